@@ -225,6 +225,19 @@ int dtpipe_set_param_float(dt_pipe_t *pipe, const char *module,
 int dtpipe_set_param_int(dt_pipe_t *pipe, const char *module,
                          const char *param, int value);
 
+/*
+ * dtpipe_set_param_string - Set a string parameter on a module (e.g. the
+ * lut3d "filepath").
+ *
+ * value is copied into the module's fixed-size field; it must be shorter
+ * than that field.
+ *
+ * Returns DTPIPE_OK, DTPIPE_ERR_NOT_FOUND, DTPIPE_ERR_PARAM_TYPE, or
+ * DTPIPE_ERR_INVALID_ARG (also when value is too long).
+ */
+int dtpipe_set_param_string(dt_pipe_t *pipe, const char *module,
+                            const char *param, const char *value);
+
 /*
  * dtpipe_get_param_float - Read a float parameter from a module.
  *
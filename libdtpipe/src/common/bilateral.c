@@ -0,0 +1,452 @@
+/*
+ * bilateral.c - Bilateral grid (splat / blur / slice) on the L channel
+ *
+ * See bilateral.h.
+ */
+
+#include "common/bilateral.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// These limits clamp away insane memory requirements.  They should reasonably faithfully represent the full
+// precision though, so tiling will help reduce the memory footprint and export will look the same as darkroom
+// mode (only 1mpix there).
+#define DT_COMMON_BILATERAL_MAX_RES_S 3000
+#define DT_COMMON_BILATERAL_MAX_RES_R 50
+
+void dt_bilateral_grid_size(dt_bilateral_t *b,
+                            const int width,
+                            const int height,
+                            const float L_range,
+                            float sigma_s,
+                            const float sigma_r)
+{
+  // Callers adjust sigma_s to account for image scaling to make the
+  // bilateral filter scale-invariant.  As a result, if the user sets
+  // a small enough value for sigma, we can get sigma_s substantially
+  // below 1.0.  Values < 1 generate a bilateral grid with spatial
+  // dimensions larger than the (scaled) image pixel dimensions; for
+  // sigma_s < 0.5, there is at least one unused grid point between
+  // any two used points, and thus the gaussian blur will have little
+  // effect.  So we force sigma_s to be at least 0.5 to avoid an
+  // excessively large grid.
+  if(sigma_s < 0.5) sigma_s = 0.5;
+
+  // compute an initial grid size, clamping away insanely large grids
+  float _x = CLAMPS((int)roundf(width / sigma_s), 4, DT_COMMON_BILATERAL_MAX_RES_S);
+  float _y = CLAMPS((int)roundf(height / sigma_s), 4, DT_COMMON_BILATERAL_MAX_RES_S);
+  float _z = CLAMPS((int)roundf(L_range / sigma_r), 4, DT_COMMON_BILATERAL_MAX_RES_R);
+  // If we clamped the X or Y dimensions, the sigma_s for that
+  // dimension changes.  Since we need to use the same value in both
+  // dimensions, compute the effective sigma_s for the grid.
+  b->sigma_s = MAX(height / _y, width / _x);
+  b->sigma_r = L_range / _z;
+  // cache the reciprocals so that we can multiply instead of dividing to get a grid point
+  b->sigma_s_inv = 1.0f / b->sigma_s;
+  b->sigma_r_inv = 1.0f / b->sigma_r;
+  // Compute the grid size in light of the actual adjusted values for
+  // sigma_s and sigma_r
+  b->size_x = (int)ceilf(width * b->sigma_s_inv) + 1;
+  b->size_y = (int)ceilf(height * b->sigma_s_inv) + 1;
+  b->size_z = (int)ceilf(L_range * b->sigma_r_inv) + 1;
+}
+
+float dt_bilateral_scaled_sigma_s(const int full_width,
+                                  const int full_height,
+                                  const float sigma_s,
+                                  const float scale)
+{
+  // clamp the grid against the full image, exactly as
+  // dt_bilateral_grid_size() would for a full-size render, then carry
+  // the resulting cell size over to the roi.  dt_bilateral_grid_size()
+  // can then only clamp further where the roi itself is too small.
+  const float s = fmaxf(sigma_s, 0.5f);
+  const float _x = CLAMPS((int)roundf(full_width / s), 4, DT_COMMON_BILATERAL_MAX_RES_S);
+  const float _y = CLAMPS((int)roundf(full_height / s), 4, DT_COMMON_BILATERAL_MAX_RES_S);
+  const float full_sigma_s = MAX(full_height / _y, full_width / _x);
+  return full_sigma_s * fminf(scale, 1.0f);
+}
+
+// grid rows touched by the image rows of one slice: the rows the first
+// and last image row fall into, plus the one below for the bilinear
+// weights, plus one for rounding.
+static inline int _slice_grid_rows(const dt_bilateral_t *const b)
+{
+  return (int)ceilf(b->sliceheight * b->sigma_s_inv) + 3;
+}
+
+// first grid row splatted by a slice
+static inline int _slice_first_grid_row(const dt_bilateral_t *const b,
+                                        const int slice)
+{
+  const float y = CLAMPS(slice * b->sliceheight * b->sigma_s_inv, 0, b->size_y - 1);
+  return MIN((int)y, (int)b->size_y - 2);
+}
+
+static void _slice_layout(dt_bilateral_t *b)
+{
+  b->numslices = MAX(1, MIN(dt_get_num_threads(), b->height));
+  b->sliceheight = (b->height + b->numslices - 1) / b->numslices;
+  b->slicerows = _slice_grid_rows(b);
+}
+
+size_t dt_bilateral_memory_use(const int width,     // width of input image
+                               const int height,    // height of input image
+                               const float sigma_s, // spatial sigma (blur pixel coords)
+                               const float sigma_r) // range sigma (blur luma values)
+{
+  dt_bilateral_t b;
+  dt_bilateral_grid_size(&b, width, height, 100.0f, sigma_s, sigma_r);
+  b.width = width;
+  b.height = height;
+  _slice_layout(&b);
+  const size_t grid_size = b.size_x * b.size_y * b.size_z;
+  const size_t band_size = (size_t)(b.numslices - 1) * b.slicerows * b.size_x * b.size_z;
+  return (grid_size + band_size) * sizeof(float);
+}
+
+size_t dt_bilateral_singlebuffer_size(const int width,     // width of input image
+                                      const int height,    // height of input image
+                                      const float sigma_s, // spatial sigma (blur pixel coords)
+                                      const float sigma_r) // range sigma (blur luma values)
+{
+  dt_bilateral_t b;
+  dt_bilateral_grid_size(&b, width, height, 100.0f, sigma_s, sigma_r);
+  return b.size_x * b.size_y * b.size_z * sizeof(float);
+}
+
+static size_t image_to_grid(const dt_bilateral_t *const b,
+                            const int i,
+                            const int j,
+                            const float L,
+                            float *xf,
+                            float *yf,
+                            float *zf)
+{
+  float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
+  float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+  float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
+  const int xi = MIN((int)x, b->size_x - 2);
+  const int yi = MIN((int)y, b->size_y - 2);
+  const int zi = MIN((int)z, b->size_z - 2);
+  *xf = x - xi;
+  *yf = y - yi;
+  *zf = z - zi;
+  return ((xi + yi * b->size_x) * b->size_z) + zi;
+}
+
+static size_t image_to_relgrid(const dt_bilateral_t *const b,
+                               const int i,
+                               const float L,
+                               float *xf,
+                               float *zf)
+{
+  float x = CLAMPS(i * b->sigma_s_inv, 0, b->size_x - 1);
+  float z = CLAMPS(L * b->sigma_r_inv, 0, b->size_z - 1);
+  const int xi = MIN((int)x, b->size_x - 2);
+  const int zi = MIN((int)z, b->size_z - 2);
+  *xf = x - xi;
+  *zf = z - zi;
+  return (xi * b->size_z) + zi;
+}
+
+dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
+                                  const int height,    // height of input image
+                                  const float sigma_s, // spatial sigma (blur pixel coords)
+                                  const float sigma_r) // range sigma (blur luma values)
+{
+  dt_bilateral_t *b = malloc(sizeof(dt_bilateral_t));
+  if(!b) return NULL;
+  dt_bilateral_grid_size(b, width, height, 100.0f, sigma_s, sigma_r);
+  b->width = width;
+  b->height = height;
+  _slice_layout(b);
+  b->buf = dt_calloc_align_float(b->size_x * b->size_y * b->size_z);
+  b->bands = NULL;
+  if(b->buf && b->numslices > 1)
+    b->bands = dt_alloc_align_float((size_t)(b->numslices - 1) * b->slicerows * b->size_x * b->size_z);
+  if(!b->buf || (b->numslices > 1 && !b->bands))
+  {
+    fprintf(stderr, "[bilateral] unable to allocate buffer for %zux%zux%zu grid\n",
+            b->size_x, b->size_y, b->size_z);
+    dt_free_align(b->buf);
+    free(b);
+    return NULL;
+  }
+  return b;
+}
+
+void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
+{
+  const int ox = b->size_z;
+  const int oy = b->size_x * b->size_z;
+  const int oz = 1;
+  const float sigma_s = b->sigma_s * b->sigma_s;
+  float *const buf = b->buf;
+
+  if(!buf) return;
+  // splat into downsampled grid
+  const size_t offsets[8] =
+  {
+    0,
+    ox,
+    oy,
+    ox + oy,
+    oz,
+    oz + ox,
+    oz + oy,
+    oz + oy + ox
+  };
+  const size_t band_size = (size_t)b->slicerows * oy;
+
+  // every slice of image rows splats into a private band of grid rows,
+  // so no two threads ever add to the same cell.  Slice 0 starts at grid
+  // row 0 and uses the grid itself.
+  DT_OMP_FOR()
+  for(int slice = 0; slice < b->numslices; slice++)
+  {
+    const int firstrow = slice * b->sliceheight;
+    const int lastrow = MIN((slice + 1) * b->sliceheight, b->height);
+    const int first_grid_row = _slice_first_grid_row(b, slice);
+    float *const band = slice ? b->bands + (slice - 1) * band_size : buf;
+    if(slice) memset(band, 0, sizeof(float) * band_size);
+    // now iterate over the rows of the current horizontal slice
+    for(int j = firstrow; j < lastrow; j++)
+    {
+      float y = CLAMPS(j * b->sigma_s_inv, 0, b->size_y - 1);
+      const int yi = MIN((int)y, b->size_y - 2);
+      const float yf = y - yi;
+      const size_t base = (size_t)(yi - first_grid_row) * oy;
+      for(int i = 0; i < b->width; i++)
+      {
+        size_t index = 4 * ((size_t)j * b->width + i);
+        float xf, zf;
+        const float L = in[index];
+        // nearest neighbour splatting:
+        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+        // sum up payload here
+        const dt_aligned_pixel_t contrib =
+        {
+          // precompute the contributions along the first two dimensions:
+          (1.0f - xf) * (1.0f - yf) * 100.0f / sigma_s,
+          xf * (1.0f - yf) * 100.0f / sigma_s,
+          (1.0f - xf) * yf * 100.0f / sigma_s,
+          xf * yf * 100.0f / sigma_s
+        };
+        DT_OMP_SIMD()
+        for(int k = 0; k < 4; k++)
+        {
+          band[grid_index + offsets[k]] += (contrib[k] * (1.0f - zf));
+          band[grid_index + offsets[k+4]] += (contrib[k] * zf);
+        }
+      }
+    }
+  }
+
+  if(b->numslices == 1) return;
+
+  // reduce the private bands into the grid.  Adjacent bands overlap by a
+  // row or two, so parallelize over grid rows and let each row gather
+  // from every band that covers it.
+  DT_OMP_FOR()
+  for(int row = 0; row < (int)b->size_y; row++)
+  {
+    float *const dest = buf + (size_t)row * oy;
+    for(int slice = 1; slice < b->numslices; slice++)
+    {
+      const int r = row - _slice_first_grid_row(b, slice);
+      if(r < 0 || r >= b->slicerows) continue;
+      const float *const src = b->bands + (slice - 1) * band_size + (size_t)r * oy;
+      DT_OMP_SIMD()
+      for(int i = 0; i < oy; i++)
+        dest[i] += src[i];
+    }
+  }
+}
+
+static void blur_line_z(float *buf,
+                        const int offset1,
+                        const int offset2,
+                        const int offset3,
+                        const int size1,
+                        const int size2,
+                        const int size3)
+{
+  const float w1 = 4.f / 16.f;
+  const float w2 = 2.f / 16.f;
+  DT_OMP_FOR()
+  for(int k = 0; k < size1; k++)
+  {
+    size_t index = (size_t)k * offset1;
+    for(int j = 0; j < size2; j++)
+    {
+      float tmp1 = buf[index];
+      buf[index] = w1 * buf[index + offset3] + w2 * buf[index + 2 * offset3];
+      index += offset3;
+      float tmp2 = buf[index];
+      buf[index] = w1 * (buf[index + offset3] - tmp1) + w2 * buf[index + 2 * offset3];
+      index += offset3;
+      for(int i = 2; i < size3 - 2; i++)
+      {
+        const float tmp3 = buf[index];
+        buf[index] = +w1 * (buf[index + offset3] - tmp2)
+          + w2 * (buf[index + 2 * offset3] - tmp1);
+        index += offset3;
+        tmp1 = tmp2;
+        tmp2 = tmp3;
+      }
+      const float tmp3 = buf[index];
+      buf[index] = w1 * (buf[index + offset3] - tmp2) - w2 * tmp1;
+      index += offset3;
+      buf[index] = -w1 * tmp3 - w2 * tmp2;
+      index += offset3;
+      index += offset2 - offset3 * size3;
+    }
+  }
+}
+
+static void blur_line(float *buf,
+                      const int offset1,
+                      const int offset2,
+                      const int offset3,
+                      const int size1,
+                      const int size2,
+                      const int size3)
+{
+  const float w0 = 6.f / 16.f;
+  const float w1 = 4.f / 16.f;
+  const float w2 = 1.f / 16.f;
+  DT_OMP_FOR()
+  for(int k = 0; k < size1; k++)
+  {
+    size_t index = (size_t)k * offset1;
+    for(int j = 0; j < size2; j++)
+    {
+      float tmp1 = buf[index];
+      buf[index] = buf[index] * w0 + w1 * buf[index + offset3]
+        + w2 * buf[index + 2 * offset3];
+      index += offset3;
+      float tmp2 = buf[index];
+      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp1)
+        + w2 * buf[index + 2 * offset3];
+      index += offset3;
+      for(int i = 2; i < size3 - 2; i++)
+      {
+        const float tmp3 = buf[index];
+        buf[index]
+            = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2)
+          + w2 * (buf[index + 2 * offset3] + tmp1);
+        index += offset3;
+        tmp1 = tmp2;
+        tmp2 = tmp3;
+      }
+      const float tmp3 = buf[index];
+      buf[index] = buf[index] * w0 + w1 * (buf[index + offset3] + tmp2) + w2 * tmp1;
+      index += offset3;
+      buf[index] = buf[index] * w0 + w1 * tmp3 + w2 * tmp2;
+      index += offset3;
+      index += offset2 - offset3 * size3;
+    }
+  }
+}
+
+void dt_bilateral_blur(const dt_bilateral_t *b)
+{
+  if(!b || !b->buf)
+    return;
+
+  const int ox = b->size_z;
+  const int oy = b->size_x * b->size_z;
+  const int oz = 1;
+  // gaussian up to 3 sigma
+  blur_line(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x);
+  // gaussian up to 3 sigma
+  blur_line(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y);
+  // -2 derivative of the gaussian up to 3 sigma: x*exp(-x*x)
+  blur_line_z(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z);
+}
+
+// trilinear lookup of the blurred grid at image pixel (i, j) with luma L
+static inline float _grid_lookup(const dt_bilateral_t *const b,
+                                 const int i,
+                                 const int j,
+                                 const float L)
+{
+  const int ox = b->size_z;
+  const int oy = b->size_x * b->size_z;
+  const int oz = 1;
+  const float *const buf = b->buf;
+  float xf, yf, zf;
+  const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
+  return buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
+       + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
+       + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
+       + buf[gi + ox + oy] * (xf) * (yf) * (1.0f - zf)
+       + buf[gi + oz] * (1.0f - xf) * (1.0f - yf) * (zf)
+       + buf[gi + ox + oz] * (xf) * (1.0f - yf) * (zf)
+       + buf[gi + oy + oz] * (1.0f - xf) * (yf) * (zf)
+       + buf[gi + ox + oy + oz] * (xf) * (yf) * (zf);
+}
+
+void dt_bilateral_slice(const dt_bilateral_t *const b,
+                        const float *const in,
+                        float *out,
+                        const float detail)
+{
+  // detail: 0 is leave as is, -1 is bilateral filtered, +1 is contrast boost
+  const float norm = -detail * b->sigma_r * 0.04f;
+  const int width = b->width;
+  const int height = b->height;
+
+  if(!b->buf) return;
+  DT_OMP_FOR(collapse(2))
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      size_t index = 4 * ((size_t)j * width + i);
+      const float L = in[index];
+      const float Lout = fmaxf(0.0f, L + norm * _grid_lookup(b, i, j, L));
+      // copy color and mask, then update L
+      copy_pixel(out + index, in + index);
+      out[index] = Lout;
+    }
+  }
+}
+
+void dt_bilateral_slice_to_output(const dt_bilateral_t *const b,
+                                  const float *const in,
+                                  float *out,
+                                  const float detail)
+{
+  // detail: 0 is leave as is, -1 is bilateral filtered, +1 is contrast boost
+  const float norm = -detail * b->sigma_r * 0.04f;
+  const int width = b->width;
+  const int height = b->height;
+
+  if(!b->buf) return;
+  DT_OMP_FOR(collapse(2))
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      size_t index = 4 * ((size_t)j * width + i);
+      const float L = in[index];
+      const float Lout = norm * _grid_lookup(b, i, j, L);
+      out[index] = MAX(0.0f, out[index] + Lout);
+    }
+  }
+}
+
+void dt_bilateral_free(dt_bilateral_t *b)
+{
+  if(!b) return;
+  dt_free_align(b->buf);
+  dt_free_align(b->bands);
+  free(b);
+}
+
+#undef DT_COMMON_BILATERAL_MAX_RES_S
+#undef DT_COMMON_BILATERAL_MAX_RES_R
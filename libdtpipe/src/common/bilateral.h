@@ -0,0 +1,87 @@
+/*
+ * bilateral.h - Bilateral grid (splat / blur / slice) on the L channel
+ *
+ * Ported from darktable src/common/bilateral.c
+ * Copyright (C) 2009-2024 darktable developers.
+ *
+ * Stripped of: the OpenCL grid (bilateralcl.c) and its *_cl / *2 memory
+ * queries.
+ *
+ * Changes:
+ *   - the splat gives every thread a private band of grid rows and reduces
+ *     the bands into the shared grid afterwards, row-parallel.  darktable's
+ *     CPU path shares one buffer between the bands and merges them
+ *     serially; the OpenCL path splats with atomics.  The first band is
+ *     the shared grid itself, so a single thread needs no extra memory.
+ *   - dt_bilateral_scaled_sigma_s() maps a spatial sigma given in
+ *     full-image pixels to the roi, clamping the grid against the full
+ *     image rather than against the roi, so crops, tiles and downscaled
+ *     renders use the same grid cells (in image space) as a full-size
+ *     export.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dt_bilateral_t
+{
+  size_t size_x, size_y, size_z;
+  int width, height;
+  int numslices, sliceheight, slicerows; // height--in input image, rows--in grid
+  float sigma_s, sigma_r;
+  float sigma_s_inv, sigma_r_inv;  // reciprocals of sigma_s and sigma_r to avoid divisions
+  float *buf;                      // the grid, size_x * size_y * size_z
+  float *bands;                    // private grid bands of slices 1..numslices-1
+} dt_bilateral_t;
+
+/**
+ * Spatial sigma to pass to dt_bilateral_init() for a roi rendered at
+ * `scale` (roi pixels per full-image pixel) out of a full image of
+ * full_width x full_height, when the user sigma_s is in full-image pixels.
+ * Magnified rois (scale > 1) keep the full-image sigma so noise is not
+ * amplified.
+ */
+float dt_bilateral_scaled_sigma_s(const int full_width,   // width of the full image
+                                  const int full_height,  // height of the full image
+                                  const float sigma_s,    // spatial sigma in full-image pixels
+                                  const float scale);     // roi scale
+
+size_t dt_bilateral_memory_use(const int width,      // width of input image
+                               const int height,     // height of input image
+                               const float sigma_s,  // spatial sigma (blur pixel coords)
+                               const float sigma_r); // range sigma (blur luma values)
+
+size_t dt_bilateral_singlebuffer_size(const int width,      // width of input image
+                                      const int height,     // height of input image
+                                      const float sigma_s,  // spatial sigma (blur pixel coords)
+                                      const float sigma_r); // range sigma (blur luma values)
+
+void dt_bilateral_grid_size(dt_bilateral_t *b, const int width, const int height, const float L_range,
+                            float sigma_s, const float sigma_r);
+
+dt_bilateral_t *dt_bilateral_init(const int width,      // width of input image
+                                  const int height,     // height of input image
+                                  const float sigma_s,  // spatial sigma (blur pixel coords)
+                                  const float sigma_r); // range sigma (blur luma values)
+
+void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in);
+
+void dt_bilateral_blur(const dt_bilateral_t *b);
+
+void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, float *out, const float detail);
+
+void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *const in, float *out,
+                                  const float detail);
+
+void dt_bilateral_free(dt_bilateral_t *b);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,223 @@
+/*
+ * chromatic_adaptation.h - Bradford, CAT16 and XYZ chromatic adaptation
+ *
+ * Ported subset of darktable src/common/chromatic_adaptation.h.
+ * Copyright (C) 2020-2025 darktable developers.
+ *
+ * Stripped of: the D50 adaptation variants, the pre-solved D50 <-> D65
+ * matrices and chroma_adapt_pixel().
+ *
+ * Changes: the libdtpipe pipeline white is D65 (see common/colorspaces.h),
+ * so only the *_adapt_D65() variants are kept; color calibration adapts
+ * to them where darktable adapts to D50.
+ *
+ * Header-only: everything is static inline.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+#include "common/colorspaces.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum dt_adaptation_t
+{
+  DT_ADAPTATION_LINEAR_BRADFORD = 0, /* linear Bradford (ICC v4) */
+  DT_ADAPTATION_CAT16           = 1, /* CAT16 (CIECAM16)         */
+  DT_ADAPTATION_FULL_BRADFORD   = 2, /* non-linear Bradford      */
+  DT_ADAPTATION_XYZ             = 3, /* XYZ                      */
+  DT_ADAPTATION_RGB             = 4, /* none (bypass)            */
+  DT_ADAPTATION_LAST
+} dt_adaptation_t;
+
+/* ── Bradford ────────────────────────────────────────────────────────────── */
+
+static const dt_colormatrix_t XYZ_to_Bradford_LMS = { {  0.8951f,  0.2664f, -0.1614f, 0.f },
+                                                      { -0.7502f,  1.7135f,  0.0367f, 0.f },
+                                                      {  0.0389f, -0.0685f,  1.0296f, 0.f } };
+
+static const dt_colormatrix_t XYZ_to_Bradford_LMS_trans = { {  0.8951f, -0.7502f,  0.0389f, 0.f },
+                                                            {  0.2664f,  1.7135f, -0.0685f, 0.f },
+                                                            { -0.1614f,  0.0367f,  1.0296f, 0.f } };
+
+static const dt_colormatrix_t Bradford_LMS_to_XYZ = { {  0.9870f, -0.1471f,  0.1600f, 0.f },
+                                                      {  0.4323f,  0.5184f,  0.0493f, 0.f },
+                                                      { -0.0085f,  0.0400f,  0.9685f, 0.f } };
+
+static const dt_colormatrix_t Bradford_LMS_to_XYZ_trans = { {  0.9870f,  0.4323f, -0.0085f, 0.f },
+                                                            { -0.1471f,  0.5184f,  0.0400f, 0.f },
+                                                            {  0.1600f,  0.0493f,  0.9685f, 0.f } };
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16))
+static inline void convert_XYZ_to_bradford_LMS(const dt_aligned_pixel_t XYZ, dt_aligned_pixel_t LMS)
+{
+  dt_apply_transposed_color_matrix(XYZ, XYZ_to_Bradford_LMS_trans, LMS);
+}
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16))
+static inline void convert_bradford_LMS_to_XYZ(const dt_aligned_pixel_t LMS, dt_aligned_pixel_t XYZ)
+{
+  dt_apply_transposed_color_matrix(LMS, Bradford_LMS_to_XYZ_trans, XYZ);
+}
+
+static inline void make_RGB_to_Bradford_LMS(const dt_colormatrix_t rgb, dt_colormatrix_t lms)
+{
+  dt_colormatrix_mul(lms, XYZ_to_Bradford_LMS, rgb);
+}
+
+static inline void make_Bradford_LMS_to_XYZ(const dt_colormatrix_t lms, dt_colormatrix_t xyz)
+{
+  dt_colormatrix_mul(xyz, Bradford_LMS_to_XYZ, lms);
+}
+
+/* ── CAT16 ───────────────────────────────────────────────────────────────── */
+
+static const dt_colormatrix_t XYZ_to_CAT16_LMS = { {  0.401288f, 0.650173f, -0.051461f, 0.f },
+                                                   { -0.250268f, 1.204414f,  0.045854f, 0.f },
+                                                   { -0.002079f, 0.048952f,  0.953127f, 0.f } };
+
+static const dt_colormatrix_t XYZ_to_CAT16_LMS_trans = { {  0.401288f, -0.250268f, -0.002079f, 0.f },
+                                                         {  0.650173f,  1.204414f,  0.048952f, 0.f },
+                                                         { -0.051461f,  0.045854f,  0.953127f, 0.f } };
+
+static const dt_colormatrix_t CAT16_LMS_to_XYZ = { {  1.862068f, -1.011255f,  0.149187f, 0.f },
+                                                   {  0.38752f ,  0.621447f, -0.008974f, 0.f },
+                                                   { -0.015841f, -0.034123f,  1.049964f, 0.f } };
+
+static const dt_colormatrix_t CAT16_LMS_to_XYZ_trans = { {  1.862068f,  0.38752f , -0.015841f, 0.f },
+                                                         { -1.011255f,  0.621447f, -0.034123f, 0.f },
+                                                         {  0.149187f, -0.008974f,  1.049964f, 0.f } };
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16))
+static inline void convert_XYZ_to_CAT16_LMS(const dt_aligned_pixel_t XYZ, dt_aligned_pixel_t LMS)
+{
+  dt_apply_transposed_color_matrix(XYZ, XYZ_to_CAT16_LMS_trans, LMS);
+}
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16))
+static inline void convert_CAT16_LMS_to_XYZ(const dt_aligned_pixel_t LMS, dt_aligned_pixel_t XYZ)
+{
+  dt_apply_transposed_color_matrix(LMS, CAT16_LMS_to_XYZ_trans, XYZ);
+}
+
+static inline void make_RGB_to_CAT16_LMS(const dt_colormatrix_t rgb, dt_colormatrix_t lms)
+{
+  dt_colormatrix_mul(lms, XYZ_to_CAT16_LMS, rgb);
+}
+
+static inline void make_CAT16_LMS_to_XYZ(const dt_colormatrix_t lms, dt_colormatrix_t xyz)
+{
+  dt_colormatrix_mul(xyz, CAT16_LMS_to_XYZ, lms);
+}
+
+/* ── Generic LMS <-> XYZ ─────────────────────────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16) uniform(kind))
+static inline void convert_any_LMS_to_XYZ(const dt_aligned_pixel_t LMS, dt_aligned_pixel_t XYZ,
+                                          const dt_adaptation_t kind)
+{
+  switch(kind)
+  {
+    case DT_ADAPTATION_FULL_BRADFORD:
+    case DT_ADAPTATION_LINEAR_BRADFORD:
+      convert_bradford_LMS_to_XYZ(LMS, XYZ);
+      break;
+    case DT_ADAPTATION_CAT16:
+      convert_CAT16_LMS_to_XYZ(LMS, XYZ);
+      break;
+    case DT_ADAPTATION_XYZ:
+    case DT_ADAPTATION_RGB:
+    case DT_ADAPTATION_LAST:
+    default:
+      XYZ[0] = LMS[0];
+      XYZ[1] = LMS[1];
+      XYZ[2] = LMS[2];
+      break;
+  }
+}
+
+DT_OMP_DECLARE_SIMD(aligned(XYZ, LMS:16) uniform(kind))
+static inline void convert_any_XYZ_to_LMS(const dt_aligned_pixel_t XYZ, dt_aligned_pixel_t LMS,
+                                          const dt_adaptation_t kind)
+{
+  switch(kind)
+  {
+    case DT_ADAPTATION_FULL_BRADFORD:
+    case DT_ADAPTATION_LINEAR_BRADFORD:
+      convert_XYZ_to_bradford_LMS(XYZ, LMS);
+      break;
+    case DT_ADAPTATION_CAT16:
+      convert_XYZ_to_CAT16_LMS(XYZ, LMS);
+      break;
+    case DT_ADAPTATION_XYZ:
+    case DT_ADAPTATION_RGB:
+    case DT_ADAPTATION_LAST:
+    default:
+      LMS[0] = XYZ[0];
+      LMS[1] = XYZ[1];
+      LMS[2] = XYZ[2];
+      break;
+  }
+}
+
+/* ── Adaptations to the D65 pipeline white ───────────────────────────────── */
+
+/* D65 white in each LMS space, Y = 1 */
+static const dt_aligned_pixel_t Bradford_LMS_D65 = { 0.941238f, 1.040633f, 1.088932f, 0.f };
+static const dt_aligned_pixel_t CAT16_LMS_D65 = { 0.97553267f, 1.01647859f, 1.0848344f, 0.f };
+static const dt_aligned_pixel_t XYZ_D65 = { 0.9504285453771807f, 1.0f, 1.0889003707981277f, 0.f };
+
+DT_OMP_DECLARE_SIMD(uniform(origin_illuminant) aligned(lms_in, lms_out, origin_illuminant:16))
+static inline void bradford_adapt_D65(const dt_aligned_pixel_t lms_in,
+                                      const dt_aligned_pixel_t origin_illuminant,
+                                      const float p, const int full,
+                                      dt_aligned_pixel_t lms_out)
+{
+  dt_aligned_pixel_t temp = { lms_in[0] / origin_illuminant[0],
+                              lms_in[1] / origin_illuminant[1],
+                              lms_in[2] / origin_illuminant[2],
+                              0.f };
+
+  if(full) temp[2] = (temp[2] > 0.f) ? powf(temp[2], p) : temp[2];
+
+  lms_out[0] = Bradford_LMS_D65[0] * temp[0];
+  lms_out[1] = Bradford_LMS_D65[1] * temp[1];
+  lms_out[2] = Bradford_LMS_D65[2] * temp[2];
+}
+
+DT_OMP_DECLARE_SIMD(uniform(origin_illuminant) aligned(lms_in, lms_out, origin_illuminant:16))
+static inline void CAT16_adapt_D65(const dt_aligned_pixel_t lms_in,
+                                   const dt_aligned_pixel_t origin_illuminant,
+                                   const float D, const int full,
+                                   dt_aligned_pixel_t lms_out)
+{
+  if(full)
+  {
+    lms_out[0] = lms_in[0] * CAT16_LMS_D65[0] / origin_illuminant[0];
+    lms_out[1] = lms_in[1] * CAT16_LMS_D65[1] / origin_illuminant[1];
+    lms_out[2] = lms_in[2] * CAT16_LMS_D65[2] / origin_illuminant[2];
+  }
+  else
+  {
+    lms_out[0] = lms_in[0] * (D * CAT16_LMS_D65[0] / origin_illuminant[0] + 1.f - D);
+    lms_out[1] = lms_in[1] * (D * CAT16_LMS_D65[1] / origin_illuminant[1] + 1.f - D);
+    lms_out[2] = lms_in[2] * (D * CAT16_LMS_D65[2] / origin_illuminant[2] + 1.f - D);
+  }
+}
+
+DT_OMP_DECLARE_SIMD(uniform(origin_illuminant) aligned(lms_in, lms_out, origin_illuminant:16))
+static inline void XYZ_adapt_D65(const dt_aligned_pixel_t lms_in,
+                                 const dt_aligned_pixel_t origin_illuminant,
+                                 dt_aligned_pixel_t lms_out)
+{
+  lms_out[0] = lms_in[0] * XYZ_D65[0] / origin_illuminant[0];
+  lms_out[1] = lms_in[1] * XYZ_D65[1] / origin_illuminant[1];
+  lms_out[2] = lms_in[2] * XYZ_D65[2] / origin_illuminant[2];
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,590 @@
+/*
+ * colorspaces.h - RGB colour spaces, matrix helpers and Kirk Yrg/Ych
+ *
+ * Ported subset of darktable src/common/colorspaces.c,
+ * colorspaces_inline_conversions.h, matrices.c, custom_primaries.c and
+ * gamut_mapping.h.
+ * Copyright (C) 2009-2024 darktable developers.
+ *
+ * Stripped of: ICC profile handling, lcms2, the D50 profile list and the
+ * CAT16 adaptation matrices.
+ *
+ * Changes: libdtpipe has no working profile; colorin is a plain camera
+ * matrix into linear Rec.709, the pipeline RGB, so every colour space here is
+ * defined by its primaries and a D65 white point and the RGB <-> XYZ
+ * matrices are built directly against D65.  The tone mappers use this
+ * instead of dt_ioppr_get_pipe_work_profile_info().
+ *
+ * Header-only: everything is static inline.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+
+#include <float.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* ── Colour space descriptors ────────────────────────────────────────────── */
+
+/*
+ * Built-in spaces: DT_COLORSPACE_LIN_REC709 / DT_COLORSPACE_SRGB (same
+ * primaries), DT_COLORSPACE_LIN_REC2020, DT_COLORSPACE_DISPLAY_P3 and
+ * DT_COLORSPACE_ADOBERGB; anything else falls back to Rec.709.
+ *
+ * An RGB space reduced to what the tone mappers need: primaries and white
+ * point in CIE 1931 xy, and the RGB -> XYZ (matrix_in) / XYZ -> RGB
+ * (matrix_out) matrices, plain and transposed for
+ * dt_apply_transposed_color_matrix().
+ */
+typedef struct dt_colorspaces_rgb_space_t
+{
+  dt_colorspaces_color_profile_type_t type;
+  float primaries[3][2];
+  float whitepoint[2];
+  dt_colormatrix_t matrix_in;
+  dt_colormatrix_t matrix_out;
+  dt_colormatrix_t matrix_in_transposed;
+  dt_colormatrix_t matrix_out_transposed;
+} dt_colorspaces_rgb_space_t;
+
+/* ── Padded 3x3 matrix helpers ───────────────────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD(aligned(in,out : 16) aligned(matrix : 64))
+static inline void dt_apply_transposed_color_matrix(const dt_aligned_pixel_t in,
+                                                    const dt_colormatrix_t matrix,
+                                                    dt_aligned_pixel_t out)
+{
+  for_each_channel(r)
+    out[r] = matrix[0][r] * in[0] + matrix[1][r] * in[1] + matrix[2][r] * in[2];
+}
+
+static inline void dt_colormatrix_mul(dt_colormatrix_t dst,
+                                      const dt_colormatrix_t m1,
+                                      const dt_colormatrix_t m2)
+{
+  for(int k = 0; k < 3; ++k)
+  {
+    dt_aligned_pixel_t sum = { 0.0f };
+    for_each_channel(i)
+    {
+      for(int j = 0; j < 3; j++)
+        sum[i] += m1[k][j] * m2[j][i];
+      dst[k][i] = sum[i];
+    }
+  }
+}
+
+static inline void dt_colormatrix_transpose(dt_colormatrix_t dst,
+                                            const dt_colormatrix_t src)
+{
+  for_four_channels(c)
+  {
+    dst[0][c] = src[c][0];
+    dst[1][c] = src[c][1];
+    dst[2][c] = src[c][2];
+    dst[3][c] = src[c][3];
+  }
+}
+
+static inline void dt_colormatrix_identity(dt_colormatrix_t m)
+{
+  for(int i = 0; i < 4; i++)
+    for(int j = 0; j < 4; j++)
+      m[i][j] = (i == j && i < 3) ? 1.0f : 0.0f;
+}
+
+/** Invert a padded 3x3 matrix.  Returns 1 (and leaves dst alone) if singular. */
+static inline int mat3SSEinv(dt_colormatrix_t dst, const dt_colormatrix_t src)
+{
+#define A(y, x) src[(y - 1)][(x - 1)]
+#define B(y, x) dst[(y - 1)][(x - 1)]
+
+  const float det = A(1, 1) * (A(3, 3) * A(2, 2) - A(3, 2) * A(2, 3))
+                    - A(2, 1) * (A(3, 3) * A(1, 2) - A(3, 2) * A(1, 3))
+                    + A(3, 1) * (A(2, 3) * A(1, 2) - A(2, 2) * A(1, 3));
+
+  const float epsilon = 1e-7f;
+  if(fabsf(det) < epsilon) return 1;
+
+  const float invDet = 1.f / det;
+
+  B(1, 1) = invDet * (A(3, 3) * A(2, 2) - A(3, 2) * A(2, 3));
+  B(1, 2) = -invDet * (A(3, 3) * A(1, 2) - A(3, 2) * A(1, 3));
+  B(1, 3) = invDet * (A(2, 3) * A(1, 2) - A(2, 2) * A(1, 3));
+
+  B(2, 1) = -invDet * (A(3, 3) * A(2, 1) - A(3, 1) * A(2, 3));
+  B(2, 2) = invDet * (A(3, 3) * A(1, 1) - A(3, 1) * A(1, 3));
+  B(2, 3) = -invDet * (A(2, 3) * A(1, 1) - A(2, 1) * A(1, 3));
+
+  B(3, 1) = invDet * (A(3, 2) * A(2, 1) - A(3, 1) * A(2, 2));
+  B(3, 2) = -invDet * (A(3, 2) * A(1, 1) - A(3, 1) * A(1, 2));
+  B(3, 3) = invDet * (A(2, 2) * A(1, 1) - A(2, 1) * A(1, 2));
+#undef A
+#undef B
+  for(int i = 0; i < 3; i++) dst[i][3] = dst[3][i] = 0.0f;
+  dst[3][3] = 0.0f;
+  return 0;
+}
+
+/* ── Matrices from primaries ─────────────────────────────────────────────── */
+
+static inline float _colorspaces_sanitize_y(const float y)
+{
+  if(y < FLT_EPSILON && y >= 0.f) return FLT_EPSILON;
+  if(y < 0.f && y > -FLT_EPSILON) return -FLT_EPSILON;
+  return y;
+}
+
+/**
+ * RGB -> XYZ matrix (transposed) for the given xy primaries and white point.
+ * http://www.brucelindbloom.com/index.html?Eqn_RGB_XYZ_Matrix.html
+ */
+static inline void
+dt_make_transposed_matrices_from_primaries_and_whitepoint(const float primaries[3][2],
+                                                          const float whitepoint[2],
+                                                          dt_colormatrix_t RGB_to_XYZ_transposed)
+{
+  dt_colormatrix_t primaries_matrix = { { 0.f } };
+  for(size_t i = 0; i < 3; i++)
+  {
+    const float y = _colorspaces_sanitize_y(primaries[i][1]);
+    /* N.B. compared to linked equations, our matrix is transposed */
+    primaries_matrix[i][0] = primaries[i][0] / y;
+    primaries_matrix[i][1] = 1.f;
+    primaries_matrix[i][2] = (1.f - primaries[i][0] - y) / y;
+  }
+
+  dt_colormatrix_t primaries_inverse = { { 0.f } };
+  mat3SSEinv(primaries_inverse, primaries_matrix);
+  dt_aligned_pixel_t scale;
+  const float y = _colorspaces_sanitize_y(whitepoint[1]);
+  const dt_aligned_pixel_t XYZ_white = { whitepoint[0] / y, 1.f, (1.f - whitepoint[0] - y) / y, 0.f };
+  dt_apply_transposed_color_matrix(XYZ_white, primaries_inverse, scale);
+
+  for(size_t i = 0; i < 4; i++)
+    for(size_t j = 0; j < 4; j++)
+      RGB_to_XYZ_transposed[i][j] = (i < 3 && j < 3) ? scale[i] * primaries_matrix[i][j] : 0.f;
+}
+
+/** Fill *space for one of the built-in D65 colour spaces. */
+static inline void dt_colorspaces_get_rgb_space(const dt_colorspaces_color_profile_type_t type,
+                                                dt_colorspaces_rgb_space_t *space)
+{
+  static const float _rec709[3][2]  = { { 0.640f, 0.330f }, { 0.300f, 0.600f }, { 0.150f, 0.060f } };
+  static const float _rec2020[3][2] = { { 0.708f, 0.292f }, { 0.170f, 0.797f }, { 0.131f, 0.046f } };
+  static const float _p3[3][2]      = { { 0.680f, 0.320f }, { 0.265f, 0.690f }, { 0.150f, 0.060f } };
+  static const float _adobe[3][2]   = { { 0.640f, 0.330f }, { 0.210f, 0.710f }, { 0.150f, 0.060f } };
+
+  const float (*p)[2] = _rec709;
+  if(type == DT_COLORSPACE_LIN_REC2020)     p = _rec2020;
+  else if(type == DT_COLORSPACE_DISPLAY_P3) p = _p3;
+  else if(type == DT_COLORSPACE_ADOBERGB)   p = _adobe;
+
+  space->type = type;
+  for(int i = 0; i < 3; i++)
+  {
+    space->primaries[i][0] = p[i][0];
+    space->primaries[i][1] = p[i][1];
+  }
+  space->whitepoint[0] = 0.3127f;
+  space->whitepoint[1] = 0.3290f;
+
+  dt_make_transposed_matrices_from_primaries_and_whitepoint(space->primaries, space->whitepoint,
+                                                            space->matrix_in_transposed);
+  dt_colormatrix_transpose(space->matrix_in, space->matrix_in_transposed);
+  mat3SSEinv(space->matrix_out, space->matrix_in);
+  dt_colormatrix_transpose(space->matrix_out_transposed, space->matrix_out);
+}
+
+/** Colour space of the pixel data flowing through the pipe: linear Rec.709. */
+static inline void dt_colorspaces_get_pipe_rgb_space(const dt_dev_pixelpipe_t *pipe,
+                                                     dt_colorspaces_rgb_space_t *space)
+{
+  (void)pipe;
+  dt_colorspaces_get_rgb_space(DT_COLORSPACE_LIN_REC709, space);
+}
+
+/* ── Custom primaries (sigmoid / AgX) ────────────────────────────────────── */
+
+static inline float _colorspaces_intersect_line_segments(const float x1, const float y1,
+                                                         const float x2, const float y2,
+                                                         const float x3, const float y3,
+                                                         const float x4, const float y4)
+{
+  const float denominator = (x1 - x2) * (y3 - y4) - (x3 - x4) * (y1 - y2);
+  if(denominator == 0.f)
+    return FLT_MAX; /* lines don't intersect */
+
+  const float t = ((x1 - x3) * (y3 - y4) - (x3 - x4) * (y1 - y3)) / denominator;
+  if(t >= 0.f)
+    return t;
+  return FLT_MAX;   /* intersection is in the wrong direction */
+}
+
+static inline float _colorspaces_distance_to_edge(const dt_colorspaces_rgb_space_t *const space,
+                                                  const float cos_angle,
+                                                  const float sin_angle)
+{
+  const float x1 = space->whitepoint[0];
+  const float y1 = space->whitepoint[1];
+  const float x2 = x1 + cos_angle;
+  const float y2 = y1 + sin_angle;
+
+  float distance_to_edge = FLT_MAX;
+  for(size_t i = 0; i < 3; i++)
+  {
+    const size_t next_i = i == 2 ? 0 : i + 1;
+    const float distance = _colorspaces_intersect_line_segments(
+        x1, y1, x2, y2, space->primaries[i][0], space->primaries[i][1],
+        space->primaries[next_i][0], space->primaries[next_i][1]);
+    if(distance < distance_to_edge)
+      distance_to_edge = distance;
+  }
+  return distance_to_edge;
+}
+
+/**
+ * Rotate one primary of `space` around the white point by `rotation`
+ * radians and move it to `scaling` times the distance to the gamut edge.
+ */
+static inline void dt_rotate_and_scale_primary(const dt_colorspaces_rgb_space_t *const space,
+                                               const float scaling,
+                                               const float rotation,
+                                               const size_t primary_index,
+                                               float new_xy[2])
+{
+  const float dx = space->primaries[primary_index][0] - space->whitepoint[0];
+  const float dy = space->primaries[primary_index][1] - space->whitepoint[1];
+  const float angle = atan2f(dy, dx) + rotation;
+  const float cos_angle = cosf(angle);
+  const float sin_angle = sinf(angle);
+  const float distance_to_edge = _colorspaces_distance_to_edge(space, cos_angle, sin_angle);
+  new_xy[0] = scaling * distance_to_edge * cos_angle + space->whitepoint[0];
+  new_xy[1] = scaling * distance_to_edge * sin_angle + space->whitepoint[1];
+}
+
+/* ── HSV ─────────────────────────────────────────────────────────────────── */
+
+static inline float _dt_RGB_2_Hue(const dt_aligned_pixel_t RGB, const float max, const float delta)
+{
+  float hue;
+  if(RGB[0] == max)
+    hue = (RGB[1] - RGB[2]) / delta;
+  else if(RGB[1] == max)
+    hue = 2.0f + (RGB[2] - RGB[0]) / delta;
+  else
+    hue = 4.0f + (RGB[0] - RGB[1]) / delta;
+
+  hue /= 6.0f;
+
+  /* restrict to [0, 1), handling hue < 0 and hue >= 1 */
+  return hue - floorf(hue);
+}
+
+static inline void _dt_Hue_2_RGB(dt_aligned_pixel_t RGB, const float H, const float C, const float min)
+{
+  const float h = H * 6.0f;
+  const float i = floorf(h);
+  const float f = h - i;
+  const float fc = f * C;
+  const float top = C + min;
+  const float inc = fc + min;
+  const float dec = top - fc;
+  const size_t i_idx = (size_t)i;
+  if(i_idx == 0)      { RGB[0] = top; RGB[1] = inc; RGB[2] = min; }
+  else if(i_idx == 1) { RGB[0] = dec; RGB[1] = top; RGB[2] = min; }
+  else if(i_idx == 2) { RGB[0] = min; RGB[1] = top; RGB[2] = inc; }
+  else if(i_idx == 3) { RGB[0] = min; RGB[1] = dec; RGB[2] = top; }
+  else if(i_idx == 4) { RGB[0] = inc; RGB[1] = min; RGB[2] = top; }
+  else                { RGB[0] = top; RGB[1] = min; RGB[2] = dec; }
+}
+
+DT_OMP_DECLARE_SIMD(aligned(RGB, HSV: 16))
+static inline void dt_RGB_2_HSV(const dt_aligned_pixel_t RGB, dt_aligned_pixel_t HSV)
+{
+  const float min = min3f(RGB);
+  const float max = max3f(RGB);
+  const float delta = max - min;
+
+  float S = 0.0f, H = 0.0f;
+  if(fabsf(max) > 1e-6f && fabsf(delta) > 1e-6f)
+  {
+    S = delta / max;
+    H = _dt_RGB_2_Hue(RGB, max, delta);
+  }
+
+  HSV[0] = H;
+  HSV[1] = S;
+  HSV[2] = max;
+}
+
+DT_OMP_DECLARE_SIMD(aligned(HSV, RGB: 16))
+static inline void dt_HSV_2_RGB(const dt_aligned_pixel_t HSV, dt_aligned_pixel_t RGB)
+{
+  /* almost straight from https://en.wikipedia.org/wiki/HSL_and_HSV */
+  const float C = HSV[1] * HSV[2];
+  const float m = HSV[2] - C;
+  _dt_Hue_2_RGB(RGB, HSV[0], C, m);
+}
+
+/* ── CIE 2006 LMS and Kirk/Filmlight Yrg ─────────────────────────────────── */
+
+/*
+ * CIE 1931 2° XYZ D65 -> CIE 2006 LMS D65, approximation by Richard A. Kirk,
+ * "Chromaticity coordinates for graphic arts based on CIE 2006 LMS with even
+ * spacing of Munsell colours", https://doi.org/10.2352/issn.2169-2629.2019.27.38
+ */
+static const dt_colormatrix_t XYZ_D65_to_LMS_2006_D65
+    = { { 0.257085f, 0.859943f, -0.031061f, 0.f },
+        { -0.394427f, 1.175800f, 0.106423f, 0.f },
+        { 0.064856f, -0.076250f, 0.559067f, 0.f } };
+
+static const dt_colormatrix_t LMS_2006_D65_to_XYZ_D65
+    = { { 1.80794659f, -1.29971660f, 0.34785879f, 0.f },
+        { 0.61783960f, 0.39595453f, -0.04104687f, 0.f },
+        { -0.12546960f, 0.20478038f, 1.74274183f, 0.f } };
+
+static const dt_colormatrix_t filmlightRGB_D65_to_LMS_D65_trans
+    = { { 0.95f, 0.05f, 0.00f, 0.f },
+        { 0.38f, 0.62f, 0.00f, 0.f },
+        { 0.00f, 0.03f, 0.97f, 0.f } };
+
+static const dt_colormatrix_t LMS_D65_to_filmlightRGB_D65_trans
+    = { {  1.08771930f, -0.0877193f,          0.f, 0.f },
+        { -0.66666667f,  1.66666667f,         0.f, 0.f },
+        {  0.02061856f, -0.05154639f, 1.03092784f, 0.f } };
+
+#define CIE_Y_1931_to_CIE_Y_2006(x) (1.05785528f * (x))
+
+/* r, g of the D65 white in Filmlight Yrg */
+#define DT_YRG_D65_R 0.21902143f
+#define DT_YRG_D65_G 0.54371398f
+
+DT_OMP_DECLARE_SIMD(aligned(LMS, Yrg: 16))
+static inline void LMS_to_Yrg(const dt_aligned_pixel_t LMS, dt_aligned_pixel_t Yrg)
+{
+  const float Y = 0.68990272f * LMS[0] + 0.34832189f * LMS[1];
+
+  const float a = LMS[0] + LMS[1] + LMS[2];
+  dt_aligned_pixel_t lms = { 0.f };
+  for_four_channels(c, aligned(LMS, lms : 16)) lms[c] = (a == 0.f) ? 0.f : LMS[c] / a;
+
+  dt_aligned_pixel_t rgb = { 0.f };
+  dt_apply_transposed_color_matrix(lms, LMS_D65_to_filmlightRGB_D65_trans, rgb);
+
+  Yrg[0] = Y;
+  Yrg[1] = rgb[0];
+  Yrg[2] = rgb[1];
+}
+
+DT_OMP_DECLARE_SIMD(aligned(Yrg, LMS: 16))
+static inline void Yrg_to_LMS(const dt_aligned_pixel_t Yrg, dt_aligned_pixel_t LMS)
+{
+  const float Y = Yrg[0];
+  const float r = Yrg[1];
+  const float g = Yrg[2];
+  const dt_aligned_pixel_t rgb = { r, g, 1.f - r - g, 0.f };
+
+  dt_aligned_pixel_t lms = { 0.f };
+  dt_apply_transposed_color_matrix(rgb, filmlightRGB_D65_to_LMS_D65_trans, lms);
+
+  const float denom = (0.68990272f * lms[0] + 0.34832189f * lms[1]);
+  const float a = (denom == 0.f) ? 0.f : Y / denom;
+  for_four_channels(c, aligned(lms, LMS:16)) LMS[c] = lms[c] * a;
+}
+
+/*
+ * Yrg in polar coordinates.  The hue angle is kept as its cosine and sine
+ * so no trigonometric function is needed per pixel.
+ */
+DT_OMP_DECLARE_SIMD(aligned(Ych, Yrg: 16))
+static inline void Yrg_to_Ych(const dt_aligned_pixel_t Yrg, dt_aligned_pixel_t Ych)
+{
+  const float r = Yrg[1] - DT_YRG_D65_R;
+  const float g = Yrg[2] - DT_YRG_D65_G;
+  const float c = dt_fast_hypotf(g, r);
+  Ych[0] = Yrg[0];
+  Ych[1] = c;
+  Ych[2] = c != 0.f ? r / c : 1.f;
+  Ych[3] = c != 0.f ? g / c : 0.f;
+}
+
+DT_OMP_DECLARE_SIMD(aligned(Ych, Yrg: 16))
+static inline void Ych_to_Yrg(const dt_aligned_pixel_t Ych, dt_aligned_pixel_t Yrg)
+{
+  Yrg[0] = Ych[0];
+  Yrg[1] = Ych[1] * Ych[2] + DT_YRG_D65_R;
+  Yrg[2] = Ych[1] * Ych[3] + DT_YRG_D65_G;
+}
+
+/** Clip chroma at constant hue and luminance so Ych fits in Yrg and LMS. */
+static inline void gamut_check_Yrg(dt_aligned_pixel_t Ych)
+{
+  dt_aligned_pixel_t Yrg = { 0.f };
+  Ych_to_Yrg(Ych, Yrg);
+
+  float max_c = Ych[1];
+  const float cos_h = Ych[2];
+  const float sin_h = Ych[3];
+
+  if(Yrg[1] < 0.f)
+    max_c = fminf(-DT_YRG_D65_R / cos_h, max_c);
+  if(Yrg[2] < 0.f)
+    max_c = fminf(-DT_YRG_D65_G / sin_h, max_c);
+  if(Yrg[1] + Yrg[2] > 1.f)
+    max_c = fminf((1.f - DT_YRG_D65_R - DT_YRG_D65_G) / (cos_h + sin_h), max_c);
+
+  Ych[1] = max_c;
+}
+
+/* ── Gamut mapping in Ych (filmic rgb v6/v7) ─────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD(uniform(matrix_trans) aligned(in, out:16) aligned(matrix_trans:64))
+static inline void RGB_to_Ych(const dt_aligned_pixel_t in,
+                              const dt_colormatrix_t matrix_trans,
+                              dt_aligned_pixel_t out)
+{
+  dt_aligned_pixel_t LMS = { 0.f };
+  dt_aligned_pixel_t Yrg = { 0.f };
+  dt_apply_transposed_color_matrix(in, matrix_trans, LMS);
+  LMS_to_Yrg(LMS, Yrg);
+  Yrg_to_Ych(Yrg, out);
+}
+
+DT_OMP_DECLARE_SIMD(uniform(matrix_trans) aligned(in, out:16) aligned(matrix_trans:64))
+static inline void Ych_to_RGB(const dt_aligned_pixel_t in,
+                              const dt_colormatrix_t matrix_trans,
+                              dt_aligned_pixel_t out)
+{
+  dt_aligned_pixel_t LMS = { 0.f };
+  dt_aligned_pixel_t Yrg = { 0.f };
+  Ych_to_Yrg(in, Yrg);
+  Yrg_to_LMS(Yrg, LMS);
+  dt_apply_transposed_color_matrix(LMS, matrix_trans, out);
+}
+
+/** RGB -> LMS 2006 (input_matrix) and LMS 2006 -> RGB (output_matrix). */
+static inline void prepare_RGB_Yrg_matrices(const dt_colorspaces_rgb_space_t *const space,
+                                            dt_colormatrix_t input_matrix,
+                                            dt_colormatrix_t output_matrix)
+{
+  dt_colormatrix_mul(input_matrix, XYZ_D65_to_LMS_2006_D65, space->matrix_in);
+  dt_colormatrix_mul(output_matrix, space->matrix_out, LMS_2006_D65_to_XYZ_D65);
+}
+
+/*
+ * Chroma that brings one RGB component to target_white.  coeffs is a row
+ * of the LMS -> RGB matrix.  See darktable's
+ * tools/derive_filmic_v6_gamut_mapping.py for the derivation.
+ */
+static inline float _clip_chroma_white_raw(const float coeffs[3], const float target_white, const float Y,
+                                           const float cos_h, const float sin_h)
+{
+  const float denominator_Y_coeff = coeffs[0] * (0.979381443298969f * cos_h + 0.391752577319588f * sin_h)
+                                    + coeffs[1] * (0.0206185567010309f * cos_h + 0.608247422680412f * sin_h)
+                                    - coeffs[2] * (cos_h + sin_h);
+  const float denominator_target_term = target_white * (0.68285981628866f * cos_h + 0.482137060515464f * sin_h);
+
+  /* this channel won't limit the chroma */
+  if(denominator_Y_coeff == 0.f) return FLT_MAX;
+
+  /* below the asymptote the upper bound is meaningless */
+  const float Y_asymptote = denominator_target_term / denominator_Y_coeff;
+  if(Y <= Y_asymptote) return FLT_MAX;
+
+  const float denominator = Y * denominator_Y_coeff - denominator_target_term;
+  const float numerator = -0.427506877216495f
+                          * (Y * (coeffs[0] + 0.856492345150334f * coeffs[1] + 0.554995960637719f * coeffs[2])
+                             - 0.988237752433297f * target_white);
+  return numerator / denominator;
+}
+
+static inline float _clip_chroma_white(const float coeffs[3], const float target_white, const float Y,
+                                       const float cos_h, const float sin_h)
+{
+  /* interpolate each clipping line to zero chroma near max luminance */
+  const float eps = 1e-3f;
+  const float max_Y = CIE_Y_1931_to_CIE_Y_2006(target_white);
+  const float delta_Y = MAX(max_Y - Y, 0.f);
+  float max_chroma;
+  if(delta_Y < eps)
+    max_chroma = delta_Y / (eps * max_Y)
+                 * _clip_chroma_white_raw(coeffs, target_white, (1.f - eps) * max_Y, cos_h, sin_h);
+  else
+    max_chroma = _clip_chroma_white_raw(coeffs, target_white, Y, cos_h, sin_h);
+  return max_chroma >= 0.f ? max_chroma : FLT_MAX;
+}
+
+static inline float _clip_chroma_black(const float coeffs[3], const float cos_h, const float sin_h)
+{
+  const float denominator = coeffs[0] * (0.979381443298969f * cos_h + 0.391752577319588f * sin_h)
+                            + coeffs[1] * (0.0206185567010309f * cos_h + 0.608247422680412f * sin_h)
+                            - coeffs[2] * (cos_h + sin_h);
+  if(denominator == 0.f) return FLT_MAX;
+
+  const float numerator = -0.427506877216495f
+                          * (coeffs[0] + 0.856492345150334f * coeffs[1] + 0.554995960637719f * coeffs[2]);
+  const float max_chroma = numerator / denominator;
+  return max_chroma >= 0.f ? max_chroma : FLT_MAX;
+}
+
+/** Largest chroma at (Y, hue) that keeps every RGB channel in [0, target_white]. */
+static inline float Ych_max_chroma(const dt_colormatrix_t matrix_out, const float target_white, const float Y,
+                                   const float cos_h, const float sin_h)
+{
+  const float chroma_R_white = _clip_chroma_white(matrix_out[0], target_white, Y, cos_h, sin_h);
+  const float chroma_G_white = _clip_chroma_white(matrix_out[1], target_white, Y, cos_h, sin_h);
+  const float chroma_B_white = _clip_chroma_white(matrix_out[2], target_white, Y, cos_h, sin_h);
+  const float max_chroma_white = MIN(MIN(chroma_R_white, chroma_G_white), chroma_B_white);
+
+  const float chroma_R_black = _clip_chroma_black(matrix_out[0], cos_h, sin_h);
+  const float chroma_G_black = _clip_chroma_black(matrix_out[1], cos_h, sin_h);
+  const float chroma_B_black = _clip_chroma_black(matrix_out[2], cos_h, sin_h);
+  const float max_chroma_black = MIN(MIN(chroma_R_black, chroma_G_black), chroma_B_black);
+
+  return MIN(max_chroma_black, max_chroma_white);
+}
+
+/* ── CIE xyY and u'v'Y ────────────────────────────────────────────────────── */
+
+/* D65 white, CIE 1931 2° */
+#define DT_D65_x 0.31271f
+#define DT_D65_y 0.32902f
+
+DT_OMP_DECLARE_SIMD(aligned(xyY, XYZ:16))
+static inline void dt_xyY_to_XYZ(const dt_aligned_pixel_t xyY, dt_aligned_pixel_t XYZ)
+{
+  const int bad = xyY[1] == 0.0f;
+  XYZ[0] = bad ? 0.0f : xyY[2] * xyY[0] / xyY[1];
+  XYZ[1] = bad ? 0.0f : xyY[2];
+  XYZ[2] = bad ? 0.0f : xyY[2] * (1.f - xyY[0] - xyY[1]) / xyY[1];
+}
+
+/* linear part of CIE L*u*v*, used for hue-preserving gamut mapping */
+DT_OMP_DECLARE_SIMD(aligned(xyY, uvY:16))
+static inline void dt_xyY_to_uvY(const dt_aligned_pixel_t xyY, dt_aligned_pixel_t uvY)
+{
+  const float denominator = -2.f * xyY[0] + 12.f * xyY[1] + 3.f;
+  uvY[0] = 4.f * xyY[0] / denominator;
+  uvY[1] = 9.f * xyY[1] / denominator;
+  uvY[2] = xyY[2];
+}
+
+DT_OMP_DECLARE_SIMD(aligned(xyY, uvY:16))
+static inline void dt_uvY_to_xyY(const dt_aligned_pixel_t uvY, dt_aligned_pixel_t xyY)
+{
+  const float denominator = 6.0f * uvY[0] - 16.f * uvY[1] + 12.0f;
+  xyY[0] = 9.f * uvY[0] / denominator;
+  xyY[1] = 4.f * uvY[1] / denominator;
+  xyY[2] = uvY[2];
+}
+
+#ifdef __cplusplus
+}
+#endif
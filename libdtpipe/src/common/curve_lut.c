@@ -0,0 +1,38 @@
+/*
+ * curve_lut.c - Log-domain lookup tables for 1-D tone curves
+ *
+ * See curve_lut.h for the table layout.
+ */
+
+#include "common/curve_lut.h"
+
+#include <math.h>
+
+void dt_curve_lut_init(dt_curve_lut_t *lut,
+                       const int lo_exp,
+                       const int hi_exp,
+                       dt_curve_lut_func_t fn,
+                       const void *data)
+{
+  int lo = lo_exp;
+  int hi = hi_exp > lo_exp ? hi_exp : lo_exp + 1;
+  if(hi - lo > DT_CURVE_LUT_MAX_OCTAVES) lo = hi - DT_CURVE_LUT_MAX_OCTAVES;
+
+  lut->lo = ldexpf(1.0f, lo);
+  lut->hi = ldexpf(1.0f, hi);
+  memcpy(&lut->lo_bits, &lut->lo, sizeof(lut->lo_bits));
+  lut->n = (uint32_t)(hi - lo) * DT_CURVE_LUT_STEPS + 1;
+
+  /* node i sits at 2^(lo + i / STEPS) with the mantissa stepped linearly,
+   * i.e. exactly at the bit pattern lo_bits + (i << SHIFT) */
+  for(uint32_t i = 0; i < lut->n; i++)
+  {
+    const uint32_t bits = lut->lo_bits + (i << DT_CURVE_LUT_SHIFT);
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    lut->y[i] = fn(x, data);
+  }
+
+  lut->y_zero = fn(0.0f, data);
+  lut->lo_slope = (lut->y[0] - lut->y_zero) / lut->lo;
+}
@@ -0,0 +1,95 @@
+/*
+ * curve_lut.h - Log-domain lookup tables for 1-D tone curves
+ *
+ * The scene-referred tone mappers (sigmoid, filmic rgb, AgX) spend most of
+ * their per-pixel time in log2f/powf evaluating a smooth curve of one
+ * variable.  A dt_curve_lut_t samples such a curve once, in commit_params,
+ * at DT_CURVE_LUT_STEPS points per octave of input, and process() replaces
+ * the transcendental calls by one table lerp.
+ *
+ * The table is indexed straight from the IEEE-754 bit pattern of the input:
+ * above the exponent, the top DT_CURVE_LUT_BITS mantissa bits select the
+ * segment and the remaining bits are the (exact, linear in x) position
+ * inside it.  No log is computed.  Nodes are 2^-7 of an octave apart, so
+ * the lerp error on the curves used here stays below 1e-4 relative.
+ *
+ * The table lives inside the module's piece->data, is written only by
+ * commit_params() and is read-only while the pipe runs, so all OpenMP
+ * threads share it without locking.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DT_CURVE_LUT_BITS 7                          /* mantissa bits used as index  */
+#define DT_CURVE_LUT_STEPS (1 << DT_CURVE_LUT_BITS)  /* segments per octave          */
+#define DT_CURVE_LUT_SHIFT (23 - DT_CURVE_LUT_BITS)
+#define DT_CURVE_LUT_MAX_OCTAVES 48
+#define DT_CURVE_LUT_MAX_SIZE (DT_CURVE_LUT_MAX_OCTAVES * DT_CURVE_LUT_STEPS + 1)
+
+/** Curve to tabulate: y = fn(x, data), evaluated for x >= 0. */
+typedef float (*dt_curve_lut_func_t)(float x, const void *data);
+
+typedef struct dt_curve_lut_t
+{
+  float lo;            /* 2^lo_exp, first node                          */
+  float hi;            /* 2^hi_exp, last node (inputs above are clamped) */
+  uint32_t lo_bits;    /* bit pattern of lo                             */
+  uint32_t n;          /* number of nodes                               */
+  float y_zero;        /* fn(0): below lo the curve is lerped to this   */
+  float lo_slope;      /* (y[0] - y_zero) / lo                          */
+  float y[DT_CURVE_LUT_MAX_SIZE] DT_ALIGNED_ARRAY;
+} dt_curve_lut_t;
+
+/**
+ * Sample fn over [2^lo_exp, 2^hi_exp].  The span is clamped to
+ * DT_CURVE_LUT_MAX_OCTAVES.  Called from commit_params().
+ */
+void dt_curve_lut_init(dt_curve_lut_t *lut,
+                       const int lo_exp,
+                       const int hi_exp,
+                       dt_curve_lut_func_t fn,
+                       const void *data);
+
+/**
+ * Evaluate the table at x.  Negative inputs and NaN map to fn(0); inputs
+ * above hi return fn(hi).
+ */
+DT_OMP_DECLARE_SIMD(uniform(lut))
+static inline float dt_curve_lut_eval(const dt_curve_lut_t *const lut, const float x)
+{
+  if(!(x > lut->lo))
+    return lut->y_zero + (x > 0.0f ? x : 0.0f) * lut->lo_slope;
+  if(x >= lut->hi)
+    return lut->y[lut->n - 1];
+
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  const uint32_t off = bits - lut->lo_bits;
+  const uint32_t i = off >> DT_CURVE_LUT_SHIFT;
+  const float t = (float)(off & ((1u << DT_CURVE_LUT_SHIFT) - 1u)) * (1.0f / (float)(1u << DT_CURVE_LUT_SHIFT));
+  return lut->y[i] + t * (lut->y[i + 1] - lut->y[i]);
+}
+
+/** Evaluate the table on the three colour channels of a pixel. */
+DT_OMP_DECLARE_SIMD(uniform(lut) aligned(in, out:16))
+static inline void dt_curve_lut_eval_rgb(const dt_curve_lut_t *const lut,
+                                         const dt_aligned_pixel_t in,
+                                         dt_aligned_pixel_t out)
+{
+  out[0] = dt_curve_lut_eval(lut, in[0]);
+  out[1] = dt_curve_lut_eval(lut, in[1]);
+  out[2] = dt_curve_lut_eval(lut, in[2]);
+}
+
+#ifdef __cplusplus
+}
+#endif
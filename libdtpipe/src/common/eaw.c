@@ -0,0 +1,214 @@
+/*
+ * eaw.c - Edge-aware à-trous wavelet decomposition for denoising
+ *
+ * See eaw.h.
+ */
+
+#include "common/eaw.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+
+// to make the processing of each pass (in which the output of one
+// row depends on multiple rows from the input) as cache-friendly as
+// possible, interleave the rows such that the next iteration
+// processes the row 'stride' pixels below the current one, which will
+// already be in L2 cache (if not L1): with a stride of 16, process
+// rows 0, 16, 32, ..., then 1, 17, 33, ..., etc.
+static inline int dwt_interleave_rows(const int rowid, const int height, const int stride)
+{
+  if (height <= stride)
+    return rowid;
+  const int per_pass = ((height + stride - 1) / stride);
+  const int long_passes = height % stride;
+  // adjust for the fact that we have some passes with one fewer iteration when height is not a multiple of stride
+  if (long_passes == 0 || rowid < long_passes * per_pass)
+    return (rowid / per_pass) + stride * (rowid % per_pass);
+  const int rowid2 = rowid - long_passes * per_pass;
+  return long_passes + (rowid2 / (per_pass-1)) + stride * (rowid2 % (per_pass-1));
+}
+
+static inline void accumulate(dt_aligned_pixel_t accum,
+                              const dt_aligned_pixel_t detail,
+                              const dt_aligned_pixel_t thresh,
+                              const dt_aligned_pixel_t boostval)
+{
+  // decrease the absolute magnitude of the detail by the threshold,
+  // then add the result to the accumulator; copysignf does not
+  // vectorize, but it turns out that just adding up two clamped
+  // alternatives gives exactly the same result and DOES vectorize
+  //    const float absamt = fmaxf(0.0f, (fabsf(detail[k + c]) - threshold[c]));
+  //    const float amount = copysignf(absamt, detail[k + c]);
+  // the below code is the vectorization of
+  //   amount = MAX(detail - thresh, 0.0f) + MIN(detail + thresh, 0.0f);
+  dt_aligned_pixel_t amount;
+  for_four_channels(c, aligned(amount, detail, thresh))
+    amount[c] = fminf(detail[c] + thresh[c], 0.0f) + fmaxf(detail[c] - thresh[c], 0.0f);
+
+  for_four_channels(c,aligned(accum,detail,thresh,boostval))
+  {
+    accum[c] += (boostval[c] * amount[c]);
+  }
+}
+
+void eaw_synthesize(float *const out, const float *const in, const float *const restrict detail,
+                    const float *const restrict threshold, const float *const restrict boost,
+                    const int32_t width, const int32_t height)
+{
+  const dt_aligned_pixel_t thresh = { threshold[0], threshold[1], threshold[2], threshold[3] };
+  const dt_aligned_pixel_t boostval = { boost[0], boost[1], boost[2], boost[3] };
+  const size_t npixels = (size_t)width * height;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+  {
+    accumulate(out + 4*k, detail + 4*k, thresh, boostval);
+  }
+  dt_omploop_sfence();
+}
+
+static inline float dn_weight(const float *c1, const float *c2, const float inv_sigma2)
+{
+  // 3d distance based on color
+  dt_aligned_pixel_t sqr;
+  for_each_channel(c)
+  {
+    const float diff = c1[c] - c2[c];
+    sqr[c] = diff * diff;
+  }
+  const float dot = (sqr[0] + sqr[1] + sqr[2]) * inv_sigma2;
+  const float var
+      = 0.02f; // FIXME: this should ideally depend on the image before noise stabilizing transforms!
+  const float off2 = 9.0f; // (3 sigma)^2
+  return fast_mexp2f(MAX(0, dot * var - off2));
+}
+
+#define SUM_PIXEL_PROLOGUE                                                                                   \
+  dt_aligned_pixel_t sum = { 0.0f, 0.0f, 0.0f, 0.0f };                                                       \
+  dt_aligned_pixel_t wgt = { 0.0f, 0.0f, 0.0f, 0.0f };							     \
+  size_t filter_idx = 0;
+
+#define SUM_PIXEL_CONTRIBUTION	 		                                                             \
+  do                                                                                                         \
+  {                                                                                                          \
+    const float f = filter[filter_idx++];                                                                    \
+    const float wp = dn_weight(px, px2, inv_sigma2);                                                         \
+    const float w = f * wp;                                                                                  \
+    for_each_channel(c,aligned(px2))                                                                         \
+    {                                                                                                        \
+      wgt[c] += w;                                                                                           \
+      sum[c] += w * px2[c];                                                                                  \
+    }                                                                                                        \
+  } while(0)
+
+#define SUM_PIXEL_EPILOGUE                                                                                   \
+  dt_aligned_pixel_t det;									             \
+  for_each_channel(c)      										     \
+  {													     \
+    sum[c] /= wgt[c];                                                   				     \
+    pcoarse[c] = sum[c];                                                                                     \
+    det[c] = (px[c] - sum[c]);									             \
+    sum_sq[c] += (det[c]*det[c]);					                                     \
+  }                                                                       				     \
+  copy_pixel_nontemporal(pdetail, det);                                                                      \
+  px += 4;                                                                                                   \
+  pdetail += 4;                                                                                              \
+  pcoarse += 4;
+
+void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                      dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                      const int32_t width, const int32_t height)
+{
+  const int mult = 1u << scale;
+  static const float filter[25] =
+    {
+      1.0f / 256.0f,  4.0f / 256.0f,  6.0f / 256.0f,  4.0f / 256.0f, 1.0f / 256.0f,
+      4.0f / 256.0f, 16.0f / 256.0f, 24.0f / 256.0f, 16.0f / 256.0f, 4.0f / 256.0f,
+      6.0f / 256.0f, 24.0f / 256.0f, 36.0f / 256.0f, 24.0f / 256.0f, 6.0f / 256.0f,
+      4.0f / 256.0f, 16.0f / 256.0f, 24.0f / 256.0f, 16.0f / 256.0f, 4.0f / 256.0f,
+      1.0f / 256.0f,  4.0f / 256.0f,  6.0f / 256.0f,  4.0f / 256.0f, 1.0f / 256.0f
+    };
+  const int boundary = 2 * mult;
+
+  dt_aligned_pixel_t sum_sq = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+#if !(defined(__apple_build_version__) && __apple_build_version__ < 11030000) //makes Xcode 11.3.1 compiler crash
+  DT_OMP_FOR(reduction(+: sum_sq[0:4]))
+#endif
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    const size_t j = dwt_interleave_rows(rowid, height, mult);
+    const float *px = ((float *)in) + (size_t)4 * j * width;
+    const float *px2;
+    float *pdetail = detail + (size_t)4 * j * width;
+    float *pcoarse = out + (size_t)4 * j * width;
+
+    // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
+    //   for the central bulk, we only need to use those slower versions on the leftmost and rightmost pixels
+    const int lbound = (j < boundary || j >= height - boundary) ? width-boundary : boundary;
+
+    /* The first "2*mult" pixels need a boundary check because we might try to access past the left edge,
+     * which requires nearest pixel interpolation */
+    int i;
+    for(i = 0; i < lbound; i++)
+    {
+      SUM_PIXEL_PROLOGUE;
+      for(int jj = 0; jj < 5; jj++)
+      {
+        const int y = j + mult * (jj-2);
+        const int clamp_y = CLAMP(y,0,height-1);
+        for(int ii = 0; ii < 5; ii++)
+        {
+          int x = i + mult * ((ii)-2);
+          if(x < 0) x = 0;			// we might be looking past the left edge
+          px2 = ((float *)in) + 4 * x + (size_t)4 * clamp_y * width;
+          SUM_PIXEL_CONTRIBUTION;
+        }
+      }
+      SUM_PIXEL_EPILOGUE;
+    }
+
+    /* For pixels [2*mult, width-2*mult], we don't need to do any boundary checks */
+    for( ; i < width - boundary; i++)
+    {
+      SUM_PIXEL_PROLOGUE;
+      px2 = ((float *)in) + (size_t)4 * (i - 2 * mult + (size_t)(j - 2 * mult) * width);
+      for(int jj = 0; jj < 5; jj++)
+      {
+        for(int ii = 0; ii < 5; ii++)
+        {
+          SUM_PIXEL_CONTRIBUTION;
+          px2 += (size_t)4 * mult;
+        }
+        px2 += (size_t)4 * (width - 5) * mult;
+      }
+      SUM_PIXEL_EPILOGUE;
+    }
+
+    /* Last 2*mult pixels in the row require the boundary check again */
+    for( ; i < width; i++)
+    {
+      SUM_PIXEL_PROLOGUE;
+      for(int jj = 0; jj < 5; jj++)
+      {
+        const int y = j + mult * (jj-2);
+        const int clamp_y = CLAMP(y,0,height-1);
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const int x = i + mult * ((ii)-2);
+          // ensure that we don't look past either edge (left edge is possible at higher scales on small images)
+          const int clamp_x = CLAMP(x, 0, width-1);
+          px2 = ((float *)in) + 4 * clamp_x + (size_t)4 * clamp_y * width;
+          SUM_PIXEL_CONTRIBUTION;
+        }
+      }
+      SUM_PIXEL_EPILOGUE;
+    }
+  }
+  for_each_channel(c)
+    sum_squared[c] = sum_sq[c];
+}
+
+#undef SUM_PIXEL_PROLOGUE
+#undef SUM_PIXEL_CONTRIBUTION
+#undef SUM_PIXEL_EPILOGUE
@@ -0,0 +1,50 @@
+/*
+ * eaw.h - Edge-aware à-trous wavelet decomposition for denoising
+ *
+ * Ported from darktable src/common/eaw.c
+ * Copyright (C) 2017-2024 darktable developers.
+ *
+ * Only the denoiseprofile pair is kept: eaw_dn_decompose() splits one
+ * scale off an RGBA float image and eaw_synthesize() adds a thresholded,
+ * boosted detail layer back.  The equalizer variant
+ * (eaw_decompose_and_synthesize) is not ported.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void((*eaw_dn_decompose_t)(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                                   dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                                   const int32_t width, const int32_t height));
+
+typedef void((*eaw_synthesize_t)(float *const out, const float *const in, const float *const restrict detail,
+                                 const float *const restrict thrsf, const float *const restrict boostf,
+                                 const int32_t width, const int32_t height));
+
+/**
+ * One level of the edge-avoiding 5x5 à-trous transform at spacing
+ * 2^scale: writes the coarse image to `out`, the detail to `detail`, and
+ * the per-channel sum of squared detail to `sum_squared`.
+ */
+void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                      dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                      const int32_t width, const int32_t height);
+
+/**
+ * out += boost * soft_threshold(detail, threshold), per channel.  `out`
+ * and `in` may alias (the accumulator is updated in place).
+ */
+void eaw_synthesize(float *const out, const float *const in, const float *const restrict detail,
+                    const float *const restrict thrsf, const float *const restrict boostf,
+                    const int32_t width, const int32_t height);
+
+#ifdef __cplusplus
+}
+#endif
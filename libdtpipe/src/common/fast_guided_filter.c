@@ -0,0 +1,749 @@
+/*
+ * fast_guided_filter.c - Fast guided filter and EIGF surface blur on grey images
+ *
+ * See fast_guided_filter.h.
+ */
+
+#include "common/fast_guided_filter.h"
+#include "common/gaussian.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_FLOAT exp2f(-16.0f)
+
+// columns of floats the vertical box pass runs side by side
+#define BOX_VECT 16
+
+/***
+ * DOCUMENTATION
+ *
+ * Fast Iterative Guided filter for surface blur
+ *
+ * The guiding and the guided image are the same, which makes the guided
+ * filter an edge-aware surface blur.  Since the guided filter is a linear
+ * application, the guide is downscaled by a factor of 4 with a bilinear
+ * interpolation, the guidance is computed at this scale, and the blending
+ * coefficients are upscaled back to the original size.
+ *
+ *  - mask quantization : posterize the guiding image in log2 space to help
+ *    the guiding produce smoother areas,
+ *  - blending : regular (linear) blending of the a and b parameters after
+ *    the variance analysis (by-the-book guided filter), or geometric mean of
+ *    the filter output and the original image,
+ *  - iterations : apply the guided filtering recursively to diffuse the
+ *    filter and soften edges transitions.
+ *
+ * The EIGF (exposure-independent guided filter) replaces the variance by
+ * variance / pixel², so exposure changes before and after the filter
+ * commute with it, uses gaussian instead of box windows and drops the final
+ * averaging of a and b, which creates halos around bright pixels.
+ *
+ * Reference :
+ *  Kaiming He, Jian Sun, Microsoft : https://arxiv.org/abs/1505.00996
+ **/
+
+/* ── Pointwise helpers ───────────────────────────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD()
+static inline float _quantize(const float value,
+                              const float sampling,
+                              const float clip_min,
+                              const float clip_max)
+{
+  // Quantize in exposure levels evenly spaced in log by sampling
+  if(sampling == 0.0f)
+    return value;
+  else if(sampling == 1.0f)
+    return fmaxf(fminf(exp2f(floorf(log2f(value))), clip_max), clip_min);
+  else
+    return fmaxf(fminf(exp2f(floorf(log2f(value) / sampling) * sampling), clip_max), clip_min);
+}
+
+DT_OMP_DECLARE_SIMD()
+static inline float _guided_blend(const float image,
+                                  const float a,
+                                  const float b,
+                                  const dt_iop_guided_filter_blending_t filter)
+{
+  // Note : image is positive at the outside of the luminance mask
+  const float linear = fmaxf(image * a + b, MIN_FLOAT);
+  return filter == DT_GF_BLENDING_LINEAR ? linear : sqrtf(image * linear);
+}
+
+DT_OMP_DECLARE_SIMD()
+static inline float _eigf_blend(const float image,
+                                const float mask,
+                                const float *const av,
+                                const dt_iop_guided_filter_blending_t filter,
+                                const float feathering)
+{
+  const float avg_g = av[0];
+  const float var_g = av[1];
+  const float avg_m = av[2];
+  const float covar_mg = av[3];
+  const float norm_g = fmaxf(avg_g * image, 1E-6);
+  const float norm_m = fmaxf(avg_m * mask, 1E-6);
+  const float normalized_var_guide = var_g / norm_g;
+  const float normalized_covar = covar_mg / sqrtf(norm_g * norm_m);
+  const float a = normalized_covar / (normalized_var_guide + feathering);
+  const float b = avg_m - a * avg_g;
+  const float linear = fmaxf(image * a + b, MIN_FLOAT);
+  return filter == DT_GF_BLENDING_LINEAR ? linear : sqrtf(image * linear);
+}
+
+// same as above, but specialized for the case where guide == mask
+DT_OMP_DECLARE_SIMD()
+static inline float _eigf_blend_no_mask(const float image,
+                                        const float *const av,
+                                        const dt_iop_guided_filter_blending_t filter,
+                                        const float feathering)
+{
+  const float avg_g = av[0];
+  const float var_g = av[1];
+  const float norm_g = fmaxf(avg_g * image, 1E-6);
+  const float normalized_var_guide = var_g / norm_g;
+  const float a = normalized_var_guide / (normalized_var_guide + feathering);
+  const float b = avg_g - a * avg_g;
+  const float linear = fmaxf(image * a + b, MIN_FLOAT);
+  return filter == DT_GF_BLENDING_LINEAR ? linear : sqrtf(image * linear);
+}
+
+/* ── Bilinear taps ───────────────────────────────────────────────────────── */
+/*
+ * Sample positions of darktable's interpolate_bilinear(): output index i
+ * maps to i / n_out * n_in, the two neighbours are clamped to the input
+ * and weighted by their distance to the unclamped position.  idx[2i] and
+ * idx[2i+1] are the previous and next neighbour, w[2i] and w[2i+1] their
+ * weights.
+ */
+
+static inline void _bilinear_tap(const size_t i,
+                                 const size_t n_out,
+                                 const size_t n_in,
+                                 int *const idx,
+                                 float *const w)
+{
+  const float x_in = ((float)i / (float)n_out) * (float)n_in;
+  size_t prev = (size_t)floorf(x_in);
+  size_t next = prev + 1;
+  prev = (prev < n_in) ? prev : n_in - 1;
+  next = (next < n_in) ? next : n_in - 1;
+  const float d_next = (float)next - x_in;
+  idx[0] = (int)prev;
+  idx[1] = (int)next;
+  w[0] = d_next;        // weight of prev
+  w[1] = 1.0f - d_next; // weight of next
+}
+
+/* ── Box mean ────────────────────────────────────────────────────────────── */
+/*
+ * Port of dt_box_mean() (src/common/box_filters.cc) for one iteration on
+ * 2 or 4 channels: a running sum over a 2*radius+1 window, normalised by
+ * the number of pixels actually in the window at the borders.
+ */
+
+static void _box_mean_horizontal(float *const restrict buf,
+                                 const size_t width,
+                                 const size_t ch,
+                                 const size_t radius,
+                                 float *const restrict scratch)
+{
+  float DT_ALIGNED_ARRAY L[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  size_t hits = 0;
+  // add up the left half of the window
+  for(size_t x = 0; x < MIN(radius, width); x++)
+  {
+    hits++;
+    for(size_t c = 0; c < ch; c++)
+    {
+      scratch[ch * x + c] = buf[ch * x + c];
+      L[c] += buf[ch * x + c];
+    }
+  }
+  // process the blur up to the point where we start removing values from the moving average
+  size_t x;
+  for(x = 0; (x <= radius) && ((x + radius) < width); x++)
+  {
+    const size_t np = x + radius;
+    hits++;
+    for(size_t c = 0; c < ch; c++)
+    {
+      scratch[ch * np + c] = buf[ch * np + c];
+      L[c] += buf[ch * np + c];
+      buf[ch * x + c] = L[c] / hits;
+    }
+  }
+  // radius > width/2: pixels for which we can neither add nor remove values
+  for(; x <= radius && x < width; x++)
+    for(size_t c = 0; c < ch; c++)
+      buf[ch * x + c] = L[c] / hits;
+  // process the blur for the bulk of the scan line
+  for(; x + radius < width; x++)
+  {
+    const size_t op = x - radius - 1;
+    const size_t np = x + radius;
+    for(size_t c = 0; c < ch; c++)
+    {
+      L[c] -= scratch[ch * op + c];
+      scratch[ch * np + c] = buf[ch * np + c];
+      L[c] += buf[ch * np + c];
+      buf[ch * x + c] = L[c] / hits;
+    }
+  }
+  // process the right end where we have no more values to add to the running sum
+  for(; x < width; x++)
+  {
+    const size_t op = x - radius - 1;
+    hits--;
+    for(size_t c = 0; c < ch; c++)
+    {
+      L[c] -= scratch[ch * op + c];
+      buf[ch * x + c] = L[c] / hits;
+    }
+  }
+}
+
+// n <= BOX_VECT adjacent float columns of a buffer with `stride` floats per row.
+// The scratch space is a circular buffer of mask + 1 rows.
+static void _box_mean_vertical(float *const restrict buf,
+                               const size_t height,
+                               const size_t stride,
+                               const size_t n,
+                               const size_t radius,
+                               float *const restrict scratch)
+{
+  size_t mask = 1;
+  for(size_t r = (2 * radius + 1); r > 1; r >>= 1) mask = (mask << 1) | 1;
+
+  float DT_ALIGNED_ARRAY L[BOX_VECT] = { 0.0f };
+  size_t hits = 0;
+  // add up the top half of the window
+  for(size_t y = 0; y < MIN(radius, height); y++)
+  {
+    hits++;
+    float *const restrict s = scratch + BOX_VECT * (y & mask);
+    for(size_t c = 0; c < n; c++)
+    {
+      s[c] = buf[y * stride + c];
+      L[c] += s[c];
+    }
+  }
+  size_t y;
+  for(y = 0; y <= radius && y + radius < height; y++)
+  {
+    const size_t np = y + radius;
+    hits++;
+    float *const restrict s = scratch + BOX_VECT * (np & mask);
+    for(size_t c = 0; c < n; c++)
+    {
+      s[c] = buf[np * stride + c];
+      L[c] += s[c];
+      buf[y * stride + c] = L[c] / hits;
+    }
+  }
+  for(; y <= radius && y < height; y++)
+    for(size_t c = 0; c < n; c++)
+      buf[y * stride + c] = L[c] / hits;
+  for(; y + radius < height; y++)
+  {
+    const size_t np = y + radius;
+    const size_t op = y - radius - 1;
+    const float *const restrict so = scratch + BOX_VECT * (op & mask);
+    float *const restrict sn = scratch + BOX_VECT * (np & mask);
+    for(size_t c = 0; c < n; c++)
+    {
+      L[c] -= so[c];
+      sn[c] = buf[np * stride + c];
+      L[c] += sn[c];
+      buf[y * stride + c] = L[c] / hits;
+    }
+  }
+  for(; y < height; y++)
+  {
+    const size_t op = y - radius - 1;
+    hits--;
+    const float *const restrict so = scratch + BOX_VECT * (op & mask);
+    for(size_t c = 0; c < n; c++)
+    {
+      L[c] -= so[c];
+      buf[y * stride + c] = L[c] / hits;
+    }
+  }
+}
+
+static gboolean _box_mean(float *const buf,
+                          const size_t height,
+                          const size_t width,
+                          const size_t ch,
+                          const size_t radius)
+{
+  size_t window = 2;
+  for(size_t r = (2 * radius + 1); r > 1; r >>= 1) window <<= 1;
+  window = MIN(window, height);
+
+  size_t padded_size;
+  float *const scanlines
+      = dt_alloc_perthread_float(MAX(ch * width, BOX_VECT * window), &padded_size);
+  if(!scanlines) return FALSE;
+
+  DT_OMP_FOR()
+  for(size_t row = 0; row < height; row++)
+  {
+    float *const restrict scratch = dt_get_perthread(scanlines, padded_size);
+    _box_mean_horizontal(buf + row * ch * width, width, ch, radius, scratch);
+  }
+
+  const size_t stride = ch * width;
+  DT_OMP_FOR()
+  for(size_t x = 0; x < stride; x += BOX_VECT)
+  {
+    float *const restrict scratch = dt_get_perthread(scanlines, padded_size);
+    _box_mean_vertical(buf + x, height, stride, MIN(BOX_VECT, stride - x), radius, scratch);
+  }
+
+  dt_free_align(scanlines);
+  return TRUE;
+}
+
+/* ── Variance analysis ───────────────────────────────────────────────────── */
+
+// guided filter: a and b of the linear model mask = a * guide + b, box-averaged
+static gboolean _variance_analyse(const float *const restrict guide, // I
+                                  const float *const restrict mask,  // p
+                                  float *const restrict ab,
+                                  const size_t width,
+                                  const size_t height,
+                                  const int radius,
+                                  const float feathering)
+{
+  const size_t Ndim = width * height;
+
+  // input is array of struct : { { guide , mask, guide * guide, guide * mask } }
+  float *const restrict input = dt_alloc_align_float(Ndim * 4);
+  if(!input) return FALSE;
+
+  DT_OMP_FOR_SIMD()
+  for(size_t k = 0; k < Ndim; k++)
+  {
+    const size_t index = k * 4;
+    input[index] = guide[k];
+    input[index + 1] = mask[k];
+    input[index + 2] = guide[k] * guide[k];
+    input[index + 3] = guide[k] * mask[k];
+  }
+
+  // blur the guide and mask as a four-channel image to exploit data locality and SIMD
+  gboolean ok = _box_mean(input, height, width, 4, radius);
+
+  DT_OMP_FOR()
+  for(size_t idx = 0; idx < Ndim; idx++)
+  {
+    const float d = fmaxf((input[4*idx+2] - input[4*idx+0] * input[4*idx+0]) + feathering, 1e-15f); // avoid division by 0.
+    const float a = (input[4*idx+3] - input[4*idx+0] * input[4*idx+1]) / d;
+    const float b = input[4*idx+1] - a * input[4*idx+0];
+    ab[2*idx] = a;
+    ab[2*idx+1] = b;
+  }
+
+  // average a and b over the window as well
+  if(ok) ok = _box_mean(ab, height, width, 2, radius);
+
+  dt_free_align(input);
+  return ok;
+}
+
+/* EIGF: average and variance of guide and mask, out has 4 channels:
+ * - average of guide
+ * - variance of guide
+ * - average of mask
+ * - covariance of mask and guide
+ * or, without a mask, the first two only. */
+static gboolean _eigf_variance_analysis(const float *const restrict guide, // I
+                                        const float *const restrict mask,  // p, may be NULL
+                                        float *const restrict out,
+                                        const size_t width,
+                                        const size_t height,
+                                        const float sigma)
+{
+  const size_t Ndim = width * height;
+  const int ch = mask ? 4 : 2;
+  float *const restrict in = dt_alloc_align_float(Ndim * ch);
+  if(!in) return FALSE;
+
+  float ming = 10000000.0f;
+  float maxg = 0.0f;
+  float minm = 10000000.0f;
+  float maxm = 0.0f;
+  float ming2 = 10000000.0f;
+  float maxg2 = 0.0f;
+  float minmg = 10000000.0f;
+  float maxmg = 0.0f;
+  if(mask)
+  {
+    DT_OMP_FOR(reduction(max:maxg, maxm, maxg2, maxmg) reduction(min:ming, minm, ming2, minmg))
+    for(size_t k = 0; k < Ndim; k++)
+    {
+      const float pixelg = guide[k];
+      const float pixelm = mask[k];
+      const float pixelg2 = pixelg * pixelg;
+      const float pixelmg = pixelm * pixelg;
+      in[k * 4] = pixelg;
+      in[k * 4 + 1] = pixelg2;
+      in[k * 4 + 2] = pixelm;
+      in[k * 4 + 3] = pixelmg;
+      ming = MIN(ming, pixelg);
+      maxg = MAX(maxg, pixelg);
+      minm = MIN(minm, pixelm);
+      maxm = MAX(maxm, pixelm);
+      ming2 = MIN(ming2, pixelg2);
+      maxg2 = MAX(maxg2, pixelg2);
+      minmg = MIN(minmg, pixelmg);
+      maxmg = MAX(maxmg, pixelmg);
+    }
+  }
+  else
+  {
+    DT_OMP_FOR(reduction(max:maxg, maxg2) reduction(min:ming, ming2))
+    for(size_t k = 0; k < Ndim; k++)
+    {
+      const float pixelg = guide[k];
+      const float pixelg2 = pixelg * pixelg;
+      in[2 * k] = pixelg;
+      in[2 * k + 1] = pixelg2;
+      ming = MIN(ming, pixelg);
+      maxg = MAX(maxg, pixelg);
+      ming2 = MIN(ming2, pixelg2);
+      maxg2 = MAX(maxg2, pixelg2);
+    }
+  }
+
+  // gaussian windows instead of the square windows of the guided filter
+  const dt_aligned_pixel_t max = { maxg, maxg2, maxm, maxmg };
+  const dt_aligned_pixel_t min = { ming, ming2, minm, minmg };
+  dt_gaussian_t *g = dt_gaussian_init(width, height, ch, max, min, sigma, 0);
+  if(!g)
+  {
+    dt_free_align(in);
+    return FALSE;
+  }
+  if(mask)
+    dt_gaussian_blur_4c(g, in, out);
+  else
+    dt_gaussian_blur(g, in, out);
+  dt_gaussian_free(g);
+
+  if(mask)
+  {
+    DT_OMP_FOR_SIMD(aligned(out:64))
+    for(size_t k = 0; k < Ndim; k++)
+    {
+      out[4 * k + 1] -= out[4 * k] * out[4 * k];
+      out[4 * k + 3] -= out[4 * k] * out[4 * k + 2];
+    }
+  }
+  else
+  {
+    DT_OMP_FOR_SIMD(aligned(out:64))
+    for(size_t k = 0; k < Ndim; k++)
+    {
+      const float avg = out[2 * k];
+      out[2 * k + 1] -= avg * avg;
+    }
+  }
+
+  dt_free_align(in);
+  return TRUE;
+}
+
+/* ── Public API ──────────────────────────────────────────────────────────── */
+
+static void _ds_geometry(const int width,
+                         const int height,
+                         const dt_guided_filter_type_t type,
+                         const float radius,
+                         int *ds_width,
+                         int *ds_height,
+                         float *ds_radius)
+{
+  float scaling;
+  if(type == DT_GF_EIGF)
+  {
+    scaling = fmaxf(fminf(radius, 4.0f), 1.0f);
+    *ds_radius = fmaxf(radius / scaling, 1.0f);
+  }
+  else
+  {
+    // A down-scaling of 4 seems empirically safe and consistent no matter the image zoom level
+    scaling = 4.0f;
+    const int r = (int)radius;
+    *ds_radius = (r < 4) ? 1 : (int)(r / scaling);
+  }
+  *ds_width = MAX(1, (int)(width / scaling));
+  *ds_height = MAX(1, (int)(height / scaling));
+}
+
+dt_guided_filter_t *dt_guided_filter_init(const int width, const int height,
+                                          const dt_guided_filter_type_t type,
+                                          const float radius,
+                                          const float feathering,
+                                          const int iterations,
+                                          const dt_iop_guided_filter_blending_t blending,
+                                          const float quantization,
+                                          const float quantize_min,
+                                          const float quantize_max)
+{
+  if(width < 1 || height < 1) return NULL;
+
+  dt_guided_filter_t *g = calloc(1, sizeof(dt_guided_filter_t));
+  if(!g) return NULL;
+
+  g->width = width;
+  g->height = height;
+  g->type = type;
+  g->blending = blending;
+  g->iterations = MAX(1, iterations);
+  g->feathering = feathering;
+  g->quantization = quantization;
+  g->quantize_min = quantize_min;
+  g->quantize_max = quantize_max;
+  _ds_geometry(width, height, type, radius, &g->ds_width, &g->ds_height, &g->ds_radius);
+  g->channels = (type == DT_GF_EIGF && quantization != 0.0f) ? 4 : 2;
+
+  g->coeffs = dt_alloc_align_float((size_t)g->ds_width * g->ds_height * g->channels);
+  g->up_x = dt_alloc_align_type(int, (size_t)2 * width);
+  g->up_wx = dt_alloc_align_float((size_t)2 * width);
+  if(!g->coeffs || !g->up_x || !g->up_wx)
+  {
+    dt_guided_filter_free(g);
+    return NULL;
+  }
+
+  for(int j = 0; j < width; j++)
+    _bilinear_tap(j, width, g->ds_width, g->up_x + 2 * j, g->up_wx + 2 * j);
+
+  return g;
+}
+
+gboolean dt_guided_filter_analyse(dt_guided_filter_t *g,
+                                  dt_guided_filter_row_t guide_row,
+                                  const void *data)
+{
+  const size_t width = g->width;
+  const size_t ds_width = g->ds_width;
+  const size_t ds_height = g->ds_height;
+  const size_t num_elem_ds = ds_width * ds_height;
+  const gboolean eigf = g->type == DT_GF_EIGF;
+  // the EIGF with quantization samples the quantized guide at full
+  // resolution, the guided filter quantizes the downsampled guide
+  const gboolean sample_mask = eigf && g->channels == 4;
+
+  size_t padded_size;
+  float *const restrict rows = dt_alloc_perthread_float(2 * width, &padded_size);
+  int *const restrict ds_x = dt_alloc_align_type(int, 2 * ds_width);
+  float *const restrict ds_wx = dt_alloc_align_float(2 * ds_width);
+  float *const restrict ds_image = dt_alloc_align_float(num_elem_ds);
+  float *const restrict ds_mask = (!eigf || sample_mask) ? dt_alloc_align_float(num_elem_ds) : NULL;
+  gboolean ok = rows && ds_x && ds_wx && ds_image && (ds_mask || (eigf && !sample_mask));
+  if(!ok)
+  {
+    fprintf(stderr, "[fast guided filter] failed to allocate memory\n");
+    goto clean;
+  }
+
+  for(size_t j = 0; j < ds_width; j++)
+    _bilinear_tap(j, ds_width, width, ds_x + 2 * j, ds_wx + 2 * j);
+
+  // Downsample the guide, pulling only the rows the bilinear taps land on
+  DT_OMP_FOR()
+  for(size_t i = 0; i < ds_height; i++)
+  {
+    float *const restrict r0 = dt_get_perthread(rows, padded_size);
+    float *const restrict r1 = r0 + width;
+    int y[2];
+    float wy[2];
+    _bilinear_tap(i, ds_height, g->height, y, wy);
+    guide_row(data, y[0], r0);
+    if(y[1] != y[0])
+      guide_row(data, y[1], r1);
+    else
+      memcpy(r1, r0, sizeof(float) * width);
+
+    float *const restrict out = ds_image + i * ds_width;
+    for(size_t j = 0; j < ds_width; j++)
+    {
+      const int xp = ds_x[2 * j];
+      const int xn = ds_x[2 * j + 1];
+      const float wxp = ds_wx[2 * j];
+      const float wxn = ds_wx[2 * j + 1];
+      out[j] = wy[1] * (r1[xp] * wxp + r1[xn] * wxn) + wy[0] * (r0[xp] * wxp + r0[xn] * wxn);
+    }
+    if(sample_mask)
+    {
+      const float q = g->quantization, qmin = g->quantize_min, qmax = g->quantize_max;
+      float *const restrict mout = ds_mask + i * ds_width;
+      for(size_t j = 0; j < ds_width; j++)
+      {
+        const int xp = ds_x[2 * j];
+        const int xn = ds_x[2 * j + 1];
+        const float wxp = ds_wx[2 * j];
+        const float wxn = ds_wx[2 * j + 1];
+        mout[j] = wy[1] * (_quantize(r1[xp], q, qmin, qmax) * wxp + _quantize(r1[xn], q, qmin, qmax) * wxn)
+                + wy[0] * (_quantize(r0[xp], q, qmin, qmax) * wxp + _quantize(r0[xn], q, qmin, qmax) * wxn);
+      }
+    }
+  }
+
+  // Iterations of filter models the diffusion, sort of.  Only the
+  // coefficients of the last one go back to full resolution.
+  for(int it = 0; it < g->iterations && ok; it++)
+  {
+    const gboolean last = (it == g->iterations - 1);
+    float *const restrict coeffs = g->coeffs;
+
+    if(!eigf)
+    {
+      // (Re)build the mask from the quantized image to help guiding
+      const float q = g->quantization, qmin = g->quantize_min, qmax = g->quantize_max;
+      DT_OMP_FOR_SIMD()
+      for(size_t k = 0; k < num_elem_ds; k++)
+        ds_mask[k] = _quantize(ds_image[k], q, qmin, qmax);
+
+      // patch-wise variance analysis: a and b such that mask = a * I + b
+      ok = _variance_analyse(ds_mask, ds_image, coeffs, ds_width, ds_height,
+                             (int)g->ds_radius, g->feathering);
+
+      if(ok && !last)
+      {
+        DT_OMP_FOR_SIMD()
+        for(size_t k = 0; k < num_elem_ds; k++)
+          ds_image[k] = _guided_blend(ds_image[k], coeffs[2 * k], coeffs[2 * k + 1],
+                                      DT_GF_BLENDING_LINEAR);
+      }
+    }
+    else if(sample_mask)
+    {
+      if(it > 0)
+      {
+        const float q = g->quantization, qmin = g->quantize_min, qmax = g->quantize_max;
+        DT_OMP_FOR_SIMD()
+        for(size_t k = 0; k < num_elem_ds; k++)
+          ds_mask[k] = _quantize(ds_image[k], q, qmin, qmax);
+      }
+      ok = _eigf_variance_analysis(ds_mask, ds_image, coeffs, ds_width, ds_height, g->ds_radius);
+
+      if(ok && !last)
+      {
+        DT_OMP_FOR()
+        for(size_t k = 0; k < num_elem_ds; k++)
+          ds_image[k] = _eigf_blend(ds_image[k], ds_mask[k], coeffs + 4 * k,
+                                    DT_GF_BLENDING_LINEAR, g->feathering);
+      }
+    }
+    else
+    {
+      ok = _eigf_variance_analysis(ds_image, NULL, coeffs, ds_width, ds_height, g->ds_radius);
+
+      if(ok && !last)
+      {
+        DT_OMP_FOR()
+        for(size_t k = 0; k < num_elem_ds; k++)
+          ds_image[k] = _eigf_blend_no_mask(ds_image[k], coeffs + 2 * k,
+                                            DT_GF_BLENDING_LINEAR, g->feathering);
+      }
+    }
+  }
+  if(!ok) fprintf(stderr, "[fast guided filter] failed to allocate memory\n");
+
+clean:
+  dt_free_align(ds_mask);
+  dt_free_align(ds_image);
+  dt_free_align(ds_wx);
+  dt_free_align(ds_x);
+  dt_free_align(rows);
+  return ok;
+}
+
+size_t dt_guided_filter_scratch_size(const dt_guided_filter_t *g)
+{
+  return (size_t)g->width * g->channels;
+}
+
+void dt_guided_filter_blend_row(const dt_guided_filter_t *g,
+                                const int row,
+                                float *const restrict guide,
+                                float *const restrict scratch)
+{
+  const size_t width = g->width;
+  const size_t ch = g->channels;
+  const size_t ds_stride = (size_t)g->ds_width * ch;
+
+  // Upsample the blending coefficients of this row
+  int y[2];
+  float wy[2];
+  _bilinear_tap(row, g->height, g->ds_height, y, wy);
+  const float *const restrict c0 = g->coeffs + y[0] * ds_stride;
+  const float *const restrict c1 = g->coeffs + y[1] * ds_stride;
+  const int *const restrict up_x = g->up_x;
+  const float *const restrict up_wx = g->up_wx;
+
+  for(size_t j = 0; j < width; j++)
+  {
+    const size_t xp = ch * up_x[2 * j];
+    const size_t xn = ch * up_x[2 * j + 1];
+    const float wxp = up_wx[2 * j];
+    const float wxn = up_wx[2 * j + 1];
+    for(size_t c = 0; c < ch; c++)
+      scratch[ch * j + c] = wy[1] * (c1[xp + c] * wxp + c1[xn + c] * wxn)
+                          + wy[0] * (c0[xp + c] * wxp + c0[xn + c] * wxn);
+  }
+
+  // Blend the guided image
+  const dt_iop_guided_filter_blending_t filter = g->blending;
+  const float feathering = g->feathering;
+  if(g->type != DT_GF_EIGF)
+  {
+    DT_OMP_SIMD()
+    for(size_t j = 0; j < width; j++)
+      guide[j] = _guided_blend(guide[j], scratch[2 * j], scratch[2 * j + 1], filter);
+  }
+  else if(ch == 4)
+  {
+    const float q = g->quantization, qmin = g->quantize_min, qmax = g->quantize_max;
+    DT_OMP_SIMD()
+    for(size_t j = 0; j < width; j++)
+      guide[j] = _eigf_blend(guide[j], _quantize(guide[j], q, qmin, qmax), scratch + 4 * j,
+                             filter, feathering);
+  }
+  else
+  {
+    DT_OMP_SIMD()
+    for(size_t j = 0; j < width; j++)
+      guide[j] = _eigf_blend_no_mask(guide[j], scratch + 2 * j, filter, feathering);
+  }
+}
+
+size_t dt_guided_filter_memory_use(const int width, const int height,
+                                   const dt_guided_filter_type_t type,
+                                   const float radius)
+{
+  int ds_width, ds_height;
+  float ds_radius;
+  _ds_geometry(width, height, type, radius, &ds_width, &ds_height, &ds_radius);
+  // downsampled guide and mask, 4 coefficients, the 4-channel variance
+  // input and the gaussian's (or box filter's) working copy
+  const size_t ds = (size_t)ds_width * ds_height;
+  return sizeof(float) * (ds * (2 + 4 + 4 + 4)
+                          + (size_t)width * (4 + 2 * dt_get_num_threads()));
+}
+
+void dt_guided_filter_free(dt_guided_filter_t *g)
+{
+  if(!g) return;
+  dt_free_align(g->coeffs);
+  dt_free_align(g->up_x);
+  dt_free_align(g->up_wx);
+  free(g);
+}
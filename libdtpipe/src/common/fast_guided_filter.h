@@ -0,0 +1,111 @@
+/*
+ * fast_guided_filter.h - Fast guided filter and EIGF surface blur on grey images
+ *
+ * Ported from darktable src/common/fast_guided_filter.h and
+ * src/common/eigf.h
+ * Copyright (C) 2019-2024 darktable developers.
+ *
+ * Stripped of: the in-place full-image entry points (fast_surface_blur,
+ * fast_eigf_surface_blur) and the generic bilinear resampler they share.
+ *
+ * Changes: darktable runs both filters on a full-resolution grey buffer:
+ * it downsamples it, analyses the variance at low resolution, then
+ * upsamples the blending coefficients into a full-resolution buffer (two
+ * or four floats per pixel) and blends the image with them.  The EIGF
+ * additionally goes back to full resolution after every iteration.  Here
+ * the filter never holds a full-resolution buffer:
+ *   - dt_guided_filter_analyse() pulls the guide one row at a time from a
+ *     callback and only keeps the rows its bilinear taps land on, so the
+ *     guide itself (e.g. a luminance estimate of an RGB image) is never
+ *     stored;
+ *   - all iterations run at low resolution, only the coefficients of the
+ *     last one are kept;
+ *   - dt_guided_filter_blend_row() upsamples the coefficients of one row
+ *     and blends the caller's full-resolution guide row with them, so the
+ *     caller can fuse the filter into its own per-row pass.
+ * The low-resolution state is small (a quarter of a float per
+ * full-resolution pixel for the EIGF with quantization once the radius
+ * reaches 4, less otherwise), which makes it cheap to keep around between
+ * runs.  With one iteration the result is
+ * darktable's to floating-point rounding; with more, the intermediate
+ * EIGF blends happen at low resolution.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum dt_iop_guided_filter_blending_t
+{
+  DT_GF_BLENDING_LINEAR = 0,
+  DT_GF_BLENDING_GEOMEAN
+} dt_iop_guided_filter_blending_t;
+
+typedef enum dt_guided_filter_type_t
+{
+  DT_GF_GUIDED = 0, // box-window guided filter (fast_guided_filter.h)
+  DT_GF_EIGF        // exposure-independent guided filter (eigf.h)
+} dt_guided_filter_type_t;
+
+// fills out[0 .. width-1] with row `row` of the full-resolution guide.
+// Called concurrently from several threads.
+typedef void (*dt_guided_filter_row_t)(const void *data, const int row, float *const out);
+
+typedef struct dt_guided_filter_t
+{
+  int width, height;          // full-resolution guide
+  int ds_width, ds_height;    // low resolution, where the variance analysis runs
+  int channels;               // blending coefficients per low-resolution pixel (2 or 4)
+  dt_guided_filter_type_t type;
+  dt_iop_guided_filter_blending_t blending;
+  int iterations;
+  float ds_radius;            // box radius (guided) or gaussian sigma (EIGF) at low resolution
+  float feathering;
+  float quantization, quantize_min, quantize_max;
+  float *coeffs;              // ds_width * ds_height * channels
+  // bilinear taps of the full-resolution columns into the low-resolution grid
+  int *up_x;
+  float *up_wx;
+} dt_guided_filter_t;
+
+dt_guided_filter_t *dt_guided_filter_init(const int width, const int height,
+                                          const dt_guided_filter_type_t type,
+                                          const float radius,          // box radius or gaussian sigma, full resolution
+                                          const float feathering,
+                                          const int iterations,
+                                          const dt_iop_guided_filter_blending_t blending,
+                                          const float quantization,
+                                          const float quantize_min,
+                                          const float quantize_max);
+
+// runs the variance analysis on the guide delivered by guide_row().
+// Returns FALSE if the working buffers cannot be allocated.
+gboolean dt_guided_filter_analyse(dt_guided_filter_t *g,
+                                  dt_guided_filter_row_t guide_row,
+                                  const void *data);
+
+// floats of scratch space dt_guided_filter_blend_row() needs per thread
+size_t dt_guided_filter_scratch_size(const dt_guided_filter_t *g);
+
+// filters row `row` of the guide in place
+void dt_guided_filter_blend_row(const dt_guided_filter_t *g,
+                                const int row,
+                                float *const guide,
+                                float *const scratch);
+
+// peak memory of init + analyse, without the caller's buffers
+size_t dt_guided_filter_memory_use(const int width, const int height,
+                                   const dt_guided_filter_type_t type,
+                                   const float radius);
+
+void dt_guided_filter_free(dt_guided_filter_t *g);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * gaussian.h - Recursive (Deriche) gaussian blur on multi-channel images
+ *
+ * Ported from darktable src/common/gaussian.c
+ * Copyright (C) 2012-2024 darktable developers.
+ *
+ * Stripped of: the OpenCL paths (dt_gaussian_*_cl) and the 9x9 fast
+ * blur (dt_gaussian_fast_blur), which no libdtpipe module uses yet.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum dt_gaussian_order_t
+{
+  DT_IOP_GAUSSIAN_ZERO = 0, // $DESCRIPTION: "order 0"
+  DT_IOP_GAUSSIAN_ONE = 1,  // $DESCRIPTION: "order 1"
+  DT_IOP_GAUSSIAN_TWO = 2   // $DESCRIPTION: "order 2"
+} dt_gaussian_order_t;
+
+typedef struct dt_gaussian_t
+{
+  int width, height, channels;
+  float sigma;
+  int order;
+  float *max;
+  float *min;
+  float *buf;
+} dt_gaussian_t;
+
+dt_gaussian_t *dt_gaussian_init(const int width, const int height, const int channels, const float *max,
+                                const float *min, const float sigma, const int order);
+
+size_t dt_gaussian_memory_use(const int width, const int height, const int channels);
+
+size_t dt_gaussian_singlebuffer_size(const int width, const int height, const int channels);
+
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out);
+
+void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out);
+
+void dt_gaussian_free(dt_gaussian_t *g);
+
+#ifdef __cplusplus
+}
+#endif
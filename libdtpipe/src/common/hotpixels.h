@@ -0,0 +1,111 @@
+/*
+ * hotpixels.h - Hot pixel detection on the Bayer mosaic
+ *
+ * Detection rule from darktable src/iop/hotpixels.c.
+ * Copyright (C) 2011-2025 darktable developers.
+ *
+ * A sensel brighter than threshold is hot when at least min_neighbours of
+ * its four nearest same-colour sites (two columns / two rows away) are
+ * below value * multiplier.  It is replaced by the brightest of those.
+ *
+ * Changes: darktable tests the neighbours with a branch per neighbour and
+ * a branch per sensel.  Here one output row is computed from three input
+ * rows with comparisons, counts and selects only, so the loop vectorizes
+ * and costs the same on clean and noisy rows.  The row form lets the
+ * filter run on rows as they are produced: rawprepare calls it while it
+ * scales the mosaic (see dt_dev_pixelpipe_iop_t::fused_hotpixels), and
+ * the hot pixels module calls it on its input rows.
+ *
+ * Header-only: everything is static inline.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dt_hotpixels_t
+{
+  float threshold;      /* lower bound for a hot sensel          */
+  float multiplier;     /* strength / 2                          */
+  int   min_neighbours; /* 3 (permissive) or 4                   */
+  gboolean markfixed;   /* mark fixed sensels (editing aid only) */
+} dt_hotpixels_t;
+
+/**
+ * Filter one Bayer row.  up / mid / down are the rows two above, this one
+ * and two below, all width sensels wide; out receives the row.  thr[p] is
+ * the threshold for columns of parity p, so that a gain still to be
+ * applied per colour can be divided out.  The two sensels on each side
+ * are copied.
+ */
+static inline void dt_hotpixels_bayer_row(const dt_hotpixels_t *const h,
+                                          const float thr[2],
+                                          const float *const restrict up,
+                                          const float *const restrict mid,
+                                          const float *const restrict down,
+                                          float *const restrict out,
+                                          const int width)
+{
+  const float multiplier = h->multiplier;
+  const int min_neighbours = h->min_neighbours;
+  const float thr0 = thr[0];
+  const float thr1 = thr[1];
+
+  for(int col = 0; col < MIN(2, width); col++)
+    out[col] = mid[col];
+
+  DT_OMP_SIMD()
+  for(int col = 2; col < width - 2; col++)
+  {
+    const float v = mid[col];
+    const float hot = v * multiplier;
+    const float n0 = mid[col - 2];
+    const float n1 = mid[col + 2];
+    const float n2 = up[col];
+    const float n3 = down[col];
+    const int count = (hot > n0) + (hot > n1) + (hot > n2) + (hot > n3);
+    float maxin = 0.0f;
+    maxin = hot > n0 ? fmaxf(maxin, n0) : maxin;
+    maxin = hot > n1 ? fmaxf(maxin, n1) : maxin;
+    maxin = hot > n2 ? fmaxf(maxin, n2) : maxin;
+    maxin = hot > n3 ? fmaxf(maxin, n3) : maxin;
+    const float t = (col & 1) ? thr1 : thr0;
+    out[col] = (v > t && count >= min_neighbours) ? maxin : v;
+  }
+
+  for(int col = MAX(2, width - 2); col < width; col++)
+    out[col] = mid[col];
+}
+
+/**
+ * Marks the sensels dt_hotpixels_bayer_row() fixed, same arguments, by
+ * spreading their original value over the same-colour sites up to ten
+ * columns away.  Scalar; only used while editing.
+ */
+static inline void dt_hotpixels_bayer_mark(const dt_hotpixels_t *const h,
+                                           const float thr[2],
+                                           const float *const restrict up,
+                                           const float *const restrict mid,
+                                           const float *const restrict down,
+                                           float *const restrict out,
+                                           const int width)
+{
+  for(int col = 2; col < width - 2; col++)
+  {
+    const float v = mid[col];
+    const float hot = v * h->multiplier;
+    if(v <= thr[col & 1]) continue;
+    const int count = (hot > mid[col - 2]) + (hot > mid[col + 2]) + (hot > up[col]) + (hot > down[col]);
+    if(count < h->min_neighbours) continue;
+    for(int i = -2; i >= -10 && i >= -col; i -= 2) out[col + i] = v;
+    for(int i = 2; i <= 10 && i < width - col; i += 2) out[col + i] = v;
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
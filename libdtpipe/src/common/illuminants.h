@@ -0,0 +1,223 @@
+/*
+ * illuminants.h - Standard illuminant chromaticities
+ *
+ * Ported subset of darktable src/common/illuminants.h.
+ * Copyright (C) 2020-2024 darktable developers.
+ *
+ * Stripped of: the GUI helpers (illuminant_xy_to_RGB, CCT reverse lookup,
+ * tint) and the custom-WB plumbing from dt_develop_t chroma.
+ *
+ * Changes: DT_ILLUMINANT_PIPE is D65, the libdtpipe pipeline white, and
+ * the camera illuminant is read from the image WB coefficients without the
+ * Bradford D65 -> D50 step.
+ *
+ * Header-only: everything is static inline.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+#include "common/chromatic_adaptation.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum dt_illuminant_t
+{
+  DT_ILLUMINANT_PIPE            = 0,  /* same as pipeline (D65)          */
+  DT_ILLUMINANT_A               = 1,  /* A (incandescent)                */
+  DT_ILLUMINANT_D               = 2,  /* D (daylight)                    */
+  DT_ILLUMINANT_E               = 3,  /* E (equi-energy)                 */
+  DT_ILLUMINANT_F               = 4,  /* F (fluorescent)                 */
+  DT_ILLUMINANT_LED             = 5,  /* LED (LED light)                 */
+  DT_ILLUMINANT_BB              = 6,  /* Planckian (black body)          */
+  DT_ILLUMINANT_CUSTOM          = 7,  /* custom: x and y taken as-is     */
+  DT_ILLUMINANT_CAMERA          = 10, /* as shot in camera (raw WB)      */
+  DT_ILLUMINANT_LAST,
+  DT_ILLUMINANT_DETECT_SURFACES = 8,  /* GUI-only auto-detection         */
+  DT_ILLUMINANT_DETECT_EDGES    = 9,
+} dt_illuminant_t;
+
+typedef enum dt_illuminant_fluo_t
+{
+  DT_ILLUMINANT_FLUO_F1 = 0, DT_ILLUMINANT_FLUO_F2, DT_ILLUMINANT_FLUO_F3, DT_ILLUMINANT_FLUO_F4,
+  DT_ILLUMINANT_FLUO_F5, DT_ILLUMINANT_FLUO_F6, DT_ILLUMINANT_FLUO_F7, DT_ILLUMINANT_FLUO_F8,
+  DT_ILLUMINANT_FLUO_F9, DT_ILLUMINANT_FLUO_F10, DT_ILLUMINANT_FLUO_F11, DT_ILLUMINANT_FLUO_F12,
+  DT_ILLUMINANT_FLUO_LAST
+} dt_illuminant_fluo_t;
+
+typedef enum dt_illuminant_led_t
+{
+  DT_ILLUMINANT_LED_B1 = 0, DT_ILLUMINANT_LED_B2, DT_ILLUMINANT_LED_B3, DT_ILLUMINANT_LED_B4,
+  DT_ILLUMINANT_LED_B5, DT_ILLUMINANT_LED_BH1, DT_ILLUMINANT_LED_RGB1, DT_ILLUMINANT_LED_V1,
+  DT_ILLUMINANT_LED_V2,
+  DT_ILLUMINANT_LED_LAST
+} dt_illuminant_led_t;
+
+/* x, y chromaticities, CIE 1931 2° observer */
+static const float dt_illuminant_fluorescent[DT_ILLUMINANT_FLUO_LAST][2]
+    = { { 0.31310f, 0.33727f }, { 0.37208f, 0.37529f }, { 0.40910f, 0.39430f }, { 0.44018f, 0.40329f },
+        { 0.31379f, 0.34531f }, { 0.37790f, 0.38835f }, { 0.31292f, 0.32933f }, { 0.34588f, 0.35875f },
+        { 0.37417f, 0.37281f }, { 0.34609f, 0.35986f }, { 0.38052f, 0.37713f }, { 0.43695f, 0.40441f } };
+
+static const float dt_illuminant_led[DT_ILLUMINANT_LED_LAST][2]
+    = { { 0.4560f, 0.4078f }, { 0.4357f, 0.4012f }, { 0.3756f, 0.3723f }, { 0.3422f, 0.3502f },
+        { 0.3118f, 0.3236f }, { 0.4474f, 0.4066f }, { 0.4557f, 0.4211f }, { 0.4560f, 0.4548f },
+        { 0.3781f, 0.3775f } };
+
+/* ── Planckian and daylight loci ─────────────────────────────────────────── */
+
+/* closest daylight illuminant, valid for 4000 K - 25000 K (0 outside) */
+static inline void CCT_to_xy_daylight(const float t, float *x, float *y)
+{
+  float x_temp = 0.f;
+
+  if(t >= 4000.f && t <= 7000.0f)
+    x_temp = ((-4.6070e9f / t + 2.9678e6f) / t + 0.09911e3f) / t + 0.244063f;
+  else if(t > 7000.f && t <= 25000.f)
+    x_temp = ((-2.0064e9f / t + 1.9018e6f) / t + 0.24748e3f) / t + 0.237040f;
+
+  *x = x_temp;
+  *y = (-3.f * x_temp + 2.87f) * x_temp - 0.275f;
+}
+
+/* black body radiator, valid for 1667 K - 25000 K (0 outside) */
+static inline void CCT_to_xy_blackbody(const float t, float *x, float *y)
+{
+  float x_temp = 0.f;
+  float y_temp = 0.f;
+
+  if(t >= 1667.f && t <= 4000.f)
+    x_temp = ((-0.2661239e9f / t - 0.2343589e6f) / t + 0.8776956e3f) / t + 0.179910f;
+  else if(t > 4000.f && t <= 25000.f)
+    x_temp = ((-3.0258469e9f / t + 2.1070379e6f) / t + 0.2226347e3f) / t + 0.240390f;
+
+  if(t >= 1667.f && t <= 2222.f)
+    y_temp = ((-1.1063814f * x_temp - 1.34811020f) * x_temp + 2.18555832f) * x_temp - 0.20219683f;
+  else if(t > 2222.f && t <= 4000.f)
+    y_temp = ((-0.9549476f * x_temp - 1.37418593f) * x_temp + 2.09137015f) * x_temp - 0.16748867f;
+  else if(t > 4000.f && t <= 25000.f)
+    y_temp = ((3.0817580f * x_temp - 5.87338670f) * x_temp + 3.75112997f) * x_temp - 0.37001483f;
+
+  *x = x_temp;
+  *y = y_temp;
+}
+
+/* illuminant XYZ with Y = 1 */
+static inline void illuminant_xy_to_XYZ(const float x, const float y, dt_aligned_pixel_t XYZ)
+{
+  XYZ[0] = x / y;
+  XYZ[1] = 1.f;
+  XYZ[2] = (1.f - x - y) / y;
+}
+
+/* ── Camera white balance ────────────────────────────────────────────────── */
+
+/**
+ * Chromaticity of the scene illuminant implied by the raw WB coefficients:
+ * camera RGB (1/WB) pushed through the inverse of adobe_XYZ_to_CAM (or the
+ * DNG D65 matrix when present).  Returns FALSE when the image carries no
+ * usable matrix or coefficients.
+ */
+static inline gboolean find_temperature_from_raw_coeffs(const dt_image_t *img,
+                                                        float *chroma_x, float *chroma_y)
+{
+  if(img == NULL || !dt_image_is_raw(img) || dt_image_is_monochrome(img)) return FALSE;
+
+  for(int k = 0; k < 3; k++)
+    if(!isnormal(img->wb_coeffs[k])) return FALSE;
+
+  dt_colormatrix_t XYZ_to_CAM = { { 0.f } };
+  const int embedded = dt_is_valid_colormatrix(img->d65_color_matrix[0]) && img->d65_color_matrix[0] != 0.f;
+  for(int k = 0; k < 3; k++)
+    for(int i = 0; i < 3; i++)
+      XYZ_to_CAM[k][i] = embedded ? img->d65_color_matrix[3 * k + i] : img->adobe_XYZ_to_CAM[k][i];
+
+  dt_colormatrix_t CAM_to_XYZ;
+  if(!dt_is_valid_colormatrix(XYZ_to_CAM[0][0]) || mat3SSEinv(CAM_to_XYZ, XYZ_to_CAM)) return FALSE;
+
+  const dt_aligned_pixel_t white = { 1.f / img->wb_coeffs[0], 1.f / img->wb_coeffs[1],
+                                     1.f / img->wb_coeffs[2], 0.f };
+  dt_aligned_pixel_t XYZ = { 0.f };
+  for(int k = 0; k < 3; k++)
+    for(int i = 0; i < 3; i++)
+      XYZ[k] += CAM_to_XYZ[k][i] * white[i];
+
+  const float sum = XYZ[0] + XYZ[1] + XYZ[2];
+  if(!(sum > 0.f) || !(XYZ[1] > 0.f)) return FALSE;
+
+  *chroma_x = XYZ[0] / sum;
+  *chroma_y = XYZ[1] / sum;
+  return TRUE;
+}
+
+/* ── Illuminant lookup ───────────────────────────────────────────────────── */
+
+/**
+ * x, y chromaticity of a standard illuminant.  Returns FALSE (and leaves
+ * *x_out, *y_out alone) for custom illuminants or when nothing valid is found.
+ */
+static inline int illuminant_to_xy(const dt_illuminant_t illuminant,
+                                   const dt_image_t *img,
+                                   float *x_out, float *y_out,
+                                   const float t,
+                                   const dt_illuminant_fluo_t fluo,
+                                   const dt_illuminant_led_t iled)
+{
+  float x = 0.f;
+  float y = 0.f;
+
+  switch(illuminant)
+  {
+    case DT_ILLUMINANT_PIPE:
+      x = DT_D65_x;
+      y = DT_D65_y;
+      break;
+    case DT_ILLUMINANT_E:
+      x = y = 1.f / 3.f;
+      break;
+    case DT_ILLUMINANT_A:
+      x = 0.44757f;
+      y = 0.40745f;
+      break;
+    case DT_ILLUMINANT_F:
+      if(fluo >= DT_ILLUMINANT_FLUO_LAST) break;
+      x = dt_illuminant_fluorescent[fluo][0];
+      y = dt_illuminant_fluorescent[fluo][1];
+      break;
+    case DT_ILLUMINANT_LED:
+      if(iled >= DT_ILLUMINANT_LED_LAST) break;
+      x = dt_illuminant_led[iled][0];
+      y = dt_illuminant_led[iled][1];
+      break;
+    case DT_ILLUMINANT_D:
+      CCT_to_xy_daylight(t, &x, &y);
+      if(y != 0.f && x != 0.f) break;
+      /* fall through: out of the daylight range, use the black body */
+    case DT_ILLUMINANT_BB:
+      CCT_to_xy_blackbody(t, &x, &y);
+      if(y != 0.f && x != 0.f) break;
+      /* fall through */
+    case DT_ILLUMINANT_CAMERA:
+      if(find_temperature_from_raw_coeffs(img, &x, &y)) break;
+      /* fall through */
+    case DT_ILLUMINANT_CUSTOM:
+    case DT_ILLUMINANT_DETECT_EDGES:
+    case DT_ILLUMINANT_DETECT_SURFACES:
+    case DT_ILLUMINANT_LAST:
+      return FALSE;
+  }
+
+  if(x != 0.f && y != 0.f)
+  {
+    *x_out = x;
+    *y_out = y;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+#ifdef __cplusplus
+}
+#endif
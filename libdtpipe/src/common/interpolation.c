@@ -0,0 +1,823 @@
+/*
+ * interpolation.c - Pixel interpolators and plan-cached image resampling
+ *
+ * Ported from darktable src/common/interpolation.c
+ * Copyright (C) 2012-2025 darktable developers.
+ *
+ * Stripped of:
+ *   - OpenCL resampling kernels
+ *   - Performance timing / debug printing
+ *   - Border modes other than BORDER_REPLICATE (the only one resampling uses)
+ *
+ * Changes:
+ *   - Resampling plans (per-output tap offsets, sample indexes and
+ *     normalised kernels) are kept in a small process-wide LRU keyed by
+ *     (interpolator, in size, out size, shift, scale), so repeated renders
+ *     at the same size skip the plan build entirely.
+ *   - dt_interpolation_resample() runs as two separable passes.  Each
+ *     thread owns a contiguous band of output rows and a ring of
+ *     horizontally-resampled rows sized to the vertical kernel span, so
+ *     every input row is filtered horizontally once per band and the
+ *     vertical pass is a straight multiply-add over contiguous rows.
+ *   - The horizontal pass works on whole pixels as 4-float vectors and
+ *     filters blocks of rows one block of output columns at a time, so
+ *     the taps of a column block stay in cache for every row.
+ */
+
+#include "common/interpolation.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum kernel half width — keep in sync with the interpolator table */
+#define MAX_HALF_FILTER_WIDTH 3
+
+/* Number of resampling plans kept alive between calls.  Every resample
+   needs two (horizontal + vertical); a handful of pipelines rendering at a
+   few sizes each fits comfortably. */
+#define RESAMPLING_PLAN_CACHE_SIZE 16
+
+/* Output pixels per column block of the horizontal pass: the plan slice of
+   a block (taps and indexes) stays in L1 while it runs down the rows. */
+#define RESAMPLE_COLUMN_BLOCK 64
+
+/* Input rows the horizontal pass filters ahead, on top of the vertical
+   kernel span, so that every column block covers several rows. */
+#define RESAMPLE_ROW_BLOCK 8
+
+/* ── Interpolation kernels ───────────────────────────────────────────────── */
+
+static float _maketaps_bilinear(float *taps,
+                                const size_t num_taps,
+                                const float width,
+                                const float first_tap,
+                                const float interval)
+{
+  static const dt_aligned_pixel_t bootstrap = { 0.0f, 1.0f, 2.0f, 3.0f };
+  dt_aligned_pixel_t iter;
+  dt_aligned_pixel_t vt;
+  for_four_channels(c)
+    iter[c] = 4.0f * interval;
+  for_four_channels(c)
+    vt[c] = first_tap + bootstrap[c] * interval;
+
+  const size_t runs = (num_taps + 3) / 4;
+
+  for(size_t i = 0; i < runs; i++)
+  {
+    for_four_channels(c)
+      taps[4*i + c] = 1.0f - (vt[c] < 0.0f ? -vt[c] : vt[c]);
+    for_four_channels(c)
+      vt[c] += iter[c];
+  }
+  return 1.0f; /* kernel norm is 1.0f by construction */
+}
+
+static float _maketaps_bicubic(float *taps,
+                               const size_t num_taps,
+                               const float width,
+                               const float first_tap,
+                               const float interval)
+{
+  static const dt_aligned_pixel_t bootstrap = { 0.0f, 1.0f, 2.0f, 3.0f };
+  dt_aligned_pixel_t iter;
+  dt_aligned_pixel_t vt;
+  for_four_channels(c)
+    iter[c] = 4.0f * interval;
+  for_four_channels(c)
+    vt[c] = first_tap + bootstrap[c] * interval;
+
+  const size_t runs = (num_taps + 3) / 4;
+
+  for(size_t i = 0; i < runs; i++)
+  {
+    dt_aligned_pixel_t r;
+    for_four_channels(c)
+    {
+      const float t   = vt[c] < 0.0f ? -vt[c] : vt[c];
+      const float t2  = t * t;
+      const float t5  = 5.0f * t;
+      /* 1 < |t| < 2 :  (-t^3 + 5t^2 - 8t + 4) / 2
+         |t| <= 1    :  (3t^3 - 5t^2 + 2) / 2 */
+      const float r12 = 0.5f * (t * (t5 - 8.0f - t2) + 4.0f);
+      const float r01 = 0.5f * ((3.0f * t2 - t5) * t + 2.0f);
+      r[c] = t <= 1.0f ? r01 : r12;
+    }
+    for_four_channels(c)
+      taps[4*i + c] = r[c];
+    for_four_channels(c)
+      vt[c] += iter[c];
+  }
+  return 1.0f; /* kernel norm is 1.0f by construction */
+}
+
+#define DT_LANCZOS_EPSILON (1e-9f)
+
+/* Fast Lanczos without libm calls:
+ *   sin(pi.t) = sign.sin(r.pi) with t = a + r, sign = -1 for odd a.
+ * The caller only ever asks for -width < t < width. */
+static float _maketaps_lanczos(float *taps,
+                               const size_t num_taps,
+                               const float width,
+                               const float first_tap,
+                               const float interval)
+{
+  static const dt_aligned_pixel_t bootstrap = { 0.0f, 1.0f, 2.0f, 3.0f };
+  dt_aligned_pixel_t iter;
+  dt_aligned_pixel_t vt;
+  for_four_channels(c)
+    iter[c] = 4.0f * interval;
+  for_four_channels(c)
+    vt[c] = first_tap + bootstrap[c] * interval;
+
+  const size_t runs = (num_taps + 3) / 4;
+
+  for(size_t i = 0; i < runs; i++)
+  {
+    dt_aligned_pixel_t sign;
+    dt_aligned_pixel_t sine_arg1;
+    dt_aligned_pixel_t sine_arg2;
+    for_four_channels(c)
+    {
+      const int a = (int)vt[c];
+      sign[c] = (a & 1) ? -1.0f : 1.0f;
+      sine_arg1[c] = M_PI_F * (vt[c] - (float)a);
+      sine_arg2[c] = M_PI_F * vt[c] / width;
+    }
+    dt_aligned_pixel_t sine1;
+    dt_aligned_pixel_t sine2;
+    dt_vector_sin(sine_arg1, sine1);
+    dt_vector_sin(sine_arg2, sine2);
+    for_four_channels(c)
+    {
+      const float num   = width * sign[c] * sine1[c] * sine2[c] + DT_LANCZOS_EPSILON;
+      const float denom = M_PI_F * M_PI_F * vt[c] * vt[c] + DT_LANCZOS_EPSILON;
+      taps[4*i + c] = num / denom;
+    }
+    for_four_channels(c)
+      vt[c] += iter[c];
+  }
+
+  /* The norm is very close to 1 but not normalising produces visible
+     moire banding in smooth gradients. */
+  float norm = 0.0f;
+  for(size_t i = 0; i < num_taps; i++)
+    norm += taps[i];
+  return norm;
+}
+
+#undef DT_LANCZOS_EPSILON
+
+/* Make sure MAX_HALF_FILTER_WIDTH is at least the widest entry here. */
+static const dt_interpolation_t dt_interpolator[] = {
+  { .id = DT_INTERPOLATION_BILINEAR, .name = "bilinear", .width = 1,
+    .maketaps = &_maketaps_bilinear },
+  { .id = DT_INTERPOLATION_BICUBIC,  .name = "bicubic",  .width = 2,
+    .maketaps = &_maketaps_bicubic },
+  { .id = DT_INTERPOLATION_LANCZOS2, .name = "lanczos2", .width = 2,
+    .maketaps = &_maketaps_lanczos },
+  { .id = DT_INTERPOLATION_LANCZOS3, .name = "lanczos3", .width = 3,
+    .maketaps = &_maketaps_lanczos },
+};
+
+/* ── Interpolator factory ────────────────────────────────────────────────── */
+
+static const dt_interpolation_t *_interpolation_by_name(const char *name)
+{
+  if(!name || !name[0])
+    return NULL;
+  for(int i = DT_INTERPOLATION_FIRST; i < DT_INTERPOLATION_LAST; i++)
+    if(!strcmp(name, dt_interpolator[i].name))
+      return &dt_interpolator[i];
+  return NULL;
+}
+
+const dt_interpolation_t *dt_interpolation_new(enum dt_interpolation_type type)
+{
+  const dt_interpolation_t *itor = NULL;
+
+  if(type == DT_INTERPOLATION_USERPREF)
+  {
+    itor = _interpolation_by_name(
+      dt_conf_get_string_const("plugins/lighttable/export/pixel_interpolator"));
+    type = DT_INTERPOLATION_DEFAULT;
+  }
+  else if(type == DT_INTERPOLATION_USERPREF_WARP)
+  {
+    itor = _interpolation_by_name(
+      dt_conf_get_string_const("plugins/lighttable/export/pixel_interpolator_warp"));
+    type = DT_INTERPOLATION_DEFAULT_WARP;
+  }
+
+  if(!itor)
+  {
+    for(int i = DT_INTERPOLATION_FIRST; i < DT_INTERPOLATION_LAST; i++)
+    {
+      if(dt_interpolator[i].id == type)
+        return &dt_interpolator[i];
+      if(dt_interpolator[i].id == DT_INTERPOLATION_DEFAULT)
+        itor = &dt_interpolator[i];
+    }
+  }
+
+  return itor;
+}
+
+/* ── Kernel helpers ──────────────────────────────────────────────────────── */
+
+static inline int _clip(const int i, const int max)
+{
+  /* BORDER_REPLICATE: aaaa|abcdefg|gggg */
+  return i < 0 ? 0 : (i > max ? max : i);
+}
+
+static inline void _compute_upsampling_kernel(const dt_interpolation_t *itor,
+                                              float *kernel,
+                                              int *first,
+                                              float t)
+{
+  /* floorf() rather than a cast: positions can be slightly negative */
+  const int f = (int)floorf(t) - (int)itor->width + 1;
+  *first = f;
+  t = t - (float)f;
+  itor->maketaps(kernel, 2 * itor->width, itor->width, t, -1.0f);
+}
+
+static inline void _compute_downsampling_kernel(const dt_interpolation_t *itor,
+                                                int *taps,
+                                                int *first,
+                                                float *kernel,
+                                                const float outoinratio,
+                                                const int xout)
+{
+  const float w = (float)itor->width;
+
+  /* phase difference between the output pixel and its first input pixel */
+  const float xin = ceil_fast(((float)xout - w) / outoinratio);
+  *first = (int)xin;
+
+  const float t = xin * outoinratio - (float)xout;
+  *taps = (int)((w - t) / outoinratio);
+  itor->maketaps(kernel, *taps, itor->width, t, outoinratio);
+}
+
+/* ── Resampling plans ────────────────────────────────────────────────────── */
+
+/*
+ * A 1-D resampling plan.  Output sample x is
+ *
+ *   sum over k in [start[x], start[x+1]) of  kernel[k] * in[index[k]]
+ *
+ * Kernels are pre-normalised and indexes pre-clipped, so applying a plan
+ * is a pure gather + multiply-add.  Indexes within one output are
+ * consecutive and the first index never decreases with x; `maxspan` is the
+ * widest [first, last] input range any single output touches.
+ */
+typedef struct _resampling_plan_t
+{
+  /* cache key */
+  enum dt_interpolation_type id;
+  int   in, out, shift;
+  float scale;
+
+  int   *start;   /* out + 1 entries */
+  int   *index;
+  float *kernel;
+  int    maxspan;
+
+  /* cache bookkeeping (guarded by _plan_mutex) */
+  int      users;
+  uint64_t tick;
+  bool     cached;
+} _resampling_plan_t;
+
+static void _plan_free(_resampling_plan_t *plan)
+{
+  if(!plan) return;
+  free(plan->start);
+  free(plan->index);
+  dt_free_align(plan->kernel);
+  free(plan);
+}
+
+static _resampling_plan_t *_plan_build(const dt_interpolation_t *itor,
+                                       const int in,
+                                       const int out,
+                                       const int shift,
+                                       const float scale)
+{
+  /* Worst-case taps per output: exact when upscaling */
+  const int maxtapsapixel = scale > 1.0f
+    ? 2 * (int)itor->width
+    : (int)ceil_fast(2.0f * (float)itor->width / scale);
+
+  _resampling_plan_t *plan = calloc(1, sizeof(_resampling_plan_t));
+  if(!plan) return NULL;
+
+  plan->id    = itor->id;
+  plan->in    = in;
+  plan->out   = out;
+  plan->shift = shift;
+  plan->scale = scale;
+
+  const size_t ntaps = (size_t)maxtapsapixel * out;
+  plan->start  = malloc(sizeof(int) * ((size_t)out + 1));
+  plan->index  = malloc(sizeof(int) * ntaps);
+  plan->kernel = dt_alloc_align_float(ntaps);
+  /* maketaps writes four taps per iteration */
+  float *scratch = dt_alloc_align_float((size_t)maxtapsapixel + 4);
+
+  if(!plan->start || !plan->index || !plan->kernel || !scratch)
+  {
+    dt_free_align(scratch);
+    _plan_free(plan);
+    return NULL;
+  }
+
+  int k = 0;
+  int maxspan = 1;
+  for(int x = 0; x < out; x++)
+  {
+    plan->start[x] = k;
+
+    int first;
+    int taps;
+    if(scale > 1.0f)
+    {
+      taps = 2 * (int)itor->width;
+      _compute_upsampling_kernel(itor, scratch, &first,
+                                 (float)(shift + x) / scale);
+    }
+    else
+      _compute_downsampling_kernel(itor, &taps, &first, scratch, scale, shift + x);
+
+    /* Pre-normalise: this avoids dividing by the norm for every pixel */
+    float norm = 0.0f;
+    for(int t = 0; t < taps; t++)
+      norm += scratch[t];
+    norm = 1.0f / norm;
+
+    for(int t = 0; t < taps; t++)
+    {
+      plan->kernel[k] = scratch[t] * norm;
+      plan->index[k]  = _clip(first + t, in - 1);
+      k++;
+    }
+
+    if(taps > 0)
+      maxspan = MAX(maxspan, plan->index[k - 1] - plan->index[plan->start[x]] + 1);
+  }
+  plan->start[out] = k;
+  plan->maxspan = maxspan;
+
+  dt_free_align(scratch);
+  return plan;
+}
+
+/* ── Plan cache ──────────────────────────────────────────────────────────── */
+
+static _resampling_plan_t *_plan_cache[RESAMPLING_PLAN_CACHE_SIZE];
+static uint64_t _plan_tick = 0;
+static dt_pthread_mutex_t _plan_mutex = { PTHREAD_MUTEX_INITIALIZER };
+
+/* Caller holds _plan_mutex */
+static _resampling_plan_t *_plan_lookup(const enum dt_interpolation_type id,
+                                        const int in, const int out,
+                                        const int shift, const float scale)
+{
+  for(int i = 0; i < RESAMPLING_PLAN_CACHE_SIZE; i++)
+  {
+    _resampling_plan_t *p = _plan_cache[i];
+    if(p && p->id == id && p->in == in && p->out == out
+       && p->shift == shift && p->scale == scale)
+    {
+      p->users++;
+      p->tick = ++_plan_tick;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Return a plan for the given geometry, building it on a miss.  The build
+ * runs outside the lock; if every slot is in use the plan is handed out
+ * uncached and freed again on release.
+ */
+static _resampling_plan_t *_plan_acquire(const dt_interpolation_t *itor,
+                                         const int in, const int out,
+                                         const int shift, const float scale)
+{
+  dt_pthread_mutex_lock(&_plan_mutex);
+  _resampling_plan_t *plan = _plan_lookup(itor->id, in, out, shift, scale);
+  dt_pthread_mutex_unlock(&_plan_mutex);
+  if(plan) return plan;
+
+  plan = _plan_build(itor, in, out, shift, scale);
+  if(!plan) return NULL;
+
+  dt_pthread_mutex_lock(&_plan_mutex);
+  _resampling_plan_t *other = _plan_lookup(itor->id, in, out, shift, scale);
+  if(other)
+  {
+    /* another thread built the same plan meanwhile */
+    dt_pthread_mutex_unlock(&_plan_mutex);
+    _plan_free(plan);
+    return other;
+  }
+
+  int victim = -1;
+  for(int i = 0; i < RESAMPLING_PLAN_CACHE_SIZE; i++)
+  {
+    if(!_plan_cache[i])
+    {
+      victim = i;
+      break;
+    }
+    if(_plan_cache[i]->users == 0
+       && (victim < 0 || _plan_cache[i]->tick < _plan_cache[victim]->tick))
+      victim = i;
+  }
+
+  if(victim >= 0)
+  {
+    _plan_free(_plan_cache[victim]);
+    _plan_cache[victim] = plan;
+    plan->cached = true;
+  }
+  plan->users = 1;
+  plan->tick  = ++_plan_tick;
+  dt_pthread_mutex_unlock(&_plan_mutex);
+
+  return plan;
+}
+
+static void _plan_release(_resampling_plan_t *plan)
+{
+  if(!plan) return;
+
+  dt_pthread_mutex_lock(&_plan_mutex);
+  const bool cached = plan->cached;
+  if(cached) plan->users--;
+  dt_pthread_mutex_unlock(&_plan_mutex);
+
+  if(!cached)
+    _plan_free(plan);
+}
+
+void dt_interpolation_cleanup(void)
+{
+  dt_pthread_mutex_lock(&_plan_mutex);
+  for(int i = 0; i < RESAMPLING_PLAN_CACHE_SIZE; i++)
+  {
+    _plan_free(_plan_cache[i]);
+    _plan_cache[i] = NULL;
+  }
+  _plan_tick = 0;
+  dt_pthread_mutex_unlock(&_plan_mutex);
+}
+
+/* ── Separable resampling ────────────────────────────────────────────────── */
+
+/* Horizontal pass: resample the float-RGBA input rows [row0, row1) into
+   their slots of the ring `hrows`, one column block at a time. */
+static inline void _resample_rows(float *const restrict hrows,
+                                  const int ring,
+                                  const size_t out_stride_floats,
+                                  const float *const restrict in,
+                                  const size_t in_stride_floats,
+                                  const int row0,
+                                  const int row1,
+                                  const _resampling_plan_t *const plan)
+{
+  const int *const restrict start = plan->start;
+  const int *const restrict index = plan->index;
+  const float *const restrict kernel = plan->kernel;
+
+  for(int ox0 = 0; ox0 < plan->out; ox0 += RESAMPLE_COLUMN_BLOCK)
+  {
+    const int ox1 = MIN(plan->out, ox0 + RESAMPLE_COLUMN_BLOCK);
+    for(int row = row0; row < row1; row++)
+    {
+      const dt_aligned_pixel_simd_t *const restrict in_row
+        = (const dt_aligned_pixel_simd_t *)(in + (size_t)row * in_stride_floats);
+      dt_aligned_pixel_simd_t *const restrict hrow
+        = (dt_aligned_pixel_simd_t *)(hrows + (size_t)(row % ring) * out_stride_floats);
+
+      for(int ox = ox0; ox < ox1; ox++)
+      {
+        dt_aligned_pixel_simd_t acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int k = start[ox]; k < start[ox + 1]; k++)
+          acc += kernel[k] * in_row[index[k]];
+        hrow[ox] = acc;
+      }
+    }
+  }
+}
+
+void dt_interpolation_resample(const dt_interpolation_t *itor,
+                               float *out,
+                               const dt_iop_roi_t *const roi_out,
+                               const float *const in,
+                               const dt_iop_roi_t *const roi_in)
+{
+  if(out == NULL)
+  {
+    fprintf(stderr, "[dt_interpolation_resample] no valid output buffer\n");
+    return;
+  }
+
+  const size_t in_stride_floats  = (size_t)4 * roi_in->width;
+  const size_t out_stride_floats = (size_t)4 * roi_out->width;
+
+  const int dx = MAX(0, roi_out->x);
+  const int dy = MAX(0, roi_out->y);
+
+  /* Fast code path for 1:1 copy, only the cropping area can change */
+  if(roi_out->scale == 1.0f)
+  {
+    const size_t x0       = sizeof(float) * 4 * dx;
+    const size_t cp_width = sizeof(float) * 4 * MAX(0, MIN(roi_out->width, roi_in->width - dx));
+    const size_t owidth   = sizeof(float) * out_stride_floats;
+
+    DT_OMP_FOR()
+    for(int row = 0; row < roi_out->height; row++)
+    {
+      uint8_t *o = (uint8_t *)out + owidth * row;
+      if((row + dy) < roi_in->height)
+      {
+        memcpy(o, (const uint8_t *)in + sizeof(float) * in_stride_floats * (row + dy) + x0,
+               cp_width);
+        if(cp_width < owidth)
+          memset(o + cp_width, 0, owidth - cp_width);
+      }
+      else
+        memset(o, 0, owidth);
+    }
+    return;
+  }
+
+  _resampling_plan_t *hplan
+    = _plan_acquire(itor, roi_in->width, roi_out->width, dx, roi_out->scale);
+  _resampling_plan_t *vplan
+    = _plan_acquire(itor, roi_in->height, roi_out->height, dy, roi_out->scale);
+
+  /* Ring of horizontally resampled rows, one per thread, deep enough to
+     hold every input row a single output row depends on and the rows
+     filtered ahead. */
+  const int ring = vplan ? vplan->maxspan + RESAMPLE_ROW_BLOCK : 0;
+  size_t padded_size = 0;
+  float *const hbuf = (hplan && vplan)
+    ? dt_alloc_perthread_float((size_t)ring * out_stride_floats, &padded_size)
+    : NULL;
+
+  if(!hbuf)
+  {
+    fprintf(stderr, "[dt_interpolation_resample] out of memory\n");
+    goto exit;
+  }
+
+  /* One contiguous band of output rows per thread keeps the ring hot and
+     limits repeated horizontal work to the band edges. */
+  const int nbands = MAX(1, MIN(dt_get_num_threads(), roi_out->height));
+  const int band_rows = (roi_out->height + nbands - 1) / nbands;
+
+  DT_OMP_FOR()
+  for(int band = 0; band < nbands; band++)
+  {
+    float *const restrict hrows = dt_get_perthread(hbuf, padded_size);
+    const int oy_end = MIN(roi_out->height, (band + 1) * band_rows);
+    int next_row = -1; /* first input row not yet in the ring */
+
+    /* the last input row of the band, no row past it is filtered ahead */
+    int band_last = -1;
+    for(int oy = band * band_rows; oy < oy_end; oy++)
+      if(vplan->start[oy + 1] > vplan->start[oy])
+        band_last = MAX(band_last, vplan->index[vplan->start[oy + 1] - 1]);
+
+    for(int oy = band * band_rows; oy < oy_end; oy++)
+    {
+      const int k0 = vplan->start[oy];
+      const int k1 = vplan->start[oy + 1];
+      float *const restrict orow = out + (size_t)oy * out_stride_floats;
+
+      if(k1 <= k0)
+      {
+        memset(orow, 0, sizeof(float) * out_stride_floats);
+        continue;
+      }
+
+      /* Filter the input rows this output needs that the ring lacks, and
+         as many following ones as fit.  The first index never decreases,
+         so the rows before `first` are no longer needed. */
+      const int first = vplan->index[k0];
+      const int last  = vplan->index[k1 - 1];
+      if(next_row < first) next_row = first;
+      if(next_row <= last)
+      {
+        const int end = MIN(first + ring - 1, band_last);
+        _resample_rows(hrows, ring, out_stride_floats, in, in_stride_floats,
+                       next_row, end + 1, hplan);
+        next_row = end + 1;
+      }
+
+      /* Vertical pass: weighted sum of whole rows */
+      {
+        const float tap = vplan->kernel[k0];
+        const float *const restrict h
+          = hrows + (size_t)(vplan->index[k0] % ring) * out_stride_floats;
+        DT_OMP_SIMD(aligned(orow, h:16))
+        for(size_t i = 0; i < out_stride_floats; i++)
+          orow[i] = tap * h[i];
+      }
+      for(int k = k0 + 1; k < k1; k++)
+      {
+        const float tap = vplan->kernel[k];
+        const float *const restrict h
+          = hrows + (size_t)(vplan->index[k] % ring) * out_stride_floats;
+        DT_OMP_SIMD(aligned(orow, h:16))
+        for(size_t i = 0; i < out_stride_floats; i++)
+          orow[i] += tap * h[i];
+      }
+
+      /* Clip negatives from Lanczos/bicubic undershoot: light is positive */
+      DT_OMP_SIMD(aligned(orow:16))
+      for(size_t i = 0; i < out_stride_floats; i++)
+        orow[i] = fmaxf(orow[i], 0.0f);
+    }
+  }
+
+exit:
+  dt_free_align(hbuf);
+  _plan_release(hplan);
+  _plan_release(vplan);
+}
+
+void dt_interpolation_resample_roi(const dt_interpolation_t *itor,
+                                   float *out,
+                                   const dt_iop_roi_t *const roi_out,
+                                   const float *const in,
+                                   const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_roi_t oroi = *roi_out;
+  oroi.x = oroi.y = 0;
+
+  dt_iop_roi_t iroi = *roi_in;
+  iroi.x = iroi.y = 0;
+
+  dt_interpolation_resample(itor, out, &oroi, in, &iroi);
+}
+
+/* ── Point sampling ──────────────────────────────────────────────────────── */
+
+/* Room for 2 * MAX_HALF_FILTER_WIDTH taps rounded up to the 4-wide runs the
+   maketaps functions write. */
+#define MAX_KERNEL_REQ ((2 * (MAX_HALF_FILTER_WIDTH) + 3) & (~3))
+
+/* Taps for one sample position; returns the index of the first input pixel
+   and stores the kernel norm. */
+static inline int _compute_sample_kernel(const dt_interpolation_t *itor,
+                                         float *kernel,
+                                         float *norm,
+                                         const float t)
+{
+  const int f = (int)t - (int)itor->width + 1;
+  *norm = itor->maketaps(kernel, 2 * itor->width, itor->width, t - (float)f, -1.0f);
+  return f;
+}
+
+float dt_interpolation_compute_sample(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int samplestride,
+                                      const int linestride)
+{
+  const int ix = (int)x;
+  const int iy = (int)y;
+  if(ix < 0 || iy < 0 || ix >= width || iy >= height)
+    return 0.0f;
+
+  float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+  float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+  float normh, normv;
+  const int x0 = _compute_sample_kernel(itor, kernelh, &normh, x);
+  const int y0 = _compute_sample_kernel(itor, kernelv, &normv, y);
+  const int taps = 2 * itor->width;
+
+  float s = 0.0f;
+  if(x0 >= 0 && y0 >= 0 && x0 + taps <= width && y0 + taps <= height)
+  {
+    /* Inside image boundary: no index clipping */
+    const float *row = in + (size_t)y0 * linestride + (size_t)x0 * samplestride;
+    for(int i = 0; i < taps; i++, row += linestride)
+    {
+      float h = 0.0f;
+      for(int j = 0; j < taps; j++)
+        h += kernelh[j] * row[j * samplestride];
+      s += kernelv[i] * h;
+    }
+  }
+  else
+  {
+    for(int i = 0; i < taps; i++)
+    {
+      const float *row = in + (size_t)_clip(y0 + i, height - 1) * linestride;
+      float h = 0.0f;
+      for(int j = 0; j < taps; j++)
+        h += kernelh[j] * row[(size_t)_clip(x0 + j, width - 1) * samplestride];
+      s += kernelv[i] * h;
+    }
+  }
+  return fmaxf(0.0f, s / (normh * normv));
+}
+
+void dt_interpolation_compute_pixel4c(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      float *out,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int linestride)
+{
+  const int ix = (int)x;
+  const int iy = (int)y;
+  if(ix < 0 || iy < 0 || ix >= width || iy >= height)
+  {
+    for_four_channels(c, aligned(out))
+      out[c] = 0.0f;
+    return;
+  }
+
+  float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+  float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+  float normh, normv;
+  const int x0 = _compute_sample_kernel(itor, kernelh, &normh, x);
+  const int y0 = _compute_sample_kernel(itor, kernelv, &normv, y);
+  const int taps = 2 * itor->width;
+  const float oonorm = 1.0f / (normh * normv);
+
+  /* Each tap is a whole 16-byte pixel: the horizontal pass is a 4-wide
+     multiply-add per tap, the vertical pass one more per row. */
+  dt_aligned_pixel_t pixel = { 0.0f, 0.0f, 0.0f, 0.0f };
+  if(x0 >= 0 && y0 >= 0 && x0 + taps <= width && y0 + taps <= height)
+  {
+    const float *row = in + (size_t)y0 * linestride + (size_t)4 * x0;
+    for(int i = 0; i < taps; i++, row += linestride)
+    {
+      dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int j = 0; j < taps; j++)
+      {
+        const float k = kernelh[j];
+        for_four_channels(c)
+          h[c] += k * row[4 * j + c];
+      }
+      for_four_channels(c)
+        pixel[c] += kernelv[i] * h[c];
+    }
+  }
+  else
+  {
+    for(int i = 0; i < taps; i++)
+    {
+      const float *row = in + (size_t)_clip(y0 + i, height - 1) * linestride;
+      dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int j = 0; j < taps; j++)
+      {
+        const float *px = row + (size_t)4 * _clip(x0 + j, width - 1);
+        const float k = kernelh[j];
+        for_four_channels(c)
+          h[c] += k * px[c];
+      }
+      for_four_channels(c)
+        pixel[c] += kernelv[i] * h[c];
+    }
+  }
+
+  for_four_channels(c, aligned(out))
+    out[c] = fmaxf(0.0f, oonorm * pixel[c]);
+}
+
+#undef MAX_KERNEL_REQ
+
+/* ── Clip-and-zoom ───────────────────────────────────────────────────────── */
+
+void dt_iop_clip_and_zoom(float *out,
+                          const float *const in,
+                          const dt_iop_roi_t *const roi_out,
+                          const dt_iop_roi_t *const roi_in)
+{
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  dt_interpolation_resample(itor, out, roi_out, in, roi_in);
+}
+
+#undef MAX_HALF_FILTER_WIDTH
+#undef RESAMPLING_PLAN_CACHE_SIZE
+#undef RESAMPLE_COLUMN_BLOCK
+#undef RESAMPLE_ROW_BLOCK
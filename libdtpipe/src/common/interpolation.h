@@ -0,0 +1,106 @@
+/*
+ * interpolation.h - Pixel interpolators and plan-cached image resampling
+ *
+ * Ported from darktable src/common/interpolation.h
+ * Copyright (C) 2012-2025 darktable developers.
+ *
+ * Stripped of: OpenCL resampling entry points.
+ * Changes: resampling plans are cached process-wide and the resampler runs
+ * as two separable passes instead of one 2-D kernel per output pixel.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum dt_interpolation_type
+{
+  DT_INTERPOLATION_FIRST = 0,                         /* helper for iteration */
+  DT_INTERPOLATION_BILINEAR = DT_INTERPOLATION_FIRST, /* tent filter */
+  DT_INTERPOLATION_BICUBIC,                           /* bicubic, a = -0.5 */
+  DT_INTERPOLATION_LANCZOS2,                          /* Lanczos, 2 lobes */
+  DT_INTERPOLATION_LANCZOS3,                          /* Lanczos, 3 lobes */
+  DT_INTERPOLATION_LAST,                              /* helper for iteration */
+  DT_INTERPOLATION_DEFAULT = DT_INTERPOLATION_BILINEAR,
+  DT_INTERPOLATION_DEFAULT_WARP = DT_INTERPOLATION_BICUBIC,
+  /* explicit values: must not alias the real interpolator ids above */
+  DT_INTERPOLATION_USERPREF = DT_INTERPOLATION_LAST + 1, /* user setting, else DEFAULT */
+  DT_INTERPOLATION_USERPREF_WARP                         /* user setting, else DEFAULT_WARP */
+};
+
+typedef float (*dt_interpolation_func)(float *taps,
+                                       size_t num_taps,
+                                       float width,
+                                       float first_tap,
+                                       float interval);
+
+typedef struct dt_interpolation_t
+{
+  enum dt_interpolation_type id;  /* id such as defined by dt_interpolation_type */
+  const char *name;               /* internal name */
+  size_t width;                   /* half width of the kernel support */
+  dt_interpolation_func maketaps; /* kernel function */
+} dt_interpolation_t;
+
+/**
+ * Look up an interpolator.  USERPREF / USERPREF_WARP consult the config
+ * (always empty in libdtpipe) and fall back to DEFAULT / DEFAULT_WARP.
+ */
+const dt_interpolation_t *dt_interpolation_new(enum dt_interpolation_type type);
+
+/**
+ * Sample one channel at (x, y).  `in` points at the channel of the first
+ * pixel; samplestride / linestride are in floats.  Border pixels are
+ * replicated, coordinates outside the image return 0.
+ */
+float dt_interpolation_compute_sample(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int samplestride,
+                                      const int linestride);
+
+/**
+ * Sample all four channels of a float-RGBA buffer at (x, y) with one set
+ * of taps.  linestride is in floats.
+ */
+void dt_interpolation_compute_pixel4c(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      float *out,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int linestride);
+
+/**
+ * Resample a float-RGBA buffer.  `in` holds the full roi_in; roi_out->x/y
+ * is the offset of the output window in scaled coordinates and
+ * roi_out->scale the output/input ratio.  Negative results are clamped.
+ */
+void dt_interpolation_resample(const dt_interpolation_t *itor, float *out,
+                               const dt_iop_roi_t *const roi_out,
+                               const float *const in,
+                               const dt_iop_roi_t *const roi_in);
+
+/**
+ * Same as dt_interpolation_resample() but both buffers hold exactly their
+ * ROI; the output window starts at the input window's origin.
+ */
+void dt_interpolation_resample_roi(const dt_interpolation_t *itor, float *out,
+                                   const dt_iop_roi_t *const roi_out,
+                                   const float *const in,
+                                   const dt_iop_roi_t *const roi_in);
+
+/** Release every cached resampling plan (called from dtpipe_cleanup()). */
+void dt_interpolation_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
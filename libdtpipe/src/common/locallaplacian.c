@@ -0,0 +1,583 @@
+/*
+ * locallaplacian.c - Local laplacian filter on the L channel
+ *
+ * See locallaplacian.h.
+ */
+
+#include "common/locallaplacian.h"
+#include "iop/iop_math.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the maximum number of levels for the gaussian pyramid
+#define max_levels 30
+// the number of segments for the piecewise linear interpolation
+#define num_gamma 6
+
+// number of fine pyramid levels built per tile.  Level LL_TILE_LEVELS of
+// the whole image is 1/256 of its padded size and is all that is kept
+// image-wide.
+#define LL_TILE_LEVELS 4
+// tile core and overlap margin, in pixels of level LL_TILE_LEVELS (x16 at
+// full resolution).  The margin must cover the boundary fill of the tile
+// pyramids: 4 coarse pixels are enough, 6 leaves headroom.
+#define LL_TILE_CORE 32
+#define LL_TILE_MARGIN 6
+
+// downsample width/height to given level
+static inline int dl(int size, const int level)
+{
+  for(int l=0;l<level;l++)
+    size = (size-1)/2+1;
+  return size;
+}
+
+// needs a boundary of 1 or 2px around i,j or else it will crash.
+// (translates to a 1px boundary around the corresponding pixel in the coarse buffer)
+// more precisely, 1<=i<wd-1 for even wd and
+//                 1<=i<wd-2 for odd wd (j likewise with ht)
+static inline float ll_expand_gaussian(
+    const float *const coarse,
+    const int i,
+    const int j,
+    const int wd,
+    const int ht)
+{
+  assert(i > 0);
+  assert(i < wd-1);
+  assert(j > 0);
+  assert(j < ht-1);
+  assert(j/2 + 1 < (ht-1)/2+1);
+  assert(i/2 + 1 < (wd-1)/2+1);
+  const int cw = (wd-1)/2+1;
+  const int ind = (j/2)*cw+i/2;
+  // case 0:     case 1:     case 2:     case 3:
+  //  x . x . x   x . x . x   x . x . x   x . x . x
+  //  . . . . .   . . . . .   . .[.]. .   .[.]. . .
+  //  x .[x]. x   x[.]x . x   x . x . x   x . x . x
+  //  . . . . .   . . . . .   . . . . .   . . . . .
+  //  x . x . x   x . x . x   x . x . x   x . x . x
+  switch((i&1) + 2*(j&1))
+  {
+    case 0: // both are even, 3x3 stencil
+      return 4./256. * (
+          6.0f*(coarse[ind-cw] + coarse[ind-1] + 6.0f*coarse[ind] + coarse[ind+1] + coarse[ind+cw])
+          + coarse[ind-cw-1] + coarse[ind-cw+1] + coarse[ind+cw-1] + coarse[ind+cw+1]);
+    case 1: // i is odd, 2x3 stencil
+      return 4./256. * (
+          24.0*(coarse[ind] + coarse[ind+1]) +
+          4.0*(coarse[ind-cw] + coarse[ind-cw+1] + coarse[ind+cw] + coarse[ind+cw+1]));
+    case 2: // j is odd, 3x2 stencil
+      return 4./256. * (
+          24.0*(coarse[ind] + coarse[ind+cw]) +
+          4.0*(coarse[ind-1] + coarse[ind+1] + coarse[ind+cw-1] + coarse[ind+cw+1]));
+    default: // case 3: // both are odd, 2x2 stencil
+      return .25f * (coarse[ind] + coarse[ind+1] + coarse[ind+cw] + coarse[ind+cw+1]);
+  }
+}
+
+// helper to fill in one pixel boundary by copying it
+static inline void ll_fill_boundary1(
+    float *const input,
+    const int wd,
+    const int ht)
+{
+  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
+  for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
+  memcpy(input,    input+wd, sizeof(float)*wd);
+  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
+}
+
+// helper to fill in two pixels boundary by copying it
+static inline void ll_fill_boundary2(
+    float *const input,
+    const int wd,
+    const int ht)
+{
+  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
+  if(wd & 1) for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
+  else       for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2] = input[j*wd+wd-3];
+  memcpy(input, input+wd, sizeof(float)*wd);
+  if(!(ht & 1)) memcpy(input+wd*(ht-2), input+wd*(ht-3), sizeof(float)*wd);
+  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
+}
+
+static inline void gauss_expand(
+    const float *const input, // coarse input
+    float *const fine,        // upsampled, blurry output
+    const int wd,             // fine res
+    const int ht)
+{
+  DT_OMP_FOR(collapse(2))
+  for(int j=1;j<((ht-1)&~1);j++)  // even ht: two px boundary. odd ht: one px.
+    for(int i=1;i<((wd-1)&~1);i++)
+      fine[j*wd+i] = ll_expand_gaussian(input, i, j, wd, ht);
+  ll_fill_boundary2(fine, wd, ht);
+}
+
+static inline void _convolve_14641_vert(dt_aligned_pixel_t conv, const float *in, const size_t wd)
+{
+  static const dt_aligned_pixel_t four = { 4.f, 4.f, 4.f, 4.f };
+  dt_aligned_pixel_t r0, r1, r2, r3, r4;
+  for_four_channels(c)
+  {
+    // 'in' is only 4-byte aligned, so we can't use copy_pixel here
+    r0[c] = in[c];
+    r1[c] = in[wd+c];
+    r2[c] = in[2*wd+c];
+    r3[c] = in[3*wd+c];
+    r4[c] = in[4*wd+c];
+  }
+  dt_aligned_pixel_t t;
+  for_four_channels(c)
+  {
+    r0[c] = r0[c] + r4[c];		// r0 = r0+r4
+    r1[c] = r1[c] + r2[c] + r3[c];	// r1 = r1+r2+r2
+    r0[c] = r0[c] + r2[c] + r2[c];	// r0 = r0 + 2*r2 * r4
+    t[c] = r1[c] * four[c];		// t = 4*r1 + 4*r2 + r*43
+    conv[c] = r0[c] + t[c];		// conv = r0 + 4*r1 + 6*r2 + 4*r3 + r4
+  }
+}
+
+static inline void gauss_reduce(
+    const float *const input, // fine input buffer
+    float *const coarse,      // coarse scale, blurred input buf
+    const size_t wd,             // fine res
+    const size_t ht)
+{
+  // blur, store only coarse res
+  const size_t cw = (wd-1)/2+1, ch = (ht-1)/2+1;
+  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
+  // is greater than the time needed to do it sequentially
+  DT_OMP_FOR(if(ch*cw>2000))
+  for(size_t j=1;j<ch-1;j++)
+  {
+    const float *base = input + 2*(j-1)*wd;
+    float *const out = coarse + j*cw + 1;
+    // prime the vertical axis
+    static const dt_aligned_pixel_t kernel = { 1.0f, 4.0f, 6.0f, 4.0f };
+    dt_aligned_pixel_t left;
+    _convolve_14641_vert(left,base,wd);
+    for(size_t col=0; col<cw-3; col += 2)
+    {
+      // convolve the next four pixel wide vertical slice
+      base += 4;
+      dt_aligned_pixel_t right;
+      _convolve_14641_vert(right,base,wd);
+      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
+      // the first uses pixels 0-4, the second uses 2-6
+      dt_aligned_pixel_t conv;
+      for_four_channels(c)
+        conv[c] = left[c] * kernel[c];
+      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.0f;
+      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6.0f*right[0] + right[2]) / 256.0f;
+      // shift to next pair of output columns (four input columns)
+      copy_pixel(left, right);
+    }
+    // handle the left-over pixel if the output size is odd
+    if(cw % 2)
+    {
+      base += 4;
+      // convolve the right-most column
+      float right = base[0] + 4.0f*(base[wd]+base[3*wd]) + 6.0f*base[2*wd] + base[4*wd];
+      dt_aligned_pixel_t conv;
+      for_four_channels(c)
+        conv[c] = left[c] * kernel[c];
+      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.0f;
+    }
+  }
+  dt_omploop_sfence();
+  ll_fill_boundary1(coarse, cw, ch);
+}
+
+static inline float ll_laplacian(
+    const float *const coarse,   // coarse res gaussian
+    const float *const fine,     // fine res gaussian
+    const int i,                 // fine index
+    const int j,
+    const int wd,                // fine width
+    const int ht)                // fine height
+{
+  const float c = ll_expand_gaussian(coarse,
+      CLAMPS(i, 1, ((wd-1)&~1)-1), CLAMPS(j, 1, ((ht-1)&~1)-1), wd, ht);
+  return fine[j*wd+i] - c;
+}
+
+static inline float curve_scalar(
+    const float x,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  const float c = x-g;
+  float val;
+  // blend in via quadratic bezier
+  if     (c >  2*sigma) val = g + sigma + shadows    * (c-sigma);
+  else if(c < -2*sigma) val = g - sigma + highlights * (c+sigma);
+  else if(c > 0.0f)
+  { // shadow contrast
+    const float t = CLAMPS(c / (2.0f*sigma), 0.0f, 1.0f);
+    const float t2 = t * t;
+    const float mt = 1.0f-t;
+    val = g + sigma * 2.0f*mt*t + t2*(sigma + sigma*shadows);
+  }
+  else
+  { // highlight contrast
+    const float t = CLAMPS(-c / (2.0f*sigma), 0.0f, 1.0f);
+    const float t2 = t * t;
+    const float mt = 1.0f-t;
+    val = g - sigma * 2.0f*mt*t + t2*(- sigma - sigma*highlights);
+  }
+  // midtone local contrast
+  val += clarity * c * dt_fast_expf(-c*c/(2.0f*sigma*sigma/3.0f));
+  return val;
+}
+
+// the padded input is replicated at the edges, so the curve of it is the
+// replicated curve and can be evaluated pointwise everywhere
+static void apply_curve(
+    float *const out,
+    const float *const in,
+    const size_t n,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  DT_OMP_FOR_SIMD()
+  for(size_t k=0;k<n;k++)
+    out[k] = curve_scalar(in[k], g, sigma, shadows, highlights, clarity);
+}
+
+// add the laplacian coefficients of level l to the expanded coarser output:
+// for each pixel, interpolate between the two remapped pyramids whose
+// gamma bracket the pixel's own gaussian value
+static void ll_collapse_level(
+    float *const output,               // output[l], holds the expanded output[l+1]
+    const float *const padded,         // gaussian of the input at level l
+    float *const buf_fine[num_gamma],  // remapped gaussians at level l
+    float *const buf_coarse[num_gamma],// remapped gaussians at level l+1
+    const float gamma[num_gamma],
+    const int pw,
+    const int ph)
+{
+  DT_OMP_FOR(collapse(2))
+  for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+  {
+    const float v = padded[j*pw+i];
+    int hi = 1;
+    for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
+    int lo = hi-1;
+    const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+    const float l0 = ll_laplacian(buf_coarse[lo], buf_fine[lo], i, j, pw, ph);
+    const float l1 = ll_laplacian(buf_coarse[hi], buf_fine[hi], i, j, pw, ph);
+    output[j*pw+i] += l0 * (1.0f-a) + l1 * a;
+  }
+}
+
+/* ── Tiled fine levels ───────────────────────────────────────────────────── */
+
+typedef struct ll_geometry_t
+{
+  int wd, ht;            // input size
+  int w, h;              // padded size
+  int max_supp;          // padding on every side, 2^last_level
+  int last_level;        // coarsest pyramid level
+  int tile_levels;       // levels built per tile
+  int wt, ht_t;          // padded size at level tile_levels
+  int tiles_x, tiles_y;  // tile grid
+  int tile_w, tile_h;    // largest tile, level 0
+} ll_geometry_t;
+
+typedef struct ll_tile_t
+{
+  int x0, y0;            // origin in the padded image, level 0
+  int w, h;              // size, level 0
+  int cx0, cy0, cx1, cy1;// core written back by this tile, level tile_levels
+  float *padded[LL_TILE_LEVELS + 1];
+  float *output[LL_TILE_LEVELS + 1];
+  float *buf[LL_TILE_LEVELS + 1][num_gamma];
+} ll_tile_t;
+
+static void ll_geometry(ll_geometry_t *g, const int wd, const int ht)
+{
+  g->wd = wd;
+  g->ht = ht;
+  // don't divide by 2 more often than we can:
+  const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(wd,ht)));
+  g->last_level = num_levels-1;
+  g->max_supp = 1<<g->last_level;
+  g->w = wd + 2*g->max_supp;
+  g->h = ht + 2*g->max_supp;
+  g->tile_levels = MIN(LL_TILE_LEVELS, g->last_level);
+  g->wt = dl(g->w, g->tile_levels);
+  g->ht_t = dl(g->h, g->tile_levels);
+  g->tiles_x = (g->wt + LL_TILE_CORE - 1) / LL_TILE_CORE;
+  g->tiles_y = (g->ht_t + LL_TILE_CORE - 1) / LL_TILE_CORE;
+  g->tile_w = MIN(g->w, (LL_TILE_CORE + 2*LL_TILE_MARGIN) << g->tile_levels);
+  g->tile_h = MIN(g->h, (LL_TILE_CORE + 2*LL_TILE_MARGIN) << g->tile_levels);
+}
+
+// place tile (tx, ty): the core in level-tile_levels pixels plus the margin,
+// clipped to the padded image.  Tile origins are multiples of
+// 2^tile_levels, so every tile level is sampled on the image-wide grid.
+static void ll_tile_place(ll_tile_t *t, const ll_geometry_t *g, const int tx, const int ty)
+{
+  const int T = g->tile_levels;
+  t->cx0 = tx * LL_TILE_CORE;
+  t->cy0 = ty * LL_TILE_CORE;
+  t->cx1 = MIN(t->cx0 + LL_TILE_CORE, g->wt);
+  t->cy1 = MIN(t->cy0 + LL_TILE_CORE, g->ht_t);
+  const int sx = MAX(0, t->cx0 - LL_TILE_MARGIN), ex = MIN(g->wt, t->cx1 + LL_TILE_MARGIN);
+  const int sy = MAX(0, t->cy0 - LL_TILE_MARGIN), ey = MIN(g->ht_t, t->cy1 + LL_TILE_MARGIN);
+  t->x0 = sx << T;
+  t->y0 = sy << T;
+  // a tile reaching the far edge ends where the padded image does, so
+  // its boundary fill is the image's own
+  t->w = ex == g->wt ? g->w - t->x0 : (ex - sx) << T;
+  t->h = ey == g->ht_t ? g->h - t->y0 : (ey - sy) << T;
+}
+
+static void ll_tile_free(ll_tile_t *t)
+{
+  for(int l=0;l<=LL_TILE_LEVELS;l++)
+  {
+    dt_free_align(t->padded[l]);
+    dt_free_align(t->output[l]);
+    for(int k=0;k<num_gamma;k++) dt_free_align(t->buf[l][k]);
+  }
+  memset(t, 0, sizeof(*t));
+}
+
+static gboolean ll_tile_alloc(ll_tile_t *t, const ll_geometry_t *g)
+{
+  memset(t, 0, sizeof(*t));
+  for(int l=0;l<=g->tile_levels;l++)
+  {
+    const size_t size = (size_t)dl(g->tile_w,l) * dl(g->tile_h,l);
+    t->padded[l] = dt_alloc_align_float(size);
+    t->output[l] = dt_alloc_align_float(size);
+    if(!t->padded[l] || !t->output[l]) return FALSE;
+    for(int k=0;k<num_gamma;k++)
+      if(!(t->buf[l][k] = dt_alloc_align_float(size))) return FALSE;
+  }
+  return TRUE;
+}
+
+// build the gaussian pyramid of the tile's window of the padded input and
+// of its num_gamma remapped copies, levels 0..tile_levels
+static void ll_tile_build(
+    ll_tile_t *t,
+    const ll_geometry_t *g,
+    const float *const input,
+    const float gamma[num_gamma],
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  // brightness channel of the padded input, replicated past the edges
+  const int supp = g->max_supp;
+  float *const pad0 = t->padded[0];
+  DT_OMP_FOR()
+  for(int j=0;j<t->h;j++)
+  {
+    const int y = CLAMPS(t->y0 + j - supp, 0, g->ht-1);
+    const float *const row = input + (size_t)4 * g->wd * y;
+    for(int i=0;i<t->w;i++)
+    {
+      const int x = CLAMPS(t->x0 + i - supp, 0, g->wd-1);
+      pad0[(size_t)j*t->w+i] = row[4*x] * 0.01f; // L -> [0,1]
+    }
+  }
+  for(int l=1;l<=g->tile_levels;l++)
+    gauss_reduce(t->padded[l-1], t->padded[l], dl(t->w,l-1), dl(t->h,l-1));
+
+  // the paper says remapping only level 3 not 0 does the trick, too
+  // (but i really like the additional octave of sharpness we get,
+  // willing to pay the cost).
+  for(int k=0;k<num_gamma;k++)
+  {
+    apply_curve(t->buf[0][k], pad0, (size_t)t->w * t->h, gamma[k], sigma, shadows, highlights, clarity);
+    for(int l=1;l<=g->tile_levels;l++)
+      gauss_reduce(t->buf[l-1][k], t->buf[l][k], dl(t->w,l-1), dl(t->h,l-1));
+  }
+}
+
+// copy the core rows of a tile level into an image-wide level, or the
+// tile's whole window of an image-wide level into the tile
+static void ll_tile_copy(float *const dst, const int dst_stride,
+                         const float *const src, const int src_stride,
+                         const int w, const int h)
+{
+  for(int j=0;j<h;j++)
+    memcpy(dst + (size_t)j*dst_stride, src + (size_t)j*src_stride, sizeof(float)*w);
+}
+
+void local_laplacian(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity)        // user param: increase clarity/local contrast
+{
+  if(wd <= 1 || ht <= 1) return;
+
+  ll_geometry_t g;
+  ll_geometry(&g, wd, ht);
+  const int T = g.tile_levels;
+  const int last_level = g.last_level;
+  const int w = g.w, h = g.h;
+
+  // evenly sample brightness [0,1]:
+  float gamma[num_gamma] = {0.0f};
+  for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
+
+  // image-wide coarse levels T..last_level
+  float *padded[max_levels] = {0};
+  float *output[max_levels] = {0};
+  float *buf[max_levels][num_gamma] = {{0}};
+  ll_tile_t tile;
+  gboolean success = ll_tile_alloc(&tile, &g);
+  for(int l=T;l<=last_level && success;l++)
+  {
+    const size_t size = (size_t)dl(w,l) * dl(h,l);
+    padded[l] = dt_alloc_align_float(size);
+    // the coarsest output is the gaussian of the input itself
+    output[l] = l < last_level ? dt_alloc_align_float(size) : padded[l];
+    success = padded[l] && output[l];
+    for(int k=0;k<num_gamma && success;k++)
+      success = (buf[l][k] = dt_alloc_align_float(size)) != NULL;
+  }
+
+  if(!success)
+  {
+    // copy the input buffer to the output so that we at least get a
+    // valid result
+    for(size_t k = 0; k < (size_t)4 * wd * ht; k++)
+      out[k] = input[k];
+    goto cleanup;
+  }
+
+  // pass 1: level T of every tile, collected into the image-wide buffers
+  for(int ty=0;ty<g.tiles_y;ty++) for(int tx=0;tx<g.tiles_x;tx++)
+  {
+    ll_tile_place(&tile, &g, tx, ty);
+    ll_tile_build(&tile, &g, input, gamma, sigma, shadows, highlights, clarity);
+    const int tw = dl(tile.w,T);
+    const int ox = tile.cx0 - (tile.x0 >> T), oy = tile.cy0 - (tile.y0 >> T);
+    const size_t src = (size_t)oy * tw + ox;
+    const size_t dst = (size_t)tile.cy0 * g.wt + tile.cx0;
+    const int cw = tile.cx1 - tile.cx0, ch = tile.cy1 - tile.cy0;
+    ll_tile_copy(padded[T] + dst, g.wt, tile.padded[T] + src, tw, cw, ch);
+    for(int k=0;k<num_gamma;k++)
+      ll_tile_copy(buf[T][k] + dst, g.wt, tile.buf[T][k] + src, tw, cw, ch);
+  }
+  const gboolean single_tile = g.tiles_x == 1 && g.tiles_y == 1;
+
+  // coarse levels over the whole image
+  for(int l=T+1;l<=last_level;l++)
+  {
+    gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
+    for(int k=0;k<num_gamma;k++)
+      gauss_reduce(buf[l-1][k], buf[l][k], dl(w,l-1), dl(h,l-1));
+  }
+  for(int l=last_level-1;l >= T; l--)
+  {
+    const int pw = dl(w,l), ph = dl(h,l);
+    gauss_expand(output[l+1], output[l], pw, ph);
+    ll_collapse_level(output[l], padded[l], buf[l], buf[l+1], gamma, pw, ph);
+  }
+
+  // pass 2: fine levels of the tiles covering the image, collapsed onto
+  // the image-wide level T
+  for(int ty=0;ty<g.tiles_y;ty++) for(int tx=0;tx<g.tiles_x;tx++)
+  {
+    ll_tile_place(&tile, &g, tx, ty);
+    // rows and columns of the input this tile's core writes
+    const int i0 = MAX((tile.cx0 << T) - g.max_supp, 0);
+    const int i1 = MIN(tile.cx1 == g.wt ? w : (tile.cx1 << T), w) - g.max_supp;
+    const int j0 = MAX((tile.cy0 << T) - g.max_supp, 0);
+    const int j1 = MIN(tile.cy1 == g.ht_t ? h : (tile.cy1 << T), h) - g.max_supp;
+    if(MIN(i1, wd) <= i0 || MIN(j1, ht) <= j0) continue; // only padding
+
+    if(!single_tile)
+      ll_tile_build(&tile, &g, input, gamma, sigma, shadows, highlights, clarity);
+    const int tw = dl(tile.w,T), th = dl(tile.h,T);
+    ll_tile_copy(tile.output[T], tw,
+                 output[T] + (size_t)(tile.y0 >> T) * g.wt + (tile.x0 >> T), g.wt, tw, th);
+    for(int l=T-1;l>=0;l--)
+    {
+      const int pw = dl(tile.w,l), ph = dl(tile.h,l);
+      gauss_expand(tile.output[l+1], tile.output[l], pw, ph);
+      ll_collapse_level(tile.output[l], tile.padded[l], tile.buf[l], tile.buf[l+1], gamma, pw, ph);
+    }
+
+    const float *const fine = tile.output[0];
+    const int ie = MIN(i1, wd), je = MIN(j1, ht);
+    DT_OMP_FOR()
+    for(int j=j0;j<je;j++)
+    {
+      const float *const row = fine + (size_t)(j + g.max_supp - tile.y0) * tile.w
+                               + g.max_supp - tile.x0;
+      for(int i=i0;i<ie;i++)
+      {
+        const size_t k = (size_t)4 * ((size_t)j*wd+i);
+        out[k+0] = 100.0f * row[i]; // [0,1] -> L
+        out[k+1] = input[k+1]; // copy original colour channels
+        out[k+2] = input[k+2];
+      }
+    }
+  }
+
+cleanup:
+  ll_tile_free(&tile);
+  for(int l=0;l<max_levels;l++)
+  {
+    if(output[l] != padded[l]) dt_free_align(output[l]);
+    dt_free_align(padded[l]);
+    for(int k=0;k<num_gamma;k++) dt_free_align(buf[l][k]);
+  }
+}
+
+size_t local_laplacian_memory_use(const int width,     // width of input image
+                                  const int height)    // height of input image
+{
+  ll_geometry_t g;
+  ll_geometry(&g, width, height);
+
+  size_t memory_use = 0;
+  // one tile's pyramids
+  for(int l=0;l<=g.tile_levels;l++)
+    memory_use += sizeof(float) * (2 + num_gamma) * dl(g.tile_w, l) * dl(g.tile_h, l);
+  // the image-wide coarse levels
+  for(int l=g.tile_levels;l<=g.last_level;l++)
+    memory_use += sizeof(float) * (2 + num_gamma) * dl(g.w, l) * dl(g.h, l);
+
+  return memory_use;
+}
+
+size_t local_laplacian_singlebuffer_size(const int width,     // width of input image
+                                         const int height)    // height of input image
+{
+  ll_geometry_t g;
+  ll_geometry(&g, width, height);
+
+  return sizeof(float) * MAX((size_t)g.tile_w * g.tile_h, (size_t)g.wt * g.ht_t);
+}
+
+#undef max_levels
+#undef num_gamma
+#undef LL_TILE_LEVELS
+#undef LL_TILE_CORE
+#undef LL_TILE_MARGIN
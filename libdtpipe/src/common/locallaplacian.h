@@ -0,0 +1,54 @@
+/*
+ * locallaplacian.h - Local laplacian filter on the L channel
+ *
+ * Ported from darktable src/common/locallaplacian.c
+ * Copyright (C) 2016-2024 darktable developers.
+ *
+ * Stripped of: the OpenCL path (locallaplaciancl.c) and the
+ * local_laplacian_boundary_t handshake through which darkroom's preview
+ * pipe pads the full pipe's roi (libdtpipe always renders the whole roi
+ * it was given).
+ *
+ * Changes: darktable pads the whole image by 2^(levels-1) pixels on every
+ * side (ll_pad_input) and keeps eight full pyramids of that padded copy
+ * alive at once, several times the image size.  Here the fine levels are
+ * built tile by tile from a window of the input with replicated edges, so
+ * only one tile's pyramids and the small coarse levels of the whole image
+ * are held at any time.  A first pass collects level LL_TILE_LEVELS of
+ * every tile into image-wide buffers, the coarse levels are assembled from
+ * those, and a second pass rebuilds the tiles that cover the image and
+ * collapses their fine levels onto the coarse result.  Tiles overlap by a
+ * margin wide enough for the boundary fill of the tile pyramids not to
+ * reach the part each tile writes, so the result matches the untiled
+ * filter to floating-point rounding.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void local_laplacian(
+    const float *const input,   // input buffer in some Labx or yuvx format
+    float *const out,           // output buffer with colour
+    const int wd,               // width and
+    const int ht,               // height of the input buffer
+    const float sigma,          // user param: separate shadows/mid-tones/highlights
+    const float shadows,        // user param: lift shadows
+    const float highlights,     // user param: compress highlights
+    const float clarity);       // user param: increase clarity/local contrast
+
+size_t local_laplacian_memory_use(const int width,      // width of input image
+                                  const int height);    // height of input image
+
+size_t local_laplacian_singlebuffer_size(const int width,       // width of input image
+                                         const int height);     // height of input image
+
+#ifdef __cplusplus
+}
+#endif
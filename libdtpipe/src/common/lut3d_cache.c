@@ -0,0 +1,637 @@
+/*
+ * lut3d_cache.c - Process-wide cache of parsed 3D LUT files
+ *
+ * See lut3d_cache.h for the node layout and the cache key.
+ */
+
+#include "common/lut3d_cache.h"
+
+#include <math.h>
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+/* ── Helpers ─────────────────────────────────────────────────────────────── */
+
+static gboolean _has_suffix(const char *path, const char *suffix)
+{
+  const size_t n = strlen(path);
+  const size_t m = strlen(suffix);
+  return n >= m && strcasecmp(path + n - m, suffix) == 0;
+}
+
+static float *_alloc_clut(const uint16_t level)
+{
+  const size_t nodes = (size_t)level * level * level;
+  /* zeroed, so the padding lane is 0 */
+  return dt_calloc_align_float(4 * nodes);
+}
+
+/* ── .cube parser ────────────────────────────────────────────────────────── */
+
+// provided by @rabauke, atof replaces strtod & sccanf which are locale dependent
+static double _dt_atof(const char *str)
+{
+  if(strncmp(str, "nan", 3) == 0 || strncmp(str, "NAN", 3) == 0)
+    return NAN;
+  double integral_result = 0;
+  double fractional_result = 0;
+  double sign = 1;
+  if(*str == '+')
+  {
+    str++;
+    sign = +1;
+  }
+  else if(*str == '-')
+  {
+    str++;
+    sign = -1;
+  }
+  if(strncmp(str, "inf", 3) == 0 || strncmp(str, "INF", 3) == 0)
+    return sign * INFINITY;
+  // search for end of integral part and parse from
+  // right to left for numerical stability
+  const char *istr_back = str;
+  while(*str >= '0' && *str <= '9')
+    str++;
+  const char *istr_2 = str;
+  double imultiplier = 1;
+  while(istr_2 != istr_back)
+  {
+    --istr_2;
+    integral_result += (*istr_2 - '0') * imultiplier;
+    imultiplier *= 10;
+  }
+  if(*str == '.')
+  {
+    str++;
+    // search for end of fractional part and parse from
+    // right to left for numerical stability
+    const char *fstr_back = str;
+    while(*str >= '0' && *str <= '9')
+      str++;
+    const char *fstr_2 = str;
+    double fmultiplier = 1;
+    while(fstr_2 != fstr_back)
+    {
+      --fstr_2;
+      fractional_result += (*fstr_2 - '0') * fmultiplier;
+      fmultiplier *= 10;
+    }
+    fractional_result /= fmultiplier;
+  }
+  double result = sign * (integral_result + fractional_result);
+  if(*str == 'e' || *str == 'E')
+  {
+    str++;
+    double power_sign = 1;
+    if(*str == '+')
+    {
+      str++;
+      power_sign = +1;
+    }
+    else if(*str == '-')
+    {
+      str++;
+      power_sign = -1;
+    }
+    double power = 0;
+    while(*str >= '0' && *str <= '9')
+    {
+      power *= 10;
+      power += *str - '0';
+      str++;
+    }
+    if(power_sign > 0)
+      result *= pow(10, power);
+    else
+      result /= pow(10, power);
+  }
+  return result;
+}
+
+// return max 3 tokens from the line (separator = ' ' and token length = 50)
+// if nb tokens > 3, the 3rd one captures the last input
+static uint8_t _parse_cube_line(char *line, char (*token)[50])
+{
+  const int max_token_len = 50;
+  uint8_t i = 0;
+  uint8_t c = 0;
+  char *t = &token[0][0];
+  char *l = line;
+
+  while(*l != 0 && i < max_token_len)
+  {
+    if(*l == '#' || *l == '\n' || *l == '\r')
+    { // end of useful part of the line
+      *t = 0;
+      if(i > 0) c++;
+      return c;
+    }
+    if(*l == ' ' || *l == '\t')
+    { // separator
+      if(i > 0)
+      {
+        *t = 0;
+        c++;
+        i = 0;
+        t = &token[c > 2 ? 2 : c][0];
+      }
+    }
+    else
+    { // capture info
+      *t = *l;
+      t++;
+      i++;
+    }
+    l++;
+    // sometimes the last lf is missing
+    if(*l == 0)
+    {
+      *t = 0;
+      c++;
+      return c;
+    }
+  }
+  token[0][max_token_len - 1] = 0;
+  token[1][max_token_len - 1] = 0;
+  token[2][max_token_len - 1] = 0;
+  return c;
+}
+
+static uint16_t _load_cube(const char *const filepath, float **clut)
+{
+  char *line = NULL;
+  size_t len = 0;
+  char token[3][50];
+  uint16_t level = 0;
+  float *lclut = NULL;
+  size_t i = 0;
+  size_t nodes = 0;
+  uint32_t out_of_range_nb = 0;
+
+  FILE *cube_file = fopen(filepath, "r");
+  if(!cube_file)
+  {
+    fprintf(stderr, "[lut3d] invalid cube file: %s\n", filepath);
+    return 0;
+  }
+
+  while(getline(&line, &len, cube_file) != -1)
+  {
+    const uint8_t nb_token = _parse_cube_line(line, token);
+    if(!nb_token) continue;
+
+    if(token[0][0] == 'T') continue; /* TITLE */
+    else if(strcmp("DOMAIN_MIN", token[0]) == 0)
+    {
+      if(strtod(token[1], NULL) != 0.0)
+      {
+        fprintf(stderr, "[lut3d] DOMAIN MIN other than 0 is not supported\n");
+        goto error;
+      }
+    }
+    else if(strcmp("DOMAIN_MAX", token[0]) == 0)
+    {
+      if(strtod(token[1], NULL) != 1.0)
+      {
+        fprintf(stderr, "[lut3d] DOMAIN MAX other than 1 is not supported\n");
+        goto error;
+      }
+    }
+    else if(strcmp("LUT_1D_SIZE", token[0]) == 0)
+    {
+      fprintf(stderr, "[lut3d] 1D cube LUT is not supported\n");
+      goto error;
+    }
+    else if(strcmp("LUT_3D_SIZE", token[0]) == 0)
+    {
+      const long long size = atoll(token[1]);
+      if(size < 2 || size > DT_LUT3D_MAX_LEVEL || lclut)
+      {
+        fprintf(stderr, "[lut3d] error - invalid LUT 3D size %lld\n", size);
+        goto error;
+      }
+      level = (uint16_t)size;
+      nodes = (size_t)level * level * level;
+      lclut = _alloc_clut(level);
+      if(!lclut)
+      {
+        fprintf(stderr, "[lut3d] error - allocating buffer for cube LUT\n");
+        goto error;
+      }
+    }
+    else if(nb_token == 3)
+    {
+      if(!level)
+      {
+        fprintf(stderr, "[lut3d] error - cube LUT size is not defined\n");
+        goto error;
+      }
+      if(i >= nodes)
+      {
+        i++; /* counted for the error message below */
+        continue;
+      }
+      for(int j = 0; j < 3; j++)
+      {
+        const float v = _dt_atof(token[j]);
+        if(isnan(v))
+        {
+          fprintf(stderr, "[lut3d] error - invalid number line %zu\n", i);
+          goto error;
+        }
+        if(v < 0.0f || v > 1.0f) out_of_range_nb++;
+        lclut[4 * i + j] = v;
+      }
+      i++;
+    }
+  }
+
+  if(i != nodes || i == 0)
+  {
+    fprintf(stderr, "[lut3d] error - cube LUT lines number %zu is not correct, should be %zu\n",
+            i, nodes);
+    goto error;
+  }
+  if(out_of_range_nb)
+    fprintf(stderr, "[lut3d] warning - %u values out of range [0,1]\n", out_of_range_nb);
+
+  free(line);
+  fclose(cube_file);
+  *clut = lclut;
+  return level;
+
+error:
+  dt_free_align(lclut);
+  free(line);
+  fclose(cube_file);
+  return 0;
+}
+
+/* ── .3dl parser ─────────────────────────────────────────────────────────── */
+
+static uint16_t _load_3dl(const char *const filepath, float **clut)
+{
+  char *line = NULL;
+  size_t len = 0;
+  char token[3][50];
+  uint16_t level = 0;
+  float *lclut = NULL;
+  uint32_t max_value = 0;
+  size_t i = 0;
+  size_t nodes = 0;
+
+  FILE *cube_file = fopen(filepath, "r");
+  if(!cube_file)
+  {
+    fprintf(stderr, "[lut3d] invalid 3dl file: %s\n", filepath);
+    return 0;
+  }
+
+  while(getline(&line, &len, cube_file) != -1)
+  {
+    const uint8_t nb_token = _parse_cube_line(line, token);
+    if(!nb_token) continue;
+
+    if(!level)
+    {
+      if(nb_token > 3)
+      {
+        // we assume the shaper is linear and gives the size of the cube (level)
+        const int min_shaper = atoi(token[0]);
+        const int max_shaper = atoi(token[2]);
+        if(max_shaper > min_shaper)
+        {
+          level = nb_token; // max nb_token = 50 < 256
+          if(max_shaper < 128)
+          {
+            fprintf(stderr, "[lut3d] error - the maximum shaper LUT value %d is too low\n", max_shaper);
+            goto error;
+          }
+          nodes = (size_t)level * level * level;
+          lclut = _alloc_clut(level);
+          if(!lclut)
+          {
+            fprintf(stderr, "[lut3d] error - allocating buffer for 3dl LUT\n");
+            goto error;
+          }
+        }
+      }
+    }
+    else if(nb_token == 3)
+    {
+      // indexing starts with blue instead of red. need to restore the right index
+      const size_t level2 = (size_t)level * level;
+      const size_t red = i / level2;
+      const size_t rr = i - red * level2;
+      const size_t green = rr / level;
+      const size_t blue = rr - green * level;
+      const size_t k = red + level * green + level2 * blue;
+      for(int j = 0; j < 3; j++)
+      {
+        const uint32_t value = (uint32_t)atoll(token[j]);
+        lclut[4 * k + j] = (float)value;
+        if(value > max_value) max_value = value;
+      }
+      i++;
+      if(i >= nodes) break;
+    }
+  }
+
+  if(i != nodes || i == 0)
+  {
+    fprintf(stderr, "[lut3d] error - 3dl LUT lines number is not correct\n");
+    goto error;
+  }
+  free(line);
+  fclose(cube_file);
+
+  // search bit depth: min 2^x > max_value
+  uint32_t inorm = 1;
+  while((inorm < max_value) && (inorm < 65536)) // bit depth 16
+    inorm <<= 1;
+  if(inorm < 128) // bit depth 7
+  {
+    fprintf(stderr, "[lut3d] error - the maximum LUT value does not match any valid bit depth\n");
+    dt_free_align(lclut);
+    return 0;
+  }
+  const float norm = 1.0f / (float)(inorm - 1);
+  for(size_t n = 0; n < nodes; n++)
+    for(int c = 0; c < 3; c++)
+      lclut[4 * n + c] = CLAMP(lclut[4 * n + c] * norm, 0.0f, 1.0f);
+
+  *clut = lclut;
+  return level;
+
+error:
+  dt_free_align(lclut);
+  free(line);
+  fclose(cube_file);
+  return 0;
+}
+
+/* ── Hald CLUT (.png) parser ─────────────────────────────────────────────── */
+
+/*
+ * A Hald CLUT of order n is an n^3 x n^3 image holding an n^2 cube, red
+ * fastest, row after row.  Palette, grey and alpha are expanded/stripped so
+ * every row is plain RGB at 8 or 16 bits.
+ */
+static uint16_t _load_haldclut(const char *const filepath, float **clut)
+{
+  FILE *f = fopen(filepath, "rb");
+  if(!f)
+  {
+    fprintf(stderr, "[lut3d] invalid png file %s\n", filepath);
+    return 0;
+  }
+
+  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+  if(!info_ptr)
+  {
+    png_destroy_read_struct(&png_ptr, NULL, NULL);
+    fclose(f);
+    return 0;
+  }
+
+  /* volatile: modified between setjmp() and a possible longjmp() */
+  float *volatile lclut = NULL;
+  uint8_t *volatile row = NULL;
+
+  if(setjmp(png_jmpbuf(png_ptr)))
+  {
+    fprintf(stderr, "[lut3d] error - could not read png image `%s'\n", filepath);
+    dt_free_align(lclut);
+    free(row);
+    png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(f);
+    return 0;
+  }
+
+  png_init_io(png_ptr, f);
+  png_read_info(png_ptr, info_ptr);
+
+  const png_uint_32 width = png_get_image_width(png_ptr, info_ptr);
+  const png_uint_32 height = png_get_image_height(png_ptr, info_ptr);
+  const int color_type = png_get_color_type(png_ptr, info_ptr);
+  int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+
+  if(color_type == PNG_COLOR_TYPE_PALETTE) png_set_palette_to_rgb(png_ptr);
+  if(color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
+    png_set_gray_to_rgb(png_ptr);
+  if(color_type & PNG_COLOR_MASK_ALPHA) png_set_strip_alpha(png_ptr);
+  if(bit_depth < 8)
+  {
+    png_set_packing(png_ptr);
+    bit_depth = 8;
+  }
+  png_read_update_info(png_ptr, info_ptr);
+
+  // check the file sizes
+  uint32_t order = 2;
+  while(order * order * order < width) ++order;
+  const uint32_t level = order * order; // to be equivalent to cube level
+
+  if(order * order * order != width || width != height)
+  {
+    fprintf(stderr, "[lut3d] invalid level in png file %u %u\n", order, width);
+    png_error(png_ptr, "invalid Hald CLUT size");
+  }
+  if(level > DT_LUT3D_MAX_LEVEL)
+  {
+    fprintf(stderr, "[lut3d] error - LUT 3D size %u > %d\n", level, DT_LUT3D_MAX_LEVEL);
+    png_error(png_ptr, "Hald CLUT too large");
+  }
+
+  lclut = _alloc_clut((uint16_t)level);
+  row = malloc(png_get_rowbytes(png_ptr, info_ptr));
+  if(!lclut || !row) png_error(png_ptr, "out of memory");
+
+  const float norm = 1.0f / (float)((1 << bit_depth) - 1);
+  float *dst = lclut;
+  for(png_uint_32 y = 0; y < height; y++)
+  {
+    png_read_row(png_ptr, row, NULL);
+    for(png_uint_32 x = 0; x < width; x++, dst += 4)
+      for(int c = 0; c < 3; c++)
+      {
+        const size_t k = 3 * (size_t)x + c;
+        const float v = bit_depth == 16 ? (float)(256 * row[2 * k] + row[2 * k + 1]) : (float)row[k];
+        dst[c] = v * norm;
+      }
+  }
+
+  png_read_end(png_ptr, NULL);
+  png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+  free(row);
+  fclose(f);
+
+  *clut = lclut;
+  return (uint16_t)level;
+}
+
+/* ── Loader ──────────────────────────────────────────────────────────────── */
+
+static void _lut_free(dt_lut3d_t *lut)
+{
+  if(!lut) return;
+  dt_free_align(lut->clut);
+  free(lut->path);
+  free(lut);
+}
+
+static dt_lut3d_t *_lut_load(const char *path, const struct stat *st)
+{
+  float *clut = NULL;
+  uint16_t level = 0;
+
+  if(_has_suffix(path, ".cube"))
+    level = _load_cube(path, &clut);
+  else if(_has_suffix(path, ".3dl"))
+    level = _load_3dl(path, &clut);
+  else if(_has_suffix(path, ".png"))
+    level = _load_haldclut(path, &clut);
+  else
+    fprintf(stderr, "[lut3d] unsupported LUT file type: %s\n", path);
+
+  if(!level) return NULL;
+
+  dt_lut3d_t *lut = calloc(1, sizeof(dt_lut3d_t));
+  char *key = strdup(path);
+  if(!lut || !key)
+  {
+    dt_free_align(clut);
+    free(lut);
+    free(key);
+    return NULL;
+  }
+  lut->clut  = clut;
+  lut->level = level;
+  lut->path  = key;
+  lut->mtime = st->st_mtime;
+  lut->size  = st->st_size;
+  return lut;
+}
+
+/* ── Cache ───────────────────────────────────────────────────────────────── */
+
+static dt_lut3d_t *_lut_cache[DT_LUT3D_CACHE_SIZE];
+static uint64_t _lut_tick = 0;
+static dt_pthread_mutex_t _lut_mutex = { PTHREAD_MUTEX_INITIALIZER };
+
+/* Caller holds _lut_mutex.  Evicts stale entries for the same path. */
+static dt_lut3d_t *_lut_lookup(const char *path, const struct stat *st)
+{
+  for(int i = 0; i < DT_LUT3D_CACHE_SIZE; i++)
+  {
+    dt_lut3d_t *lut = _lut_cache[i];
+    if(!lut || strcmp(lut->path, path) != 0) continue;
+
+    if(lut->mtime == st->st_mtime && lut->size == st->st_size)
+    {
+      lut->users++;
+      lut->tick = ++_lut_tick;
+      return lut;
+    }
+
+    /* the file changed: forget it; current users free it on release */
+    _lut_cache[i] = NULL;
+    lut->cached = false;
+    if(lut->users == 0) _lut_free(lut);
+  }
+  return NULL;
+}
+
+/*
+ * The parse runs outside the lock; if every slot is in use the LUT is
+ * handed out uncached and freed again on release.
+ */
+const dt_lut3d_t *dt_lut3d_acquire(const char *path)
+{
+  if(!path || !path[0]) return NULL;
+
+  struct stat st;
+  if(stat(path, &st) != 0)
+  {
+    fprintf(stderr, "[lut3d] cannot access LUT file: %s\n", path);
+    return NULL;
+  }
+
+  dt_pthread_mutex_lock(&_lut_mutex);
+  dt_lut3d_t *lut = _lut_lookup(path, &st);
+  dt_pthread_mutex_unlock(&_lut_mutex);
+  if(lut) return lut;
+
+  lut = _lut_load(path, &st);
+  if(!lut) return NULL;
+
+  dt_pthread_mutex_lock(&_lut_mutex);
+  dt_lut3d_t *other = _lut_lookup(path, &st);
+  if(other)
+  {
+    /* another pipe loaded the same file meanwhile */
+    dt_pthread_mutex_unlock(&_lut_mutex);
+    _lut_free(lut);
+    return other;
+  }
+
+  int victim = -1;
+  for(int i = 0; i < DT_LUT3D_CACHE_SIZE; i++)
+  {
+    if(!_lut_cache[i])
+    {
+      victim = i;
+      break;
+    }
+    if(_lut_cache[i]->users == 0
+       && (victim < 0 || _lut_cache[i]->tick < _lut_cache[victim]->tick))
+      victim = i;
+  }
+
+  if(victim >= 0)
+  {
+    _lut_free(_lut_cache[victim]);
+    _lut_cache[victim] = lut;
+    lut->cached = true;
+  }
+  lut->users = 1;
+  lut->tick  = ++_lut_tick;
+  dt_pthread_mutex_unlock(&_lut_mutex);
+
+  return lut;
+}
+
+void dt_lut3d_release(const dt_lut3d_t *clut)
+{
+  if(!clut) return;
+  dt_lut3d_t *lut = (dt_lut3d_t *)clut;
+
+  dt_pthread_mutex_lock(&_lut_mutex);
+  lut->users--;
+  const bool drop = !lut->cached && lut->users == 0;
+  dt_pthread_mutex_unlock(&_lut_mutex);
+
+  if(drop) _lut_free(lut);
+}
+
+void dt_lut3d_cache_cleanup(void)
+{
+  dt_pthread_mutex_lock(&_lut_mutex);
+  for(int i = 0; i < DT_LUT3D_CACHE_SIZE; i++)
+  {
+    dt_lut3d_t *lut = _lut_cache[i];
+    _lut_cache[i] = NULL;
+    if(!lut) continue;
+    /* pipes still holding it free it on release */
+    lut->cached = false;
+    if(lut->users == 0) _lut_free(lut);
+  }
+  _lut_tick = 0;
+  dt_pthread_mutex_unlock(&_lut_mutex);
+}
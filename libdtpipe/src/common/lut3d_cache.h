@@ -0,0 +1,67 @@
+/*
+ * lut3d_cache.h - Process-wide cache of parsed 3D LUT files
+ *
+ * Parsers ported from darktable src/iop/lut3d.c
+ * Copyright (C) 2019-2025 darktable developers.
+ *
+ * Stripped of: the G'MIC compressed LUTs and the LUT folder preference;
+ * paths are used as given.
+ *
+ * Changes: darktable parses the file again for every module instance.  Here
+ * a parsed LUT is shared by every pipeline that uses the same file, keyed
+ * by path, modification time and size, so re-rendering or opening a second
+ * pipe with the same look costs nothing.  An entry whose file changed on
+ * disk is dropped on the next lookup.
+ *
+ * Layout: level^3 nodes, red index fastest, then green, then blue (the
+ * .cube order).  Each node is padded to four floats (RGB + 0) so one node
+ * is one aligned 16-byte vector load and never straddles a cache line.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DT_LUT3D_MAX_LEVEL 256  /* largest accepted grid (nodes per axis) */
+#define DT_LUT3D_CACHE_SIZE 8   /* parsed LUTs kept around                */
+
+typedef struct dt_lut3d_t
+{
+  float   *clut;   /* 4 * level^3 floats, see above */
+  uint16_t level;  /* nodes per axis, >= 2          */
+
+  /* cache key */
+  char    *path;
+  time_t   mtime;
+  off_t    size;
+
+  /* cache bookkeeping (guarded by the cache mutex) */
+  int      users;
+  uint64_t tick;
+  bool     cached;
+} dt_lut3d_t;
+
+/**
+ * Return the parsed LUT for a .cube, .3dl or Hald CLUT .png file, loading
+ * it on a miss.  Returns NULL (after printing why) when the file is missing
+ * or invalid.  The LUT is read-only; hand it back with dt_lut3d_release().
+ */
+const dt_lut3d_t *dt_lut3d_acquire(const char *path);
+
+/** Drop a reference taken by dt_lut3d_acquire().  NULL is ignored. */
+void dt_lut3d_release(const dt_lut3d_t *lut);
+
+/** Free every cached LUT (called from dtpipe_cleanup()). */
+void dt_lut3d_cache_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,526 @@
+/*
+ * nlmeans_core.c - Non-local means denoising core
+ *
+ * See nlmeans_core.h for the slice sizing.
+ */
+
+#include "common/nlmeans_core.h"
+#include "iop/iop_math.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+// to avoid accumulation of rounding errors, we should do a full recomputation of the patch differences
+//   every so many rows of the image.  We'll also use that interval as the target maximum chunk size for
+//   parallelization
+// in addition, to keep the working set within L1 cache, we need to limit the width of the chunks that
+//   are processed.  The working set uses (2*radius+3)*(ceil(width/4)+1) + (2*radius+3)*(ceil(width/16)+1)
+//   64-byte cache lines.  The typical x86 CPU has an L1 cache containing 256 lines, and we'll need to
+//   reserve a few for variables in the stack frame and the like.  That results in a maximal width of
+//   96 pixels for radius=2, 72 pixels for radius=3, and 56 for radius=4 (default patch radius is 2)
+
+// lower values for the slice height reduce the accumulation of rounding errors at the cost of more
+//  computation; to avoid excessive overhead, width*height should be at least 2000.  Keeping the rows a slice
+//  reads within L2 will greatly improve cache hit rates and help with scaling beyond 16 threads.  The sizes
+//  computed by _slice_target() are targets and may be adjusted slightly to avoid having extremely small
+//  chunks at the right/bottom edge of the images (width will only be reduced, height could be either
+//  reduced or increased).  SLICE_WIDTH x SLICE_HEIGHT is darktable's fixed choice for a 16 KiB L1, used
+//  when a computed target is out of range.
+#define SLICE_WIDTH 72
+#define SLICE_HEIGHT 60
+
+#define SLICE_MIN_WIDTH 32
+#define SLICE_MAX_WIDTH 256
+#define SLICE_MIN_HEIGHT 24
+#define SLICE_MAX_HEIGHT 120
+
+#if defined(__GNUC__)
+#define PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#else
+#define PREFETCH(p) do {} while(0)
+#endif
+
+/* ── Cache-derived slice size ────────────────────────────────────────────── */
+
+static size_t _l1_size = 0, _l2_size = 0;
+static pthread_once_t _cache_once = PTHREAD_ONCE_INIT;
+
+#if defined(__APPLE__)
+static size_t _sysctl_size(const char *name)
+{
+  int64_t v = 0;
+  size_t len = sizeof(v);
+  return sysctlbyname(name, &v, &len, NULL, 0) == 0 && v > 0 ? (size_t)v : 0;
+}
+#endif
+
+static void _query_cache_sizes(void)
+{
+  size_t l1 = 0, l2 = 0;
+#if defined(_SC_LEVEL1_DCACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+  const long s1 = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  const long s2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if(s1 > 0) l1 = (size_t)s1;
+  if(s2 > 0) l2 = (size_t)s2;
+#elif defined(__APPLE__)
+  l1 = _sysctl_size("hw.l1dcachesize");
+  // Apple silicon shares one L2 per cluster: count the share of one performance core
+  const size_t cluster_l2 = _sysctl_size("hw.perflevel0.l2cachesize");
+  const size_t cluster_cpus = _sysctl_size("hw.perflevel0.cpusperl2");
+  l2 = cluster_l2 && cluster_cpus ? cluster_l2 / cluster_cpus : _sysctl_size("hw.l2cachesize");
+#endif
+  _l1_size = l1 ? l1 : 32 * 1024;
+  _l2_size = l2 ? l2 : 512 * 1024;
+}
+
+// target slice size for the given patch radius and maximal patch shift
+static void _slice_target(const int radius, const int max_shift, int *width, int *height)
+{
+  pthread_once(&_cache_once, _query_cache_sizes);
+
+  // the column sums and the rows they are built from occupy
+  //   (2*radius+3)*(w/4+1) + (2*radius+3)*(w/16+1)
+  // 64-byte lines of L1 (see above); keep 16 lines for the stack frame
+  const int lines = (int)(_l1_size / 64) - 16;
+  int w = ((lines / (2 * radius + 3)) - 2) * 16 / 5;
+  w = w & ~3;
+  if(w < SLICE_MIN_WIDTH || w > 4 * SLICE_MAX_WIDTH) w = SLICE_WIDTH;
+  w = MIN(w, SLICE_MAX_WIDTH);
+
+  // one slice reads (h + 2m) rows of (w + 2m) input pixels and writes h rows of w output pixels,
+  // m being the patch radius plus the largest patch shift; keep that within half of L2 so that
+  // the input rows are still there when the next patch sweeps over them
+  const int m = radius + max_shift;
+  const long budget = (long)(_l2_size / 2) / (4 * sizeof(float));
+  long h = 0;
+  for(;;)
+  {
+    h = (budget - 2L * m * (w + 2 * m)) / (2 * w + 2 * m);
+    if(h >= SLICE_MIN_HEIGHT || w - 4 < SLICE_MIN_WIDTH) break;
+    w -= 4;
+  }
+  *width = w;
+  *height = (int)CLAMP(h, SLICE_MIN_HEIGHT, SLICE_MAX_HEIGHT);
+}
+
+// a structure to collect together the items which define the location of a patch relative to the pixel
+//  being denoised
+struct patch_t
+{
+  short rows;		// number of rows difference
+  short cols;		// number of columns difference
+  int offset;	  	// array distance between corresponding pixels
+};
+typedef struct patch_t patch_t;
+
+static inline float gh(const float f)
+{
+  return dt_fast_mexp2f(f) ;
+}
+
+static inline int sign(int a)
+{
+  return (a > 0) - (a < 0);
+}
+
+// map the basic row/column offset into a possible much larger offset based on a user parameter
+static int scatter(
+        const float scale,
+        const float scattering,
+        const int index1,
+        const int index2)
+{
+  // this formula is designed to
+  //  - produce an identity mapping when scattering = 0
+  //  - avoiding duplicate patches provided that 0 <= scattering <= 1
+  //  - avoiding grid artifacts by trying to take patches on various rows and columns
+  const int abs_i1 = abs(index1);
+  const int abs_i2 = abs(index2);
+  return scale * ((abs_i1 * abs_i1 * abs_i1 + 7.0 * abs_i1 * sqrt(abs_i2)) * sign(index1) * scattering / 6.0 + index1);
+}
+
+// allocate and fill an array of patch definitions
+static struct patch_t* define_patches(
+        const dt_nlmeans_param_t *const params,
+        const int stride,
+        int *num_patches,
+        int *max_shift)
+{
+  const int search_radius = params->search_radius;
+  const float scale = params->scale;
+  const float scattering = params->scattering;
+  int decimate = params->decimate ? 1 : 0;  // must start at 1 when nonzero, to choose correct patches to skip below
+  // determine how many patches we have
+  int n_patches = (2 * search_radius + 1) * (2 * search_radius + 1);
+  if(decimate)
+    n_patches = (n_patches + 1) / 2;
+  *num_patches = n_patches ;
+  // allocate a cacheline-aligned buffer
+  struct patch_t* patches = dt_alloc_align_type(struct patch_t, n_patches);
+  // set up the patch offsets
+  int patch_num = 0;
+  int shift = 0;
+  for(int row_index = -search_radius; row_index <= search_radius; row_index++)
+  {
+    for(int col_index = -search_radius; col_index <= search_radius; col_index++)
+    {
+      if(decimate && (++decimate & 1)) continue; // skip every other patch
+      int r = scatter(scale,scattering,row_index,col_index);
+      int c = scatter(scale,scattering,col_index,row_index);
+      patches[patch_num].rows = r;
+      patches[patch_num].cols = c;
+      if(r > shift) shift = r;
+      else if(-r > shift) shift = -r;
+      if(c > shift) shift = c;
+      else if(-c > shift) shift = -c;
+      patches[patch_num].offset = (r * stride + c * 4);
+      patch_num++;
+    }
+  }
+  *max_shift = shift;
+  return patches;
+}
+
+static float compute_center_pixel_norm(const float center_weight, const int radius)
+{
+  // scale the central pixel's contribution by the size of the patch so that the center-weight
+  //   setting can be independent of patch size
+  const int width = 2 * radius + 1;
+  return center_weight * width * width;
+}
+
+// compute the channel-normed squared difference between two pixels
+static inline float pixel_difference(
+        const dt_aligned_pixel_t pix1,
+        const dt_aligned_pixel_t pix2,
+        const dt_aligned_pixel_t norm)
+{
+  dt_aligned_pixel_t sum = { 0.f, 0.f, 0.f, 0.f };
+  for_each_channel(i, aligned(sum, pix1, pix2:16))
+  {
+    const float diff = pix1[i] - pix2[i];
+    sum[i] = diff * diff * norm[i];
+  }
+  return sum[0] + sum[1] + sum[2];
+}
+
+// optimized: pixel_difference(pix1, pix2, norm) - pixel_difference(pix3, pix4, norm)
+static inline float diff_of_pixels_diff(
+        const dt_aligned_pixel_t pix1,
+        const dt_aligned_pixel_t pix2,
+        const dt_aligned_pixel_t pix3,
+        const dt_aligned_pixel_t pix4,
+        const dt_aligned_pixel_t norm)
+{
+  dt_aligned_pixel_t sum = { 0.f, 0.f, 0.f, 0.f };
+  for_each_channel(i, aligned(sum, pix1, pix2, pix3, pix4:16))
+  {
+    const float diff1 = pix1[i] - pix2[i];
+    const float diff2 = pix3[i] - pix4[i];
+    sum[i] = (diff1 * diff1 - diff2 * diff2) * norm[i];
+  }
+  return sum[0] + sum[1] + sum[2];
+}
+
+static void init_column_sums(
+        float *const col_sums,
+        const patch_t *const patch,
+        const float *const in,
+        const int row,
+        const int chunk_left,
+        const int chunk_right,
+        const int height,
+        const int width,
+        const int stride,
+        const int radius,
+        const float *const norm)
+{
+  // Compute column sums from scratch.  Needed for the very first row, and at intervals thereafter
+  //   to limit accumulation of rounding errors
+
+  // figure out which columns can possibly contribute to patches whose centers lie within the RoI
+  // we can go up to 'radius' columns beyond the current chunk provided that the patch does not
+  // lie in the same direction from the pixel being denoised and that we're still in the RoI
+  const int scol = patch->cols;
+  const int col_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+  const int col_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+  // adjust bounds if the patch extends past top/bottom of RoI
+  const int srow = patch->rows;
+  const int rmin = row - MIN(radius,MIN(row,row+srow));
+  const int rmax = row + MIN(radius,MIN(height-1-row,height-1-(row+srow)));
+  for(int col = chunk_left-radius-1; col < MIN(col_min,chunk_right+radius); col++)
+  {
+    col_sums[col] = 0.0f;
+  }
+  for(int col = col_min; col < col_max; col++)
+  {
+    float sum = 0.0f;
+    for(int r = rmin; r <= rmax; r++)
+    {
+      const float *pixel = in + r*stride + 4*col;
+      const float diff = pixel_difference(pixel,pixel+patch->offset,norm);
+      sum += diff;
+    }
+    col_sums[col] = sum;
+  }
+  // clear out any columns where the patch column would be outside the RoI, as well as our overrun area
+  for(int col = MAX(col_min,col_max); col < chunk_right + radius; col++)
+  {
+    col_sums[col] = 0.0f;
+  }
+  return;
+}
+
+
+// determine the height of the horizontal slice each thread will process
+static int compute_slice_height(const int height, const int target)
+{
+  if(height % target == 0)
+    return target;
+  // try to make the heights of the chunks as even as possible
+  int best = height % target;
+  int best_incr = 0;
+  for(int incr = 1; incr < 10; incr++)
+  {
+    int plus_rem = height % (target + incr);
+    if(plus_rem == 0)
+      return target + incr;
+    else if(plus_rem > best)
+    {
+      best_incr = +incr;
+      best = plus_rem;
+    }
+    int minus_rem = height % (target - incr);
+    if(minus_rem == 0)
+      return target - incr;
+    else if(minus_rem > best)
+    {
+      best_incr = -incr;
+      best = minus_rem;
+    }
+  }
+  return target + best_incr;
+}
+
+// determine the width of the horizontal slice each thread will process
+static int compute_slice_width(const int width, const int target)
+{
+  int sl_width = target;
+  // if there's just a sliver left over for the last column, see whether slicing a few pixels off each gives
+  // us a more nearly full final chunk
+  int rem = width % sl_width;
+  if(rem < target/2 && (width % (sl_width-4)) > rem)
+  {
+    sl_width -= 4;
+    // check whether removing an additional sliver improves things even more
+    rem = width % sl_width;
+    if(rem < target/2 && (width % (sl_width-4)) > rem)
+      sl_width -= 4;
+  }
+  return sl_width;
+}
+
+__DT_CLONE_TARGETS__
+void nlmeans_denoise(
+        const float *const inbuf,
+        float *const outbuf,
+        const dt_iop_roi_t *const roi_in,
+        const dt_iop_roi_t *const roi_out,
+        const dt_nlmeans_param_t *const params)
+{
+  // define the factors for applying blending between the original image and the denoised version
+  // if running in RGB space, 'luma' should equal 'chroma'
+  const dt_aligned_pixel_t weight = { params->luma, params->chroma, params->chroma, 1.0f };
+  const dt_aligned_pixel_t invert = { 1.0f - params->luma, 1.0f - params->chroma, 1.0f - params->chroma, 0.0f };
+  const gboolean skip_blend = (params->luma == 1.0 && params->chroma == 1.0);
+
+  // define the normalization to convert central pixel differences into central pixel weights
+  const float cp_norm = compute_center_pixel_norm(params->center_weight,params->patch_radius);
+  const dt_aligned_pixel_t center_norm = { cp_norm, cp_norm, cp_norm, 1.0f };
+
+  // define the patches to be compared when denoising a pixel
+  const size_t stride = 4 * roi_in->width;
+  int num_patches;
+  int max_shift;
+  struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
+  // allocate scratch space, including an overrun area on each end so we don't need a boundary check on every access
+  const int radius = params->patch_radius;
+  int target_width, target_height;
+  _slice_target(radius, max_shift, &target_width, &target_height);
+  const int chk_height = compute_slice_height(roi_out->height, target_height);
+  const int chk_width = compute_slice_width(roi_out->width, target_width);
+  const size_t scratch_size = chk_width + 2*radius + 1 + 48; // getting false sharing without the +48....
+  size_t padded_scratch_size;
+  float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
+  DT_OMP_FOR(collapse(2))
+  for(int chunk_top = 0 ; chunk_top < roi_out->height; chunk_top += chk_height)
+  {
+    for(int chunk_left = 0; chunk_left < roi_out->width; chunk_left += chk_width)
+    {
+      // locate our scratch space within the big buffer allocated above
+      // we'll offset by chunk_left so that we don't have to subtract on every access
+      float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
+      float *const col_sums =  tmpbuf + (radius+1) - chunk_left;
+      // determine which horizontal slice of the image to process
+      const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
+      // determine which vertical slice of the image to process
+      const int chunk_right = MIN(chunk_left + chk_width, roi_out->width);
+      // we want to incrementally sum results (especially weights in col[3]), so clear the output buffer to zeros
+      for(int i = chunk_top; i < chunk_bot; i++)
+      {
+        memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
+      }
+      // cycle through all of the patches over our slice of the image
+      for(int p = 0; p < num_patches; p++)
+      {
+        // retrieve info about the current patch
+        const patch_t *patch = &patches[p];
+        // skip any rows where the patch center would be above top of RoI or below bottom of RoI
+        const int height = roi_out->height;
+        const int row_min = MAX(chunk_top,MAX(0,-patch->rows));
+        const int row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
+        // figure out which rows at top and bottom result in patches extending outside the RoI, even though the
+        // center pixel is inside
+        const int row_top = MAX(row_min,MAX(radius,radius-patch->rows));
+        const int row_bot = MIN(row_max,height-1-MAX(radius,radius+patch->rows));
+        // skip any columns where the patch center would be to the left or the right of the RoI
+        const int width = roi_out->width;
+        const int scol = patch->cols;
+        const int col_min = MAX(chunk_left,-scol);
+        const int col_max = MIN(chunk_right,roi_out->width - scol);
+
+        init_column_sums(col_sums,patch,inbuf,row_min,chunk_left,chunk_right,height,width,
+                         stride,radius,params->norm);
+        for(int row = row_min; row < row_max; row++)
+        {
+          // add up the initial columns of the sliding window of total patch distortion
+          float distortion = 0.0f;
+          for(int i = col_min - radius; i < MIN(col_min+radius, col_max); i++)
+          {
+            distortion += col_sums[i];
+          }
+          // now proceed down the current row of the image
+          const float *in = inbuf + stride * row;
+          float *const out = outbuf + (size_t)4 * width * row;
+          const int offset = patch->offset;
+          const float sharpness = params->sharpness;
+          if(params->center_weight < 0.0f)
+          {
+            // computation as used by denoise(non-local) iop
+            for(int col = col_min; col < col_max; col++)
+            {
+              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
+              const float wt = gh(distortion * sharpness);
+              const float *const inpx = in+4*col;
+              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
+              for_four_channels(c,aligned(pixel,out:16))
+              {
+                out[4*col+c] += pixel[c] * wt;
+              }
+              PREFETCH(in+4*col+offset+stride);	// try to ensure next row is ready in time
+            }
+          }
+          else
+          {
+            // computation as used by denoiseprofiled iop with non-local means
+            for(int col = col_min; col < col_max; col++)
+            {
+              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
+              const float dissimilarity = (distortion + pixel_difference(in+4*col,in+4*col+offset,center_norm))
+                                           / (1.0f + params->center_weight);
+              const float wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+              const float *const inpx = in + 4*col;
+              const dt_aligned_pixel_t pixel = { inpx[offset], inpx[offset+1], inpx[offset+2], 1.0f };
+              for_four_channels(c,aligned(pixel,out:16))
+              {
+                out[4*col+c] += pixel[c] * wt;
+              }
+              PREFETCH(in+4*col+offset+stride);	// try to ensure next row is ready in time
+            }
+          }
+          const int pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+          const int pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+          if(row < MIN(row_top, row_bot))
+          {
+            // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
+            const float *bot_row = inbuf + (row+1+radius)*stride;
+            for(int col = pcol_min; col < pcol_max; col++)
+            {
+              const float *const bot_px = bot_row + 4*col;
+              const float diff = pixel_difference(bot_px,bot_px+offset,params->norm);
+              PREFETCH(bot_px+stride);
+              col_sums[col] += diff;
+              PREFETCH(bot_px+offset+stride);
+            }
+          }
+          else if(row < row_bot)
+          {
+            const float *const top_row = inbuf + (row-radius)*stride   /* +(2*radius+1)*stride*/ ;
+            const float *const bot_row = inbuf + (row+1+radius)*stride ;
+            // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
+            for(int col = pcol_min; col < pcol_max; col++)
+            {
+              const float *const top_px = top_row + 4*col;
+              const float *const bot_px = bot_row + 4*col;
+              const float diff = diff_of_pixels_diff(bot_px,bot_px+offset,top_px,top_px+offset,params->norm);
+              PREFETCH(bot_px+stride);
+              col_sums[col] += diff;
+              PREFETCH(bot_px+offset+stride);
+            }
+          }
+          else if(row >= row_top && row + 1 < row_max) // don't bother updating if last iteration
+          {
+            // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
+            const float *top_row = inbuf + (row-radius)*stride;
+            for(int col = pcol_min; col < pcol_max; col++)
+            {
+              const float *const top_px = top_row + 4*col;
+              col_sums[col] -= pixel_difference(top_px,top_px+offset,params->norm);
+            }
+          }
+        }
+      }
+      if(skip_blend)
+      {
+        // normalize the pixels
+        for(int row = chunk_top; row < chunk_bot; row++)
+        {
+          float *const out = outbuf + 4 * row * roi_out->width;
+          for(int col = chunk_left; col < chunk_right; col++)
+          {
+            for_each_channel(c,aligned(out:16))
+            {
+              out[4*col+c] /= out[4*col+3];
+            }
+          }
+        }
+      }
+      else
+      {
+        // normalize and apply chroma/luma blending
+        for(int row = chunk_top; row < chunk_bot; row++)
+        {
+          const float *in = inbuf + row * stride;
+          float *out = outbuf + row * 4 * roi_out->width;
+          for(int col = chunk_left; col < chunk_right; col++)
+          {
+            for_each_channel(c,aligned(in,out,weight,invert:16))
+            {
+              out[4*col+c] = (in[4*col+c] * invert[c]) + (out[4*col+c] / out[4*col+3] * weight[c]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // clean up: free the work space
+  dt_free_align(patches);
+  dt_free_align(scratch_buf);
+  return;
+}
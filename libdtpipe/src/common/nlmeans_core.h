@@ -0,0 +1,50 @@
+/*
+ * nlmeans_core.h - Non-local means denoising core
+ *
+ * Ported from darktable src/common/nlmeans_core.c
+ * Copyright (C) 2019-2024 darktable developers.
+ *
+ * Stripped of: the OpenCL paths (nlmeans_denoise_cl,
+ * nlmeans_denoiseprofile_cl) and their kernel handles.
+ *
+ * Changes: the image is processed in slices small enough that the running
+ * column sums stay in L1 and the input rows of one slice stay in L2.
+ * darktable fixes the slice at 72x60 pixels, sized for a 16 KiB L1; here
+ * the slice is derived once from the L1/L2 sizes the host reports (falling
+ * back to 32 KiB / 512 KiB), the patch radius and the search footprint.
+ * Slice geometry changes only the order of the sums, not which patches
+ * contribute, so the output is the same for any slice size up to
+ * floating-point rounding.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dt_nlmeans_param_t
+{
+  float scattering;	// scattering factor for patches (default 0 = densest possible)
+  float scale;		// image scaling, affects scattering
+  float luma;		// blend amount, L channel in Lab (set to 1.00 for RGB)
+  float chroma;		// blend amount, a/b channels (set to 1.00 for RBG)
+  float center_weight;  // weighting of central pixel in patch (<0 for no special handling; used by denoise[non-local])
+  float sharpness;	// relative weight of central pixel (preserves detail), ignored if center_weight >= 0
+  int patch_radius;	// radius of patches which are compared, 1..4
+  int search_radius;	// radius around a pixel in which to compare patches (default = 7)
+  int decimate;         // set to 1 to search only half the patches in the neighborhood (default = 0)
+  const float* const norm; // array of four per-channel weight factors
+  dt_dev_pixelpipe_type_t pipetype;
+};
+typedef struct dt_nlmeans_param_t dt_nlmeans_param_t;
+
+void nlmeans_denoise(const float *const inbuf, float *const outbuf,
+                     const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                     const dt_nlmeans_param_t *const params);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,547 @@
+/*
+ * noiseprofiles.c - Camera noise profile database
+ *
+ * See noiseprofiles.h for the table layout and its lifetime.
+ */
+
+#include "common/noiseprofiles.h"
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// bump this when the noiseprofiles are getting a different layout or meaning (raw-raw data, ...)
+#define DT_NOISE_PROFILE_VERSION 0
+
+const dt_noiseprofile_t dt_noiseprofile_generic = {"generic poissonian", "", "", 0, {0.0001f, 0.0001f, 0.0001f}, {0.0f, 0.0f, 0.0f}};
+
+/* ── Table ───────────────────────────────────────────────────────────────── */
+
+/* One camera: a run of profiles in _db.profiles, sorted by ISO. */
+typedef struct _np_camera_t
+{
+  char *maker;
+  char *model;
+  int   first;
+  int   count;
+} _np_camera_t;
+
+typedef struct _np_db_t
+{
+  _np_camera_t      *cameras;
+  int                n_cameras, cap_cameras;
+  dt_noiseprofile_t *profiles;
+  int                n_profiles, cap_profiles;
+} _np_db_t;
+
+static _np_db_t _db = { 0 };
+static gboolean _db_tried = FALSE; /* lazy load attempted */
+static dt_pthread_mutex_t _db_mutex = { PTHREAD_MUTEX_INITIALIZER };
+
+static void _db_free(_np_db_t *db)
+{
+  for(int i = 0; i < db->n_cameras; i++)
+  {
+    free(db->cameras[i].maker);
+    free(db->cameras[i].model);
+  }
+  for(int i = 0; i < db->n_profiles; i++)
+    free((char *)db->profiles[i].name);
+  free(db->cameras);
+  free(db->profiles);
+  memset(db, 0, sizeof(*db));
+}
+
+static dt_noiseprofile_t *_db_add_profile(_np_db_t *db)
+{
+  if(db->n_profiles == db->cap_profiles)
+  {
+    const int cap = db->cap_profiles ? 2 * db->cap_profiles : 1024;
+    dt_noiseprofile_t *p = realloc(db->profiles, sizeof(dt_noiseprofile_t) * cap);
+    if(!p) return NULL;
+    db->profiles = p;
+    db->cap_profiles = cap;
+  }
+  dt_noiseprofile_t *prof = &db->profiles[db->n_profiles++];
+  memset(prof, 0, sizeof(*prof));
+  return prof;
+}
+
+static _np_camera_t *_db_add_camera(_np_db_t *db)
+{
+  if(db->n_cameras == db->cap_cameras)
+  {
+    const int cap = db->cap_cameras ? 2 * db->cap_cameras : 256;
+    _np_camera_t *c = realloc(db->cameras, sizeof(_np_camera_t) * cap);
+    if(!c) return NULL;
+    db->cameras = c;
+    db->cap_cameras = cap;
+  }
+  _np_camera_t *cam = &db->cameras[db->n_cameras++];
+  memset(cam, 0, sizeof(*cam));
+  return cam;
+}
+
+/* ── JSON reader ─────────────────────────────────────────────────────────── */
+/*
+ * Just enough JSON for noiseprofiles.json: objects, arrays, strings,
+ * numbers and the three keywords.  Unknown members ("comment", ...) are
+ * skipped.  Numbers go through strtod, as in history/deserialize.c.
+ */
+
+typedef struct _parser_t
+{
+  const char *p;
+  char        err[256];
+} _parser_t;
+
+static void _skip_ws(_parser_t *ps)
+{
+  while(*ps->p && isspace((unsigned char)*ps->p)) ps->p++;
+}
+
+static int _fail(_parser_t *ps, const char *what)
+{
+  if(!ps->err[0]) snprintf(ps->err, sizeof(ps->err), "%s near: %.20s", what, ps->p);
+  return 0;
+}
+
+static int _expect(_parser_t *ps, const char c)
+{
+  _skip_ws(ps);
+  if(*ps->p != c) return _fail(ps, "unexpected character");
+  ps->p++;
+  return 1;
+}
+
+/* Strings are copied verbatim; escapes other than \" and \\ are kept as the
+   escaped character, which is all the database uses. */
+static int _parse_string(_parser_t *ps, char *out, const size_t out_size)
+{
+  _skip_ws(ps);
+  if(*ps->p != '"') return _fail(ps, "expected string");
+  ps->p++;
+  size_t pos = 0;
+  while(*ps->p && *ps->p != '"')
+  {
+    char c = *ps->p++;
+    if(c == '\\' && *ps->p) c = *ps->p++;
+    if(pos + 1 < out_size) out[pos++] = c;
+  }
+  if(*ps->p != '"') return _fail(ps, "unterminated string");
+  ps->p++;
+  out[pos] = '\0';
+  return 1;
+}
+
+static int _parse_number(_parser_t *ps, double *out)
+{
+  _skip_ws(ps);
+  char *end;
+  *out = strtod(ps->p, &end);
+  if(end == ps->p) return _fail(ps, "expected number");
+  ps->p = end;
+  return 1;
+}
+
+/*
+ * Container iteration: call _next() before each element (after consuming
+ * the opening bracket).  Returns 1 when an element follows, 0 at the
+ * closing bracket (consumed) and -1 on a syntax error.
+ */
+static int _next(_parser_t *ps, const char close, int *count)
+{
+  _skip_ws(ps);
+  if(*ps->p == close)
+  {
+    ps->p++;
+    return 0;
+  }
+  if(*count > 0)
+  {
+    if(*ps->p != ',') return _fail(ps, "expected ',' or closing bracket") - 1;
+    ps->p++;
+  }
+  (*count)++;
+  return 1;
+}
+
+/* _next() for objects, also reading the member name and its ':'. */
+static int _next_member(_parser_t *ps, int *count, char *key, const size_t key_size)
+{
+  const int r = _next(ps, '}', count);
+  if(r <= 0) return r;
+  if(!_parse_string(ps, key, key_size) || !_expect(ps, ':')) return -1;
+  return 1;
+}
+
+static int _skip_value(_parser_t *ps)
+{
+  _skip_ws(ps);
+  const char c = *ps->p;
+  if(c == '"')
+  {
+    char tmp[512];
+    return _parse_string(ps, tmp, sizeof(tmp));
+  }
+  if(c == '{' || c == '[')
+  {
+    const char close = c == '{' ? '}' : ']';
+    ps->p++;
+    int n = 0, r;
+    char key[256];
+    while((r = (close == '}' ? _next_member(ps, &n, key, sizeof(key)) : _next(ps, close, &n))) > 0)
+      if(!_skip_value(ps)) return 0;
+    return r == 0;
+  }
+  if(strncmp(ps->p, "true", 4) == 0)  { ps->p += 4; return 1; }
+  if(strncmp(ps->p, "false", 5) == 0) { ps->p += 5; return 1; }
+  if(strncmp(ps->p, "null", 4) == 0)  { ps->p += 4; return 1; }
+  double d;
+  return _parse_number(ps, &d);
+}
+
+/* [x, y, z] into out[0..2] */
+static int _parse_triplet(_parser_t *ps, float *out)
+{
+  if(!_expect(ps, '[')) return 0;
+  int n = 0, r;
+  while((r = _next(ps, ']', &n)) > 0)
+  {
+    double v;
+    if(n > 3 || !_parse_number(ps, &v)) return _fail(ps, "expected 3 numbers");
+    out[n - 1] = (float)v;
+  }
+  return r == 0 && n == 3 ? 1 : _fail(ps, "expected 3 numbers");
+}
+
+/* ── Schema ──────────────────────────────────────────────────────────────── */
+
+static int _parse_profile(_parser_t *ps, _np_db_t *db)
+{
+  if(!_expect(ps, '{')) return 0;
+  char name[256] = { 0 };
+  gboolean has_name = FALSE, has_iso = FALSE, has_a = FALSE, has_b = FALSE, skip = FALSE;
+  dt_noiseprofile_t tmp = { 0 };
+
+  int n = 0, r;
+  char key[64];
+  while((r = _next_member(ps, &n, key, sizeof(key))) > 0)
+  {
+    if(!strcmp(key, "name"))
+    {
+      if(!_parse_string(ps, name, sizeof(name))) return 0;
+      has_name = TRUE;
+    }
+    else if(!strcmp(key, "iso"))
+    {
+      double iso;
+      if(!_parse_number(ps, &iso)) return 0;
+      tmp.iso = (int)iso;
+      has_iso = TRUE;
+    }
+    else if(!strcmp(key, "a"))
+    {
+      if(!_parse_triplet(ps, tmp.a)) return 0;
+      has_a = TRUE;
+    }
+    else if(!strcmp(key, "b"))
+    {
+      if(!_parse_triplet(ps, tmp.b)) return 0;
+      has_b = TRUE;
+    }
+    else if(!strcmp(key, "skip"))
+    {
+      _skip_ws(ps);
+      skip = strncmp(ps->p, "true", 4) == 0;
+      if(!_skip_value(ps)) return 0;
+    }
+    else if(!_skip_value(ps))
+      return 0;
+  }
+  if(r < 0) return 0;
+
+  if(!has_name) return _fail(ps, "missing `name`");
+  if(!has_iso) return _fail(ps, "missing `iso`");
+  if(!has_a) return _fail(ps, "missing `a`");
+  if(!has_b) return _fail(ps, "missing `b`");
+  if(skip) return 1;
+
+  dt_noiseprofile_t *prof = _db_add_profile(db);
+  if(!prof || !(tmp.name = strdup(name)))
+  {
+    if(prof) db->n_profiles--;
+    return _fail(ps, "out of memory");
+  }
+  *prof = tmp;
+  return 1;
+}
+
+static int _parse_model(_parser_t *ps, _np_db_t *db)
+{
+  if(!_expect(ps, '{')) return 0;
+  char model[256] = { 0 };
+  gboolean has_model = FALSE, has_profiles = FALSE;
+  const int first = db->n_profiles;
+
+  int n = 0, r;
+  char key[64];
+  while((r = _next_member(ps, &n, key, sizeof(key))) > 0)
+  {
+    if(!strcmp(key, "model"))
+    {
+      if(!_parse_string(ps, model, sizeof(model))) return 0;
+      has_model = TRUE;
+    }
+    else if(!strcmp(key, "profiles"))
+    {
+      if(!_expect(ps, '[')) return 0;
+      int m = 0, s;
+      while((s = _next(ps, ']', &m)) > 0)
+        if(!_parse_profile(ps, db)) return 0;
+      if(s < 0) return 0;
+      has_profiles = TRUE;
+    }
+    else if(!_skip_value(ps))
+      return 0;
+  }
+  if(r < 0) return 0;
+  if(!has_model) return _fail(ps, "missing `model`");
+  if(!has_profiles) return _fail(ps, "missing `profiles`");
+
+  _np_camera_t *cam = _db_add_camera(db);
+  if(!cam || !(cam->model = strdup(model))) return _fail(ps, "out of memory");
+  cam->first = first;
+  cam->count = db->n_profiles - first;
+  return 1;
+}
+
+static int _parse_maker(_parser_t *ps, _np_db_t *db)
+{
+  if(!_expect(ps, '{')) return 0;
+  char maker[256] = { 0 };
+  gboolean has_maker = FALSE, has_models = FALSE;
+  const int first = db->n_cameras;
+
+  int n = 0, r;
+  char key[64];
+  while((r = _next_member(ps, &n, key, sizeof(key))) > 0)
+  {
+    if(!strcmp(key, "maker"))
+    {
+      if(!_parse_string(ps, maker, sizeof(maker))) return 0;
+      has_maker = TRUE;
+    }
+    else if(!strcmp(key, "models"))
+    {
+      if(!_expect(ps, '[')) return 0;
+      int m = 0, s;
+      while((s = _next(ps, ']', &m)) > 0)
+        if(!_parse_model(ps, db)) return 0;
+      if(s < 0) return 0;
+      has_models = TRUE;
+    }
+    else if(!_skip_value(ps))
+      return 0;
+  }
+  if(r < 0) return 0;
+  if(!has_maker) return _fail(ps, "missing `maker`");
+  if(!has_models) return _fail(ps, "missing `models`");
+
+  for(int i = first; i < db->n_cameras; i++)
+    if(!(db->cameras[i].maker = strdup(maker))) return _fail(ps, "out of memory");
+  return 1;
+}
+
+static int _parse_root(_parser_t *ps, _np_db_t *db)
+{
+  if(!_expect(ps, '{')) return 0;
+  gboolean has_version = FALSE, has_profiles = FALSE;
+
+  int n = 0, r;
+  char key[64];
+  while((r = _next_member(ps, &n, key, sizeof(key))) > 0)
+  {
+    if(!strcmp(key, "version"))
+    {
+      double version;
+      if(!_parse_number(ps, &version)) return 0;
+      if((int)version != DT_NOISE_PROFILE_VERSION)
+        return _fail(ps, "file version is not what this code understands");
+      has_version = TRUE;
+    }
+    else if(!strcmp(key, "noiseprofiles"))
+    {
+      if(!_expect(ps, '[')) return 0;
+      int m = 0, s;
+      while((s = _next(ps, ']', &m)) > 0)
+        if(!_parse_maker(ps, db)) return 0;
+      if(s < 0) return 0;
+      has_profiles = TRUE;
+    }
+    else if(!_skip_value(ps))
+      return 0;
+  }
+  if(r < 0) return 0;
+  if(!has_version) return _fail(ps, "can't find file version");
+  if(!has_profiles) return _fail(ps, "can't find `noiseprofiles' entry");
+  return 1;
+}
+
+static int _sort_by_iso(const void *a, const void *b)
+{
+  const dt_noiseprofile_t *profile_a = (const dt_noiseprofile_t *)a;
+  const dt_noiseprofile_t *profile_b = (const dt_noiseprofile_t *)b;
+
+  return profile_a->iso - profile_b->iso;
+}
+
+/* ── Loading ─────────────────────────────────────────────────────────────── */
+
+static char *_read_file(const char *filename)
+{
+  FILE *f = fopen(filename, "rb");
+  if(!f) return NULL;
+
+  char *buf = NULL;
+  if(fseek(f, 0, SEEK_END) == 0)
+  {
+    const long size = ftell(f);
+    if(size >= 0 && fseek(f, 0, SEEK_SET) == 0 && (buf = malloc((size_t)size + 1)))
+    {
+      if(fread(buf, 1, (size_t)size, f) == (size_t)size)
+        buf[size] = '\0';
+      else
+      {
+        free(buf);
+        buf = NULL;
+      }
+    }
+  }
+  fclose(f);
+  return buf;
+}
+
+/* Parse `filename` into db.  Called with _db_mutex held. */
+static gboolean _load(const char *filename, _np_db_t *db)
+{
+  char *text = _read_file(filename);
+  if(!text)
+  {
+    fprintf(stderr, "[noiseprofile] can't load noiseprofiles from `%s'\n", filename);
+    return FALSE;
+  }
+
+  _parser_t ps = { .p = text, .err = { 0 } };
+  const int ok = _parse_root(&ps, db);
+  free(text);
+
+  if(!ok)
+  {
+    fprintf(stderr, "[noiseprofile] error: `%s' is not a valid noiseprofile file: %s\n",
+            filename, ps.err);
+    _db_free(db);
+    return FALSE;
+  }
+
+  /* the profiles array is final now: point the profiles at their camera
+     and sort each camera's run by ISO */
+  for(int i = 0; i < db->n_cameras; i++)
+  {
+    const _np_camera_t *cam = &db->cameras[i];
+    dt_noiseprofile_t *run = db->profiles + cam->first;
+    for(int k = 0; k < cam->count; k++)
+    {
+      run[k].maker = cam->maker;
+      run[k].model = cam->model;
+    }
+    qsort(run, cam->count, sizeof(dt_noiseprofile_t), _sort_by_iso);
+  }
+  return TRUE;
+}
+
+bool dt_noiseprofile_init(const char *alternative)
+{
+  char filename[PATH_MAX] = { 0 };
+
+  if(alternative == NULL)
+  {
+    // TODO: shall we look for profiles in the user config dir?
+    if(darktable.datadir && darktable.datadir[0])
+      snprintf(filename, sizeof(filename), "%s/%s", darktable.datadir, "noiseprofiles.json");
+    else
+      snprintf(filename, sizeof(filename), "%s/%s", DTPIPE_DATADIR, "noiseprofiles.json");
+  }
+  else
+    g_strlcpy(filename, alternative, sizeof(filename));
+
+  _np_db_t db = { 0 };
+  const gboolean ok = _load(filename, &db);
+
+  dt_pthread_mutex_lock(&_db_mutex);
+  if(ok)
+  {
+    _db_free(&_db);
+    _db = db;
+  }
+  _db_tried = TRUE;
+  dt_pthread_mutex_unlock(&_db_mutex);
+  return ok;
+}
+
+/* ── Lookup ──────────────────────────────────────────────────────────────── */
+
+int dt_noiseprofile_get_matching(const dt_image_t *cimg,
+                                 const dt_noiseprofile_t **profiles)
+{
+  *profiles = NULL;
+
+  dt_pthread_mutex_lock(&_db_mutex);
+  const gboolean tried = _db_tried;
+  dt_pthread_mutex_unlock(&_db_mutex);
+  if(!tried) dt_noiseprofile_init(NULL);
+
+  if(!cimg->camera_maker[0] || !cimg->camera_model[0]) return 0;
+
+  dt_pthread_mutex_lock(&_db_mutex);
+  int count = 0;
+  for(int i = 0; i < _db.n_cameras; i++)
+  {
+    const _np_camera_t *cam = &_db.cameras[i];
+    if(strstr(cimg->camera_maker, cam->maker) && !strcmp(cimg->camera_model, cam->model))
+    {
+      *profiles = _db.profiles + cam->first;
+      count = cam->count;
+      break;
+    }
+  }
+  dt_pthread_mutex_unlock(&_db_mutex);
+  return count;
+}
+
+void dt_noiseprofile_interpolate(
+  const dt_noiseprofile_t *const p1,  // the smaller iso
+  const dt_noiseprofile_t *const p2,  // the larger iso (can't be == iso1)
+  dt_noiseprofile_t *out)             // has iso initialized
+{
+  // stupid linear interpolation.
+  // to be confirmed for gaussian part.
+  const float t = CLAMP(
+    (float)(out->iso - p1->iso) / (float)(p2->iso - p1->iso),
+                        0.0f, 1.0f);
+  for(int k=0; k<3; k++)
+  {
+    out->a[k] = (1.0f-t)*p1->a[k] + t*p2->a[k];
+    out->b[k] = (1.0f-t)*p1->b[k] + t*p2->b[k];
+  }
+}
+
+void dt_noiseprofile_cleanup(void)
+{
+  dt_pthread_mutex_lock(&_db_mutex);
+  _db_free(&_db);
+  _db_tried = FALSE;
+  dt_pthread_mutex_unlock(&_db_mutex);
+}
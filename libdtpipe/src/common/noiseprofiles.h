@@ -0,0 +1,66 @@
+/*
+ * noiseprofiles.h - Camera noise profile database
+ *
+ * Ported from darktable src/common/noiseprofiles.c
+ * Copyright (C) 2013-2020 darktable developers.
+ *
+ * Stripped of: json-glib and GList.  data/noiseprofiles.json is read once
+ * with a small hand-written parser into a flat table, grouped by camera
+ * and sorted by ISO, and lookups return a slice of that table.
+ *
+ * The table is loaded lazily on the first lookup from
+ * <datadir>/noiseprofiles.json (datadir as passed to dtpipe_init(), else
+ * the build-tree share/dtpipe) and stays read-only until
+ * dt_noiseprofile_cleanup(), so pipes on any thread can share it.
+ */
+
+#pragma once
+
+#include "dtpipe_internal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct dt_noiseprofile_t
+{
+  const char *name;
+  const char *maker;
+  const char *model;
+  int iso;
+  dt_aligned_pixel_t a; // poissonian part; use 4 aligned instead of 3 elements to aid vectorization
+  dt_aligned_pixel_t b; // gaussian part
+} dt_noiseprofile_t;
+
+extern const dt_noiseprofile_t dt_noiseprofile_generic;
+
+/**
+ * Load the database from `alternative`, or from the data directory when
+ * NULL, replacing any table already loaded.  Returns false (after printing
+ * why) when the file is missing or invalid.
+ */
+bool dt_noiseprofile_init(const char *alternative);
+
+/**
+ * Profiles matching the image's maker and model, sorted by ascending ISO,
+ * stored in *profiles.  Returns their count (0 when the camera is unknown
+ * or no database could be loaded).  The profiles stay valid until
+ * dt_noiseprofile_cleanup().
+ */
+int dt_noiseprofile_get_matching(const dt_image_t *cimg,
+                                 const dt_noiseprofile_t **profiles);
+
+/*
+ * interpolate values from p1 and p2 into out.
+ */
+void dt_noiseprofile_interpolate(
+  const dt_noiseprofile_t *const p1,  // the smaller iso
+  const dt_noiseprofile_t *const p2,  // the larger iso (can't be == iso1)
+  dt_noiseprofile_t *out);            // has iso initialized
+
+/** Free the loaded table (called from dtpipe_cleanup()). */
+void dt_noiseprofile_cleanup(void);
+
+#ifdef __cplusplus
+}
+#endif
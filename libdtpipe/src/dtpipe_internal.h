@@ -87,6 +87,8 @@ static inline int omp_get_thread_num(void)  { return 0; }
 
 /** Aligned 4-float pixel vector */
 typedef DT_ALIGNED_PIXEL float dt_aligned_pixel_t[4];
+/** one float-RGBA pixel as a 128-bit vector, for loops working on whole pixels */
+typedef float dt_aligned_pixel_simd_t __attribute__((vector_size(16)));
 
 /** 3×3 matrix padded to 4×4 for SIMD */
 typedef float DT_ALIGNED_ARRAY dt_colormatrix_t[4][4];
@@ -630,6 +632,47 @@ typedef enum dt_image_colorspace_t
   DT_IMAGE_COLORSPACE_ADOBE_RGB,
 } dt_image_colorspace_t;
 
+/* ── dt_image_correction_data_t ──────────────────────────────────────────── */
+/* Lens correction tables embedded by the camera (read by load.cc, consumed
+ * by iop/lens.c).  Layout matches darktable src/common/image.h. */
+
+typedef enum dt_image_correction_type_t
+{
+  CORRECTION_TYPE_NONE,
+  CORRECTION_TYPE_SONY,
+  CORRECTION_TYPE_FUJI,
+  CORRECTION_TYPE_DNG,
+  CORRECTION_TYPE_OLYMPUS
+} dt_image_correction_type_t;
+
+typedef union dt_image_correction_data_t
+{
+  struct {
+    int nc;
+    short distortion[16], ca_r[16], ca_b[16], vignetting[16];
+  } sony;
+  struct {
+    int nc;
+    float cropf;
+    float knots[11], distortion[11], ca_r[11], ca_b[11], vignetting[11];
+  } fuji;
+  struct {
+    int planes;
+    float cwarp[3][6]; /* for up to 3 planes warp rectilinear */
+    float centre_warp[2];
+    float cvig[5];     /* for vignetting */
+    float centre_vig[2];
+    int has_warp;
+    int has_vignette;
+  } dng;
+  struct {
+    int has_dist;
+    float dist[4];
+    int has_ca;
+    float ca[6];
+  } olympus;
+} dt_image_correction_data_t;
+
 /* ── dt_image_t ──────────────────────────────────────────────────────────── */
 /*
  * Image metadata.  Fields preserved:
@@ -642,7 +685,6 @@ typedef enum dt_image_colorspace_t
  * Fields removed from the original:
  *   - database IDs (film_id, group_id, id) — not meaningful standalone
  *   - thumbnail / cache machinery
- *   - lens-correction correction tables (sensor-specific)
  *   - geolocation
  *   - GLib timestamps
  */
@@ -710,6 +752,10 @@ typedef struct dt_image_t
   /* Adobe XYZ→CAM matrix */
   float              adobe_XYZ_to_CAM[4][3];
 
+  /* Embedded lens correction (Sony / Fuji / Olympus makernotes) */
+  dt_image_correction_type_t exif_correction_type;
+  dt_image_correction_data_t exif_correction_data;
+
   /* User crop (normalised bounding box: x0,y0,x1,y1) */
   float              usercrop[4];
 
@@ -742,6 +788,7 @@ struct dt_dev_pixelpipe_iop_t;
 struct dt_develop_tiling_t;
 struct dt_iop_order_iccprofile_info_t;
 struct dt_develop_blend_params_t;
+struct dt_hotpixels_t;
 struct dt_dev_pixelpipe_cache_t;
 
 /* ── dt_develop_tiling_t ─────────────────────────────────────────────────── */
@@ -848,6 +895,24 @@ typedef struct dt_dev_pixelpipe_iop_t
 
   /* Raster mask table (maps mask id → float*).  NULL if unused. */
   void *raster_masks; /* GHashTable* in the original; opaque here */
+
+  /* Matrix stage fusion, planned by pixelpipe.c before each run.  The head
+     of a run of adjacent color_matrix() pieces has fused_count > 0 and
+     applies fused_matrix (out = M · in) instead of its own process(); the
+     pieces folded into it have fused_into set and are skipped.  The same
+     fields describe warp fusion: a head with fused_warp set resamples once
+     through the composed distort_backtransform() of itself and the next
+     fused_count geometric pieces. */
+  float fused_matrix[3][3];
+  int   fused_count;
+  bool  fused_into;
+  bool  fused_warp;
+
+  /* Raw stage fusion: on the rawprepare piece, the hot pixel filter of a
+     later piece (fused_into set) to run while the mosaic is scaled, and
+     the per-colour gains of the pieces it was moved across. */
+  const struct dt_hotpixels_t *fused_hotpixels;
+  float fused_raw_gains[4];
 } dt_dev_pixelpipe_iop_t;
 
 /* ── dt_dev_pixelpipe_t ──────────────────────────────────────────────────── */
@@ -1020,6 +1085,48 @@ typedef struct dt_iop_module_so_t
                          struct dt_dev_pixelpipe_iop_t *piece,
                          dt_iop_roi_t *roi_out,
                          const dt_iop_roi_t *roi_in);
+
+  /** Compute tiling requirements (NULL → dt_iop_default_tiling_callback). */
+  void (*tiling_callback)(struct dt_iop_module_t *self,
+                          struct dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *roi_in,
+                          const dt_iop_roi_t *roi_out,
+                          struct dt_develop_tiling_t *tiling);
+
+  /** If the committed piece is one 3×3 matrix on RGB (alpha copied), write
+      it to M (out = M · in) and return true.  The pipe fuses runs of such
+      pieces into a single pass (NULL → never fused). */
+  bool (*color_matrix)(struct dt_iop_module_t *self,
+                       struct dt_dev_pixelpipe_iop_t *piece,
+                       dt_colormatrix_t M);
+
+  /** Map points_count (x, y) pairs in place from the piece's full-size input
+      to its full-size output (transform) or back (backtransform).  Pieces
+      that have both, modify_roi_in() and 4-channel float buffers are
+      geometric: the pipe folds adjacent ones into one resampling pass and
+      passes a piece through without copying when its map is the identity
+      on pixels (e.g. a crop).  Called per row from a parallel loop. */
+  bool (*distort_transform)(struct dt_iop_module_t *self,
+                            struct dt_dev_pixelpipe_iop_t *piece,
+                            float *const points,
+                            const size_t points_count);
+  bool (*distort_backtransform)(struct dt_iop_module_t *self,
+                                struct dt_dev_pixelpipe_iop_t *piece,
+                                float *const points,
+                                const size_t points_count);
+
+  /** If all the committed piece does is a gain per CFA colour on the raw
+      mosaic (white balance), write the gains and return true.  Raw filters
+      may then be moved ahead of it (NULL → never). */
+  bool (*raw_gains)(struct dt_iop_module_t *self,
+                    struct dt_dev_pixelpipe_iop_t *piece,
+                    float gains[4]);
+
+  /** Hot pixel filter the pipe may run inside rawprepare's scaling pass
+      instead of this piece's process(), or NULL when the piece has to run
+      on its own. */
+  const struct dt_hotpixels_t *(*raw_prefilter)(struct dt_iop_module_t *self,
+                                                struct dt_dev_pixelpipe_iop_t *piece);
 } dt_iop_module_so_t;
 
 /* Helper: check if a module's so matches a given op name */
@@ -1168,6 +1275,29 @@ typedef struct dt_iop_module_t
                           const dt_iop_roi_t *roi_out,
                           struct dt_develop_tiling_t *tiling);
 
+  /** Pure-matrix query for stage fusion (mirrors so->color_matrix). */
+  bool (*color_matrix)(struct dt_iop_module_t *self,
+                       struct dt_dev_pixelpipe_iop_t *piece,
+                       dt_colormatrix_t M);
+
+  /** Point maps for warp fusion (mirror so->distort_transform and
+      so->distort_backtransform). */
+  bool (*distort_transform)(struct dt_iop_module_t *self,
+                            struct dt_dev_pixelpipe_iop_t *piece,
+                            float *const points,
+                            const size_t points_count);
+  bool (*distort_backtransform)(struct dt_iop_module_t *self,
+                                struct dt_dev_pixelpipe_iop_t *piece,
+                                float *const points,
+                                const size_t points_count);
+
+  /** Raw stage fusion queries (mirror so->raw_gains and so->raw_prefilter). */
+  bool (*raw_gains)(struct dt_iop_module_t *self,
+                    struct dt_dev_pixelpipe_iop_t *piece,
+                    float gains[4]);
+  const struct dt_hotpixels_t *(*raw_prefilter)(struct dt_iop_module_t *self,
+                                                struct dt_dev_pixelpipe_iop_t *piece);
+
   /** Returns IOP flags (combination of dt_iop_flags_t). */
   int (*flags)(void);
 
@@ -1443,51 +1573,14 @@ static inline void tiling_callback_blendop(
 
 /**
  * Scale a float-RGBA input buffer into an output buffer according to ROIs.
- * Simple bilinear implementation sufficient for headless export.
+ * `in` holds the full roi_in; roi_out->x/y/scale select the output window.
+ * Implemented in common/interpolation.c on top of the plan-cached separable
+ * resampler (user-preferred interpolator, bilinear tent by default).
  */
-static inline void dt_iop_clip_and_zoom(float *restrict out,
-                                        const float *restrict in,
-                                        const dt_iop_roi_t *const roi_out,
-                                        const dt_iop_roi_t *const roi_in)
-{
-  const float scalex = (float)roi_in->width  / (float)roi_out->width;
-  const float scaley = (float)roi_in->height / (float)roi_out->height;
-
-  DT_OMP_FOR()
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    const float fy = (j + 0.5f) * scaley - 0.5f;
-    const int   y0 = (int)fy;
-    const int   y1 = y0 + 1;
-    const float dy = fy - (float)y0;
-
-    const int iy0 = CLAMPS(y0, 0, roi_in->height - 1);
-    const int iy1 = CLAMPS(y1, 0, roi_in->height - 1);
-
-    for(int i = 0; i < roi_out->width; i++)
-    {
-      const float fx = (i + 0.5f) * scalex - 0.5f;
-      const int   x0 = (int)fx;
-      const int   x1 = x0 + 1;
-      const float dx = fx - (float)x0;
-
-      const int ix0 = CLAMPS(x0, 0, roi_in->width - 1);
-      const int ix1 = CLAMPS(x1, 0, roi_in->width - 1);
-
-      const float *p00 = in + 4 * (iy0 * roi_in->width + ix0);
-      const float *p01 = in + 4 * (iy0 * roi_in->width + ix1);
-      const float *p10 = in + 4 * (iy1 * roi_in->width + ix0);
-      const float *p11 = in + 4 * (iy1 * roi_in->width + ix1);
-
-      float *o = out + 4 * (j * roi_out->width + i);
-      for(int c = 0; c < 4; c++)
-      {
-        o[c] = (1.0f - dy) * ((1.0f - dx) * p00[c] + dx * p01[c])
-                     + dy  * ((1.0f - dx) * p10[c] + dx * p11[c]);
-      }
-    }
-  }
-}
+void dt_iop_clip_and_zoom(float *out,
+                          const float *const in,
+                          const dt_iop_roi_t *const roi_out,
+                          const dt_iop_roi_t *const roi_in);
 
 /* ── Output format helper ────────────────────────────────────────────────── */
 
@@ -1617,6 +1710,32 @@ static inline void dt_dev_pixelpipe_cache_flush(struct dt_dev_pixelpipe_t *pipe)
   (void)pipe;
 }
 
+/*
+ * Hash of everything a piece's input depends on: the pipe input (buffer,
+ * size, scale and a timestamp bumped by dt_dev_pixelpipe_set_input()), the
+ * params/enabled/blend hash of every upstream piece as of the last commit,
+ * and roi.  include adds the piece's own params.  Modules use it to keep
+ * expensive intermediate results (e.g. toneequal's mask) across runs.
+ */
+dt_hash_t dt_dev_pixelpipe_piece_hash(const struct dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_roi_t *roi,
+                                      const bool include);
+
+/*
+ * Resample a float-RGBA buffer through the composed distort_backtransform()
+ * of pieces[count - 1] down to pieces[0]: every output pixel centre of
+ * roi_out is mapped back into roi_in of pieces[0] and sampled once with the
+ * warp interpolator.  Points that land on a pixel centre are copied, so
+ * flips, 90° turns and integer shifts stay lossless.  Used by the pipe for
+ * fused geometric runs and by single geometric modules.
+ */
+void dt_dev_pixelpipe_warp(struct dt_dev_pixelpipe_iop_t *const *pieces,
+                           const int count,
+                           const float *const in,
+                           float *const out,
+                           const dt_iop_roi_t *const roi_in,
+                           const dt_iop_roi_t *const roi_out);
+
 /* ── Performance timing stubs ────────────────────────────────────────────── */
 
 typedef struct { double clock; double user; } dt_times_t;
@@ -1778,6 +1897,13 @@ static inline gboolean dt_image_is_ldr(const dt_image_t *img)
   return (img->flags & DT_IMAGE_LDR) != 0;
 }
 
+/* Raw with a colour Bayer mosaic (not X-Trans, not monochrome). */
+static inline gboolean dt_image_is_bayerRGB(const dt_image_t *img)
+{
+  return dt_image_is_raw(img) && img->buf_dsc.filters && img->buf_dsc.filters != 9u
+         && !dt_image_is_monochrome(img);
+}
+
 static inline gboolean dt_image_is_hdr(const dt_image_t *img)
 {
   return (img->flags & DT_IMAGE_HDR) != 0;
@@ -452,6 +452,14 @@ static int _apply_param_cb(void *ctx, const char *key, _parser_t *ps)
       memcpy(dst, &stored, sizeof(int32_t));
       break;
     }
+    case DT_PARAM_STRING:
+    {
+      char sv[1024];
+      if(!_parse_string(ps, sv, MIN(d->size, sizeof(sv)))) return 0;
+      memset(dst, 0, d->size);
+      memcpy(dst, sv, strlen(sv));
+      break;
+    }
     default:
       fprintf(stderr,
               "[dtpipe/deserialize] warning: unknown type for param '%s.%s' — skipping\n",
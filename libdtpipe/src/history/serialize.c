@@ -281,6 +281,16 @@ static int _serialize_params(_buf_t *b,
         if(!_buf_puts(b, bv ? "true" : "false")) return 0;
         break;
       }
+      case DT_PARAM_STRING:
+      {
+        /* the field need not be NUL-terminated in a foreign params blob */
+        char sv[1024];
+        const size_t n = MIN(d->size, sizeof(sv) - 1);
+        memcpy(sv, src, n);
+        sv[strnlen(sv, n)] = '\0';
+        if(!_buf_put_json_string(b, sv)) return 0;
+        break;
+      }
       default:
         if(!_buf_puts(b, "null")) return 0;
         break;
@@ -122,9 +122,13 @@ static const float *_run_pipeline(dt_pipe_t *pipe, int *out_w, int *out_h)
                              1.0f,   /* iscale: full resolution */
                              pipe->img);
 
+  /* Geometric modules (crop, flip, ashift) change the output size */
+  int out_width = W, out_height = H;
+  dt_dev_pixelpipe_get_dimensions(&pipe->pipe, W, H, &out_width, &out_height);
+
   const bool err = dt_dev_pixelpipe_process(&pipe->pipe,
                                             0, 0,   /* origin */
-                                            W, H,
+                                            out_width, out_height,
                                             1.0f);  /* scale */
   if(err)
   {
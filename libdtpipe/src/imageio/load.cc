@@ -86,6 +86,117 @@ static inline uint16_t _clamp_u16(int v)
   return (uint16_t)v;
 }
 
+/*
+ * Embedded lens correction tables (ported from darktable
+ * src/common/exif.cc _check_lens_correction_data).  DNG opcode lists are
+ * not parsed: libdtpipe has no DNG opcode reader.
+ */
+static void _read_lens_correction(Exiv2::ExifData &exif, dt_image_t *img)
+{
+  if(Exiv2::versionNumber() < EXIV2_MAKE_VERSION(0, 27, 4)) return;
+
+  auto find = [&](const char *key, Exiv2::ExifData::const_iterator &pos) {
+    pos = exif.findKey(Exiv2::ExifKey(key));
+    return pos != exif.end() && pos->size();
+  };
+
+  Exiv2::ExifData::const_iterator pos, posd, posc, posv;
+  dt_image_correction_data_t *cd = &img->exif_correction_data;
+
+  /* Sony */
+  if(find("Exif.SubImage1.DistortionCorrParams", posd)
+     && find("Exif.SubImage1.ChromaticAberrationCorrParams", posc)
+     && find("Exif.SubImage1.VignettingCorrParams", posv))
+  {
+    const int nc = (int)posd->toInt64(0);
+    if(nc <= 16 && 2 * nc == posc->toInt64(0) && nc == posv->toInt64(0))
+    {
+      img->exif_correction_type = CORRECTION_TYPE_SONY;
+      cd->sony.nc = nc;
+      for(int i = 0; i < nc; i++)
+      {
+        cd->sony.distortion[i] = (short)posd->toInt64(i + 1);
+        cd->sony.ca_r[i]       = (short)posc->toInt64(i + 1);
+        cd->sony.ca_b[i]       = (short)posc->toInt64(nc + i + 1);
+        cd->sony.vignetting[i] = (short)posv->toInt64(i + 1);
+      }
+    }
+  }
+
+  /* Fuji */
+  if(find("Exif.Fujifilm.GeometricDistortionParams", posd)
+     && find("Exif.Fujifilm.ChromaticAberrationParams", posc)
+     && find("Exif.Fujifilm.VignettingParams", posv))
+  {
+    /* X-Trans IV/V: 9 knots; X-Trans I/II/III: 11 knots, CA data lacks
+       the first (zero) knot */
+    const bool v4 = posd->count() == 19 && posc->count() == 29 && posv->count() == 19;
+    const bool v3 = posd->count() == 23 && posc->count() == 31 && posv->count() == 23;
+    if(v4 || v3)
+    {
+      const int nc = v4 ? 9 : 11;
+      const int doff = v4 ? 10 : 12;
+      img->exif_correction_type = CORRECTION_TYPE_FUJI;
+      cd->fuji.nc = nc;
+      for(int i = 0; i < nc; i++)
+      {
+        const float kd = posd->toFloat(i + 1);
+        const float kc = v4 ? posc->toFloat(i + 1) : (i ? posc->toFloat(i) : 0.0f);
+        const float kv = posv->toFloat(i + 1);
+
+        /* knot positions must agree for distortion, ca and vignetting */
+        if(kd != kc || kd != kv)
+        {
+          img->exif_correction_type = CORRECTION_TYPE_NONE;
+          break;
+        }
+
+        cd->fuji.knots[i]      = kd;
+        cd->fuji.distortion[i] = posd->toFloat(i + doff);
+        cd->fuji.ca_r[i]       = v4 ? posc->toFloat(i + 10) : (i ? posc->toFloat(i + 10) : 0.0f);
+        cd->fuji.ca_b[i]       = v4 ? posc->toFloat(i + 19) : (i ? posc->toFloat(i + 20) : 0.0f);
+        cd->fuji.vignetting[i] = posv->toFloat(i + doff);
+      }
+
+      /* 1.25x crop modes in some Fuji cameras */
+      cd->fuji.cropf = find("Exif.Fujifilm.CropMode", pos)
+                       && (pos->toInt64() == 2 || pos->toInt64() == 4)
+                       ? 1.25f : 1.0f;
+    }
+  }
+
+  /* Olympus distortion */
+  if(find("Exif.OlympusIp.0x150a", pos) && pos->count() == 4)
+  {
+    for(int i = 0; i < 4; i++)
+    {
+      const float kd = pos->toFloat(i);
+      cd->olympus.dist[i] = kd;
+      /* null correction is '0 0 0 1': only the first three count */
+      if(kd != 0.0f && i < 3)
+      {
+        img->exif_correction_type = CORRECTION_TYPE_OLYMPUS;
+        cd->olympus.has_dist = TRUE;
+      }
+    }
+  }
+
+  /* Olympus CA */
+  if(find("Exif.OlympusIp.0x150c", pos) && pos->count() == 6)
+  {
+    for(int i = 0; i < 6; i++)
+    {
+      const float kc = pos->toFloat(i);
+      cd->olympus.ca[i] = kc;
+      if(kc != 0.0f)
+      {
+        img->exif_correction_type = CORRECTION_TYPE_OLYMPUS;
+        cd->olympus.has_ca = TRUE;
+      }
+    }
+  }
+}
+
 /*
  * Read EXIF scalars that rawspeed doesn't expose (exposure, aperture, ISO,
  * focal length) using exiv2.
@@ -173,6 +284,8 @@ static void _read_exif(dt_image_t *m, const char *path)
                  "%s", it->print(&exif).c_str());
     }
 
+    _read_lens_correction(exif, m);
+
     m->exif_inited = true;
   }
   catch(const std::exception &)
@@ -16,6 +16,9 @@
 
 #include "dtpipe.h"
 #include "dtpipe_internal.h"
+#include "common/interpolation.h"
+#include "common/lut3d_cache.h"
+#include "common/noiseprofiles.h"
 
 #include <lcms2.h>
 #include <pthread.h>
@@ -136,6 +139,21 @@ extern void dt_iop_temperature_init_global(dt_iop_module_so_t *module);
 extern void dt_iop_demosaic_init_global(dt_iop_module_so_t *module);
 extern void dt_iop_sharpen_init_global(dt_iop_module_so_t *module);
 extern void dt_iop_highlights_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_lens_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_sigmoid_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_filmicrgb_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_agx_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_colorin_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_channelmixerrgb_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_lut3d_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_denoiseprofile_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_bilat_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_toneequal_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_ashift_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_flip_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_crop_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_cacorrect_init_global(dt_iop_module_so_t *module);
+extern void dt_iop_hotpixels_init_global(dt_iop_module_so_t *module);
 /* --- end IOP forward declarations --------------------------------------- */
 
 typedef void (*iop_init_global_fn_t)(dt_iop_module_so_t *);
@@ -155,12 +173,26 @@ typedef struct
 static const iop_registration_t _iop_registry[] = {
   { "rawprepare",  dt_iop_rawprepare_init_global }, /* Task 8.5: real process */
   { "demosaic",    dt_iop_demosaic_init_global }, /* Task 8.7: PPG + passthrough */
-  { "colorin",     NULL },
+  { "colorin",     dt_iop_colorin_init_global },     /* camera matrix only */
   { "exposure",    dt_iop_exposure_init_global },   /* Task 8.4: real process */
   { "colorout",    NULL },
   { "temperature", dt_iop_temperature_init_global }, /* Task 8.6: real process */
   { "highlights",  dt_iop_highlights_init_global }, /* Task 8.9: clip mode */
   { "sharpen",     dt_iop_sharpen_init_global },     /* Task 8.9: USM */
+  { "lens",        dt_iop_lens_init_global },        /* embedded metadata */
+  { "sigmoid",     dt_iop_sigmoid_init_global },     /* curve LUT */
+  { "filmicrgb",   dt_iop_filmicrgb_init_global },   /* curve LUT, no reconstruction */
+  { "agx",         dt_iop_agx_init_global },         /* curve LUT */
+  { "channelmixerrgb", dt_iop_channelmixerrgb_init_global }, /* fuses into colorin */
+  { "lut3d",       dt_iop_lut3d_init_global },       /* shared LUT cache */
+  { "denoiseprofile", dt_iop_denoiseprofile_init_global }, /* CPU wavelets + nlmeans */
+  { "bilat",       dt_iop_bilat_init_global },       /* bilateral grid + tiled local laplacian */
+  { "toneequal",   dt_iop_toneequal_init_global },   /* cached low-resolution guided filter mask */
+  { "ashift",      dt_iop_ashift_init_global },      /* folded into one warp with flip / crop */
+  { "flip",        dt_iop_flip_init_global },        /* lossless index remap */
+  { "crop",        dt_iop_crop_init_global },        /* pure ROI change, no copy */
+  { "cacorrect",   dt_iop_cacorrect_init_global },   /* raw CA, fit cached per input */
+  { "hotpixels",   dt_iop_hotpixels_init_global },   /* folded into rawprepare on Bayer */
 };
 
 static const int _iop_registry_len =
@@ -293,6 +325,15 @@ void dtpipe_cleanup(void)
   /* Release IOP modules (reverse of init) */
   _unregister_iop_modules();
 
+  /* Release cached resampling plans */
+  dt_interpolation_cleanup();
+
+  /* Release cached 3D LUTs */
+  dt_lut3d_cache_cleanup();
+
+  /* Release the noise profile database */
+  dt_noiseprofile_cleanup();
+
   /* Release color management */
   _cleanup_color_management();
 
@@ -0,0 +1,868 @@
+/*
+ * agx.c - darktable AgX IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/agx.c (GPLv3).
+ * GUI code, OpenCL, presets, colour picker auto-tuning and legacy_params()
+ * removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - Log encoding, the toe/linear/shoulder curve and (when no look is set)
+ *     the gamma linearisation are folded into one log-domain LUT per commit
+ *     (common/curve_lut.h); the default path does no log2f/powf per pixel.
+ *   - The inset/outset matrices are built in commit_params() instead of once
+ *     per process() call.
+ *   - "working profile" base primaries resolve to linear Rec.709, the
+ *     pipeline colour space; "export profile" falls back to Rec.2020 as
+ *     darktable does when no matrix export profile is available.
+ *   - The per-pixel kernel is a static inline function taking only the
+ *     committed data, so it can be chained with other pointwise ops.
+ *
+ * Struct layout of dt_iop_agx_params_t MUST match the descriptor table
+ * in libdtpipe/src/pipe/params.c (_agx_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2025 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+#include "common/curve_lut.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const float _epsilon = 1E-6f;
+static const float _default_gamma = 2.2f;
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+typedef enum dt_iop_agx_base_primaries_t
+{
+  DT_AGX_EXPORT_PROFILE = 0,
+  DT_AGX_WORK_PROFILE = 1,
+  DT_AGX_REC2020 = 2,
+  DT_AGX_DISPLAY_P3 = 3,
+  DT_AGX_ADOBE_RGB = 4,
+  DT_AGX_SRGB = 5,
+} dt_iop_agx_base_primaries_t;
+
+/*
+ * IMPORTANT: field order and types must exactly match _agx_params_t in
+ * pipe/params.c so that memcpy-based history load/save works correctly.
+ */
+typedef struct dt_iop_agx_params_t
+{
+  float   look_lift;                        /* [-1, 1]                         */
+  float   look_slope;                       /* [0, 10]                         */
+  float   look_brightness;                  /* [0, 100]                        */
+  float   look_saturation;                  /* [0, 10]                         */
+  float   look_original_hue_mix_ratio;      /* [0, 1]                          */
+
+  float   range_black_relative_ev;          /* [-20, -0.1]                     */
+  float   range_white_relative_ev;          /* [0.1, 20]                       */
+  float   dynamic_range_scaling;            /* [-0.5, 2]                       */
+
+  float   curve_pivot_x;                    /* [0, 1]                          */
+  float   curve_pivot_y_linear_output;      /* [0, 1]                          */
+  float   curve_contrast_around_pivot;      /* [0.1, 10]                       */
+  float   curve_linear_ratio_below_pivot;   /* [0, 1]                          */
+  float   curve_linear_ratio_above_pivot;   /* [0, 1]                          */
+  float   curve_toe_power;                  /* [0, 10]                         */
+  float   curve_shoulder_power;             /* [0, 10]                         */
+  float   curve_gamma;                      /* [0.01, 100]                     */
+  int32_t auto_gamma;                       /* bool                            */
+  float   curve_target_display_black_ratio; /* [0, 0.15]                       */
+  float   curve_target_display_white_ratio; /* [0.2, 1]                        */
+
+  int32_t base_primaries;                   /* dt_iop_agx_base_primaries_t     */
+  int32_t disable_primaries_adjustments;    /* bool                            */
+  float   red_inset;
+  float   red_rotation;
+  float   green_inset;
+  float   green_rotation;
+  float   blue_inset;
+  float   blue_rotation;
+
+  float   master_outset_ratio;
+  float   master_unrotation_ratio;
+  float   red_outset;
+  float   red_unrotation;
+  float   green_outset;
+  float   green_unrotation;
+  float   blue_outset;
+  float   blue_unrotation;
+
+  int32_t completely_reverse_primaries;     /* bool                            */
+} dt_iop_agx_params_t;
+
+typedef struct tone_mapping_params_t
+{
+  float black_relative_ev;
+  float white_relative_ev;
+  float range_in_ev;
+  float curve_gamma;
+
+  /* toe: (0, target_black) to (toe_transition_x, toe_transition_y) */
+  float pivot_x;
+  float pivot_y;
+  float target_black;
+  float toe_power;
+  float toe_transition_x;
+  float toe_transition_y;
+  float toe_scale;
+  int need_convex_toe;
+  float toe_fallback_coefficient;
+  float toe_fallback_power;
+
+  /* linear section y = slope * x + intercept */
+  float slope;
+  float intercept;
+
+  /* shoulder: (shoulder_transition_x, shoulder_transition_y) to (1, target_white) */
+  float target_white;
+  float shoulder_power;
+  float shoulder_transition_x;
+  float shoulder_transition_y;
+  float shoulder_scale;
+  int need_concave_shoulder;
+  float shoulder_fallback_coefficient;
+  float shoulder_fallback_power;
+
+  /* look */
+  float look_lift;
+  float look_slope;
+  float look_power;
+  float look_saturation;
+  float look_original_hue_mix_ratio;
+  int look_tuned;
+  int restore_hue;
+} tone_mapping_params_t;
+
+typedef struct primaries_params_t
+{
+  dt_iop_agx_base_primaries_t base_primaries;
+
+  float inset[3];
+  float rotation[3];
+
+  float master_outset_ratio;
+  float master_unrotation_ratio;
+
+  float outset[3];
+  float unrotation[3];
+} primaries_params_t;
+
+typedef struct dt_iop_agx_data_t
+{
+  tone_mapping_params_t tone_mapping_params;
+  primaries_params_t primaries_params;
+  int base_working_same_profile;
+  dt_colormatrix_t rendering_to_xyz_transposed;
+  dt_colormatrix_t pipe_to_base_transposed;
+  dt_colormatrix_t base_to_rendering_transposed;
+  dt_colormatrix_t rendering_to_pipe_transposed;
+  /* log encoding + curve, and the gamma linearisation unless a look is set */
+  dt_curve_lut_t curve;
+} dt_iop_agx_data_t;
+
+/* ── Curve ──────────────────────────────────────────────────────────────── */
+
+static inline float _line(const float x, const float slope, const float intercept)
+{
+  return slope * x + intercept;
+}
+
+/* s_t, s_s at https://www.desmos.com/calculator/yrysofmx8h, rewritten as
+ * base = actual_rise^-power - projected_rise^-power */
+static inline float _scale(const float limit_x,
+                           const float limit_y,
+                           const float transition_x,
+                           const float transition_y,
+                           const float slope,
+                           const float power)
+{
+  /* the hypothetical 'rise' if the linear section were extended to the limit */
+  const float projected_rise = slope * fmaxf(_epsilon, limit_x - transition_x);
+  /* the actual 'rise' the curve needs to cover */
+  const float actual_rise = fmaxf(_epsilon, limit_y - transition_y);
+
+  const float transformed_projected_rise = powf(projected_rise, -power);
+  const float transformed_actual_rise = powf(actual_rise, -power);
+  const float base = fmaxf(_epsilon, transformed_actual_rise - transformed_projected_rise);
+  const float scale_value = powf(base, -1.f / power);
+
+  /* avoid 'explosions' */
+  return fminf(1e9f, scale_value);
+}
+
+/* f_t(x), f_s(x) */
+static inline float _sigmoid(const float x, const float power)
+{
+  return x / powf(1.f + powf(x, power), 1.f / power);
+}
+
+/* f_ss, f_ts */
+static inline float _scaled_sigmoid(const float x,
+                                    const float scale,
+                                    const float slope,
+                                    const float power,
+                                    const float transition_x,
+                                    const float transition_y)
+{
+  return scale * _sigmoid(slope * (x - transition_x) / scale, power) + transition_y;
+}
+
+/* Fallback toe/shoulder, so we can always reach black and white.
+ * See https://www.desmos.com/calculator/gijzff3wlv */
+static inline float _fallback_toe(const float x, const tone_mapping_params_t *params)
+{
+  return x < 0.f
+           ? params->target_black
+           : params->target_black
+             + fmaxf(0.f, params->toe_fallback_coefficient * powf(x, params->toe_fallback_power));
+}
+
+static inline float _fallback_shoulder(const float x, const tone_mapping_params_t *params)
+{
+  return x >= 1.f
+           ? params->target_white
+           : params->target_white
+             - fmaxf(0.f, params->shoulder_fallback_coefficient
+                          * powf(1.f - x, params->shoulder_fallback_power));
+}
+
+static inline float _apply_curve(const float x, const tone_mapping_params_t *params)
+{
+  float result = 0.f;
+
+  if(x < params->toe_transition_x)
+  {
+    result = params->need_convex_toe
+               ? _fallback_toe(x, params)
+               : _scaled_sigmoid(x, params->toe_scale, params->slope, params->toe_power,
+                                 params->toe_transition_x, params->toe_transition_y);
+  }
+  else if(x <= params->shoulder_transition_x)
+  {
+    result = _line(x, params->slope, params->intercept);
+  }
+  else
+  {
+    result = params->need_concave_shoulder
+               ? _fallback_shoulder(x, params)
+               : _scaled_sigmoid(x, params->shoulder_scale, params->slope, params->shoulder_power,
+                                 params->shoulder_transition_x, params->shoulder_transition_y);
+  }
+  return CLAMPF(result, params->target_black, params->target_white);
+}
+
+static inline float _apply_log_encoding(const float x,
+                                        const float range_in_ev,
+                                        const float black_relative_ev)
+{
+  /* input is linear RGB relative to 0.18 mid-gray; normalise to [0, 1] */
+  const float x_relative = fmaxf(_epsilon, x / 0.18f);
+  const float mapped = (log2f(x_relative) - black_relative_ev) / range_in_ev;
+  return CLIP(mapped);
+}
+
+/* LUT source: scene-linear channel -> curve output, linearised when no look */
+static float _agx_curve(const float x, const void *data)
+{
+  const tone_mapping_params_t *params = (const tone_mapping_params_t *)data;
+  const float log_value = _apply_log_encoding(x, params->range_in_ev, params->black_relative_ev);
+  const float y = _apply_curve(log_value, params);
+  return params->look_tuned ? y : powf(fmaxf(0.f, y), params->curve_gamma);
+}
+
+/* ── Curve parameters ───────────────────────────────────────────────────── */
+
+static inline float _calculate_slope_matching_power(const float slope,
+                                                    const float dx_transition_to_limit,
+                                                    const float dy_transition_to_limit)
+{
+  return slope * dx_transition_to_limit / dy_transition_to_limit;
+}
+
+static inline float _calculate_fallback_curve_coefficient(const float dx_transition_to_limit,
+                                                          const float dy_transition_to_limit,
+                                                          const float exponent)
+{
+  return dy_transition_to_limit / powf(dx_transition_to_limit, exponent);
+}
+
+static inline float _calculate_pivot_y_at_gamma(const dt_iop_agx_params_t *p, const float gamma)
+{
+  return powf(CLAMPF(p->curve_pivot_y_linear_output,
+                     p->curve_target_display_black_ratio,
+                     p->curve_target_display_white_ratio),
+              1.f / gamma);
+}
+
+static void _adjust_pivot(const dt_iop_agx_params_t *p, tone_mapping_params_t *tone_mapping_params)
+{
+  /* don't allow pivot_x to touch the endpoints */
+  tone_mapping_params->pivot_x = CLAMPF(p->curve_pivot_x, _epsilon, 1.f - _epsilon);
+
+  if(p->auto_gamma)
+  {
+    tone_mapping_params->curve_gamma =
+      tone_mapping_params->pivot_x > 0.f && p->curve_pivot_y_linear_output > 0.f
+      ? log2f(p->curve_pivot_y_linear_output) / log2f(tone_mapping_params->pivot_x)
+      : p->curve_gamma;
+  }
+  else
+  {
+    tone_mapping_params->curve_gamma = p->curve_gamma;
+  }
+
+  tone_mapping_params->pivot_y = _calculate_pivot_y_at_gamma(p, tone_mapping_params->curve_gamma);
+}
+
+/* Compensate contrast relative to gamma 2.2 to keep the slope of
+ * curve(x)^gamma at the pivot constant (chain rule). */
+static inline float _calculate_slope_gamma_compensation(const float gamma,
+                                                        const float pivot_y,
+                                                        const dt_iop_agx_params_t *p)
+{
+  const float pivot_y_at_default_gamma = _calculate_pivot_y_at_gamma(p, _default_gamma);
+  const float derivative_at_current_gamma = gamma * powf(fmaxf(_epsilon, pivot_y), gamma - 1.0f);
+  const float derivative_at_default_gamma =
+    _default_gamma * powf(fmaxf(_epsilon, pivot_y_at_default_gamma), _default_gamma - 1.0f);
+  return derivative_at_current_gamma / derivative_at_default_gamma;
+}
+
+static tone_mapping_params_t _calculate_tone_mapping_params(const dt_iop_agx_params_t *p)
+{
+  tone_mapping_params_t tmp;
+
+  /* look */
+  tmp.look_lift = p->look_lift;
+  tmp.look_slope = p->look_slope;
+  tmp.look_saturation = p->look_saturation;
+  const float brightness = p->look_brightness;
+  tmp.look_power = brightness < 1 ? 1.f / sqrtf(fmaxf(brightness, _epsilon)) : 1.f / brightness;
+  tmp.look_original_hue_mix_ratio = p->look_original_hue_mix_ratio;
+  tmp.look_tuned = p->look_slope != 1.f
+                   || p->look_brightness != 1.f
+                   || p->look_lift != 0.f
+                   || p->look_saturation != 1.f;
+  tmp.restore_hue = p->look_original_hue_mix_ratio != 0.f;
+
+  /* log mapping */
+  tmp.white_relative_ev = p->range_white_relative_ev;
+  tmp.black_relative_ev = p->range_black_relative_ev;
+  tmp.range_in_ev = tmp.white_relative_ev - tmp.black_relative_ev;
+
+  _adjust_pivot(p, &tmp);
+
+  /* 16.5 EV is the default AgX range; keep the meaning of slope */
+  const float range_adjusted_slope = p->curve_contrast_around_pivot * (tmp.range_in_ev / 16.5f);
+  const float compensation_factor = _calculate_slope_gamma_compensation(tmp.curve_gamma, tmp.pivot_y, p);
+  tmp.slope = range_adjusted_slope / compensation_factor;
+
+  /* toe */
+  tmp.target_black = powf(p->curve_target_display_black_ratio, 1.f / tmp.curve_gamma);
+  tmp.toe_power = fmaxf(0.01f, p->curve_toe_power);
+
+  const float remaining_y_below_pivot = tmp.pivot_y - tmp.target_black;
+  const float toe_length_y = remaining_y_below_pivot * p->curve_linear_ratio_below_pivot;
+  float dx_linear_below_pivot = toe_length_y / tmp.slope;
+  /* keep the transition point above x = 0 */
+  tmp.toe_transition_x = fmaxf(_epsilon, tmp.pivot_x - dx_linear_below_pivot);
+  dx_linear_below_pivot = tmp.pivot_x - tmp.toe_transition_x;
+
+  const float toe_dy_below_pivot = tmp.slope * dx_linear_below_pivot;
+  tmp.toe_transition_y = tmp.pivot_y - toe_dy_below_pivot;
+
+  /* same calculation as for the shoulder, with the toe flipped */
+  const float inverse_toe_limit_x = 1.f;
+  const float inverse_toe_limit_y = 1.f - tmp.target_black;
+  const float inverse_toe_transition_x = 1.f - tmp.toe_transition_x;
+  const float inverse_toe_transition_y = 1.f - tmp.toe_transition_y;
+  tmp.toe_scale = -_scale(inverse_toe_limit_x, inverse_toe_limit_y,
+                          inverse_toe_transition_x, inverse_toe_transition_y,
+                          tmp.slope, tmp.toe_power);
+
+  const float toe_length_x = tmp.toe_transition_x;
+  const float toe_dy_transition_to_limit = fmaxf(_epsilon, tmp.toe_transition_y - tmp.target_black);
+  const float toe_slope_transition_to_limit = toe_dy_transition_to_limit / toe_length_x;
+  tmp.need_convex_toe = toe_slope_transition_to_limit > tmp.slope;
+
+  tmp.toe_fallback_power = _calculate_slope_matching_power(tmp.slope, toe_length_x, toe_dy_transition_to_limit);
+  tmp.toe_fallback_coefficient = _calculate_fallback_curve_coefficient(toe_length_x, toe_dy_transition_to_limit,
+                                                                       tmp.toe_fallback_power);
+
+  tmp.intercept = tmp.toe_transition_y - (tmp.slope * tmp.toe_transition_x);
+
+  /* shoulder */
+  tmp.target_white = powf(p->curve_target_display_white_ratio, 1.f / tmp.curve_gamma);
+  const float remaining_y_above_pivot = tmp.target_white - tmp.pivot_y;
+  const float shoulder_length_y = remaining_y_above_pivot * p->curve_linear_ratio_above_pivot;
+  float dx_linear_above_pivot = shoulder_length_y / tmp.slope;
+
+  /* don't allow shoulder_transition_x to reach 1 */
+  tmp.shoulder_transition_x = fminf(1.f - _epsilon, tmp.pivot_x + dx_linear_above_pivot);
+  dx_linear_above_pivot = tmp.shoulder_transition_x - tmp.pivot_x;
+
+  const float shoulder_dy_above_pivot = tmp.slope * dx_linear_above_pivot;
+  tmp.shoulder_transition_y = tmp.pivot_y + shoulder_dy_above_pivot;
+  tmp.shoulder_power = fmaxf(0.01f, p->curve_shoulder_power);
+
+  tmp.shoulder_scale = _scale(1.f, tmp.target_white, tmp.shoulder_transition_x, tmp.shoulder_transition_y,
+                              tmp.slope, tmp.shoulder_power);
+
+  const float shoulder_length_x = 1.f - tmp.shoulder_transition_x;
+  const float shoulder_dy_transition_to_limit = fmaxf(_epsilon, tmp.target_white - tmp.shoulder_transition_y);
+  const float shoulder_slope_transition_to_limit = shoulder_dy_transition_to_limit / shoulder_length_x;
+  tmp.need_concave_shoulder = shoulder_slope_transition_to_limit > tmp.slope;
+
+  tmp.shoulder_fallback_power
+    = _calculate_slope_matching_power(tmp.slope, shoulder_length_x, shoulder_dy_transition_to_limit);
+  tmp.shoulder_fallback_coefficient
+    = _calculate_fallback_curve_coefficient(shoulder_length_x, shoulder_dy_transition_to_limit,
+                                            tmp.shoulder_fallback_power);
+
+  return tmp;
+}
+
+static primaries_params_t _get_primaries_params(const dt_iop_agx_params_t *p)
+{
+  primaries_params_t pp;
+
+  pp.base_primaries = p->base_primaries;
+
+  pp.inset[0] = p->red_inset;
+  pp.inset[1] = p->green_inset;
+  pp.inset[2] = p->blue_inset;
+  pp.rotation[0] = p->red_rotation;
+  pp.rotation[1] = p->green_rotation;
+  pp.rotation[2] = p->blue_rotation;
+  pp.master_outset_ratio = p->master_outset_ratio;
+  pp.master_unrotation_ratio = p->master_unrotation_ratio;
+
+  if(p->disable_primaries_adjustments)
+  {
+    for(int i = 0; i < 3; i++)
+      pp.inset[i] = pp.rotation[i] = pp.outset[i] = pp.unrotation[i] = 0.f;
+  }
+  else if(p->completely_reverse_primaries)
+  {
+    for(int i = 0; i < 3; i++)
+    {
+      pp.outset[i] = pp.inset[i];
+      pp.unrotation[i] = pp.rotation[i];
+    }
+    pp.master_outset_ratio = 1.f;
+    pp.master_unrotation_ratio = 1.f;
+  }
+  else
+  {
+    pp.outset[0] = p->red_outset;
+    pp.outset[1] = p->green_outset;
+    pp.outset[2] = p->blue_outset;
+    pp.unrotation[0] = p->red_unrotation;
+    pp.unrotation[1] = p->green_unrotation;
+    pp.unrotation[2] = p->blue_unrotation;
+  }
+
+  return pp;
+}
+
+/* ── Primaries ──────────────────────────────────────────────────────────── */
+
+static void _get_base_space(const dt_iop_agx_base_primaries_t base_primaries,
+                            const dt_colorspaces_rgb_space_t *const pipe_space,
+                            dt_colorspaces_rgb_space_t *base_space)
+{
+  switch(base_primaries)
+  {
+    case DT_AGX_WORK_PROFILE:
+      *base_space = *pipe_space;
+      return;
+    case DT_AGX_SRGB:
+      dt_colorspaces_get_rgb_space(DT_COLORSPACE_SRGB, base_space);
+      return;
+    case DT_AGX_DISPLAY_P3:
+      dt_colorspaces_get_rgb_space(DT_COLORSPACE_DISPLAY_P3, base_space);
+      return;
+    case DT_AGX_ADOBE_RGB:
+      dt_colorspaces_get_rgb_space(DT_COLORSPACE_ADOBERGB, base_space);
+      return;
+    case DT_AGX_EXPORT_PROFILE: /* no export profile in libdtpipe: Rec2020 fallback */
+    case DT_AGX_REC2020:
+    default:
+      dt_colorspaces_get_rgb_space(DT_COLORSPACE_LIN_REC2020, base_space);
+      return;
+  }
+}
+
+/*
+ * "Inset" the base RGB toward achromatic along spectral lines before the
+ * per-channel curve and rotate the primaries to compensate for Abney etc.
+ * (AgX by Troy Sobotka, https://github.com/sobotka/AgX-S2O3).  The outbound
+ * matrix can undo the rotation and restore purity.
+ */
+static void _create_matrices(dt_iop_agx_data_t *d,
+                             const dt_colorspaces_rgb_space_t *pipe_space,
+                             const dt_colorspaces_rgb_space_t *base_space)
+{
+  const primaries_params_t *params = &d->primaries_params;
+
+  dt_colormatrix_mul(d->pipe_to_base_transposed,
+                     pipe_space->matrix_in_transposed,   /* pipe->XYZ */
+                     base_space->matrix_out_transposed); /* XYZ->base */
+
+  dt_colormatrix_t base_to_pipe_transposed;
+  mat3SSEinv(base_to_pipe_transposed, d->pipe_to_base_transposed);
+
+  /* inbound path: base RGB -> inset and rotated rendering space */
+  float inset_and_rotated_primaries[3][2];
+  for(size_t i = 0; i < 3; i++)
+    dt_rotate_and_scale_primary(base_space, 1.f - params->inset[i], params->rotation[i], i,
+                                inset_and_rotated_primaries[i]);
+
+  dt_make_transposed_matrices_from_primaries_and_whitepoint(inset_and_rotated_primaries,
+                                                            base_space->whitepoint,
+                                                            d->rendering_to_xyz_transposed);
+  dt_colormatrix_mul(d->base_to_rendering_transposed, d->rendering_to_xyz_transposed,
+                     base_space->matrix_out_transposed);
+
+  /* outbound path: rendering space -> base RGB, optionally restoring purity */
+  float outset_and_unrotated_primaries[3][2];
+  for(size_t i = 0; i < 3; i++)
+  {
+    const float scaling = 1.f - params->master_outset_ratio * params->outset[i];
+    dt_rotate_and_scale_primary(base_space, scaling, params->master_unrotation_ratio * params->unrotation[i],
+                                i, outset_and_unrotated_primaries[i]);
+  }
+
+  dt_colormatrix_t outset_and_unrotated_to_xyz_transposed;
+  dt_make_transposed_matrices_from_primaries_and_whitepoint(outset_and_unrotated_primaries,
+                                                            base_space->whitepoint,
+                                                            outset_and_unrotated_to_xyz_transposed);
+
+  dt_colormatrix_t tmp;
+  dt_colormatrix_mul(tmp, outset_and_unrotated_to_xyz_transposed, base_space->matrix_out_transposed);
+
+  dt_colormatrix_t rendering_to_base_transposed;
+  mat3SSEinv(rendering_to_base_transposed, tmp);
+
+  dt_colormatrix_mul(d->rendering_to_pipe_transposed, rendering_to_base_transposed, base_to_pipe_transposed);
+}
+
+/* ── commit_params ──────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_agx_data_t *d = piece->data;
+  const dt_iop_agx_params_t *p = (const dt_iop_agx_params_t *)p1;
+
+  d->tone_mapping_params = _calculate_tone_mapping_params(p);
+  d->primaries_params = _get_primaries_params(p);
+
+  dt_colorspaces_rgb_space_t pipe_space, base_space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &pipe_space);
+  _get_base_space(d->primaries_params.base_primaries, &pipe_space, &base_space);
+  d->base_working_same_profile = d->primaries_params.base_primaries == DT_AGX_WORK_PROFILE;
+  _create_matrices(d, &pipe_space, &base_space);
+
+  /* the log encoding is constant outside 0.18 * 2^[black_ev, white_ev];
+   * one octave of margin on either side */
+  const tone_mapping_params_t *tmp = &d->tone_mapping_params;
+  const int lo_exp = (int)floorf(log2f(0.18f) + tmp->black_relative_ev) - 1;
+  const int hi_exp = (int)ceilf(log2f(0.18f) + tmp->white_relative_ev) + 1;
+  dt_curve_lut_init(&d->curve, lo_exp, hi_exp, _agx_curve, tmp);
+}
+
+/* ── Per-pixel kernel ───────────────────────────────────────────────────── */
+
+static inline float _lerp_hue(const float original_hue, const float processed_hue, const float mix)
+{
+  /* shortest signed difference in [-0.5, 0.5]; hue wraps around 1 -> 0 */
+  const float shortest_distance_on_hue_circle = remainderf(processed_hue - original_hue, 1.0f);
+  /* mix = 0 -> processed_hue; mix = 1 -> original_hue */
+  const float mixed_hue = DT_FMA(1.0f - mix, shortest_distance_on_hue_circle, original_hue);
+  return mixed_hue - floorf(mixed_hue);
+}
+
+static inline float _apply_slope_lift(const float x, const float slope, const float lift)
+{
+  /* https://www.desmos.com/calculator/8a26bc7eb8 */
+  const float m = slope / (1.f + lift);
+  const float b = lift * m;
+  return DT_FMA(m, x, b);
+}
+
+static inline void _agx_look(dt_aligned_pixel_t pixel_in_out,
+                             const tone_mapping_params_t *params,
+                             const dt_colormatrix_t rendering_to_xyz_transposed)
+{
+  for_three_channels(k, aligned(pixel_in_out : 16))
+  {
+    const float value_with_slope_and_lift
+      = _apply_slope_lift(pixel_in_out[k], params->look_slope, params->look_lift);
+    pixel_in_out[k] = value_with_slope_and_lift > 0.f
+                        ? powf(value_with_slope_and_lift, params->look_power)
+                        : value_with_slope_and_lift;
+  }
+
+  dt_aligned_pixel_t xyz = { 0.f };
+  dt_apply_transposed_color_matrix(pixel_in_out, rendering_to_xyz_transposed, xyz);
+  const float luma = xyz[1];
+
+  for_three_channels(k, aligned(pixel_in_out : 16))
+    pixel_in_out[k] = luma + params->look_saturation * (pixel_in_out[k] - luma);
+}
+
+static inline void _compress_into_gamut(dt_aligned_pixel_t pixel_in_out)
+{
+  /* Blender: https://github.com/EaryChow/AgX_LUT_Gen/blob/main/luminance_compenstation_bt2020.py */
+  const float luminance_coeffs[] = { 0.2658180370250449f, 0.59846986045365f, 0.1357121025213052f };
+
+  const float input_y = pixel_in_out[0] * luminance_coeffs[0]
+                      + pixel_in_out[1] * luminance_coeffs[1]
+                      + pixel_in_out[2] * luminance_coeffs[2];
+  const float max_rgb = max3f(pixel_in_out);
+
+  /* luminance of the opponent colour compensates negative luminance */
+  dt_aligned_pixel_t opponent_rgb = { 0.f };
+  for_each_channel(c, aligned(opponent_rgb, pixel_in_out))
+    opponent_rgb[c] = max_rgb - pixel_in_out[c];
+
+  const float opponent_y = opponent_rgb[0] * luminance_coeffs[0]
+                         + opponent_rgb[1] * luminance_coeffs[1]
+                         + opponent_rgb[2] * luminance_coeffs[2];
+  const float max_opponent = max3f(opponent_rgb);
+  const float y_compensate_negative = max_opponent - opponent_y + input_y;
+
+  /* offset the input tristimulus such that there are no negatives */
+  const float min_rgb = min3f(pixel_in_out);
+  const float offset = fmaxf(-min_rgb, 0.f);
+  dt_aligned_pixel_t rgb_offset = { 0.f };
+  for_each_channel(c, aligned(rgb_offset, pixel_in_out))
+    rgb_offset[c] = pixel_in_out[c] + offset;
+
+  const float max_of_rgb_offset = max3f(rgb_offset);
+  dt_aligned_pixel_t opponent_rgb_offset = { 0.f };
+  for_each_channel(c, aligned(opponent_rgb_offset, rgb_offset))
+    opponent_rgb_offset[c] = max_of_rgb_offset - rgb_offset[c];
+
+  const float max_inverse_rgb_offset = max3f(opponent_rgb_offset);
+  const float y_inverse_rgb_offset = opponent_rgb_offset[0] * luminance_coeffs[0]
+                                   + opponent_rgb_offset[1] * luminance_coeffs[1]
+                                   + opponent_rgb_offset[2] * luminance_coeffs[2];
+  float y_new = rgb_offset[0] * luminance_coeffs[0]
+              + rgb_offset[1] * luminance_coeffs[1]
+              + rgb_offset[2] * luminance_coeffs[2];
+  y_new = max_inverse_rgb_offset - y_inverse_rgb_offset + y_new;
+
+  /* match the original luminance; avoid div by 0 or tiny number */
+  const float luminance_ratio =
+    (y_new > y_compensate_negative && y_new > _epsilon) ? y_compensate_negative / y_new : 1.f;
+
+  for_each_channel(c, aligned(pixel_in_out, rgb_offset))
+    pixel_in_out[c] = luminance_ratio * rgb_offset[c];
+}
+
+static inline void _agx_tone_mapping(dt_aligned_pixel_t rgb_in_out, const dt_iop_agx_data_t *const d)
+{
+  const tone_mapping_params_t *params = &d->tone_mapping_params;
+
+  /* record current chromaticity angle */
+  dt_aligned_pixel_t hsv_pixel = { 0.f };
+  if(params->restore_hue)
+    dt_RGB_2_HSV(rgb_in_out, hsv_pixel);
+  const float h_before = hsv_pixel[0];
+
+  dt_aligned_pixel_t transformed_pixel = { 0.f };
+  dt_curve_lut_eval_rgb(&d->curve, rgb_in_out, transformed_pixel);
+
+  if(params->look_tuned)
+  {
+    _agx_look(transformed_pixel, params, d->rendering_to_xyz_transposed);
+    for_three_channels(k, aligned(transformed_pixel : 16))
+      transformed_pixel[k] = powf(fmaxf(0.f, transformed_pixel[k]), params->curve_gamma);
+  }
+
+  if(params->restore_hue)
+  {
+    dt_RGB_2_HSV(transformed_pixel, hsv_pixel);
+    hsv_pixel[0] = _lerp_hue(h_before, hsv_pixel[0], params->look_original_hue_mix_ratio);
+    dt_HSV_2_RGB(hsv_pixel, rgb_in_out);
+  }
+  else
+  {
+    copy_pixel(rgb_in_out, transformed_pixel);
+  }
+}
+
+/** Full AgX chain for one pixel: pipe RGB -> base -> rendering -> curve -> pipe. */
+static inline void _agx_pixel(const dt_iop_agx_data_t *const d,
+                              const float *const pix_in,
+                              dt_aligned_pixel_t pix_out)
+{
+  dt_aligned_pixel_t sanitised_in = { 0.f };
+  for_each_channel(c)
+  {
+    /* allow about 22.5 EV above mid-gray, getting rid of NaNs */
+    const float component = pix_in[c];
+    sanitised_in[c] = isnan(component) ? 0.f : CLAMPF(component, -1e6f, 1e6f);
+  }
+
+  dt_aligned_pixel_t base_rgb = { 0.f };
+  if(d->base_working_same_profile)
+    copy_pixel(base_rgb, sanitised_in);
+  else
+    dt_apply_transposed_color_matrix(sanitised_in, d->pipe_to_base_transposed, base_rgb);
+
+  _compress_into_gamut(base_rgb);
+
+  dt_aligned_pixel_t rendering_rgb = { 0.f };
+  dt_apply_transposed_color_matrix(base_rgb, d->base_to_rendering_transposed, rendering_rgb);
+
+  _agx_tone_mapping(rendering_rgb, d);
+
+  dt_apply_transposed_color_matrix(rendering_rgb, d->rendering_to_pipe_transposed, pix_out);
+  pix_out[3] = sanitised_in[3];
+}
+
+/* ── process ────────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_agx_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t n_pixels = (size_t)roi_in->width * roi_in->height;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * n_pixels; k += 4)
+  {
+    dt_aligned_pixel_t pix_out;
+    _agx_pixel(d, in + k, pix_out);
+    copy_pixel(out + k, pix_out);
+  }
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_agx_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+/* AgX primaries that give the same matrices as the Blender OCIO config:
+ * https://github.com/EaryChow/AgX_LUT_Gen/blob/main/AgXBaseRec2020.py */
+static void _set_blenderlike_primaries(dt_iop_agx_params_t *p)
+{
+  p->disable_primaries_adjustments = FALSE;
+  p->completely_reverse_primaries = FALSE;
+  p->base_primaries = DT_AGX_REC2020;
+
+  p->red_inset = 0.29462451f;
+  p->green_inset = 0.25861925f;
+  p->blue_inset = 0.14641371f;
+  p->red_rotation = 0.03540329f;
+  p->green_rotation = -0.02108586f;
+  p->blue_rotation = -0.06305724f;
+
+  p->master_outset_ratio = 1.f;
+  /* Blender doesn't reverse rotations */
+  p->master_unrotation_ratio = 0.f;
+
+  p->red_outset = 0.290776401758f;
+  p->green_outset = 0.263155400753f;
+  p->blue_outset = 0.045810721815f;
+  p->red_unrotation = p->red_rotation;
+  p->green_unrotation = p->green_rotation;
+  p->blue_unrotation = p->blue_rotation;
+}
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_agx_params_t *p = self->default_params;
+  if(!p) return;
+
+  memset(p, 0, sizeof(*p));
+
+  /* darktable's scene-referred defaults: shared params + Blender primaries */
+  p->look_slope = 1.f;
+  p->look_brightness = 1.f;
+  p->look_lift = 0.f;
+  p->look_saturation = 1.f;
+  p->look_original_hue_mix_ratio = 0.f;
+
+  p->range_black_relative_ev = -10.f;
+  p->range_white_relative_ev = 6.5f;
+  p->dynamic_range_scaling = 0.1f;
+
+  p->curve_contrast_around_pivot = 2.8f;
+  p->curve_linear_ratio_below_pivot = 0.f;
+  p->curve_linear_ratio_above_pivot = 0.f;
+  p->curve_toe_power = 1.55f;
+  p->curve_shoulder_power = 1.55f;
+  p->curve_target_display_black_ratio = 0.f;
+  p->curve_target_display_white_ratio = 1.f;
+  p->auto_gamma = FALSE;
+  p->curve_gamma = _default_gamma;
+  p->curve_pivot_x = -p->range_black_relative_ev / (p->range_white_relative_ev - p->range_black_relative_ev);
+  p->curve_pivot_y_linear_output = 0.18f;
+
+  _set_blenderlike_primaries(p);
+
+  memcpy(self->params, p, sizeof(*p));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_agx_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+}
@@ -0,0 +1,662 @@
+/*
+ * ashift.c - darktable rotate and perspective (ashift) IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/ashift.c
+ * Copyright (C) 2016-2024 darktable developers.
+ * GUI code, line detection (LSD), the automatic fit (RANSAC / Nelder-Mead),
+ * automatic cropping, OpenCL paths, distort_mask and legacy_params removed.
+ * The params keep the fitted values and the crop box the editor stored.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - the forward and inverted homographies are built once per input size
+ *     and kept in piece->data instead of on every call of every hook.
+ *   - process() does not carry its own per-pixel loop: it hands the piece
+ *     to dt_dev_pixelpipe_warp(), the pipe's resampler.  When flip or crop
+ *     sit next to ashift the pipe folds them into the same pass, so the
+ *     image is interpolated once for the whole geometric stage.
+ *   - pixel (i, j) is sampled at its centre (i + 0.5, j + 0.5) in full-size
+ *     coordinates, which keeps flips and crops in the same pass exact;
+ *     darktable samples at the pixel corner.  The difference is a sub-pixel
+ *     shift of the rotation centre.
+ *   - a neutral setting maps every pixel onto itself, so the pipe passes the
+ *     input buffer on without calling process().
+ *
+ * Struct layout MUST match _ashift_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in any colorspace (pure resampling).
+ */
+
+#include "dtpipe_internal.h"
+#include "common/colorspaces.h"
+#include "iop/iop_math.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_F_LENGTH 28.0f // focal length we assume if no exif data are available
+
+// maximum number of drawn lines that can be saved in parameters
+// any change in this value needs to upgrade parameters version !
+#define MAX_SAVED_LINES 50
+
+/* ── Parameter / data structs ────────────────────────────────────────────── */
+
+typedef enum dt_iop_ashift_homodir_t
+{
+  ASHIFT_HOMOGRAPH_FORWARD,
+  ASHIFT_HOMOGRAPH_INVERTED
+} dt_iop_ashift_homodir_t;
+
+typedef enum dt_iop_ashift_mode_t
+{
+  ASHIFT_MODE_GENERIC = 0,
+  ASHIFT_MODE_SPECIFIC = 1
+} dt_iop_ashift_mode_t;
+
+typedef enum dt_iop_ashift_crop_t
+{
+  ASHIFT_CROP_OFF = 0,
+  ASHIFT_CROP_LARGEST = 1,
+  ASHIFT_CROP_ASPECT = 2
+} dt_iop_ashift_crop_t;
+
+typedef struct dt_iop_ashift_params_t
+{
+  float rotation;    /* $MIN: -180 $MAX: 180 $DEFAULT: 0.0 */
+  float lensshift_v; /* $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0 */
+  float lensshift_h; /* $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0 */
+  float shear;       /* $MIN: -0.5 $MAX: 0.5 $DEFAULT: 0.0 */
+  float f_length;    /* $MIN: 1.0 $MAX: 2000.0 $DEFAULT: DEFAULT_F_LENGTH */
+  float crop_factor; /* $MIN: 0.5 $MAX: 10.0 $DEFAULT: 1.0 */
+  float orthocorr;   /* $MIN: 0.0 $MAX: 100.0 $DEFAULT: 100.0 */
+  float aspect;      /* $MIN: 0.5 $MAX: 2.0 $DEFAULT: 1.0 */
+  dt_iop_ashift_mode_t mode;     /* $DEFAULT: ASHIFT_MODE_GENERIC */
+  dt_iop_ashift_crop_t cropmode; /* $DEFAULT: ASHIFT_CROP_LARGEST */
+  float cl;          /* $DEFAULT: 0.0 $MIN: 0.0 $MAX: 1.0 */
+  float cr;          /* $DEFAULT: 1.0 $MIN: 0.0 $MAX: 1.0 */
+  float ct;          /* $DEFAULT: 0.0 $MIN: 0.0 $MAX: 1.0 */
+  float cb;          /* $DEFAULT: 1.0 $MIN: 0.0 $MAX: 1.0 */
+  float last_drawn_lines[MAX_SAVED_LINES * 4];
+  int last_drawn_lines_count;
+  float last_quad_lines[8];
+} dt_iop_ashift_params_t;
+
+typedef struct dt_iop_ashift_data_t
+{
+  float rotation;
+  float lensshift_v;
+  float lensshift_h;
+  float shear;
+  float f_length_kb;
+  float orthocorr;
+  float aspect;
+  float cl;
+  float cr;
+  float ct;
+  float cb;
+
+  // homographies for an input of hwidth x hheight, rebuilt by the ROI hooks
+  // when the size changes and only read by the point maps
+  int hwidth, hheight;
+  float homograph[3][3];
+  float ihomograph[3][3];
+} dt_iop_ashift_data_t;
+
+/* ── Homography ──────────────────────────────────────────────────────────── */
+
+#define MAT3SWAP(a, b) { float (*tmp)[3] = (a); (a) = (b); (b) = tmp; }
+
+static void _homography(float *homograph,
+                        const float angle,
+                        const float shift_v,
+                        const float shift_h,
+                        const float shear,
+                        const float f_length_kb,
+                        const float orthocorr,
+                        const float aspect,
+                        const int width,
+                        const int height,
+                        const dt_iop_ashift_homodir_t dir)
+{
+  // calculate homograph that combines all translations, rotations
+  // and warping into one single matrix operation.
+  // this is heavily leaning on ShiftN where the homographic matrix expects
+  // input in (y : x : 1) format. in the darktable world we want to keep the
+  // (x : y : 1) convention. therefore we need to flip coordinates first and
+  // make sure that output is in correct format after corrections are applied.
+
+  const float u = width;
+  const float v = height;
+
+  const float phi = deg2radf(angle);
+  const float cosi = cosf(phi);
+  const float sini = sinf(phi);
+  const float ascale = sqrtf(aspect);
+
+  // most of this comes from ShiftN
+  const float f_global = f_length_kb;
+  const float horifac = 1.0f - orthocorr / 100.0f;
+  const float exppa_v = expf(shift_v);
+  const float fdb_v = f_global / (14.4f + (v / u - 1) * 7.2f);
+  const float rad_v = fdb_v * (exppa_v - 1.0f) / (exppa_v + 1.0f);
+  const float alpha_v = CLAMP(atanf(rad_v), -1.5f, 1.5f);
+  const float rt_v = sinf(0.5f * alpha_v);
+  const float r_v = fmaxf(0.1f, 2.0f * (horifac - 1.0f) * rt_v * rt_v + 1.0f);
+
+  const float vertifac = 1.0f - orthocorr / 100.0f;
+  const float exppa_h = expf(shift_h);
+  const float fdb_h = f_global / (14.4f + (u / v - 1) * 7.2f);
+  const float rad_h = fdb_h * (exppa_h - 1.0f) / (exppa_h + 1.0f);
+  const float alpha_h = CLAMP(atanf(rad_h), -1.5f, 1.5f);
+  const float rt_h = sinf(0.5f * alpha_h);
+  const float r_h = fmaxf(0.1f, 2.0f * (vertifac - 1.0f) * rt_h * rt_h + 1.0f);
+
+  // three intermediate buffers for matrix calculation ...
+  float DT_ALIGNED_ARRAY m1[3][3];
+  float DT_ALIGNED_ARRAY m2[3][3];
+  float DT_ALIGNED_ARRAY m3[3][3];
+
+  // ... and some pointers to handle them more intuitively
+  float (*mwork)[3] = m1;
+  float (*minput)[3] = m2;
+  float (*moutput)[3] = m3;
+
+  // Step 1: flip x and y coordinates (see above)
+  memset(minput, 0, sizeof(float) * 9);
+  minput[0][1] = 1.0f;
+  minput[1][0] = 1.0f;
+  minput[2][2] = 1.0f;
+
+  // Step 2: rotation of image around its center
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = cosi;
+  mwork[0][1] = -sini;
+  mwork[1][0] = sini;
+  mwork[1][1] = cosi;
+  mwork[0][2] = -0.5f * v * cosi + 0.5f * u * sini + 0.5f * v;
+  mwork[1][2] = -0.5f * v * sini - 0.5f * u * cosi + 0.5f * u;
+  mwork[2][2] = 1.0f;
+
+  // multiply mwork * minput -> moutput
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 3: apply shearing
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = 1.0f;
+  mwork[0][1] = shear;
+  mwork[1][1] = 1.0f;
+  mwork[1][0] = shear;
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 4: apply vertical lens shift effect
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = exppa_v;
+  mwork[1][0] = 0.5f * ((exppa_v - 1.0f) * u) / v;
+  mwork[1][1] = 2.0f * exppa_v / (exppa_v + 1.0f);
+  mwork[1][2] = -0.5f * ((exppa_v - 1.0f) * u) / (exppa_v + 1.0f);
+  mwork[2][0] = (exppa_v - 1.0f) / v;
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 5: horizontal compression
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = 1.0f;
+  mwork[1][1] = r_v;
+  mwork[1][2] = 0.5f * u * (1.0f - r_v);
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 6: flip x and y back again
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][1] = 1.0f;
+  mwork[1][0] = 1.0f;
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // from here output vectors would be in (x : y : 1) format
+
+  // Step 7: now we can apply horizontal lens shift with the same matrix format as above
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = exppa_h;
+  mwork[1][0] = 0.5f * ((exppa_h - 1.0f) * v) / u;
+  mwork[1][1] = 2.0f * exppa_h / (exppa_h + 1.0f);
+  mwork[1][2] = -0.5f * ((exppa_h - 1.0f) * v) / (exppa_h + 1.0f);
+  mwork[2][0] = (exppa_h - 1.0f) / u;
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 8: vertical compression
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = 1.0f;
+  mwork[1][1] = r_h;
+  mwork[1][2] = 0.5f * v * (1.0f - r_h);
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 9: apply aspect ratio scaling
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = 1.0f * ascale;
+  mwork[1][1] = 1.0f / ascale;
+  mwork[2][2] = 1.0f;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // Step 10: find x/y offsets and apply according correction so that
+  // no negative coordinates occur in output vector
+  float umin = FLT_MAX, vmin = FLT_MAX;
+  // visit all four corners
+  for(int y = 0; y < height; y += height - 1)
+    for(int x = 0; x < width; x += width - 1)
+    {
+      float pi[3], po[3];
+      pi[0] = x;
+      pi[1] = y;
+      pi[2] = 1.0f;
+      // moutput expects input in (x:y:1) format and gives output as (x:y:1)
+      mat3mulv(po, (float *)moutput, pi);
+      umin = MIN(umin, po[0] / po[2]);
+      vmin = MIN(vmin, po[1] / po[2]);
+    }
+
+  memset(mwork, 0, sizeof(float) * 9);
+  mwork[0][0] = 1.0f;
+  mwork[1][1] = 1.0f;
+  mwork[2][2] = 1.0f;
+  mwork[0][2] = -umin;
+  mwork[1][2] = -vmin;
+
+  MAT3SWAP(minput, moutput);
+  mat3mul((float *)moutput, (float *)mwork, (float *)minput);
+
+  // on request we either keep the final matrix for forward conversions
+  // or produce an inverted matrix for backward conversions
+  if(dir == ASHIFT_HOMOGRAPH_FORWARD)
+  {
+    memcpy(homograph, moutput, sizeof(float) * 9);
+    return;
+  }
+
+  dt_colormatrix_t M, Mi;
+  for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+      M[r][c] = moutput[r][c];
+  if(mat3SSEinv(Mi, M))
+  {
+    // in case of error we set to unity matrix
+    memset(homograph, 0, sizeof(float) * 9);
+    homograph[0] = homograph[4] = homograph[8] = 1.0f;
+    return;
+  }
+  for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+      homograph[3 * r + c] = Mi[r][c];
+}
+#undef MAT3SWAP
+
+// check if module parameters are set to all neutral values in which case the module's
+// output is identical to its input
+static inline bool _isneutral(const dt_iop_ashift_data_t *data)
+{
+  // values lower than this have no visible effect
+  const float eps = 1.0e-4f;
+
+  return (feqf(data->rotation, 0.0f, eps)
+          && feqf(data->lensshift_v, 0.0f, eps)
+          && feqf(data->lensshift_h, 0.0f, eps)
+          && feqf(data->shear, 0.0f, eps)
+          && feqf(data->aspect, 1.0f, eps)
+          && feqf(data->cl, 0.0f, eps)
+          && feqf(data->cr, 1.0f, eps)
+          && feqf(data->ct, 0.0f, eps)
+          && feqf(data->cb, 1.0f, eps));
+}
+
+// (re)build both homographies for the current input size.  Called from the
+// ROI hooks only, which the pipe runs single-threaded before process().
+static void _update_homography(dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_ashift_data_t *d = piece->data;
+  if(d->hwidth == piece->buf_in.width && d->hheight == piece->buf_in.height)
+    return;
+
+  _homography((float *)d->homograph, d->rotation, d->lensshift_v, d->lensshift_h,
+              d->shear, d->f_length_kb, d->orthocorr, d->aspect,
+              piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_FORWARD);
+  _homography((float *)d->ihomograph, d->rotation, d->lensshift_v, d->lensshift_h,
+              d->shear, d->f_length_kb, d->orthocorr, d->aspect,
+              piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_INVERTED);
+  d->hwidth = piece->buf_in.width;
+  d->hheight = piece->buf_in.height;
+}
+
+// clipping offset of the crop box in full-size output coordinates
+static inline void _clip_offset(const dt_dev_pixelpipe_iop_t *piece, float *cx, float *cy)
+{
+  const dt_iop_ashift_data_t *d = piece->data;
+  const float fullwidth = (float)piece->buf_out.width / (d->cr - d->cl);
+  const float fullheight = (float)piece->buf_out.height / (d->cb - d->ct);
+  *cx = fullwidth * d->cl;
+  *cy = fullheight * d->ct;
+}
+
+/* ── Point maps ──────────────────────────────────────────────────────────── */
+
+static bool distort_transform(dt_iop_module_t *self,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              float *const points,
+                              const size_t points_count)
+{
+  const dt_iop_ashift_data_t *d = piece->data;
+
+  // nothing to be done if parameters are set to neutral values
+  if(_isneutral(d)) return true;
+
+  float DT_ALIGNED_ARRAY H[3][3];
+  if(d->hwidth == piece->buf_in.width && d->hheight == piece->buf_in.height)
+    memcpy(H, d->homograph, sizeof(H));
+  else
+    _homography((float *)H, d->rotation, d->lensshift_v, d->lensshift_h,
+                d->shear, d->f_length_kb, d->orthocorr, d->aspect,
+                piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_FORWARD);
+
+  float cx, cy;
+  _clip_offset(piece, &cx, &cy);
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    const float x = points[i];
+    const float y = points[i + 1];
+    const float w = H[2][0] * x + H[2][1] * y + H[2][2];
+    points[i]     = (H[0][0] * x + H[0][1] * y + H[0][2]) / w - cx;
+    points[i + 1] = (H[1][0] * x + H[1][1] * y + H[1][2]) / w - cy;
+  }
+  return true;
+}
+
+static bool distort_backtransform(dt_iop_module_t *self,
+                                  dt_dev_pixelpipe_iop_t *piece,
+                                  float *const points,
+                                  const size_t points_count)
+{
+  const dt_iop_ashift_data_t *d = piece->data;
+
+  if(_isneutral(d)) return true;
+
+  float DT_ALIGNED_ARRAY Hi[3][3];
+  if(d->hwidth == piece->buf_in.width && d->hheight == piece->buf_in.height)
+    memcpy(Hi, d->ihomograph, sizeof(Hi));
+  else
+    _homography((float *)Hi, d->rotation, d->lensshift_v, d->lensshift_h,
+                d->shear, d->f_length_kb, d->orthocorr, d->aspect,
+                piece->buf_in.width, piece->buf_in.height, ASHIFT_HOMOGRAPH_INVERTED);
+
+  float cx, cy;
+  _clip_offset(piece, &cx, &cy);
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    const float x = points[i] + cx;
+    const float y = points[i + 1] + cy;
+    const float w = Hi[2][0] * x + Hi[2][1] * y + Hi[2][2];
+    points[i]     = (Hi[0][0] * x + Hi[0][1] * y + Hi[0][2]) / w;
+    points[i + 1] = (Hi[1][0] * x + Hi[1][1] * y + Hi[1][2]) / w;
+  }
+  return true;
+}
+
+/* ── modify_roi_out() / modify_roi_in() ──────────────────────────────────── */
+
+static void modify_roi_out(dt_iop_module_t *self,
+                           dt_dev_pixelpipe_iop_t *piece,
+                           dt_iop_roi_t *roi_out,
+                           const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_ashift_data_t *d = piece->data;
+  *roi_out = *roi_in;
+
+  // nothing more to be done if parameters are set to neutral values
+  if(_isneutral(d)) return;
+
+  _update_homography(piece);
+
+  float xm = FLT_MAX, xM = -FLT_MAX, ym = FLT_MAX, yM = -FLT_MAX;
+
+  // go through all four vertices of input roi and convert coordinates to output
+  for(int y = 0; y < roi_in->height; y += roi_in->height - 1)
+  {
+    for(int x = 0; x < roi_in->width; x += roi_in->width - 1)
+    {
+      float DT_ALIGNED_PIXEL pin[3], DT_ALIGNED_PIXEL pout[3];
+
+      // convert from input coordinates to original image coordinates
+      pin[0] = (roi_in->x + x) / roi_in->scale;
+      pin[1] = (roi_in->y + y) / roi_in->scale;
+      pin[2] = 1.0f;
+
+      // apply homograph
+      mat3mulv(pout, (float *)d->homograph, pin);
+
+      // convert to output image coordinates
+      pout[0] = pout[0] / pout[2] * roi_out->scale;
+      pout[1] = pout[1] / pout[2] * roi_out->scale;
+      xm = MIN(xm, pout[0]);
+      xM = MAX(xM, pout[0]);
+      ym = MIN(ym, pout[1]);
+      yM = MAX(yM, pout[1]);
+    }
+  }
+
+  const float width = (xM - xm + 1.0f) * (d->cr - d->cl);
+  const float height = (yM - ym + 1.0f) * (d->cb - d->ct);
+
+  roi_out->width = floorf(width);
+  roi_out->height = floorf(height);
+
+  if(roi_out->width < 4 || roi_out->height < 4)
+  {
+    fprintf(stderr, "[ashift] module has insane data so it is bypassed for now\n");
+    roi_out->width = roi_in->width;
+    roi_out->height = roi_in->height;
+    piece->enabled = FALSE;
+  }
+}
+
+static void modify_roi_in(dt_iop_module_t *self,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_roi_t *roi_in)
+{
+  dt_iop_ashift_data_t *d = piece->data;
+  *roi_in = *roi_out;
+
+  // nothing more to be done if parameters are set to neutral values
+  if(_isneutral(d)) return;
+
+  _update_homography(piece);
+
+  const float orig_w = roi_in->scale * piece->buf_in.width;
+  const float orig_h = roi_in->scale * piece->buf_in.height;
+
+  // the four output corners, at their pixel centres as the pipe samples them
+  float pts[8];
+  for(int c = 0; c < 4; c++)
+  {
+    pts[2 * c]     = (roi_out->x + ((c & 1) ? roi_out->width - 1 : 0) + 0.5f) / roi_out->scale;
+    pts[2 * c + 1] = (roi_out->y + ((c & 2) ? roi_out->height - 1 : 0) + 0.5f) / roi_out->scale;
+  }
+  distort_backtransform(self, piece, pts, 4);
+
+  float xm = FLT_MAX, xM = -FLT_MAX, ym = FLT_MAX, yM = -FLT_MAX;
+  for(int c = 0; c < 4; c++)
+  {
+    const float x = pts[2 * c] * roi_in->scale - 0.5f;
+    const float y = pts[2 * c + 1] * roi_in->scale - 0.5f;
+    xm = MIN(xm, x);
+    xM = MAX(xM, x);
+    ym = MIN(ym, y);
+    yM = MAX(yM, y);
+  }
+
+  const dt_interpolation_t *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+
+  const float iw1 = interpolation->width;
+  const float iw2 = 2.0f * iw1;
+  roi_in->x       = xm - iw1;
+  roi_in->y       = ym - iw1;
+  roi_in->width   = xM + iw2 - xm + 1.0f;
+  roi_in->height  = yM + iw2 - ym + 1.0f;
+
+  // sanity check.
+  roi_in->x       = CLAMP(roi_in->x, 0, (int)floorf(orig_w));
+  roi_in->y       = CLAMP(roi_in->y, 0, (int)floorf(orig_h));
+  roi_in->width   = CLAMP(roi_in->width, 4, (int)floorf(orig_w) - roi_in->x);
+  roi_in->height  = CLAMP(roi_in->height, 4, (int)floorf(orig_h) - roi_in->y);
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_ashift_data_t *d = piece->data;
+
+  // if module is set to neutral parameters we just copy input->output and are done
+  if(_isneutral(d) || piece->colors != 4)
+  {
+    dt_iop_copy_image_roi((float *)ovoid, (const float *)ivoid, piece->colors,
+                          roi_in, roi_out);
+    return;
+  }
+
+  dt_dev_pixelpipe_warp(&piece, 1, (const float *)ivoid, (float *)ovoid, roi_in, roi_out);
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_ashift_params_t *p = (const dt_iop_ashift_params_t *)p1;
+  dt_iop_ashift_data_t *d = piece->data;
+
+  d->rotation = p->rotation;
+  d->lensshift_v = p->lensshift_v;
+  d->lensshift_h = p->lensshift_h;
+  d->shear = p->shear;
+  d->f_length_kb = (p->mode == ASHIFT_MODE_GENERIC)
+    ? DEFAULT_F_LENGTH
+    : p->f_length * p->crop_factor;
+
+  d->orthocorr = (p->mode == ASHIFT_MODE_GENERIC) ? 0.0f : p->orthocorr;
+  d->aspect = (p->mode == ASHIFT_MODE_GENERIC) ? 1.0f : p->aspect;
+
+  if(dt_isnan(p->cl) || dt_isnan(p->cr) || dt_isnan(p->ct) || dt_isnan(p->cb)
+     || p->cr - p->cl <= 0.0f || p->cb - p->ct <= 0.0f)
+  {
+    d->cl = 0.0f;
+    d->cr = 1.0f;
+    d->ct = 0.0f;
+    d->cb = 1.0f;
+  }
+  else
+  {
+    d->cl = p->cl;
+    d->cr = p->cr;
+    d->ct = p->ct;
+    d->cb = p->cb;
+  }
+
+  // the homographies depend on the params: rebuild on the next ROI call
+  d->hwidth = d->hheight = 0;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_ashift_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params (darktable reload_defaults) ─────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_ashift_params_t *d = self->default_params;
+  if(!d) return;
+  memset(d, 0, sizeof(*d));
+  d->f_length    = DEFAULT_F_LENGTH;
+  d->crop_factor = 1.0f;
+  d->orthocorr   = 100.0f;
+  d->aspect      = 1.0f;
+  d->mode        = ASHIFT_MODE_GENERIC;
+  d->cropmode    = ASHIFT_CROP_LARGEST;
+  d->cr          = 1.0f;
+  d->cb          = 1.0f;
+
+  if(self->dev)
+  {
+    const dt_image_t *img = &((dt_develop_t *)self->dev)->image_storage;
+    if(isfinite(img->exif_focal_length) && img->exif_focal_length > 0.0f)
+      d->f_length = img->exif_focal_length;
+    if(isfinite(img->exif_crop) && img->exif_crop > 0.0f)
+      d->crop_factor = img->exif_crop;
+  }
+
+  memcpy(self->params, d, sizeof(*d));
+}
+
+static int operation_tags(void)
+{
+  return IOP_TAG_DISTORT;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_ashift_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain          = process;
+  so->init                   = init;
+  so->init_pipe              = init_pipe;
+  so->cleanup_pipe           = cleanup_pipe;
+  so->commit_params          = commit_params;
+  so->operation_tags         = operation_tags;
+  so->modify_roi_in          = modify_roi_in;
+  so->modify_roi_out         = modify_roi_out;
+  so->distort_transform      = distort_transform;
+  so->distort_backtransform  = distort_backtransform;
+}
@@ -0,0 +1,230 @@
+/*
+ * bilat.c - darktable local contrast IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/bilat.c
+ * Copyright (C) 2012-2024 darktable developers.
+ * GUI code, OpenCL paths, presets and legacy_params removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - both backends live in common/: the bilateral grid in bilateral.c,
+ *     the local laplacian filter in locallaplacian.c (built tile by tile,
+ *     see locallaplacian.h)
+ *   - the bilateral grid is scale-aware: its cells are sized against the
+ *     full image and carried over to the roi with roi_out->scale, so a
+ *     downscaled, cropped or tiled render filters with the same grid (in
+ *     image space) as a full-size export.  darktable clamps the grid
+ *     against the roi, which gives crops and tiles a finer grid than the
+ *     export once the 3000-cell limit is reached.
+ *
+ * Struct layout MUST match _bilat_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in IOP_CS_LAB.
+ */
+
+#include "dtpipe_internal.h"
+#include "common/bilateral.h"
+#include "common/locallaplacian.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter structs (must match params.c descriptor layout) ───────────── */
+
+typedef enum dt_iop_bilat_mode_t
+{
+  s_mode_bilateral = 0,       // $DESCRIPTION: "bilateral grid"
+  s_mode_local_laplacian = 1, // $DESCRIPTION: "local laplacian filter"
+}
+dt_iop_bilat_mode_t;
+
+typedef struct dt_iop_bilat_params_t
+{
+  dt_iop_bilat_mode_t mode; // $DEFAULT: 1
+  float sigma_r; // $MIN: 0.0 $MAX: 100.0 $DEFAULT: 0.5 highlights 100 & range
+  float sigma_s; // $MIN: 0.0 $MAX: 100.0 $DEFAULT: 0.5 shadows 100 & spatial 1 100 50
+  float detail;  // $MIN: -1.0 $MAX: 4.0 $DEFAULT: 0.25
+  float midtone; // $MIN: 0.001 $MAX: 1.0 $DEFAULT: 0.5 $DESCRIPTION: "midtone range"
+} dt_iop_bilat_params_t;
+
+typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+
+/* ── Bilateral grid geometry ─────────────────────────────────────────────── */
+
+// spatial sigma of the bilateral grid for this roi.  sigma_s is in
+// full-image pixels; roi_out->scale / iscale is roi pixels per full-image
+// pixel.
+static float _grid_sigma_s(const dt_iop_bilat_data_t *const d,
+                           const dt_dev_pixelpipe_iop_t *const piece,
+                           const dt_iop_roi_t *const roi_in,
+                           const dt_iop_roi_t *const roi_out)
+{
+  const float scale = roi_out->scale / piece->iscale;
+  // the piece's full input, in full-image pixels.  Pipes that never ran
+  // dt_dev_pixelpipe_get_dimensions() fall back to the roi itself.
+  const int full_width = piece->buf_in.width > 0
+    ? (int)(piece->buf_in.width * piece->iscale) : (int)(roi_in->width / fminf(scale, 1.0f));
+  const int full_height = piece->buf_in.height > 0
+    ? (int)(piece->buf_in.height * piece->iscale) : (int)(roi_in->height / fminf(scale, 1.0f));
+  return dt_bilateral_scaled_sigma_s(full_width, full_height, d->sigma_s, scale);
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid, void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4 /*full-color pixels*/, self,
+                                         piece->colors, ivoid, ovoid,
+                                         roi_in, roi_out))
+    return;
+
+  const dt_iop_bilat_data_t *d = piece->data;
+
+  if(d->mode == s_mode_bilateral)
+  {
+    const float sigma_r = d->sigma_r; // does not depend on scale
+    const float sigma_s = _grid_sigma_s(d, piece, roi_in, roi_out);
+
+    dt_bilateral_t *b = dt_bilateral_init(roi_in->width, roi_in->height, sigma_s, sigma_r);
+    if(b)
+    {
+      dt_bilateral_splat(b, (const float *)ivoid);
+      dt_bilateral_blur(b);
+      dt_bilateral_slice(b, (const float *)ivoid, (float *)ovoid, d->detail);
+      dt_bilateral_free(b);
+    }
+    else
+    {
+      // dt_bilateral_init will have spit out an error message.  Now just copy the input to output
+      dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, piece->colors);
+    }
+  }
+  else // s_mode_local_laplacian
+  {
+    local_laplacian(ivoid, ovoid, roi_in->width, roi_in->height,
+                    d->midtone, d->sigma_s, d->sigma_r, d->detail);
+  }
+}
+
+/* ── tiling_callback() ───────────────────────────────────────────────────── */
+
+static void tiling_callback(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const dt_iop_roi_t *roi_in,
+                            const dt_iop_roi_t *roi_out,
+                            dt_develop_tiling_t *tiling)
+{
+  const dt_iop_bilat_data_t *d = piece->data;
+
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const int channels = piece->colors;
+  const size_t basebuffer = sizeof(float) * channels * width * height;
+
+  if(d->mode == s_mode_bilateral)
+  {
+    const float sigma_r = d->sigma_r;
+    const float sigma_s = _grid_sigma_s(d, piece, roi_in, roi_out);
+
+    tiling->factor = 2.0f + (float)dt_bilateral_memory_use(width, height, sigma_s, sigma_r) / basebuffer;
+    tiling->maxbuf
+        = fmax(1.0f, (float)dt_bilateral_singlebuffer_size(width, height, sigma_s, sigma_r) / basebuffer);
+    tiling->overhead = 0;
+    tiling->overlap = ceilf(4 * sigma_s);
+    tiling->xalign = 1;
+    tiling->yalign = 1;
+  }
+  else  // mode == s_mode_local_laplacian
+  {
+    const int rad = MIN(roi_in->width, ceilf(256 * roi_in->scale / piece->iscale));
+
+    tiling->factor = 2.0f + (float)local_laplacian_memory_use(width, height) / basebuffer;
+    tiling->maxbuf
+        = fmax(1.0f, (float)local_laplacian_singlebuffer_size(width, height) / basebuffer);
+    tiling->overhead = 0;
+    tiling->overlap = rad;
+    tiling->xalign = 1;
+    tiling->yalign = 1;
+  }
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_bilat_params_t *p = (const dt_iop_bilat_params_t *)p1;
+  dt_iop_bilat_data_t *d = piece->data;
+  *d = *p;
+
+  // the pyramid needs the whole roi for its coarse levels, and bounds its
+  // own memory by tiling internally
+  if(d->mode == s_mode_local_laplacian)
+    piece->process_tiling_ready = FALSE;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_bilat_data_t));
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_bilat_params_t *d = self->default_params;
+  if(!d) return;
+  d->mode    = s_mode_local_laplacian;
+  d->sigma_r = 0.5f;
+  d->sigma_s = 0.5f;
+  d->detail  = 0.25f;
+  d->midtone = 0.5f;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_LAB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_LAB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_bilat_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->tiling_callback    = tiling_callback;
+}
@@ -0,0 +1,1235 @@
+/*
+ * cacorrect.c - darktable raw chromatic aberration IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/cacorrect.c
+ * Copyright (C) 2010-2024 darktable developers.
+ * Chromatic aberration correction on raw Bayer data:
+ *   copyright (c) 2008-2010 Emil Martinec <ejmartin@uchicago.edu>
+ *   copyright (c) 2018 Ingo Weyrich <heckflosse67@gmx.de> (speedups,
+ *   iterated correction and avoid colour shift)
+ * GUI code, OpenCL paths, distort_mask and legacy_params removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - the tile loop is split in three passes per iteration: green
+ *     interpolation at R/B sites (all tiles), the CA diagnosis that feeds
+ *     the polynomial fit, and the correction (all tiles).  darktable runs
+ *     the diagnosis on every tile of every run.
+ *   - on large images the diagnosis runs on every second tile in both
+ *     directions (a quarter of the tiles); the 3x3 median and the fit work
+ *     on that lattice with the real block coordinates, so the fitted
+ *     surface is the same polynomial over the same image positions.
+ *   - the fitted coefficients of each iteration are cached in the piece
+ *     data, keyed by the upstream pipe hash (dt_dev_pixelpipe_piece_hash())
+ *     and the buffer size: they only depend on the raw data reaching the
+ *     module.  Re-rendering, or changing avoidshift or anything downstream,
+ *     skips the diagnosis; raising the iteration count only fits the new
+ *     iterations.
+ *   - the diagnosis reads green at R/B sites from the green pass instead of
+ *     interpolating it again inside the tile.  This only differs in the
+ *     mirrored border of tiles on the image edge.
+ *
+ * Struct layout MUST match _cacorrect_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in IOP_CS_RAW, Bayer only.
+ */
+
+// fast-math changes results enough to fail the integration test, and isn't even any faster...
+#ifdef __GNUC__
+#pragma GCC optimize ("no-fast-math")
+#endif
+
+#include "dtpipe_internal.h"
+#include "common/gaussian.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter / data structs ────────────────────────────────────────────── */
+
+typedef enum dt_iop_cacorrect_multi_t
+{
+  CACORRETC_MULTI_1 = 1,     // $DESCRIPTION: "once"
+  CACORRETC_MULTI_2 = 2,     // $DESCRIPTION: "twice"
+  CACORRETC_MULTI_3 = 3,     // $DESCRIPTION: "three times"
+  CACORRETC_MULTI_4 = 4,     // $DESCRIPTION: "four times"
+  CACORRETC_MULTI_5 = 5,     // $DESCRIPTION: "five times"
+} dt_iop_cacorrect_multi_t;
+
+typedef struct dt_iop_cacorrect_params_t
+{
+  gboolean avoidshift;                 // $DEFAULT: 0 $DESCRIPTION: "avoid colorshift"
+  dt_iop_cacorrect_multi_t iterations; // $DEFAULT: CACORRETC_MULTI_2 $DESCRIPTION: "iterations"
+} dt_iop_cacorrect_params_t;
+
+#define CA_MAX_ITERATIONS 5
+
+/* polynomial fit of the block shifts of one iteration */
+typedef struct _ca_fit_t
+{
+  double params[2][2][16]; // [colour][dir][polyord * i + j]
+  int polyord;
+  gboolean valid;          // FALSE: the fit failed, the iteration is skipped
+} _ca_fit_t;
+
+typedef struct dt_iop_cacorrect_data_t
+{
+  gboolean avoidshift;
+  uint32_t iterations;
+
+  /* fit cache: survives commit_params, invalidated by hash */
+  dt_hash_t fit_hash;
+  int fit_count;           // iterations with a fit in fit[]
+  _ca_fit_t fit[CA_MAX_ITERATIONS];
+} dt_iop_cacorrect_data_t;
+
+/*==================================================================================
+ * begin raw therapee code, hg initial checkout of march 09, 2016 branch master.
+ * avoid colorshift code has been added later
+ *==================================================================================*/
+
+#define caautostrength 4.0f
+#define ts 128    // multiple of 16 for aligned buffers
+#define tsh (ts / 2)
+#define v1 (ts)
+#define v2 (2 * ts)
+#define v3 (3 * ts)
+#define v4 (4 * ts)
+#define border 8
+#define border2 (2 * border)
+#define borderh (border / 2)
+
+/* diagnose every second tile once this many of them remain */
+#define CA_FIT_MIN_SAMPLES 128
+
+static const float eps = 1e-5f;
+static const float eps2 = 1e-10f; // tolerance to avoid dividing by zero
+
+//%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+static gboolean _LinEqSolve(ssize_t nDim, double *pfMatr, double *pfVect, double *pfSolution)
+{
+  //==============================================================================
+  // return 1 if system not solving, 0 if system solved
+  // nDim - system dimension
+  // pfMatr - matrix with coefficients
+  // pfVect - vector with free members
+  // pfSolution - vector with system solution
+  // pfMatr becomes triangular after function call
+  // pfVect changes after function call
+  //
+  // Developer: Henry Guennadi Levkin
+  //
+  //==============================================================================
+
+  double fMaxElem;
+  double fAcc;
+
+  ssize_t i, j, k, m;
+
+  for(k = 0; k < (nDim - 1); k++)
+  { // base row of matrix
+    // search of line with max element
+    fMaxElem = fabs(pfMatr[k * nDim + k]);
+    m = k;
+
+    for(i = k + 1; i < nDim; i++)
+    {
+      if(fMaxElem < fabs(pfMatr[i * nDim + k]))
+      {
+        fMaxElem = pfMatr[i * nDim + k];
+        m = i;
+      }
+    }
+
+    // permutation of base line (index k) and max element line(index m)
+    if(m != k)
+    {
+      for(i = k; i < nDim; i++)
+      {
+        fAcc = pfMatr[k * nDim + i];
+        pfMatr[k * nDim + i] = pfMatr[m * nDim + i];
+        pfMatr[m * nDim + i] = fAcc;
+      }
+
+      fAcc = pfVect[k];
+      pfVect[k] = pfVect[m];
+      pfVect[m] = fAcc;
+    }
+
+    if(pfMatr[k * nDim + k] == 0.)
+    {
+      // linear system has no solution
+      return FALSE; // needs improvement !!!
+    }
+
+    // triangulation of matrix with coefficients
+    for(j = (k + 1); j < nDim; j++)
+    { // current row of matrix
+      fAcc = -pfMatr[j * nDim + k] / pfMatr[k * nDim + k];
+
+      for(i = k; i < nDim; i++)
+      {
+        pfMatr[j * nDim + i] = pfMatr[j * nDim + i] + fAcc * pfMatr[k * nDim + i];
+      }
+
+      pfVect[j] = pfVect[j] + fAcc * pfVect[k]; // free member recalculation
+    }
+  }
+
+  for(k = (nDim - 1); k >= 0; k--)
+  {
+    pfSolution[k] = pfVect[k];
+
+    for(i = (k + 1); i < nDim; i++)
+    {
+      pfSolution[k] -= (pfMatr[k * nDim + i] * pfSolution[i]);
+    }
+
+    pfSolution[k] = pfSolution[k] / pfMatr[k * nDim + k];
+  }
+
+  return TRUE;
+}
+// end of linear equation solver
+//%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
+
+static inline void _sort2f(float *a, float *b)
+{
+  const float lo = fminf(*a, *b);
+  *b = fmaxf(*a, *b);
+  *a = lo;
+}
+
+// median of 9 by the usual 19 compare-exchange network
+static float _median9f(float p[9])
+{
+  _sort2f(&p[1], &p[2]); _sort2f(&p[4], &p[5]); _sort2f(&p[7], &p[8]);
+  _sort2f(&p[0], &p[1]); _sort2f(&p[3], &p[4]); _sort2f(&p[6], &p[7]);
+  _sort2f(&p[1], &p[2]); _sort2f(&p[4], &p[5]); _sort2f(&p[7], &p[8]);
+  _sort2f(&p[0], &p[3]); _sort2f(&p[5], &p[8]); _sort2f(&p[4], &p[7]);
+  _sort2f(&p[3], &p[6]); _sort2f(&p[1], &p[4]); _sort2f(&p[2], &p[5]);
+  _sort2f(&p[4], &p[7]); _sort2f(&p[4], &p[2]); _sort2f(&p[6], &p[4]);
+  _sort2f(&p[4], &p[2]);
+  return p[4];
+}
+
+/* ── Tiles ───────────────────────────────────────────────────────────────── */
+
+typedef struct _ca_tile_t
+{
+  int top, left;                  // origin in the image, may be -border
+  int vblock, hblock;             // block indices (1-based, as in the fit)
+  int rr1, cc1;                   // tile size
+  int rrmin, rrmax, ccmin, ccmax; // part covered by the image
+} _ca_tile_t;
+
+static inline _ca_tile_t _tile_at(const int iv, const int ih, const int width, const int height)
+{
+  _ca_tile_t t;
+  t.top = -border + iv * (ts - border2);
+  t.left = -border + ih * (ts - border2);
+  t.vblock = iv + 1;
+  t.hblock = ih + 1;
+  const int bottom = MIN(t.top + ts, height + border);
+  const int right = MIN(t.left + ts, width + border);
+  t.rr1 = bottom - t.top;
+  t.cc1 = right - t.left;
+  t.rrmin = t.top < 0 ? border : 0;
+  t.rrmax = bottom > height ? height - t.top : t.rr1;
+  t.ccmin = t.left < 0 ? border : 0;
+  t.ccmax = right > width ? width - t.left : t.cc1;
+  return t;
+}
+
+/* per-thread working space, all aligned by the tile size */
+typedef struct _ca_buffers_t
+{
+  float *rgb[3];  // rgb data in a tile
+  float *rbhpfh;  // high pass filter for R/B in vertical direction
+  float *rbhpfv;  // high pass filter for R/B in horizontal direction
+  float *rblpfh;  // low pass filter for R/B in horizontal direction
+  float *rblpfv;  // low pass filter for R/B in vertical direction
+  float *grblpfh; // low pass filter for colour differences in horizontal direction
+  float *grblpfv; // low pass filter for colour differences in vertical direction
+  float *grbdiff; // colour differences (shares rbhpfh, no overlap in use)
+  float *gshift;  // green interpolated to optical sample points for R/B (shares rbhpfv)
+} _ca_buffers_t;
+
+#define CA_BUFFER_SIZE (3 * (size_t)ts * ts + 6 * (size_t)ts * tsh)
+
+static inline _ca_buffers_t _buffers(float *data)
+{
+  const int tilebuf_size = ts * ts;
+  const int tilebuf_half_size = ts * tsh;
+  _ca_buffers_t b;
+  b.rgb[0] = data;
+  b.rgb[1] = data + tilebuf_size;
+  b.rgb[2] = data + 2 * tilebuf_size;
+  b.rbhpfh = data + 3 * tilebuf_size;
+  b.rbhpfv = data + 3 * tilebuf_size + 1 * tilebuf_half_size;
+  b.rblpfh = data + 3 * tilebuf_size + 2 * tilebuf_half_size;
+  b.rblpfv = data + 3 * tilebuf_size + 3 * tilebuf_half_size;
+  b.grblpfh = data + 3 * tilebuf_size + 4 * tilebuf_half_size;
+  b.grblpfv = data + 3 * tilebuf_size + 5 * tilebuf_half_size;
+  b.grbdiff = b.rbhpfh;
+  b.gshift = b.rbhpfv;
+  return b;
+}
+
+// rgb from input CFA data, borders mirrored.  With G, green at the R/B
+// sites comes from the green pass as well.
+static void _tile_load(const _ca_tile_t *const t,
+                       float *const rgb[3],
+                       const float *const in,
+                       const float *const G,
+                       const int width,
+                       const int height,
+                       const uint32_t filters)
+{
+  const int top = t->top, left = t->left;
+  const int rr1 = t->rr1, cc1 = t->cc1;
+  const int rrmin = t->rrmin, rrmax = t->rrmax, ccmin = t->ccmin, ccmax = t->ccmax;
+
+  // rgb values should be floating point numbers between 0 and 1
+  // after white balance multipliers are applied
+  for(int rr = rrmin; rr < rrmax; rr++)
+  {
+    const int row = rr + top;
+    int c = FC(rr, ccmin, filters);
+    const int c_diff = c ^ FC(rr, ccmin + 1, filters);
+    for(int cc = ccmin; cc < ccmax; cc++)
+    {
+      const int col = cc + left;
+      const size_t indx = (size_t)row * width + col;
+      const size_t indx1 = (size_t)rr * ts + cc;
+      rgb[c][indx1] = in[indx];
+      if(G && (c & 1) == 0)
+        rgb[1][indx1] = G[indx];
+      c ^= c_diff;
+    }
+  }
+
+#define FILL(DST, SRC_IN, SRC_TILE)                                                           \
+  {                                                                                           \
+    const int c = FC(rr, cc, filters);                                                        \
+    rgb[c][DST] = SRC_TILE ? rgb[c][SRC_IN] : in[SRC_IN];                                     \
+    if(G) rgb[1][DST] = SRC_TILE ? rgb[1][SRC_IN] : G[SRC_IN];                                \
+  }
+
+  // fill borders
+  if(rrmin > 0)
+  {
+    for(int rr = 0; rr < border; rr++)
+      for(int cc = ccmin; cc < ccmax; cc++)
+        FILL(rr * ts + cc, (border2 - rr) * ts + cc, TRUE)
+  }
+  if(rrmax < rr1)
+  {
+    for(int rr = 0; rr < MIN(border, rr1 - rrmax); rr++)
+      for(int cc = ccmin; cc < ccmax; cc++)
+        FILL((rrmax + rr) * ts + cc, (height - rr - 2) * width + left + cc, FALSE)
+  }
+  if(ccmin > 0)
+  {
+    for(int rr = rrmin; rr < rrmax; rr++)
+      for(int cc = 0; cc < border; cc++)
+        FILL(rr * ts + cc, rr * ts + border2 - cc, TRUE)
+  }
+  if(ccmax < cc1)
+  {
+    for(int rr = rrmin; rr < rrmax; rr++)
+      for(int cc = 0; cc < MIN(border, cc1 - ccmax); cc++)
+        FILL(rr * ts + ccmax + cc, (top + rr) * width + (width - cc - 2), FALSE)
+  }
+  // also, fill the image corners
+  if(rrmin > 0 && ccmin > 0)
+  {
+    for(int rr = 0; rr < border; rr++)
+      for(int cc = 0; cc < border; cc++)
+        FILL(rr * ts + cc, (border2 - rr) * width + border2 - cc, FALSE)
+  }
+  if(rrmax < rr1 && ccmax < cc1)
+  {
+    for(int rr = 0; rr < MIN(border, rr1 - rrmax); rr++)
+      for(int cc = 0; cc < MIN(border, cc1 - ccmax); cc++)
+        FILL((rrmax + rr) * ts + ccmax + cc, (height - rr - 2) * width + (width - cc - 2), FALSE)
+  }
+  if(rrmin > 0 && ccmax < cc1)
+  {
+    for(int rr = 0; rr < border; rr++)
+      for(int cc = 0; cc < MIN(border, cc1 - ccmax); cc++)
+        FILL(rr * ts + ccmax + cc, (border2 - rr) * width + (width - cc - 2), FALSE)
+  }
+  if(rrmax < rr1 && ccmin > 0)
+  {
+    for(int rr = 0; rr < MIN(border, rr1 - rrmax); rr++)
+      for(int cc = 0; cc < border; cc++)
+        FILL((rrmax + rr) * ts + cc, (height - rr - 2) * width + (border2 - cc), FALSE)
+  }
+#undef FILL
+}
+
+// green at the R/B sites by directionally weighted average, stored in G
+static void _tile_green(const _ca_tile_t *const t,
+                        float *const rgb[3],
+                        float *const G,
+                        const int width,
+                        const int height,
+                        const uint32_t filters)
+{
+  const int top = t->top, left = t->left;
+  const int rr1 = t->rr1, cc1 = t->cc1;
+
+  for(int rr = 3; rr < rr1 - 3; rr++)
+  {
+    const int row = rr + top;
+    for(int cc = 3 + (FC(rr, 3, filters) & 1), indx = rr * ts + cc, c = FC(rr, cc, filters);
+        cc < cc1 - 3;
+        cc += 2, indx += 2)
+    {
+      // compute directional weights using image gradients
+      const float wtu = 1.f / sqrf(eps + fabsf(rgb[1][indx + v1] - rgb[1][indx - v1])
+                                       + fabsf(rgb[c][indx]      - rgb[c][indx - v2])
+                                       + fabsf(rgb[1][indx - v1] - rgb[1][indx - v3]));
+      const float wtd = 1.f / sqrf(eps + fabsf(rgb[1][indx - v1] - rgb[1][indx + v1])
+                                       + fabsf(rgb[c][indx]      - rgb[c][indx + v2])
+                                       + fabsf(rgb[1][indx + v1] - rgb[1][indx + v3]));
+      const float wtl = 1.f / sqrf(eps + fabsf(rgb[1][indx + 1]  - rgb[1][indx - 1])
+                                       + fabsf(rgb[c][indx]      - rgb[c][indx - 2])
+                                       + fabsf(rgb[1][indx - 1]  - rgb[1][indx - 3]));
+      const float wtr = 1.f / sqrf(eps + fabsf(rgb[1][indx - 1]  - rgb[1][indx + 1])
+                                       + fabsf(rgb[c][indx]      - rgb[c][indx + 2])
+                                       + fabsf(rgb[1][indx + 1]  - rgb[1][indx + 3]));
+      // store in rgb array the interpolated G value at R/B grid points using directional weighted average
+      rgb[1][indx] = (wtu * rgb[1][indx - v1] + wtd * rgb[1][indx + v1] + wtl * rgb[1][indx - 1] + wtr * rgb[1][indx + 1])
+                     / (wtu + wtd + wtl + wtr);
+    }
+    if(row > -1 && row < height)
+    {
+      for(int col = MAX(left + 3, 0), indx = rr * ts + 3 - (left < 0 ? (left + 3) : 0);
+          col < MIN(cc1 + left - 3, width);
+          col++, indx++)
+      {
+        G[(size_t)row * width + col] = rgb[1][indx];
+      }
+    }
+  }
+}
+
+// CA shift of the tile per colour and direction, and the weight of the tile
+static void _tile_diagnose(const _ca_tile_t *const t,
+                           const _ca_buffers_t *const b,
+                           float CAshift[2][2],
+                           float *const weight,
+                           const uint32_t filters)
+{
+  float *const *const rgb = b->rgb;
+  const int rr1 = t->rr1, cc1 = t->cc1;
+
+  for(int rr = borderh; rr < rr1 - borderh; rr++)
+  {
+    for(int cc = borderh + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, c = FC(rr, cc, filters);
+        cc < cc1 - borderh;
+        cc += 2, indx += 2)
+    {
+      b->rbhpfv[indx >> 1] = fabsf(fabsf((rgb[1][indx] - rgb[c][indx])           - (rgb[1][indx + v4] - rgb[c][indx + v4]))
+                                 + fabsf((rgb[1][indx - v4] - rgb[c][indx - v4]) - (rgb[1][indx] - rgb[c][indx]))
+                                 - fabsf((rgb[1][indx - v4] - rgb[c][indx - v4]) - (rgb[1][indx + v4] - rgb[c][indx + v4])));
+      b->rbhpfh[indx >> 1] = fabsf(fabsf((rgb[1][indx] - rgb[c][indx])           - (rgb[1][indx + 4] - rgb[c][indx + 4]))
+                                 + fabsf((rgb[1][indx - 4] - rgb[c][indx - 4])   - (rgb[1][indx] - rgb[c][indx]))
+                                 - fabsf((rgb[1][indx - 4] - rgb[c][indx - 4])   - (rgb[1][indx + 4] - rgb[c][indx + 4])));
+      // low and high pass 1D filters of G in vertical/horizontal directions
+      const float glpfv = 0.25f * (2.f * rgb[1][indx] + rgb[1][indx + v2] + rgb[1][indx - v2]);
+      const float glpfh = 0.25f * (2.f * rgb[1][indx] + rgb[1][indx + 2] + rgb[1][indx - 2]);
+      b->rblpfv[indx >> 1] = eps + fabsf(glpfv - 0.25f * (2.f * rgb[c][indx] + rgb[c][indx + v2] + rgb[c][indx - v2]));
+      b->rblpfh[indx >> 1] = eps + fabsf(glpfh - 0.25f * (2.f * rgb[c][indx] + rgb[c][indx + 2] + rgb[c][indx - 2]));
+      b->grblpfv[indx >> 1] = glpfv + 0.25f * (2.f * rgb[c][indx] + rgb[c][indx + v2] + rgb[c][indx - v2]);
+      b->grblpfh[indx >> 1] = glpfh + 0.25f * (2.f * rgb[c][indx] + rgb[c][indx + 2] + rgb[c][indx - 2]);
+    }
+  }
+
+  // local quadratic fit to shift data within a tile
+  float coeff[2][3][2] = { { { 0.0f } } };
+
+  // along line segments, find the point along each segment that minimizes the colour variance
+  // averaged over the tile; evaluate for up/down and left/right away from R/B grid point
+  for(int rr = border; rr < rr1 - border; rr++)
+  {
+    for(int cc = border + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, c = FC(rr, cc, filters);
+        cc < cc1 - border;
+        cc += 2, indx += 2)
+    {
+      // in linear interpolation, colour differences are a quadratic function of interpolation
+      // position; solve for the interpolation position that minimizes colour difference variance over the tile
+      // vertical
+      float gdiff = 0.3125f * (rgb[1][indx + ts] - rgb[1][indx - ts])
+                  + 0.09375f * (rgb[1][indx + ts + 1] - rgb[1][indx - ts + 1] + rgb[1][indx + ts - 1] - rgb[1][indx - ts - 1]);
+      const float deltgrb = (rgb[c][indx] - rgb[1][indx]);
+      float gradwt = fabsf(0.25f * b->rbhpfv[indx >> 1] + 0.125f * (b->rbhpfv[(indx >> 1) + 1] + b->rbhpfv[(indx >> 1) - 1]))
+                     * (b->grblpfv[(indx >> 1) - v1] + b->grblpfv[(indx >> 1) + v1])
+                     / (eps + 0.1f * (b->grblpfv[(indx >> 1) - v1] + b->grblpfv[(indx >> 1) + v1])
+                        + b->rblpfv[(indx >> 1) - v1] + b->rblpfv[(indx >> 1) + v1]);
+      coeff[0][0][c >> 1] += gradwt * deltgrb * deltgrb;
+      coeff[0][1][c >> 1] += gradwt * gdiff * deltgrb;
+      coeff[0][2][c >> 1] += gradwt * gdiff * gdiff;
+      // horizontal
+      gdiff = 0.3125f * (rgb[1][indx + 1] - rgb[1][indx - 1])
+            + 0.09375f * (rgb[1][indx + 1 + ts] - rgb[1][indx - 1 + ts] + rgb[1][indx + 1 - ts] - rgb[1][indx - 1 - ts]);
+      gradwt = fabsf(0.25f * b->rbhpfh[indx >> 1] + 0.125f * (b->rbhpfh[(indx >> 1) + v1] + b->rbhpfh[(indx >> 1) - v1]))
+               * (b->grblpfh[(indx >> 1) - 1] + b->grblpfh[(indx >> 1) + 1])
+               / (eps + 0.1f * (b->grblpfh[(indx >> 1) - 1] + b->grblpfh[(indx >> 1) + 1])
+                  + b->rblpfh[(indx >> 1) - 1] + b->rblpfh[(indx >> 1) + 1]);
+      coeff[1][0][c >> 1] += gradwt * deltgrb * deltgrb;
+      coeff[1][1][c >> 1] += gradwt * gdiff * deltgrb;
+      coeff[1][2][c >> 1] += gradwt * gdiff * gdiff;
+      //  In Mathematica,
+      //  f[x_]=Expand[Total[Flatten[
+      //  ((1-x) RotateLeft[Gint,shift1]+x
+      //  RotateLeft[Gint,shift2]-cfapad)^2[[dv;;-1;;2,dh;;-1;;2]]]]];
+      //  extremum = -.5Coefficient[f[x],x]/Coefficient[f[x],x^2]
+    }
+  }
+
+  for(int c = 0; c < 2; c++)
+  {
+    for(int dir = 0; dir < 2; dir++)
+    { // vert/hor
+      // CAshift[dir][c] are the locations
+      // that minimize colour difference variances;
+      // This is the approximate _optical_ location of the R/B pixels
+      if(coeff[dir][2][c] > eps2)
+      {
+        CAshift[dir][c] = coeff[dir][1][c] / coeff[dir][2][c];
+        *weight = coeff[dir][2][c] / (eps + coeff[dir][0][c]);
+      }
+      else
+      {
+        CAshift[dir][c] = 17.0f;
+        *weight = 0;
+      }
+    }
+  }
+}
+
+// correct the R/B sites of the tile and store them in RawDataTmp
+static void _tile_correct(const _ca_tile_t *const t,
+                          const _ca_buffers_t *const b,
+                          const _ca_fit_t *const fit,
+                          float *const RawDataTmp,
+                          const int width,
+                          const uint32_t filters)
+{
+  float *const *const rgb = b->rgb;
+  const int top = t->top, left = t->left;
+  const int rr1 = t->rr1, cc1 = t->cc1;
+  const int vblock = t->vblock, hblock = t->hblock;
+  const int polyord = fit->polyord;
+
+  // direction of the CA shift in a tile
+  int GRBdir[2][3];
+  int shifthfloor[3], shiftvfloor[3], shifthceil[3], shiftvceil[3];
+  // residual CA shift amount within a plaquette
+  float shifthfrac[3], shiftvfrac[3];
+
+  float lblockshifts[2][2];
+  {
+    // CA auto correction; use CA diagnostic pass to set shift parameters
+    lblockshifts[0][0] = lblockshifts[0][1] = 0;
+    lblockshifts[1][0] = lblockshifts[1][1] = 0;
+    float powVblock = 1.0f;
+    for(int i = 0; i < polyord; i++)
+    {
+      float powHblock = powVblock;
+      for(int j = 0; j < polyord; j++)
+      {
+        lblockshifts[0][0] += powHblock * fit->params[0][0][polyord * i + j];
+        lblockshifts[0][1] += powHblock * fit->params[0][1][polyord * i + j];
+        lblockshifts[1][0] += powHblock * fit->params[1][0][polyord * i + j];
+        lblockshifts[1][1] += powHblock * fit->params[1][1][polyord * i + j];
+        powHblock *= hblock;
+      }
+      powVblock *= vblock;
+    }
+    const float bslim = 3.99f; // max allowed CA shift
+    lblockshifts[0][0] = CLAMPF(lblockshifts[0][0], -bslim, bslim);
+    lblockshifts[0][1] = CLAMPF(lblockshifts[0][1], -bslim, bslim);
+    lblockshifts[1][0] = CLAMPF(lblockshifts[1][0], -bslim, bslim);
+    lblockshifts[1][1] = CLAMPF(lblockshifts[1][1], -bslim, bslim);
+  } // end of setting CA shift parameters
+
+  for(int c = 0; c < 3; c += 2)
+  {
+    // some parameters for the bilinear interpolation
+    shiftvfloor[c] = floorf(lblockshifts[c >> 1][0]);
+    shiftvceil[c] = ceilf(lblockshifts[c >> 1][0]);
+    if(lblockshifts[c >> 1][0] < 0.f)
+    {
+      const int tmp = shiftvfloor[c];
+      shiftvfloor[c] = shiftvceil[c];
+      shiftvceil[c] = tmp;
+    }
+    shiftvfrac[c] = fabsf(lblockshifts[c >> 1][0] - shiftvfloor[c]);
+    shifthfloor[c] = floorf(lblockshifts[c >> 1][1]);
+    shifthceil[c] = ceilf(lblockshifts[c >> 1][1]);
+    if(lblockshifts[c >> 1][1] < 0.f)
+    {
+      const int tmp = shifthfloor[c];
+      shifthfloor[c] = shifthceil[c];
+      shifthceil[c] = tmp;
+    }
+    shifthfrac[c] = fabsf(lblockshifts[c >> 1][1] - shifthfloor[c]);
+
+    GRBdir[0][c] = lblockshifts[c >> 1][0] > 0 ? 2 : -2;
+    GRBdir[1][c] = lblockshifts[c >> 1][1] > 0 ? 2 : -2;
+  }
+
+  for(int rr = borderh; rr < rr1 - borderh; rr++)
+  {
+    for(int cc = borderh + (FC(rr, 2, filters) & 1), c = FC(rr, cc, filters); cc < cc1 - borderh; cc += 2)
+    {
+      // perform CA correction using colour ratios or colour differences
+      const float Ginthfloor = interpolatef(shifthfrac[c],
+                                            rgb[1][(rr + shiftvfloor[c]) * ts + cc + shifthceil[c]],
+                                            rgb[1][(rr + shiftvfloor[c]) * ts + cc + shifthfloor[c]]);
+      const float Ginthceil = interpolatef(shifthfrac[c],
+                                           rgb[1][(rr + shiftvceil[c]) * ts + cc + shifthceil[c]],
+                                           rgb[1][(rr + shiftvceil[c]) * ts + cc + shifthfloor[c]]);
+      // Gint is bilinear interpolation of G at CA shift point
+      const float Gint = interpolatef(shiftvfrac[c], Ginthceil, Ginthfloor);
+
+      // determine R/B at grid points using colour differences at shift point plus interpolated G value at grid point
+      // but first we need to interpolate G-R/G-B to grid points...
+      b->grbdiff[(rr * ts + cc) >> 1] = Gint - rgb[c][rr * ts + cc];
+      b->gshift[(rr * ts + cc) >> 1] = Gint;
+    }
+  }
+
+  shifthfrac[0] /= 2.f;
+  shifthfrac[2] /= 2.f;
+  shiftvfrac[0] /= 2.f;
+  shiftvfrac[2] /= 2.f;
+
+  const float *const grbdiff = b->grbdiff;
+  const float *const gshift = b->gshift;
+
+  // this loop does not deserve vectorization in mainly because the most expensive part with the
+  // divisions does not happen often (less than 1/10 in my tests)
+  for(int rr = border; rr < rr1 - border; rr++)
+  {
+    for(int cc = border + (FC(rr, 2, filters) & 1), c = FC(rr, cc, filters), indx = rr * ts + cc;
+        cc < cc1 - border;
+        cc += 2, indx += 2)
+    {
+      const float grbdiffold = rgb[1][indx] - rgb[c][indx];
+      // interpolate colour difference from optical R/B locations to grid locations
+      const float grbdiffinthfloor = interpolatef(shifthfrac[c],
+                                                  grbdiff[(indx - GRBdir[1][c]) >> 1],
+                                                  grbdiff[indx >> 1]);
+      const float grbdiffinthceil = interpolatef(shifthfrac[c],
+                                                 grbdiff[((rr - GRBdir[0][c]) * ts + cc - GRBdir[1][c]) >> 1],
+                                                 grbdiff[((rr - GRBdir[0][c]) * ts + cc) >> 1]);
+      // grbdiffint is bilinear interpolation of G-R/G-B at grid point
+      float grbdiffint = interpolatef(shiftvfrac[c], grbdiffinthceil, grbdiffinthfloor);
+
+      // now determine R/B at grid points using interpolated colour differences and interpolated G value at grid point
+      const float RBint = rgb[1][indx] - grbdiffint;
+      if(fabsf(RBint - rgb[c][indx]) < 0.25f * (RBint + rgb[c][indx]))
+      {
+        if(fabsf(grbdiffold) > fabsf(grbdiffint))
+          rgb[c][indx] = RBint;
+      }
+      else
+      {
+        // gradient weights using difference from G at CA shift points and G at grid points
+        const float p0 = 1.0f / (eps + fabsf(rgb[1][indx] - gshift[indx >> 1]));
+        const float p1 = 1.0f / (eps + fabsf(rgb[1][indx] - gshift[(indx - GRBdir[1][c]) >> 1]));
+        const float p2 = 1.0f / (eps + fabsf(rgb[1][indx] - gshift[((rr - GRBdir[0][c]) * ts + cc) >> 1]));
+        const float p3 = 1.0f / (eps + fabsf(rgb[1][indx] - gshift[((rr - GRBdir[0][c]) * ts + cc - GRBdir[1][c]) >> 1]));
+
+        grbdiffint = (p0 * grbdiff[indx >> 1]
+                      + p1 * grbdiff[(indx - GRBdir[1][c]) >> 1]
+                      + p2 * grbdiff[((rr - GRBdir[0][c]) * ts + cc) >> 1]
+                      + p3 * grbdiff[((rr - GRBdir[0][c]) * ts + cc - GRBdir[1][c]) >> 1])
+                     / (p0 + p1 + p2 + p3);
+
+        // now determine R/B at grid points using interpolated colour differences and interpolated G
+        // value at grid point
+        if(fabsf(grbdiffold) > fabsf(grbdiffint))
+          rgb[c][indx] = rgb[1][indx] - grbdiffint;
+      }
+
+      // if colour difference interpolation overshot the correction, just desaturate
+      if(grbdiffold * grbdiffint < 0)
+        rgb[c][indx] = rgb[1][indx] - 0.5f * (grbdiffold + grbdiffint);
+    }
+  }
+
+  // copy CA corrected results to temporary image matrix
+  for(int rr = border; rr < rr1 - border; rr++)
+  {
+    const int c = FC(rr + top, left + border + (FC(rr + top, 2, filters) & 1), filters);
+    for(int row = rr + top, cc = border + (FC(rr, 2, filters) & 1), indx = (row * width + cc + left) >> 1;
+        cc < cc1 - border;
+        cc += 2, indx++)
+    {
+      RawDataTmp[indx] = rgb[c][rr * ts + cc];
+    }
+  }
+}
+
+/* ── Polynomial fit ──────────────────────────────────────────────────────── */
+
+/*
+ * Fits the block shifts of the diagnosed tiles.  bs / bw hold the sampled
+ * tiles on a (nv x nh) lattice with a one-block margin; lattice index
+ * (i, j) is tile (1 + step * (i - 1), 1 + step * (j - 1)).  blockvar is
+ * the variance of the shifts over all diagnosed tiles.
+ */
+static gboolean _fit_blockshifts(float (*const bs)[2][2],
+                                 const float *const bw,
+                                 const int nv,
+                                 const int nh,
+                                 const int step,
+                                 const float blockvar[2][2],
+                                 _ca_fit_t *const fit)
+{
+  // fill border blocks of the blockshift array
+  for(int i = 1; i < nv - 1; i++)
+  { // left and right sides
+    for(int c = 0; c < 2; c++)
+      for(int k = 0; k < 2; k++)
+      {
+        bs[i * nh][c][k] = bs[i * nh + 2][c][k];
+        bs[i * nh + nh - 1][c][k] = bs[i * nh + nh - 3][c][k];
+      }
+  }
+  for(int j = 0; j < nh; j++)
+  { // top and bottom sides
+    for(int c = 0; c < 2; c++)
+      for(int k = 0; k < 2; k++)
+      {
+        bs[j][c][k] = bs[2 * nh + j][c][k];
+        bs[(nv - 1) * nh + j][c][k] = bs[(nv - 3) * nh + j][c][k];
+      }
+  }
+
+  // order of 2d polynomial fit (polyord), and numpar=polyord^2
+  int polyord = 4;
+  int numpar = 16;
+
+  // initialize fit arrays
+  double polymat[2][2][256] = { { { 0.0 } } };
+  double shiftmat[2][2][16] = { { { 0.0 } } };
+  int numblox[2] = { 0, 0 };
+
+  for(int i = 1; i < nv - 1; i++)
+  {
+    const double vblock = 1 + step * (i - 1);
+    for(int j = 1; j < nh - 1; j++)
+    {
+      const double hblock = 1 + step * (j - 1);
+      const float wt = bw[i * nh + j];
+
+      // block 3x3 median of blockshifts for robustness
+      for(int c = 0; c < 2; c++)
+      {
+        float bstemp[2];
+        for(int dir = 0; dir < 2; dir++)
+        {
+          float p[9];
+          for(int di = -1, n = 0; di <= 1; di++)
+            for(int dj = -1; dj <= 1; dj++, n++)
+              p[n] = bs[(i + di) * nh + j + dj][c][dir];
+          bstemp[dir] = _median9f(p);
+        }
+        // now prepare coefficient matrix; use only data points within caautostrength/2 std devs of zero
+        if(sqrf(bstemp[0]) > caautostrength * blockvar[0][c] || sqrf(bstemp[1]) > caautostrength * blockvar[1][c])
+          continue;
+
+        numblox[c]++;
+        double powVblockInit = 1.0;
+        for(int a = 0; a < polyord; a++)
+        {
+          double powHblockInit = 1.0;
+          for(int b = 0; b < polyord; b++)
+          {
+            double powVblock = powVblockInit;
+            for(int m = 0; m < polyord; m++)
+            {
+              double powHblock = powHblockInit;
+              for(int n = 0; n < polyord; n++)
+              {
+                const double inc = powVblock * powHblock * wt;
+                const size_t idx = numpar * (polyord * a + b) + (polyord * m + n);
+                polymat[c][0][idx] += inc;
+                polymat[c][1][idx] += inc;
+                powHblock *= hblock;
+              }
+              powVblock *= vblock;
+            }
+            const double blkinc = powVblockInit * powHblockInit * wt;
+            shiftmat[c][0][(polyord * a + b)] += blkinc * bstemp[0];
+            shiftmat[c][1][(polyord * a + b)] += blkinc * bstemp[1];
+            powHblockInit *= hblock;
+          }
+          powVblockInit *= vblock;
+        } // monomials
+      }   // c
+    }     // blocks
+  }
+
+  numblox[1] = MIN(numblox[0], numblox[1]);
+  // if too few data points, restrict the order of the fit to linear
+  if(numblox[1] < 32)
+  {
+    polyord = 2;
+    numpar = 4;
+
+    if(numblox[1] < 10)
+    {
+      dt_print(DT_DEBUG_PIPE, "[cacorrect] restrict fit to linear, numblox = %d\n", numblox[1]);
+      return FALSE;
+    }
+  }
+
+  // fit parameters to blockshifts
+  for(int c = 0; c < 2; c++)
+    for(int dir = 0; dir < 2; dir++)
+    {
+      if(!_LinEqSolve(numpar, polymat[c][dir], shiftmat[c][dir], fit->params[c][dir]))
+      {
+        dt_print(DT_DEBUG_PIPE, "[cacorrect] can't solve linear equations for colour %d direction %d\n", c, dir);
+        return FALSE;
+      }
+    }
+  // params[polyord*i+j] gives the coefficients of (vblock^i hblock^j) in a polynomial fit for i,j<=4
+  fit->polyord = polyord;
+  return TRUE;
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const float *const input = (float *)ivoid;
+  float *output = (float *)ovoid;
+
+  const uint32_t filters = piece->pipe->dsc.filters;
+
+  const gboolean run_fast = piece->pipe->type & DT_DEV_PIXELPIPE_FAST;
+
+  dt_iop_cacorrect_data_t *d = piece->data;
+
+  // the colorshift avoiding requires non-downscaled data for sure so we
+  // don't do this for preview
+  const gboolean avoidshift = d->avoidshift && !(piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW);
+  const int iterations = MIN(d->iterations, CA_MAX_ITERATIONS);
+
+  gboolean processpasstwo = TRUE;
+
+  float *redfactor = NULL;
+  float *bluefactor = NULL;
+  float *oldraw = NULL;
+  float *blockwt = NULL;
+  float *RawDataTmp = NULL;
+  float *Gtmp = NULL;
+  float *data = NULL;
+
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const size_t ibsize = (size_t)width * (height + 2);
+
+  const int h_width = (width + 1) / 2;
+  const int h_height = (height + 1) / 2;
+  const size_t h_bsize = (size_t)h_width * (h_height + 2);
+
+  float *out = dt_alloc_align_float(ibsize);
+  if(!out)
+  {
+    dt_iop_copy_image_roi(ovoid, ivoid, piece->colors, roi_in, roi_out);
+    fprintf(stderr, "[cacorrect] out of memory, skipping\n");
+    return;
+  }
+
+  const float scaler = dt_iop_get_processed_maximum(piece);
+  DT_OMP_FOR_SIMD()
+  for(size_t k = 0; k < (size_t)width * height; k++)
+    out[k] = input[k] / scaler;
+
+  if(run_fast) goto writeout;
+
+  const float *const in = out;
+
+  if(avoidshift)
+  {
+    redfactor = dt_calloc_align_float(h_bsize);
+    bluefactor = dt_calloc_align_float(h_bsize);
+    oldraw = dt_calloc_align_float(h_bsize * 2);
+    if(!redfactor || !bluefactor || !oldraw)
+    {
+      fprintf(stderr, "[cacorrect] out of memory, skipping\n");
+      goto writeout;
+    }
+    // copy raw values before ca correction
+    DT_OMP_FOR()
+    for(int row = 0; row < height; row++)
+    {
+      for(int col = (FC(row, 0, filters) & 1); col < width; col += 2)
+      {
+        oldraw[(size_t)row * h_width + col / 2] = in[(size_t)row * width + col];
+      }
+    }
+  }
+
+  // tiles of the image, and the lattice of the diagnosed ones with a one-block margin
+  const int vtiles = (height + border + (ts - border2) - 1) / (ts - border2);
+  const int htiles = (width + border + (ts - border2) - 1) / (ts - border2);
+  const int step = ((vtiles / 2) * (htiles / 2) >= CA_FIT_MIN_SAMPLES) ? 2 : 1;
+  const int nv = (vtiles + step - 1) / step + 2;
+  const int nh = (htiles + step - 1) / step + 2;
+
+  // the fit only depends on the data reaching this module
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+  hash = dt_hash(hash, &scaler, sizeof(scaler));
+  if(d->fit_hash != hash)
+  {
+    d->fit_hash = hash;
+    d->fit_count = 0;
+  }
+
+  // temporary array to store simple interpolation of G
+  Gtmp = dt_calloc_align_float(ibsize);
+  // temporary array to avoid race conflicts, only every second pixel needs to be saved here
+  RawDataTmp = dt_alloc_align_float(ibsize / 2 + 1);
+  // block CA shift values and weight assigned to block
+  blockwt = dt_calloc_align_float(5 * (size_t)nv * nh);
+
+  size_t padded;
+  data = dt_alloc_perthread_float(CA_BUFFER_SIZE, &padded);
+
+  if(!Gtmp || !RawDataTmp || !blockwt || !data)
+  {
+    fprintf(stderr, "[cacorrect] out of memory, skipping\n");
+    goto writeout;
+  }
+  float (*blockshifts)[2][2] = (float(*)[2][2])(blockwt + (size_t)nv * nh);
+
+  for(int it = 0; it < iterations && processpasstwo; it++)
+  {
+    // green at the R/B sites for the whole image
+    DT_OMP_FOR(collapse(2))
+    for(int iv = 0; iv < vtiles; iv++)
+      for(int ih = 0; ih < htiles; ih++)
+      {
+        float *const tile = dt_get_perthread(data, padded);
+        const _ca_buffers_t b = _buffers(tile);
+        const _ca_tile_t t = _tile_at(iv, ih, width, height);
+        memset(tile, 0, 3 * sizeof(float) * ts * ts);
+        _tile_load(&t, b.rgb, in, NULL, width, height, filters);
+        _tile_green(&t, b.rgb, Gtmp, width, height, filters);
+      }
+
+    if(it >= d->fit_count)
+    {
+      // diagnostic pass on the lattice
+      memset(blockwt, 0, sizeof(float) * 5 * (size_t)nv * nh);
+      DT_OMP_FOR(collapse(2))
+      for(int i = 1; i < nv - 1; i++)
+        for(int j = 1; j < nh - 1; j++)
+        {
+          const int iv = step * (i - 1);
+          const int ih = step * (j - 1);
+          if(iv >= vtiles || ih >= htiles) continue;
+          float *const tile = dt_get_perthread(data, padded);
+          const _ca_buffers_t b = _buffers(tile);
+          const _ca_tile_t t = _tile_at(iv, ih, width, height);
+          memset(tile, 0, sizeof(float) * CA_BUFFER_SIZE);
+          _tile_load(&t, b.rgb, in, Gtmp, width, height, filters);
+
+          float CAshift[2][2];
+          _tile_diagnose(&t, &b, CAshift, &blockwt[i * nh + j], filters);
+          // data structure = blockshifts[block][colour][vert/hor]
+          for(int c = 0; c < 2; c++)
+            for(int dir = 0; dir < 2; dir++)
+              blockshifts[i * nh + j][c][dir] = CAshift[dir][c];
+        }
+
+      // evaluation of block CA shift variance
+      float blockave[2][2] = { { 0, 0 }, { 0, 0 } };
+      float blocksqave[2][2] = { { 0, 0 }, { 0, 0 } };
+      float blockdenom[2][2] = { { 0, 0 }, { 0, 0 } };
+      float blockvar[2][2];
+      for(int i = 1; i < nv - 1; i++)
+        for(int j = 1; j < nh - 1; j++)
+        {
+          if(step * (i - 1) >= vtiles || step * (j - 1) >= htiles) continue;
+          for(int c = 0; c < 2; c++)
+            for(int dir = 0; dir < 2; dir++)
+            {
+              const float shift = blockshifts[i * nh + j][c][dir];
+              if(fabsf(shift) < 2.0f)
+              {
+                blockave[dir][c] += shift;
+                blocksqave[dir][c] += sqrf(shift);
+                blockdenom[dir][c] += 1;
+              }
+            }
+        }
+
+      _ca_fit_t *const fit = &d->fit[it];
+      fit->valid = TRUE;
+      for(int dir = 0; dir < 2 && fit->valid; dir++)
+        for(int c = 0; c < 2; c++)
+        {
+          if(blockdenom[dir][c])
+            blockvar[dir][c] = blocksqave[dir][c] / blockdenom[dir][c] - sqrf(blockave[dir][c] / blockdenom[dir][c]);
+          else
+          {
+            dt_print(DT_DEBUG_PIPE, "[cacorrect] blockdenom vanishes\n");
+            fit->valid = FALSE;
+            break;
+          }
+        }
+      if(fit->valid)
+        fit->valid = _fit_blockshifts(blockshifts, blockwt, nv, nh, step, blockvar, fit);
+      d->fit_count = it + 1;
+    }
+
+    const _ca_fit_t *const fit = &d->fit[it];
+    processpasstwo = fit->valid;
+    if(!processpasstwo) break;
+
+    // correction pass
+    DT_OMP_FOR(collapse(2))
+    for(int iv = 0; iv < vtiles; iv++)
+      for(int ih = 0; ih < htiles; ih++)
+      {
+        float *const tile = dt_get_perthread(data, padded);
+        const _ca_buffers_t b = _buffers(tile);
+        const _ca_tile_t t = _tile_at(iv, ih, width, height);
+        memset(tile, 0, sizeof(float) * CA_BUFFER_SIZE);
+        _tile_load(&t, b.rgb, in, Gtmp, width, height, filters);
+        _tile_correct(&t, &b, fit, RawDataTmp, width, filters);
+      }
+
+    // copy temporary image matrix back to image matrix
+    DT_OMP_FOR()
+    for(int row = 0; row < height; row++)
+      for(int col = 0 + (FC(row, 0, filters) & 1), indx = (row * width + col) >> 1; col < width; col += 2, indx++)
+      {
+        out[(size_t)row * width + col] = RawDataTmp[indx];
+      }
+  }
+
+  if(avoidshift && processpasstwo)
+  {
+    // to avoid or at least reduce the colour shift caused by raw ca correction we compute the per pixel difference factors
+    // of red and blue channel and apply a gaussian blur to them.
+    // Then we apply the resulting factors per pixel on the result of raw ca correction
+    DT_OMP_FOR()
+    for(int row = 0; row < height; row++)
+    {
+      const int firstCol = FC(row, 0, filters) & 1;
+      const int color    = FC(row, firstCol, filters);
+      float *nongreen    = (color == 0) ? redfactor : bluefactor;
+      for(int col = firstCol; col < width; col += 2)
+      {
+        const size_t index = (size_t)row * width + col;
+        const size_t oindex = (size_t)row * h_width + col / 2;
+        nongreen[(row / 2) * h_width + col / 2] = CLAMPF(oldraw[oindex] / in[index], 0.5f, 2.0f);
+      }
+    }
+
+    if(height % 2)
+    {
+      // odd height => factors are not set in last row => use values of preceding row
+      for(int col = 0; col < h_width; col++)
+      {
+        redfactor[(h_height - 1) * h_width + col] = redfactor[(h_height - 2) * h_width + col];
+        bluefactor[(h_height - 1) * h_width + col] = bluefactor[(h_height - 2) * h_width + col];
+      }
+    }
+
+    if(width % 2)
+    {
+      // odd width => factors for one channel are not set in last column => use value of preceding column
+      const int ngRow = 1 - (FC(0, 0, filters) & 1);
+      const int ngCol = FC(ngRow, 0, filters) & 1;
+      const int color = FC(ngRow, ngCol, filters);
+      float *nongreen = (color == 0) ? redfactor : bluefactor;
+      for(int row = 0; row < h_height; row++)
+      {
+        nongreen[row * h_width + h_width - 1] = nongreen[row * h_width + h_width - 2];
+      }
+    }
+
+    // blur correction factors
+    float valmax[] = { 10.0f };
+    float valmin[] = { 0.1f };
+    dt_gaussian_t *red  = dt_gaussian_init(h_width, h_height, 1, valmax, valmin, 30.0f, 0);
+    dt_gaussian_t *blue = dt_gaussian_init(h_width, h_height, 1, valmax, valmin, 30.0f, 0);
+    if(red && blue)
+    {
+      dt_gaussian_blur(red, redfactor, redfactor);
+      dt_gaussian_blur(blue, bluefactor, bluefactor);
+
+      DT_OMP_FOR()
+      for(int row = 2; row < height - 2; row++)
+      {
+        const int firstCol = FC(row, 0, filters) & 1;
+        const int color = FC(row, firstCol, filters);
+        float *nongreen = (color == 0) ? redfactor : bluefactor;
+        for(int col = firstCol; col < width - 2; col += 2)
+        {
+          const float correction = nongreen[row / 2 * h_width + col / 2];
+          out[(size_t)row * width + col] *= correction;
+        }
+      }
+    }
+    if(red)  dt_gaussian_free(red);
+    if(blue) dt_gaussian_free(blue);
+  }
+
+writeout:
+  DT_OMP_FOR(collapse(2))
+  for(size_t row = 0; row < roi_out->height; row++)
+  {
+    for(size_t col = 0; col < roi_out->width; col++)
+    {
+      const size_t ox = row * roi_out->width + col;
+      const size_t irow = row + roi_out->y;
+      const size_t icol = col + roi_out->x;
+      const size_t ix = irow * roi_in->width + icol;
+      if((irow < roi_in->height) && (icol < roi_in->width))
+      {
+        output[ox] = out[ix] * scaler;
+      }
+    }
+  }
+
+  dt_free_align(data);
+  dt_free_align(blockwt);
+  dt_free_align(out);
+  dt_free_align(RawDataTmp);
+  dt_free_align(Gtmp);
+  dt_free_align(redfactor);
+  dt_free_align(bluefactor);
+  dt_free_align(oldraw);
+}
+
+#undef CA_BUFFER_SIZE
+#undef CA_FIT_MIN_SAMPLES
+#undef caautostrength
+#undef ts
+#undef tsh
+#undef v1
+#undef v2
+#undef v3
+#undef v4
+#undef border
+#undef border2
+#undef borderh
+
+/*==================================================================================
+ * end raw therapee code
+ *==================================================================================*/
+
+/* ── modify_roi_out() / modify_roi_in() ──────────────────────────────────── */
+
+static void modify_roi_out(dt_iop_module_t *self,
+                           dt_dev_pixelpipe_iop_t *piece,
+                           dt_iop_roi_t *roi_out,
+                           const dt_iop_roi_t *const roi_in)
+{
+  *roi_out = *roi_in;
+  roi_out->x = MAX(0, roi_in->x);
+  roi_out->y = MAX(0, roi_in->y);
+}
+
+static void modify_roi_in(dt_iop_module_t *self,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_roi_t *roi_in)
+{
+  *roi_in = *roi_out;
+  roi_in->x = 0;
+  roi_in->y = 0;
+  roi_in->width = piece->buf_in.width;
+  roi_in->height = piece->buf_in.height;
+  roi_in->scale = 1.0f;
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *params,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_cacorrect_params_t *p = (const dt_iop_cacorrect_params_t *)params;
+  dt_iop_cacorrect_data_t *d = piece->data;
+
+  // can't be switched on for non bayer RGB images
+  if(!dt_image_is_bayerRGB(&pipe->image)) piece->enabled = FALSE;
+
+  d->iterations = CLAMP((int)p->iterations, 1, CA_MAX_ITERATIONS);
+  d->avoidshift = p->avoidshift;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_cacorrect_data_t *d = calloc(1, sizeof(dt_iop_cacorrect_data_t));
+  if(d) d->fit_hash = DT_INVALID_HASH;
+  piece->data = d;
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_cacorrect_params_t *d = self->default_params;
+  if(!d) return;
+  d->avoidshift = FALSE;
+  d->iterations = CACORRETC_MULTI_2;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+static int input_colorspace(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_t *pipe,
+                            dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RAW;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_cacorrect_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain     = process;
+  so->init              = init;
+  so->init_pipe         = init_pipe;
+  so->cleanup_pipe      = cleanup_pipe;
+  so->commit_params     = commit_params;
+  so->input_colorspace  = input_colorspace;
+  so->output_colorspace = input_colorspace;
+  so->modify_roi_in     = modify_roi_in;
+  so->modify_roi_out    = modify_roi_out;
+}
@@ -0,0 +1,732 @@
+/*
+ * channelmixerrgb.c - darktable color calibration IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/channelmixerrgb.c (GPLv3).
+ * GUI code, OpenCL, presets, legacy_params(), the colour checker
+ * calibration and the illuminant auto-detection (surfaces / edges) removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - The pipeline white is D65 (common/colorspaces.h), so the chromatic
+ *     adaptation targets D65 where darktable targets D50, and the gamut
+ *     mapping compresses towards the D65 white.
+ *   - Pipeline RGB <-> XYZ matrices are built in commit_params() instead of
+ *     being fetched from the work profile in process().
+ *   - The "as shot in camera" illuminant is resolved once per commit from
+ *     the image WB coefficients; there is no dt_develop_t chroma to follow.
+ *   - When the committed parameters reduce the module to a linear map
+ *     (no gamut compression, no clipping, no saturation / lightness / grey,
+ *     and any adaptation but non-linear Bradford) the whole per-pixel chain
+ *     is folded into one 3x3 matrix.  process() then runs a single matrix
+ *     pass, and color_matrix() exposes it to the pipe so it is fused with
+ *     the colorin matrix that runs just before it (see pixelpipe.c).
+ *
+ * Struct layout of dt_iop_channelmixer_rgb_params_t MUST match the
+ * descriptor table in libdtpipe/src/pipe/params.c (_channelmixerrgb_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2020-2025 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+#include "common/chromatic_adaptation.h"
+#include "common/illuminants.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHANNEL_SIZE 4
+#define INVERSE_SQRT_3 0.5773502691896258f
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+typedef enum dt_iop_channelmixer_rgb_version_t
+{
+  CHANNELMIXERRGB_V_1 = 0, /* version 1 (2020)     */
+  CHANNELMIXERRGB_V_2 = 1, /* version 2 (2021)     */
+  CHANNELMIXERRGB_V_3 = 2, /* version 3 (Apr 2021) */
+} dt_iop_channelmixer_rgb_version_t;
+
+/*
+ * IMPORTANT: field order and types must exactly match
+ * _channelmixerrgb_params_t in pipe/params.c so that memcpy-based history
+ * load/save works correctly.
+ */
+typedef struct dt_iop_channelmixer_rgb_params_t
+{
+  float   red[CHANNEL_SIZE];         /* [-2, 2] R output from R, G, B    */
+  float   green[CHANNEL_SIZE];       /* [-2, 2]                          */
+  float   blue[CHANNEL_SIZE];        /* [-2, 2]                          */
+  float   saturation[CHANNEL_SIZE];  /* [-2, 2]                          */
+  float   lightness[CHANNEL_SIZE];   /* [-2, 2]                          */
+  float   grey[CHANNEL_SIZE];        /* [-2, 2]                          */
+  int32_t normalize_R, normalize_G, normalize_B;            /* gboolean */
+  int32_t normalize_sat, normalize_light, normalize_grey;   /* gboolean */
+  int32_t illuminant;                /* dt_illuminant_t, default D       */
+  int32_t illum_fluo;                /* dt_illuminant_fluo_t, default F3 */
+  int32_t illum_led;                 /* dt_illuminant_led_t, default B5  */
+  int32_t adaptation;                /* dt_adaptation_t, default CAT16   */
+  float   x, y;                      /* custom illuminant chromaticity   */
+  float   temperature;               /* [1667, 25000] K, default 5003    */
+  float   gamut;                     /* [0, 12] gamut compression        */
+  int32_t clip;                      /* gboolean, clip negative RGB      */
+  int32_t version;                   /* dt_iop_channelmixer_rgb_version_t */
+} dt_iop_channelmixer_rgb_params_t;
+
+typedef struct dt_iop_channelmixer_rgb_data_t
+{
+  dt_colormatrix_t MIX;
+  float DT_ALIGNED_PIXEL saturation[CHANNEL_SIZE];
+  float DT_ALIGNED_PIXEL lightness[CHANNEL_SIZE];
+  float DT_ALIGNED_PIXEL grey[CHANNEL_SIZE];
+  dt_aligned_pixel_t illuminant; /* illuminant in the adaptation LMS space */
+  float p, gamut;
+  gboolean apply_grey;
+  gboolean clip;
+  dt_adaptation_t adaptation;
+  dt_illuminant_t illuminant_type;
+  dt_iop_channelmixer_rgb_version_t version;
+
+  /* pipeline RGB <-> XYZ, from common/colorspaces.h */
+  dt_colormatrix_t RGB_to_XYZ;
+  dt_colormatrix_t XYZ_to_RGB;
+
+  /* the whole module as one pipeline RGB -> RGB matrix, when linear */
+  gboolean is_matrix;
+  dt_colormatrix_t matrix;
+  dt_colormatrix_t matrix_transposed;
+} dt_iop_channelmixer_rgb_data_t;
+
+/* ── Pixel helpers ───────────────────────────────────────────────────────── */
+
+/* max(in, floor) per channel, NaN -> floor */
+static inline void _vector_max_nan(dt_aligned_pixel_t out, const float *const in,
+                                   const float floor)
+{
+  for_each_channel(c)
+    out[c] = (in[c] > floor) ? in[c] : floor;
+}
+
+/* clip negatives and NaN to 0 */
+static inline void _vector_clipneg_nan(dt_aligned_pixel_t v)
+{
+  for_each_channel(c)
+    v[c] = (v[c] > 0.f) ? v[c] : 0.f;
+}
+
+/* ── Kernels ─────────────────────────────────────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD(aligned(input, output:16) uniform(compression, clip))
+static inline void _gamut_mapping(const dt_aligned_pixel_t input,
+                                  const float compression,
+                                  const gboolean clip,
+                                  dt_aligned_pixel_t output)
+{
+  /* Get the sum XYZ */
+  const float sum = input[0] + input[1] + input[2];
+  const float Y = input[1];
+
+  /* use chromaticity coordinates of reference white for sum == 0 */
+  dt_aligned_pixel_t xyY = { sum > 0.0f ? input[0] / sum : DT_D65_x,
+                             sum > 0.0f ? input[1] / sum : DT_D65_y,
+                             Y,
+                             0.0f };
+
+  /* Convert to uvY */
+  dt_aligned_pixel_t uvY;
+  dt_xyY_to_uvY(xyY, uvY);
+
+  /* Get the chromaticity difference with white point uv */
+  const float white_denominator = -2.f * DT_D65_x + 12.f * DT_D65_y + 3.f;
+  const float white[2] DT_ALIGNED_PIXEL = { 4.f * DT_D65_x / white_denominator,
+                                            9.f * DT_D65_y / white_denominator };
+  const float delta[2] DT_ALIGNED_PIXEL = { white[0] - uvY[0], white[1] - uvY[1] };
+  const float Delta = Y * (sqf(delta[0]) + sqf(delta[1]));
+
+  /* Compress chromaticity (move toward white point) */
+  const float correction = (compression == 0.0f) ? 0.f : powf(Delta, compression);
+  for(size_t c = 0; c < 2; c++)
+  {
+    /* Ensure the correction does not bring our uvY vector the other side of
+       the white point, that would switch to the opposite color */
+    const float tmp = DT_FMA(correction, delta[c], uvY[c]);
+    uvY[c] = (uvY[c] > white[c]) ? fmaxf(tmp, white[c])
+                                 : fminf(tmp, white[c]);
+  }
+
+  /* Convert back to xyY */
+  dt_uvY_to_xyY(uvY, xyY);
+
+  /* Clip upon request */
+  if(clip) for(size_t c = 0; c < 2; c++) xyY[c] = fmaxf(xyY[c], 0.0f);
+
+  /* Check sanity of y: since we later divide by y, it can't be zero */
+  xyY[1] = fmaxf(xyY[1], NORM_MIN);
+
+  /* Check sanity of x and y: since Z = Y (1 - x - y) / y, if x + y >= 1,
+     Z will be negative */
+  const float scale = xyY[0] + xyY[1];
+  const int sanitize = (scale >= 1.f);
+  for(size_t c = 0; c < 2; c++) xyY[c] = (sanitize) ? xyY[c] / scale : xyY[c];
+
+  /* Convert back to XYZ */
+  dt_xyY_to_XYZ(xyY, output);
+}
+
+DT_OMP_DECLARE_SIMD(aligned(input, output, saturation, lightness:16) uniform(saturation, lightness))
+static inline void _luma_chroma(const dt_aligned_pixel_t input,
+                                const dt_aligned_pixel_t saturation,
+                                const dt_aligned_pixel_t lightness,
+                                dt_aligned_pixel_t output,
+                                const dt_iop_channelmixer_rgb_version_t version)
+{
+  /* Compute euclidean norm */
+  float norm = euclidean_norm(input);
+  const float avg = fmaxf((input[0] + input[1] + input[2]) / 3.0f, NORM_MIN);
+
+  if(norm > 0.f && avg > 0.f)
+  {
+    /* Compute flat lightness adjustment */
+    const float mix = scalar_product(input, lightness);
+
+    /* Compensate the norm to get color ratios (R, G, B) = (1, 1, 1) for
+       grey (colorless) pixels. */
+    if(version == CHANNELMIXERRGB_V_3) norm *= INVERSE_SQRT_3;
+
+    /* Ratios */
+    for_three_channels(c)
+      output[c] = input[c] / norm;
+
+    /* Compute ratios and a flat colorfulness adjustment for the whole pixel */
+    float coeff_ratio = 0.f;
+
+    if(version == CHANNELMIXERRGB_V_1)
+    {
+      for_three_channels(c)
+        coeff_ratio += sqf(1.0f - output[c]) * saturation[c];
+    }
+    else
+      coeff_ratio = scalar_product(output, saturation) / 3.f;
+
+    /* Adjust the RGB ratios with the pixel correction */
+    for_three_channels(c)
+    {
+      /* if the ratio was already invalid (negative), we accept the result
+         to be invalid too, otherwise bright saturated blues end up solid
+         black */
+      const float min_ratio = (output[c] < 0.0f) ? output[c] : 0.0f;
+      const float output_inverse = 1.0f - output[c];
+      output[c] = fmaxf(DT_FMA(output_inverse, coeff_ratio, output[c]), min_ratio);
+    }
+
+    /* The above interpolation between original pixel ratios and (1, 1, 1)
+       might change the norm of the ratios.  Compensate for that. */
+    if(version == CHANNELMIXERRGB_V_3) norm /= euclidean_norm(output) * INVERSE_SQRT_3;
+
+    /* Apply colorfulness adjustment channel-wise and repack with lightness
+       to get LMS back */
+    norm *= fmaxf(1.f + mix / avg, 0.f);
+    for_three_channels(c)
+      output[c] *= norm;
+  }
+  else
+  {
+    /* we have black, 0 stays 0, no luminance = no color */
+    for_three_channels(c)
+      output[c] = input[c];
+  }
+}
+
+static void _loop_switch(const float *const restrict in,
+                         float *const restrict out,
+                         const size_t npixels,
+                         const dt_iop_channelmixer_rgb_data_t *const d,
+                         const dt_adaptation_t kind)
+{
+  dt_colormatrix_t RGB_to_LMS = { { 0.0f } };
+  dt_colormatrix_t MIX_to_XYZ = { { 0.0f } };
+  switch(kind)
+  {
+    case DT_ADAPTATION_FULL_BRADFORD:
+    case DT_ADAPTATION_LINEAR_BRADFORD:
+      make_RGB_to_Bradford_LMS(d->RGB_to_XYZ, RGB_to_LMS);
+      make_Bradford_LMS_to_XYZ(d->MIX, MIX_to_XYZ);
+      break;
+    case DT_ADAPTATION_CAT16:
+      make_RGB_to_CAT16_LMS(d->RGB_to_XYZ, RGB_to_LMS);
+      make_CAT16_LMS_to_XYZ(d->MIX, MIX_to_XYZ);
+      break;
+    case DT_ADAPTATION_XYZ:
+      memcpy(RGB_to_LMS, d->RGB_to_XYZ, sizeof(dt_colormatrix_t));
+      memcpy(MIX_to_XYZ, d->MIX, sizeof(dt_colormatrix_t));
+      break;
+    case DT_ADAPTATION_RGB:
+    case DT_ADAPTATION_LAST:
+    default:
+      /* RGB_to_LMS not applied, since we are not adapting WB */
+      dt_colormatrix_mul(MIX_to_XYZ, d->RGB_to_XYZ, d->MIX);
+      break;
+  }
+
+  const float minval = d->clip ? 0.0f : -FLT_MAX;
+  const float p = d->p;
+  const float gamut = d->gamut;
+  const gboolean clip = d->clip;
+  const gboolean apply_grey = d->apply_grey;
+  const dt_iop_channelmixer_rgb_version_t version = d->version;
+
+  dt_colormatrix_t RGB_to_XYZ_trans;
+  dt_colormatrix_transpose(RGB_to_XYZ_trans, d->RGB_to_XYZ);
+  dt_colormatrix_t RGB_to_LMS_trans;
+  dt_colormatrix_transpose(RGB_to_LMS_trans, RGB_to_LMS);
+  dt_colormatrix_t MIX_to_XYZ_trans;
+  dt_colormatrix_transpose(MIX_to_XYZ_trans, MIX_to_XYZ);
+  dt_colormatrix_t XYZ_to_RGB_trans;
+  dt_colormatrix_transpose(XYZ_to_RGB_trans, d->XYZ_to_RGB);
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    /* intermediate temp buffers */
+    dt_aligned_pixel_t temp_one;
+    dt_aligned_pixel_t temp_two;
+
+    _vector_max_nan(temp_two, &in[k], minval);
+
+    /* WE START IN PIPELINE RGB */
+
+    switch(kind)
+    {
+      case DT_ADAPTATION_FULL_BRADFORD:
+      {
+        /* Convert from RGB to XYZ */
+        dt_apply_transposed_color_matrix(temp_two, RGB_to_XYZ_trans, temp_one);
+        const float Y = temp_one[1];
+
+        /* Convert to LMS */
+        convert_XYZ_to_bradford_LMS(temp_one, temp_two);
+        /* Do white balance */
+        downscale_vector(temp_two, Y);
+        bradford_adapt_D65(temp_two, d->illuminant, p, TRUE, temp_one);
+        upscale_vector(temp_one, Y);
+        copy_pixel(temp_two, temp_one);
+        break;
+      }
+      case DT_ADAPTATION_LINEAR_BRADFORD:
+      {
+        /* Convert from RGB to XYZ to LMS */
+        dt_apply_transposed_color_matrix(temp_two, RGB_to_LMS_trans, temp_one);
+
+        /* Do white balance */
+        bradford_adapt_D65(temp_one, d->illuminant, p, FALSE, temp_two);
+        break;
+      }
+      case DT_ADAPTATION_CAT16:
+      {
+        /* Convert from RGB to LMS */
+        dt_apply_transposed_color_matrix(temp_two, RGB_to_LMS_trans, temp_one);
+
+        /* Do white balance, force full adaptation */
+        CAT16_adapt_D65(temp_one, d->illuminant, 1.0f, TRUE, temp_two);
+        break;
+      }
+      case DT_ADAPTATION_XYZ:
+      {
+        /* Convert from RGB to XYZ */
+        dt_apply_transposed_color_matrix(temp_two, RGB_to_XYZ_trans, temp_one);
+
+        /* Do white balance in XYZ */
+        XYZ_adapt_D65(temp_one, d->illuminant, temp_two);
+        break;
+      }
+      case DT_ADAPTATION_RGB:
+      case DT_ADAPTATION_LAST:
+      default:
+      {
+        /* No white balance. */
+        for_four_channels(c)
+          temp_one[c] = 0.0f;
+      }
+    }
+
+    /* Compute the 3D mix - this is a rotation + homothety of the vector base */
+    dt_apply_transposed_color_matrix(temp_two, MIX_to_XYZ_trans, temp_one);
+
+    /* FROM HERE WE ARE MANDATORILY IN XYZ - DATA IS IN temp_one */
+
+    /* Gamut mapping happens in XYZ space no matter what */
+    if(clip)
+      _vector_clipneg_nan(temp_one);
+    _gamut_mapping(temp_one, gamut, clip, temp_two);
+
+    /* convert to LMS, XYZ or pipeline RGB */
+    switch(kind)
+    {
+      case DT_ADAPTATION_FULL_BRADFORD:
+      case DT_ADAPTATION_LINEAR_BRADFORD:
+      case DT_ADAPTATION_CAT16:
+      case DT_ADAPTATION_XYZ:
+        convert_any_XYZ_to_LMS(temp_two, temp_one, kind);
+        break;
+      case DT_ADAPTATION_RGB:
+      case DT_ADAPTATION_LAST:
+      default:
+        dt_apply_transposed_color_matrix(temp_two, XYZ_to_RGB_trans, temp_one);
+        break;
+    }
+
+    /* FROM HERE WE ARE IN LMS, XYZ OR PIPELINE RGB depending on user
+       param - DATA IS IN temp_one */
+
+    if(clip)
+      _vector_clipneg_nan(temp_one);
+
+    /* Apply lightness / saturation adjustment */
+    _luma_chroma(temp_one, d->saturation, d->lightness, temp_two, version);
+
+    if(clip)
+      _vector_clipneg_nan(temp_two);
+
+    if(apply_grey)
+    {
+      /* Turn LMS, XYZ or pipeline RGB into monochrome */
+      const float grey_mix = fmaxf(scalar_product(temp_two, d->grey), 0.0f);
+      temp_two[0] = temp_two[1] = temp_two[2] = grey_mix;
+    }
+    else
+    {
+      /* Convert back to XYZ */
+      switch(kind)
+      {
+        case DT_ADAPTATION_FULL_BRADFORD:
+        case DT_ADAPTATION_LINEAR_BRADFORD:
+        case DT_ADAPTATION_CAT16:
+        case DT_ADAPTATION_XYZ:
+          convert_any_LMS_to_XYZ(temp_two, temp_one, kind);
+          break;
+        case DT_ADAPTATION_RGB:
+        case DT_ADAPTATION_LAST:
+        default:
+          dt_apply_transposed_color_matrix(temp_two, RGB_to_XYZ_trans, temp_one);
+          break;
+      }
+
+      /* FROM HERE WE ARE MANDATORILY IN XYZ - DATA IS IN temp_one */
+
+      if(clip)
+        _vector_clipneg_nan(temp_one);
+
+      /* Convert back to RGB */
+      dt_apply_transposed_color_matrix(temp_one, XYZ_to_RGB_trans, temp_two);
+
+      if(clip)
+        _vector_clipneg_nan(temp_two);
+    }
+
+    temp_two[3] = in[k + 3]; /* alpha mask */
+    copy_pixel_nontemporal(&out[k], temp_two);
+  }
+  dt_omploop_sfence();
+}
+
+/* Linear case: one 3x3 matrix per pixel. */
+static void _process_matrix(const float *const restrict in,
+                            float *const restrict out,
+                            const size_t npixels,
+                            const dt_colormatrix_t matrix_transposed)
+{
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    dt_aligned_pixel_t pix;
+    dt_apply_transposed_color_matrix(in + k, matrix_transposed, pix);
+    pix[3] = in[k + 3];
+    copy_pixel_nontemporal(out + k, pix);
+  }
+  dt_omploop_sfence();
+}
+
+/* ── process() ──────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_channelmixer_rgb_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+  if(d->is_matrix)
+  {
+    _process_matrix(in, out, npixels, d->matrix_transposed);
+    return;
+  }
+
+  /* force loop unswitching in a controlled way */
+  switch(d->adaptation)
+  {
+    case DT_ADAPTATION_FULL_BRADFORD:
+      _loop_switch(in, out, npixels, d, DT_ADAPTATION_FULL_BRADFORD);
+      break;
+    case DT_ADAPTATION_LINEAR_BRADFORD:
+      _loop_switch(in, out, npixels, d, DT_ADAPTATION_LINEAR_BRADFORD);
+      break;
+    case DT_ADAPTATION_CAT16:
+      _loop_switch(in, out, npixels, d, DT_ADAPTATION_CAT16);
+      break;
+    case DT_ADAPTATION_XYZ:
+      _loop_switch(in, out, npixels, d, DT_ADAPTATION_XYZ);
+      break;
+    case DT_ADAPTATION_RGB:
+    case DT_ADAPTATION_LAST:
+    default:
+      _loop_switch(in, out, npixels, d, DT_ADAPTATION_RGB);
+      break;
+  }
+}
+
+/* ── Linear folding ──────────────────────────────────────────────────────── */
+
+/*
+ * The module is linear when nothing in _loop_switch() depends on the pixel
+ * but the matrices: gamut compression off, no clipping, zero saturation and
+ * lightness, no grey mix, and a linear adaptation.  _gamut_mapping() with
+ * compression 0 is then the identity for every XYZ inside the spectral
+ * locus, and _luma_chroma() with zero coefficients is the identity, so the
+ * chain collapses to
+ *
+ *   XYZ_to_RGB . LMS_to_XYZ . MIX . diag(white / illuminant) . RGB_to_LMS
+ *
+ * Non-physical XYZ (negative sum, or x + y >= 1) pass through the matrix
+ * unchanged instead of being folded back onto the locus.
+ */
+static gboolean _is_linear(const dt_iop_channelmixer_rgb_data_t *const d)
+{
+  if(d->gamut != 0.f || d->clip || d->apply_grey) return FALSE;
+  if(d->adaptation == DT_ADAPTATION_FULL_BRADFORD) return FALSE;
+  for(int c = 0; c < 3; c++)
+    if(d->saturation[c] != 0.f || d->lightness[c] != 0.f) return FALSE;
+  return TRUE;
+}
+
+static void _build_matrix(dt_iop_channelmixer_rgb_data_t *const d)
+{
+  dt_colormatrix_t RGB_to_LMS, LMS_to_XYZ, adapt, tmp, tmp2;
+  dt_colormatrix_identity(adapt);
+
+  switch(d->adaptation)
+  {
+    case DT_ADAPTATION_LINEAR_BRADFORD:
+      make_RGB_to_Bradford_LMS(d->RGB_to_XYZ, RGB_to_LMS);
+      memcpy(LMS_to_XYZ, Bradford_LMS_to_XYZ, sizeof(dt_colormatrix_t));
+      for(int c = 0; c < 3; c++) adapt[c][c] = Bradford_LMS_D65[c] / d->illuminant[c];
+      break;
+    case DT_ADAPTATION_CAT16:
+      make_RGB_to_CAT16_LMS(d->RGB_to_XYZ, RGB_to_LMS);
+      memcpy(LMS_to_XYZ, CAT16_LMS_to_XYZ, sizeof(dt_colormatrix_t));
+      for(int c = 0; c < 3; c++) adapt[c][c] = CAT16_LMS_D65[c] / d->illuminant[c];
+      break;
+    case DT_ADAPTATION_XYZ:
+      memcpy(RGB_to_LMS, d->RGB_to_XYZ, sizeof(dt_colormatrix_t));
+      dt_colormatrix_identity(LMS_to_XYZ);
+      for(int c = 0; c < 3; c++) adapt[c][c] = XYZ_D65[c] / d->illuminant[c];
+      break;
+    case DT_ADAPTATION_RGB:
+    case DT_ADAPTATION_LAST:
+    default:
+      /* mix straight in pipeline RGB */
+      dt_colormatrix_identity(RGB_to_LMS);
+      dt_colormatrix_mul(LMS_to_XYZ, d->RGB_to_XYZ, d->MIX);
+      dt_colormatrix_mul(d->matrix, d->XYZ_to_RGB, LMS_to_XYZ);
+      dt_colormatrix_transpose(d->matrix_transposed, d->matrix);
+      return;
+  }
+
+  dt_colormatrix_mul(tmp, adapt, RGB_to_LMS);
+  dt_colormatrix_mul(tmp2, d->MIX, tmp);
+  dt_colormatrix_mul(tmp, LMS_to_XYZ, tmp2);
+  dt_colormatrix_mul(d->matrix, d->XYZ_to_RGB, tmp);
+  dt_colormatrix_transpose(d->matrix_transposed, d->matrix);
+}
+
+/* Pipe hook: the module as a single RGB matrix, when it is one. */
+static bool color_matrix(dt_iop_module_t *self,
+                         dt_dev_pixelpipe_iop_t *piece,
+                         dt_colormatrix_t M)
+{
+  const dt_iop_channelmixer_rgb_data_t *const d = piece->data;
+  if(!d || !d->is_matrix) return false;
+  memcpy(M, d->matrix, sizeof(dt_colormatrix_t));
+  return true;
+}
+
+/* ── commit_params() ────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_channelmixer_rgb_params_t *p = (const dt_iop_channelmixer_rgb_params_t *)p1;
+  dt_iop_channelmixer_rgb_data_t *d = piece->data;
+
+  d->version = (dt_iop_channelmixer_rgb_version_t)p->version;
+
+  float norm_R = 1.0f;
+  if(p->normalize_R)
+    norm_R = p->red[0] + p->red[1] + p->red[2];
+
+  float norm_G = 1.0f;
+  if(p->normalize_G)
+    norm_G = p->green[0] + p->green[1] + p->green[2];
+
+  float norm_B = 1.0f;
+  if(p->normalize_B)
+    norm_B = p->blue[0] + p->blue[1] + p->blue[2];
+
+  float norm_sat = 0.0f;
+  if(p->normalize_sat)
+    norm_sat = (p->saturation[0] + p->saturation[1] + p->saturation[2]) / 3.f;
+
+  float norm_light = 0.0f;
+  if(p->normalize_light)
+    norm_light = (p->lightness[0] + p->lightness[1] + p->lightness[2]) / 3.f;
+
+  float norm_grey = p->grey[0] + p->grey[1] + p->grey[2];
+  d->apply_grey = (p->grey[0] != 0.f) || (p->grey[1] != 0.f) || (p->grey[2] != 0.f);
+  if(!p->normalize_grey || norm_grey == 0.f)
+    norm_grey = 1.f;
+
+  memset(d->MIX, 0, sizeof(d->MIX));
+  for(int i = 0; i < 3; i++)
+  {
+    d->MIX[0][i] = p->red[i] / norm_R;
+    d->MIX[1][i] = p->green[i] / norm_G;
+    d->MIX[2][i] = p->blue[i] / norm_B;
+    d->saturation[i] = -p->saturation[i] + norm_sat;
+    d->lightness[i] = p->lightness[i] - norm_light;
+    /* = NaN if(norm_grey == 0.f) but we don't care since apply_grey == FALSE */
+    d->grey[i] = p->grey[i] / norm_grey;
+  }
+
+  if(p->version == CHANNELMIXERRGB_V_1)
+  {
+    /* for the v1 saturation algo, the effect of R and B coeffs is reversed */
+    d->saturation[0] = -p->saturation[2] + norm_sat;
+    d->saturation[2] = -p->saturation[0] + norm_sat;
+  }
+
+  d->saturation[CHANNEL_SIZE - 1] = 0.0f;
+  d->lightness[CHANNEL_SIZE - 1] = 0.0f;
+  d->grey[CHANNEL_SIZE - 1] = 0.0f;
+
+  d->adaptation = (dt_adaptation_t)p->adaptation;
+  d->clip = p->clip;
+  d->gamut = (p->gamut == 0.f) ? p->gamut : 1.f / p->gamut;
+
+  /* find x y coordinates of illuminant for CIE 1931 2° observer */
+  float x = p->x;
+  float y = p->y;
+  illuminant_to_xy((dt_illuminant_t)p->illuminant, &pipe->image, &x, &y, p->temperature,
+                   (dt_illuminant_fluo_t)p->illum_fluo, (dt_illuminant_led_t)p->illum_led);
+  d->illuminant_type = (dt_illuminant_t)p->illuminant;
+
+  /* Convert illuminant from xyY to XYZ, then to the adaptation LMS */
+  dt_aligned_pixel_t XYZ;
+  illuminant_xy_to_XYZ(x, y, XYZ);
+  convert_any_XYZ_to_LMS(XYZ, d->illuminant, d->adaptation);
+  d->illuminant[3] = 0.f;
+
+  /* blue compensation for Bradford transform = (test illuminant blue /
+     reference illuminant blue)^0.0834, the reference being the D65 pipe */
+  d->p = powf(Bradford_LMS_D65[2] / d->illuminant[2], 0.0834f);
+
+  dt_colorspaces_rgb_space_t space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &space);
+  memcpy(d->RGB_to_XYZ, space.matrix_in, sizeof(dt_colormatrix_t));
+  memcpy(d->XYZ_to_RGB, space.matrix_out, sizeof(dt_colormatrix_t));
+
+  d->is_matrix = _is_linear(d);
+  if(d->is_matrix)
+    _build_matrix(d);
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_channelmixer_rgb_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_channelmixer_rgb_params_t *d = self->default_params;
+  if(!d) return;
+
+  memset(d, 0, sizeof(*d));
+  d->red[0] = d->green[1] = d->blue[2] = 1.0f;
+  d->illuminant  = DT_ILLUMINANT_D;
+  d->illum_fluo  = DT_ILLUMINANT_FLUO_F3;
+  d->illum_led   = DT_ILLUMINANT_LED_B5;
+  d->adaptation  = DT_ADAPTATION_CAT16;
+  d->x           = 0.333f;
+  d->y           = 0.333f;
+  d->temperature = 5003.0f;
+  d->gamut       = 1.0f;
+  d->clip        = TRUE;
+  d->version     = CHANNELMIXERRGB_V_3;
+
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_channelmixerrgb_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->color_matrix       = color_matrix;
+}
@@ -0,0 +1,216 @@
+/*
+ * colorin.c - darktable input color profile IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/colorin.c (GPLv3).
+ * GUI code, OpenCL, presets and legacy_params() removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - Matrix profiles only: there is no lcms2, so ICC files, embedded ICC
+ *     profiles, Lab output and the gamut clipping (normalize) options are
+ *     not supported.  Every raw is converted with its standard matrix
+ *     (DNG D65 matrix when present, else adobe_XYZ_to_CAM) straight into
+ *     linear Rec.709, the pipeline RGB (common/colorspaces.h).  The work
+ *     profile selection is ignored.
+ *   - The camera matrix is normalised the dcraw way, so white-balanced
+ *     camera white maps to RGB (1, 1, 1).
+ *   - Non-raw, monochrome and matrix-less images pass through unchanged.
+ *   - color_matrix() exposes the camera matrix to the pipe so the following
+ *     linear RGB stages (e.g. color calibration) are fused into it.
+ *
+ * Struct layout of dt_iop_colorin_params_t MUST match the descriptor table
+ * in libdtpipe/src/pipe/params.c (_colorin_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2009-2025 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+/*
+ * IMPORTANT: field order and types must exactly match _colorin_params_t in
+ * pipe/params.c so that memcpy-based history load/save works correctly.
+ */
+typedef struct dt_iop_colorin_params_t
+{
+  int32_t type;               /* dt_colorspaces_color_profile_type_t      */
+  char    filename[512];      /* ICC filename (unused)                    */
+  int32_t intent;             /* dt_iop_color_intent_t (unused)           */
+  int32_t normalize;          /* gamut clipping method (unused)           */
+  int32_t blue_mapping;       /* legacy blue mapping (unused)             */
+  int32_t type_work;          /* working profile type (unused)            */
+  char    filename_work[512]; /* working profile filename (unused)        */
+} dt_iop_colorin_params_t;
+
+typedef struct dt_iop_colorin_data_t
+{
+  dt_colormatrix_t cmatrix;            /* camera RGB -> pipeline RGB */
+  dt_colormatrix_t cmatrix_transposed;
+} dt_iop_colorin_data_t;
+
+/* ── Camera matrix ───────────────────────────────────────────────────────── */
+
+/*
+ * camera RGB -> pipeline RGB, from the XYZ -> camera matrix.  Returns FALSE
+ * (identity) when the image has no usable matrix.
+ */
+static gboolean _camera_matrix(const dt_image_t *img,
+                               const dt_colormatrix_t RGB_to_XYZ,
+                               dt_colormatrix_t cam_to_rgb)
+{
+  dt_colormatrix_identity(cam_to_rgb);
+
+  if(!dt_image_is_raw(img) || dt_image_is_monochrome(img)) return FALSE;
+
+  dt_colormatrix_t XYZ_to_CAM = { { 0.f } };
+  const int embedded = dt_is_valid_colormatrix(img->d65_color_matrix[0]) && img->d65_color_matrix[0] != 0.f;
+  for(int k = 0; k < 3; k++)
+    for(int i = 0; i < 3; i++)
+    {
+      XYZ_to_CAM[k][i] = embedded ? img->d65_color_matrix[3 * k + i] : img->adobe_XYZ_to_CAM[k][i];
+      if(!dt_is_valid_colormatrix(XYZ_to_CAM[k][i])) return FALSE;
+    }
+
+  /* pipeline RGB -> camera, rows normalised so RGB white hits camera white */
+  dt_colormatrix_t RGB_to_CAM;
+  dt_colormatrix_mul(RGB_to_CAM, XYZ_to_CAM, RGB_to_XYZ);
+  for(int k = 0; k < 3; k++)
+  {
+    const float sum = RGB_to_CAM[k][0] + RGB_to_CAM[k][1] + RGB_to_CAM[k][2];
+    if(!(fabsf(sum) > 1e-6f)) return FALSE;
+    for(int i = 0; i < 3; i++) RGB_to_CAM[k][i] /= sum;
+  }
+
+  dt_colormatrix_t inverse;
+  if(mat3SSEinv(inverse, RGB_to_CAM)) return FALSE;
+
+  memcpy(cam_to_rgb, inverse, sizeof(dt_colormatrix_t));
+  return TRUE;
+}
+
+/* ── process() ──────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_colorin_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    dt_aligned_pixel_t pix;
+    dt_apply_transposed_color_matrix(in + k, d->cmatrix_transposed, pix);
+    pix[3] = in[k + 3];
+    copy_pixel_nontemporal(out + k, pix);
+  }
+  dt_omploop_sfence();
+}
+
+/* Pipe hook: colorin is always a single RGB matrix. */
+static bool color_matrix(dt_iop_module_t *self,
+                         dt_dev_pixelpipe_iop_t *piece,
+                         dt_colormatrix_t M)
+{
+  const dt_iop_colorin_data_t *const d = piece->data;
+  if(!d) return false;
+  memcpy(M, d->cmatrix, sizeof(dt_colormatrix_t));
+  return true;
+}
+
+/* ── commit_params() ────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_colorin_data_t *d = piece->data;
+
+  dt_colorspaces_rgb_space_t space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &space);
+
+  _camera_matrix(&pipe->image, space.matrix_in, d->cmatrix);
+  dt_colormatrix_transpose(d->cmatrix_transposed, d->cmatrix);
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_colorin_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_colorin_params_t *d = self->default_params;
+  if(!d) return;
+
+  /* the params buffer only spans the fields described in params.c (up to
+     type_work), so never touch filename_work here */
+  const size_t size = (size_t)self->params_size;
+  memset(d, 0, size);
+  d->type      = DT_COLORSPACE_STANDARD_MATRIX;
+  d->intent    = DT_INTENT_PERCEPTUAL;
+  d->type_work = DT_COLORSPACE_LIN_REC709;
+
+  memcpy(self->params, d, size);
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_colorin_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->color_matrix       = color_matrix;
+}
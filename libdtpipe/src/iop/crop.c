@@ -0,0 +1,236 @@
+/*
+ * crop.c - darktable crop IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/crop.c
+ * Copyright (C) 2021-2024 darktable developers.
+ * GUI code (including the aspect-ratio handling of ratio_n / ratio_d, which
+ * only steers the on-canvas editor), OpenCL paths, distort_mask and
+ * legacy_params removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - crop is a pure ROI change.  modify_roi_in() shifts the window by the
+ *     crop offset at the current scale (rounded, not truncated) and keeps
+ *     its size, and the point maps are the matching translation, so the
+ *     pipe recognises the piece as an identity on pixels and hands the
+ *     input buffer on without calling process() or copying.  Next to other
+ *     geometric modules the offset is folded into their single warp.
+ *   - process() is only reached when the window had to be clamped to the
+ *     image; it copies rows with the offset, as darktable does.
+ *
+ * Struct layout MUST match _crop_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in any colorspace (pure ROI change).
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter / data structs ────────────────────────────────────────────── */
+
+typedef struct dt_iop_crop_params_t
+{
+  float cx;    /* $MIN: 0.0 $MAX: 1.0 $DESCRIPTION: "left" */
+  float cy;    /* $MIN: 0.0 $MAX: 1.0 $DESCRIPTION: "top" */
+  float cw;    /* $MIN: 0.0 $MAX: 1.0 $DESCRIPTION: "right" */
+  float ch;    /* $MIN: 0.0 $MAX: 1.0 $DESCRIPTION: "bottom" */
+  int ratio_n; /* $DEFAULT: -1 */
+  int ratio_d; /* $DEFAULT: -1 */
+} dt_iop_crop_params_t;
+
+typedef struct dt_iop_crop_data_t
+{
+  float cx, cy, cw, ch; /* crop box as fractions; cw / ch are the right and bottom edges */
+} dt_iop_crop_data_t;
+
+/* Full-size crop offset in pixels of the piece input. */
+static inline void _crop_offset(const dt_dev_pixelpipe_iop_t *piece, float *dx, float *dy)
+{
+  const dt_iop_crop_data_t *d = piece->data;
+  *dx = floorf(piece->buf_in.width * d->cx);
+  *dy = floorf(piece->buf_in.height * d->cy);
+}
+
+/* ── Point maps ──────────────────────────────────────────────────────────── */
+
+static bool distort_transform(dt_iop_module_t *self,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              float *const points,
+                              const size_t points_count)
+{
+  float dx, dy;
+  _crop_offset(piece, &dx, &dy);
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    points[i]     -= dx;
+    points[i + 1] -= dy;
+  }
+  return true;
+}
+
+static bool distort_backtransform(dt_iop_module_t *self,
+                                  dt_dev_pixelpipe_iop_t *piece,
+                                  float *const points,
+                                  const size_t points_count)
+{
+  float dx, dy;
+  _crop_offset(piece, &dx, &dy);
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    points[i]     += dx;
+    points[i + 1] += dy;
+  }
+  return true;
+}
+
+/* ── modify_roi_out() / modify_roi_in() ──────────────────────────────────── */
+
+static void modify_roi_out(dt_iop_module_t *self,
+                           dt_dev_pixelpipe_iop_t *piece,
+                           dt_iop_roi_t *roi_out,
+                           const dt_iop_roi_t *const roi_in)
+{
+  const dt_iop_crop_data_t *d = piece->data;
+  *roi_out = *roi_in;
+
+  const float odx = floorf(roi_in->width * d->cx);
+  const float ody = floorf(roi_in->height * d->cy);
+  const float odw = floorf(roi_in->width * (d->cw - d->cx));
+  const float odh = floorf(roi_in->height * (d->ch - d->cy));
+
+  // the box is always within the image
+  roi_out->width = MAX(5, MIN(odw, roi_in->width - odx));
+  roi_out->height = MAX(5, MIN(odh, roi_in->height - ody));
+}
+
+static void modify_roi_in(dt_iop_module_t *self,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_roi_t *roi_in)
+{
+  *roi_in = *roi_out;
+
+  float dx, dy;
+  _crop_offset(piece, &dx, &dy);
+
+  const float iw = piece->buf_in.width * roi_out->scale;
+  const float ih = piece->buf_in.height * roi_out->scale;
+
+  roi_in->x = roi_out->x + (int)roundf(dx * roi_out->scale);
+  roi_in->y = roi_out->y + (int)roundf(dy * roi_out->scale);
+
+  // sanity check: never ask for more than the input has
+  roi_in->x = CLAMP(roi_in->x, 0, MAX(0, (int)floorf(iw) - 1));
+  roi_in->y = CLAMP(roi_in->y, 0, MAX(0, (int)floorf(ih) - 1));
+  roi_in->width = CLAMP(roi_in->width, 1, (int)ceilf(iw) - roi_in->x);
+  roi_in->height = CLAMP(roi_in->height, 1, (int)ceilf(ih) - roi_in->y);
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const int ch = piece->colors;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+
+  // roi_in starts at the cropped origin; it is only smaller than roi_out
+  // where it was clamped to the image
+  const int width = MIN(roi_in->width, roi_out->width);
+  const int height = MIN(roi_in->height, roi_out->height);
+
+  DT_OMP_FOR()
+  for(int y = 0; y < roi_out->height; y++)
+  {
+    float *const orow = out + (size_t)ch * roi_out->width * y;
+    if(y < height)
+    {
+      memcpy(orow, in + (size_t)ch * roi_in->width * y, sizeof(float) * ch * width);
+      if(width < roi_out->width)
+        memset(orow + (size_t)ch * width, 0, sizeof(float) * ch * (roi_out->width - width));
+    }
+    else
+      memset(orow, 0, sizeof(float) * ch * roi_out->width);
+  }
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_crop_params_t *p = (const dt_iop_crop_params_t *)p1;
+  dt_iop_crop_data_t *d = piece->data;
+
+  d->cx = CLAMPF(p->cx, 0.0f, 0.9f);
+  d->cy = CLAMPF(p->cy, 0.0f, 0.9f);
+  d->cw = CLAMPF(p->cw, 0.1f, 1.0f);
+  d->ch = CLAMPF(p->ch, 0.1f, 1.0f);
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_crop_data_t));
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_crop_params_t *d = self->default_params;
+  if(!d) return;
+  d->cx = 0.0f;
+  d->cy = 0.0f;
+  d->cw = 1.0f;
+  d->ch = 1.0f;
+  d->ratio_n = -1;
+  d->ratio_d = -1;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+static int operation_tags(void)
+{
+  return IOP_TAG_DISTORT;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_crop_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain          = process;
+  so->init                   = init;
+  so->init_pipe              = init_pipe;
+  so->cleanup_pipe           = cleanup_pipe;
+  so->commit_params          = commit_params;
+  so->operation_tags         = operation_tags;
+  so->modify_roi_in          = modify_roi_in;
+  so->modify_roi_out         = modify_roi_out;
+  so->distort_transform      = distort_transform;
+  so->distort_backtransform  = distort_backtransform;
+}
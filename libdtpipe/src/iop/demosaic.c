@@ -168,6 +168,42 @@ static gboolean _demosaic_full(const dt_iop_roi_t *const roi_out)
   return roi_out->scale > 0.5f;
 }
 
+/*
+ * Half-size Bayer averaging for the preview path.  At exactly 0.5 each 2×2
+ * quad maps straight to one output pixel.  Below 0.5 the quads are first
+ * averaged into a half-resolution buffer covering the whole input window,
+ * which is then resampled to roi_out with the plan-cached resampler.
+ */
+static void _demosaic_half_size(float *const out,
+                                const float *const in,
+                                const dt_iop_roi_t *const roi_out,
+                                const dt_iop_roi_t *const roi_in,
+                                const uint32_t filters)
+{
+  const dt_iop_roi_t half = { roi_in->x / 2, roi_in->y / 2,
+                              MAX(1, roi_in->width / 2), MAX(1, roi_in->height / 2),
+                              0.5f };
+  float *tmp = roi_out->scale < 0.5f
+    ? dt_alloc_align_float((size_t)4 * half.width * half.height)
+    : NULL;
+
+  if(!tmp)
+  {
+    dt_iop_clip_and_zoom_demosaic_half_size_f(out, in, roi_out, roi_in,
+                                              roi_out->width, roi_in->width, filters);
+    return;
+  }
+
+  dt_iop_clip_and_zoom_demosaic_half_size_f(tmp, in, &half, roi_in,
+                                            half.width, roi_in->width, filters);
+
+  /* resample_roi takes roi_out->scale as the out/in ratio */
+  dt_iop_roi_t zoom_out = *roi_out;
+  zoom_out.scale = roi_out->scale / half.scale;
+  dt_iop_clip_and_zoom_roi(out, tmp, &zoom_out, &half);
+  dt_free_align(tmp);
+}
+
 static void modify_roi_in(dt_iop_module_t *self,
                           dt_dev_pixelpipe_iop_t *piece,
                           const dt_iop_roi_t *roi_out,
@@ -284,8 +320,7 @@ static void process(dt_iop_module_t *self,
       passthrough_color((float *)o, (const float *)i, roi_out->width, roi_out->height, filters,
                         (const uint8_t (*)[6])xtrans);
     else if(!is_xtrans)
-      dt_iop_clip_and_zoom_demosaic_half_size_f(
-          (float *)o, (const float *)i, roi_out, roi_in, roi_out->width, width, filters);
+      _demosaic_half_size((float *)o, (const float *)i, roi_out, roi_in, filters);
     else
       dt_iop_clip_and_zoom_demosaic_passthrough_monochrome_f(
           (float *)o, (const float *)i, roi_out, roi_in, roi_out->width, width);
@@ -0,0 +1,1335 @@
+/*
+ * denoiseprofile.c - darktable profiled denoise IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/denoiseprofile.c
+ * Copyright (C) 2013-2025 darktable developers.
+ * GUI code, OpenCL paths, presets, legacy_params and the PFM debug dumps
+ * removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - the noise profile comes from common/noiseprofiles.c, matched against
+ *     pipe->image in commit_params() (darktable does it in reload_defaults);
+ *     the default params carry a[0] = -1 so every image is autodetected,
+ *     and radius / scattering / shadows / bias left at their defaults are
+ *     re-inferred from the detected profile, as reload_defaults would
+ *   - the per-band force curves (x/y) are evaluated with a local
+ *     Catmull-Rom spline instead of dt_draw_curve_t
+ *   - "compute variance" mode passes the image through (its only output is
+ *     the GUI readout)
+ *   - late scaling does not exist here, so full pipes always use the
+ *     scale-adjusted search radius
+ *
+ * Reduced-cost preview: when the pipe is not an export and renders below
+ * DT_IOP_DENOISE_PROFILE_PREVIEW_SCALE (and for PREVIEW / FAST / THUMBNAIL
+ * pipes), the wavelet path only thresholds the finest
+ * DT_IOP_DENOISE_PROFILE_PREVIEW_BANDS scales, keeping their band mapping,
+ * and non-local means searches half the patches.  Exports and full-size
+ * renders run the unchanged algorithm.
+ *
+ * The non-local means slices are sized from the host cache sizes, see
+ * common/nlmeans_core.h.
+ *
+ * Struct layout MUST match _denoiseprofile_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in IOP_CS_RGB.
+ */
+
+#include "dtpipe_internal.h"
+#include "common/eaw.h"
+#include "common/nlmeans_core.h"
+#include "common/noiseprofiles.h"
+#include "common/colorspaces.h"
+#include "iop/iop_math.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_IOP_DENOISE_PROFILE_BANDS 7
+
+// the following fulcrum is used to help user to set shadows and
+// strength parameters.  applying precondition on this value will give
+// the same value even if shadows slider is changed, as strength will
+// be adjusted to guarantee that.  from a user point of view, it
+// separates "shadows" area from the rest of the image.
+#define DT_IOP_DENOISE_PROFILE_P_FULCRUM 0.05f
+
+// reduced-cost preview: below this output scale, non-export pipes only
+// threshold the finest few wavelet scales
+#define DT_IOP_DENOISE_PROFILE_PREVIEW_SCALE 0.5f
+#define DT_IOP_DENOISE_PROFILE_PREVIEW_BANDS 3
+
+/* ── Parameter structs (must match params.c descriptor layout) ───────────── */
+
+typedef enum dt_iop_denoiseprofile_mode_t
+{
+  MODE_NLMEANS = 0,       // $DESCRIPTION: "non-local means"
+  MODE_NLMEANS_AUTO = 3,  // $DESCRIPTION: "non-local means auto"
+  MODE_WAVELETS = 1,      // $DESCRIPTION: "wavelets"
+  MODE_WAVELETS_AUTO = 4, // $DESCRIPTION: "wavelets auto"
+  MODE_VARIANCE = 2,      // $DESCRIPTION: "compute variance"
+} dt_iop_denoiseprofile_mode_t;
+
+typedef enum dt_iop_denoiseprofile_wavelet_mode_t
+{
+  MODE_RGB = 0,    // $DESCRIPTION: "RGB"
+  MODE_Y0U0V0 = 1  // $DESCRIPTION: "Y0U0V0"
+} dt_iop_denoiseprofile_wavelet_mode_t;
+
+typedef enum dt_iop_denoiseprofile_channel_t
+{
+  DT_DENOISE_PROFILE_ALL = 0,
+  DT_DENOISE_PROFILE_R = 1,
+  DT_DENOISE_PROFILE_G = 2,
+  DT_DENOISE_PROFILE_B = 3,
+  DT_DENOISE_PROFILE_Y0 = 4,
+  DT_DENOISE_PROFILE_U0V0 = 5,
+  DT_DENOISE_PROFILE_NONE = 6
+} dt_iop_denoiseprofile_channel_t;
+
+typedef struct dt_iop_denoiseprofile_params_t
+{
+  float radius;     /* patch size
+                       $MIN: 0.0 $MAX: 12.0 $DEFAULT: 1.0 $DESCRIPTION: "patch size" */
+  float nbhood;     /* search radius
+                       $MIN: 1.0 $MAX: 30.0 $DEFAULT: 7.0 $DESCRIPTION: "search radius" */
+  float strength;   /* noise level after equalization
+                       $MIN: 0.001 $MAX: 1000.0 $DEFAULT: 1.0 */
+  float shadows;    /* control the impact on shadows
+                       $MIN: 0.0 $MAX: 1.8 $DEFAULT: 1.0 $DESCRIPTION: "preserve shadows" */
+  float bias;       /* allows to reduce backtransform bias
+                       $MIN: -1000.0 $MAX: 100.0 $DEFAULT: 0.0 $DESCRIPTION: "bias correction" */
+  float scattering; /* spread the patch search zone without increasing number of patches
+                       $MIN: 0.0 $MAX: 20.0 $DEFAULT: 0.0 $DESCRIPTION: "scattering" */
+  float central_pixel_weight; /* increase central pixel's weight in patch comparison
+                       $MIN: 0.0 $MAX: 10.0 $DEFAULT: 0.1 $DESCRIPTION: "central pixel weight" */
+  float overshooting; /* adjusts the way parameters are autoset
+                         $MIN: 0.001 $MAX: 1000.0 $DEFAULT: 1.0 $DESCRIPTION: "adjust autoset parameters" */
+  float a[3], b[3]; // fit for poissonian-gaussian noise per color channel.
+  dt_iop_denoiseprofile_mode_t mode; /* switch between nlmeans and wavelets
+                                        $DEFAULT: MODE_WAVELETS */
+  float x[DT_DENOISE_PROFILE_NONE][DT_IOP_DENOISE_PROFILE_BANDS];
+  float y[DT_DENOISE_PROFILE_NONE][DT_IOP_DENOISE_PROFILE_BANDS]; /* values to change wavelet force by frequency
+                                                                     $DEFAULT: 0.5 */
+  gboolean wb_adaptive_anscombe; // $DEFAULT: TRUE $DESCRIPTION: "whitebalance-adaptive transform" whether to adapt anscombe transform to wb coeffs
+  gboolean fix_anscombe_and_nlmeans_norm; // $DEFAULT: TRUE $DESCRIPTION: "fix various bugs in algorithm" backward compatibility options
+  gboolean use_new_vst; // $DEFAULT: TRUE $DESCRIPTION: "upgrade profiled transform" backward compatibility options
+  dt_iop_denoiseprofile_wavelet_mode_t wavelet_color_mode; /* switch between RGB and Y0U0V0 modes.
+                                                              $DEFAULT: MODE_Y0U0V0 $DESCRIPTION: "color mode"*/
+  gboolean compensate_hilite_pres; // $DEFAULT: TRUE $DESCRIPTION: "compensate highlight preservation"
+} dt_iop_denoiseprofile_params_t;
+
+typedef struct dt_iop_denoiseprofile_data_t
+{
+  float radius;                      // patch radius
+  float nbhood;                      // search radius
+  float strength;                    // noise level after equalization
+  float shadows;                     // controls noise reduction in shadows
+  float bias;                        // controls bias in backtransform
+  float scattering;                  // spread the search zone without changing number of patches
+  float central_pixel_weight;        // increase central pixel's weight in patch comparison
+  float overshooting;                // adjusts the way parameters are autoset
+  float a[3], b[3];                  // fit for poissonian-gaussian noise per color channel.
+  dt_iop_denoiseprofile_mode_t mode; // switch between nlmeans and wavelets
+  float force[DT_DENOISE_PROFILE_NONE][DT_IOP_DENOISE_PROFILE_BANDS];
+  gboolean wb_adaptive_anscombe;          // whether to adapt anscombe transform to wb coeffs
+  gboolean fix_anscombe_and_nlmeans_norm; // backward compatibility options
+  gboolean use_new_vst;                   // backward compatibility options
+  dt_iop_denoiseprofile_wavelet_mode_t wavelet_color_mode; // switch between RGB and Y0U0V0 modes.
+} dt_iop_denoiseprofile_data_t;
+
+/* ── Variance stabilizing transforms ─────────────────────────────────────── */
+
+static inline void precondition(const float *const in,
+                                float *const buf,
+                                const int wd,
+                                const int ht,
+                                const dt_aligned_pixel_t a,
+                                const dt_aligned_pixel_t b)
+{
+  const dt_aligned_pixel_t sigma2_plus_3_8
+      = { (b[0] / a[0]) * (b[0] / a[0]) + 3.f / 8.f,
+          (b[1] / a[1]) * (b[1] / a[1]) + 3.f / 8.f,
+          (b[2] / a[2]) * (b[2] / a[2]) + 3.f / 8.f,
+          0.0f };
+  const size_t npixels = (size_t)wd * ht;
+
+  DT_OMP_FOR()
+  for(size_t j = 0; j < 4U * npixels; j += 4)
+  {
+    for_each_channel(c,aligned(in,buf,a,sigma2_plus_3_8))
+    {
+      const float d = fmaxf(0.0f, in[j+c] / a[c] + sigma2_plus_3_8[c]);
+      buf[j+c] = 2.0f * sqrtf(d);
+    }
+  }
+}
+
+static inline void backtransform(float *const buf,
+                                 const int wd,
+                                 const int ht,
+                                 const dt_aligned_pixel_t a,
+                                 const dt_aligned_pixel_t b)
+{
+  const dt_aligned_pixel_t sigma2_plus_1_8
+      = { (b[0] / a[0]) * (b[0] / a[0]) + 1.f / 8.f,
+          (b[1] / a[1]) * (b[1] / a[1]) + 1.f / 8.f,
+          (b[2] / a[2]) * (b[2] / a[2]) + 1.f / 8.f,
+          0.0f };
+  const size_t npixels = (size_t)wd * ht;
+  const float sqrt_3_2 = sqrtf(3.0f / 2.0f);
+
+  DT_OMP_FOR()
+  for(size_t j = 0; j < 4U * npixels; j += 4)
+  {
+    for_each_channel(c,aligned(buf,sigma2_plus_1_8))
+    {
+      const float x = buf[j+c], x2 = x * x;
+      // closed form approximation to unbiased inverse (input range
+      // was 0..200 for fit, not 0..1)
+      buf[j+c] = (x < 0.5f)
+        ? 0.0f
+        : a[c] * (1.f / 4.f * x2 + 1.f / 4.f * sqrt_3_2 / x - 11.f / 8.f / x2
+                  + 5.f / 8.f * sqrt_3_2 / (x * x2) - sigma2_plus_1_8[c]);
+      // asymptotic form:
+      // buf[j+c] = fmaxf(0.0f, 1./4.*x*x - 1./8. - sigma2[c]);
+      // buf[j+c] *= a[c];
+    }
+  }
+}
+
+// the "v2" variance stabilizing transform is an extension of the generalized
+// anscombe transform.
+// In the generalized anscombe transform, the profiles gives a and b such as:
+// V(X) = a * E[X] + b
+// In this new transform, we have an additional parameter, p, such as:
+// V(X) = a * (E[X] + b) ^ p
+// When p == 1, we get back the equation of generalized anscombe transform.
+// Now, let's see how we derive the precondition.
+// The goal of a VST f is to make variance constant: V(f(X)) = constant
+// Using a Taylor expansion, we have:
+// V(f(X)) ~= V(f(E[X])+f'(X)(X-E[X]))
+//          = V(f'(X)(X-E[X]))
+//          = f'(X)^2 * V(X-E[X])
+//          = f'(X)^2 * V(X)
+// So the condition V(f(X)) = constant gives us the following condition:
+// V(X) = constant / f'(X)^2
+// Usually, we take constant = 1
+// If we have V(X) = a * (E[X] + b) ^ p
+// then: f'(X) = 1 / sqrt(a) * (E[X] + b) ^ (-p / 2)
+// then: f(x) = 1 / (sqrt(a) * (1 - p / 2)) * (x + b) ^ (1 - p / 2)
+//            = 2 * (x + b) ^ (1 - p / 2) / (sqrt(a) * (2 - p))
+// is a suitable function.
+// This is the function we use here.
+static inline void precondition_v2(const float *const in,
+                                   float *const buf,
+                                   const int wd,
+                                   const int ht,
+                                   const float a,
+                                   const dt_aligned_pixel_t p,
+                                   const float b,
+                                   const dt_aligned_pixel_t wb)
+{
+  const size_t npixels = (size_t)wd * ht;
+  const dt_aligned_pixel_t expon = { -p[0] / 2 + 1, -p[1] / 2 + 1, -p[2] / 2 + 1, 1.0f };
+  const dt_aligned_pixel_t denom = { (-p[0] + 2) * sqrtf(a), (-p[1] + 2) * sqrtf(a),
+                                     (-p[2] + 2) * sqrtf(a), 1.0f };
+
+  DT_OMP_FOR()
+  for(size_t j = 0; j < 4U * npixels; j += 4)
+  {
+    dt_aligned_pixel_t scaled;
+    for_each_channel(c,aligned(in,wb))
+      scaled[c] = MAX(in[j+c] / wb[c] + b, 0.0f);
+    dt_aligned_pixel_t precond;
+    for_each_channel(c,aligned(scaled,expon))
+      precond[c] = powf(scaled[c], expon[c]);
+    for_each_channel(c,aligned(denom))
+      precond[c] = 2.0f * precond[c] / denom[c];
+    copy_pixel_nontemporal(buf + j, precond);
+  }
+  dt_omploop_sfence(); // ensure that nontemporal writes complete before we read the output
+}
+
+// this backtransform aims at being a low bias backtransform
+// you can see that it is not equal to f-1
+// this is because E[X] != f-1(E[f(X)])
+// so let's try to find a better backtransform than f-1:
+// we want to find E[X] knowing E[f(X)]
+// let's apply Taylor expansion to E[f(X)] to see if we can get something better:
+// E[f(X)] ~= E[f(E[X]) + f'(E[X])(X-E[X])]
+//          = E[f(E[X]) + f'(E[X]) * X - f'(E[X]) * E[X]]
+//          = f(E[X]) + f'(E[X]) * E[X] - f'(E[X]) * E[X]
+//          = f(E[X])
+// so first order Taylor expansion is not useful.
+// going to the second order:
+// E[f(X)] ~= E[f(E[X]) + f'(E[X])(X-E[X]) + f"(E[X])/2 * (X-E[X])^2]
+//          = f(E[X]) + f"(E[X])/2 * E[(X-E[X])^2]
+//          = f(E[X]) + f"(E[X])/2 * V(X)
+// and we know that V(X) = constant / f'(X)^2
+// the constant here is not 1, due to problems in noise profiling tool
+// so in fact constant depends on the image (and is approximately in [10;15])
+// so:
+// E[f(X)] ~= f(E[X]) + f"(E[X])/2 * constant / f'(E[X])^2
+// we have:
+// f(x) = 2 * (x + b) ^ (1 - p / 2) / (sqrt(a) * (2 - p))
+// f'(x) = 1 / sqrt(a) * (x + b) ^ (-p / 2)
+// 1/f'(x)^2 = a * (x + b) ^ p
+// f"(x) = 1 / sqrt(a) * (-p / 2) * (x + b) ^ (- p / 2 - 1)
+// let's replace f, f', and f" by their analytical expressions in our equation:
+// let x = E[X]
+// E[f(X)] ~= 2 * (x + b) ^ (1 - p / 2) / (sqrt(a) * (2 - p))
+//            + constant / 2 * (1 / sqrt(a) * (-p / 2) * (x + b) ^ (- p / 2 - 1)) * (a * (x + b) ^ p)
+//          = 2 * (x + b) ^ (1 - p / 2) / (sqrt(a) * (2 - p))
+//            + constant / 2 * 1 / sqrt(a) * (-p / 2) * a * (x + b) ^ (p / 2 - 1)
+//          = 2 * (x + b) ^ (1 - p / 2) / (sqrt(a) * (2 - p))
+//            - constant / 4 * sqrt(a) * p * (x + b) ^ (p / 2 - 1)
+// let z = (x + b) ^ (1 - p / 2)
+// E[f(X)] ~= 2 / (sqrt(a) * (2 - p)) * z
+//            - constant / 4 * sqrt(a) * p * z^(-1)
+// let y = E[f(X)]
+// y ~= 2 / (sqrt(a) * (2 - p)) * z - constant / 4 * sqrt(a) * p * z^(-1)
+// y * z = 2 / (sqrt(a) * (2 - p)) * z^2 - constant / 4 * sqrt(a) * p
+// 0 = 2 / (sqrt(a) * (2 - p)) * z^2 - y * z - constant / 4 * sqrt(a) * p
+// let's solve this equation:
+// delta = y ^ 2 - 4 * 2 / (sqrt(a) * (2 - p)) * (- constant / 4 * sqrt(a))
+//       = y ^ 2 + 2 * p * constant / (2 - p)
+// delta >= 0
+// the 2 solutions are:
+// z0 = (y - sqrt(delta)) / (2 * 2 / (sqrt(a) * (2 - p)))
+// z1 = (y + sqrt(delta)) / (2 * 2 / (sqrt(a) * (2 - p)))
+// as delta > y^2, sqrt(delta) > y, so z0 is negative
+// so z1 is the only possible solution.
+// Then, to find E[X], we only have to do:
+// z = (x + b) ^ (1 - p / 2) <=> x = z ^ (1 / (1 - p / 2)) - b
+//
+// What we see here is that a bias compensation term is in delta:
+// the term: 2 * p * constant / (2 - p)
+// But we are not sure at all what the value of the constant is
+// That's why we introduce a user-controled bias parameter to be able to
+// control the bias:
+// we replace the 2 * p * constant / (2 - p) part of delta by user
+// defined bias controller.
+static inline void backtransform_v2(float *const buf,
+                                    const int wd,
+                                    const int ht,
+                                    const float a,
+                                    const dt_aligned_pixel_t p,
+                                    const float b,
+                                    const float bias,
+                                    const dt_aligned_pixel_t wb)
+{
+  const size_t npixels = (size_t)wd * ht;
+  const dt_aligned_pixel_t expon = { 1.0f / (1.0f - p[0] / 2.0f),
+                                     1.0f / (1.0f - p[1] / 2.0f),
+                                     1.0f / (1.0f - p[2] / 2.0f),
+                                     1.0f };
+
+  const dt_aligned_pixel_t denom = { 4.0f / (sqrtf(a) * (2.0f - p[0])),
+                                     4.0f / (sqrtf(a) * (2.0f - p[1])),
+                                     4.0f / (sqrtf(a) * (2.0f - p[2])),
+                                     1.0f };
+  DT_OMP_FOR()
+  for(size_t j = 0; j < 4U * npixels; j += 4)
+  {
+    dt_aligned_pixel_t z1;
+    for_each_channel(c,aligned(buf,wb))
+    {
+      const float x = MAX(buf[j+c], 0.0f);
+      const float delta = x * x + bias;
+      z1[c] = (x + sqrtf(MAX(delta, 0.0f))) / denom[c];
+    }
+    dt_aligned_pixel_t back;
+    for_each_channel(c)
+      back[c] = powf(z1[c], expon[c]);
+    for_each_channel(c,aligned(buf))
+      buf[j+c] = wb[c] * (back[c] - b);
+  }
+}
+
+static inline void precondition_Y0U0V0(const float *const in,
+                                       float *const buf,
+                                       const int wd,
+                                       const int ht,
+                                       const float a,
+                                       const dt_aligned_pixel_t p,
+                                       const float b,
+                                       const dt_colormatrix_t toY0U0V0_trans)
+{
+  const dt_aligned_pixel_t expon = { -p[0] / 2 + 1, -p[1] / 2 + 1, -p[2] / 2 + 1, 1.0f };
+  const dt_aligned_pixel_t scale = { 2.0f / ((-p[0] + 2) * sqrtf(a)),
+                                     2.0f / ((-p[1] + 2) * sqrtf(a)),
+                                     2.0f / ((-p[2] + 2) * sqrtf(a)),
+                                     1.0f };
+  DT_OMP_FOR()
+  for(size_t j = 0; j < (size_t)4 * ht * wd; j += 4)
+  {
+    dt_aligned_pixel_t tmp; // "unused" fourth element enables vectorization
+    for_each_channel(c,aligned(in))
+      tmp[c] = powf(MAX(in[j+c] + b, 0.0f), expon[c]) * scale[c];
+    dt_aligned_pixel_t yuv;
+    dt_apply_transposed_color_matrix(tmp, toY0U0V0_trans, yuv);
+    copy_pixel_nontemporal(buf + j, yuv);
+  }
+  dt_omploop_sfence(); // ensure that nontemporal writes complete before we read the output
+}
+
+static inline void backtransform_Y0U0V0(float *const buf,
+                                        const int wd,
+                                        const int ht,
+                                        const float a,
+                                        const dt_aligned_pixel_t p,
+                                        const float b,
+                                        const float bias,
+                                        const dt_aligned_pixel_t wb,
+                                        const dt_colormatrix_t toRGB_trans)
+{
+  const dt_aligned_pixel_t bias_wb = { bias * wb[0], bias * wb[1], bias * wb[2], 0.0f };
+
+  const dt_aligned_pixel_t expon = {  1.0f / (1.0f - p[0] / 2.0f),
+                                      1.0f / (1.0f - p[1] / 2.0f),
+                                      1.0f / (1.0f - p[2] / 2.0f),
+                                      1.0f };
+
+  const dt_aligned_pixel_t scale = { (sqrtf(a) * (2.0f - p[0])) / 4.0f,
+                                     (sqrtf(a) * (2.0f - p[1])) / 4.0f,
+                                     (sqrtf(a) * (2.0f - p[2])) / 4.0f,
+                                     1.0f };
+  DT_OMP_FOR()
+  for(size_t j = 0; j < (size_t)4 * ht * wd; j += 4)
+  {
+    dt_aligned_pixel_t rgb = { 0.0f }; // "unused" fourth element enables vectorization
+    dt_apply_transposed_color_matrix(buf + j, toRGB_trans, rgb);
+    dt_aligned_pixel_t z1;
+    for_each_channel(c,aligned(buf))
+    {
+      const float x = MAX(rgb[c], 0.0f);
+      const float delta = x * x + bias_wb[c];
+      z1[c] = (x + sqrtf(MAX(delta, 0.0f))) * scale[c];
+    }
+    for_each_channel(c,aligned(expon))
+      z1[c] = powf(z1[c], expon[c]);
+    for_each_channel(c,aligned(buf))
+      buf[j+c] = z1[c] - b;
+  }
+}
+
+/* ── White balance and Y0U0V0 matrices ───────────────────────────────────── */
+
+static void compute_wb_factors(dt_aligned_pixel_t wb,
+                               const dt_iop_denoiseprofile_data_t *const d,
+                               const dt_dev_pixelpipe_iop_t *const piece,
+                               const dt_aligned_pixel_t weights)
+{
+  const float wb_mean =
+    (piece->pipe->dsc.temperature.coeffs[0] + piece->pipe->dsc.temperature.coeffs[1]
+     + piece->pipe->dsc.temperature.coeffs[2])
+    / 3.0f;
+  // we init wb by the mean of the coeffs, which corresponds to the mean
+  // amplification that is done in addition to the "ISO" related amplification
+  wb[0] = wb[1] = wb[2] = wb[3] = wb_mean;
+
+  if(d->fix_anscombe_and_nlmeans_norm)
+  {
+    if(wb_mean != 0.0f && d->wb_adaptive_anscombe)
+    {
+      for(int i = 0; i < 3; i++) wb[i] = piece->pipe->dsc.temperature.coeffs[i];
+    }
+    else if(wb_mean == 0.0f)
+    {
+      // temperature coeffs are equal to 0 if we open a JPG image.
+      // in this case consider them equal to 1.
+      for_each_channel(i)
+        wb[i] = 1.0f;
+    }
+    // else, wb_adaptive_anscombe is false and our wb array is
+    // filled with the wb_mean
+  }
+  else
+  {
+    for_each_channel(i)
+      wb[i] = weights[i] * piece->pipe->dsc.processed_maximum[i];
+  }
+  return;
+}
+
+static gboolean invert_matrix(const dt_colormatrix_t in,
+                              dt_colormatrix_t out)
+{
+  // use same notation as:
+  // https://en.wikipedia.org/wiki/Invertible_matrix#Inversion_of_3_%C3%97_3_matrices
+  const float biga = in[1][1] * in[2][2] - in[1][2] * in[2][1];
+  const float bigb = -in[1][0] * in[2][2] + in[1][2] * in[2][0];
+  const float bigc = in[1][0] * in[2][1] - in[1][1] * in[2][0];
+  const float bigd = -in[0][1] * in[2][2] + in[0][2] * in[2][1];
+  const float bige = in[0][0] * in[2][2] - in[0][2] * in[2][0];
+  const float bigf = -in[0][0] * in[2][1] + in[0][1] * in[2][0];
+  const float bigg = in[0][1] * in[1][2] - in[0][2] * in[1][1];
+  const float bigh = -in[0][0] * in[1][2] + in[0][2] * in[1][0];
+  const float bigi = in[0][0] * in[1][1] - in[0][1] * in[1][0];
+
+  const float det = in[0][0] * biga + in[0][1] * bigb + in[0][2] * bigc;
+  if(det == 0.0f)
+  {
+    return FALSE;
+  }
+
+  out[0][0] = 1.0f / det * biga;
+  out[0][1] = 1.0f / det * bigd;
+  out[0][2] = 1.0f / det * bigg;
+  out[0][3] = 0.0f;
+  out[1][0] = 1.0f / det * bigb;
+  out[1][1] = 1.0f / det * bige;
+  out[1][2] = 1.0f / det * bigh;
+  out[1][3] = 0.0f;
+  out[2][0] = 1.0f / det * bigc;
+  out[2][1] = 1.0f / det * bigf;
+  out[2][2] = 1.0f / det * bigi;
+  out[2][3] = 0.0f;
+  return TRUE;
+}
+
+// create the white balance adaptative conversion matrices
+// supposes toY0U0V0 already contains the "normal" conversion matrix
+static void set_up_conversion_matrices(dt_colormatrix_t toY0U0V0,
+                                       dt_colormatrix_t toRGB,
+                                       const dt_aligned_pixel_t wb)
+{
+  // for an explanation of the spirit of the choice of the coefficients of the
+  // Y0U0V0 conversion matrix, see part 12.3.3 page 190 of
+  // "From Theory to Practice, a Tour of Image Denoising"
+  // https://hal.archives-ouvertes.fr/tel-01114299
+  // we adapt a bit the coefficients, in a way that follows the same spirit.
+
+  float sum_invwb = 1.0f/wb[0] + 1.0f/wb[1] + 1.0f/wb[2];
+  // we change the coefs to Y0, but keeping the goal of making SNR higher:
+  // these were all equal to 1/3 to get the Y0 the least noisy possible, assuming
+  // that all channels have equal noise variance.
+  // as white balance influences noise variance, we do a weighted mean depending
+  // on white balance. Note that it is equivalent to keeping the 1/3 coefficients
+  // if we divide by the white balance coefficients beforehand.
+  // we then normalize the line so that variance becomes equal to 1:
+  // var(Y0) = 1/9 * (var(R) + var(G) + var(B)) = 1/3
+  // var(sqrt(3)Y0) = 1
+  sum_invwb *= sqrtf(3);
+  toY0U0V0[0][0] = sum_invwb / wb[0];
+  toY0U0V0[0][1] = sum_invwb / wb[1];
+  toY0U0V0[0][2] = sum_invwb / wb[2];
+  toY0U0V0[0][3] = 0.0f;
+  // we also normalize the other line in a way that should give a variance of 1
+  // if var(B/wb[B]) == 1, then var(B) = wb[B]^2
+  // note that we don't change the coefs of U0 and V0 depending on white balance,
+  // apart of the normalization: these coefficients do differences of RGB channels
+  // to try to reduce or cancel the signal. If we change these depending on white
+  // balance, we will not reduce/cancel the signal anymore.
+  const float stddevU0 = sqrtf(0.5f * 0.5f * wb[0] * wb[0]
+                               + 0.5f * 0.5f * wb[2] * wb[2]);
+  const float stddevV0 = sqrtf(0.25f * 0.25f * wb[0] * wb[0]
+                               + 0.5f * 0.5f * wb[1] * wb[1]
+                               + 0.25f * 0.25f * wb[2] * wb[2]);
+  toY0U0V0[1][0] /= stddevU0;
+  toY0U0V0[1][1] /= stddevU0;
+  toY0U0V0[1][2] /= stddevU0;
+  toY0U0V0[1][3] = 0.0f;
+  toY0U0V0[2][0] /= stddevV0;
+  toY0U0V0[2][1] /= stddevV0;
+  toY0U0V0[2][2] /= stddevV0;
+  toY0U0V0[2][3] = 0.0f;
+  const gboolean is_invertible = invert_matrix(toY0U0V0, toRGB);
+  if(!is_invertible)
+  {
+    // use standard form if whitebalance adapted matrix is not invertible
+    float stddevY0 = sqrtf(1.0f / 9.0f * (wb[0] * wb[0] + wb[1] * wb[1] + wb[2] * wb[2]));
+    toY0U0V0[0][0] = 1.0f / (3.0f * stddevY0);
+    toY0U0V0[0][1] = 1.0f / (3.0f * stddevY0);
+    toY0U0V0[0][2] = 1.0f / (3.0f * stddevY0);
+    toY0U0V0[0][3] = 0.0f;
+    invert_matrix(toY0U0V0, toRGB);
+  }
+}
+
+static void variance_stabilizing_xform(dt_aligned_pixel_t thrs,
+                                       const int scale,
+                                       const int max_scale,
+                                       const size_t npixels,
+                                       const float *const sum_y2,
+                                       const dt_iop_denoiseprofile_data_t *const d)
+{
+  // variance stabilizing transform maps sigma to unity.
+  const float sigma = 1.0f;
+  // it is then transformed by wavelet scales via the 5 tap a-trous filter:
+  const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
+  const float sigma_band = powf(varf, scale) * sigma;
+  // determine thrs as bayesshrink
+  const float sb2 = sigma_band * sigma_band;
+
+  const dt_aligned_pixel_t var_y =
+    { sum_y2[0] / (npixels - 1.0f),
+      sum_y2[1] / (npixels - 1.0f),
+      sum_y2[2] / (npixels - 1.0f),
+      0.0f };
+
+  const dt_aligned_pixel_t std_x =
+    { sqrtf(MAX(1e-6f, var_y[0] - sb2)),
+      sqrtf(MAX(1e-6f, var_y[1] - sb2)),
+      sqrtf(MAX(1e-6f, var_y[2] - sb2)),
+      1.0f };
+
+  // add 8.0 here because it seemed a little weak
+  dt_aligned_pixel_t adjt = { 8.0f, 8.0f, 8.0f, 0.0f };
+
+  const int offset_scale = DT_IOP_DENOISE_PROFILE_BANDS - max_scale;
+  const int band_index = DT_IOP_DENOISE_PROFILE_BANDS - (scale + offset_scale + 1);
+
+  if(d->wavelet_color_mode == MODE_RGB)
+  {
+    // current scale number is scale+offset_scale
+    // for instance, largest scale is DT_IOP_DENOISE_PROFILE_BANDS
+    // max_scale only indicates the number of scales to process at THIS
+    // zoom level, it does NOT corresponds to the the maximum number of scales.
+    // in other words, max_scale is the maximum number of VISIBLE scales.
+    // That is why we have this "scale+offset_scale"
+    float band_force_exp_2
+      = d->force[DT_DENOISE_PROFILE_ALL][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    for_each_channel(ch)
+    {
+      adjt[ch] *= band_force_exp_2;
+    }
+    band_force_exp_2 = d->force[DT_DENOISE_PROFILE_R][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    adjt[0] *= band_force_exp_2;
+    band_force_exp_2 = d->force[DT_DENOISE_PROFILE_G][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    adjt[1] *= band_force_exp_2;
+    band_force_exp_2 = d->force[DT_DENOISE_PROFILE_B][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    adjt[2] *= band_force_exp_2;
+  }
+  else
+  {
+    float band_force_exp_2 = d->force[DT_DENOISE_PROFILE_Y0][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    adjt[0] *= band_force_exp_2;
+    band_force_exp_2 = d->force[DT_DENOISE_PROFILE_U0V0][band_index];
+    band_force_exp_2 *= band_force_exp_2;
+    band_force_exp_2 *= 4;
+    adjt[1] *= band_force_exp_2;
+    adjt[2] *= band_force_exp_2;
+  }
+  for_each_channel(c)
+    thrs[c] = adjt[c] * sb2 / std_x[c];
+}
+
+
+/* ── Reduced-cost preview ────────────────────────────────────────────────── */
+
+static gboolean _preview_variant(const dt_dev_pixelpipe_iop_t *const piece,
+                                 const dt_iop_roi_t *const roi_out)
+{
+  const dt_dev_pixelpipe_type_t type = piece->pipe->type;
+  if(type & DT_DEV_PIXELPIPE_EXPORT) return FALSE;
+  if(type & (DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_FAST | DT_DEV_PIXELPIPE_THUMBNAIL))
+    return TRUE;
+  return roi_out->scale < DT_IOP_DENOISE_PROFILE_PREVIEW_SCALE;
+}
+
+// number of wavelet scales visible at this zoom level
+static int _wavelet_max_scale(const dt_dev_pixelpipe_iop_t *const piece,
+                              const float in_scale)
+{
+  const int max_max_scale = DT_IOP_DENOISE_PROFILE_BANDS; // hard limit
+  int max_scale = 0;
+  // largest desired filter on input buffer (20% of input dim)
+  const float supp0 = MIN(2 * (2u << (max_max_scale - 1)) + 1,
+                          MAX(piece->buf_in.height * piece->iscale,
+                              piece->buf_in.width * piece->iscale) * 0.2f);
+  const float i0 = dt_log2f((supp0 - 1.0f) * .5f);
+
+  for(; max_scale < max_max_scale; max_scale++)
+  {
+    // actual filter support on scaled buffer
+    const float supp = 2 * (2u << max_scale) + 1;
+    // approximates this filter size on unscaled input image:
+    const float supp_in = supp * (1.0f / in_scale);
+    const float i_in = dt_log2f((supp_in - 1) * .5f) - 1.0f;
+    // i_in = max_scale .. .. .. 0
+    const float t = 1.0f - (i_in + .5f) / i0;
+    if(t < 0.0f) break;
+  }
+  return max_scale;
+}
+
+/* ── Wavelets ────────────────────────────────────────────────────────────── */
+
+static void process_wavelets(dt_iop_module_t *self,
+                             dt_dev_pixelpipe_iop_t *piece,
+                             const void *const ivoid,
+                             void *const ovoid,
+                             const dt_iop_roi_t *const roi_in,
+                             const dt_iop_roi_t *const roi_out,
+                             const eaw_dn_decompose_t decompose,
+                             const eaw_synthesize_t synthesize)
+{
+  const dt_iop_denoiseprofile_data_t *const d = piece->data;
+
+  const float in_scale = fminf(roi_in->scale / piece->iscale, 1.0f);
+  const int max_scale = _wavelet_max_scale(piece, in_scale);
+  // the preview keeps the band mapping of all visible scales but leaves
+  // the coarser ones in the residual
+  const int num_scales = _preview_variant(piece, roi_out)
+    ? MIN(max_scale, DT_IOP_DENOISE_PROFILE_PREVIEW_BANDS)
+    : max_scale;
+
+  const int max_mult = 1u << (max_scale - 1);
+  const int width = roi_in->width, height = roi_in->height;
+  const size_t npixels = (size_t)width*height;
+  const float *const restrict in = (const float*)ivoid;
+  float *const restrict out = (float*)ovoid;
+
+  // corner case of extremely small image. this is not really likely
+  // to happen but would lead to out of bounds memory access
+  if(width < 2 * max_mult || height < 2 * max_mult)
+  {
+    memcpy(out, in, sizeof(float) * 4 * npixels);
+    return;
+  }
+
+  float *buf = NULL;
+  float *restrict precond = NULL;
+  float *restrict tmp = NULL;
+
+  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 4, &buf, 0, NULL))
+  {
+    dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out);
+    return;
+  }
+
+  dt_aligned_pixel_t wb;  // the "unused" fourth element enables vectorization
+  const dt_aligned_pixel_t wb_weights = { 2.0f, 1.0f, 2.0f, 0.0f };
+  compute_wb_factors(wb,d,piece,wb_weights);
+
+  // adaptive p depending on white balance (the "unused" fourth
+  // element enables vectorization
+  const dt_aligned_pixel_t p = { MAX(d->shadows + 0.1 * logf(in_scale / wb[0]), 0.0f),
+                                 MAX(d->shadows + 0.1 * logf(in_scale / wb[1]), 0.0f),
+                                 MAX(d->shadows + 0.1 * logf(in_scale / wb[2]), 0.0f),
+                                 0.0f };
+
+  const float compensate_p =
+    DT_IOP_DENOISE_PROFILE_P_FULCRUM / powf(DT_IOP_DENOISE_PROFILE_P_FULCRUM, d->shadows);
+
+  // conversion to Y0U0V0 space as defined in Secrets of image denoising cuisine
+  dt_colormatrix_t toY0U0V0 = { { 1.0f/3.0f, 1.0f/3.0f, 1.0f/3.0f, 0.0f },
+                                {  0.5f,      0.0f,    -0.5f,      0.0f },
+                                {  0.25f,    -0.5f,     0.25f,     0.0f },
+                                {  0.0f,      0.0f,     0.0f,      0.0f } };
+
+  // "unused" fourth element enables vectorization:
+  dt_colormatrix_t toRGB = { { 0.0f, 0.0f, 0.0f, 0.0f },
+                             { 0.0f, 0.0f, 0.0f, 0.0f },
+                             { 0.0f, 0.0f, 0.0f, 0.0f },
+                             { 0.0f, 0.0f, 0.0f, 0.0f }};
+  set_up_conversion_matrices(toY0U0V0, toRGB, wb);
+
+  // more strength in Y0U0V0 in order to get a similar smoothing as in other modes
+  // otherwise, result was much less denoised in Y0U0V0 mode.
+  const float compensate_strength = (d->wavelet_color_mode == MODE_RGB) ? 1.0f : 2.5f;
+  // update the coeffs with strength and scale
+  for(size_t k = 0; k < 3; k++)
+    for_each_channel(c)
+    {
+      toY0U0V0[k][c] /= (d->strength * compensate_strength * in_scale);
+      toRGB[k][c] *= (d->strength * compensate_strength * in_scale);
+    }
+  // make transposed copies of the conversion matrices for more efficient
+  // vectorized multiplication
+  dt_colormatrix_t toY0U0V0_trans;
+  dt_colormatrix_transpose(toY0U0V0_trans,toY0U0V0);
+  dt_colormatrix_t toRGB_trans;
+  dt_colormatrix_transpose(toRGB_trans,toRGB);
+
+  for_each_channel(i)
+    wb[i] *= d->strength * compensate_strength * in_scale;
+
+  // only use green channel + wb for now: (the "unused" fourth element
+  // enables vectorization)
+  const dt_aligned_pixel_t aa = { d->a[1] * wb[0], d->a[1] * wb[1], d->a[1] * wb[2], 0.0f };
+  const dt_aligned_pixel_t bb = { d->b[1] * wb[0], d->b[1] * wb[1], d->b[1] * wb[2], 0.0f };
+
+  if(!d->use_new_vst)
+  {
+    precondition(in, precond, width, height, aa, bb);
+  }
+  else if(d->wavelet_color_mode == MODE_RGB)
+  {
+    precondition_v2(in, precond, width, height, d->a[1] * compensate_p, p, d->b[1], wb);
+  }
+  else
+  {
+    precondition_Y0U0V0(in, precond, width, height,
+                        d->a[1] * compensate_p,
+                        p, d->b[1],
+                        toY0U0V0_trans);
+  }
+
+  float *restrict buf1 = precond;
+  float *restrict buf2 = tmp;
+
+  // clear the output buffer, which will be accumulating all of the detail scales
+  dt_iop_image_fill(out, 0.0f, width, height, 4);
+
+  for(int scale = 0; scale < num_scales; scale++)
+  {
+    const float sigma = 1.0f;
+    const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
+    const float sigma_band = powf(varf, scale) * sigma;
+    dt_aligned_pixel_t sum_y2;
+    decompose(buf2, buf1, buf, sum_y2,
+              scale, 1.0f / (sigma_band * sigma_band), width, height);
+
+    const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
+    dt_aligned_pixel_t thrs;
+    variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
+    synthesize(out, out, buf, thrs, boost, width, height);
+
+    float *buf3 = buf2;
+    buf2 = buf1;
+    buf1 = buf3;
+  }
+
+  // add in the final residue
+  DT_OMP_SIMD(aligned(buf1, out : 64))
+  for(size_t k = 0; k < 4U * npixels; k++)
+    out[k] += buf1[k];
+
+  if(!d->use_new_vst)
+  {
+    backtransform(out, width, height, aa, bb);
+  }
+  else if(d->wavelet_color_mode == MODE_RGB)
+  {
+    backtransform_v2(out, width, height, d->a[1] * compensate_p,
+                     p, d->b[1], d->bias - 0.5 * logf(in_scale), wb);
+  }
+  else
+  {
+    backtransform_Y0U0V0(out, width, height, d->a[1] * compensate_p,
+                         p, d->b[1], d->bias - 0.5 * logf(in_scale), wb, toRGB_trans);
+  }
+
+  dt_free_align(buf);
+  dt_free_align(tmp);
+  dt_free_align(precond);
+}
+
+/* ── Non-local means ─────────────────────────────────────────────────────── */
+
+static float nlmeans_norm(const int P,
+                          const dt_iop_denoiseprofile_data_t *const d)
+{
+  // Each patch has a width of 2P+1 and a height of 2P+1
+  // thus, divide by (2P+1)^2.
+  // The 0.045 was derived from the old formula, to keep the
+  // norm identical when P=1, as the norm for P=1 seemed
+  // to work quite well: 0.045 = 0.015 * (2 * P + 1) with P=1.
+  float norm = .045f / ((2 * P + 1) * (2 * P + 1));
+  if(!d->fix_anscombe_and_nlmeans_norm)
+  {
+    // use old formula
+    norm = .015f / (2 * P + 1);
+  }
+  return norm;
+}
+
+// adjust the user-specified scattering factor and search radius to
+// account for the type of pixelpipe
+static float nlmeans_scattering(int *nbhood,
+                                const dt_iop_denoiseprofile_data_t *const d,
+                                const dt_dev_pixelpipe_iop_t *const piece,
+                                const float scale)
+{
+  int K = *nbhood;
+  float scattering = d->scattering;
+
+  const int maxk = (K * K * K + 7.0 * K * sqrt(K)) * scattering / 6.0 + K;
+  if(piece->pipe->type
+     & (DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_FAST | DT_DEV_PIXELPIPE_THUMBNAIL))
+  {
+    // much faster but inaccurate for previews
+    K = MIN(3, K);
+    scattering = (maxk - K) * 6.0 / (K * K * K + 7.0 * K * sqrt(K));
+  }
+  else if(piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW2))
+  {
+    // faster but slightly more inaccurate
+    K = MAX(MIN(4, K), K * scale);
+    scattering = (maxk - K) * 6.0 / (K * K * K + 7.0 * K * sqrt(K));
+  }
+  *nbhood = K;
+  return scattering;
+}
+
+static float nlmeans_precondition(const dt_iop_denoiseprofile_data_t *const d,
+                                  const dt_dev_pixelpipe_iop_t *const piece,
+                                  dt_aligned_pixel_t wb,
+                                  const void *const ivoid,
+                                  const dt_iop_roi_t *const roi_in,
+                                  float scale, float *in,
+                                  dt_aligned_pixel_t aa,
+                                  dt_aligned_pixel_t bb,
+                                  dt_aligned_pixel_t p)
+{
+  // the "unused" fourth array element enables vectorization
+  const dt_aligned_pixel_t wb_weights = { 1.0f, 1.0f, 1.0f, 0.0f };
+  compute_wb_factors(wb,d,piece,wb_weights);
+
+  // adaptive p depending on white balance
+  p[0] = MAX(d->shadows + 0.1 * logf(scale / wb[0]), 0.0f);
+  p[1] = MAX(d->shadows + 0.1 * logf(scale / wb[1]), 0.0f);
+  p[2] = MAX(d->shadows + 0.1 * logf(scale / wb[2]), 0.0f);
+  p[3] = 0.0f;
+
+  // update the coeffs with strength and scale
+  for_each_channel(i,aligned(wb,aa,bb))
+  {
+    wb[i] *= d->strength * scale;
+    // only use green channel + wb for now:
+    aa[i] = d->a[1] * wb[i];
+    bb[i] = d->b[1] * wb[i];
+  }
+  const float compensate_p =
+    DT_IOP_DENOISE_PROFILE_P_FULCRUM / powf(DT_IOP_DENOISE_PROFILE_P_FULCRUM, d->shadows);
+  if(!d->use_new_vst)
+  {
+    precondition((float *)ivoid, in, roi_in->width, roi_in->height, aa, bb);
+  }
+  else
+  {
+    precondition_v2((float *)ivoid, in, roi_in->width, roi_in->height,
+                    d->a[1] * compensate_p, p, d->b[1], wb);
+  }
+  return compensate_p;
+}
+
+static void nlmeans_backtransform(const dt_iop_denoiseprofile_data_t *const d,
+                                  float *ovoid,
+                                  const dt_iop_roi_t *const roi_in,
+                                  const float scale,
+                                  const float compensate_p,
+                                  const dt_aligned_pixel_t wb,
+                                  const dt_aligned_pixel_t aa,
+                                  const dt_aligned_pixel_t bb,
+                                  const dt_aligned_pixel_t p)
+{
+  if(!d->use_new_vst)
+  {
+    backtransform((float *)ovoid, roi_in->width, roi_in->height, aa, bb);
+  }
+  else
+  {
+    backtransform_v2((float *)ovoid, roi_in->width, roi_in->height,
+                     d->a[1] * compensate_p, p, d->b[1],
+                     d->bias - 0.5 * logf(scale), wb);
+  }
+}
+
+static void process_nlmeans(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const void *const ivoid,
+                            void *const ovoid,
+                            const dt_iop_roi_t *const roi_in,
+                            const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_denoiseprofile_data_t *const d = piece->data;
+  if(!dt_iop_have_required_input_format(4 /*we need full-color pixels*/,
+                                        self, piece->colors,
+                                        ivoid, ovoid, roi_in, roi_out))
+    return; // image has been copied through to output and module's
+            // trouble flag has been updated
+
+  float *restrict in;
+  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out,
+                                 4 | DT_IMGSZ_INPUT, &in, 0))
+    return;
+
+  // adjust to zoom size:
+  const float scale = fminf(fminf(roi_in->scale, 2.0f) / fmaxf(piece->iscale, 1.0f), 1.0f);
+  const int P = ceilf(d->radius * scale); // pixel filter size
+  int K = d->nbhood; // nbhood
+  const float scattering = nlmeans_scattering(&K,d,piece,scale);
+  const float norm = nlmeans_norm(P,d);
+  const float central_pixel_weight = d->central_pixel_weight * scale;
+
+  // P == 0 : this will degenerate to a (fast) bilateral filter.
+
+  dt_aligned_pixel_t wb; // the "unused" fourth array element enables vectorization
+  dt_aligned_pixel_t p;
+  dt_aligned_pixel_t aa, bb;
+  const float compensate_p =
+    nlmeans_precondition(d, piece, wb, ivoid, roi_in, scale, in, aa, bb, p);
+
+  const dt_aligned_pixel_t norm2 = { 1.0f, 1.0f, 1.0f, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = scattering,
+                                      .scale = scale,
+                                      .luma = 1.0,    //no blending
+                                      .chroma = 1.0,
+                                      .center_weight = central_pixel_weight,
+                                      .sharpness = norm,
+                                      .patch_radius = P,
+                                      .search_radius = K,
+                                      // the preview compares every other patch
+                                      .decimate = _preview_variant(piece, roi_out) ? 1 : 0,
+                                      .norm = norm2,
+                                      .pipetype = piece->pipe->type };
+  nlmeans_denoise(in, ovoid, roi_in, roi_out, &params);
+
+  dt_free_align(in);
+  nlmeans_backtransform(d,ovoid,roi_in,scale,compensate_p,wb,aa,bb,p);
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_denoiseprofile_data_t *d = piece->data;
+
+  if(d->mode == MODE_NLMEANS
+     || d->mode == MODE_NLMEANS_AUTO)
+    process_nlmeans(self, piece, ivoid, ovoid, roi_in, roi_out);
+  else if(d->mode == MODE_WAVELETS
+          || d->mode == MODE_WAVELETS_AUTO)
+    process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out,
+                     eaw_dn_decompose, eaw_synthesize);
+  else
+    // MODE_VARIANCE only measures the image for the GUI
+    dt_iop_copy_image_roi((float *)ovoid, (const float *)ivoid, piece->colors, roi_in, roi_out);
+}
+
+/* ── tiling_callback() ───────────────────────────────────────────────────── */
+
+static void tiling_callback(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const dt_iop_roi_t *roi_in,
+                            const dt_iop_roi_t *roi_out,
+                            dt_develop_tiling_t *tiling)
+{
+  const dt_iop_denoiseprofile_data_t *d = piece->data;
+
+  if(d->mode == MODE_NLMEANS || d->mode == MODE_NLMEANS_AUTO)
+  {
+    // pixel filter size:
+    const int P = ceilf(d->radius * fminf(fminf(roi_in->scale, 2.0f)
+                                          / fmaxf(piece->iscale, 1.0f), 1.0f));
+    const int K = ceilf(d->nbhood * fminf(fminf(roi_in->scale, 2.0f)
+                                          / fmaxf(piece->iscale, 1.0f), 1.0f)); // nbhood
+    const int K_scattered = ceilf(d->scattering
+                                  * (K * K * K + 7.0 * K * sqrt(K)) / 6.0) + K;
+
+    tiling->factor = 2.0f + 0.25f; // in + out + tmp
+    tiling->factor_cl = tiling->factor;
+    tiling->maxbuf = 1.0f;
+    tiling->overhead = 0;
+    tiling->overlap = P + K_scattered;
+    tiling->xalign = 1;
+    tiling->yalign = 1;
+  }
+  else
+  {
+    const float scale = fminf(roi_in->scale / piece->iscale, 1.0f);
+    const int max_scale = _wavelet_max_scale(piece, scale);
+    const int max_filter_radius = (1u << max_scale); // 2 * 2^max_scale
+
+    tiling->factor = 5.0f; // in + out + precond + tmp + reducebuffer
+    tiling->factor_cl = tiling->factor;
+    tiling->maxbuf = 1.0f;
+    tiling->maxbuf_cl = 1.0f;
+    tiling->overhead = 0;
+    tiling->overlap = max_filter_radius;
+    tiling->xalign = 1;
+    tiling->yalign = 1;
+  }
+}
+
+/* ── Noise profile ───────────────────────────────────────────────────────── */
+
+static inline unsigned infer_radius_from_profile(const float a)
+{
+  return MIN((unsigned)(1.0f + a * 15000.0f + a * a * 300000.0f), 8);
+}
+
+static inline float infer_scattering_from_profile(const float a)
+{
+  return MIN(3000.0f * a, 1.0f);
+}
+
+static inline float infer_shadows_from_profile(const float a)
+{
+  return MIN(MAX(0.1f - 0.1 * logf(a), 0.7f), 1.8f);
+}
+
+static inline float infer_bias_from_profile(const float a)
+{
+  return -MAX(5 + 0.5 * logf(a), 0.0);
+}
+
+static int _get_iso_highlight_preservation_shift(const dt_image_t *img)
+{
+  const float hilight_pres = img->exif_highlight_preservation;
+  // Only compensate whole EV steps, as non-whole steps are (based on
+  // experience and discussion in #19624) handled by different means in the
+  // camera.
+  const int shift = floorf(hilight_pres);
+  if(shift <= 0)
+  {
+    return 0;
+  }
+  return shift;
+}
+
+// profile for the image's camera at its ISO, interpolated between the two
+// nearest profiled ISOs; the generic poissonian profile when there is none
+static dt_noiseprofile_t _get_auto_profile(const dt_image_t *img,
+                                           const gboolean compensate_hilite_pres)
+{
+  dt_noiseprofile_t interpolated = dt_noiseprofile_generic; // default to generic poissonian
+
+  const dt_noiseprofile_t *profiles = NULL;
+  const int count = dt_noiseprofile_get_matching(img, &profiles);
+
+  int iso = (int)img->exif_iso;
+  if(compensate_hilite_pres)
+    iso >>= _get_iso_highlight_preservation_shift(img);
+
+  for(int i = 0; i < count; i++)
+  {
+    const dt_noiseprofile_t *current = &profiles[i];
+    if(current->iso == iso)
+    {
+      interpolated = *current;
+      break;
+    }
+    if(i > 0 && profiles[i - 1].iso < iso && current->iso > iso)
+    {
+      interpolated.iso = iso;
+      dt_noiseprofile_interpolate(&profiles[i - 1], current, &interpolated);
+      break;
+    }
+  }
+  return interpolated;
+}
+
+/* ── Band force curves ───────────────────────────────────────────────────── */
+
+/*
+ * darktable samples a Catmull-Rom curve through the (x, y) nodes of each
+ * channel at DT_IOP_DENOISE_PROFILE_BANDS points in [0, 1], clamped and
+ * quantised to 16 bits (dt_draw_curve_calc_values).  Same here, without
+ * the draw-curve object.  Returns FALSE when the x are not increasing.
+ */
+static gboolean _band_force(const float *const x,
+                            const float *const y,
+                            float *const force)
+{
+  const int n = DT_IOP_DENOISE_PROFILE_BANDS;
+  float m[DT_IOP_DENOISE_PROFILE_BANDS];
+
+  for(int i = 0; i < n - 1; i++)
+    if(x[i + 1] <= x[i]) return FALSE;
+
+  // tangents: one-sided at the ends, centred in between
+  m[0] = (y[1] - y[0]) / (x[1] - x[0]);
+  m[n - 1] = (y[n - 1] - y[n - 2]) / (x[n - 1] - x[n - 2]);
+  for(int i = 1; i < n - 1; i++)
+    m[i] = (y[i + 1] - y[i - 1]) / (x[i + 1] - x[i - 1]);
+
+  for(int k = 0; k < n; k++)
+  {
+    const float t = k / (n - 1.0f);
+    float v;
+    if(t <= x[0])
+      v = y[0];
+    else if(t >= x[n - 1])
+      v = y[n - 1];
+    else
+    {
+      int i = 0;
+      while(t > x[i + 1]) i++;
+      // cubic Hermite segment
+      const float h = x[i + 1] - x[i];
+      const float s = (t - x[i]) / h;
+      const float s2 = s * s, s3 = s2 * s;
+      v = (2.0f * s3 - 3.0f * s2 + 1.0f) * y[i] + (s3 - 2.0f * s2 + s) * h * m[i]
+          + (-2.0f * s3 + 3.0f * s2) * y[i + 1] + (s3 - s2) * h * m[i + 1];
+    }
+    v = CLAMP(v, 0.0f, 1.0f);
+    force[k] = (int)(v * 0xffff + 0.5f) / (float)0x10000;
+  }
+  return TRUE;
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *params,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_denoiseprofile_params_t *p = (const dt_iop_denoiseprofile_params_t *)params;
+  const dt_iop_denoiseprofile_params_t *def = self->default_params;
+  dt_iop_denoiseprofile_data_t *d = piece->data;
+
+  d->nbhood = p->nbhood;
+  d->central_pixel_weight = p->central_pixel_weight;
+  d->strength = p->strength;
+  d->overshooting = p->overshooting;
+  for(int i = 0; i < 3; i++)
+  {
+    d->a[i] = p->a[i];
+    d->b[i] = p->b[i];
+  }
+  d->mode = p->mode;
+  d->wavelet_color_mode = p->wavelet_color_mode;
+
+  d->radius = p->radius;
+  d->scattering = p->scattering;
+  d->shadows = p->shadows;
+  d->bias = p->bias;
+
+  // compare if a[0] in params is set to "magic value" -1.0 for autodetection
+  if(p->a[0] == -1.0)
+  {
+    const dt_noiseprofile_t interpolated =
+      _get_auto_profile(&pipe->image, p->compensate_hilite_pres);
+    for(int k = 0; k < 3; k++)
+    {
+      d->a[k] = interpolated.a[k];
+      d->b[k] = interpolated.b[k];
+    }
+
+    // darktable infers these in reload_defaults from the image's profile;
+    // our defaults come from the generic one, so redo it for untouched values
+    const float a = interpolated.a[1];
+    if(def && p->radius == def->radius) d->radius = infer_radius_from_profile(a);
+    if(def && p->scattering == def->scattering) d->scattering = infer_scattering_from_profile(a);
+    if(def && p->shadows == def->shadows) d->shadows = infer_shadows_from_profile(a);
+    if(def && p->bias == def->bias) d->bias = infer_bias_from_profile(a);
+  }
+
+  if((p->mode == MODE_NLMEANS_AUTO) || (p->mode == MODE_WAVELETS_AUTO))
+  {
+    const float gain = p->overshooting;
+    d->radius = infer_radius_from_profile(d->a[1] * gain);
+    d->scattering = infer_scattering_from_profile(d->a[1] * gain);
+    d->shadows = infer_shadows_from_profile(d->a[1] * gain);
+    d->bias = infer_bias_from_profile(d->a[1] * gain);
+  }
+
+  for(int ch = 0; ch < DT_DENOISE_PROFILE_NONE; ch++)
+    if(!_band_force(p->x[ch], p->y[ch], d->force[ch]))
+      memcpy(d->force[ch], p->y[ch], sizeof(d->force[ch]));
+
+  d->wb_adaptive_anscombe = p->wb_adaptive_anscombe;
+  d->fix_anscombe_and_nlmeans_norm = p->fix_anscombe_and_nlmeans_norm;
+  d->use_new_vst = p->use_new_vst;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_denoiseprofile_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_denoiseprofile_params_t *d = self->default_params;
+  if(!d) return;
+
+  memset(d, 0, sizeof(*d));
+
+  // reload_defaults() with the generic profile, flagged for autodetection
+  const float a = dt_noiseprofile_generic.a[1];
+  d->radius = infer_radius_from_profile(a);
+  d->nbhood = 7.0f;
+  d->strength = 1.0f;
+  d->shadows = infer_shadows_from_profile(a);
+  d->bias = infer_bias_from_profile(a);
+  d->scattering = infer_scattering_from_profile(a);
+  d->central_pixel_weight = 0.1f;
+  d->overshooting = 1.0f;
+  for(int k = 0; k < 3; k++)
+  {
+    d->a[k] = dt_noiseprofile_generic.a[k];
+    d->b[k] = dt_noiseprofile_generic.b[k];
+  }
+  // signal later autodetection in commit_params.
+  d->a[0] = -1.0f;
+  d->mode = MODE_WAVELETS;
+  for(int ch = 0; ch < DT_DENOISE_PROFILE_NONE; ch++)
+    for(int k = 0; k < DT_IOP_DENOISE_PROFILE_BANDS; k++)
+    {
+      d->x[ch][k] = k / (DT_IOP_DENOISE_PROFILE_BANDS - 1.f);
+      d->y[ch][k] = 0.5f;
+    }
+  d->wb_adaptive_anscombe = TRUE;
+  d->fix_anscombe_and_nlmeans_norm = TRUE;
+  d->use_new_vst = TRUE;
+  d->wavelet_color_mode = MODE_Y0U0V0;
+  // the shift is 0 for images without highlight preservation
+  d->compensate_hilite_pres = TRUE;
+
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_denoiseprofile_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->tiling_callback    = tiling_callback;
+}
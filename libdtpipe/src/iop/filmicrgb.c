@@ -0,0 +1,1049 @@
+/*
+ * filmicrgb.c - darktable filmic rgb IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/filmicrgb.c (GPLv3).
+ * GUI code, OpenCL, presets, auto-tuners and legacy_params() removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - The log encoding, filmic spline, display clamp and output power are
+ *     composed into log-domain LUTs in commit_params() (common/curve_lut.h):
+ *     one for the norm path, one for the per-channel path and one for the
+ *     v3/v4 desaturation factor.  process() does no log2f/powf on the v5/v6/v7
+ *     paths.
+ *   - The Yrg gamut-mapping matrices are built in commit_params() against
+ *     the pipeline colour space (linear Rec.709 D65).  There is no export
+ *     profile in libdtpipe, so gamut mapping always targets the pipeline.
+ *   - Highlight reconstruction (wavelet inpainting) is not ported;
+ *     enable_highlight_reconstruction is accepted and ignored.
+ *   - Colour science v3 (2019, DT_FILMIC_COLORSCIENCE_V1) is processed with
+ *     the v4 (2020) kernels.
+ *   - The per-pixel kernels are static inline functions taking only the
+ *     committed data, so they can be chained with other pointwise ops.
+ *
+ * Struct layout of dt_iop_filmicrgb_params_t MUST match the descriptor table
+ * in libdtpipe/src/pipe/params.c (_filmicrgb_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2019-2024 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+#include "common/curve_lut.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INVERSE_SQRT_3 0.5773502691896258f
+#define SAFETY_MARGIN 0.01f
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+typedef enum dt_iop_filmicrgb_methods_type_t
+{
+  DT_FILMIC_METHOD_NONE = 0,
+  DT_FILMIC_METHOD_MAX_RGB = 1,
+  DT_FILMIC_METHOD_LUMINANCE = 2,
+  DT_FILMIC_METHOD_POWER_NORM = 3,
+  DT_FILMIC_METHOD_EUCLIDEAN_NORM_V1 = 4,
+  DT_FILMIC_METHOD_EUCLIDEAN_NORM_V2 = 5,
+} dt_iop_filmicrgb_methods_type_t;
+
+typedef enum dt_iop_filmicrgb_curve_type_t
+{
+  DT_FILMIC_CURVE_POLY_4 = 0,
+  DT_FILMIC_CURVE_POLY_3 = 1,
+  DT_FILMIC_CURVE_RATIONAL = 2,
+} dt_iop_filmicrgb_curve_type_t;
+
+typedef enum dt_iop_filmicrgb_colorscience_type_t
+{
+  DT_FILMIC_COLORSCIENCE_V1 = 0, /* v3 (2019) */
+  DT_FILMIC_COLORSCIENCE_V2 = 1, /* v4 (2020) */
+  DT_FILMIC_COLORSCIENCE_V3 = 2, /* v5 (2021) */
+  DT_FILMIC_COLORSCIENCE_V4 = 3, /* v6 (2022) */
+  DT_FILMIC_COLORSCIENCE_V5 = 4, /* v7 (2023) */
+} dt_iop_filmicrgb_colorscience_type_t;
+
+typedef enum dt_iop_filmicrgb_spline_version_type_t
+{
+  DT_FILMIC_SPLINE_VERSION_V1 = 0,
+  DT_FILMIC_SPLINE_VERSION_V2 = 1,
+  DT_FILMIC_SPLINE_VERSION_V3 = 2,
+} dt_iop_filmicrgb_spline_version_type_t;
+
+typedef enum dt_iop_filmic_noise_distribution_t
+{
+  DT_FILMIC_NOISE_UNIFORM = 0,
+  DT_FILMIC_NOISE_GAUSSIAN = 1,
+  DT_FILMIC_NOISE_POISSONIAN = 2,
+} dt_iop_filmic_noise_distribution_t;
+
+/*
+ * IMPORTANT: field order and types must exactly match _filmicrgb_params_t
+ * in pipe/params.c so that memcpy-based history load/save works correctly.
+ */
+typedef struct dt_iop_filmicrgb_params_t
+{
+  float   grey_point_source;                /* [0, 100]   default 18.45         */
+  float   black_point_source;               /* [-16, -0.1] default -8           */
+  float   white_point_source;               /* [0.1, 16]  default 4             */
+  float   reconstruct_threshold;            /* [-6, 6]    default 0             */
+  float   reconstruct_feather;              /* [0.25, 6]  default 3             */
+  float   reconstruct_bloom_vs_details;     /* [-100, 100] default 100          */
+  float   reconstruct_grey_vs_color;        /* [-100, 100] default 100          */
+  float   reconstruct_structure_vs_texture; /* [-100, 100] default 0            */
+  float   security_factor;                  /* [-50, 200] default 0             */
+  float   grey_point_target;                /* [1, 50]    default 18.45         */
+  float   black_point_target;               /* [0, 20]    default 0.01517634    */
+  float   white_point_target;               /* [0, 1600]  default 100           */
+  float   output_power;                     /* [1, 10]    default 4             */
+  float   latitude;                         /* [0.01, 99] default 0.01          */
+  float   contrast;                         /* [0, 5]     default 1             */
+  float   saturation;                       /* [-200, 200] default 0            */
+  float   balance;                          /* [-50, 50]  default 0             */
+  float   noise_level;                      /* [0, 6]     default 0.2           */
+  int32_t preserve_color;                   /* dt_iop_filmicrgb_methods_type_t  */
+  int32_t version;                          /* dt_iop_filmicrgb_colorscience_type_t */
+  int32_t auto_hardness;                    /* bool                             */
+  int32_t custom_grey;                      /* bool                             */
+  int32_t high_quality_reconstruction;      /* [0, 10]    default 1             */
+  int32_t noise_distribution;               /* dt_iop_filmic_noise_distribution_t */
+  int32_t shadows;                          /* dt_iop_filmicrgb_curve_type_t    */
+  int32_t highlights;                       /* dt_iop_filmicrgb_curve_type_t    */
+  int32_t compensate_icc_black;             /* bool                             */
+  int32_t spline_version;                   /* dt_iop_filmicrgb_spline_version_type_t */
+  int32_t enable_highlight_reconstruction;  /* bool (ignored, see header)       */
+} dt_iop_filmicrgb_params_t;
+
+typedef struct dt_iop_filmic_rgb_spline_t
+{
+  dt_aligned_pixel_t M1, M2, M3, M4, M5;    /* factors for the interpolation polynom */
+  float latitude_min, latitude_max;         /* bounds of the linear part            */
+  float y[5];                               /* control nodes                        */
+  float x[5];                               /* control nodes                        */
+  dt_iop_filmicrgb_curve_type_t type[2];
+} dt_iop_filmic_rgb_spline_t;
+
+typedef struct dt_iop_filmicrgb_data_t
+{
+  float grey_source;
+  float black_source;
+  float dynamic_range;
+  float saturation;
+  float output_power;
+  float contrast;
+  float sigma_toe, sigma_shoulder;
+  float norm_min, norm_max;                 /* valid input range of the norm path */
+  float black_display, white_display;       /* after output power                 */
+  int preserve_color;
+  int version;
+  int spline_version;
+  dt_aligned_pixel_t luminance;             /* Y row of pipeline RGB -> XYZ       */
+  struct dt_iop_filmic_rgb_spline_t spline DT_ALIGNED_ARRAY;
+
+  dt_colormatrix_t input_matrix_trans;      /* pipeline RGB -> LMS 2006           */
+  dt_colormatrix_t output_matrix;           /* LMS 2006 -> pipeline RGB           */
+  dt_colormatrix_t output_matrix_trans;     /* LMS 2006 -> pipeline RGB           */
+
+  /* norm -> tone-mapped norm (v6/v7: display-clamped; v4/v5: CLIP) */
+  dt_curve_lut_t norm_curve;
+  /* channel -> tone-mapped channel (v6/v7 per-channel path) */
+  dt_curve_lut_t rgb_curve;
+  /* norm -> desaturation factor (v4/v5 chroma preservation) */
+  dt_curve_lut_t desaturation;
+} dt_iop_filmicrgb_data_t;
+
+/* ── Gaussian elimination (from darktable src/iop/gaussian_elimination.h) ── */
+
+/* Gaussian elimination with partial pivoting; A is row-major and becomes
+ * triangular, p records the row swaps.  Returns 0 if A is singular. */
+static int _gauss_make_triangular(double *A, int *p, int n)
+{
+  p[n - 1] = n - 1;
+  for(int k = 0; k < n; ++k)
+  {
+    int m = k;
+    for(int i = k + 1; i < n; ++i)
+      if(fabs(A[k + n * i]) > fabs(A[k + n * m])) m = i;
+    p[k] = m;
+    const double t1 = A[k + n * m];
+    A[k + n * m] = A[k + n * k];
+    A[k + n * k] = t1;
+    if(t1 == 0) return 0;
+
+    for(int i = k + 1; i < n; ++i) A[k + n * i] /= -t1;
+    if(k != m)
+      for(int i = k + 1; i < n; ++i)
+      {
+        const double t2 = A[i + n * m];
+        A[i + n * m] = A[i + n * k];
+        A[i + n * k] = t2;
+      }
+    for(int j = k + 1; j < n; ++j)
+      for(int i = k + 1; i < n; ++i) A[i + n * j] += A[k + j * n] * A[i + k * n];
+  }
+  return 1;
+}
+
+static void _gauss_solve_triangular(const double *A, const int *p, double *b, int n)
+{
+  for(int k = 0; k < n - 1; ++k)
+  {
+    const int m = p[k];
+    const double t = b[m];
+    b[m] = b[k];
+    b[k] = t;
+    for(int i = k + 1; i < n; ++i) b[i] += A[k + n * i] * t;
+  }
+  for(int k = n - 1; k > 0; --k)
+  {
+    b[k] /= A[k + n * k];
+    const double t = b[k];
+    for(int i = 0; i < k; ++i) b[i] -= A[k + n * i] * t;
+  }
+  b[0] /= A[0];
+}
+
+/* n is at most 5 here, so the pivot vector lives on the stack */
+static int _gauss_solve(double *A, double *b, int n)
+{
+  int p[8];
+  const int ok = _gauss_make_triangular(A, p, n);
+  if(ok) _gauss_solve_triangular(A, p, b, n);
+  return ok;
+}
+
+/* ── Curve ──────────────────────────────────────────────────────────────── */
+
+DT_OMP_DECLARE_SIMD(aligned(pixel:16))
+static inline float _pixel_rgb_norm_power(const dt_aligned_pixel_t pixel)
+{
+  /* (R^3 + G^3 + B^3) / (R^2 + G^2 + B^2), in ]0; +inf[ */
+  float numerator = 0.0f;
+  float denominator = 0.0f;
+
+  for(int c = 0; c < 3; c++)
+  {
+    const float value = fabsf(pixel[c]);
+    const float RGB_square = value * value;
+    const float RGB_cubic = RGB_square * value;
+    numerator += RGB_cubic;
+    denominator += RGB_square;
+  }
+
+  return numerator / fmaxf(denominator, 1e-12f);
+}
+
+static inline float _luminance(const dt_aligned_pixel_t pixel, const float *const luminance)
+{
+  return luminance[0] * pixel[0] + luminance[1] * pixel[1] + luminance[2] * pixel[2];
+}
+
+/* Any new norm must satisfy norm(x, x, x) = x; the desaturation relies on it.
+ * EUCLIDEAN_NORM_V1 is the legacy exception. */
+static inline float _get_pixel_norm(const dt_aligned_pixel_t pixel,
+                                    const dt_iop_filmicrgb_methods_type_t variant,
+                                    const float *const luminance)
+{
+  switch(variant)
+  {
+    case DT_FILMIC_METHOD_MAX_RGB:
+      return max3f(pixel);
+
+    case DT_FILMIC_METHOD_POWER_NORM:
+      return _pixel_rgb_norm_power(pixel);
+
+    case DT_FILMIC_METHOD_EUCLIDEAN_NORM_V1:
+      return sqrtf(sqf(pixel[0]) + sqf(pixel[1]) + sqf(pixel[2]));
+
+    case DT_FILMIC_METHOD_EUCLIDEAN_NORM_V2:
+      return sqrtf(sqf(pixel[0]) + sqf(pixel[1]) + sqf(pixel[2])) * INVERSE_SQRT_3;
+
+    case DT_FILMIC_METHOD_LUMINANCE:
+    default:
+      return _luminance(pixel, luminance);
+  }
+}
+
+static inline float _log_tonemapping(const float x, const float grey, const float black,
+                                     const float dynamic_range)
+{
+  return CLIP((log2f(x / grey) - black) / dynamic_range);
+}
+
+static inline float _exp_tonemapping(const float x, const float grey, const float black,
+                                     const float dynamic_range)
+{
+  /* inverse of _log_tonemapping */
+  return grey * exp2f(dynamic_range * x + black);
+}
+
+static inline float _filmic_spline(const float x, const dt_iop_filmic_rgb_spline_t *const spline)
+{
+  /* polynomial: y = M5 x^4 + M4 x^3 + M3 x^2 + M2 x + M1 (Horner)
+   * rational:   y = M1 (M2 (x - x0)^2 + (x - x0)) / (M2 (x - x0)^2 + (x - x0) + M3) */
+  float result;
+
+  if(x < spline->latitude_min)
+  {
+    /* toe */
+    if(spline->type[0] == DT_FILMIC_CURVE_POLY_4)
+      result = spline->M1[0] + x * (spline->M2[0] + x * (spline->M3[0] + x * (spline->M4[0] + x * spline->M5[0])));
+    else if(spline->type[0] == DT_FILMIC_CURVE_POLY_3)
+      result = spline->M1[0] + x * (spline->M2[0] + x * (spline->M3[0] + x * spline->M4[0]));
+    else
+    {
+      const float xi = spline->latitude_min - x;
+      const float rat = xi * (xi * spline->M2[0] + 1.f);
+      result = spline->M4[0] - spline->M1[0] * rat / (rat + spline->M3[0]);
+    }
+  }
+  else if(x > spline->latitude_max)
+  {
+    /* shoulder */
+    if(spline->type[1] == DT_FILMIC_CURVE_POLY_4)
+      result = spline->M1[1] + x * (spline->M2[1] + x * (spline->M3[1] + x * (spline->M4[1] + x * spline->M5[1])));
+    else if(spline->type[1] == DT_FILMIC_CURVE_POLY_3)
+      result = spline->M1[1] + x * (spline->M2[1] + x * (spline->M3[1] + x * spline->M4[1]));
+    else
+    {
+      const float xi = x - spline->latitude_max;
+      const float rat = xi * (xi * spline->M2[1] + 1.f);
+      result = spline->M4[1] + spline->M1[1] * rat / (rat + spline->M3[1]);
+    }
+  }
+  else
+  {
+    /* latitude */
+    result = spline->M1[2] + x * spline->M2[2];
+  }
+
+  return result;
+}
+
+static inline float _filmic_desaturate_v2(const float x, const float sigma_toe, const float sigma_shoulder,
+                                          const float saturation)
+{
+  const float radius_toe = x;
+  const float radius_shoulder = 1.0f - x;
+  const float sat2 = 0.5f / sqrtf(saturation);
+  const float key_toe = expf(-radius_toe * radius_toe / sigma_toe * sat2);
+  const float key_shoulder = expf(-radius_shoulder * radius_shoulder / sigma_shoulder * sat2);
+
+  return (saturation - (key_toe + key_shoulder) * (saturation));
+}
+
+static inline float _linear_saturation(const float x, const float luminance, const float saturation)
+{
+  return luminance + saturation * (x - luminance);
+}
+
+/* ── LUT sources ────────────────────────────────────────────────────────── */
+
+static inline float _log_encode(const float x, const dt_iop_filmicrgb_data_t *const d)
+{
+  return _log_tonemapping(x, d->grey_source, d->black_source, d->dynamic_range);
+}
+
+/* v6/v7 norm: log encoding, spline, clamp to display range, output power */
+static float _norm_curve_v4(const float x, const void *data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  const float y = _filmic_spline(_log_encode(x, d), &d->spline);
+  return powf(CLAMP(y, d->spline.y[0], d->spline.y[4]), d->output_power);
+}
+
+/* v4/v5 norm: same with the spline output clipped to [0, 1] */
+static float _norm_curve_v2(const float x, const void *data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  const float y = _filmic_spline(_log_encode(x, d), &d->spline);
+  return powf(CLIP(y), d->output_power);
+}
+
+/* v6/v7 per channel: components may reach 0, luminance is clamped later */
+static float _rgb_curve_v4(const float x, const void *data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  const float y = _filmic_spline(_log_encode(x, d), &d->spline);
+  return powf(CLAMP(y, 0.0f, d->spline.y[4]), d->output_power);
+}
+
+static float _desaturation_v2(const float x, const void *data)
+{
+  const dt_iop_filmicrgb_data_t *const d = data;
+  return _filmic_desaturate_v2(_log_encode(x, d), d->sigma_toe, d->sigma_shoulder, d->saturation);
+}
+
+/* ── Gamut mapping ──────────────────────────────────────────────────────── */
+
+static inline void _filmic_desaturate_v4(const dt_aligned_pixel_t Ych_original,
+                                         dt_aligned_pixel_t Ych_final,
+                                         const float saturation)
+{
+  /* Ych is normalised through LMS, so c is a saturation (chroma / brightness).
+   * Fit chroma = c1 + saturation * (c2 - c1): 0 keeps the tone-mapped chroma,
+   * > 0 goes back towards the original, < 0 amplifies the change. */
+  const float chroma_original = Ych_original[1] * Ych_original[0];
+  float chroma_final = Ych_final[1] * Ych_final[0];
+
+  const float delta_chroma = saturation * (chroma_original - chroma_final);
+
+  const int filmic_brightens = (Ych_final[0] > Ych_original[0]);
+  const int filmic_resat = (chroma_original < chroma_final);
+  const int filmic_desat = (chroma_original > chroma_final);
+  const int user_resat = (saturation > 0.f);
+  const int user_desat = (saturation < 0.f);
+
+  chroma_final = (filmic_brightens && filmic_resat)
+                  ? (chroma_original + chroma_final) / 2.f
+                  : ((user_resat && filmic_desat) || user_desat)
+                      ? chroma_final + delta_chroma
+                      : chroma_final;
+
+  Ych_final[1] = MAX(chroma_final / Ych_final[0], 0.f);
+}
+
+static inline void _gamut_check_RGB(const dt_iop_filmicrgb_data_t *const d,
+                                    const dt_aligned_pixel_t Ych_in,
+                                    dt_aligned_pixel_t RGB_out)
+{
+  /* amount of white light that would bring negatives back in gamut */
+  dt_aligned_pixel_t RGB_brightened = { 0.f };
+  Ych_to_RGB(Ych_in, d->output_matrix_trans, RGB_brightened);
+  const float min_pix = MIN(MIN(RGB_brightened[0], RGB_brightened[1]), RGB_brightened[2]);
+  const float black_offset = MAX(-min_pix, 0.f);
+  for_each_channel(c) RGB_brightened[c] += black_offset;
+  dt_aligned_pixel_t Ych_brightened = { 0.f };
+  RGB_to_Ych(RGB_brightened, d->input_matrix_trans, Ych_brightened);
+
+  /* raise the luminance a little, then find the chroma that fits */
+  const float Y = CLAMP((Ych_in[0] + Ych_brightened[0]) / 2.f,
+                        CIE_Y_1931_to_CIE_Y_2006(d->black_display),
+                        CIE_Y_1931_to_CIE_Y_2006(d->white_display));
+
+  const float cos_h = Ych_in[2];
+  const float sin_h = Ych_in[3];
+  const float new_chroma = MIN(Ych_in[1], Ych_max_chroma(d->output_matrix, d->white_display, Y, cos_h, sin_h));
+
+  const dt_aligned_pixel_t Ych = { Y, new_chroma, cos_h, sin_h };
+  Ych_to_RGB(Ych, d->output_matrix_trans, RGB_out);
+
+  /* final catch-all */
+  for_each_channel(c, aligned(RGB_out))
+    RGB_out[c] = CLAMP(RGB_out[c], 0.f, d->white_display);
+}
+
+static inline void _gamut_mapping(const dt_iop_filmicrgb_data_t *const d,
+                                  dt_aligned_pixel_t Ych_final,
+                                  const dt_aligned_pixel_t Ych_original,
+                                  dt_aligned_pixel_t pix_out,
+                                  const float saturation)
+{
+  /* force final hue to original */
+  Ych_final[2] = Ych_original[2];
+  Ych_final[3] = Ych_original[3];
+
+  Ych_final[0] = CLAMP(Ych_final[0],
+                       CIE_Y_1931_to_CIE_Y_2006(d->black_display),
+                       CIE_Y_1931_to_CIE_Y_2006(d->white_display));
+
+  _filmic_desaturate_v4(Ych_original, Ych_final, saturation);
+  gamut_check_Yrg(Ych_final);
+
+  /* Y is clipped already, any channel above display white is due to c */
+  _gamut_check_RGB(d, Ych_final, pix_out);
+}
+
+/* ── Per-pixel kernels ──────────────────────────────────────────────────── */
+
+/* v6/v7 norm path: the norm is clamped before computing the ratios, else
+ * clipped raw areas turn into colourful patches darker than surroundings. */
+static inline void _norm_tone_mapping_v4(const dt_iop_filmicrgb_data_t *const d,
+                                         const float *const pix_in,
+                                         dt_aligned_pixel_t pix_out,
+                                         const dt_iop_filmicrgb_methods_type_t type)
+{
+  const float norm = CLAMPF(_get_pixel_norm(pix_in, type, d->luminance), d->norm_min, d->norm_max);
+  const float mapped = dt_curve_lut_eval(&d->norm_curve, norm);
+  const float ratio = mapped / norm;
+  for_each_channel(c)
+    pix_out[c] = pix_in[c] * ratio;
+}
+
+/** v7 (2023): mix of per-channel and max RGB tone mapping. */
+static inline void _filmic_v5_pixel(const dt_iop_filmicrgb_data_t *const d,
+                                    const float *const pix_in,
+                                    dt_aligned_pixel_t pix_out)
+{
+  dt_aligned_pixel_t max_rgb = { 0.f };
+  dt_aligned_pixel_t naive_rgb = { 0.f };
+
+  dt_curve_lut_eval_rgb(&d->rgb_curve, pix_in, naive_rgb);
+  _norm_tone_mapping_v4(d, pix_in, max_rgb, DT_FILMIC_METHOD_MAX_RGB);
+
+  for_each_channel(c)
+    pix_out[c] = (0.5f - d->saturation) * naive_rgb[c] + (0.5f + d->saturation) * max_rgb[c];
+
+  dt_aligned_pixel_t Ych_original = { 0.f };
+  RGB_to_Ych(pix_in, d->input_matrix_trans, Ych_original);
+
+  dt_aligned_pixel_t Ych_final = { 0.f };
+  RGB_to_Ych(pix_out, d->input_matrix_trans, Ych_final);
+
+  Ych_final[1] = fminf(Ych_original[1], Ych_final[1]);
+
+  _gamut_mapping(d, Ych_final, Ych_original, pix_out, 0.0f);
+}
+
+/** v6 (2022) with chroma preservation. */
+static inline void _filmic_chroma_v4_pixel(const dt_iop_filmicrgb_data_t *const d,
+                                           const float *const pix_in,
+                                           dt_aligned_pixel_t pix_out)
+{
+  _norm_tone_mapping_v4(d, pix_in, pix_out, d->preserve_color);
+
+  dt_aligned_pixel_t Ych_original = { 0.f };
+  RGB_to_Ych(pix_in, d->input_matrix_trans, Ych_original);
+
+  dt_aligned_pixel_t Ych_final = { 0.f };
+  RGB_to_Ych(pix_out, d->input_matrix_trans, Ych_final);
+
+  _gamut_mapping(d, Ych_final, Ych_original, pix_out, d->saturation);
+}
+
+/** v6 (2022) without chroma preservation. */
+static inline void _filmic_split_v4_pixel(const dt_iop_filmicrgb_data_t *const d,
+                                          const float *const pix_in,
+                                          dt_aligned_pixel_t pix_out)
+{
+  dt_curve_lut_eval_rgb(&d->rgb_curve, pix_in, pix_out);
+
+  dt_aligned_pixel_t Ych_original = { 0.f };
+  RGB_to_Ych(pix_in, d->input_matrix_trans, Ych_original);
+
+  dt_aligned_pixel_t Ych_final = { 0.f };
+  RGB_to_Ych(pix_out, d->input_matrix_trans, Ych_final);
+
+  Ych_final[1] = MIN(Ych_original[1], Ych_final[1]);
+
+  _gamut_mapping(d, Ych_final, Ych_original, pix_out, d->saturation);
+}
+
+/** v4/v5 (2020/2021) with chroma preservation. */
+static inline void _filmic_chroma_v2_v3_pixel(const dt_iop_filmicrgb_data_t *const d,
+                                              const float *const pix_in,
+                                              dt_aligned_pixel_t pix_out)
+{
+  const float norm_in = MAX(_get_pixel_norm(pix_in, d->preserve_color, d->luminance), NORM_MIN);
+
+  dt_aligned_pixel_t ratios = { 0.0f };
+  for_each_channel(c)
+    ratios[c] = pix_in[c] / norm_in;
+
+  /* sanitize the ratios */
+  const float min_ratios = MIN(MIN(ratios[0], ratios[1]), ratios[2]);
+  if(min_ratios < 0.0f)
+    for_each_channel(c)
+      ratios[c] -= min_ratios;
+
+  const float desaturation = dt_curve_lut_eval(&d->desaturation, norm_in);
+  float norm = dt_curve_lut_eval(&d->norm_curve, norm_in);
+
+  /* re-apply ratios with saturation change */
+  for_each_channel(c)
+    ratios[c] = MAX(ratios[c] + (1.0f - ratios[c]) * (1.0f - desaturation), 0.0f);
+
+  /* v5: normalise again, the norm might have changed by the desaturation */
+  if(d->version == DT_FILMIC_COLORSCIENCE_V3)
+    norm /= MAX(_get_pixel_norm(ratios, d->preserve_color, d->luminance), NORM_MIN);
+
+  for_each_channel(c)
+    pix_out[c] = ratios[c] * norm;
+
+  /* penalize the ratios by the amount of clipping */
+  const float max_pix = max3f(pix_out);
+  if(max_pix > 1.0f)
+  {
+    for_each_channel(c)
+    {
+      ratios[c] = fmaxf(ratios[c] + (1.0f - max_pix), 0.0f);
+      pix_out[c] = CLIP(ratios[c] * norm);
+    }
+  }
+}
+
+/** v4/v5 (2020/2021) without chroma preservation.  The desaturation mixes
+ *  channels in the log domain before the spline, so no LUT applies here. */
+static inline void _filmic_split_v2_v3_pixel(const dt_iop_filmicrgb_data_t *const d,
+                                             const float *const pix_in,
+                                             dt_aligned_pixel_t pix_out)
+{
+  dt_aligned_pixel_t temp;
+  for_each_channel(c)
+    temp[c] = _log_encode(MAX(pix_in[c], NORM_MIN), d);
+
+  const float lum = _luminance(temp, d->luminance);
+  const float desaturation = _filmic_desaturate_v2(lum, d->sigma_toe, d->sigma_shoulder, d->saturation);
+
+  pix_out[3] = 0.0f;
+  for(size_t c = 0; c < 3; c++)
+  {
+    const float y = _filmic_spline(_linear_saturation(temp[c], lum, desaturation), &d->spline);
+    pix_out[c] = powf(CLIP(y), d->output_power);
+  }
+}
+
+/* ── process ────────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_filmicrgb_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t n = 4 * (size_t)roi_out->width * roi_out->height;
+
+  if(d->version == DT_FILMIC_COLORSCIENCE_V5)
+  {
+    DT_OMP_FOR()
+    for(size_t k = 0; k < n; k += 4)
+    {
+      dt_aligned_pixel_t pix_out;
+      _filmic_v5_pixel(d, in + k, pix_out);
+      pix_out[3] = in[k + 3];
+      copy_pixel(out + k, pix_out);
+    }
+  }
+  else if(d->version == DT_FILMIC_COLORSCIENCE_V4)
+  {
+    const int preserve = d->preserve_color != DT_FILMIC_METHOD_NONE;
+    DT_OMP_FOR()
+    for(size_t k = 0; k < n; k += 4)
+    {
+      dt_aligned_pixel_t pix_out;
+      if(preserve)
+        _filmic_chroma_v4_pixel(d, in + k, pix_out);
+      else
+        _filmic_split_v4_pixel(d, in + k, pix_out);
+      pix_out[3] = in[k + 3];
+      copy_pixel(out + k, pix_out);
+    }
+  }
+  else
+  {
+    const int preserve = d->preserve_color != DT_FILMIC_METHOD_NONE;
+    DT_OMP_FOR()
+    for(size_t k = 0; k < n; k += 4)
+    {
+      dt_aligned_pixel_t pix_out;
+      if(preserve)
+        _filmic_chroma_v2_v3_pixel(d, in + k, pix_out);
+      else
+        _filmic_split_v2_v3_pixel(d, in + k, pix_out);
+      pix_out[3] = in[k + 3];
+      copy_pixel(out + k, pix_out);
+    }
+  }
+}
+
+/* ── Spline ─────────────────────────────────────────────────────────────── */
+
+#define ORDER_4 5
+#define ORDER_3 4
+
+static void _compute_spline(const dt_iop_filmicrgb_params_t *const p,
+                            dt_iop_filmic_rgb_spline_t *const spline)
+{
+  float grey_display;
+
+  if(p->custom_grey)
+    grey_display = powf(CLAMP(p->grey_point_target, p->black_point_target, p->white_point_target) / 100.0f,
+                        1.0f / (p->output_power));
+  else
+    grey_display = powf(0.1845f, 1.0f / (p->output_power));
+
+  const float white_source = p->white_point_source;
+  const float black_source = p->black_point_source;
+  const float dynamic_range = white_source - black_source;
+
+  /* luminance after log encoding */
+  const float black_log = 0.0f;
+  const float grey_log = fabsf(p->black_point_source) / dynamic_range;
+  const float white_log = 1.0f;
+
+  /* target luminance desired after filmic curve */
+  float black_display, white_display;
+
+  if(p->spline_version == DT_FILMIC_SPLINE_VERSION_V1)
+  {
+    /* buggy v1: ignores the output power */
+    black_display = CLAMP(p->black_point_target, 0.0f, p->grey_point_target) / 100.0f;
+    white_display = fmaxf(p->white_point_target, p->grey_point_target) / 100.0f;
+  }
+  else
+  {
+    black_display = powf(CLAMP(p->black_point_target, 0.0f, p->grey_point_target) / 100.0f,
+                         1.0f / (p->output_power));
+    white_display = powf(fmaxf(p->white_point_target, p->grey_point_target) / 100.0f,
+                         1.0f / (p->output_power));
+  }
+
+  float toe_log, shoulder_log, toe_display, shoulder_display, contrast;
+  const float balance = CLAMP(p->balance, -50.0f, 50.0f) / 100.0f;
+  if(p->spline_version < DT_FILMIC_SPLINE_VERSION_V3)
+  {
+    const float latitude = CLAMP(p->latitude, 0.0f, 100.0f) / 100.0f * dynamic_range;
+    contrast = CLAMP(p->contrast, 1.00001f, 6.0f);
+
+    toe_log = grey_log - latitude / dynamic_range * fabsf(black_source / dynamic_range);
+    shoulder_log = grey_log + latitude / dynamic_range * fabsf(white_source / dynamic_range);
+
+    const float linear_intercept = grey_display - (contrast * grey_log);
+
+    toe_display = (toe_log * contrast + linear_intercept);
+    shoulder_display = (shoulder_log * contrast + linear_intercept);
+
+    /* highlights/shadows balance as a shift along the contrast slope */
+    const float norm = sqrtf(contrast * contrast + 1.0f);
+    const float coeff = -((2.0f * latitude) / dynamic_range) * balance;
+
+    toe_display += coeff * contrast / norm;
+    shoulder_display += coeff * contrast / norm;
+    toe_log += coeff / norm;
+    shoulder_log += coeff / norm;
+  }
+  else
+  {
+    /* v3: slope depends on contrast only, latitude is % of display range */
+    const float hardness = p->output_power;
+    const float latitude = CLAMP(p->latitude, 0.0f, 100.0f) / 100.0f;
+    const float slope = p->contrast * dynamic_range / 8.0f;
+    float min_contrast = 1.0f;
+    /* enough contrast to reach white_display and black_display */
+    min_contrast = fmaxf(min_contrast, (white_display - grey_display) / (white_log - grey_log));
+    min_contrast = fmaxf(min_contrast, (grey_display - black_display) / (grey_log - black_log));
+    min_contrast += SAFETY_MARGIN;
+    /* f(x) = (contrast * x + intercept)^hardness has slope
+     * contrast * hardness * grey_display^(hardness - 1) at grey */
+    contrast = slope / (hardness * powf(grey_display, hardness - 1.0f));
+    contrast = CLAMP(contrast, min_contrast, 100.0f);
+
+    const float linear_intercept = grey_display - (contrast * grey_log);
+
+    /* x where the line reaches black/white display, with safety margin */
+    const float xmin = (black_display + SAFETY_MARGIN * (white_display - black_display) - linear_intercept) / contrast;
+    const float xmax = (white_display - SAFETY_MARGIN * (white_display - black_display) - linear_intercept) / contrast;
+
+    toe_log = (1.0f - latitude) * grey_log + latitude * xmin;
+    shoulder_log = (1.0f - latitude) * grey_log + latitude * xmax;
+
+    const float balance_correction = (balance > 0.0f) ? 2.0f * balance * (shoulder_log - grey_log)
+                                                      : 2.0f * balance * (grey_log - toe_log);
+    toe_log -= balance_correction;
+    shoulder_log -= balance_correction;
+    toe_log = fmaxf(toe_log, xmin);
+    shoulder_log = MIN(shoulder_log, xmax);
+
+    toe_display = (toe_log * contrast + linear_intercept);
+    shoulder_display = (shoulder_log * contrast + linear_intercept);
+  }
+
+  spline->x[0] = black_log;
+  spline->x[1] = toe_log;
+  spline->x[2] = grey_log;
+  spline->x[3] = shoulder_log;
+  spline->x[4] = white_log;
+
+  spline->y[0] = black_display;
+  spline->y[1] = toe_display;
+  spline->y[2] = grey_display;
+  spline->y[3] = shoulder_display;
+  spline->y[4] = white_display;
+
+  spline->latitude_min = spline->x[1];
+  spline->latitude_max = spline->x[3];
+
+  spline->type[0] = p->shadows;
+  spline->type[1] = p->highlights;
+
+  /* https://eng.aurelienpierre.com/2018/11/30/filmic-darktable-and-the-quest-of-the-hdr-tone-mapping/#filmic_s_curve */
+  const double Tl = spline->x[1];
+  const double Tl2 = Tl * Tl;
+  const double Tl3 = Tl2 * Tl;
+  const double Tl4 = Tl3 * Tl;
+
+  const double Sl = spline->x[3];
+  const double Sl2 = Sl * Sl;
+  const double Sl3 = Sl2 * Sl;
+  const double Sl4 = Sl3 * Sl;
+
+  /* linear central part */
+  spline->M2[2] = contrast;
+  spline->M1[2] = spline->y[1] - spline->M2[2] * spline->x[1];
+  spline->M3[2] = 0.f;
+  spline->M4[2] = 0.f;
+  spline->M5[2] = 0.f;
+
+  /* toe */
+  if(p->shadows == DT_FILMIC_CURVE_POLY_4)
+  {
+    double A0[ORDER_4 * ORDER_4] = { 0.,        0.,       0.,      0., 1.,
+                                     0.,        0.,       0.,      1., 0.,
+                                     Tl4,       Tl3,      Tl2,     Tl, 1.,
+                                     4. * Tl3,  3. * Tl2, 2. * Tl, 1., 0.,
+                                     12. * Tl2, 6. * Tl,  2.,      0., 0. };
+
+    double b0[ORDER_4] = { spline->y[0], 0., spline->y[1], spline->M2[2], 0. };
+
+    _gauss_solve(A0, b0, ORDER_4);
+
+    spline->M5[0] = b0[0];
+    spline->M4[0] = b0[1];
+    spline->M3[0] = b0[2];
+    spline->M2[0] = b0[3];
+    spline->M1[0] = b0[4];
+  }
+  else if(p->shadows == DT_FILMIC_CURVE_POLY_3)
+  {
+    double A0[ORDER_3 * ORDER_3] = { 0.,       0.,      0., 1.,
+                                     Tl3,      Tl2,     Tl, 1.,
+                                     3. * Tl2, 2. * Tl, 1., 0.,
+                                     6. * Tl,  2.,      0., 0. };
+
+    double b0[ORDER_3] = { spline->y[0], spline->y[1], spline->M2[2], 0. };
+
+    _gauss_solve(A0, b0, ORDER_3);
+
+    spline->M5[0] = 0.0f;
+    spline->M4[0] = b0[0];
+    spline->M3[0] = b0[1];
+    spline->M2[0] = b0[2];
+    spline->M1[0] = b0[3];
+  }
+  else
+  {
+    const float x = toe_log - black_log;
+    const float y = toe_display - black_display;
+    const float g = contrast;
+    const float b = g / (2.f * y) + (sqrtf(sqf(x * g / y + 1.f) - 4.f) - 1.f) / (2.f * x);
+    const float c = y / g * (b * sqf(x) + x) / (b * sqf(x) + x - (y / g));
+    const float a = c * g;
+    spline->M1[0] = a;
+    spline->M2[0] = b;
+    spline->M3[0] = c;
+    spline->M4[0] = toe_display;
+  }
+
+  /* shoulder */
+  if(p->highlights == DT_FILMIC_CURVE_POLY_3)
+  {
+    double A1[ORDER_3 * ORDER_3] = { 1.,       1.,      1., 1.,
+                                     Sl3,      Sl2,     Sl, 1.,
+                                     3. * Sl2, 2. * Sl, 1., 0.,
+                                     6. * Sl,  2.,      0., 0. };
+
+    double b1[ORDER_3] = { spline->y[4], spline->y[3], spline->M2[2], 0. };
+
+    _gauss_solve(A1, b1, ORDER_3);
+
+    spline->M5[1] = 0.0f;
+    spline->M4[1] = b1[0];
+    spline->M3[1] = b1[1];
+    spline->M2[1] = b1[2];
+    spline->M1[1] = b1[3];
+  }
+  else if(p->highlights == DT_FILMIC_CURVE_POLY_4)
+  {
+    double A1[ORDER_4 * ORDER_4] = { 1.,        1.,       1.,      1., 1.,
+                                     4.,        3.,       2.,      1., 0.,
+                                     Sl4,       Sl3,      Sl2,     Sl, 1.,
+                                     4. * Sl3,  3. * Sl2, 2. * Sl, 1., 0.,
+                                     12. * Sl2, 6. * Sl,  2.,      0., 0. };
+
+    double b1[ORDER_4] = { spline->y[4], 0., spline->y[3], spline->M2[2], 0. };
+
+    _gauss_solve(A1, b1, ORDER_4);
+
+    spline->M5[1] = b1[0];
+    spline->M4[1] = b1[1];
+    spline->M3[1] = b1[2];
+    spline->M2[1] = b1[3];
+    spline->M1[1] = b1[4];
+  }
+  else
+  {
+    const float x = white_log - shoulder_log;
+    const float y = white_display - shoulder_display;
+    const float g = contrast;
+    const float b = g / (2.f * y) + (sqrtf(sqf(x * g / y + 1.f) - 4.f) - 1.f) / (2.f * x);
+    const float c = y / g * (b * sqf(x) + x) / (b * sqf(x) + x - (y / g));
+    const float a = c * g;
+    spline->M1[1] = a;
+    spline->M2[1] = b;
+    spline->M3[1] = c;
+    spline->M4[1] = shoulder_display;
+  }
+}
+
+/* ── commit_params ──────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_filmicrgb_params_t *p = (const dt_iop_filmicrgb_params_t *)p1;
+  dt_iop_filmicrgb_data_t *d = piece->data;
+
+  const float grey_source = p->custom_grey ? p->grey_point_source / 100.0f : 0.1845f;
+
+  d->dynamic_range = p->white_point_source - p->black_point_source;
+  d->black_source = p->black_point_source;
+  d->grey_source = grey_source;
+  d->output_power = p->output_power;
+  d->contrast = p->contrast;
+  d->version = p->version;
+  d->spline_version = p->spline_version;
+  d->preserve_color = p->preserve_color;
+
+  _compute_spline(p, &d->spline);
+
+  if(p->version >= DT_FILMIC_COLORSCIENCE_V4)
+    d->saturation = p->saturation / 100.0f;
+  else
+    d->saturation = (2.0f * p->saturation / 100.0f + 1.0f);
+
+  d->sigma_toe = powf(d->spline.latitude_min / 3.0f, 2.0f);
+  d->sigma_shoulder = powf((1.0f - d->spline.latitude_max) / 3.0f, 2.0f);
+
+  d->white_display = powf(d->spline.y[4], d->output_power);
+  d->black_display = powf(d->spline.y[0], d->output_power);
+
+  d->norm_min = _exp_tonemapping(0.f, d->grey_source, d->black_source, d->dynamic_range);
+  d->norm_max = _exp_tonemapping(1.f, d->grey_source, d->black_source, d->dynamic_range);
+
+  /* pipeline colour space: luminance row and Yrg matrices */
+  dt_colorspaces_rgb_space_t pipe_space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &pipe_space);
+  for(int c = 0; c < 3; c++) d->luminance[c] = pipe_space.matrix_in[1][c];
+  d->luminance[3] = 0.f;
+
+  dt_colormatrix_t input_matrix;
+  prepare_RGB_Yrg_matrices(&pipe_space, input_matrix, d->output_matrix);
+  dt_colormatrix_transpose(d->input_matrix_trans, input_matrix);
+  dt_colormatrix_transpose(d->output_matrix_trans, d->output_matrix);
+
+  /* the log encoding is constant outside [norm_min, norm_max]; one octave
+   * of margin on either side */
+  const int lo_exp = (int)floorf(log2f(d->norm_min)) - 1;
+  const int hi_exp = (int)ceilf(log2f(d->norm_max)) + 1;
+
+  if(p->version >= DT_FILMIC_COLORSCIENCE_V4)
+  {
+    dt_curve_lut_init(&d->norm_curve, lo_exp, hi_exp, _norm_curve_v4, d);
+    dt_curve_lut_init(&d->rgb_curve, lo_exp, hi_exp, _rgb_curve_v4, d);
+  }
+  else
+  {
+    dt_curve_lut_init(&d->norm_curve, lo_exp, hi_exp, _norm_curve_v2, d);
+    dt_curve_lut_init(&d->desaturation, lo_exp, hi_exp, _desaturation_v2, d);
+  }
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_filmicrgb_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_filmicrgb_params_t *p = self->default_params;
+  if(!p) return;
+
+  memset(p, 0, sizeof(*p));
+
+  p->grey_point_source                = 18.45f;
+  p->black_point_source               = -8.0f;
+  p->white_point_source               = 4.0f;
+  p->reconstruct_threshold            = 0.0f;
+  p->reconstruct_feather              = 3.0f;
+  p->reconstruct_bloom_vs_details     = 100.0f;
+  p->reconstruct_grey_vs_color        = 100.0f;
+  p->reconstruct_structure_vs_texture = 0.0f;
+  p->security_factor                  = 0.0f;
+  p->grey_point_target                = 18.45f;
+  p->black_point_target               = 0.01517634f;
+  p->white_point_target               = 100.0f;
+  p->output_power                     = 4.0f;
+  p->latitude                         = 0.01f;
+  p->contrast                         = 1.0f;
+  p->saturation                       = 0.0f;
+  p->balance                          = 0.0f;
+  p->noise_level                      = 0.2f;
+  p->preserve_color                   = DT_FILMIC_METHOD_POWER_NORM;
+  p->version                          = DT_FILMIC_COLORSCIENCE_V5;
+  p->auto_hardness                    = TRUE;
+  p->custom_grey                      = FALSE;
+  p->high_quality_reconstruction      = 1;
+  p->noise_distribution               = DT_FILMIC_NOISE_GAUSSIAN;
+  p->shadows                          = DT_FILMIC_CURVE_POLY_4;
+  p->highlights                       = DT_FILMIC_CURVE_POLY_4;
+  p->compensate_icc_black             = FALSE;
+  p->spline_version                   = DT_FILMIC_SPLINE_VERSION_V3;
+  p->enable_highlight_reconstruction  = FALSE;
+
+  memcpy(self->params, p, sizeof(*p));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_filmicrgb_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+}
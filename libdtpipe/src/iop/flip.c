@@ -0,0 +1,315 @@
+/*
+ * flip.c - darktable orientation (flip) IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/flip.c
+ * Copyright (C) 2009-2024 darktable developers.
+ * GUI code, OpenCL paths, presets, distort_mask and legacy_params removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - process() gathers each output row from the input with integer index
+ *     arithmetic instead of scattering input rows with
+ *     dt_imageio_flip_buffers(), so rows are written contiguously and the
+ *     loop parallelizes over output rows.  The result is bit-identical.
+ *   - the point maps are plain loops without their own OpenMP region: the
+ *     pipe calls them per row when it folds flip into a single warp with
+ *     the geometric modules next to it (ashift, crop).
+ *   - ORIENTATION_NULL takes the orientation from piece->pipe->image.
+ *
+ * Struct layout MUST match _flip_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in any colorspace (pure pixel permutation).
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter / data structs ────────────────────────────────────────────── */
+
+typedef struct dt_iop_flip_params_t
+{
+  int32_t orientation; /* dt_image_orientation_t, ORIENTATION_NULL = from image */
+} dt_iop_flip_params_t;
+
+typedef struct dt_iop_flip_data_t
+{
+  dt_image_orientation_t orientation;
+} dt_iop_flip_data_t;
+
+/* ── Point maps ──────────────────────────────────────────────────────────── */
+
+static bool distort_transform(dt_iop_module_t *self,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              float *const points,
+                              const size_t points_count)
+{
+  const dt_iop_flip_data_t *d = piece->data;
+  const dt_image_orientation_t o = d->orientation;
+
+  // nothing to be done if parameters are set to neutral values (no flip or swap)
+  if(o == ORIENTATION_NONE) return true;
+
+  const float w = piece->buf_in.width;
+  const float h = piece->buf_in.height;
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    const float x = (o & ORIENTATION_FLIP_X) ? w - points[i] : points[i];
+    const float y = (o & ORIENTATION_FLIP_Y) ? h - points[i + 1] : points[i + 1];
+    const bool swap = o & ORIENTATION_SWAP_XY;
+    points[i]     = swap ? y : x;
+    points[i + 1] = swap ? x : y;
+  }
+  return true;
+}
+
+static bool distort_backtransform(dt_iop_module_t *self,
+                                  dt_dev_pixelpipe_iop_t *piece,
+                                  float *const points,
+                                  const size_t points_count)
+{
+  const dt_iop_flip_data_t *d = piece->data;
+  const dt_image_orientation_t o = d->orientation;
+
+  if(o == ORIENTATION_NONE) return true;
+
+  const float w = piece->buf_in.width;
+  const float h = piece->buf_in.height;
+
+  DT_OMP_SIMD()
+  for(size_t i = 0; i < points_count * 2; i += 2)
+  {
+    const bool swap = o & ORIENTATION_SWAP_XY;
+    const float x = swap ? points[i + 1] : points[i];
+    const float y = swap ? points[i] : points[i + 1];
+    points[i]     = (o & ORIENTATION_FLIP_X) ? w - x : x;
+    points[i + 1] = (o & ORIENTATION_FLIP_Y) ? h - y : y;
+  }
+  return true;
+}
+
+/* ── modify_roi_out() / modify_roi_in() ──────────────────────────────────── */
+
+// maps integer pixel x of the output to the input, iw x ih being the size of
+// the input at the current scale
+static void _backtransform(const int32_t *x,
+                           int32_t *o,
+                           const dt_image_orientation_t orientation,
+                           int32_t iw,
+                           int32_t ih)
+{
+  if(orientation & ORIENTATION_SWAP_XY)
+  {
+    o[1] = x[0];
+    o[0] = x[1];
+    const int32_t tmp = iw;
+    iw = ih;
+    ih = tmp;
+  }
+  else
+  {
+    o[0] = x[0];
+    o[1] = x[1];
+  }
+
+  if(orientation & ORIENTATION_FLIP_X)
+    o[0] = iw - o[0] - 1;
+
+  if(orientation & ORIENTATION_FLIP_Y)
+    o[1] = ih - o[1] - 1;
+}
+
+static void modify_roi_out(dt_iop_module_t *self,
+                           dt_dev_pixelpipe_iop_t *piece,
+                           dt_iop_roi_t *roi_out,
+                           const dt_iop_roi_t *const roi_in)
+{
+  const dt_iop_flip_data_t *d = piece->data;
+  *roi_out = *roi_in;
+
+  // transform whole buffer roi
+  if(d->orientation & ORIENTATION_SWAP_XY)
+  {
+    roi_out->width = roi_in->height;
+    roi_out->height = roi_in->width;
+  }
+}
+
+static void modify_roi_in(dt_iop_module_t *self,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_roi_t *roi_in)
+{
+  const dt_iop_flip_data_t *d = piece->data;
+  *roi_in = *roi_out;
+
+  // this aabb contains all valid points (thus the -1)
+  const int32_t aabb[4] = { roi_out->x,
+                            roi_out->y,
+                            roi_out->x + roi_out->width - 1,
+                            roi_out->y + roi_out->height - 1 };
+  int32_t aabb_in[4] = { INT_MAX, INT_MAX, INT_MIN, INT_MIN };
+
+  // the input at this scale, in output orientation
+  const int32_t ow = piece->buf_out.width * roi_out->scale;
+  const int32_t oh = piece->buf_out.height * roi_out->scale;
+
+  for(int c = 0; c < 4; c++)
+  {
+    const int32_t p[2] = { aabb[(c & 1) ? 2 : 0], aabb[(c & 2) ? 3 : 1] };
+    int32_t o[2];
+    _backtransform(p, o, d->orientation, ow, oh);
+    aabb_in[0] = MIN(aabb_in[0], o[0]);
+    aabb_in[1] = MIN(aabb_in[1], o[1]);
+    aabb_in[2] = MAX(aabb_in[2], o[0]);
+    aabb_in[3] = MAX(aabb_in[3], o[1]);
+  }
+
+  // adjust roi_in to minimally needed region
+  roi_in->x = aabb_in[0];
+  roi_in->y = aabb_in[1];
+  // to convert valid points to widths, we need to add one
+  roi_in->width = aabb_in[2] - aabb_in[0] + 1;
+  roi_in->height = aabb_in[3] - aabb_in[1] + 1;
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_flip_data_t *d = piece->data;
+  const dt_image_orientation_t o = d->orientation;
+  const int ch = piece->colors;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+
+  if(o == ORIENTATION_NONE)
+  {
+    dt_iop_image_copy_by_size(out, in, roi_out->width, roi_out->height, ch);
+    return;
+  }
+
+  // output (x, y) reads input (x0 + x * sx + y * sy): swap first, then flip
+  // against the input size
+  const int iw = roi_in->width;
+  const int ih = roi_in->height;
+  ptrdiff_t sx = (o & ORIENTATION_SWAP_XY) ? iw : 1;
+  ptrdiff_t sy = (o & ORIENTATION_SWAP_XY) ? 1 : iw;
+  ptrdiff_t x0 = 0;
+  if(o & ORIENTATION_FLIP_X)
+  {
+    x0 += iw - 1;
+    if(o & ORIENTATION_SWAP_XY) sy = -sy; else sx = -sx;
+  }
+  if(o & ORIENTATION_FLIP_Y)
+  {
+    x0 += (ptrdiff_t)(ih - 1) * iw;
+    if(o & ORIENTATION_SWAP_XY) sx = -sx; else sy = -sy;
+  }
+
+  const int width = MIN(roi_out->width, (o & ORIENTATION_SWAP_XY) ? ih : iw);
+  const int height = MIN(roi_out->height, (o & ORIENTATION_SWAP_XY) ? iw : ih);
+
+  DT_OMP_FOR()
+  for(int y = 0; y < roi_out->height; y++)
+  {
+    float *const restrict orow = out + (size_t)ch * roi_out->width * y;
+    if(y >= height)
+    {
+      memset(orow, 0, sizeof(float) * ch * roi_out->width);
+      continue;
+    }
+    const float *const restrict irow = in + ch * (x0 + y * sy);
+    if(ch == 4)
+    {
+      for(int x = 0; x < width; x++)
+        copy_pixel(orow + 4 * x, irow + 4 * x * sx);
+    }
+    else
+    {
+      for(int x = 0; x < width; x++)
+        for(int c = 0; c < ch; c++)
+          orow[ch * x + c] = irow[ch * x * sx + c];
+    }
+    if(width < roi_out->width)
+      memset(orow + (size_t)ch * width, 0, sizeof(float) * ch * (roi_out->width - width));
+  }
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_flip_params_t *p = (const dt_iop_flip_params_t *)p1;
+  dt_iop_flip_data_t *d = piece->data;
+
+  if(p->orientation == ORIENTATION_NULL)
+    d->orientation = pipe->image.orientation == ORIENTATION_NULL
+                       ? ORIENTATION_NONE
+                       : pipe->image.orientation;
+  else
+    d->orientation = (dt_image_orientation_t)(p->orientation & 7);
+
+  if(d->orientation == ORIENTATION_NONE)
+    piece->enabled = FALSE;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_flip_data_t));
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_flip_params_t *d = self->default_params;
+  if(!d) return;
+  d->orientation = ORIENTATION_NULL;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+static int operation_tags(void)
+{
+  return IOP_TAG_DISTORT;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_flip_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain          = process;
+  so->init                   = init;
+  so->init_pipe              = init_pipe;
+  so->cleanup_pipe           = cleanup_pipe;
+  so->commit_params          = commit_params;
+  so->operation_tags         = operation_tags;
+  so->modify_roi_in          = modify_roi_in;
+  so->modify_roi_out         = modify_roi_out;
+  so->distort_transform      = distort_transform;
+  so->distort_backtransform  = distort_backtransform;
+}
@@ -0,0 +1,321 @@
+/*
+ * hotpixels.c - darktable hot pixels IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/hotpixels.c
+ * Copyright (C) 2011-2025 darktable developers.
+ * GUI code (including the fixed-pixel counter), reload_defaults and the
+ * sraw monochrome (4-plane) variant removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - the Bayer variant is the row kernel of common/hotpixels.h: counts
+ *     and selects instead of a branch per neighbour, vectorized per row.
+ *   - on Bayer raws the pipe does not run this module on its own: it folds
+ *     the filter into rawprepare's black / white scaling pass, so the
+ *     mosaic is read once (raw_prefilter() below; the planner is
+ *     _plan_raw_fusion() in pipe/pixelpipe.c).  Only per-colour gains
+ *     (white balance) may sit in between; their gains are divided out of
+ *     the threshold, which leaves the result unchanged.
+ *   - process() remains for X-Trans, monochrome Bayer and the runs where
+ *     the fusion does not apply (blending, highlights or cacorrect in
+ *     between, fixed pixels marked).
+ *
+ * Struct layout MUST match _hotpixels_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in IOP_CS_RAW.
+ */
+
+#include "dtpipe_internal.h"
+#include "common/hotpixels.h"
+#include "iop/iop_math.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ── Parameter / data structs ────────────────────────────────────────────── */
+
+typedef struct dt_iop_hotpixels_params_t
+{
+  float strength;      // $MIN: 0.0 $MAX: 1.0 $DEFAULT: 0.25
+  float threshold;     // $MIN: 0.0 $MAX: 1.0 $DEFAULT: 0.05
+  gboolean markfixed;  // $DEFAULT: FALSE $DESCRIPTION: "mark fixed pixels"
+  gboolean permissive; // $DEFAULT: FALSE $DESCRIPTION: "detect by 3 neighbors"
+} dt_iop_hotpixels_params_t;
+
+typedef struct dt_iop_hotpixels_data_t
+{
+  dt_hotpixels_t hp;
+  gboolean monochrome;
+} dt_iop_hotpixels_data_t;
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+/* This is the Bayer sensor variant. */
+static void process_bayer(const dt_iop_hotpixels_data_t *data,
+                          const float *const ivoid,
+                          float *const ovoid,
+                          const dt_iop_roi_t *const roi_out)
+{
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  const float thr[2] = { data->hp.threshold, data->hp.threshold };
+
+  DT_OMP_FOR()
+  for(int row = 0; row < height; row++)
+  {
+    const float *const in = ivoid + (size_t)width * row;
+    float *const out = ovoid + (size_t)width * row;
+    if(row < 2 || row >= height - 2)
+    {
+      memcpy(out, in, sizeof(float) * width);
+      continue;
+    }
+    dt_hotpixels_bayer_row(&data->hp, thr, in - 2 * width, in, in + 2 * width, out, width);
+    if(data->hp.markfixed)
+      dt_hotpixels_bayer_mark(&data->hp, thr, in - 2 * width, in, in + 2 * width, out, width);
+  }
+}
+
+/* This is the monochrome sensor variant. */
+static void process_monochrome(const dt_iop_hotpixels_data_t *data,
+                               const void *const ivoid,
+                               void *const ovoid,
+                               const dt_iop_roi_t *const roi_out)
+{
+  const float threshold = data->hp.threshold;
+  const float multiplier = data->hp.multiplier;
+  const gboolean markfixed = data->hp.markfixed;
+  const int min_neighbours = data->hp.min_neighbours;
+  const int width = roi_out->width;
+
+  DT_OMP_FOR()
+  for(int row = 1; row < roi_out->height - 1; row++)
+  {
+    const float *in = (float *)ivoid + (size_t)width * row + 1;
+    float *out = (float *)ovoid + (size_t)width * row + 1;
+    for(int col = 1; col < width - 1; col++, in++, out++)
+    {
+      float mid = *in * multiplier;
+      if(*in > threshold)
+      {
+        int count = 0;
+        float maxin = 0.0f;
+        float other;
+#define TESTONE(OFFSET)                                                                                      \
+  other = in[OFFSET];                                                                                        \
+  if(mid > other)                                                                                            \
+  {                                                                                                          \
+    count++;                                                                                                 \
+    if(other > maxin) maxin = other;                                                                         \
+  }
+        TESTONE(-1);
+        TESTONE(-width);
+        TESTONE(1);
+        TESTONE(width);
+#undef TESTONE
+        if(count >= min_neighbours)
+        {
+          *out = maxin;
+          if(markfixed)
+          {
+            for(int i = -1; i >= -10 && i >= -col; i--) out[i] = *in;
+            for(int i = 1; i <= 10 && i < width - col; i++) out[i] = *in;
+          }
+        }
+      }
+    }
+  }
+}
+
+/* X-Trans sensor equivalent of process_bayer(). */
+static void process_xtrans(const dt_iop_hotpixels_data_t *data,
+                           const void *const ivoid,
+                           void *const ovoid,
+                           const dt_iop_roi_t *const roi_out,
+                           const uint8_t (*const xtrans)[6])
+{
+  // for each cell of sensor array, pre-calculate, a list of the x/y
+  // offsets of the four radially nearest pixels of the same color
+  int offsets[6][6][4][2];
+  // increasing offsets from pixel to find nearest like-colored pixels
+  const int search[20][2] = { { -1, 0 },  { 1, 0 },   { 0, -1 },  { 0, 1 },   { -1, -1 },
+                              { -1, 1 },  { 1, -1 },  { 1, 1 },   { -2, 0 },  { 2, 0 },
+                              { 0, -2 },  { 0, 2 },   { -2, -1 }, { -2, 1 },  { 2, -1 },
+                              { 2, 1 },   { -1, -2 }, { 1, -2 },  { -1, 2 },  { 1, 2 } };
+  for(int j = 0; j < 6; ++j)
+  {
+    for(int i = 0; i < 6; ++i)
+    {
+      const uint8_t c = FCxtrans(j, i, roi_out, xtrans);
+      for(int s = 0, found = 0; s < 20 && found < 4; ++s)
+      {
+        if(c == FCxtrans(j + search[s][1], i + search[s][0], roi_out, xtrans))
+        {
+          offsets[j][i][found][0] = search[s][0];
+          offsets[j][i][found][1] = search[s][1];
+          ++found;
+        }
+      }
+    }
+  }
+
+  const float threshold = data->hp.threshold;
+  const float multiplier = data->hp.multiplier;
+  const gboolean markfixed = data->hp.markfixed;
+  const int min_neighbours = data->hp.min_neighbours;
+  const int width = roi_out->width;
+
+  DT_OMP_FOR()
+  for(int row = 2; row < roi_out->height - 2; row++)
+  {
+    const float *in = (float *)ivoid + (size_t)width * row + 2;
+    float *out = (float *)ovoid + (size_t)width * row + 2;
+    for(int col = 2; col < width - 2; col++, in++, out++)
+    {
+      float mid = *in * multiplier;
+      if(*in > threshold)
+      {
+        int count = 0;
+        float maxin = 0.0;
+        for(int n = 0; n < 4; ++n)
+        {
+          int xx = offsets[row % 6][col % 6][n][0];
+          int yy = offsets[row % 6][col % 6][n][1];
+          float other = *(in + xx + yy * (size_t)width);
+          if(mid > other)
+          {
+            count++;
+            if(other > maxin) maxin = other;
+          }
+        }
+        // NOTE: it seems that detecting by 2 neighbors would help for extreme cases
+        if(count >= min_neighbours)
+        {
+          *out = maxin;
+          if(markfixed)
+          {
+            const uint8_t c = FCxtrans(row, col, roi_out, xtrans);
+            for(int i = -2; i >= -10 && i >= -col; --i)
+            {
+              if(c == FCxtrans(row, col + i, roi_out, xtrans))
+                out[i] = *in;
+            }
+            for(int i = 2; i <= 10 && i < width - col; ++i)
+            {
+              if(c == FCxtrans(row, col + i, roi_out, xtrans))
+                out[i] = *in;
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_hotpixels_data_t *data = piece->data;
+
+  if(data->monochrome || piece->pipe->dsc.filters == 9u)
+  {
+    // The processing loop should output only a few pixels, so just copy everything first
+    dt_iop_image_copy_by_size(ovoid, ivoid, roi_out->width, roi_out->height, 1);
+    if(data->monochrome)
+      process_monochrome(data, ivoid, ovoid, roi_out);
+    else
+      process_xtrans(data, ivoid, ovoid, roi_out,
+                     (const uint8_t(*const)[6])piece->pipe->dsc.xtrans);
+  }
+  else
+    process_bayer(data, ivoid, ovoid, roi_out);
+}
+
+/* ── Raw stage fusion ────────────────────────────────────────────────────── */
+
+static const dt_hotpixels_t *raw_prefilter(dt_iop_module_t *self,
+                                           dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_hotpixels_data_t *d = piece->data;
+  const uint32_t filters = piece->pipe->image.buf_dsc.filters;
+  // the fixed-pixel marks are spread over neighbours, keep them standalone
+  if(d->monochrome || !filters || filters == 9u || d->hp.markfixed)
+    return NULL;
+  return &d->hp;
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *params,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_hotpixels_params_t *p = (const dt_iop_hotpixels_params_t *)params;
+  dt_iop_hotpixels_data_t *d = piece->data;
+
+  d->hp.multiplier = p->strength / 2.0;
+  d->hp.threshold = p->threshold;
+  d->hp.min_neighbours = p->permissive ? 3 : 4;
+  d->hp.markfixed = p->markfixed
+                    && (!(pipe->type & (DT_DEV_PIXELPIPE_EXPORT | DT_DEV_PIXELPIPE_THUMBNAIL)));
+
+  const dt_image_t *img = &pipe->image;
+  d->monochrome = dt_image_is_monochrome(img);
+  if(!dt_image_is_raw(img) || !img->buf_dsc.filters || p->strength == 0.0)
+    piece->enabled = FALSE;
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_hotpixels_data_t));
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_hotpixels_params_t *d = self->default_params;
+  if(!d) return;
+  d->strength = 0.25f;
+  d->threshold = 0.05f;
+  d->markfixed = FALSE;
+  d->permissive = FALSE;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+static int input_colorspace(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_t *pipe,
+                            dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RAW;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_hotpixels_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain     = process;
+  so->init              = init;
+  so->init_pipe         = init_pipe;
+  so->cleanup_pipe      = cleanup_pipe;
+  so->commit_params     = commit_params;
+  so->input_colorspace  = input_colorspace;
+  so->output_colorspace = input_colorspace;
+  so->raw_prefilter     = raw_prefilter;
+}
@@ -26,6 +26,7 @@
 #pragma once
 
 #include "dtpipe_internal.h"
+#include "common/interpolation.h"
 #include <math.h>
 #include <stdarg.h>
 #include <stdint.h>
@@ -541,6 +542,32 @@ static inline float dt_vector_channel_max(const dt_aligned_pixel_t pixel)
   return fmaxf(fmaxf(pixel[0], pixel[1]), pixel[2]);
 }
 
+/** dt_vector_sin — parabolic sine approximation on [-pi, pi], four lanes */
+static inline void dt_vector_sin(const dt_aligned_pixel_t arg,
+                                 dt_aligned_pixel_t sine)
+{
+  static const dt_aligned_pixel_t pi = { M_PI_F, M_PI_F, M_PI_F, M_PI_F };
+  static const dt_aligned_pixel_t a
+    = { 4 / (M_PI_F * M_PI_F),
+        4 / (M_PI_F * M_PI_F),
+        4 / (M_PI_F * M_PI_F),
+        4 / (M_PI_F * M_PI_F) };
+  static const dt_aligned_pixel_t p = { 0.225f, 0.225f, 0.225f, 0.225f };
+  static const dt_aligned_pixel_t one = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+  dt_aligned_pixel_t abs_arg;
+  for_four_channels(c)
+    abs_arg[c] = (arg[c] < 0.0f) ? -arg[c] : arg[c];
+  dt_aligned_pixel_t scaled;
+  for_four_channels(c)
+    scaled[c] = a[c] * arg[c] * (pi[c] - abs_arg[c]);
+  dt_aligned_pixel_t abs_scaled;
+  for_four_channels(c)
+    abs_scaled[c] = (scaled[c] < 0.0f) ? -scaled[c] : scaled[c];
+  for_four_channels(c)
+    sine[c] = scaled[c] * (p[c] * (abs_scaled[c] - one[c]) + one[c]);
+}
+
 /* ── Kahan summation ─────────────────────────────────────────────────────── */
 
 DT_OMP_DECLARE_SIMD()
@@ -799,15 +826,15 @@ static inline int dt_iop_have_required_input_format(const int required_ch,
 
 /**
  * dt_iop_clip_and_zoom_roi — crop/zoom float-RGBA input to output according to ROIs.
- * Uses bilinear interpolation.  Wrapper around dt_iop_clip_and_zoom (already in
- * dtpipe_internal.h) with the argument name matching the original signature.
+ * Both buffers hold exactly their ROI.  Uses the plan-cached separable
+ * resampler from common/interpolation.c with the user-preferred interpolator.
  */
 static inline void dt_iop_clip_and_zoom_roi(float *out, const float *const in,
                                             const dt_iop_roi_t *const roi_out,
                                             const dt_iop_roi_t *const roi_in)
 {
-  /* Delegate to the implementation already in dtpipe_internal.h */
-  dt_iop_clip_and_zoom(out, in, roi_out, roi_in);
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+  dt_interpolation_resample_roi(itor, out, roi_out, in, roi_in);
 }
 
 /**
@@ -0,0 +1,1308 @@
+/*
+ * lens.c - Lens correction IOP for libdtpipe
+ *
+ * Extracted from darktable src/iop/lens.cc
+ * Copyright (C) 2010-2025 darktable developers.
+ * Adapted for libdtpipe: GUI, OpenCL, distort_mask/transform and the
+ * vignette mask display removed.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Supported methods:
+ *   - embedded metadata (Sony / Fuji / Olympus correction tables read by
+ *     imageio/load.cc), algorithm versions 1 and 2
+ *   - manual vignette only
+ * libdtpipe does not link lensfun; params asking for the Lensfun method
+ * fall back to embedded metadata when the image carries it and to the
+ * manual vignette otherwise.
+ *
+ * darktable evaluates the radial splines and one interpolation kernel per
+ * channel for every pixel on every render.  Here the per-pixel source
+ * coordinates (green plus red/blue TCA offsets) and the vignetting gain are
+ * built once per (correction data, ROI, scale) and kept in piece->data as
+ * 16-bit fixed-point maps, so a re-render of the same view only runs the
+ * warp itself.  The warp samples all four channels with one set of taps
+ * and only re-samples red and blue when TCA moves them.
+ *
+ * Operates in IOP_CS_RGB.
+ */
+
+#include "dtpipe_internal.h"
+#include "common/interpolation.h"
+#include "iop/iop_math.h"
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXKNOTS 16
+#define VIGSPLINES 512
+
+/* Coordinate and gain maps larger than this are not kept; the warp then
+   evaluates the splines row by row as darktable does. */
+#define LENS_MAP_MAX_BYTES ((size_t)256 << 20)
+
+/* ── Parameter structs (must match params.c descriptor layout) ───────────── */
+
+typedef enum dt_iop_lens_method_t
+{
+  DT_IOP_LENS_METHOD_EMBEDDED_METADATA = 0,
+  DT_IOP_LENS_METHOD_LENSFUN = 1,
+  DT_IOP_LENS_METHOD_ONLYVIGNETTE = 2
+} dt_iop_lens_method_t;
+
+typedef enum dt_iop_lens_modify_flag_t
+{
+  DT_IOP_LENS_MODIFY_FLAG_TCA = 1,
+  DT_IOP_LENS_MODIFY_FLAG_VIGNETTING = 1 << 1,
+  DT_IOP_LENS_MODIFY_FLAG_DISTORTION = 1 << 2
+} dt_iop_lens_modify_flag_t;
+
+typedef enum dt_iop_lens_modflag_t
+{
+  DT_IOP_LENS_MODFLAG_NONE = 0,
+  DT_IOP_LENS_MODFLAG_ALL = DT_IOP_LENS_MODIFY_FLAG_DISTORTION | DT_IOP_LENS_MODIFY_FLAG_TCA
+                          | DT_IOP_LENS_MODIFY_FLAG_VIGNETTING,
+  DT_IOP_LENS_MODFLAG_DIST_VIGN = DT_IOP_LENS_MODIFY_FLAG_DISTORTION
+                                | DT_IOP_LENS_MODIFY_FLAG_VIGNETTING,
+} dt_iop_lens_modflag_t;
+
+typedef enum dt_iop_lens_embedded_metadata_version
+{
+  DT_IOP_LENS_EMBEDDED_METADATA_VERSION_1 = 0,
+  DT_IOP_LENS_EMBEDDED_METADATA_VERSION_2 = 1
+} dt_iop_lens_embedded_metadata_version;
+
+typedef struct dt_iop_lens_params_t
+{
+  dt_iop_lens_method_t method;  /* $DEFAULT: DT_IOP_LENS_METHOD_LENSFUN */
+  int   modify_flags;           /* $DEFAULT: DT_IOP_LENS_MODFLAG_ALL */
+
+  /* Lensfun method parameters (kept for layout; unused in libdtpipe) */
+  int   inverse;
+  float scale;
+  float crop;
+  float focal;
+  float aperture;
+  float distance;
+  int   target_geom;
+  char  camera[128];
+  char  lens[128];
+  gboolean tca_override;
+  float tca_r;
+  float tca_b;
+
+  /* embedded metadata method parameters */
+  float cor_dist_ft;            /* $MIN: 0 $MAX: 2 $DEFAULT: 1 */
+  float cor_vig_ft;             /* $MIN: 0 $MAX: 2 $DEFAULT: 1 */
+  float cor_ca_r_ft;            /* $MIN: 0 $MAX: 2 $DEFAULT: 1 */
+  float cor_ca_b_ft;            /* $MIN: 0 $MAX: 2 $DEFAULT: 1 */
+  float scale_md_v1;            /* algorithm v1 scale fine-tune [0.9, 1.1] */
+  dt_iop_lens_embedded_metadata_version md_version;
+  float scale_md;               /* $MIN: 0.1 $MAX: 2.0 $DEFAULT: 1 */
+  gboolean has_been_set;        /* FALSE: use the image defaults */
+
+  /* manual vignette */
+  float v_strength;             /* $MIN: 0.0 $MAX: 1.0 $DEFAULT: 0.0 */
+  float v_radius;               /* $MIN: 0.0 $MAX: 1.0 $DEFAULT: 0.5 */
+  float v_steepness;            /* $MIN: 0.0 $MAX: 1.0 $DEFAULT: 0.5 */
+  float reserved[2];
+} dt_iop_lens_params_t;
+
+/*
+ * Cached source-coordinate map for one (roi_in, roi_out) pair.  Offsets are
+ * stored relative to the identity position (output pixel in roi_in
+ * coordinates) and quantised with a per-map step, so the full int16 range
+ * covers the largest displacement the map actually needs.
+ */
+typedef struct dt_iop_lens_map_t
+{
+  dt_hash_t hash;     /* splines + geometry the map was built for; 0 = empty */
+  int       width, height;
+  float     step;     /* pixels per unit of coord[] */
+  float     tca_step; /* pixels per unit of tca[] */
+  int16_t  *coord;    /* green (dx, dy) per output pixel */
+  int16_t  *tca;      /* red (dx, dy), blue (dx, dy) from green; NULL = no TCA */
+} dt_iop_lens_map_t;
+
+/* Cached vignetting gain over roi_in, unsigned fixed point */
+typedef struct dt_iop_lens_gain_t
+{
+  dt_hash_t hash;
+  int       width, height;
+  float     step;
+  uint16_t *gain;
+} dt_iop_lens_gain_t;
+
+typedef struct dt_iop_lens_data_t
+{
+  int method;
+  int modify_flags;
+  int corrections;    /* modify flags the splines actually change */
+
+  /* embedded metadata data */
+  float scale_md_v1;
+  float scale_md;
+  dt_iop_lens_embedded_metadata_version md_version;
+  int   nc;
+  float knots_dist[MAXKNOTS];
+  float knots_vig[MAXKNOTS];
+  float cor_rgb[3][MAXKNOTS];
+  float vig[MAXKNOTS];
+
+  /* manual vignette */
+  float v_strength;
+  float v_radius;
+  float v_steepness;
+  float vigspline[VIGSPLINES];
+  dt_hash_t vighash;
+
+  /* render caches: survive commit_params, invalidated by hash */
+  dt_iop_lens_map_t  map;
+  dt_iop_lens_gain_t gain;
+} dt_iop_lens_data_t;
+
+/* Geometry shared by the ROI sweep, the map builder and the warp */
+typedef struct _lens_geometry_t
+{
+  float w2, h2;         /* optical centre in roi scale */
+  float r;              /* 1 / half diagonal */
+  float inv_scale_md;
+  int   ox, oy;         /* roi_out origin */
+  int   ix, iy;         /* roi_in origin */
+  float limw, limh;     /* last valid roi_in coordinate */
+  int   width;          /* roi_out width */
+} _lens_geometry_t;
+
+static inline const dt_image_t *_image(const dt_iop_module_t *self,
+                                       const dt_dev_pixelpipe_iop_t *piece)
+{
+  if(piece && piece->pipe) return &piece->pipe->image;
+  return &((dt_develop_t *)self->dev)->image_storage;
+}
+
+static inline gboolean _have_embedded_metadata(const dt_image_t *img)
+{
+  return img->exif_correction_type != CORRECTION_TYPE_NONE;
+}
+
+/* Full-resolution size of the module input.  buf_in is only known once
+   dt_dev_pixelpipe_get_dimensions() has run; fall back to the pipe input. */
+static inline void _full_size(const dt_dev_pixelpipe_iop_t *piece,
+                              float *w, float *h)
+{
+  *w = piece->buf_in.width  > 0 ? piece->buf_in.width  : piece->pipe->iwidth;
+  *h = piece->buf_in.height > 0 ? piece->buf_in.height : piece->pipe->iheight;
+}
+
+/* ── Manual vignette ─────────────────────────────────────────────────────── */
+
+static void _init_vignette_spline(dt_iop_lens_data_t *d)
+{
+  const dt_hash_t vhash = dt_hash(DT_INITHASH, &d->v_radius, 2 * sizeof(float));
+  if(d->vighash == vhash) return;
+  d->vighash = vhash;
+
+  /* basic math idea from rawtherapee code */
+  for(int i = 0; i < VIGSPLINES; i++)
+  {
+    const double radius = (double)i / (double)(VIGSPLINES - 1);
+    const double v = d->v_steepness;
+    const double b = 1.0 + d->v_radius * 10.0;
+    const double mul = -v / tanh(b);
+    d->vigspline[i] = (float)(v + mul * tanh(b * (1.0 - radius)));
+  }
+}
+
+static inline float _calc_vignette_spline(const float radius,
+                                          const float *spline)
+{
+  if(radius >= 1.0f) return spline[VIGSPLINES - 1];
+
+  const float r = radius * (float)(VIGSPLINES - 1);
+  const int i = (int)r;
+  const float frac = r - (float)i;
+  const float p0 = spline[i];
+  return p0 + (spline[i + 1] - p0) * frac;
+}
+
+static void _preprocess_vignette(dt_iop_lens_data_t *d,
+                                 dt_dev_pixelpipe_iop_t *piece,
+                                 const float *const data,
+                                 float *vig,
+                                 const dt_iop_roi_t *const roi)
+{
+  _init_vignette_spline(d);
+
+  float fw, fh;
+  _full_size(piece, &fw, &fh);
+  const float w2 = 0.5f * roi->scale * fw;
+  const float h2 = 0.5f * roi->scale * fh;
+  const float inv_maxr = 1.0f / sqrtf(w2 * w2 + h2 * h2);
+  const float strength = 2.0f * d->v_strength;
+  const float *spline = d->vigspline;
+
+  DT_OMP_FOR()
+  for(int row = 0; row < roi->height; row++)
+  {
+    const float dy = (float)(roi->y + row) - h2;
+    for(int col = 0; col < roi->width; col++)
+    {
+      const size_t idx = 4 * ((size_t)row * roi->width + col);
+      const float dx = (float)(roi->x + col) - w2;
+      const float radius = sqrtf(dx * dx + dy * dy) * inv_maxr;
+      const float val = MAX(0.0f, strength * _calc_vignette_spline(radius, spline));
+
+      for_three_channels(c)
+        vig[idx + c] = (1.0f + val) * data[idx + c];
+      vig[idx + 3] = data[idx + 3];
+    }
+  }
+}
+
+/* ── Embedded metadata splines ───────────────────────────────────────────── */
+
+/* This code is based on the algorithm developed by Freddie Witherden
+ * <freddie@witherden.org> in darktable pull request 7092. */
+
+static inline float _interpolate_linear_spline(const float *xi,
+                                               const float *yi,
+                                               const int ni,
+                                               const float x)
+{
+  if(x < xi[0])
+    return yi[0];
+
+  for(int i = 1; i < ni; i++)
+  {
+    if(x >= xi[i - 1] && x <= xi[i])
+    {
+      const float dydx = (yi[i] - yi[i - 1]) / (xi[i] - xi[i - 1]);
+      return yi[i - 1] + (x - xi[i - 1]) * dydx;
+    }
+  }
+
+  return yi[ni - 1];
+}
+
+/* Segment lookup shared by the three colour planes, which all use the same
+   knots: y = yi[i-1] + t * (yi[i] - yi[i-1]) reproduces
+   _interpolate_linear_spline() including its clamping at both ends. */
+static inline int _spline_segment(const float *xi,
+                                  const int ni,
+                                  const float x,
+                                  float *t)
+{
+  if(x < xi[0])
+  {
+    *t = 0.0f;
+    return 1;
+  }
+  for(int i = 1; i < ni; i++)
+  {
+    if(x >= xi[i - 1] && x <= xi[i])
+    {
+      const float dx = xi[i] - xi[i - 1];
+      *t = dx > 0.0f ? (x - xi[i - 1]) / dx : 0.0f;
+      return i;
+    }
+  }
+  *t = 1.0f;
+  return ni - 1;
+}
+
+static int _init_coeffs_md_v1(const dt_image_t *img,
+                              const dt_iop_lens_params_t *p,
+                              const float scale,
+                              float knots_dist[MAXKNOTS],
+                              float knots_vig[MAXKNOTS],
+                              float cor_rgb[3][MAXKNOTS],
+                              float vig[MAXKNOTS])
+{
+  const dt_image_correction_data_t *cd = &img->exif_correction_data;
+
+  if(img->exif_correction_type == CORRECTION_TYPE_SONY)
+  {
+    const int nc = cd->sony.nc;
+    for(int i = 0; i < nc; i++)
+    {
+      knots_dist[i] = knots_vig[i] = (float)(i + 0.5) / (nc - 1);
+
+      if(cor_rgb && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] =
+          (p->cor_dist_ft * cd->sony.distortion[i] * powf(2, -14) + 1) * scale;
+      else if(cor_rgb)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = scale;
+
+      if(cor_rgb && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA)
+      {
+        cor_rgb[0][i] *= cd->sony.ca_r[i] * powf(2, -21) + 1;
+        cor_rgb[2][i] *= cd->sony.ca_b[i] * powf(2, -21) + 1;
+      }
+
+      if(vig && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING)
+      {
+        vig[i] = powf(2, 0.5f - powf(2, p->cor_vig_ft * cd->sony.vignetting[i]
+                                        * powf(2, -13) - 1));
+        /* use the square of the correction factor */
+        vig[i] *= vig[i];
+      }
+      else if(vig)
+        vig[i] = 1;
+    }
+    return nc;
+  }
+  else if(img->exif_correction_type == CORRECTION_TYPE_FUJI)
+  {
+    const int nc = cd->fuji.nc;
+    for(int i = 0; i < nc; i++)
+    {
+      knots_dist[i] = knots_vig[i] = cd->fuji.cropf * cd->fuji.knots[i];
+
+      if(cor_rgb && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] =
+          (p->cor_dist_ft * cd->fuji.distortion[i] / 100 + 1) * scale;
+      else if(cor_rgb)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = scale;
+
+      if(cor_rgb && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA)
+      {
+        cor_rgb[0][i] *= cd->fuji.ca_r[i] + 1;
+        cor_rgb[2][i] *= cd->fuji.ca_b[i] + 1;
+      }
+
+      if(vig && p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING)
+      {
+        vig[i] = 1 - p->cor_vig_ft * (1 - cd->fuji.vignetting[i] / 100);
+        /* use the square of the correction factor */
+        vig[i] *= vig[i];
+      }
+      else if(vig)
+        vig[i] = 1;
+    }
+    return nc;
+  }
+
+  return 0;
+}
+
+static float _get_autoscale_md_v1(const dt_image_t *img,
+                                  const dt_iop_lens_params_t *p)
+{
+  const float tested = 200.0f;
+  float knots_dist[MAXKNOTS], knots_vig[MAXKNOTS], cor_rgb[3][MAXKNOTS];
+
+  /* default the scale to one for the benefit of init_coeffs */
+  const int nc = _init_coeffs_md_v1(img, p, 1.0f, knots_dist, knots_vig, cor_rgb, NULL);
+
+  float scale = 0.0f;
+  for(float i = 0.0f; i < tested; i++)
+    for(int j = 0; j < 3; j++)
+      scale = MAX(scale, _interpolate_linear_spline(knots_dist, cor_rgb[j], nc,
+                                                    0.5f + 0.5f * i / (tested - 1.0f)));
+  return scale;
+}
+
+static int _init_coeffs_md_v2(const dt_image_t *img,
+                              const dt_iop_lens_params_t *p,
+                              float knots_dist[MAXKNOTS],
+                              float knots_vig[MAXKNOTS],
+                              float cor_rgb[3][MAXKNOTS],
+                              float vig[MAXKNOTS])
+{
+  const dt_image_correction_data_t *cd = &img->exif_correction_data;
+  int nc = 0;
+
+  if(img->exif_correction_type == CORRECTION_TYPE_SONY)
+  {
+    nc = cd->sony.nc;
+    for(int i = 0; i < nc; i++)
+    {
+      knots_dist[i] = knots_vig[i] = (float)(i + 0.5) / (nc - 1);
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] =
+          p->cor_dist_ft * cd->sony.distortion[i] * powf(2, -14) + 1;
+      else
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = 1;
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA)
+      {
+        cor_rgb[0][i] *= p->cor_ca_r_ft * cd->sony.ca_r[i] * powf(2, -21) + 1;
+        cor_rgb[2][i] *= p->cor_ca_b_ft * cd->sony.ca_b[i] * powf(2, -21) + 1;
+      }
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING)
+        vig[i] = powf(2, 0.5f - powf(2, p->cor_vig_ft * cd->sony.vignetting[i]
+                                        * powf(2, -13) - 1));
+      else
+        vig[i] = 1;
+    }
+  }
+  else if(img->exif_correction_type == CORRECTION_TYPE_FUJI)
+  {
+    float knots_in[MAXKNOTS] = { 0 };
+    float cor_rgb_in[MAXKNOTS];
+    float cor_ca_r_in[MAXKNOTS];
+    float cor_ca_b_in[MAXKNOTS];
+    int j = 0;
+    int ncin = 0;
+
+    /* add a knot with no corrections at 0 if not existing */
+    if(cd->fuji.knots[0] > 0.f)
+    {
+      knots_in[j] = 0;
+      cor_rgb_in[j] = 1;
+      cor_ca_r_in[j] = 0;
+      cor_ca_b_in[j] = 0;
+      knots_vig[j] = 0;
+      vig[j] = 1;
+      ncin++;
+      j++;
+    }
+
+    for(int i = 0; i < cd->fuji.nc; i++, j++)
+    {
+      knots_in[j] = cd->fuji.cropf * cd->fuji.knots[i];
+      cor_rgb_in[j] = p->cor_dist_ft * cd->fuji.distortion[i] / 100 + 1;
+      cor_ca_r_in[j] = p->cor_ca_r_ft * cd->fuji.ca_r[i];
+      cor_ca_b_in[j] = p->cor_ca_b_ft * cd->fuji.ca_b[i];
+
+      /* vignetting is corrected before distortion, so this spline is
+         related to the source image */
+      knots_vig[j] = cd->fuji.cropf * cd->fuji.knots[i];
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING)
+        vig[j] = 1 - p->cor_vig_ft * (1 - cd->fuji.vignetting[i] / 100);
+      else
+        vig[j] = 1;
+
+      ncin++;
+    }
+
+    /* convert from a spline over the source image radius to one over the
+       destination image radius */
+    nc = MAXKNOTS;
+    for(int i = 0; i < nc; i++)
+    {
+      const float rin = (float)i / (float)(nc - 1);
+      const float m = _interpolate_linear_spline(knots_in, cor_rgb_in, ncin, rin);
+      knots_dist[i] = rin / m;
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION)
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = m;
+      else
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = 1;
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA)
+      {
+        cor_rgb[0][i] *= _interpolate_linear_spline(knots_in, cor_ca_r_in, ncin, rin) + 1;
+        cor_rgb[2][i] *= _interpolate_linear_spline(knots_in, cor_ca_b_in, ncin, rin) + 1;
+      }
+    }
+  }
+  else if(img->exif_correction_type == CORRECTION_TYPE_OLYMPUS)
+  {
+    /* distortion polynomial */
+    float drs = 1, dk2 = 0, dk4 = 0, dk6 = 0;
+    if(cd->olympus.has_dist)
+    {
+      drs = cd->olympus.dist[3]; /* radius of the output image corner */
+      dk2 = cd->olympus.dist[0];
+      dk4 = cd->olympus.dist[1];
+      dk6 = cd->olympus.dist[2];
+    }
+    /* CA polynomial */
+    float car0 = 0, car2 = 0, car4 = 0, cab0 = 0, cab2 = 0, cab4 = 0;
+    if(cd->olympus.has_ca)
+    {
+      car0 = cd->olympus.ca[0];
+      car2 = cd->olympus.ca[1];
+      car4 = cd->olympus.ca[2];
+      cab0 = cd->olympus.ca[3];
+      cab2 = cd->olympus.ca[4];
+      cab4 = cd->olympus.ca[5];
+    }
+
+    nc = MAXKNOTS;
+    for(int i = 0; i < nc; i++)
+    {
+      const float r = (float)i / (float)(nc - 1);
+      knots_dist[i] = knots_vig[i] = r;
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION)
+      {
+        /* Rin = Rout*drs * (1 + dk2 (Rout*drs)^2 + dk4 (Rout*drs)^4 + dk6 (Rout*drs)^6);
+           r_cor is Rin / Rout */
+        const float rs2 = powf(r * drs, 2);
+        const float r_cor = drs * (1 + rs2 * (dk2 + rs2 * (dk4 + rs2 * dk6)));
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = p->cor_dist_ft * (r_cor - 1) + 1;
+      }
+      else
+        cor_rgb[0][i] = cor_rgb[1][i] = cor_rgb[2][i] = 1.0f;
+
+      if(p->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA && r > 0)
+      {
+        /* Rin_with_CA = Rin * ((1 + car0) + car2 * Rin^2 + car4 * Rin^4) */
+        const float rd = cor_rgb[1][i] * r;
+        const float rd2 = powf(rd, 2);
+        cor_rgb[0][i] += p->cor_ca_r_ft * rd * (car0 + rd2 * (car2 + rd2 * car4)) / r;
+        cor_rgb[2][i] += p->cor_ca_b_ft * rd * (cab0 + rd2 * (cab2 + rd2 * cab4)) / r;
+      }
+
+      vig[i] = 1;
+    }
+  }
+
+  if(nc == 0) return 0;
+
+  /* Find the scale that shows the largest visible image box after
+     correction by walking the normalised radius from the shorter image
+     border to the corner. */
+  const float iwd2 = 0.5f * img->p_width;
+  const float iht2 = 0.5f * img->p_height;
+  const float r = sqrtf(iwd2 * iwd2 + iht2 * iht2);
+  const float srr = MIN(iwd2, iht2) / r;
+  const float tested = 200.0f;
+
+  float scale = 0.0f;
+  for(float i = 0.0f; i < tested; i++)
+    for(int c = 0; c < 3; c++)
+    {
+      const float x = srr + (1.0f - srr) * i / (tested - 1.0f);
+      scale = MAX(scale, _interpolate_linear_spline(knots_dist, cor_rgb[c], nc, x));
+    }
+
+  for(int i = 0; i < nc; i++)
+  {
+    knots_dist[i] *= scale;
+    for(int c = 0; c < 3; c++)
+      cor_rgb[c][i] /= scale;
+  }
+
+  return nc;
+}
+
+static int _check_corrections_md(const dt_iop_lens_data_t *d)
+{
+  gboolean has_vignette = FALSE;
+  gboolean has_distort = FALSE;
+  gboolean has_tca = FALSE;
+
+  for(int i = 0; i < d->nc; i++)
+  {
+    if(!feqf(d->vig[i], 1.0f, 1e-7f))
+      has_vignette = TRUE;
+    for(int c = 0; c < 3; c++)
+      if(!feqf(d->cor_rgb[c][i], 1.0f, 1e-7f))
+        has_distort = TRUE;
+    if(d->cor_rgb[0][i] != d->cor_rgb[1][i] || d->cor_rgb[2][i] != d->cor_rgb[1][i])
+      has_tca = TRUE;
+  }
+
+  return ((d->modify_flags & DT_IOP_LENS_MODIFY_FLAG_TCA) && has_tca
+            ? DT_IOP_LENS_MODIFY_FLAG_TCA : 0)
+       | ((d->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING) && has_vignette
+            ? DT_IOP_LENS_MODIFY_FLAG_VIGNETTING : 0)
+       | ((d->modify_flags & DT_IOP_LENS_MODIFY_FLAG_DISTORTION) && has_distort
+            ? DT_IOP_LENS_MODIFY_FLAG_DISTORTION : 0);
+}
+
+static void _commit_params_md(const dt_image_t *img,
+                              const dt_iop_lens_params_t *p,
+                              dt_iop_lens_data_t *d)
+{
+  d->nc = 0;
+  d->corrections = 0;
+  if(!_have_embedded_metadata(img))
+    return;
+
+  d->md_version = p->md_version;
+  if(d->md_version == DT_IOP_LENS_EMBEDDED_METADATA_VERSION_1)
+  {
+    d->scale_md_v1 = p->scale_md_v1;
+    if(d->scale_md_v1 < 0.9f || d->scale_md_v1 > 1.1f) /* autoscale improper data */
+      d->scale_md_v1 = _get_autoscale_md_v1(img, p);
+
+    d->nc = _init_coeffs_md_v1(img, p, 1.0f / d->scale_md_v1,
+                               d->knots_dist, d->knots_vig, d->cor_rgb, d->vig);
+  }
+  else if(d->md_version == DT_IOP_LENS_EMBEDDED_METADATA_VERSION_2)
+  {
+    d->nc = _init_coeffs_md_v2(img, p, d->knots_dist, d->knots_vig, d->cor_rgb, d->vig);
+  }
+
+  d->scale_md = p->scale_md;
+  if(d->scale_md < 0.1f || d->scale_md > 2.0f) /* reset improper data */
+    d->scale_md = 1.0f;
+
+  d->corrections = _check_corrections_md(d);
+}
+
+/* ── Coordinate and gain maps ────────────────────────────────────────────── */
+
+static void _geometry(const dt_iop_lens_data_t *d,
+                      const dt_dev_pixelpipe_iop_t *piece,
+                      const dt_iop_roi_t *const roi_in,
+                      const dt_iop_roi_t *const roi_out,
+                      _lens_geometry_t *g)
+{
+  float fw, fh;
+  _full_size(piece, &fw, &fh);
+  g->w2 = 0.5f * roi_in->scale * fw;
+  g->h2 = 0.5f * roi_in->scale * fh;
+  g->r = 1.0f / sqrtf(g->w2 * g->w2 + g->h2 * g->h2);
+  g->inv_scale_md = 1.0f / d->scale_md;
+  g->ox = roi_out->x;
+  g->oy = roi_out->y;
+  g->ix = roi_in->x;
+  g->iy = roi_in->y;
+  g->limw = roi_in->width - 1;
+  g->limh = roi_in->height - 1;
+  g->width = roi_out->width;
+}
+
+/* Source positions (roi_in pixels) of one output row.  With three planes
+   xs/ys hold red, green, blue back to back; with one plane only green. */
+static void _coords_row(const dt_iop_lens_data_t *d,
+                        const _lens_geometry_t *g,
+                        const int y,
+                        const int nplanes,
+                        float *const restrict xs,
+                        float *const restrict ys)
+{
+  const float cy = ((float)(g->oy + y) - g->h2) * g->inv_scale_md;
+  const int w = g->width;
+
+  for(int x = 0; x < w; x++)
+  {
+    const float cx = ((float)(g->ox + x) - g->w2) * g->inv_scale_md;
+    float t;
+    const int i = _spline_segment(d->knots_dist, d->nc, g->r * sqrtf(cx * cx + cy * cy), &t);
+
+    for(int p = 0; p < nplanes; p++)
+    {
+      const float *cor = d->cor_rgb[nplanes == 1 ? 1 : p];
+      const float dr = cor[i - 1] + t * (cor[i] - cor[i - 1]);
+      xs[p * w + x] = CLAMPF(dr * cx + g->w2 - g->ix, 0.0f, g->limw);
+      ys[p * w + x] = CLAMPF(dr * cy + g->h2 - g->iy, 0.0f, g->limh);
+    }
+  }
+}
+
+static void _map_free(dt_iop_lens_map_t *m)
+{
+  dt_free_align(m->coord);
+  dt_free_align(m->tca);
+  memset(m, 0, sizeof(*m));
+}
+
+static void _gain_free(dt_iop_lens_gain_t *v)
+{
+  dt_free_align(v->gain);
+  memset(v, 0, sizeof(*v));
+}
+
+static dt_hash_t _map_hash(const dt_iop_lens_data_t *d,
+                           const _lens_geometry_t *g,
+                           const int height,
+                           const int nplanes)
+{
+  dt_hash_t hash = dt_hash(DT_INITHASH, g, sizeof(*g));
+  hash = dt_hash(hash, &height, sizeof(height));
+  hash = dt_hash(hash, &nplanes, sizeof(nplanes));
+  hash = dt_hash(hash, &d->nc, sizeof(d->nc));
+  hash = dt_hash(hash, d->knots_dist, sizeof(d->knots_dist));
+  return dt_hash(hash, d->cor_rgb, sizeof(d->cor_rgb));
+}
+
+/*
+ * Build (or keep) the coordinate map.  Two passes: the first finds the
+ * largest displacement so the quantisation step can use the full int16
+ * range, the second stores the offsets.  Returns FALSE if the map would
+ * exceed the memory budget or cannot be allocated.
+ */
+static gboolean _map_update(dt_iop_lens_data_t *d,
+                            const _lens_geometry_t *g,
+                            const int height,
+                            const int nplanes)
+{
+  dt_iop_lens_map_t *m = &d->map;
+  const dt_hash_t hash = _map_hash(d, g, height, nplanes);
+  if(m->hash == hash && m->coord)
+    return TRUE;
+
+  _map_free(m);
+
+  const int w = g->width;
+  const size_t npix = (size_t)w * height;
+  const size_t bytes = npix * sizeof(int16_t) * (nplanes == 3 ? 6 : 2);
+  if(bytes > LENS_MAP_MAX_BYTES)
+    return FALSE;
+
+  size_t padded;
+  float *rowbuf = dt_alloc_perthread_float((size_t)6 * w, &padded);
+  m->coord = dt_alloc_align_type(int16_t, 2 * npix);
+  m->tca = nplanes == 3 ? dt_alloc_align_type(int16_t, 4 * npix) : NULL;
+  if(!rowbuf || !m->coord || (nplanes == 3 && !m->tca))
+  {
+    dt_free_align(rowbuf);
+    _map_free(m);
+    return FALSE;
+  }
+
+  float maxd = 0.0f;
+  float maxt = 0.0f;
+  DT_OMP_FOR(reduction(max : maxd, maxt))
+  for(int y = 0; y < height; y++)
+  {
+    float *xs = dt_get_perthread(rowbuf, padded);
+    float *ys = xs + 3 * w;
+    _coords_row(d, g, y, nplanes, xs, ys);
+    const float *xg = xs + (nplanes == 3 ? w : 0);
+    const float *yg = ys + (nplanes == 3 ? w : 0);
+    const float bx = (float)(g->ox - g->ix);
+    const float by = (float)(g->oy - g->iy + y);
+    for(int x = 0; x < w; x++)
+    {
+      maxd = fmaxf(maxd, fmaxf(fabsf(xg[x] - bx - x), fabsf(yg[x] - by)));
+      if(nplanes == 3)
+        for(int p = 0; p < 3; p += 2)
+          maxt = fmaxf(maxt, fmaxf(fabsf(xs[p * w + x] - xg[x]),
+                                   fabsf(ys[p * w + x] - yg[x])));
+    }
+  }
+
+  m->step = fmaxf(maxd, 1e-3f) / 32767.0f;
+  m->tca_step = fmaxf(maxt, 1e-3f) / 32767.0f;
+  const float is = 1.0f / m->step;
+  const float its = 1.0f / m->tca_step;
+
+  DT_OMP_FOR()
+  for(int y = 0; y < height; y++)
+  {
+    float *xs = dt_get_perthread(rowbuf, padded);
+    float *ys = xs + 3 * w;
+    _coords_row(d, g, y, nplanes, xs, ys);
+    const float *xg = xs + (nplanes == 3 ? w : 0);
+    const float *yg = ys + (nplanes == 3 ? w : 0);
+    const float bx = (float)(g->ox - g->ix);
+    const float by = (float)(g->oy - g->iy + y);
+    int16_t *c = m->coord + (size_t)2 * w * y;
+    for(int x = 0; x < w; x++)
+    {
+      c[2 * x]     = (int16_t)lrintf((xg[x] - bx - x) * is);
+      c[2 * x + 1] = (int16_t)lrintf((yg[x] - by) * is);
+    }
+    if(nplanes == 3)
+    {
+      int16_t *t = m->tca + (size_t)4 * w * y;
+      for(int x = 0; x < w; x++)
+      {
+        t[4 * x]     = (int16_t)lrintf((xs[x] - xg[x]) * its);
+        t[4 * x + 1] = (int16_t)lrintf((ys[x] - yg[x]) * its);
+        t[4 * x + 2] = (int16_t)lrintf((xs[2 * w + x] - xg[x]) * its);
+        t[4 * x + 3] = (int16_t)lrintf((ys[2 * w + x] - yg[x]) * its);
+      }
+    }
+  }
+
+  dt_free_align(rowbuf);
+  m->width = w;
+  m->height = height;
+  m->hash = hash;
+  return TRUE;
+}
+
+/* Decode one row of the cached map into the layout _coords_row() writes.
+   Dequantised positions can overshoot the border by half a step. */
+static void _map_row(const dt_iop_lens_map_t *m,
+                     const _lens_geometry_t *g,
+                     const int y,
+                     const int nplanes,
+                     float *const restrict xs,
+                     float *const restrict ys)
+{
+  const int w = m->width;
+  const int16_t *c = m->coord + (size_t)2 * w * y;
+  const float bx = (float)(g->ox - g->ix);
+  const float by = (float)(g->oy - g->iy + y);
+  float *const restrict xg = xs + (nplanes == 3 ? w : 0);
+  float *const restrict yg = ys + (nplanes == 3 ? w : 0);
+
+  DT_OMP_SIMD()
+  for(int x = 0; x < w; x++)
+  {
+    xg[x] = CLAMPF(bx + x + m->step * c[2 * x], 0.0f, g->limw);
+    yg[x] = CLAMPF(by + m->step * c[2 * x + 1], 0.0f, g->limh);
+  }
+
+  if(nplanes == 3)
+  {
+    const int16_t *t = m->tca + (size_t)4 * w * y;
+    DT_OMP_SIMD()
+    for(int x = 0; x < w; x++)
+    {
+      xs[x]         = CLAMPF(xg[x] + m->tca_step * t[4 * x],     0.0f, g->limw);
+      ys[x]         = CLAMPF(yg[x] + m->tca_step * t[4 * x + 1], 0.0f, g->limh);
+      xs[2 * w + x] = CLAMPF(xg[x] + m->tca_step * t[4 * x + 2], 0.0f, g->limw);
+      ys[2 * w + x] = CLAMPF(yg[x] + m->tca_step * t[4 * x + 3], 0.0f, g->limh);
+    }
+  }
+}
+
+/* Build (or keep) the vignetting gain 1 / spline(r) over roi_in.  The gain
+   never exceeds 1 / min(knot value), which fixes the step up front. */
+static gboolean _gain_update(dt_iop_lens_data_t *d,
+                             const _lens_geometry_t *g,
+                             const dt_iop_roi_t *const roi_in)
+{
+  dt_iop_lens_gain_t *v = &d->gain;
+  dt_hash_t hash = dt_hash(DT_INITHASH, roi_in, sizeof(*roi_in));
+  hash = dt_hash(hash, &g->w2, 3 * sizeof(float));
+  hash = dt_hash(hash, &d->nc, sizeof(d->nc));
+  hash = dt_hash(hash, d->knots_vig, sizeof(d->knots_vig));
+  hash = dt_hash(hash, d->vig, sizeof(d->vig));
+  if(v->hash == hash && v->gain)
+    return TRUE;
+
+  _gain_free(v);
+
+  const size_t npix = (size_t)roi_in->width * roi_in->height;
+  if(npix * sizeof(uint16_t) > LENS_MAP_MAX_BYTES)
+    return FALSE;
+  v->gain = dt_alloc_align_type(uint16_t, npix);
+  if(!v->gain)
+    return FALSE;
+
+  float vmin = FLT_MAX;
+  for(int i = 0; i < d->nc; i++)
+    vmin = fminf(vmin, d->vig[i]);
+  v->step = 1.0f / MAX(1e-4f, vmin) / 65535.0f;
+  const float is = 1.0f / v->step;
+
+  DT_OMP_FOR()
+  for(int y = 0; y < roi_in->height; y++)
+  {
+    const float cy = (float)(roi_in->y + y) - g->h2;
+    uint16_t *row = v->gain + (size_t)y * roi_in->width;
+    for(int x = 0; x < roi_in->width; x++)
+    {
+      const float cx = (float)(roi_in->x + x) - g->w2;
+      const float sf = _interpolate_linear_spline(d->knots_vig, d->vig, d->nc,
+                                                  g->r * sqrtf(cx * cx + cy * cy));
+      row[x] = (uint16_t)MIN(65535.0f, lrintf(is / MAX(1e-4f, sf)));
+    }
+  }
+
+  v->width = roi_in->width;
+  v->height = roi_in->height;
+  v->hash = hash;
+  return TRUE;
+}
+
+/* ── Embedded metadata processing ────────────────────────────────────────── */
+
+static void _process_md(dt_iop_module_t *self,
+                        dt_dev_pixelpipe_iop_t *piece,
+                        const float *const in,
+                        float *const out,
+                        const dt_iop_roi_t *const roi_in,
+                        const dt_iop_roi_t *const roi_out,
+                        const gboolean backbuf)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+
+  if(!d->nc || d->modify_flags == DT_IOP_LENS_MODFLAG_NONE)
+  {
+    dt_iop_copy_image_roi(out, in, 4, roi_in, roi_out);
+    return;
+  }
+
+  _lens_geometry_t g;
+  _geometry(d, piece, roi_in, roi_out, &g);
+
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+  const int nplanes = (d->corrections & DT_IOP_LENS_MODIFY_FLAG_TCA) ? 3 : 1;
+  const size_t in_floats = (size_t)4 * roi_in->width * roi_in->height;
+
+  /* Correct vignetting into a scratch copy (or in place on the manual
+     vignette buffer, which is already ours) */
+  const float *buf = in;
+  float *tmp = NULL;
+  if(d->modify_flags & DT_IOP_LENS_MODIFY_FLAG_VIGNETTING)
+  {
+    float *dst = backbuf ? (float *)in : (tmp = dt_alloc_align_float(in_floats));
+    if(dst)
+    {
+      if(_gain_update(d, &g, roi_in))
+      {
+        const dt_iop_lens_gain_t *v = &d->gain;
+        DT_OMP_FOR()
+        for(size_t k = 0; k < (size_t)roi_in->width * roi_in->height; k++)
+        {
+          const float f = v->step * v->gain[k];
+          for_four_channels(c)
+            dst[4 * k + c] = f * in[4 * k + c];
+        }
+      }
+      else
+      {
+        DT_OMP_FOR()
+        for(int y = 0; y < roi_in->height; y++)
+        {
+          const float cy = (float)(roi_in->y + y) - g.h2;
+          for(int x = 0; x < roi_in->width; x++)
+          {
+            const size_t k = (size_t)y * roi_in->width + x;
+            const float cx = (float)(roi_in->x + x) - g.w2;
+            const float sf = _interpolate_linear_spline(d->knots_vig, d->vig, d->nc,
+                                                        g.r * sqrtf(cx * cx + cy * cy));
+            const float f = 1.0f / MAX(1e-4f, sf);
+            for_four_channels(c)
+              dst[4 * k + c] = f * in[4 * k + c];
+          }
+        }
+      }
+      buf = dst;
+    }
+  }
+
+  /* Correct distortion and/or chromatic aberration */
+  const gboolean cached = _map_update(d, &g, roi_out->height, nplanes);
+  const int w = roi_out->width;
+  size_t padded;
+  float *rowbuf = dt_alloc_perthread_float((size_t)6 * w, &padded);
+  if(!rowbuf)
+  {
+    fprintf(stderr, "[lens] out of memory\n");
+    dt_iop_copy_image_roi(out, in, 4, roi_in, roi_out);
+    dt_free_align(tmp);
+    return;
+  }
+
+  const int iw = roi_in->width;
+  const int ih = roi_in->height;
+  const int stride = 4 * iw;
+
+  DT_OMP_FOR()
+  for(int y = 0; y < roi_out->height; y++)
+  {
+    float *xs = dt_get_perthread(rowbuf, padded);
+    float *ys = xs + 3 * w;
+    if(cached)
+      _map_row(&d->map, &g, y, nplanes, xs, ys);
+    else
+      _coords_row(d, &g, y, nplanes, xs, ys);
+
+    float *o = out + (size_t)4 * w * y;
+    if(nplanes == 1)
+    {
+      for(int x = 0; x < w; x++)
+        dt_interpolation_compute_pixel4c(itor, buf, o + 4 * x, xs[x], ys[x], iw, ih, stride);
+    }
+    else
+    {
+      /* one 4-channel sample at the green position (green and alpha),
+         then red and blue where TCA moved them */
+      const float *xg = xs + w, *yg = ys + w;
+      const float *xb = xs + 2 * w, *yb = ys + 2 * w;
+      for(int x = 0; x < w; x++)
+      {
+        dt_interpolation_compute_pixel4c(itor, buf, o + 4 * x, xg[x], yg[x], iw, ih, stride);
+        o[4 * x + 0] = dt_interpolation_compute_sample(itor, buf + 0, xs[x], ys[x],
+                                                       iw, ih, 4, stride);
+        o[4 * x + 2] = dt_interpolation_compute_sample(itor, buf + 2, xb[x], yb[x],
+                                                       iw, ih, 4, stride);
+      }
+    }
+  }
+
+  dt_free_align(rowbuf);
+  dt_free_align(tmp);
+}
+
+static void _modify_roi_in_md(dt_iop_lens_data_t *d,
+                              dt_dev_pixelpipe_iop_t *piece,
+                              const dt_iop_roi_t *const roi_out,
+                              dt_iop_roi_t *roi_in)
+{
+  *roi_in = *roi_out;
+
+  if(!d->nc || d->modify_flags == DT_IOP_LENS_MODFLAG_NONE)
+    return;
+
+  float fw, fh;
+  _full_size(piece, &fw, &fh);
+  const float inv_scale_md = 1.0f / d->scale_md;
+  const float orig_w = roi_in->scale * fw;
+  const float orig_h = roi_in->scale * fh;
+  const float w2 = 0.5f * orig_w;
+  const float h2 = 0.5f * orig_h;
+  const float r = 1.0f / sqrtf(w2 * w2 + h2 * h2);
+
+  const int xoff = roi_in->x;
+  const int yoff = roi_in->y;
+  const int width = roi_in->width, height = roi_in->height;
+  const float cxs[2] = { (xoff - w2) * inv_scale_md, (xoff + (width - 1) - w2) * inv_scale_md };
+  const float cys[2] = { (yoff - h2) * inv_scale_md, (yoff + (height - 1) - h2) * inv_scale_md };
+
+  float xm = FLT_MAX, xM = -FLT_MAX, ym = FLT_MAX, yM = -FLT_MAX;
+
+  /* sweep the ROI border: top/bottom rows, then left/right columns */
+  for(int k = 0; k < width + height; k++)
+  {
+    for(int j = 0; j < 2; j++)
+    {
+      const float cx = k < width ? (xoff + k - w2) * inv_scale_md : cxs[j];
+      const float cy = k < width ? cys[j] : (yoff + (k - width) - h2) * inv_scale_md;
+      float t;
+      const int i = _spline_segment(d->knots_dist, d->nc, r * sqrtf(cx * cx + cy * cy), &t);
+      for_three_channels(c)
+      {
+        const float *cor = d->cor_rgb[c];
+        const float dr = cor[i - 1] + t * (cor[i] - cor[i - 1]);
+        const float xs = dr * cx + w2;
+        const float ys = dr * cy + h2;
+        xm = MIN(xm, xs);
+        xM = MAX(xM, xs);
+        ym = MIN(ym, ys);
+        yM = MAX(yM, ys);
+      }
+    }
+  }
+
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+  const float iw1 = itor->width;
+  const float iw2 = 2.0f * iw1;
+  roi_in->x      = xm - iw1;
+  roi_in->y      = ym - iw1;
+  roi_in->width  = xM + iw2 - xm + 1.0f;
+  roi_in->height = yM + iw2 - ym + 1.0f;
+
+  /* sanity check */
+  roi_in->x = CLAMP(roi_in->x, 0, (int)floorf(orig_w - 2.0f));
+  roi_in->y = CLAMP(roi_in->y, 0, (int)floorf(orig_h - 2.0f));
+  roi_in->width = CLAMP(roi_in->width, 1, (int)floorf(orig_w) - roi_in->x);
+  roi_in->height = CLAMP(roi_in->height, 1, (int)floorf(orig_h) - roi_in->y);
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid, void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+  const gboolean pre_vignette = d->v_strength > 0.0f;
+  float *data = (float *)ivoid;
+
+  if(pre_vignette)
+  {
+    data = dt_alloc_align_float((size_t)4 * roi_in->width * roi_in->height);
+    if(data)
+      _preprocess_vignette(d, piece, (const float *)ivoid, data, roi_in);
+    else
+      data = (float *)ivoid;
+  }
+
+  if(d->method == DT_IOP_LENS_METHOD_EMBEDDED_METADATA)
+    _process_md(self, piece, data, (float *)ovoid, roi_in, roi_out,
+                data != (float *)ivoid);
+  else
+    dt_iop_copy_image_roi((float *)ovoid, data, 4, roi_in, roi_out);
+
+  if(data != (float *)ivoid)
+    dt_free_align(data);
+}
+
+/* ── modify_roi_in() ─────────────────────────────────────────────────────── */
+
+static void modify_roi_in(dt_iop_module_t *self,
+                          dt_dev_pixelpipe_iop_t *piece,
+                          const dt_iop_roi_t *const roi_out,
+                          dt_iop_roi_t *roi_in)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+
+  if(d->method == DT_IOP_LENS_METHOD_EMBEDDED_METADATA)
+    _modify_roi_in_md(d, piece, roi_out, roi_in);
+  else
+    *roi_in = *roi_out;
+}
+
+/* ── tiling_callback() ───────────────────────────────────────────────────── */
+
+static void tiling_callback(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const dt_iop_roi_t *roi_in,
+                            const dt_iop_roi_t *roi_out,
+                            dt_develop_tiling_t *tiling)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+  const gboolean md = d->method == DT_IOP_LENS_METHOD_EMBEDDED_METADATA;
+
+  tiling->factor    = md ? 4.5f : 2.0f; /* in + out + tmp + tmpbuf */
+  tiling->factor_cl = tiling->factor;
+  tiling->maxbuf    = md ? 1.5f : 1.0f;
+  tiling->maxbuf_cl = tiling->maxbuf;
+  tiling->overhead  = 0;
+  tiling->overlap   = 4;
+  tiling->xalign    = 1;
+  tiling->yalign    = 1;
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_image_t *img = _image(self, piece);
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+  dt_iop_lens_params_t p = *(const dt_iop_lens_params_t *)p1;
+
+  /* untouched after autodetection: use the image defaults but keep the
+     method, which presets and mass export rely on */
+  if(!p.has_been_set && self->default_params)
+  {
+    const dt_iop_lens_method_t method = p.method;
+    p = *(const dt_iop_lens_params_t *)self->default_params;
+    p.method = method;
+  }
+
+  /* no Lensfun database in libdtpipe */
+  if(p.method == DT_IOP_LENS_METHOD_LENSFUN)
+  {
+    if(_have_embedded_metadata(img))
+    {
+      const dt_iop_lens_params_t *dp = (const dt_iop_lens_params_t *)self->default_params;
+      p.method = DT_IOP_LENS_METHOD_EMBEDDED_METADATA;
+      p.md_version = DT_IOP_LENS_EMBEDDED_METADATA_VERSION_2;
+      p.scale_md = dp ? dp->scale_md : 1.0f;
+    }
+    else
+    {
+      fprintf(stderr, "[lens] Lensfun correction not available, "
+                      "applying manual vignette only\n");
+      p.method = DT_IOP_LENS_METHOD_ONLYVIGNETTE;
+    }
+  }
+
+  d->method = p.method;
+  d->modify_flags = p.modify_flags;
+  if(dt_image_is_monochrome(img))
+    d->modify_flags &= ~DT_IOP_LENS_MODIFY_FLAG_TCA;
+
+  d->v_strength = p.v_strength;
+  d->v_radius = p.v_radius;
+  d->v_steepness = p.v_steepness;
+
+  if(d->method == DT_IOP_LENS_METHOD_EMBEDDED_METADATA)
+    _commit_params_md(img, &p, d);
+  else
+  {
+    d->nc = 0;
+    d->corrections = 0;
+  }
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = calloc(1, sizeof(dt_iop_lens_data_t));
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_lens_data_t *d = (dt_iop_lens_data_t *)piece->data;
+  if(d)
+  {
+    _map_free(&d->map);
+    _gain_free(&d->gain);
+  }
+  free(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params (darktable reload_defaults) ─────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_lens_params_t *d = self->default_params;
+  if(!d) return;
+
+  memset(d, 0, sizeof(*d));
+  d->method       = DT_IOP_LENS_METHOD_LENSFUN;
+  d->modify_flags = DT_IOP_LENS_MODFLAG_ALL;
+  d->scale        = 1.0f;
+  d->distance     = 1000.0f;
+  d->tca_r        = 1.0f;
+  d->tca_b        = 1.0f;
+  d->cor_dist_ft  = 1.0f;
+  d->cor_vig_ft   = 1.0f;
+  d->cor_ca_r_ft  = 1.0f;
+  d->cor_ca_b_ft  = 1.0f;
+  d->scale_md_v1  = 1.0f;
+  d->scale_md     = 1.0f;
+  d->v_radius     = 0.5f;
+  d->v_steepness  = 0.5f;
+
+  if(self->dev)
+  {
+    const dt_image_t *img = &((dt_develop_t *)self->dev)->image_storage;
+    snprintf(d->camera, sizeof(d->camera), "%s", img->exif_model);
+    snprintf(d->lens, sizeof(d->lens), "%s", img->exif_lens);
+    d->crop     = img->exif_crop;
+    d->aperture = img->exif_aperture;
+    d->focal    = img->exif_focal_length;
+    if(img->exif_focus_distance != 0.0f)
+      d->distance = img->exif_focus_distance;
+    if(dt_image_is_monochrome(img))
+      d->modify_flags = DT_IOP_LENS_MODFLAG_DIST_VIGN;
+
+    /* prefer embedded metadata if available, with the new algorithm */
+    if(_have_embedded_metadata(img))
+    {
+      d->method     = DT_IOP_LENS_METHOD_EMBEDDED_METADATA;
+      d->md_version = DT_IOP_LENS_EMBEDDED_METADATA_VERSION_2;
+    }
+  }
+
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_lens_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->modify_roi_in      = modify_roi_in;
+  so->tiling_callback    = tiling_callback;
+}
@@ -0,0 +1,537 @@
+/*
+ * lut3d.c - darktable 3D LUT IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/lut3d.c (GPLv3).
+ * GUI code, OpenCL, G'MIC compressed LUTs and legacy_params() removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - .cube, .3dl and Hald CLUT .png files are parsed once per file by the
+ *     process-wide cache in common/lut3d_cache.h and shared by every pipe;
+ *     filepath is used as given (no LUT folder preference).
+ *   - Nodes are stored as padded RGBA, so each lookup is one aligned
+ *     4-float load.
+ *   - Tetrahedral interpolation runs on blocks of pixels: the cell index,
+ *     the tetrahedron and its four weights are computed branch-free for the
+ *     whole block in one SIMD loop, then the four nodes of each pixel are
+ *     gathered and blended.
+ *   - The conversion to and from the LUT colour space (matrix + transfer
+ *     curve) is done inline per pixel instead of in two extra passes over
+ *     the image.  Colour spaces are built from primaries
+ *     (common/colorspaces.h); linear ProPhoto is Bradford-adapted from D50.
+ *
+ * Struct layout of dt_iop_lut3d_params_t MUST match the descriptor table
+ * in libdtpipe/src/pipe/params.c (_lut3d_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2019-2025 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+#include "common/chromatic_adaptation.h"
+#include "common/lut3d_cache.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_IOP_LUT3D_MAX_PATHNAME 512
+#define DT_IOP_LUT3D_MAX_LUTNAME 128
+#define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+
+/* pixels per tetrahedral block; a multiple of the SIMD width */
+#define LUT3D_BLOCK 8
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+typedef enum dt_iop_lut3d_colorspace_t
+{
+  DT_IOP_SRGB = 0,     /* sRGB               */
+  DT_IOP_ARGB,         /* Adobe RGB          */
+  DT_IOP_REC709,       /* gamma Rec709 RGB   */
+  DT_IOP_LIN_REC709,   /* linear Rec709 RGB  */
+  DT_IOP_LIN_REC2020,  /* linear Rec2020 RGB */
+  DT_IOP_LIN_PROPHOTO, /* linear ProPhoto RGB */
+} dt_iop_lut3d_colorspace_t;
+
+typedef enum dt_iop_lut3d_interpolation_t
+{
+  DT_IOP_TETRAHEDRAL = 0,
+  DT_IOP_TRILINEAR = 1,
+  DT_IOP_PYRAMID = 2,
+} dt_iop_lut3d_interpolation_t;
+
+/*
+ * IMPORTANT: field order and types must exactly match _lut3d_params_t in
+ * pipe/params.c so that memcpy-based history load/save works correctly.
+ */
+typedef struct dt_iop_lut3d_params_t
+{
+  char filepath[DT_IOP_LUT3D_MAX_PATHNAME];
+  int32_t colorspace;      /* dt_iop_lut3d_colorspace_t               */
+  int32_t interpolation;   /* dt_iop_lut3d_interpolation_t            */
+  int32_t nb_keypoints;    /* > 0: G'MIC compressed LUT (unsupported) */
+  char c_clut[DT_IOP_LUT3D_MAX_KEYPOINTS * 2 * 3];
+  char lutname[DT_IOP_LUT3D_MAX_LUTNAME];
+} dt_iop_lut3d_params_t;
+
+typedef enum dt_iop_lut3d_trc_t
+{
+  LUT3D_TRC_LINEAR = 0,
+  LUT3D_TRC_SRGB,
+  LUT3D_TRC_REC709,
+  LUT3D_TRC_ADOBE,
+} dt_iop_lut3d_trc_t;
+
+typedef struct dt_iop_lut3d_data_t
+{
+  const dt_lut3d_t *lut;                 /* shared, from lut3d_cache      */
+  dt_iop_lut3d_interpolation_t interpolation;
+  gboolean to_lut;                       /* LUT space differs from pipe   */
+  dt_iop_lut3d_trc_t trc;
+  dt_colormatrix_t pipe_to_lut_transposed;
+  dt_colormatrix_t lut_to_pipe_transposed;
+} dt_iop_lut3d_data_t;
+
+/* ── LUT colour space ───────────────────────────────────────────────────── */
+
+static inline float _trc_encode(const float x, const dt_iop_lut3d_trc_t trc)
+{
+  const float v = fmaxf(x, 0.0f);
+  switch(trc)
+  {
+    case LUT3D_TRC_SRGB:
+      return v <= 0.0031308f ? 12.92f * v : 1.055f * powf(v, 1.0f / 2.4f) - 0.055f;
+    case LUT3D_TRC_REC709:
+      return v < 0.018f ? 4.5f * v : 1.099f * powf(v, 0.45f) - 0.099f;
+    case LUT3D_TRC_ADOBE:
+      return powf(v, 1.0f / 2.19921875f);
+    case LUT3D_TRC_LINEAR:
+    default:
+      return x;
+  }
+}
+
+static inline float _trc_decode(const float x, const dt_iop_lut3d_trc_t trc)
+{
+  const float v = fmaxf(x, 0.0f);
+  switch(trc)
+  {
+    case LUT3D_TRC_SRGB:
+      return v <= 0.04045f ? v / 12.92f : powf((v + 0.055f) / 1.055f, 2.4f);
+    case LUT3D_TRC_REC709:
+      return v < 0.081f ? v / 4.5f : powf((v + 0.099f) / 1.099f, 1.0f / 0.45f);
+    case LUT3D_TRC_ADOBE:
+      return powf(v, 2.19921875f);
+    case LUT3D_TRC_LINEAR:
+    default:
+      return x;
+  }
+}
+
+/* pipeline RGB -> LUT RGB, in place */
+static inline void _to_lut(dt_aligned_pixel_t px, const dt_iop_lut3d_data_t *const d)
+{
+  if(!d->to_lut) return;
+  dt_aligned_pixel_t tmp;
+  dt_apply_transposed_color_matrix(px, d->pipe_to_lut_transposed, tmp);
+  for_three_channels(c) px[c] = _trc_encode(tmp[c], d->trc);
+}
+
+/* LUT RGB -> pipeline RGB, in place */
+static inline void _from_lut(dt_aligned_pixel_t px, const dt_iop_lut3d_data_t *const d)
+{
+  if(!d->to_lut) return;
+  dt_aligned_pixel_t tmp;
+  for_three_channels(c) tmp[c] = _trc_decode(px[c], d->trc);
+  tmp[3] = 0.0f;
+  dt_apply_transposed_color_matrix(tmp, d->lut_to_pipe_transposed, px);
+}
+
+/*
+ * RGB -> XYZ (D65) of the LUT colour space.  ProPhoto is defined against
+ * D50, so its matrix is followed by a linear Bradford D50 -> D65.
+ */
+static void _lut_rgb_to_xyz(const dt_iop_lut3d_colorspace_t cs, dt_colormatrix_t RGB_to_XYZ)
+{
+  if(cs == DT_IOP_LIN_PROPHOTO)
+  {
+    static const float prophoto[3][2] = { { 0.7347f, 0.2653f }, { 0.1596f, 0.8404f }, { 0.0366f, 0.0001f } };
+    static const float d50[2] = { 0.3457f, 0.3585f };
+
+    dt_colormatrix_t transposed, RGB_to_XYZ_D50;
+    dt_make_transposed_matrices_from_primaries_and_whitepoint(prophoto, d50, transposed);
+    dt_colormatrix_transpose(RGB_to_XYZ_D50, transposed);
+
+    dt_aligned_pixel_t XYZ_D50 = { d50[0] / d50[1], 1.0f, (1.0f - d50[0] - d50[1]) / d50[1], 0.0f };
+    dt_aligned_pixel_t LMS_D50;
+    convert_XYZ_to_bradford_LMS(XYZ_D50, LMS_D50);
+
+    dt_colormatrix_t adapt, tmp, D50_to_D65;
+    dt_colormatrix_identity(adapt);
+    for(int c = 0; c < 3; c++) adapt[c][c] = Bradford_LMS_D65[c] / LMS_D50[c];
+    dt_colormatrix_mul(tmp, adapt, XYZ_to_Bradford_LMS);
+    dt_colormatrix_mul(D50_to_D65, Bradford_LMS_to_XYZ, tmp);
+    dt_colormatrix_mul(RGB_to_XYZ, D50_to_D65, RGB_to_XYZ_D50);
+    return;
+  }
+
+  const dt_colorspaces_color_profile_type_t type
+    = (cs == DT_IOP_ARGB) ? DT_COLORSPACE_ADOBERGB
+    : (cs == DT_IOP_LIN_REC2020) ? DT_COLORSPACE_LIN_REC2020
+    : DT_COLORSPACE_LIN_REC709; /* sRGB and Rec709 share the primaries */
+
+  dt_colorspaces_rgb_space_t space;
+  dt_colorspaces_get_rgb_space(type, &space);
+  memcpy(RGB_to_XYZ, space.matrix_in, sizeof(dt_colormatrix_t));
+}
+
+/* ── Tetrahedral interpolation ──────────────────────────────────────────── */
+
+/*
+ * from OpenColorIO
+ * https://github.com/imageworks/OpenColorIO/blob/master/src/OpenColorIO/ops/Lut3D/Lut3DOp.cpp
+ *
+ * The six cases of the original are one walk from P000 to P111 along the
+ * axes sorted by decreasing fraction: P000 -> +max axis -> +mid axis ->
+ * P111, with weights 1 - dmax, dmax - dmid, dmid - dmin and dmin.  Written
+ * that way the tetrahedron is selected without branches, so the first loop
+ * below vectorizes across the block; ties pick distinct axes and leave the
+ * extra vertices with zero weight.
+ */
+static void _correct_pixel_tetrahedral(const float *const in,
+                                       float *const out,
+                                       const size_t pixel_nb,
+                                       const dt_iop_lut3d_data_t *const d)
+{
+  const float *const restrict clut = DT_IS_ALIGNED(d->lut->clut);
+  const int level = d->lut->level;
+  const float flevel_1 = (float)(level - 1);
+  /* node strides in floats */
+  const int s_r = 4;
+  const int s_g = 4 * level;
+  const int s_b = 4 * level * level;
+  const int s_rgb = s_r + s_g + s_b;
+
+  DT_OMP_FOR()
+  for(size_t k0 = 0; k0 < pixel_nb; k0 += LUT3D_BLOCK)
+  {
+    const size_t n = MIN((size_t)LUT3D_BLOCK, pixel_nb - k0);
+
+    dt_aligned_pixel_t px[LUT3D_BLOCK];
+    for(size_t j = 0; j < LUT3D_BLOCK; j++)
+    {
+      if(j < n)
+      {
+        copy_pixel(px[j], in + 4 * (k0 + j));
+        _to_lut(px[j], d);
+      }
+      else
+        px[j][0] = px[j][1] = px[j][2] = px[j][3] = 0.0f;
+    }
+
+    DT_ALIGNED_ARRAY int base[LUT3D_BLOCK], o1[LUT3D_BLOCK], o2[LUT3D_BLOCK];
+    DT_ALIGNED_ARRAY float w0[LUT3D_BLOCK], w1[LUT3D_BLOCK], w2[LUT3D_BLOCK], w3[LUT3D_BLOCK];
+
+    DT_OMP_SIMD(aligned(base, o1, o2, w0, w1, w2, w3 : 64))
+    for(int j = 0; j < LUT3D_BLOCK; j++)
+    {
+      const float r = CLIP(px[j][0]) * flevel_1;
+      const float g = CLIP(px[j][1]) * flevel_1;
+      const float b = CLIP(px[j][2]) * flevel_1;
+      const int ri = MIN((int)r, level - 2);
+      const int gi = MIN((int)g, level - 2);
+      const int bi = MIN((int)b, level - 2);
+      const float fr = r - ri;
+      const float fg = g - gi;
+      const float fb = b - bi;
+
+      const int r_max = fr >= fg && fr >= fb;
+      const int g_max = !r_max && fg >= fb;
+      const float dmax = r_max ? fr : (g_max ? fg : fb);
+      const int omax = r_max ? s_r : (g_max ? s_g : s_b);
+
+      const int b_min = fb <= fr && fb <= fg;
+      const int g_min = !b_min && fg <= fr;
+      const float dmin = b_min ? fb : (g_min ? fg : fr);
+      const int omin = b_min ? s_b : (g_min ? s_g : s_r);
+
+      const float dmid = fr + fg + fb - dmax - dmin;
+
+      base[j] = s_r * ri + s_g * gi + s_b * bi;
+      o1[j] = omax;
+      o2[j] = s_rgb - omin;
+      w0[j] = 1.0f - dmax;
+      w1[j] = dmax - dmid;
+      w2[j] = dmid - dmin;
+      w3[j] = dmin;
+    }
+
+    for(size_t j = 0; j < n; j++)
+    {
+      const float *const restrict p = clut + base[j];
+      const float *const restrict p1 = p + o1[j];
+      const float *const restrict p2 = p + o2[j];
+      const float *const restrict p3 = p + s_rgb;
+      dt_aligned_pixel_t o;
+      for_four_channels(c, aligned(p, p1, p2, p3 : 16))
+        o[c] = w0[j] * p[c] + w1[j] * p1[c] + w2[j] * p2[c] + w3[j] * p3[c];
+      _from_lut(o, d);
+      o[3] = in[4 * (k0 + j) + 3];
+      // not using non-temporal writes here, as those are substantially slower when in==out....
+      copy_pixel(out + 4 * (k0 + j), o);
+    }
+  }
+}
+
+/* ── Trilinear and pyramid interpolation ────────────────────────────────── */
+
+/* cell origin (node offset in floats) and fractions of one pixel */
+static inline size_t _cell(const dt_aligned_pixel_t px, const int level, dt_aligned_pixel_t rgbd)
+{
+  const float flevel_1 = (float)(level - 1);
+  int rgbi[3];
+  for(int c = 0; c < 3; c++)
+  {
+    const float v = CLIP(px[c]) * flevel_1;
+    rgbi[c] = MIN((int)v, level - 2);
+    rgbd[c] = v - rgbi[c];
+  }
+  rgbd[3] = 0.0f;
+  return 4 * (rgbi[0] + (size_t)level * rgbi[1] + (size_t)level * level * rgbi[2]);
+}
+
+// From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
+static void _correct_pixel_trilinear(const float *const in,
+                                     float *const out,
+                                     const size_t pixel_nb,
+                                     const dt_iop_lut3d_data_t *const d)
+{
+  const float *const restrict clut = DT_IS_ALIGNED(d->lut->clut);
+  const int level = d->lut->level;
+  const size_t s_r = 4;
+  const size_t s_g = 4 * (size_t)level;
+  const size_t s_b = 4 * (size_t)level * level;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < pixel_nb; k++)
+  {
+    dt_aligned_pixel_t px, rgbd, tmp1, tmp2, tmp3;
+    copy_pixel(px, in + 4 * k);
+    _to_lut(px, d);
+
+    const float *const restrict p = clut + _cell(px, level, rgbd);
+
+    for_four_channels(c) // P000 and P100
+      tmp1[c] = p[c] * (1.0f - rgbd[0]) + p[s_r + c] * rgbd[0];
+    for_four_channels(c) // P010 and P110
+      tmp2[c] = p[s_g + c] * (1.0f - rgbd[0]) + p[s_g + s_r + c] * rgbd[0];
+    for_four_channels(c) // blend P000/P100 with P010/P110
+      tmp3[c] = tmp1[c] * (1.0f - rgbd[1]) + tmp2[c] * rgbd[1];
+    for_four_channels(c) // P001 and P101
+      tmp1[c] = p[s_b + c] * (1.0f - rgbd[0]) + p[s_b + s_r + c] * rgbd[0];
+    for_four_channels(c) // P011 and P111
+      tmp2[c] = p[s_b + s_g + c] * (1.0f - rgbd[0]) + p[s_b + s_g + s_r + c] * rgbd[0];
+    for_four_channels(c) // blend P001/P101 and P011/P111
+      tmp1[c] = tmp1[c] * (1.0f - rgbd[1]) + tmp2[c] * rgbd[1];
+    for_four_channels(c)
+      px[c] = tmp3[c] * (1.0f - rgbd[2]) + tmp1[c] * rgbd[2];
+
+    _from_lut(px, d);
+    px[3] = in[4 * k + 3];
+    copy_pixel(out + 4 * k, px);
+  }
+}
+
+// from Study on the 3D Interpolation Models Used in Color Conversion
+// http://ijetch.org/papers/318-T860.pdf
+static void _correct_pixel_pyramid(const float *const in,
+                                   float *const out,
+                                   const size_t pixel_nb,
+                                   const dt_iop_lut3d_data_t *const d)
+{
+  const float *const restrict clut = DT_IS_ALIGNED(d->lut->clut);
+  const int level = d->lut->level;
+  const size_t s_r = 4;
+  const size_t s_g = 4 * (size_t)level;
+  const size_t s_b = 4 * (size_t)level * level;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < pixel_nb; k++)
+  {
+    dt_aligned_pixel_t px, rgbd, o;
+    copy_pixel(px, in + 4 * k);
+    _to_lut(px, d);
+
+    const float *const restrict c000 = clut + _cell(px, level, rgbd);
+    const float *const restrict c100 = c000 + s_r;
+    const float *const restrict c010 = c000 + s_g;
+    const float *const restrict c110 = c010 + s_r;
+    const float *const restrict c001 = c000 + s_b;
+    const float *const restrict c101 = c001 + s_r;
+    const float *const restrict c011 = c001 + s_g;
+    const float *const restrict c111 = c011 + s_r;
+
+    if(rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
+    {
+      for_four_channels(c)
+        o[c] = c000[c] + (c111[c] - c011[c]) * rgbd[0] + (c010[c] - c000[c]) * rgbd[1]
+               + (c001[c] - c000[c]) * rgbd[2]
+               + (c011[c] - c001[c] - c010[c] + c000[c]) * rgbd[1] * rgbd[2];
+    }
+    else if(rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
+    {
+      for_four_channels(c)
+        o[c] = c000[c] + (c100[c] - c000[c]) * rgbd[0] + (c111[c] - c101[c]) * rgbd[1]
+               + (c001[c] - c000[c]) * rgbd[2]
+               + (c101[c] - c001[c] - c100[c] + c000[c]) * rgbd[0] * rgbd[2];
+    }
+    else
+    {
+      for_four_channels(c)
+        o[c] = c000[c] + (c100[c] - c000[c]) * rgbd[0] + (c010[c] - c000[c]) * rgbd[1]
+               + (c111[c] - c110[c]) * rgbd[2]
+               + (c110[c] - c100[c] - c010[c] + c000[c]) * rgbd[0] * rgbd[1];
+    }
+
+    _from_lut(o, d);
+    o[3] = in[4 * k + 3];
+    copy_pixel(out + 4 * k, o);
+  }
+}
+
+/* ── process() ──────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_lut3d_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+  if(!d->lut)
+  {
+    dt_iop_image_copy(out, in, 4 * npixels);
+    return;
+  }
+
+  if(d->interpolation == DT_IOP_TRILINEAR)
+    _correct_pixel_trilinear(in, out, npixels, d);
+  else if(d->interpolation == DT_IOP_PYRAMID)
+    _correct_pixel_pyramid(in, out, npixels, d);
+  else
+    _correct_pixel_tetrahedral(in, out, npixels, d);
+}
+
+/* ── commit_params() ────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self,
+                          dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_lut3d_params_t *p = (const dt_iop_lut3d_params_t *)p1;
+  dt_iop_lut3d_data_t *d = piece->data;
+
+  /* acquire before releasing so an unchanged LUT keeps its reference; the
+     cache checks the file's mtime, so edits on disk are picked up here */
+  char path[DT_IOP_LUT3D_MAX_PATHNAME];
+  g_strlcpy(path, p->filepath, sizeof(path));
+  const dt_lut3d_t *lut = path[0] ? dt_lut3d_acquire(path) : NULL;
+  dt_lut3d_release(d->lut);
+  d->lut = lut;
+
+  d->interpolation = (dt_iop_lut3d_interpolation_t)p->interpolation;
+
+  const dt_iop_lut3d_colorspace_t cs = (dt_iop_lut3d_colorspace_t)p->colorspace;
+  d->trc = (cs == DT_IOP_SRGB) ? LUT3D_TRC_SRGB
+         : (cs == DT_IOP_REC709) ? LUT3D_TRC_REC709
+         : (cs == DT_IOP_ARGB) ? LUT3D_TRC_ADOBE
+         : LUT3D_TRC_LINEAR;
+  d->to_lut = (cs != DT_IOP_LIN_REC709);
+
+  dt_colorspaces_rgb_space_t pipe_space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &pipe_space);
+
+  dt_colormatrix_t lut_to_xyz, xyz_to_lut, pipe_to_lut, lut_to_pipe;
+  _lut_rgb_to_xyz(cs, lut_to_xyz);
+  mat3SSEinv(xyz_to_lut, lut_to_xyz);
+  dt_colormatrix_mul(pipe_to_lut, xyz_to_lut, pipe_space.matrix_in);
+  dt_colormatrix_mul(lut_to_pipe, pipe_space.matrix_out, lut_to_xyz);
+  dt_colormatrix_transpose(d->pipe_to_lut_transposed, pipe_to_lut);
+  dt_colormatrix_transpose(d->lut_to_pipe_transposed, lut_to_pipe);
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_lut3d_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_lut3d_data_t *d = piece->data;
+  if(d) dt_lut3d_release(d->lut);
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_lut3d_params_t *d = self->default_params;
+  if(!d) return;
+
+  /* the params buffer only spans the fields described in params.c (up to
+     nb_keypoints), so never touch c_clut / lutname here */
+  const size_t size = (size_t)self->params_size;
+  memset(d, 0, size);
+  d->colorspace    = DT_IOP_SRGB;
+  d->interpolation = DT_IOP_TETRAHEDRAL;
+
+  memcpy(self->params, d, size);
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_lut3d_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+}
@@ -12,6 +12,14 @@
  *   - Adjusts the filter pattern offset for left/top sensor crop.
  *   - Trims the left/top/right/bottom sensor border pixels.
  *
+ * Adapted for libdtpipe:
+ *   - when the planner hands it a hot pixel filter (piece->fused_hotpixels,
+ *     see _plan_raw_fusion() in pipe/pixelpipe.c) the Bayer branches scale
+ *     the mosaic into a per-thread ring of five rows and run the filter on
+ *     it before writing the row out, so the hot pixels module neither
+ *     reads nor writes the mosaic.  The per-colour gains of the pieces in
+ *     between are divided out of the threshold.
+ *
  * Param struct layout MUST match _rawprepare_params_t in pipe/params.c:
  *   int32_t  left, top, right, bottom       (crop edges)
  *   uint16_t raw_black_level_separate[4]    (per-CFA black level)
@@ -22,6 +30,7 @@
  */
 
 #include "dtpipe_internal.h"
+#include "common/hotpixels.h"
 #include "iop/iop_math.h"
 
 #include <math.h>
@@ -101,6 +110,108 @@ static int _compute_proper_crop(dt_dev_pixelpipe_iop_t *piece,
   return (int)roundf((float)value * scale);
 }
 
+/* ── Fused hot pixel pass ────────────────────────────────────────────────── */
+
+/* rows per band of the fused pass; each band re-scales four rows of halo */
+#define RAWPREPARE_FUSED_BAND 64
+
+/* One output row of the black / white scaling, from uint16 or float input. */
+static inline void _scale_row(const dt_iop_rawprepare_data_t *const d,
+                              const void *const ivoid,
+                              const gboolean floating,
+                              const dt_iop_roi_t *const roi_in,
+                              const dt_iop_roi_t *const roi_out,
+                              const int csx,
+                              const int csy,
+                              const int j,
+                              float *const restrict row)
+{
+  const size_t pin = (size_t)roi_in->width * (j + csy) + csx;
+  const int idy = ((j + roi_out->y + d->top) & 1) << 1;
+  if(floating)
+  {
+    const float *const in = (const float *)ivoid + pin;
+    DT_OMP_SIMD()
+    for(int i = 0; i < roi_out->width; i++)
+    {
+      const int id = idy | ((i + roi_out->x + d->left) & 1);
+      row[i] = (in[i] - d->sub[id]) / d->div[id];
+    }
+  }
+  else
+  {
+    const uint16_t *const in = (const uint16_t *)ivoid + pin;
+    DT_OMP_SIMD()
+    for(int i = 0; i < roi_out->width; i++)
+    {
+      const int id = idy | ((i + roi_out->x + d->left) & 1);
+      row[i] = (in[i] - d->sub[id]) / d->div[id];
+    }
+  }
+}
+
+/*
+ * Scaling plus hot pixel filter.  Rows j - 2 .. j + 2 live in a ring of
+ * five, so every input row is scaled once per band and the filtered row is
+ * the only write to the output.  filters is the pattern of the output.
+ */
+static void _process_fused_hotpixels(const dt_dev_pixelpipe_iop_t *const piece,
+                                     const void *const ivoid,
+                                     const gboolean floating,
+                                     float *const out,
+                                     const dt_iop_roi_t *const roi_in,
+                                     const dt_iop_roi_t *const roi_out,
+                                     const int csx,
+                                     const int csy,
+                                     const uint32_t filters)
+{
+  const dt_iop_rawprepare_data_t *const d = piece->data;
+  const dt_hotpixels_t *const h = piece->fused_hotpixels;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+
+  // threshold per row / column parity, in units before the later gains
+  float thr[2][2];
+  for(int r = 0; r < 2; r++)
+    for(int c = 0; c < 2; c++)
+    {
+      const float g = piece->fused_raw_gains[FC(r + roi_out->y, c + roi_out->x, filters)];
+      thr[r][c] = h->threshold / (g > 0.0f ? g : 1.0f);
+    }
+
+  size_t padded;
+  float *const ring = dt_alloc_perthread_float((size_t)5 * width, &padded);
+  if(!ring) return;
+
+  const int nbands = (height + RAWPREPARE_FUSED_BAND - 1) / RAWPREPARE_FUSED_BAND;
+  DT_OMP_FOR()
+  for(int b = 0; b < nbands; b++)
+  {
+    float *const rows = dt_get_perthread(ring, padded);
+    const int j0 = b * RAWPREPARE_FUSED_BAND;
+    const int j1 = MIN(height, j0 + RAWPREPARE_FUSED_BAND);
+
+    for(int j = MAX(0, j0 - 2); j < MIN(height, j0 + 2); j++)
+      _scale_row(d, ivoid, floating, roi_in, roi_out, csx, csy, j, rows + (size_t)(j % 5) * width);
+
+    for(int j = j0; j < j1; j++)
+    {
+      if(j + 2 < height)
+        _scale_row(d, ivoid, floating, roi_in, roi_out, csx, csy, j + 2,
+                   rows + (size_t)((j + 2) % 5) * width);
+      const float *const mid = rows + (size_t)(j % 5) * width;
+      float *const o = out + (size_t)j * width;
+      if(j < 2 || j >= height - 2)
+        memcpy(o, mid, sizeof(float) * width);
+      else
+        dt_hotpixels_bayer_row(h, thr[j & 1], rows + (size_t)((j - 2) % 5) * width, mid,
+                               rows + (size_t)((j + 2) % 5) * width, o, width);
+    }
+  }
+
+  dt_free_align(ring);
+}
+
 /* ── process ─────────────────────────────────────────────────────────────── */
 
 static void process(dt_iop_module_t *self,
@@ -120,30 +231,37 @@ static void process(dt_iop_module_t *self,
   if(piece->pipe->dsc.filters && piece->dsc_in.channels == 1
      && piece->dsc_in.datatype == TYPE_UINT16)
   {
+    /* Adjust the CFA filter pattern for the crop offset */
+    const uint32_t filters =
+        _crop_dcraw_filters(self->dev
+                            ? ((dt_develop_t *)self->dev)->image_storage.buf_dsc.filters
+                            : piece->pipe->image.buf_dsc.filters,
+                            csx, csy);
+
     /* Raw uint16 Bayer mosaic: subtract black, normalise */
     const uint16_t *const in = (const uint16_t *const)ivoid;
 
-    DT_OMP_FOR_SIMD(collapse(2))
-    for(int j = 0; j < roi_out->height; j++)
+    if(piece->fused_hotpixels && filters != 9u)
+      _process_fused_hotpixels(piece, ivoid, FALSE, out, roi_in, roi_out, csx, csy, filters);
+    else
     {
-      for(int i = 0; i < roi_out->width; i++)
+      DT_OMP_FOR_SIMD(collapse(2))
+      for(int j = 0; j < roi_out->height; j++)
       {
-        const size_t pin  = (size_t)(roi_in->width * (j + csy) + csx) + i;
-        const size_t pout = (size_t)j * roi_out->width + i;
+        for(int i = 0; i < roi_out->width; i++)
+        {
+          const size_t pin  = (size_t)(roi_in->width * (j + csy) + csx) + i;
+          const size_t pout = (size_t)j * roi_out->width + i;
 
-        /* Determine the Bayer channel quadrant for this pixel */
-        const int id = (((j + roi_out->y + d->top) & 1) << 1)
-                     | ((i + roi_out->x + d->left) & 1);
-        out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+          /* Determine the Bayer channel quadrant for this pixel */
+          const int id = (((j + roi_out->y + d->top) & 1) << 1)
+                       | ((i + roi_out->x + d->left) & 1);
+          out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+        }
       }
     }
 
-    /* Adjust the CFA filter pattern for the crop offset */
-    piece->pipe->dsc.filters =
-        _crop_dcraw_filters(self->dev
-                            ? ((dt_develop_t *)self->dev)->image_storage.buf_dsc.filters
-                            : piece->pipe->image.buf_dsc.filters,
-                            csx, csy);
+    piece->pipe->dsc.filters = filters;
 
     /* Adjust the X-Trans filter pattern for the crop offset */
     if(piece->pipe->dsc.filters == 9u)
@@ -157,28 +275,35 @@ static void process(dt_iop_module_t *self,
   else if(piece->pipe->dsc.filters && piece->dsc_in.channels == 1
           && piece->dsc_in.datatype == TYPE_FLOAT)
   {
+    const uint32_t filters =
+        _crop_dcraw_filters(self->dev
+                            ? ((dt_develop_t *)self->dev)->image_storage.buf_dsc.filters
+                            : piece->pipe->image.buf_dsc.filters,
+                            csx, csy);
+
     /* Raw float mosaic (HDR DNG) */
     const float *const in = (const float *const)ivoid;
 
-    DT_OMP_FOR_SIMD(collapse(2))
-    for(int j = 0; j < roi_out->height; j++)
+    if(piece->fused_hotpixels && filters != 9u)
+      _process_fused_hotpixels(piece, ivoid, TRUE, out, roi_in, roi_out, csx, csy, filters);
+    else
     {
-      for(int i = 0; i < roi_out->width; i++)
+      DT_OMP_FOR_SIMD(collapse(2))
+      for(int j = 0; j < roi_out->height; j++)
       {
-        const size_t pin  = (size_t)(roi_in->width * (j + csy) + csx) + i;
-        const size_t pout = (size_t)j * roi_out->width + i;
+        for(int i = 0; i < roi_out->width; i++)
+        {
+          const size_t pin  = (size_t)(roi_in->width * (j + csy) + csx) + i;
+          const size_t pout = (size_t)j * roi_out->width + i;
 
-        const int id = (((j + roi_out->y + d->top) & 1) << 1)
-                     | ((i + roi_out->x + d->left) & 1);
-        out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+          const int id = (((j + roi_out->y + d->top) & 1) << 1)
+                       | ((i + roi_out->x + d->left) & 1);
+          out[pout] = (in[pin] - d->sub[id]) / d->div[id];
+        }
       }
     }
 
-    piece->pipe->dsc.filters =
-        _crop_dcraw_filters(self->dev
-                            ? ((dt_develop_t *)self->dev)->image_storage.buf_dsc.filters
-                            : piece->pipe->image.buf_dsc.filters,
-                            csx, csy);
+    piece->pipe->dsc.filters = filters;
 
     if(piece->pipe->dsc.filters == 9u)
     {
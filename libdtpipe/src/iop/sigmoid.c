@@ -0,0 +1,556 @@
+/*
+ * sigmoid.c - darktable sigmoid IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/sigmoid.c (GPLv3).
+ * GUI code, OpenCL, presets and legacy_params() removed.
+ * Adapted to compile against dtpipe_internal.h instead of darktable headers.
+ *
+ * Adapted for libdtpipe:
+ *   - The generalized log-logistic curve is tabulated once per commit in a
+ *     log-domain LUT (common/curve_lut.h); process() does no powf.
+ *   - The primaries matrices are built in commit_params() instead of once
+ *     per process() call.
+ *   - "working profile" base primaries resolve to linear Rec.709, the
+ *     pipeline colour space (common/colorspaces.h).
+ *   - The per-pixel kernels are static inline functions taking only the
+ *     committed data, so they can be chained with other pointwise ops.
+ *
+ * Struct layout of dt_iop_sigmoid_params_t MUST match the descriptor table
+ * in libdtpipe/src/pipe/params.c (_sigmoid_params_t).
+ *
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Copyright (C) 2020-2024 darktable developers (GPLv3)
+ */
+
+#include "dtpipe_internal.h"
+#include "iop/iop_math.h"
+#include "common/colorspaces.h"
+#include "common/curve_lut.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MIDDLE_GREY 0.1845f
+
+/* Input range covered by the curve LUT: 2^-20 .. 2^16 */
+#define SIGMOID_LUT_LO_EXP -20
+#define SIGMOID_LUT_HI_EXP 16
+
+/* ── Parameter and data structs ─────────────────────────────────────────── */
+
+typedef enum dt_iop_sigmoid_methods_type_t
+{
+  DT_SIGMOID_METHOD_PER_CHANNEL = 0,
+  DT_SIGMOID_METHOD_RGB_RATIO = 1,
+} dt_iop_sigmoid_methods_type_t;
+
+typedef enum dt_iop_sigmoid_base_primaries_t
+{
+  DT_SIGMOID_WORK_PROFILE = 0,
+  DT_SIGMOID_REC2020 = 1,
+  DT_SIGMOID_DISPLAY_P3 = 2,
+  DT_SIGMOID_ADOBE_RGB = 3,
+  DT_SIGMOID_SRGB = 4,
+} dt_iop_sigmoid_base_primaries_t;
+
+/*
+ * IMPORTANT: field order and types must exactly match _sigmoid_params_t in
+ * pipe/params.c so that memcpy-based history load/save works correctly.
+ */
+typedef struct dt_iop_sigmoid_params_t
+{
+  float   middle_grey_contrast;  /* [0.1, 10]     default 1.5            */
+  float   contrast_skewness;     /* [-1, 1]       default 0              */
+  float   display_white_target;  /* [20, 1600] %  default 100            */
+  float   display_black_target;  /* [0, 15] %     default 0.0152         */
+  int32_t color_processing;      /* dt_iop_sigmoid_methods_type_t        */
+  float   hue_preservation;      /* [0, 100] %    default 100            */
+  float   red_inset;             /* [0, 0.99]                            */
+  float   red_rotation;          /* [-0.4, 0.4] rad                      */
+  float   green_inset;
+  float   green_rotation;
+  float   blue_inset;
+  float   blue_rotation;
+  float   purity;                /* [0, 1]                               */
+  int32_t base_primaries;        /* dt_iop_sigmoid_base_primaries_t      */
+} dt_iop_sigmoid_params_t;
+
+typedef struct dt_iop_sigmoid_data_t
+{
+  float white_target;
+  float black_target;
+  float paper_exposure;
+  float film_fog;
+  float film_power;
+  float paper_power;
+  dt_iop_sigmoid_methods_type_t color_processing;
+  float hue_preservation;
+  float inset[3];
+  float rotation[3];
+  float purity;
+  dt_iop_sigmoid_base_primaries_t base_primaries;
+  dt_colormatrix_t pipe_to_base;       /* per channel only */
+  dt_colormatrix_t base_to_rendering;
+  dt_colormatrix_t rendering_to_pipe;
+  dt_curve_lut_t curve;                /* scene -> display, log-domain LUT */
+} dt_iop_sigmoid_data_t;
+
+/* ── Curve ──────────────────────────────────────────────────────────────── */
+
+static inline float _generalized_loglogistic_sigmoid(const float value,
+                                                     const float magnitude,
+                                                     const float paper_exp,
+                                                     const float film_fog,
+                                                     const float film_power,
+                                                     const float paper_power)
+{
+  const float clamped_value = fmaxf(value, 0.0f);
+  /* The model magnitude * (1 + paper_exp * (film_fog + value)^-film_power)^-paper_power
+   * has a pole at 0; this is the same curve rewritten to be stable there. */
+  const float film_response = powf(film_fog + clamped_value, film_power);
+  const float paper_response = magnitude * powf(film_response / (paper_exp + film_response), paper_power);
+
+  /* Safety check for very large floats that cause numerical errors */
+  return dt_isnan(paper_response) ? magnitude : paper_response;
+}
+
+static float _sigmoid_curve(const float x, const void *data)
+{
+  const dt_iop_sigmoid_data_t *d = (const dt_iop_sigmoid_data_t *)data;
+  return _generalized_loglogistic_sigmoid(x, d->white_target, d->paper_exposure, d->film_fog,
+                                          d->film_power, d->paper_power);
+}
+
+/* ── Primaries ──────────────────────────────────────────────────────────── */
+
+static dt_colorspaces_color_profile_type_t _get_base_profile_type(const dt_iop_sigmoid_base_primaries_t base_primaries)
+{
+  if(base_primaries == DT_SIGMOID_SRGB)
+    return DT_COLORSPACE_SRGB;
+
+  if(base_primaries == DT_SIGMOID_DISPLAY_P3)
+    return DT_COLORSPACE_DISPLAY_P3;
+
+  if(base_primaries == DT_SIGMOID_ADOBE_RGB)
+    return DT_COLORSPACE_ADOBERGB;
+
+  return DT_COLORSPACE_LIN_REC2020;
+}
+
+/*
+ * "Inset" the pipe RGB toward achromatic along spectral lines before the
+ * per-channel curves, and rotate the primaries to compensate for Abney
+ * etc. (AgX by Troy Sobotka, https://github.com/sobotka/AgX-S2O3).
+ */
+static void _calculate_adjusted_primaries(dt_iop_sigmoid_data_t *const d,
+                                          const dt_colorspaces_rgb_space_t *const pipe_space,
+                                          const dt_colorspaces_rgb_space_t *const base_space)
+{
+  dt_colormatrix_t base_to_pipe;
+  if(pipe_space->type != base_space->type)
+  {
+    dt_colormatrix_mul(d->pipe_to_base, pipe_space->matrix_in_transposed, base_space->matrix_out_transposed);
+    mat3SSEinv(base_to_pipe, d->pipe_to_base);
+  }
+  else
+  {
+    dt_colormatrix_identity(d->pipe_to_base);
+    dt_colormatrix_identity(base_to_pipe);
+  }
+
+  /* rotated, scaled primaries are calculated based on the base space */
+  float custom_primaries[3][2];
+  for(size_t i = 0; i < 3; i++)
+    dt_rotate_and_scale_primary(base_space, 1.f - d->inset[i], d->rotation[i], i, custom_primaries[i]);
+
+  dt_colormatrix_t custom_to_XYZ;
+  dt_make_transposed_matrices_from_primaries_and_whitepoint(custom_primaries, base_space->whitepoint,
+                                                            custom_to_XYZ);
+  dt_colormatrix_mul(d->base_to_rendering, custom_to_XYZ, base_space->matrix_out_transposed);
+
+  for(size_t i = 0; i < 3; i++)
+  {
+    const float scaling = 1.f - d->purity * d->inset[i];
+    dt_rotate_and_scale_primary(base_space, scaling, d->rotation[i], i, custom_primaries[i]);
+  }
+
+  dt_make_transposed_matrices_from_primaries_and_whitepoint(custom_primaries, base_space->whitepoint,
+                                                            custom_to_XYZ);
+  dt_colormatrix_t tmp;
+  dt_colormatrix_mul(tmp, custom_to_XYZ, base_space->matrix_out_transposed);
+  dt_colormatrix_t rendering_to_base;
+  mat3SSEinv(rendering_to_base, tmp);
+  dt_colormatrix_mul(d->rendering_to_pipe, rendering_to_base, base_to_pipe);
+}
+
+/* ── commit_params ──────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_sigmoid_params_t *params = (const dt_iop_sigmoid_params_t *)p1;
+  dt_iop_sigmoid_data_t *module_data = piece->data;
+
+  /* Calculate actual skew log logistic parameters to fulfill the following:
+   * f(scene_zero) = display_black_target
+   * f(scene_grey) = MIDDLE_GREY
+   * f(scene_inf)  = display_white_target
+   * Slope at scene_grey independent of skewness i.e. only changed by the contrast parameter.
+   */
+
+  /* Reference slope for no skew and a normalized display */
+  const float ref_film_power = params->middle_grey_contrast;
+  const float ref_paper_power = 1.0f;
+  const float ref_magnitude = 1.0f;
+  const float ref_film_fog = 0.0f;
+  const float ref_paper_exposure
+      = powf(ref_film_fog + MIDDLE_GREY, ref_film_power) * ((ref_magnitude / MIDDLE_GREY) - 1.0f);
+  const float delta = 1e-6f;
+  const float ref_slope
+      = (_generalized_loglogistic_sigmoid(MIDDLE_GREY + delta, ref_magnitude, ref_paper_exposure, ref_film_fog,
+                                          ref_film_power, ref_paper_power)
+         - _generalized_loglogistic_sigmoid(MIDDLE_GREY - delta, ref_magnitude, ref_paper_exposure, ref_film_fog,
+                                            ref_film_power, ref_paper_power))
+        / 2.0f / delta;
+
+  /* Add skew */
+  module_data->paper_power = powf(5.0f, -params->contrast_skewness);
+
+  /* Slope at low film power */
+  const float temp_film_power = 1.0f;
+  const float temp_white_target = 0.01f * params->display_white_target;
+  const float temp_white_grey_relation
+      = powf(temp_white_target / MIDDLE_GREY, 1.0f / module_data->paper_power) - 1.0f;
+  const float temp_paper_exposure = powf(MIDDLE_GREY, temp_film_power) * temp_white_grey_relation;
+  const float temp_slope
+      = (_generalized_loglogistic_sigmoid(MIDDLE_GREY + delta, temp_white_target, temp_paper_exposure,
+                                          ref_film_fog, temp_film_power, module_data->paper_power)
+         - _generalized_loglogistic_sigmoid(MIDDLE_GREY - delta, temp_white_target, temp_paper_exposure,
+                                            ref_film_fog, temp_film_power, module_data->paper_power))
+        / 2.0f / delta;
+
+  /* Film power that fulfills the target slope (linear when display_black = 0) */
+  module_data->film_power = ref_slope / temp_slope;
+
+  /* The other parameters now that both film and paper power are known */
+  module_data->white_target = 0.01f * params->display_white_target;
+  module_data->black_target = 0.01f * params->display_black_target;
+  const float white_grey_relation
+      = powf(module_data->white_target / MIDDLE_GREY, 1.0f / module_data->paper_power) - 1.0f;
+  const float white_black_relation
+      = powf(module_data->black_target / module_data->white_target, -1.0f / module_data->paper_power) - 1.0f;
+
+  module_data->film_fog = MIDDLE_GREY * powf(white_grey_relation, 1.0f / module_data->film_power)
+                          / (powf(white_black_relation, 1.0f / module_data->film_power)
+                             - powf(white_grey_relation, 1.0f / module_data->film_power));
+  module_data->paper_exposure
+      = powf(module_data->film_fog + MIDDLE_GREY, module_data->film_power) * white_grey_relation;
+
+  module_data->color_processing = params->color_processing;
+  module_data->hue_preservation = fminf(fmaxf(0.01f * params->hue_preservation, 0.0f), 1.0f);
+
+  module_data->purity = params->purity;
+  module_data->inset[0] = params->red_inset;
+  module_data->inset[1] = params->green_inset;
+  module_data->inset[2] = params->blue_inset;
+  module_data->rotation[0] = params->red_rotation;
+  module_data->rotation[1] = params->green_rotation;
+  module_data->rotation[2] = params->blue_rotation;
+  module_data->base_primaries = params->base_primaries;
+
+  dt_colorspaces_rgb_space_t pipe_space, base_space;
+  dt_colorspaces_get_pipe_rgb_space(pipe, &pipe_space);
+  if(module_data->base_primaries == DT_SIGMOID_WORK_PROFILE)
+    base_space = pipe_space;
+  else
+    dt_colorspaces_get_rgb_space(_get_base_profile_type(module_data->base_primaries), &base_space);
+  _calculate_adjusted_primaries(module_data, &pipe_space, &base_space);
+
+  dt_curve_lut_init(&module_data->curve, SIGMOID_LUT_LO_EXP, SIGMOID_LUT_HI_EXP,
+                    _sigmoid_curve, module_data);
+}
+
+/* ── Per-pixel kernels ──────────────────────────────────────────────────── */
+
+static inline void _desaturate_negative_values(const dt_aligned_pixel_t pix_in, dt_aligned_pixel_t pix_out)
+{
+  const float pixel_average = fmaxf((pix_in[0] + pix_in[1] + pix_in[2]) / 3.0f, 0.0f);
+  const float min_value = min3f(pix_in);
+  const float saturation_factor = min_value < 0.0f ? -pixel_average / (min_value - pixel_average) : 1.0f;
+  for_each_channel(c, aligned(pix_in, pix_out))
+    pix_out[c] = pixel_average + saturation_factor * (pix_in[c] - pixel_average);
+}
+
+typedef struct dt_iop_sigmoid_value_order_t
+{
+  size_t min;
+  size_t mid;
+  size_t max;
+} dt_iop_sigmoid_value_order_t;
+
+static inline void _pixel_channel_order(const dt_aligned_pixel_t pix_in,
+                                        dt_iop_sigmoid_value_order_t *pixel_value_order)
+{
+  if(pix_in[0] >= pix_in[1])
+  {
+    if(pix_in[1] > pix_in[2])
+    { /* r >= g >  b */
+      pixel_value_order->max = 0; pixel_value_order->mid = 1; pixel_value_order->min = 2;
+    }
+    else if(pix_in[2] > pix_in[0])
+    { /* b >  r >= g */
+      pixel_value_order->max = 2; pixel_value_order->mid = 0; pixel_value_order->min = 1;
+    }
+    else if(pix_in[2] > pix_in[1])
+    { /* r >= b >  g */
+      pixel_value_order->max = 0; pixel_value_order->mid = 2; pixel_value_order->min = 1;
+    }
+    else
+    { /* r == g == b: no change of the middle value, just assign something */
+      pixel_value_order->max = 0; pixel_value_order->mid = 1; pixel_value_order->min = 2;
+    }
+  }
+  else
+  {
+    if(pix_in[0] >= pix_in[2])
+    { /* g >  r >= b */
+      pixel_value_order->max = 1; pixel_value_order->mid = 0; pixel_value_order->min = 2;
+    }
+    else if(pix_in[2] > pix_in[1])
+    { /* b >  g >  r */
+      pixel_value_order->max = 2; pixel_value_order->mid = 1; pixel_value_order->min = 0;
+    }
+    else
+    { /* g >= b >  r */
+      pixel_value_order->max = 1; pixel_value_order->mid = 2; pixel_value_order->min = 0;
+    }
+  }
+}
+
+/* Linear interpolation of hue that also preserves the sum of channels.
+ * Assumes hue_preservation strictly in range [0, 1]. */
+static inline void _preserve_hue_and_energy(const dt_aligned_pixel_t pix_in,
+                                            const dt_aligned_pixel_t per_channel,
+                                            dt_aligned_pixel_t pix_out,
+                                            const dt_iop_sigmoid_value_order_t order,
+                                            const float hue_preservation)
+{
+  /* Naive hue correction of the middle channel */
+  const float chroma = pix_in[order.max] - pix_in[order.min];
+  const float midscale = chroma != 0.f ? (pix_in[order.mid] - pix_in[order.min]) / chroma : 0.f;
+  const float full_hue_correction
+      = per_channel[order.min] + (per_channel[order.max] - per_channel[order.min]) * midscale;
+  const float naive_hue_mid
+      = (1.0f - hue_preservation) * per_channel[order.mid] + hue_preservation * full_hue_correction;
+
+  const float per_channel_energy = per_channel[0] + per_channel[1] + per_channel[2];
+  const float naive_hue_energy = per_channel[order.min] + naive_hue_mid + per_channel[order.max];
+  const float pix_in_min_plus_mid = pix_in[order.min] + pix_in[order.mid];
+  const float blend_factor = pix_in_min_plus_mid != 0.f ? 2.0f * pix_in[order.min] / pix_in_min_plus_mid : 0.f;
+  const float energy_target = blend_factor * per_channel_energy + (1.0f - blend_factor) * naive_hue_energy;
+
+  /* Preserve hue constrained to maintain the same energy as the per channel result */
+  if(naive_hue_mid <= per_channel[order.mid])
+  {
+    const float corrected_mid = ((1.0f - hue_preservation) * per_channel[order.mid]
+                                 + hue_preservation
+                                       * (midscale * per_channel[order.max]
+                                          + (1.0f - midscale) * (energy_target - per_channel[order.max])))
+                                / (1.0f + hue_preservation * (1.0f - midscale));
+    pix_out[order.min] = energy_target - per_channel[order.max] - corrected_mid;
+    pix_out[order.mid] = corrected_mid;
+    pix_out[order.max] = per_channel[order.max];
+  }
+  else
+  {
+    const float corrected_mid = ((1.0f - hue_preservation) * per_channel[order.mid]
+                                 + hue_preservation
+                                       * (per_channel[order.min] * (1.0f - midscale)
+                                          + midscale * (energy_target - per_channel[order.min])))
+                                / (1.0f + hue_preservation * midscale);
+    pix_out[order.min] = per_channel[order.min];
+    pix_out[order.mid] = corrected_mid;
+    pix_out[order.max] = energy_target - per_channel[order.min] - corrected_mid;
+  }
+}
+
+/** RGB ratio: tone map a luma estimate and scale the triplet uniformly. */
+static inline void _sigmoid_rgb_ratio_pixel(const dt_iop_sigmoid_data_t *const d,
+                                            const dt_aligned_pixel_t pix_in,
+                                            dt_aligned_pixel_t pix_out)
+{
+  dt_aligned_pixel_t pre_out;
+  dt_aligned_pixel_t pix_in_strict_positive;
+
+  _desaturate_negative_values(pix_in, pix_in_strict_positive);
+
+  const float luma = (pix_in_strict_positive[0] + pix_in_strict_positive[1] + pix_in_strict_positive[2]) / 3.0f;
+  const float mapped_luma = dt_curve_lut_eval(&d->curve, luma);
+
+  if(luma > 1e-9f)
+  {
+    const float scaling_factor = mapped_luma / luma;
+    for_each_channel(c, aligned(pix_in_strict_positive, pre_out))
+      pre_out[c] = scaling_factor * pix_in_strict_positive[c];
+  }
+  else
+  {
+    for_each_channel(c, aligned(pre_out))
+      pre_out[c] = mapped_luma;
+  }
+
+  dt_iop_sigmoid_value_order_t order;
+  _pixel_channel_order(pre_out, &order);
+  const float pixel_min = pre_out[order.min];
+  const float pixel_max = pre_out[order.max];
+
+  /* Chroma relative display gamut and scene "mapping" gamut */
+  const float epsilon = 1e-6f;
+  const float display_border_vs_chroma_white
+      = (d->white_target - mapped_luma) / (pixel_max - mapped_luma + epsilon);
+  const float display_border_vs_chroma_black
+      = (d->black_target - mapped_luma) / (pixel_min - mapped_luma - epsilon);
+  const float display_border_vs_chroma = fminf(display_border_vs_chroma_white, display_border_vs_chroma_black);
+  const float chroma_vs_mapping_border = (mapped_luma - pixel_min) / (mapped_luma + epsilon);
+
+  /* Hyperbolic gamut compression: small chroma values are preserved, large
+   * ones compressed */
+  const float pixel_chroma_adjustment = 1.0f / (chroma_vs_mapping_border * display_border_vs_chroma + epsilon);
+  const float hyperbolic_chroma = 2.0f * chroma_vs_mapping_border
+                                  / (1.0f - chroma_vs_mapping_border * chroma_vs_mapping_border + epsilon)
+                                  * pixel_chroma_adjustment;
+  const float hyperbolic_z = sqrtf(hyperbolic_chroma * hyperbolic_chroma + 1.0f);
+  const float chroma_factor = hyperbolic_chroma / (1.0f + hyperbolic_z) * display_border_vs_chroma;
+
+  for_each_channel(c, aligned(pre_out, pix_out))
+    pix_out[c] = mapped_luma + chroma_factor * (pre_out[c] - mapped_luma);
+}
+
+/** Per channel: curve on inset/rotated primaries, then hue correction. */
+static inline void _sigmoid_per_channel_pixel(const dt_iop_sigmoid_data_t *const d,
+                                              const dt_aligned_pixel_t pix_in,
+                                              dt_aligned_pixel_t pix_out)
+{
+  dt_aligned_pixel_t pix_in_base, pix_in_strict_positive, rendering_RGB;
+  dt_aligned_pixel_t per_channel = { 0.f };
+
+  dt_apply_transposed_color_matrix(pix_in, d->pipe_to_base, pix_in_base);
+  _desaturate_negative_values(pix_in_base, pix_in_strict_positive);
+  dt_apply_transposed_color_matrix(pix_in_strict_positive, d->base_to_rendering, rendering_RGB);
+
+  dt_curve_lut_eval_rgb(&d->curve, rendering_RGB, per_channel);
+
+  dt_iop_sigmoid_value_order_t order;
+  dt_aligned_pixel_t per_channel_hue_corrected = { 0.f };
+  _pixel_channel_order(rendering_RGB, &order);
+  _preserve_hue_and_energy(rendering_RGB, per_channel, per_channel_hue_corrected, order,
+                           d->hue_preservation);
+  dt_apply_transposed_color_matrix(per_channel_hue_corrected, d->rendering_to_pipe, pix_out);
+}
+
+/* ── process ────────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self,
+                    dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid,
+                    void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4, self, piece->colors, ivoid, ovoid, roi_in, roi_out))
+    return;
+
+  const dt_iop_sigmoid_data_t *const d = piece->data;
+  const float *const in = (const float *)ivoid;
+  float *const out = (float *)ovoid;
+  const size_t npixels = (size_t)roi_in->width * roi_in->height;
+
+  if(d->color_processing == DT_SIGMOID_METHOD_PER_CHANNEL)
+  {
+    DT_OMP_FOR()
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      dt_aligned_pixel_t pix_out;
+      _sigmoid_per_channel_pixel(d, in + k, pix_out);
+      pix_out[3] = in[k + 3];
+      copy_pixel(out + k, pix_out);
+    }
+  }
+  else /* DT_SIGMOID_METHOD_RGB_RATIO */
+  {
+    DT_OMP_FOR()
+    for(size_t k = 0; k < 4 * npixels; k += 4)
+    {
+      dt_aligned_pixel_t pix_out;
+      _sigmoid_rgb_ratio_pixel(d, in + k, pix_out);
+      pix_out[3] = in[k + 3];
+      copy_pixel(out + k, pix_out);
+    }
+  }
+}
+
+/* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_sigmoid_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_sigmoid_params_t *d = self->default_params;
+  if(!d) return;
+
+  memset(d, 0, sizeof(*d));
+  d->middle_grey_contrast = 1.5f;
+  d->contrast_skewness    = 0.0f;
+  d->display_white_target = 100.0f;
+  d->display_black_target = 0.0152f;
+  d->color_processing     = DT_SIGMOID_METHOD_PER_CHANNEL;
+  d->hue_preservation     = 100.0f;
+  d->base_primaries       = DT_SIGMOID_WORK_PROFILE;
+
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_sigmoid_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+}
@@ -278,6 +278,23 @@ static void commit_params(dt_iop_module_t *self,
   }
 }
 
+/* ── Raw stage fusion ───────────────────────────────────────────────────── */
+
+/* On a mosaic this module is one gain per CFA colour (see
+   _plan_raw_fusion() in pipe/pixelpipe.c). */
+static bool raw_gains(dt_iop_module_t *self,
+                      dt_dev_pixelpipe_iop_t *piece,
+                      float gains[4])
+{
+  (void)self;
+  const dt_iop_temperature_data_t *d = (const dt_iop_temperature_data_t *)piece->data;
+  if(!d || !piece->pipe->image.buf_dsc.filters)
+    return false;
+  for(int k = 0; k < 4; k++)
+    gains[k] = d->coeffs[k];
+  return true;
+}
+
 /* ── init_pipe / cleanup_pipe ───────────────────────────────────────────── */
 
 static void init_pipe(dt_iop_module_t *self,
@@ -388,6 +405,7 @@ void dt_iop_temperature_init_global(dt_iop_module_so_t *so)
   so->commit_params    = commit_params;
   so->input_colorspace = input_colorspace;
   so->output_colorspace= output_colorspace;
+  so->raw_gains        = raw_gains;
   /* modify_roi_in / modify_roi_out: not needed — temperature is 1:1 pixel   */
   /* output_format: not needed — temperature does not change buffer format    */
 }
@@ -0,0 +1,709 @@
+/*
+ * toneequal.c - darktable tone equalizer IOP, ported for libdtpipe
+ *
+ * Extracted from darktable src/iop/toneequal.c
+ * Copyright (C) 2018-2024 darktable developers.
+ * GUI code, OpenCL paths, presets, mask display, histogram and
+ * legacy_params removed.
+ * Adapted to compile against dtpipe_internal.h.
+ *
+ * Adapted for libdtpipe:
+ *   - the luminance mask is never built at full resolution: the guided
+ *     filter (common/fast_guided_filter.h) pulls luminance rows straight
+ *     from the input, analyses them at low resolution and keeps only its
+ *     blending coefficients.  process() then runs one fused pass per row:
+ *     luminance estimate, upsample + blend of the coefficients, gain
+ *     lookup, multiply.
+ *   - the coefficients are cached in the piece data, keyed by the upstream
+ *     pipe hash (dt_dev_pixelpipe_piece_hash()) and the mask parameters
+ *     only.  Moving the tone curve sliders leaves the key unchanged, so
+ *     those runs skip the filter entirely.  darktable keys its GUI mask
+ *     cache with the module's own params included, and computes the mask
+ *     from scratch on export.
+ *   - the correction LUT is indexed by the bits of the clamped luminance
+ *     instead of log2f(): 256 linearly interpolated entries per EV
+ *     (8 KB) instead of 80001 nearest-neighbour ones.  The gain lookup
+ *     has no transcendental call and vectorizes.
+ *   - the mask radius is sized against the full image with
+ *     roi_in->scale / iscale, as in bilat.c; there is no modify_roi_in.
+ *
+ * Struct layout MUST match _toneequal_params_t in src/pipe/params.c.
+ * All internal functions are static (Phase 8 convention for single dylib).
+ *
+ * Operates in IOP_CS_RGB.
+ */
+
+#include "dtpipe_internal.h"
+#include "common/fast_guided_filter.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONTRAST_FULCRUM exp2f(-4.0f)
+#define MIN_FLOAT exp2f(-16.0f)
+
+/**
+ * Build the exposures octaves :
+ * band-pass filters with gaussian windows spaced by 1 EV
+**/
+
+#define CHANNELS 9
+#define PIXEL_CHAN 8
+
+#define DT_TONEEQ_MIN_EV (-8.0f)
+#define DT_TONEEQ_MAX_EV (0.0f)
+
+/* Correction LUT.  Luminances in [2^-8, 1] are positive normal floats, so
+ * their bit patterns are monotonic: the top LUT_MANTISSA_BITS of the
+ * mantissa and the exponent index the LUT, the remaining mantissa bits
+ * interpolate between two entries. */
+#define LUT_OCTAVES 8 // DT_TONEEQ_MAX_EV - DT_TONEEQ_MIN_EV
+#define LUT_MANTISSA_BITS 8
+#define LUT_STEPS (1 << LUT_MANTISSA_BITS)
+#define LUT_SHIFT (23 - LUT_MANTISSA_BITS)
+#define LUT_FRAC_MASK ((1u << LUT_SHIFT) - 1u)
+#define LUT_BITS_MIN 0x3B800000u // bits of 2^-8
+#define LUT_SIZE (LUT_OCTAVES * LUT_STEPS + 2) // + 1 for 0 EV, + 1 guard
+
+// radial distances used for pixel ops
+static const float centers_ops[PIXEL_CHAN] DT_ALIGNED_ARRAY =
+  {-56.0f / 7.0f, // = -8.0f
+   -48.0f / 7.0f,
+   -40.0f / 7.0f,
+   -32.0f / 7.0f,
+   -24.0f / 7.0f,
+   -16.0f / 7.0f,
+   -8.0f / 7.0f,
+   0.0f / 7.0f}; // split 8 EV into 7 evenly-spaced channels
+
+static const float centers_params[CHANNELS] DT_ALIGNED_ARRAY =
+  { -8.0f, -7.0f, -6.0f, -5.0f,
+    -4.0f, -3.0f, -2.0f, -1.0f, 0.0f};
+
+/* ── Parameter structs (must match params.c descriptor layout) ───────────── */
+
+typedef enum dt_iop_toneequalizer_filter_t
+{
+  DT_TONEEQ_NONE = 0,   // $DESCRIPTION: "no"
+  DT_TONEEQ_AVG_GUIDED, // $DESCRIPTION: "averaged guided filter"
+  DT_TONEEQ_GUIDED,     // $DESCRIPTION: "guided filter"
+  DT_TONEEQ_AVG_EIGF,   // $DESCRIPTION: "averaged EIGF"
+  DT_TONEEQ_EIGF        // $DESCRIPTION: "EIGF"
+} dt_iop_toneequalizer_filter_t;
+
+typedef enum dt_iop_luminance_mask_method_t
+{
+  DT_TONEEQ_MEAN = 0,   // $DESCRIPTION: "RGB average"
+  DT_TONEEQ_LIGHTNESS,  // $DESCRIPTION: "HSL lightness"
+  DT_TONEEQ_VALUE,      // $DESCRIPTION: "HSV value / RGB max"
+  DT_TONEEQ_NORM_1,     // $DESCRIPTION: "RGB sum"
+  DT_TONEEQ_NORM_2,     // $DESCRIPTION: "RGB euclidean norm")
+  DT_TONEEQ_NORM_POWER, // $DESCRIPTION: "RGB power norm"
+  DT_TONEEQ_GEOMEAN,    // $DESCRIPTION: "RGB geometric mean"
+  DT_TONEEQ_LAST
+} dt_iop_luminance_mask_method_t;
+
+typedef struct dt_iop_toneequalizer_params_t
+{
+  float noise; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "blacks"
+  float ultra_deep_blacks; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "deep shadows"
+  float deep_blacks; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "shadows"
+  float blacks; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "light shadows"
+  float shadows; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "mid-tones"
+  float midtones; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "dark highlights"
+  float highlights; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "highlights"
+  float whites; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "whites"
+  float speculars; // $MIN: -2.0 $MAX: 2.0 $DEFAULT: 0.0  $DESCRIPTION: "speculars"
+  float blending; // $MIN: 0.01 $MAX: 100.0 $DEFAULT: 5.0 $DESCRIPTION: "smoothing diameter"
+  float smoothing; // $DEFAULT: 1.414213562 sqrtf(2.0f)
+  float feathering; // $MIN: 0.01 $MAX: 10000.0 $DEFAULT: 1.0 $DESCRIPTION: "edges refinement/feathering"
+  float quantization; // $MIN: 0.0 $MAX: 2.0 $DEFAULT: 0.0 $DESCRIPTION: "mask quantization"
+  float contrast_boost; // $MIN: -16.0 $MAX: 16.0 $DEFAULT: 0.0 $DESCRIPTION: "mask contrast compensation"
+  float exposure_boost; // $MIN: -16.0 $MAX: 16.0 $DEFAULT: 0.0 $DESCRIPTION: "mask exposure compensation"
+  dt_iop_toneequalizer_filter_t details; // $DEFAULT: DT_TONEEQ_EIGF $DESCRIPTION: "preserve details"
+  dt_iop_luminance_mask_method_t method; // $DEFAULT: DT_TONEEQ_NORM_2 $DESCRIPTION: "luminance estimator"
+  int iterations; // $MIN: 1 $MAX: 20 $DEFAULT: 1 $DESCRIPTION: "filter diffusion"
+} dt_iop_toneequalizer_params_t;
+
+typedef struct dt_iop_toneequalizer_data_t
+{
+  float factors[PIXEL_CHAN] DT_ALIGNED_ARRAY;
+  float correction_lut[LUT_SIZE] DT_ALIGNED_ARRAY;
+  float blending, feathering, contrast_boost, exposure_boost, quantization, smoothing;
+  int iterations;
+  dt_iop_luminance_mask_method_t method;
+  dt_iop_toneequalizer_filter_t details;
+
+  /* mask cache: survives commit_params, invalidated by hash */
+  dt_guided_filter_t *mask;
+  dt_hash_t mask_hash;
+} dt_iop_toneequalizer_data_t;
+
+/* ── Gaussian radial basis ───────────────────────────────────────────────── */
+
+static float gaussian_denom(const float sigma)
+{
+  // Gaussian function denominator such that y = exp(- radius^2 / denominator)
+  // this is the constant factor of the exponential, so we don't need to recompute it
+  // for every single pixel
+  return 2.0f * sigma * sigma;
+}
+
+DT_OMP_DECLARE_SIMD()
+static float gaussian_func(const float radius, const float denominator)
+{
+  // Gaussian function without normalization
+  // this is the variable part of the exponential
+  // the denominator should be evaluated with `gaussian_denom`
+  // ahead of the array loop for optimal performance
+  return expf(- radius * radius / denominator);
+}
+
+static inline float pixel_correction(const float exposure,
+                                     const float *const restrict factors,
+                                     const float sigma)
+{
+  // build the correction for the current pixel
+  // as the sum of the contribution of each luminance channel
+  float result = 0.0f;
+  const float gauss_denom = gaussian_denom(sigma);
+  const float expo = CLAMPF(exposure, DT_TONEEQ_MIN_EV, DT_TONEEQ_MAX_EV);
+
+  for(int i = 0; i < PIXEL_CHAN; ++i)
+    result += gaussian_func(expo - centers_ops[i], gauss_denom) * factors[i];
+
+  // the user-set correction is expected in [-2;+2] EV, so is the interpolated one
+  return CLAMPF(result, 0.25f, 4.0f);
+}
+
+/* ── Least-squares fit of the user curve ─────────────────────────────────── */
+/*
+ * The 9 user gains are approximated by 8 gaussians (darktable's
+ * pseudo_solve() from src/iop/choleski.h, fast path): solve A'A x = A'y by
+ * Choleski decomposition.  A is built here, so it is known to be
+ * symmetrical definite positive and the checks are skipped.
+ */
+
+static gboolean _choleski_decompose(const float *const restrict A,
+                                    float *const restrict L,
+                                    const size_t n)
+{
+  // A is input n×n matrix, decompose it into L such that A = L × L'
+  if(A[0] <= 0.0f) return FALSE; // failure : non positive definite matrice
+
+  for(size_t i = 0; i < n; i++)
+    for(size_t j = 0; j < (i + 1); j++)
+    {
+      float sum = 0.0f;
+
+      for(size_t k = 0; k < j; k++)
+        sum += L[i * n + k] * L[j * n + k];
+
+      L[i * n + j] = (i == j) ?
+                        sqrtf(A[i * n + i] - sum) :
+                        (A[i * n + j] - sum) / L[j * n + j];
+    }
+
+  return TRUE;
+}
+
+static gboolean _pseudo_solve(const float *const restrict A, // m × n
+                              float *const restrict y,       // m in, n out
+                              const size_t m,
+                              const size_t n)
+{
+  float A_square[PIXEL_CHAN * PIXEL_CHAN] DT_ALIGNED_ARRAY = { 0.0f };
+  float L[PIXEL_CHAN * PIXEL_CHAN] DT_ALIGNED_ARRAY = { 0.0f };
+  float y_square[PIXEL_CHAN] DT_ALIGNED_ARRAY;
+  float b[PIXEL_CHAN] DT_ALIGNED_ARRAY;
+
+  // A' A, lower triangle only, and A' y
+  for(size_t i = 0; i < n; ++i)
+  {
+    for(size_t j = 0; j < (i + 1); ++j)
+    {
+      float sum = 0.0f;
+      for(size_t k = 0; k < m; ++k)
+        sum += A[k * n + i] * A[k * n + j];
+      A_square[i * n + j] = sum;
+    }
+    float sum = 0.0f;
+    for(size_t k = 0; k < m; ++k)
+      sum += A[k * n + i] * y[k];
+    y_square[i] = sum;
+  }
+
+  if(!_choleski_decompose(A_square, L, n)) return FALSE;
+
+  // solve L × b = A'y from top to bottom
+  for(size_t i = 0; i < n; ++i)
+  {
+    float sum = y_square[i];
+    for(size_t j = 0; j < i; ++j)
+      sum -= L[i * n + j] * b[j];
+    b[i] = sum / L[i * n + i];
+  }
+
+  // solve L' × x = b from bottom to top
+  for(int i = (int)n - 1; i > -1; --i)
+  {
+    float sum = b[i];
+    for(int j = (int)n - 1; j > i; --j)
+      sum -= L[j * n + i] * y[j];
+    y[i] = sum / L[i * n + i];
+  }
+
+  return TRUE;
+}
+
+/* ── Correction LUT ──────────────────────────────────────────────────────── */
+
+static void compute_correction_lut(float *const restrict lut,
+                                   const float sigma,
+                                   const float *const restrict factors)
+{
+  DT_OMP_FOR()
+  for(int j = 0; j < LUT_SIZE - 1; j++)
+  {
+    // entry j sits at the luminance whose float bits are
+    // LUT_BITS_MIN + (j << LUT_SHIFT)
+    const float exposure = DT_TONEEQ_MIN_EV + (float)(j / LUT_STEPS)
+                           + log2f(1.0f + (float)(j % LUT_STEPS) / (float)LUT_STEPS);
+    lut[j] = pixel_correction(exposure, factors, sigma);
+  }
+  // 0 EV interpolates towards the guard entry with a weight of 0
+  lut[LUT_SIZE - 1] = lut[LUT_SIZE - 2];
+}
+
+// gain[k] = correction for luminance[k], in place
+static inline void _lut_correction_row(float *const restrict row,
+                                       const size_t width,
+                                       const float *const restrict lut)
+{
+  const float lum_min = exp2f(DT_TONEEQ_MIN_EV);
+  const float lum_max = exp2f(DT_TONEEQ_MAX_EV);
+
+  DT_OMP_SIMD(aligned(lut:64))
+  for(size_t k = 0; k < width; k++)
+  {
+    // The radial-basis interpolation is valid in [-8; 0] EV and can quickly diverge outside.
+    const float lum = CLAMPF(row[k], lum_min, lum_max);
+    uint32_t bits;
+    memcpy(&bits, &lum, sizeof(bits));
+    const uint32_t offset = bits - LUT_BITS_MIN;
+    const uint32_t i = offset >> LUT_SHIFT;
+    const float t = (float)(offset & LUT_FRAC_MASK) * (1.0f / (float)(LUT_FRAC_MASK + 1u));
+    row[k] = lut[i] + t * (lut[i + 1] - lut[i]);
+  }
+}
+
+/* ── Luminance estimators ────────────────────────────────────────────────── */
+/*
+ * darktable's luminance_mask() (src/common/luminance_mask.h), one row at a
+ * time so the guided filter can pull rows without a full-size mask.
+ */
+
+DT_OMP_DECLARE_SIMD()
+static inline float linear_contrast(const float pixel, const float fulcrum, const float contrast)
+{
+  // Increase the slope of the value around a fulcrum value
+  return MAX((pixel - fulcrum) * contrast + fulcrum, MIN_FLOAT);
+}
+
+typedef struct _luminance_source_t
+{
+  const float *in;
+  int width;
+  dt_iop_luminance_mask_method_t method;
+  float exposure_boost, fulcrum, contrast_boost;
+} _luminance_source_t;
+
+static void _luminance_row(const void *data, const int row, float *const restrict out)
+{
+  const _luminance_source_t *const s = data;
+  const size_t width = s->width;
+  const float *const restrict in = s->in + (size_t)4 * width * row;
+  const float eb = s->exposure_boost;
+  const float fulcrum = s->fulcrum;
+  const float contrast = s->contrast_boost;
+
+  switch(s->method)
+  {
+    case DT_TONEEQ_MEAN:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+        out[k] = linear_contrast(eb * (in[4*k] + in[4*k+1] + in[4*k+2]) / 3.0f, fulcrum, contrast);
+      break;
+
+    case DT_TONEEQ_LIGHTNESS:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+      {
+        // (max(RGB) + min(RGB)) / 2 is equivalent to HSL lightness
+        const float max_rgb = MAX(MAX(in[4*k], in[4*k+1]), in[4*k+2]);
+        const float min_rgb = MIN(MIN(in[4*k], in[4*k+1]), in[4*k+2]);
+        out[k] = linear_contrast(eb * (max_rgb + min_rgb) / 2.0f, fulcrum, contrast);
+      }
+      break;
+
+    case DT_TONEEQ_VALUE:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+        // max(RGB) is equivalent to HSV value
+        out[k] = linear_contrast(eb * MAX(MAX(in[4*k], in[4*k+1]), in[4*k+2]), fulcrum, contrast);
+      break;
+
+    case DT_TONEEQ_NORM_1:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+        out[k] = linear_contrast(eb * (fabsf(in[4*k]) + fabsf(in[4*k+1]) + fabsf(in[4*k+2])),
+                                 fulcrum, contrast);
+      break;
+
+    case DT_TONEEQ_NORM_POWER:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+      {
+        // weird norm sort of perceptual. This is black magic really, but it looks good.
+        float numerator = 0.0f;
+        float denominator = 0.0f;
+        for(int c = 0; c < 3; c++)
+        {
+          const float value = fabsf(in[4*k+c]);
+          const float RGB_square = value * value;
+          numerator += RGB_square * value;
+          denominator += RGB_square;
+        }
+        out[k] = linear_contrast(eb * numerator / denominator, fulcrum, contrast);
+      }
+      break;
+
+    case DT_TONEEQ_GEOMEAN:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+      {
+        // geometric_mean(RGB). Kind of interesting for saturated colours (maybe).
+        const float product = fabsf(in[4*k]) * fabsf(in[4*k+1]) * fabsf(in[4*k+2]);
+        out[k] = linear_contrast(eb * powf(product, 1.0f / 3.0f), fulcrum, contrast);
+      }
+      break;
+
+    case DT_TONEEQ_NORM_2:
+    default:
+      DT_OMP_SIMD()
+      for(size_t k = 0; k < width; k++)
+      {
+        // vector norm L2 : euclidean norm
+        const float result = in[4*k] * in[4*k] + in[4*k+1] * in[4*k+1] + in[4*k+2] * in[4*k+2];
+        out[k] = linear_contrast(eb * sqrtf(result), fulcrum, contrast);
+      }
+      break;
+  }
+}
+
+/* ── Luminance mask ──────────────────────────────────────────────────────── */
+
+static void _luminance_source(const dt_iop_toneequalizer_data_t *const d,
+                              const float *const in,
+                              const int width,
+                              _luminance_source_t *s)
+{
+  s->in = in;
+  s->width = width;
+  s->method = d->method;
+  s->exposure_boost = d->exposure_boost;
+  // Contrast boosting is done around the average luminance of the mask.
+  // This is to make exposure corrections easier to control for users, by spreading
+  // the dynamic range along all exposure channels, because guided filters
+  // tend to flatten the luminance mask a lot around an average ± 2 EV
+  // which makes only 2-3 channels usable.
+  // we assume the distribution is centered around -4EV, e.g. the center of the nodes
+  // the exposure boost should be used to make this assumption true
+  const gboolean boost = d->details == DT_TONEEQ_GUIDED || d->details == DT_TONEEQ_EIGF;
+  s->fulcrum = boost ? CONTRAST_FULCRUM : 0.0f;
+  s->contrast_boost = boost ? d->contrast_boost : 1.0f;
+}
+
+// window radius of the box average (guided filter) or sigma (EIGF), in roi
+// pixels.  blending is a fraction of the largest dimension of the full image.
+static float _mask_radius(const dt_iop_toneequalizer_data_t *const d,
+                          const dt_dev_pixelpipe_iop_t *const piece,
+                          const dt_iop_roi_t *const roi_in)
+{
+  const float scale = roi_in->scale / piece->iscale;
+  // the piece's full input, in full-image pixels.  Pipes that never ran
+  // dt_dev_pixelpipe_get_dimensions() fall back to the roi itself.
+  const int max_size = piece->buf_in.width > 0
+    ? (int)(MAX(piece->buf_in.width, piece->buf_in.height) * piece->iscale)
+    : (int)(MAX(roi_in->width, roi_in->height) / fminf(scale, 1.0f));
+  const float diameter = d->blending * max_size * scale;
+  return (float)(int)((diameter - 1.0f) / 2.0f);
+}
+
+static dt_hash_t _mask_hash(const dt_iop_toneequalizer_data_t *const d,
+                            const dt_dev_pixelpipe_iop_t *const piece,
+                            const dt_iop_roi_t *const roi_in,
+                            const float radius)
+{
+  // everything upstream of this piece, but not its own params: the tone
+  // curve does not change the mask
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, roi_in, FALSE);
+  hash = dt_hash(hash, &d->method, sizeof(d->method));
+  hash = dt_hash(hash, &d->details, sizeof(d->details));
+  hash = dt_hash(hash, &d->exposure_boost, sizeof(d->exposure_boost));
+  hash = dt_hash(hash, &d->contrast_boost, sizeof(d->contrast_boost));
+  hash = dt_hash(hash, &d->feathering, sizeof(d->feathering));
+  hash = dt_hash(hash, &d->quantization, sizeof(d->quantization));
+  hash = dt_hash(hash, &d->iterations, sizeof(d->iterations));
+  return dt_hash(hash, &radius, sizeof(radius));
+}
+
+// builds (or reuses) the low-resolution guided filter state for this roi
+static gboolean _update_mask(dt_iop_toneequalizer_data_t *const d,
+                             const dt_dev_pixelpipe_iop_t *const piece,
+                             const _luminance_source_t *const s,
+                             const dt_iop_roi_t *const roi_in)
+{
+  const float radius = _mask_radius(d, piece, roi_in);
+  const dt_hash_t hash = _mask_hash(d, piece, roi_in, radius);
+  if(d->mask && d->mask_hash == hash) return TRUE;
+
+  dt_guided_filter_free(d->mask);
+  d->mask = NULL;
+  d->mask_hash = DT_INVALID_HASH;
+
+  const gboolean eigf = d->details == DT_TONEEQ_AVG_EIGF || d->details == DT_TONEEQ_EIGF;
+  const gboolean avg = d->details == DT_TONEEQ_AVG_EIGF || d->details == DT_TONEEQ_AVG_GUIDED;
+  dt_guided_filter_t *g = dt_guided_filter_init(roi_in->width, roi_in->height,
+                                                eigf ? DT_GF_EIGF : DT_GF_GUIDED,
+                                                radius, d->feathering, d->iterations,
+                                                avg ? DT_GF_BLENDING_GEOMEAN : DT_GF_BLENDING_LINEAR,
+                                                d->quantization, exp2f(-14.0f), 4.0f);
+  if(!g || !dt_guided_filter_analyse(g, _luminance_row, s))
+  {
+    dt_guided_filter_free(g);
+    return FALSE;
+  }
+
+  d->mask = g;
+  d->mask_hash = hash;
+  return TRUE;
+}
+
+/* ── process() ───────────────────────────────────────────────────────────── */
+
+static void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                    const void *const ivoid, void *const ovoid,
+                    const dt_iop_roi_t *const roi_in,
+                    const dt_iop_roi_t *const roi_out)
+{
+  if(!dt_iop_have_required_input_format(4 /*full-color pixels*/, self,
+                                         piece->colors, ivoid, ovoid,
+                                         roi_in, roi_out))
+    return;
+
+  dt_iop_toneequalizer_data_t *const d = piece->data;
+  const float *const restrict in = (const float *)ivoid;
+  float *const restrict out = (float *)ovoid;
+  const size_t width = roi_in->width;
+  const size_t height = roi_in->height;
+
+  _luminance_source_t s;
+  _luminance_source(d, in, roi_in->width, &s);
+
+  const gboolean filtered = d->details != DT_TONEEQ_NONE;
+  if(filtered && !_update_mask(d, piece, &s, roi_in))
+  {
+    fprintf(stderr, "[toneequal] failed to allocate memory for the luminance mask\n");
+    dt_iop_image_copy_by_size(out, in, roi_out->width, roi_out->height, 4);
+    return;
+  }
+
+  const dt_guided_filter_t *const mask = filtered ? d->mask : NULL;
+  size_t padded_size;
+  float *const restrict rows
+      = dt_alloc_perthread_float(width + (mask ? dt_guided_filter_scratch_size(mask) : 0), &padded_size);
+  if(!rows)
+  {
+    fprintf(stderr, "[toneequal] failed to allocate memory\n");
+    dt_iop_image_copy_by_size(out, in, roi_out->width, roi_out->height, 4);
+    return;
+  }
+
+  const float *const restrict lut = d->correction_lut;
+
+  // luminance, mask, gain and multiply fused per row
+  DT_OMP_FOR()
+  for(size_t i = 0; i < height; i++)
+  {
+    float *const restrict gain = dt_get_perthread(rows, padded_size);
+    _luminance_row(&s, i, gain);
+    if(mask) dt_guided_filter_blend_row(mask, i, gain, gain + width);
+    _lut_correction_row(gain, width, lut);
+
+    const float *const restrict row_in = in + 4 * width * i;
+    float *const restrict row_out = out + 4 * width * i;
+    for(size_t k = 0; k < width; k++)
+      for_each_channel(c)
+        row_out[4 * k + c] = gain[k] * row_in[4 * k + c];
+  }
+
+  dt_free_align(rows);
+}
+
+/* ── tiling_callback() ───────────────────────────────────────────────────── */
+
+static void tiling_callback(dt_iop_module_t *self,
+                            dt_dev_pixelpipe_iop_t *piece,
+                            const dt_iop_roi_t *roi_in,
+                            const dt_iop_roi_t *roi_out,
+                            dt_develop_tiling_t *tiling)
+{
+  const dt_iop_toneequalizer_data_t *d = piece->data;
+
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  const size_t basebuffer = sizeof(float) * piece->colors * width * height;
+
+  tiling->factor = 2.0f; // input + output
+  tiling->maxbuf = 1.0f;
+  tiling->overhead = 0;
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+
+  if(d->details != DT_TONEEQ_NONE)
+  {
+    const gboolean eigf = d->details == DT_TONEEQ_AVG_EIGF || d->details == DT_TONEEQ_EIGF;
+    const float radius = _mask_radius(d, piece, roi_in);
+    tiling->factor += (float)dt_guided_filter_memory_use(width, height,
+                                                         eigf ? DT_GF_EIGF : DT_GF_GUIDED,
+                                                         radius) / basebuffer;
+    // box windows averaged twice, or a gaussian of sigma = radius
+    tiling->overlap = eigf ? ceilf(3.0f * radius) : 2 * MAX(radius, 0.0f);
+  }
+}
+
+/* ── commit_params() ─────────────────────────────────────────────────────── */
+
+static void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1,
+                          dt_dev_pixelpipe_t *pipe,
+                          dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_toneequalizer_params_t *p = (const dt_iop_toneequalizer_params_t *)p1;
+  dt_iop_toneequalizer_data_t *d = piece->data;
+
+  // Trivial params passing
+  d->method = p->method;
+  d->details = p->details;
+  d->iterations = p->iterations;
+  d->smoothing = p->smoothing;
+  d->quantization = p->quantization;
+
+  // UI blending param is set in % of the largest image dimension
+  d->blending = p->blending / 100.0f;
+
+  // UI guided filter feathering param increases the edges taping
+  // but the actual regularization params applied in guided filter behaves the other way
+  d->feathering = 1.f / (p->feathering);
+
+  // UI params are in log2 offsets (EV) : convert to linear factors
+  d->contrast_boost = exp2f(p->contrast_boost);
+  d->exposure_boost = exp2f(p->exposure_boost);
+
+  /*
+   * Perform a radial-based interpolation using a series gaussian functions
+   */
+  const float user_gains[CHANNELS] = { p->noise, p->ultra_deep_blacks, p->deep_blacks,
+                                       p->blacks, p->shadows, p->midtones,
+                                       p->highlights, p->whites, p->speculars };
+  float factors[CHANNELS] DT_ALIGNED_ARRAY;
+  for(int c = 0; c < CHANNELS; ++c)
+    factors[c] = exp2f(user_gains[c]);
+
+  // Build the symmetrical definite positive part of the augmented matrix
+  // of the radial-basis interpolation weights
+  float A[CHANNELS * PIXEL_CHAN] DT_ALIGNED_ARRAY;
+  const float gauss_denom = gaussian_denom(p->smoothing);
+  for(int i = 0; i < CHANNELS; ++i)
+    for(int j = 0; j < PIXEL_CHAN; ++j)
+      A[i * PIXEL_CHAN + j] = gaussian_func(centers_params[i] - centers_ops[j], gauss_denom);
+
+  if(!_pseudo_solve(A, factors, CHANNELS, PIXEL_CHAN))
+    fprintf(stderr, "[toneequal] the curve fit failed\n");
+
+  memcpy(d->factors, factors, sizeof(d->factors));
+
+  // compute the correction LUT here to spare some time in process
+  // when computing several times toneequalizer with same parameters
+  compute_correction_lut(d->correction_lut, d->smoothing, d->factors);
+}
+
+/* ── init_pipe() / cleanup_pipe() ────────────────────────────────────────── */
+
+static void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                      dt_dev_pixelpipe_iop_t *piece)
+{
+  piece->data = dt_calloc1_align_type(dt_iop_toneequalizer_data_t);
+}
+
+static void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe,
+                         dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_toneequalizer_data_t *d = piece->data;
+  if(d) dt_guided_filter_free(d->mask);
+  dt_free_align(piece->data);
+  piece->data = NULL;
+}
+
+/* ── init() — default params ─────────────────────────────────────────────── */
+
+static void init(dt_iop_module_t *self)
+{
+  dt_iop_toneequalizer_params_t *d = self->default_params;
+  if(!d) return;
+  memset(d, 0, sizeof(*d));
+  d->blending       = 5.0f;
+  d->smoothing      = sqrtf(2.0f);
+  d->feathering     = 1.0f;
+  d->quantization   = 0.0f;
+  d->contrast_boost = 0.0f;
+  d->exposure_boost = 0.0f;
+  d->details        = DT_TONEEQ_EIGF;
+  d->method         = DT_TONEEQ_NORM_2;
+  d->iterations     = 1;
+  memcpy(self->params, d, sizeof(*d));
+}
+
+/* ── colorspace declarations ─────────────────────────────────────────────── */
+
+static dt_iop_colorspace_type_t input_colorspace(dt_iop_module_t *self,
+                                                 dt_dev_pixelpipe_t *pipe,
+                                                 dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+static dt_iop_colorspace_type_t output_colorspace(dt_iop_module_t *self,
+                                                  dt_dev_pixelpipe_t *pipe,
+                                                  dt_dev_pixelpipe_iop_t *piece)
+{
+  return IOP_CS_RGB;
+}
+
+/* ── Public init_global entry point ──────────────────────────────────────── */
+
+void dt_iop_toneequal_init_global(dt_iop_module_so_t *so)
+{
+  so->process_plain      = process;
+  so->init               = init;
+  so->init_pipe          = init_pipe;
+  so->cleanup_pipe       = cleanup_pipe;
+  so->commit_params      = commit_params;
+  so->input_colorspace   = input_colorspace;
+  so->output_colorspace  = output_colorspace;
+  so->tiling_callback    = tiling_callback;
+}
@@ -161,6 +161,18 @@ static _module_node_t *_build_module_list(dt_develop_t *dev)
     m->output_format     = so->output_format;
     m->modify_roi_in     = so->modify_roi_in;
     m->modify_roi_out    = so->modify_roi_out;
+    m->tiling_callback   = so->tiling_callback;
+
+    /* Mirror the matrix-fusion query from the so */
+    m->color_matrix      = so->color_matrix;
+
+    /* Mirror the geometric point maps used for warp fusion */
+    m->distort_transform     = so->distort_transform;
+    m->distort_backtransform = so->distort_backtransform;
+
+    /* Mirror the raw stage fusion queries */
+    m->raw_gains         = so->raw_gains;
+    m->raw_prefilter     = so->raw_prefilter;
 
     /* Default enabled state */
     m->default_enabled = _is_default_enabled(op);
@@ -2,7 +2,8 @@
  * params.c - Parameter get/set implementation for libdtpipe
  *
  * Implements the public dtpipe_set_param_float(), dtpipe_set_param_int(),
- * dtpipe_get_param_float(), and dtpipe_enable_module() API functions.
+ * dtpipe_set_param_string(), dtpipe_get_param_float(), and
+ * dtpipe_enable_module() API functions.
  *
  * Architecture (Option B: hand-written descriptors)
  * ──────────────────────────────────────────────────
@@ -15,7 +16,9 @@
  *
  * Currently covered modules (Tier 1 + key Tier 2):
  *   exposure, temperature, rawprepare, demosaic,
- *   colorin, colorout, highlights, sharpen
+ *   colorin, colorout, highlights, sharpen, lens,
+ *   sigmoid, filmicrgb, agx, channelmixerrgb, lut3d, denoiseprofile,
+ *   bilat, toneequal, ashift, flip, crop, cacorrect, hotpixels
  *
  * To add a new module:
  *   1. Define a static dt_param_desc_t _params_<op>[] array below.
@@ -57,6 +60,8 @@
   { #field, offsetof(st, field), DT_PARAM_UINT32,sizeof(uint32_t),(lo), (hi) }
 #define PARAM_B(st, field) \
   { #field, offsetof(st, field), DT_PARAM_BOOL,  sizeof(int32_t),  0.0f, 1.0f }
+#define PARAM_S(st, field) \
+  { #field, offsetof(st, field), DT_PARAM_STRING, sizeof(((st *)0)->field), 0.0f, 0.0f }
 
 /* ═══════════════════════════════════════════════════════════════════════════
  * Module: exposure  (version 7)
@@ -260,6 +265,597 @@ static const dt_param_desc_t _params_sharpen[] = {
   PARAM_F(_sharpen_params_t, threshold,  0.0f, 100.0f),
 };
 
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: lens  (version 10)
+ * darktable src/iop/lens.cc  dt_iop_lens_params_t
+ * camera / lens are fixed-size char arrays (128 bytes each).  The Lensfun
+ * fields are kept for layout only; libdtpipe applies embedded metadata.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _lens_params_t {
+  int32_t method;        /* 0 embedded metadata, 1 lensfun, 2 vignette only */
+  int32_t modify_flags;  /* TCA | VIGNETTING | DISTORTION                   */
+  int32_t inverse;
+  float   scale;
+  float   crop;
+  float   focal;
+  float   aperture;
+  float   distance;
+  int32_t target_geom;
+  char    camera[128];
+  char    lens[128];
+  int32_t tca_override;
+  float   tca_r;
+  float   tca_b;
+  float   cor_dist_ft;
+  float   cor_vig_ft;
+  float   cor_ca_r_ft;
+  float   cor_ca_b_ft;
+  float   scale_md_v1;
+  int32_t md_version;    /* 0 = v1, 1 = v2 */
+  float   scale_md;
+  int32_t has_been_set;
+  float   v_strength;
+  float   v_radius;
+  float   v_steepness;
+  float   reserved[2];
+} _lens_params_t;
+
+static const dt_param_desc_t _params_lens[] = {
+  PARAM_I(_lens_params_t, method,        0.0f,   2.0f),
+  PARAM_I(_lens_params_t, modify_flags,  0.0f,   7.0f),
+  PARAM_B(_lens_params_t, inverse),
+  PARAM_F(_lens_params_t, scale,         0.1f,   2.0f),
+  PARAM_F(_lens_params_t, crop,          0.0f, 100.0f),
+  PARAM_F(_lens_params_t, focal,         0.0f, 10000.0f),
+  PARAM_F(_lens_params_t, aperture,      0.0f, 1000.0f),
+  PARAM_F(_lens_params_t, distance,      0.0f, 1000.0f),
+  PARAM_I(_lens_params_t, target_geom,   0.0f,   8.0f),
+  PARAM_B(_lens_params_t, tca_override),
+  PARAM_F(_lens_params_t, tca_r,         0.99f,  1.01f),
+  PARAM_F(_lens_params_t, tca_b,         0.99f,  1.01f),
+  PARAM_F(_lens_params_t, cor_dist_ft,   0.0f,   2.0f),
+  PARAM_F(_lens_params_t, cor_vig_ft,    0.0f,   2.0f),
+  PARAM_F(_lens_params_t, cor_ca_r_ft,   0.0f,   2.0f),
+  PARAM_F(_lens_params_t, cor_ca_b_ft,   0.0f,   2.0f),
+  PARAM_F(_lens_params_t, scale_md_v1,   0.9f,   1.1f),
+  PARAM_I(_lens_params_t, md_version,    0.0f,   1.0f),
+  PARAM_F(_lens_params_t, scale_md,      0.1f,   2.0f),
+  PARAM_B(_lens_params_t, has_been_set),
+  PARAM_F(_lens_params_t, v_strength,    0.0f,   1.0f),
+  PARAM_F(_lens_params_t, v_radius,      0.0f,   1.0f),
+  PARAM_F(_lens_params_t, v_steepness,   0.0f,   1.0f),
+  /* covers the struct tail so the params blob matches sizeof() */
+  { "reserved", offsetof(_lens_params_t, reserved), DT_PARAM_FLOAT,
+    2 * sizeof(float), 0.0f, 0.0f },
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: sigmoid  (version 3)
+ * darktable src/iop/sigmoid.c  dt_iop_sigmoid_params_t
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _sigmoid_params_t {
+  float   middle_grey_contrast;
+  float   contrast_skewness;
+  float   display_white_target;
+  float   display_black_target;
+  int32_t color_processing;   /* 0 per channel, 1 RGB ratio               */
+  float   hue_preservation;
+  float   red_inset;
+  float   red_rotation;
+  float   green_inset;
+  float   green_rotation;
+  float   blue_inset;
+  float   blue_rotation;
+  float   purity;
+  int32_t base_primaries;     /* 0 work profile, 1 Rec2020, 2 P3, 3 Adobe, 4 sRGB */
+} _sigmoid_params_t;
+
+static const dt_param_desc_t _params_sigmoid[] = {
+  PARAM_F(_sigmoid_params_t, middle_grey_contrast,  0.1f,   10.0f),
+  PARAM_F(_sigmoid_params_t, contrast_skewness,    -1.0f,    1.0f),
+  PARAM_F(_sigmoid_params_t, display_white_target, 20.0f, 1600.0f),
+  PARAM_F(_sigmoid_params_t, display_black_target,  0.0f,   15.0f),
+  PARAM_I(_sigmoid_params_t, color_processing,      0.0f,    1.0f),
+  PARAM_F(_sigmoid_params_t, hue_preservation,      0.0f,  100.0f),
+  PARAM_F(_sigmoid_params_t, red_inset,             0.0f,    0.99f),
+  PARAM_F(_sigmoid_params_t, red_rotation,         -0.4f,    0.4f),
+  PARAM_F(_sigmoid_params_t, green_inset,           0.0f,    0.99f),
+  PARAM_F(_sigmoid_params_t, green_rotation,       -0.4f,    0.4f),
+  PARAM_F(_sigmoid_params_t, blue_inset,            0.0f,    0.99f),
+  PARAM_F(_sigmoid_params_t, blue_rotation,        -0.4f,    0.4f),
+  PARAM_F(_sigmoid_params_t, purity,                0.0f,    1.0f),
+  PARAM_I(_sigmoid_params_t, base_primaries,        0.0f,    4.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: filmicrgb  (version 6)
+ * darktable src/iop/filmicrgb.c  dt_iop_filmicrgb_params_t
+ * Highlight reconstruction fields are kept for layout only.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _filmicrgb_params_t {
+  float   grey_point_source;
+  float   black_point_source;
+  float   white_point_source;
+  float   reconstruct_threshold;
+  float   reconstruct_feather;
+  float   reconstruct_bloom_vs_details;
+  float   reconstruct_grey_vs_color;
+  float   reconstruct_structure_vs_texture;
+  float   security_factor;
+  float   grey_point_target;
+  float   black_point_target;
+  float   white_point_target;
+  float   output_power;
+  float   latitude;
+  float   contrast;
+  float   saturation;
+  float   balance;
+  float   noise_level;
+  int32_t preserve_color;     /* 0 none, 1 max RGB, 2 luminance, 3 power, 4/5 euclidean */
+  int32_t version;            /* colour science, 0 = v3 (2019) .. 4 = v7 (2023)     */
+  int32_t auto_hardness;
+  int32_t custom_grey;
+  int32_t high_quality_reconstruction;
+  int32_t noise_distribution;
+  int32_t shadows;            /* 0 hard, 1 soft, 2 safe                   */
+  int32_t highlights;
+  int32_t compensate_icc_black;
+  int32_t spline_version;
+  int32_t enable_highlight_reconstruction;
+} _filmicrgb_params_t;
+
+static const dt_param_desc_t _params_filmicrgb[] = {
+  PARAM_F(_filmicrgb_params_t, grey_point_source,                0.0f,  100.0f),
+  PARAM_F(_filmicrgb_params_t, black_point_source,             -16.0f,   -0.1f),
+  PARAM_F(_filmicrgb_params_t, white_point_source,               0.1f,   16.0f),
+  PARAM_F(_filmicrgb_params_t, reconstruct_threshold,           -6.0f,    6.0f),
+  PARAM_F(_filmicrgb_params_t, reconstruct_feather,              0.25f,   6.0f),
+  PARAM_F(_filmicrgb_params_t, reconstruct_bloom_vs_details,  -100.0f,  100.0f),
+  PARAM_F(_filmicrgb_params_t, reconstruct_grey_vs_color,     -100.0f,  100.0f),
+  PARAM_F(_filmicrgb_params_t, reconstruct_structure_vs_texture, -100.0f, 100.0f),
+  PARAM_F(_filmicrgb_params_t, security_factor,                -50.0f,  200.0f),
+  PARAM_F(_filmicrgb_params_t, grey_point_target,                1.0f,   50.0f),
+  PARAM_F(_filmicrgb_params_t, black_point_target,               0.0f,   20.0f),
+  PARAM_F(_filmicrgb_params_t, white_point_target,               0.0f, 1600.0f),
+  PARAM_F(_filmicrgb_params_t, output_power,                     1.0f,   10.0f),
+  PARAM_F(_filmicrgb_params_t, latitude,                         0.01f,  99.0f),
+  PARAM_F(_filmicrgb_params_t, contrast,                         0.0f,    5.0f),
+  PARAM_F(_filmicrgb_params_t, saturation,                    -200.0f,  200.0f),
+  PARAM_F(_filmicrgb_params_t, balance,                        -50.0f,   50.0f),
+  PARAM_F(_filmicrgb_params_t, noise_level,                      0.0f,    6.0f),
+  PARAM_I(_filmicrgb_params_t, preserve_color,                   0.0f,    5.0f),
+  PARAM_I(_filmicrgb_params_t, version,                          0.0f,    4.0f),
+  PARAM_B(_filmicrgb_params_t, auto_hardness),
+  PARAM_B(_filmicrgb_params_t, custom_grey),
+  PARAM_I(_filmicrgb_params_t, high_quality_reconstruction,      0.0f,   10.0f),
+  PARAM_I(_filmicrgb_params_t, noise_distribution,               0.0f,    2.0f),
+  PARAM_I(_filmicrgb_params_t, shadows,                          0.0f,    2.0f),
+  PARAM_I(_filmicrgb_params_t, highlights,                       0.0f,    2.0f),
+  PARAM_B(_filmicrgb_params_t, compensate_icc_black),
+  PARAM_I(_filmicrgb_params_t, spline_version,                   0.0f,    2.0f),
+  PARAM_B(_filmicrgb_params_t, enable_highlight_reconstruction),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: agx  (version 7)
+ * darktable src/iop/agx.c  dt_iop_agx_params_t
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _agx_params_t {
+  float   look_lift;
+  float   look_slope;
+  float   look_brightness;
+  float   look_saturation;
+  float   look_original_hue_mix_ratio;
+  float   range_black_relative_ev;
+  float   range_white_relative_ev;
+  float   dynamic_range_scaling;
+  float   curve_pivot_x;
+  float   curve_pivot_y_linear_output;
+  float   curve_contrast_around_pivot;
+  float   curve_linear_ratio_below_pivot;
+  float   curve_linear_ratio_above_pivot;
+  float   curve_toe_power;
+  float   curve_shoulder_power;
+  float   curve_gamma;
+  int32_t auto_gamma;
+  float   curve_target_display_black_ratio;
+  float   curve_target_display_white_ratio;
+  int32_t base_primaries;     /* 0 export, 1 work, 2 Rec2020, 3 P3, 4 Adobe, 5 sRGB */
+  int32_t disable_primaries_adjustments;
+  float   red_inset;
+  float   red_rotation;
+  float   green_inset;
+  float   green_rotation;
+  float   blue_inset;
+  float   blue_rotation;
+  float   master_outset_ratio;
+  float   master_unrotation_ratio;
+  float   red_outset;
+  float   red_unrotation;
+  float   green_outset;
+  float   green_unrotation;
+  float   blue_outset;
+  float   blue_unrotation;
+  int32_t completely_reverse_primaries;
+} _agx_params_t;
+
+static const dt_param_desc_t _params_agx[] = {
+  PARAM_F(_agx_params_t, look_lift,                        -1.0f,   1.0f),
+  PARAM_F(_agx_params_t, look_slope,                        0.0f,  10.0f),
+  PARAM_F(_agx_params_t, look_brightness,                   0.0f, 100.0f),
+  PARAM_F(_agx_params_t, look_saturation,                   0.0f,  10.0f),
+  PARAM_F(_agx_params_t, look_original_hue_mix_ratio,       0.0f,   1.0f),
+  PARAM_F(_agx_params_t, range_black_relative_ev,         -20.0f,  -0.1f),
+  PARAM_F(_agx_params_t, range_white_relative_ev,           0.1f,  20.0f),
+  PARAM_F(_agx_params_t, dynamic_range_scaling,            -0.5f,   2.0f),
+  PARAM_F(_agx_params_t, curve_pivot_x,                     0.0f,   1.0f),
+  PARAM_F(_agx_params_t, curve_pivot_y_linear_output,       0.0f,   1.0f),
+  PARAM_F(_agx_params_t, curve_contrast_around_pivot,       0.1f,  10.0f),
+  PARAM_F(_agx_params_t, curve_linear_ratio_below_pivot,    0.0f,   1.0f),
+  PARAM_F(_agx_params_t, curve_linear_ratio_above_pivot,    0.0f,   1.0f),
+  PARAM_F(_agx_params_t, curve_toe_power,                   0.0f,  10.0f),
+  PARAM_F(_agx_params_t, curve_shoulder_power,              0.0f,  10.0f),
+  PARAM_F(_agx_params_t, curve_gamma,                       0.01f, 100.0f),
+  PARAM_B(_agx_params_t, auto_gamma),
+  PARAM_F(_agx_params_t, curve_target_display_black_ratio,  0.0f,   0.15f),
+  PARAM_F(_agx_params_t, curve_target_display_white_ratio,  0.2f,   1.0f),
+  PARAM_I(_agx_params_t, base_primaries,                    0.0f,   5.0f),
+  PARAM_B(_agx_params_t, disable_primaries_adjustments),
+  PARAM_F(_agx_params_t, red_inset,                         0.0f,   0.99f),
+  PARAM_F(_agx_params_t, red_rotation,                     -0.524f, 0.524f),
+  PARAM_F(_agx_params_t, green_inset,                       0.0f,   0.99f),
+  PARAM_F(_agx_params_t, green_rotation,                   -0.524f, 0.524f),
+  PARAM_F(_agx_params_t, blue_inset,                        0.0f,   0.99f),
+  PARAM_F(_agx_params_t, blue_rotation,                    -0.524f, 0.524f),
+  PARAM_F(_agx_params_t, master_outset_ratio,               0.0f,   2.0f),
+  PARAM_F(_agx_params_t, master_unrotation_ratio,           0.0f,   2.0f),
+  PARAM_F(_agx_params_t, red_outset,                        0.0f,   0.99f),
+  PARAM_F(_agx_params_t, red_unrotation,                   -0.524f, 0.524f),
+  PARAM_F(_agx_params_t, green_outset,                      0.0f,   0.99f),
+  PARAM_F(_agx_params_t, green_unrotation,                 -0.524f, 0.524f),
+  PARAM_F(_agx_params_t, blue_outset,                       0.0f,   0.99f),
+  PARAM_F(_agx_params_t, blue_unrotation,                  -0.524f, 0.524f),
+  PARAM_B(_agx_params_t, completely_reverse_primaries),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: channelmixerrgb  (version 3)
+ * darktable src/iop/channelmixerrgb.c  dt_iop_channelmixer_rgb_params_t
+ * The coefficient arrays have 4 floats each (the 4th is padding); their
+ * elements are exposed under darktable's introspection names "red[0]" etc.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _channelmixerrgb_params_t {
+  float   red[4];
+  float   green[4];
+  float   blue[4];
+  float   saturation[4];
+  float   lightness[4];
+  float   grey[4];
+  int32_t normalize_R, normalize_G, normalize_B;
+  int32_t normalize_sat, normalize_light, normalize_grey;
+  int32_t illuminant;         /* dt_illuminant_t: 0 pipe .. 10 camera     */
+  int32_t illum_fluo;         /* F1 .. F12                                */
+  int32_t illum_led;          /* B1 .. V2                                 */
+  int32_t adaptation;         /* 0 lin. Bradford, 1 CAT16, 2 Bradford, 3 XYZ, 4 none */
+  float   x, y;
+  float   temperature;
+  float   gamut;
+  int32_t clip;
+  int32_t version;            /* 0 v1, 1 v2, 2 v3                         */
+} _channelmixerrgb_params_t;
+
+#define PARAM_F_AT(st, name, field, lo, hi) \
+  { name, offsetof(st, field), DT_PARAM_FLOAT, sizeof(float), (lo), (hi) }
+
+static const dt_param_desc_t _params_channelmixerrgb[] = {
+  PARAM_F_AT(_channelmixerrgb_params_t, "red[0]",        red[0],        -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "red[1]",        red[1],        -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "red[2]",        red[2],        -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "green[0]",      green[0],      -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "green[1]",      green[1],      -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "green[2]",      green[2],      -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "blue[0]",       blue[0],       -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "blue[1]",       blue[1],       -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "blue[2]",       blue[2],       -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "saturation[0]", saturation[0], -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "saturation[1]", saturation[1], -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "saturation[2]", saturation[2], -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "lightness[0]",  lightness[0],  -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "lightness[1]",  lightness[1],  -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "lightness[2]",  lightness[2],  -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "grey[0]",       grey[0],       -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "grey[1]",       grey[1],       -2.0f, 2.0f),
+  PARAM_F_AT(_channelmixerrgb_params_t, "grey[2]",       grey[2],       -2.0f, 2.0f),
+  PARAM_B(_channelmixerrgb_params_t, normalize_R),
+  PARAM_B(_channelmixerrgb_params_t, normalize_G),
+  PARAM_B(_channelmixerrgb_params_t, normalize_B),
+  PARAM_B(_channelmixerrgb_params_t, normalize_sat),
+  PARAM_B(_channelmixerrgb_params_t, normalize_light),
+  PARAM_B(_channelmixerrgb_params_t, normalize_grey),
+  PARAM_I(_channelmixerrgb_params_t, illuminant,     0.0f,    10.0f),
+  PARAM_I(_channelmixerrgb_params_t, illum_fluo,     0.0f,    11.0f),
+  PARAM_I(_channelmixerrgb_params_t, illum_led,      0.0f,     8.0f),
+  PARAM_I(_channelmixerrgb_params_t, adaptation,     0.0f,     4.0f),
+  PARAM_F(_channelmixerrgb_params_t, x,              0.0f,     1.0f),
+  PARAM_F(_channelmixerrgb_params_t, y,              0.0f,     1.0f),
+  PARAM_F(_channelmixerrgb_params_t, temperature, 1667.0f, 25000.0f),
+  PARAM_F(_channelmixerrgb_params_t, gamut,          0.0f,    12.0f),
+  PARAM_B(_channelmixerrgb_params_t, clip),
+  PARAM_I(_channelmixerrgb_params_t, version,        0.0f,     2.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: lut3d  (version 3)
+ * darktable src/iop/lut3d.c  dt_iop_lut3d_params_t
+ * filepath is a fixed-size char array (512 bytes).  The G'MIC compressed
+ * LUT (c_clut, lutname) follows nb_keypoints and is kept for layout only.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _lut3d_params_t {
+  char    filepath[512];
+  int32_t colorspace;     /* 0 sRGB, 1 Adobe RGB, 2 Rec709, 3 lin Rec709,
+                             4 lin Rec2020, 5 lin ProPhoto               */
+  int32_t interpolation;  /* 0 tetrahedral, 1 trilinear, 2 pyramid        */
+  int32_t nb_keypoints;   /* G'MIC compressed LUT (unsupported)           */
+  char    c_clut[2048 * 2 * 3];
+  char    lutname[128];
+} _lut3d_params_t;
+
+static const dt_param_desc_t _params_lut3d[] = {
+  PARAM_S(_lut3d_params_t, filepath),
+  PARAM_I(_lut3d_params_t, colorspace,    0.0f, 5.0f),
+  PARAM_I(_lut3d_params_t, interpolation, 0.0f, 2.0f),
+  PARAM_I(_lut3d_params_t, nb_keypoints,  0.0f, 2048.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: denoiseprofile  (version 12)
+ * darktable src/iop/denoiseprofile.c  dt_iop_denoiseprofile_params_t
+ * a[0] == -1 asks for the camera's noise profile at commit time.  The
+ * per-band force curves x/y (6 channels x 7 bands each) are not exposed;
+ * they keep their defaults unless a history stack sets them.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _denoiseprofile_params_t {
+  float   radius;
+  float   nbhood;
+  float   strength;
+  float   shadows;
+  float   bias;
+  float   scattering;
+  float   central_pixel_weight;
+  float   overshooting;
+  float   a[3], b[3];
+  int32_t mode;                  /* 0 nlmeans, 1 wavelets, 2 variance,
+                                    3 nlmeans auto, 4 wavelets auto     */
+  float   x[6][7];
+  float   y[6][7];
+  int32_t wb_adaptive_anscombe;
+  int32_t fix_anscombe_and_nlmeans_norm;
+  int32_t use_new_vst;
+  int32_t wavelet_color_mode;    /* 0 RGB, 1 Y0U0V0                     */
+  int32_t compensate_hilite_pres;
+} _denoiseprofile_params_t;
+
+static const dt_param_desc_t _params_denoiseprofile[] = {
+  PARAM_F(_denoiseprofile_params_t, radius,               0.0f,    12.0f),
+  PARAM_F(_denoiseprofile_params_t, nbhood,               1.0f,    30.0f),
+  PARAM_F(_denoiseprofile_params_t, strength,             0.001f, 1000.0f),
+  PARAM_F(_denoiseprofile_params_t, shadows,              0.0f,     1.8f),
+  PARAM_F(_denoiseprofile_params_t, bias,              -1000.0f,  100.0f),
+  PARAM_F(_denoiseprofile_params_t, scattering,           0.0f,    20.0f),
+  PARAM_F(_denoiseprofile_params_t, central_pixel_weight, 0.0f,    10.0f),
+  PARAM_F(_denoiseprofile_params_t, overshooting,         0.001f, 1000.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "a[0]", a[0], -1.0f, 1.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "a[1]", a[1], -1.0f, 1.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "a[2]", a[2], -1.0f, 1.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "b[0]", b[0], -1.0f, 1.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "b[1]", b[1], -1.0f, 1.0f),
+  PARAM_F_AT(_denoiseprofile_params_t, "b[2]", b[2], -1.0f, 1.0f),
+  PARAM_I(_denoiseprofile_params_t, mode,                 0.0f,     4.0f),
+  PARAM_B(_denoiseprofile_params_t, wb_adaptive_anscombe),
+  PARAM_B(_denoiseprofile_params_t, fix_anscombe_and_nlmeans_norm),
+  PARAM_B(_denoiseprofile_params_t, use_new_vst),
+  PARAM_I(_denoiseprofile_params_t, wavelet_color_mode,   0.0f,     1.0f),
+  PARAM_B(_denoiseprofile_params_t, compensate_hilite_pres),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: bilat  (version 3)
+ * darktable src/iop/bilat.c  dt_iop_bilat_params_t
+ * In local laplacian mode sigma_r / sigma_s are the highlights / shadows
+ * sliders; in bilateral grid mode they are the range and spatial sigmas.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _bilat_params_t {
+  int32_t mode;     /* 0 bilateral grid, 1 local laplacian */
+  float   sigma_r;  /* highlights / range   [0, 100]  */
+  float   sigma_s;  /* shadows / spatial    [0, 100]  */
+  float   detail;   /* local contrast       [-1, 4]   */
+  float   midtone;  /* midtone range        [0.001, 1]*/
+} _bilat_params_t;
+
+static const dt_param_desc_t _params_bilat[] = {
+  PARAM_I(_bilat_params_t, mode,     0.0f,   1.0f),
+  PARAM_F(_bilat_params_t, sigma_r,  0.0f, 100.0f),
+  PARAM_F(_bilat_params_t, sigma_s,  0.0f, 100.0f),
+  PARAM_F(_bilat_params_t, detail,  -1.0f,   4.0f),
+  PARAM_F(_bilat_params_t, midtone,  0.001f, 1.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: toneequal  (version 2)
+ * darktable src/iop/toneequal.c  dt_iop_toneequalizer_params_t
+ * The nine gains are the -8 … 0 EV channels, in EV.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _toneequal_params_t {
+  float   noise;             /* -8 EV gain                 [-2, 2]        */
+  float   ultra_deep_blacks; /* -7 EV gain                 [-2, 2]        */
+  float   deep_blacks;       /* -6 EV gain                 [-2, 2]        */
+  float   blacks;            /* -5 EV gain                 [-2, 2]        */
+  float   shadows;           /* -4 EV gain                 [-2, 2]        */
+  float   midtones;          /* -3 EV gain                 [-2, 2]        */
+  float   highlights;        /* -2 EV gain                 [-2, 2]        */
+  float   whites;            /* -1 EV gain                 [-2, 2]        */
+  float   speculars;         /*  0 EV gain                 [-2, 2]        */
+  float   blending;          /* smoothing diameter, %      [0.01, 100]    */
+  float   smoothing;         /* curve smoothing √2^(1+s)   [0.6, 2.6]     */
+  float   feathering;        /* edges refinement           [0.01, 10000]  */
+  float   quantization;      /* mask quantization, EV      [0, 2]         */
+  float   contrast_boost;    /* mask contrast, EV          [-16, 16]      */
+  float   exposure_boost;    /* mask exposure, EV          [-16, 16]      */
+  int32_t details;           /* 0 none … 4 EIGF                           */
+  int32_t method;            /* luminance estimator 0–6                   */
+  int32_t iterations;        /* filter diffusion           [1, 20]        */
+} _toneequal_params_t;
+
+static const dt_param_desc_t _params_toneequal[] = {
+  PARAM_F(_toneequal_params_t, noise,              -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, ultra_deep_blacks,  -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, deep_blacks,        -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, blacks,             -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, shadows,            -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, midtones,           -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, highlights,         -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, whites,             -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, speculars,          -2.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, blending,            0.01f,  100.0f),
+  PARAM_F(_toneequal_params_t, smoothing,           0.6f,     2.6f),
+  PARAM_F(_toneequal_params_t, feathering,          0.01f, 10000.0f),
+  PARAM_F(_toneequal_params_t, quantization,        0.0f,     2.0f),
+  PARAM_F(_toneequal_params_t, contrast_boost,    -16.0f,    16.0f),
+  PARAM_F(_toneequal_params_t, exposure_boost,    -16.0f,    16.0f),
+  PARAM_I(_toneequal_params_t, details,             0.0f,     4.0f),
+  PARAM_I(_toneequal_params_t, method,              0.0f,     6.0f),
+  PARAM_I(_toneequal_params_t, iterations,          1.0f,    20.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: ashift  (version 5)
+ * darktable src/iop/ashift.c  dt_iop_ashift_params_t
+ * The drawn / quad line arrays only feed the editor's fit; they are kept
+ * for layout and covered by one opaque entry.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _ashift_params_t {
+  float   rotation;          /* degrees                    [-180, 180]    */
+  float   lensshift_v;       /* vertical lens shift        [-2, 2]        */
+  float   lensshift_h;       /* horizontal lens shift      [-2, 2]        */
+  float   shear;             /*                            [-0.5, 0.5]    */
+  float   f_length;          /* focal length, mm           [1, 2000]      */
+  float   crop_factor;       /*                            [0.5, 10]      */
+  float   orthocorr;         /* lens dependence, %         [0, 100]       */
+  float   aspect;            /* aspect adjust              [0.5, 2]       */
+  int32_t mode;              /* 0 generic, 1 specific                     */
+  int32_t cropmode;          /* 0 off, 1 largest, 2 aspect (editor only)  */
+  float   cl;                /* crop box left              [0, 1]         */
+  float   cr;                /* crop box right             [0, 1]         */
+  float   ct;                /* crop box top               [0, 1]         */
+  float   cb;                /* crop box bottom            [0, 1]         */
+  float   last_drawn_lines[200];
+  int32_t last_drawn_lines_count;
+  float   last_quad_lines[8];
+} _ashift_params_t;
+
+static const dt_param_desc_t _params_ashift[] = {
+  PARAM_F(_ashift_params_t, rotation,     -180.0f,  180.0f),
+  PARAM_F(_ashift_params_t, lensshift_v,    -2.0f,    2.0f),
+  PARAM_F(_ashift_params_t, lensshift_h,    -2.0f,    2.0f),
+  PARAM_F(_ashift_params_t, shear,          -0.5f,    0.5f),
+  PARAM_F(_ashift_params_t, f_length,        1.0f, 2000.0f),
+  PARAM_F(_ashift_params_t, crop_factor,     0.5f,   10.0f),
+  PARAM_F(_ashift_params_t, orthocorr,       0.0f,  100.0f),
+  PARAM_F(_ashift_params_t, aspect,          0.5f,    2.0f),
+  PARAM_I(_ashift_params_t, mode,            0.0f,    1.0f),
+  PARAM_I(_ashift_params_t, cropmode,        0.0f,    2.0f),
+  PARAM_F(_ashift_params_t, cl,              0.0f,    1.0f),
+  PARAM_F(_ashift_params_t, cr,              0.0f,    1.0f),
+  PARAM_F(_ashift_params_t, ct,              0.0f,    1.0f),
+  PARAM_F(_ashift_params_t, cb,              0.0f,    1.0f),
+  /* covers the struct tail so the params blob matches sizeof() */
+  { "lines", offsetof(_ashift_params_t, last_drawn_lines), DT_PARAM_FLOAT,
+    sizeof(_ashift_params_t) - offsetof(_ashift_params_t, last_drawn_lines), 0.0f, 0.0f },
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: flip  (version 2)
+ * darktable src/iop/flip.c  dt_iop_flip_params_t
+ * orientation -1 takes the orientation from the image's EXIF data.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _flip_params_t {
+  int32_t orientation;       /* dt_image_orientation_t     [-1, 7]        */
+} _flip_params_t;
+
+static const dt_param_desc_t _params_flip[] = {
+  PARAM_I(_flip_params_t, orientation,    -1.0f,    7.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: crop  (version 3)
+ * darktable src/iop/crop.c  dt_iop_crop_params_t
+ * cw / ch are the right and bottom edges, not sizes.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _crop_params_t {
+  float   cx;                /* left                       [0, 1]         */
+  float   cy;                /* top                        [0, 1]         */
+  float   cw;                /* right                      [0, 1]         */
+  float   ch;                /* bottom                     [0, 1]         */
+  int32_t ratio_n;           /* aspect numerator, -1 free (editor only)   */
+  int32_t ratio_d;           /* aspect denominator                        */
+} _crop_params_t;
+
+static const dt_param_desc_t _params_crop[] = {
+  PARAM_F(_crop_params_t, cx,              0.0f,    1.0f),
+  PARAM_F(_crop_params_t, cy,              0.0f,    1.0f),
+  PARAM_F(_crop_params_t, cw,              0.0f,    1.0f),
+  PARAM_F(_crop_params_t, ch,              0.0f,    1.0f),
+  PARAM_I(_crop_params_t, ratio_n,        -1.0f, 1000.0f),
+  PARAM_I(_crop_params_t, ratio_d,        -1.0f, 1000.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: cacorrect  (version 2)
+ * darktable src/iop/cacorrect.c  dt_iop_cacorrect_params_t
+ * Raw chromatic aberration correction; Bayer only.
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _cacorrect_params_t {
+  int32_t avoidshift;        /* gboolean, avoid colour shift              */
+  int32_t iterations;        /* fit / correct passes       [1, 5]         */
+} _cacorrect_params_t;
+
+static const dt_param_desc_t _params_cacorrect[] = {
+  PARAM_I(_cacorrect_params_t, avoidshift,     0.0f,    1.0f),
+  PARAM_I(_cacorrect_params_t, iterations,     1.0f,    5.0f),
+};
+
+/* ═══════════════════════════════════════════════════════════════════════════
+ * Module: hotpixels  (version 1)
+ * darktable src/iop/hotpixels.c  dt_iop_hotpixels_params_t
+ * ══════════════════════════════════════════════════════════════════════════*/
+
+typedef struct _hotpixels_params_t {
+  float   strength;          /*                            [0, 1]         */
+  float   threshold;         /*                            [0, 1]         */
+  int32_t markfixed;         /* gboolean, editor aid                      */
+  int32_t permissive;        /* gboolean, detect by 3 neighbours          */
+} _hotpixels_params_t;
+
+static const dt_param_desc_t _params_hotpixels[] = {
+  PARAM_F(_hotpixels_params_t, strength,       0.0f,    1.0f),
+  PARAM_F(_hotpixels_params_t, threshold,      0.0f,    1.0f),
+  PARAM_I(_hotpixels_params_t, markfixed,      0.0f,    1.0f),
+  PARAM_I(_hotpixels_params_t, permissive,     0.0f,    1.0f),
+};
+
 /* ═══════════════════════════════════════════════════════════════════════════
  * Master lookup table
  * ══════════════════════════════════════════════════════════════════════════*/
@@ -273,6 +869,20 @@ static const dt_module_param_table_t _module_param_tables[] = {
   { "colorout",    _params_colorout,    ARRAY_LEN(_params_colorout)    },
   { "highlights",  _params_highlights,  ARRAY_LEN(_params_highlights)  },
   { "sharpen",     _params_sharpen,     ARRAY_LEN(_params_sharpen)     },
+  { "lens",        _params_lens,        ARRAY_LEN(_params_lens)        },
+  { "sigmoid",     _params_sigmoid,     ARRAY_LEN(_params_sigmoid)     },
+  { "filmicrgb",   _params_filmicrgb,   ARRAY_LEN(_params_filmicrgb)   },
+  { "agx",         _params_agx,         ARRAY_LEN(_params_agx)         },
+  { "channelmixerrgb", _params_channelmixerrgb, ARRAY_LEN(_params_channelmixerrgb) },
+  { "lut3d",       _params_lut3d,       ARRAY_LEN(_params_lut3d)       },
+  { "denoiseprofile", _params_denoiseprofile, ARRAY_LEN(_params_denoiseprofile) },
+  { "bilat",       _params_bilat,       ARRAY_LEN(_params_bilat)       },
+  { "toneequal",   _params_toneequal,   ARRAY_LEN(_params_toneequal)   },
+  { "ashift",      _params_ashift,      ARRAY_LEN(_params_ashift)      },
+  { "flip",        _params_flip,        ARRAY_LEN(_params_flip)        },
+  { "crop",        _params_crop,        ARRAY_LEN(_params_crop)        },
+  { "cacorrect",   _params_cacorrect,   ARRAY_LEN(_params_cacorrect)   },
+  { "hotpixels",   _params_hotpixels,   ARRAY_LEN(_params_hotpixels)   },
 };
 
 static const int _module_param_tables_count =
@@ -444,6 +1054,39 @@ int dtpipe_set_param_int(dt_pipe_t *pipe, const char *module_name,
   return DTPIPE_OK;
 }
 
+/* ── dtpipe_set_param_string ─────────────────────────────────────────────── */
+
+int dtpipe_set_param_string(dt_pipe_t *pipe, const char *module_name,
+                            const char *param, const char *value)
+{
+  if(!pipe || !module_name || !param || !value)
+    return DTPIPE_ERR_INVALID_ARG;
+
+  dt_iop_module_t *m = dtpipe_find_module(pipe, module_name);
+  if(!m)
+    return DTPIPE_ERR_NOT_FOUND;
+
+  if(!m->params)
+    return DTPIPE_ERR_NOT_FOUND;
+
+  const dt_param_desc_t *desc = dtpipe_lookup_param(module_name, param);
+  if(!desc)
+    return DTPIPE_ERR_NOT_FOUND;
+
+  if(desc->type != DT_PARAM_STRING)
+    return DTPIPE_ERR_PARAM_TYPE;
+
+  /* Unlike numeric bounds this is a hard limit: the field is fixed-size */
+  const size_t len = strlen(value);
+  if(len >= desc->size)
+    return DTPIPE_ERR_INVALID_ARG;
+
+  char *dst = (char *)((uint8_t *)m->params + desc->offset);
+  memset(dst, 0, desc->size);
+  memcpy(dst, value, len);
+  return DTPIPE_OK;
+}
+
 /* ── dtpipe_get_param_float ──────────────────────────────────────────────── */
 
 int dtpipe_get_param_float(dt_pipe_t *pipe, const char *module_name,
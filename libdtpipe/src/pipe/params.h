@@ -37,6 +37,7 @@ typedef enum dt_param_type_t
   DT_PARAM_INT    = 1,
   DT_PARAM_UINT32 = 2,
   DT_PARAM_BOOL   = 3,
+  DT_PARAM_STRING = 4, /* fixed-size, NUL-terminated char array */
 } dt_param_type_t;
 
 /* ── Single parameter descriptor ─────────────────────────────────────────── */
@@ -13,8 +13,10 @@
 
 #include "pipe/pixelpipe.h"
 #include "dtpipe_internal.h"
+#include "common/interpolation.h"
 
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -154,6 +156,7 @@ void dt_dev_pixelpipe_set_input(dt_dev_pixelpipe_t *pipe,
     pipe->image = *image; /* shallow copy of metadata */
 
   pipe->input_changed = true;
+  pipe->input_timestamp++;
   pipe->status        = DT_DEV_PIXELPIPE_DIRTY;
 }
 
@@ -260,9 +263,440 @@ static inline bool _skip_piece(const dt_dev_pixelpipe_iop_t *piece)
     return true;
   if(piece->module && piece->module->iop_order == INT_MAX)
     return true;
+  /* folded into an upstream stage by _plan_matrix_fusion(),
+     _plan_warp_fusion() or _plan_raw_fusion() */
+  if(piece->fused_into)
+    return true;
   return false;
 }
 
+/* ── Commit and matrix stage fusion ──────────────────────────────────────── */
+/*
+ * Before each run every enabled piece commits its params (front to back,
+ * so a piece may look at what its predecessors committed), then the
+ * planner looks for runs of adjacent pieces that each reduce to one 3x3
+ * RGB matrix (module->color_matrix(), e.g. colorin followed by color
+ * calibration without gamut compression).  Disabled pieces in between do
+ * not break a run.  The run is composed into the head piece, which then
+ * makes a single matrix pass over the buffer; the others are skipped.
+ *
+ * A piece is only fused when it has no active blending and no ROI
+ * callbacks, so the fused pass is pixel-for-pixel the same map, and when
+ * it reads and writes 4-channel float buffers, the only ones the fused
+ * pass handles.
+ */
+
+static void _commit_pieces(dt_dev_pixelpipe_t *pipe)
+{
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    dt_dev_pixelpipe_iop_t *piece  = &node->piece;
+    dt_iop_module_t        *module = piece->module;
+
+    /* commit_params() may switch a piece off for one run (flip without an
+       orientation), so start from the module */
+    if(module)
+      piece->enabled = module->enabled;
+    piece->fused_count = 0;
+    piece->fused_into  = false;
+    piece->fused_warp  = false;
+    piece->fused_hotpixels = NULL;
+
+    dt_hash_t hash = dt_hash(DT_INITHASH, &piece->enabled, sizeof(piece->enabled));
+    if(module && module->params)
+      hash = dt_hash(hash, module->params, module->params_size);
+    if(piece->blendop_data)
+      hash = dt_hash(hash, piece->blendop_data, sizeof(dt_develop_blend_params_t));
+    piece->hash = hash;
+
+    if(piece->enabled && module && module->commit_params)
+      module->commit_params(module, module->params, pipe, piece);
+  }
+}
+
+dt_hash_t dt_dev_pixelpipe_piece_hash(const dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_roi_t *roi,
+                                      const bool include)
+{
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  dt_hash_t hash = dt_hash(DT_INITHASH, &pipe->input, sizeof(pipe->input));
+  hash = dt_hash(hash, &pipe->input_timestamp, sizeof(pipe->input_timestamp));
+  hash = dt_hash(hash, &pipe->iwidth, sizeof(pipe->iwidth));
+  hash = dt_hash(hash, &pipe->iheight, sizeof(pipe->iheight));
+  hash = dt_hash(hash, &pipe->iscale, sizeof(pipe->iscale));
+
+  for(const _pipe_node_t *node = (const _pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    if(&node->piece == piece && !include)
+      break;
+    hash = dt_hash(hash, &node->piece.hash, sizeof(node->piece.hash));
+    if(&node->piece == piece)
+      break;
+  }
+
+  if(roi)
+  {
+    hash = dt_hash(hash, &roi->x, sizeof(roi->x));
+    hash = dt_hash(hash, &roi->y, sizeof(roi->y));
+    hash = dt_hash(hash, &roi->width, sizeof(roi->width));
+    hash = dt_hash(hash, &roi->height, sizeof(roi->height));
+    hash = dt_hash(hash, &roi->scale, sizeof(roi->scale));
+  }
+  return hash;
+}
+
+/* Buffer formats of the enabled pieces for this run, front to back, as the
+   recursion will find them.  The fused passes only handle 4-channel float
+   buffers and the pieces folded into a head are skipped, so the planners
+   must not start a run the head could not process fused. */
+static void _plan_formats(dt_dev_pixelpipe_t *pipe,
+                          const dt_iop_buffer_dsc_t *input_format)
+{
+  dt_iop_buffer_dsc_t dsc = *input_format;
+
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    dt_dev_pixelpipe_iop_t *piece  = &node->piece;
+    dt_iop_module_t        *module = piece->module;
+
+    piece->dsc_out = piece->dsc_in = dsc;
+    if(_skip_piece(piece))
+      continue;
+
+    if(module->output_format)
+      module->output_format(module, pipe, piece, &piece->dsc_out);
+    dsc = piece->dsc_out;
+  }
+}
+
+static inline bool _piece_rgba(const dt_dev_pixelpipe_iop_t *piece)
+{
+  return piece->dsc_in.channels == 4 && piece->dsc_in.datatype == TYPE_FLOAT
+      && piece->dsc_out.channels == 4 && piece->dsc_out.datatype == TYPE_FLOAT;
+}
+
+static bool _piece_matrix(dt_dev_pixelpipe_iop_t *piece, dt_colormatrix_t M)
+{
+  dt_iop_module_t *module = piece->module;
+  if(!module || !module->color_matrix)
+    return false;
+  if(module->modify_roi_in || module->modify_roi_out)
+    return false;
+  if(!_piece_rgba(piece))
+    return false;
+
+  const dt_develop_blend_params_t *const b = piece->blendop_data;
+  if(b && b->mask_mode != DEVELOP_MASK_DISABLED)
+    return false;
+
+  return module->color_matrix(module, piece, M);
+}
+
+static void _plan_matrix_fusion(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_iop_t *head = NULL;
+
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    dt_dev_pixelpipe_iop_t *piece = &node->piece;
+    if(_skip_piece(piece))
+      continue;
+
+    dt_colormatrix_t M;
+    if(!_piece_matrix(piece, M))
+    {
+      head = NULL;
+      continue;
+    }
+
+    if(!head)
+    {
+      head = piece;
+      for(int r = 0; r < 3; r++)
+        for(int c = 0; c < 3; c++)
+          head->fused_matrix[r][c] = M[r][c];
+      continue;
+    }
+
+    /* fused = M · fused */
+    float prod[3][3];
+    for(int r = 0; r < 3; r++)
+      for(int c = 0; c < 3; c++)
+        prod[r][c] = M[r][0] * head->fused_matrix[0][c]
+                   + M[r][1] * head->fused_matrix[1][c]
+                   + M[r][2] * head->fused_matrix[2][c];
+    memcpy(head->fused_matrix, prod, sizeof(prod));
+
+    head->fused_count++;
+    piece->fused_into = true;
+  }
+}
+
+/* Single pass of a fused run: out = M · in on RGB, alpha copied. */
+static void _process_fused_matrix(const dt_dev_pixelpipe_iop_t *piece,
+                                  const float *const restrict in,
+                                  float *const restrict out,
+                                  const dt_iop_roi_t *roi_out)
+{
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+
+  /* transposed and padded, one column per output channel */
+  dt_colormatrix_t Mt = { { 0.0f } };
+  for(int r = 0; r < 3; r++)
+    for(int c = 0; c < 3; c++)
+      Mt[c][r] = piece->fused_matrix[r][c];
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < 4 * npixels; k += 4)
+  {
+    dt_aligned_pixel_t pix;
+    for_each_channel(r)
+      pix[r] = Mt[0][r] * in[k] + Mt[1][r] * in[k + 1] + Mt[2][r] * in[k + 2];
+    pix[3] = in[k + 3];
+    copy_pixel_nontemporal(out + k, pix);
+  }
+  dt_omploop_sfence();
+}
+
+/* ── Geometry: warp fusion and pure ROI changes ──────────────────────────── */
+/*
+ * Geometric pieces (crop, flip, ashift, ...) describe themselves by point
+ * maps on full-size coordinates.  darktable resamples or copies the whole
+ * buffer once per such module; here a run of adjacent ones is planned like
+ * a matrix run: the head gets fused_warp, its modify_roi_in() is chained
+ * over the run, and a single pass maps every output pixel back through all
+ * of them and samples the head's input once.  A piece or run whose map is
+ * a sub-pixel translation with unchanged size (a crop at any scale, a
+ * neutral perspective) is a pure ROI change: its output is its input
+ * buffer, nothing is copied.
+ */
+
+/* longest run of geometric pieces folded into one pass */
+#define DT_WARP_RUN_MAX 16
+
+static bool _piece_warp(const dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_iop_module_t *module = piece->module;
+  if(!module || !module->distort_backtransform || !module->modify_roi_in)
+    return false;
+  if(!_piece_rgba(piece))
+    return false;
+
+  const dt_develop_blend_params_t *const b = piece->blendop_data;
+  return !(b && b->mask_mode != DEVELOP_MASK_DISABLED);
+}
+
+static void _plan_warp_fusion(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_iop_t *head = NULL;
+
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    dt_dev_pixelpipe_iop_t *piece = &node->piece;
+    if(_skip_piece(piece))
+      continue;
+
+    if(!_piece_warp(piece))
+    {
+      head = NULL;
+      continue;
+    }
+
+    if(!head || head->fused_count + 1 >= DT_WARP_RUN_MAX)
+    {
+      head = piece;
+      continue;
+    }
+
+    head->fused_warp = true;
+    head->fused_count++;
+    piece->fused_into = true;
+  }
+}
+
+/* The pieces of the geometric run starting at head, head first. */
+static int _warp_run(dt_dev_pixelpipe_t *pipe,
+                     dt_dev_pixelpipe_iop_t *head,
+                     dt_dev_pixelpipe_iop_t **run)
+{
+  run[0] = head;
+  if(!head->fused_warp)
+    return 1;
+
+  int n = 1;
+  bool found = false;
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes;
+      node && n <= head->fused_count; node = node->next)
+  {
+    if(&node->piece == head)
+      found = true;
+    else if(found && node->piece.fused_into)
+      run[n++] = &node->piece;
+  }
+  return n;
+}
+
+/* True if the run maps output pixel (i, j) onto input pixel (i, j) up to a
+   common sub-pixel shift, i.e. the run is a pure ROI change. */
+static bool _warp_is_identity(dt_dev_pixelpipe_iop_t *const *run,
+                              const int n,
+                              const dt_iop_roi_t *const roi_in,
+                              const dt_iop_roi_t *const roi_out)
+{
+  if(roi_in->width != roi_out->width || roi_in->height != roi_out->height
+     || roi_in->scale != roi_out->scale)
+    return false;
+
+  const float corner[4][2] = { { 0.0f, 0.0f },
+                               { roi_out->width - 1.0f, 0.0f },
+                               { 0.0f, roi_out->height - 1.0f },
+                               { roi_out->width - 1.0f, roi_out->height - 1.0f } };
+  float pts[8];
+  for(int c = 0; c < 4; c++)
+  {
+    pts[2 * c]     = (roi_out->x + corner[c][0] + 0.5f) / roi_out->scale;
+    pts[2 * c + 1] = (roi_out->y + corner[c][1] + 0.5f) / roi_out->scale;
+  }
+  for(int k = n - 1; k >= 0; k--)
+    run[k]->module->distort_backtransform(run[k]->module, run[k], pts, 4);
+
+  float d0[2] = { 0.0f, 0.0f };
+  for(int c = 0; c < 4; c++)
+  {
+    const float dx = pts[2 * c] * roi_in->scale - 0.5f - roi_in->x - corner[c][0];
+    const float dy = pts[2 * c + 1] * roi_in->scale - 0.5f - roi_in->y - corner[c][1];
+    if(c == 0)
+    {
+      d0[0] = dx;
+      d0[1] = dy;
+      if(fabsf(dx) > 0.5f + 1e-3f || fabsf(dy) > 0.5f + 1e-3f)
+        return false;
+    }
+    else if(fabsf(dx - d0[0]) > 1e-3f || fabsf(dy - d0[1]) > 1e-3f)
+      return false;
+  }
+  return true;
+}
+
+void dt_dev_pixelpipe_warp(dt_dev_pixelpipe_iop_t *const *pieces,
+                           const int count,
+                           const float *const in,
+                           float *const out,
+                           const dt_iop_roi_t *const roi_in,
+                           const dt_iop_roi_t *const roi_out)
+{
+  const dt_interpolation_t *itor = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
+  const int width = roi_out->width;
+  const int in_width = roi_in->width;
+  const int in_height = roi_in->height;
+
+  size_t padded;
+  float *const points = dt_alloc_perthread_float((size_t)2 * width, &padded);
+  if(!points)
+  {
+    fprintf(stderr, "[pixelpipe] out of memory in warp\n");
+    memset(out, 0, sizeof(float) * 4 * width * roi_out->height);
+    return;
+  }
+
+  DT_OMP_FOR()
+  for(int j = 0; j < roi_out->height; j++)
+  {
+    float *const restrict pts = dt_get_perthread(points, padded);
+    const float y = (roi_out->y + j + 0.5f) / roi_out->scale;
+    for(int i = 0; i < width; i++)
+    {
+      pts[2 * i]     = (roi_out->x + i + 0.5f) / roi_out->scale;
+      pts[2 * i + 1] = y;
+    }
+
+    /* back through the run, tail first, one call per piece and row */
+    for(int k = count - 1; k >= 0; k--)
+      pieces[k]->module->distort_backtransform(pieces[k]->module, pieces[k], pts, width);
+
+    float *const restrict orow = out + (size_t)4 * width * j;
+    for(int i = 0; i < width; i++)
+    {
+      const float px = pts[2 * i] * roi_in->scale - 0.5f - roi_in->x;
+      const float py = pts[2 * i + 1] * roi_in->scale - 0.5f - roi_in->y;
+      const float rx = roundf(px);
+      const float ry = roundf(py);
+      if(fabsf(px - rx) < 1e-3f && fabsf(py - ry) < 1e-3f)
+      {
+        const int ix = (int)rx;
+        const int iy = (int)ry;
+        if(ix >= 0 && iy >= 0 && ix < in_width && iy < in_height)
+          copy_pixel(orow + 4 * i, in + (size_t)4 * ((size_t)iy * in_width + ix));
+        else
+          for_four_channels(c)
+            orow[4 * i + c] = 0.0f;
+      }
+      else
+        dt_interpolation_compute_pixel4c(itor, in, orow + 4 * i, px, py,
+                                         in_width, in_height, 4 * in_width);
+    }
+  }
+
+  dt_free_align(points);
+}
+
+/* ── Raw stage: hot pixels folded into rawprepare ────────────────────────── */
+/*
+ * The hot pixel filter only compares a sensel with its same-colour
+ * neighbours, so a gain per CFA colour in front of it (white balance) does
+ * not change which sensels it fixes once the gain is divided out of the
+ * threshold.  When only such pieces separate rawprepare and a hot pixel
+ * piece that can run on rows (raw_prefilter()), the filter is handed to
+ * rawprepare, which applies it to the rows it has just scaled: the mosaic
+ * is read once and the hot pixel pass and its buffer disappear.  The
+ * filter's hash and the gains are folded into rawprepare's hash, so cache
+ * lines of the fused output never match an unfused run.
+ */
+
+static void _plan_raw_fusion(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_iop_t *head = NULL;
+  float gains[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+  for(_pipe_node_t *node = (_pipe_node_t *)pipe->nodes; node; node = node->next)
+  {
+    dt_dev_pixelpipe_iop_t *piece = &node->piece;
+    dt_iop_module_t *module = piece->module;
+    if(_skip_piece(piece))
+      continue;
+
+    if(!head)
+    {
+      // rawprepare is the first piece on the mosaic, or there is nothing to do
+      if(!dt_iop_module_is(module->so, "rawprepare"))
+        return;
+      head = piece;
+      continue;
+    }
+
+    const dt_develop_blend_params_t *const b = piece->blendop_data;
+    const bool blended = b && b->mask_mode != DEVELOP_MASK_DISABLED;
+    const struct dt_hotpixels_t *filter =
+      (module->raw_prefilter && !blended) ? module->raw_prefilter(module, piece) : NULL;
+    if(filter)
+    {
+      head->fused_hotpixels = filter;
+      for(int c = 0; c < 4; c++)
+        head->fused_raw_gains[c] = gains[c];
+      head->hash = dt_hash(head->hash, &piece->hash, sizeof(piece->hash));
+      head->hash = dt_hash(head->hash, gains, sizeof(gains));
+      piece->fused_into = true;
+      return;
+    }
+
+    float g[4];
+    if(!module->raw_gains || blended || !module->raw_gains(module, piece, g))
+      return;
+    for(int c = 0; c < 4; c++)
+      gains[c] *= g[c];
+  }
+}
+
 /* ── _transform_for_blend ────────────────────────────────────────────────── */
 /*
  * Returns true if the blending step needs a colorspace transform.
@@ -353,8 +787,18 @@ static bool _process_on_cpu(dt_dev_pixelpipe_t *pipe,
   const bool fitting = dt_tiling_piece_fits_host_memory(
     piece, m_width, m_height, m_bpp, tiling->factor, tiling->overhead);
 
-  /* Dispatch: tiled or full-buffer */
-  if(!fitting && piece->process_tiling_ready && module->process_tiling)
+  /* Dispatch: fused stage, tiled or full-buffer */
+  if(piece->fused_warp && input_format->channels == 4)
+  {
+    dt_dev_pixelpipe_iop_t *run[DT_WARP_RUN_MAX];
+    const int n = _warp_run(pipe, piece, run);
+    dt_dev_pixelpipe_warp(run, n, input, (float *)*output, roi_in, roi_out);
+  }
+  else if(piece->fused_count > 0 && input_format->channels == 4)
+  {
+    _process_fused_matrix(piece, input, (float *)*output, roi_out);
+  }
+  else if(!fitting && piece->process_tiling_ready && module->process_tiling)
   {
     module->process_tiling(module, piece, input, *output, roi_in, roi_out,
                            (int)in_bpp);
@@ -529,7 +973,11 @@ static bool _process_rec(dt_dev_pixelpipe_t *pipe,
   dt_dev_pixelpipe_iop_t *piece  = &node->piece;
   dt_iop_module_t        *module = piece->module;
 
-  /* Skip disabled / sentinel modules: recurse with this node's predecessor. */
+  /* Params were committed by _commit_pieces() before the recursion, so
+     modify_roi_in() sees current piece->data, and a module can disable
+     itself for this pipe (e.g. flip) and be skipped. */
+
+  /* Skip disabled / sentinel / fused modules: recurse with the predecessor. */
   if(_skip_piece(piece))
   {
     /* Find the predecessor of this node */
@@ -547,12 +995,28 @@ static bool _process_rec(dt_dev_pixelpipe_t *pipe,
   if(dt_pipe_shutdown(pipe))
     return true;
 
-  /* Compute the ROI that this module requires from its predecessor */
-  if(module->modify_roi_in)
+  /* Compute the ROI that this module (or the geometric run it heads)
+     requires from its predecessor */
+  dt_dev_pixelpipe_iop_t *run[DT_WARP_RUN_MAX];
+  const int nrun = _piece_warp(piece) ? _warp_run(pipe, piece, run) : 0;
+
+  if(nrun > 1)
+  {
+    dt_iop_roi_t roi = *roi_out;
+    for(int k = nrun - 1; k >= 0; k--)
+    {
+      run[k]->processed_roi_out = roi;
+      run[k]->module->modify_roi_in(run[k]->module, run[k], &run[k]->processed_roi_out, &roi);
+      run[k]->processed_roi_in = roi;
+    }
+    roi_in = roi;
+  }
+  else if(module->modify_roi_in)
     module->modify_roi_in(module, piece, roi_out, &roi_in);
 
   piece->processed_roi_in  = roi_in;
-  piece->processed_roi_out = *roi_out;
+  if(nrun <= 1)
+    piece->processed_roi_out = *roi_out;
 
   /* Recurse to obtain input */
   void *input        = NULL;
@@ -584,6 +1048,15 @@ static bool _process_rec(dt_dev_pixelpipe_t *pipe,
 
   **out_format = pipe->dsc = piece->dsc_out;
 
+  /* A geometric piece or run that is a pure ROI change hands its input on */
+  if(nrun > 0 && in_bpp == 4 * sizeof(float)
+     && dt_iop_buffer_dsc_to_bpp(*out_format) == in_bpp
+     && _warp_is_identity(run, nrun, &roi_in, roi_out))
+  {
+    *output = input;
+    return dt_pipe_shutdown(pipe);
+  }
+
   /* Allocate output buffer — sized using the POST-output_format bpp */
   const size_t bpp     = dt_iop_buffer_dsc_to_bpp(*out_format);
   const size_t bufsize = (size_t)bpp * roi_out->width * roi_out->height;
@@ -644,12 +1117,6 @@ static bool _process_rec(dt_dev_pixelpipe_t *pipe,
 
   piece->module->position = pos;
 
-  /* ── Commit params ───────────────────────────────────────────────────── */
-  /* Call commit_params() to copy/transform module->params into piece->data.
-     This must happen before process() so piece->data reflects current params. */
-  if(module->commit_params)
-    module->commit_params(module, module->params, pipe, piece);
-
   /* ── CPU processing ──────────────────────────────────────────────────── */
   if(_process_on_cpu(pipe, (float *)input, input_format, &roi_in,
                      output, out_format, roi_out,
@@ -662,6 +1129,45 @@ static bool _process_rec(dt_dev_pixelpipe_t *pipe,
   return dt_pipe_shutdown(pipe);
 }
 
+/* ── _update_dimensions ──────────────────────────────────────────────────── */
+
+/* Forward walk over committed pieces: sets buf_in / buf_out of each. */
+static void _update_dimensions(dt_dev_pixelpipe_t *pipe,
+                               int width_in, int height_in,
+                               int *width_out, int *height_out)
+{
+  dt_iop_roi_t roi_in  = { 0, 0, width_in, height_in, 1.0f };
+  dt_iop_roi_t roi_out = roi_in;
+
+  _pipe_node_t *node = (_pipe_node_t *)pipe->nodes;
+  while(node)
+  {
+    dt_dev_pixelpipe_iop_t *piece  = &node->piece;
+    dt_iop_module_t        *module = piece->module;
+
+    piece->buf_in = roi_in;
+
+    if(!_skip_piece(piece))
+    {
+      if(module->modify_roi_out)
+        module->modify_roi_out(module, piece, &roi_out, &roi_in);
+      else
+        dt_iop_default_modify_roi_out(module, piece, &roi_out, &roi_in);
+    }
+    else
+    {
+      roi_out = roi_in;
+    }
+
+    piece->buf_out = roi_out;
+    roi_in = roi_out;
+    node = node->next;
+  }
+
+  if(width_out)  *width_out  = roi_out.width;
+  if(height_out) *height_out = roi_out.height;
+}
+
 /* ── dt_dev_pixelpipe_process ────────────────────────────────────────────── */
 
 /**
@@ -725,6 +1231,14 @@ bool dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
     }
   }
 
+  /* Commit every piece, size every buffer, then plan stage fusion */
+  _commit_pieces(pipe);
+  _update_dimensions(pipe, pipe->iwidth, pipe->iheight, NULL, NULL);
+  _plan_formats(pipe, out_format);
+  _plan_matrix_fusion(pipe);
+  _plan_warp_fusion(pipe);
+  _plan_raw_fusion(pipe);
+
   /* Run the recursive processing engine */
   const bool err = _process_rec(pipe, &buf, &out_format, &roi, tail, pos);
 
@@ -771,44 +1285,15 @@ bool dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
 
 /**
  * Compute the output dimensions of the pipeline for a given input size.
- * Walks the node list forward, calling modify_roi_out() on each active module.
+ * Commits every piece, then walks the node list forward, calling
+ * modify_roi_out() on each active module.
  */
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
                                      int width_in, int height_in,
                                      int *width_out, int *height_out)
 {
   dt_pthread_mutex_lock(&pipe->mutex);
-
-  dt_iop_roi_t roi_in  = { 0, 0, width_in, height_in, 1.0f };
-  dt_iop_roi_t roi_out = roi_in;
-
-  _pipe_node_t *node = (_pipe_node_t *)pipe->nodes;
-  while(node)
-  {
-    dt_dev_pixelpipe_iop_t *piece  = &node->piece;
-    dt_iop_module_t        *module = piece->module;
-
-    piece->buf_in = roi_in;
-
-    if(!_skip_piece(piece))
-    {
-      if(module->modify_roi_out)
-        module->modify_roi_out(module, piece, &roi_out, &roi_in);
-      else
-        dt_iop_default_modify_roi_out(module, piece, &roi_out, &roi_in);
-    }
-    else
-    {
-      roi_out = roi_in;
-    }
-
-    piece->buf_out = roi_out;
-    roi_in = roi_out;
-    node = node->next;
-  }
-
-  *width_out  = roi_out.width;
-  *height_out = roi_out.height;
-
+  _commit_pieces(pipe);
+  _update_dimensions(pipe, width_in, height_in, width_out, height_out);
   dt_pthread_mutex_unlock(&pipe->mutex);
 }
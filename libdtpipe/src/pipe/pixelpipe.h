@@ -104,7 +104,8 @@ bool dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe,
  * Compute the output dimensions of the pipeline for a given input size.
  * Useful to size the output buffer before calling process().
  *
- * Walks the node list applying modify_roi_out() on each enabled module.
+ * Commits every piece, then walks the node list applying modify_roi_out()
+ * on each enabled module.
  */
 void dt_dev_pixelpipe_get_dimensions(dt_dev_pixelpipe_t *pipe,
                                      int width_in, int height_in,
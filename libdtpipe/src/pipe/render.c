@@ -165,7 +165,8 @@ static uint8_t *_float_to_u8_rgba(const float *src, int W, int H)
  *
  * @param pipe       Public pipeline handle.
  * @param x, y       Top-left corner of the ROI in full-resolution coords.
- * @param w, h       Dimensions of the ROI in full-resolution pixels.
+ * @param w, h       Dimensions of the ROI in full-resolution pixels; 0 means
+ *                   the whole pipeline output (after crops and rotations).
  * @param scale      Output scale (1.0 = 1:1 mapping of the ROI).
  */
 static dt_render_result_t *_do_render(dt_pipe_t *pipe,
@@ -200,6 +201,9 @@ static dt_render_result_t *_do_render(dt_pipe_t *pipe,
                              1.0f,      /* iscale: input is full resolution */
                              pipe->img);
 
+  if(w <= 0 || h <= 0)
+    dt_dev_pixelpipe_get_dimensions(&pipe->pipe, full_w, full_h, &w, &h);
+
   /* Output dimensions */
   const int out_w = (int)((float)w * scale);
   const int out_h = (int)((float)h * scale);
@@ -261,8 +265,7 @@ dt_render_result_t *dtpipe_render(dt_pipe_t *pipe, float scale)
 
   return _do_render(pipe,
                     0, 0,                          /* full image origin */
-                    pipe->input_width,
-                    pipe->input_height,
+                    0, 0,                          /* full pipeline output */
                     scale);
 }
 
@@ -0,0 +1,189 @@
+/*
+ * test_curve_lut.c
+ *
+ * Internal unit test for the log-domain tone curve tables in
+ * src/common/curve_lut.c (dt_curve_lut_init / dt_curve_lut_eval).
+ *
+ * Checks, on a sigmoid-like and a filmic-like (log + power) curve:
+ *   1. The table matches the curve to 1e-4 relative over its whole range.
+ *   2. Nodes are reproduced exactly.
+ *   3. Inputs below the range lerp to fn(0); negatives and NaN give fn(0).
+ *   4. Inputs above the range clamp to fn(hi).
+ *   5. Spans wider than DT_CURVE_LUT_MAX_OCTAVES keep the top of the range.
+ *
+ * No image file is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/curve_lut.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+/* generalized log-logistic, as in sigmoid.c with default params */
+static float _sigmoid(const float x, const void *data)
+{
+  const float contrast = 1.5f;
+  const float white = 1.0f;
+  const float fog = 0.0001f;
+  const float paper = 0.18f;
+  const float clamped = fmaxf(x, 0.0f);
+  return white * powf(clamped / (clamped + paper * powf(fmaxf(clamped, 1e-9f) / paper, 1.0f - contrast) + fog),
+                      contrast);
+}
+
+/* log encoding over [-8, +4] EV around 0.1845, smoothstep, power 4 */
+static float _filmic(const float x, const void *data)
+{
+  float t = (log2f(fmaxf(x, 1e-9f) / 0.1845f) + 8.0f) / 12.0f;
+  t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+  const float s = t * t * (3.0f - 2.0f * t);
+  return powf(s, 4.0f);
+}
+
+static float _max_rel_error(const dt_curve_lut_t *lut, dt_curve_lut_func_t fn)
+{
+  float worst = 0.0f;
+  /* 37 samples per node, spread over the whole table */
+  for(uint32_t i = 0; i + 1 < lut->n; i++)
+    for(int j = 0; j < 37; j++)
+    {
+      const float x = lut->lo * exp2f(((float)i + (float)j / 37.0f) / DT_CURVE_LUT_STEPS);
+      const float ref = fn(x, NULL);
+      const float got = dt_curve_lut_eval(lut, x);
+      const float err = fabsf(got - ref) / fmaxf(fabsf(ref), 1e-3f);
+      if(err > worst) worst = err;
+    }
+  return worst;
+}
+
+/* ── Test 1: accuracy ────────────────────────────────────────────────────── */
+
+static void test_accuracy(void)
+{
+  printf("\n--- Test 1: accuracy ---\n");
+
+  dt_curve_lut_t *lut = dt_calloc1_align_type(dt_curve_lut_t);
+
+  dt_curve_lut_init(lut, -20, 16, _sigmoid, NULL);
+  const float e1 = _max_rel_error(lut, _sigmoid);
+  printf("  sigmoid max relative error %g\n", e1);
+  CHECK(e1 < 1e-4f, "sigmoid curve within 1e-4");
+
+  dt_curve_lut_init(lut, -12, 4, _filmic, NULL);
+  const float e2 = _max_rel_error(lut, _filmic);
+  printf("  filmic max relative error %g\n", e2);
+  CHECK(e2 < 1e-4f, "filmic curve within 1e-4");
+
+  dt_free_align(lut);
+}
+
+/* ── Test 2: nodes are exact ─────────────────────────────────────────────── */
+
+static void test_nodes(void)
+{
+  printf("\n--- Test 2: exact nodes ---\n");
+
+  dt_curve_lut_t *lut = dt_calloc1_align_type(dt_curve_lut_t);
+  dt_curve_lut_init(lut, -10, 6, _sigmoid, NULL);
+
+  int exact = 1;
+  for(int e = -10; e < 6; e++)
+  {
+    const float x = ldexpf(1.0f, e);
+    if(dt_curve_lut_eval(lut, x) != _sigmoid(x, NULL)) exact = 0;
+  }
+  CHECK(exact, "powers of two hit table nodes exactly");
+  CHECK(lut->n == 16 * DT_CURVE_LUT_STEPS + 1, "node count is octaves * steps + 1");
+
+  dt_free_align(lut);
+}
+
+/* ── Test 3: out-of-range inputs ─────────────────────────────────────────── */
+
+static void test_range(void)
+{
+  printf("\n--- Test 3: out-of-range inputs ---\n");
+
+  dt_curve_lut_t *lut = dt_calloc1_align_type(dt_curve_lut_t);
+  dt_curve_lut_init(lut, -12, 4, _filmic, NULL);
+
+  const float y0 = _filmic(0.0f, NULL);
+  CHECK(dt_curve_lut_eval(lut, 0.0f) == y0, "0 maps to fn(0)");
+  CHECK(dt_curve_lut_eval(lut, -3.0f) == y0, "negative maps to fn(0)");
+  CHECK(dt_curve_lut_eval(lut, NAN) == y0, "NaN maps to fn(0)");
+
+  const float mid = 0.5f * lut->lo;
+  const float expect = 0.5f * (y0 + lut->y[0]);
+  CHECK(fabsf(dt_curve_lut_eval(lut, mid) - expect) < 1e-6f, "below lo lerps towards fn(0)");
+
+  const float top = _filmic(lut->hi, NULL);
+  CHECK(dt_curve_lut_eval(lut, lut->hi) == top, "hi maps to fn(hi)");
+  CHECK(dt_curve_lut_eval(lut, 1e30f) == top, "far above hi clamps");
+  CHECK(dt_curve_lut_eval(lut, INFINITY) == top, "+inf clamps");
+
+  dt_aligned_pixel_t in = { 0.01f, 0.1845f, 2.0f, 1.0f };
+  dt_aligned_pixel_t out = { 0.0f, 0.0f, 0.0f, -1.0f };
+  dt_curve_lut_eval_rgb(lut, in, out);
+  CHECK(out[0] == dt_curve_lut_eval(lut, in[0]) && out[1] == dt_curve_lut_eval(lut, in[1])
+        && out[2] == dt_curve_lut_eval(lut, in[2]) && out[3] == -1.0f,
+        "eval_rgb maps three channels and leaves alpha");
+
+  dt_free_align(lut);
+}
+
+/* ── Test 4: span clamping ───────────────────────────────────────────────── */
+
+static void test_span(void)
+{
+  printf("\n--- Test 4: span clamping ---\n");
+
+  dt_curve_lut_t *lut = dt_calloc1_align_type(dt_curve_lut_t);
+  dt_curve_lut_init(lut, -100, 10, _sigmoid, NULL);
+
+  CHECK(lut->hi == ldexpf(1.0f, 10), "hi kept");
+  CHECK(lut->lo == ldexpf(1.0f, 10 - DT_CURVE_LUT_MAX_OCTAVES), "lo raised to max span");
+  CHECK(lut->n == DT_CURVE_LUT_MAX_SIZE, "table full");
+
+  dt_free_align(lut);
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_curve_lut ===\n");
+
+  test_accuracy();
+  test_nodes();
+  test_range();
+  test_span();
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * test_geometry.c
+ *
+ * Internal unit test for the geometric modules (src/iop/flip.c,
+ * src/iop/crop.c) and the composed warp in src/pipe/pixelpipe.c.
+ *
+ * Checks, on a synthetic RGBA buffer:
+ *   1. flip process() is a lossless remap for all seven orientations, and
+ *      dt_dev_pixelpipe_warp() through its point map gives the same bits.
+ *   2. crop asks for the shifted window of the same size, so a warp
+ *      through it is a plain copy of the cropped rows.
+ *   3. flip followed by crop, folded into one warp, matches running the
+ *      two modules one after the other.
+ *
+ * The modules are driven through their init_global hooks, no image file
+ * is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void dt_iop_flip_init_global(dt_iop_module_so_t *so);
+void dt_iop_crop_init_global(dt_iop_module_so_t *so);
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+/* Layouts match _flip_params_t and _crop_params_t in src/pipe/params.c. */
+typedef struct { int32_t orientation; } _flip_params_t;
+typedef struct { float cx, cy, cw, ch; int ratio_n, ratio_d; } _crop_params_t;
+
+static dt_dev_pixelpipe_t g_pipe;
+
+/* Every pixel carries its own coordinates, so any misplaced read shows. */
+static float *_make_rgba(const int wd, const int ht)
+{
+  float *buf = dt_alloc_align_float((size_t)4 * wd * ht);
+  if(!buf) return NULL;
+  for(int j = 0; j < ht; j++)
+    for(int i = 0; i < wd; i++)
+    {
+      float *px = buf + (size_t)4 * (j * wd + i);
+      px[0] = (float)i;
+      px[1] = (float)j;
+      px[2] = (float)(i * 7 + j * 3);
+      px[3] = 1.0f;
+    }
+  return buf;
+}
+
+/* Module and piece wired the way create.c does it, with committed params. */
+static void _setup(dt_iop_module_so_t *so,
+                   dt_iop_module_t *m,
+                   dt_dev_pixelpipe_iop_t *piece,
+                   void *params,
+                   const dt_iop_roi_t *buf_in)
+{
+  memset(m, 0, sizeof(*m));
+  memset(piece, 0, sizeof(*piece));
+  m->so                    = so;
+  m->process_plain         = so->process_plain;
+  m->init_pipe             = so->init_pipe;
+  m->cleanup_pipe          = so->cleanup_pipe;
+  m->commit_params         = so->commit_params;
+  m->modify_roi_in         = so->modify_roi_in;
+  m->modify_roi_out        = so->modify_roi_out;
+  m->distort_transform     = so->distort_transform;
+  m->distort_backtransform = so->distort_backtransform;
+  m->enabled               = true;
+
+  piece->module  = m;
+  piece->pipe    = &g_pipe;
+  piece->colors  = 4;
+  piece->enabled = true;
+  m->init_pipe(m, &g_pipe, piece);
+  m->commit_params(m, params, &g_pipe, piece);
+  piece->buf_in = *buf_in;
+  m->modify_roi_out(m, piece, &piece->buf_out, buf_in);
+}
+
+static void _teardown(dt_iop_module_t *m, dt_dev_pixelpipe_iop_t *piece)
+{
+  m->cleanup_pipe(m, &g_pipe, piece);
+}
+
+/* ── Test 1: flip ────────────────────────────────────────────────────────── */
+
+static void test_flip(void)
+{
+  printf("\n--- Test 1: flip remap and point map ---\n");
+
+  const int wd = 37, ht = 23;
+  const dt_iop_roi_t full = { 0, 0, wd, ht, 1.0f };
+  float *in = _make_rgba(wd, ht);
+  float *a = dt_alloc_align_float((size_t)4 * wd * ht);
+  float *b = dt_alloc_align_float((size_t)4 * wd * ht);
+  CHECK(in && a && b, "buffers allocated");
+  if(!in || !a || !b) goto done;
+
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_flip_init_global(&so);
+
+  bool all_exact = true, all_same = true, all_dims = true;
+  for(int o = 1; o < 8; o++)
+  {
+    dt_iop_module_t m;
+    dt_dev_pixelpipe_iop_t piece;
+    _flip_params_t p = { o };
+    _setup(&so, &m, &piece, &p, &full);
+
+    const dt_iop_roi_t roi_out = piece.buf_out;
+    dt_iop_roi_t roi_in;
+    m.modify_roi_in(&m, &piece, &roi_out, &roi_in);
+    if(roi_in.x != 0 || roi_in.y != 0 || roi_in.width != wd || roi_in.height != ht)
+      all_dims = false;
+
+    m.process_plain(&m, &piece, in, a, &roi_in, &roi_out);
+    dt_dev_pixelpipe_warp((dt_dev_pixelpipe_iop_t *const[]){ &piece }, 1,
+                          in, b, &roi_in, &roi_out);
+    if(memcmp(a, b, sizeof(float) * 4 * wd * ht)) all_same = false;
+
+    // every output pixel must be an input pixel, exactly
+    for(int j = 0; j < roi_out.height && all_exact; j++)
+      for(int i = 0; i < roi_out.width; i++)
+      {
+        const float *px = a + (size_t)4 * (j * roi_out.width + i);
+        const int si = (int)px[0], sj = (int)px[1];
+        if(si < 0 || sj < 0 || si >= wd || sj >= ht
+           || memcmp(px, in + (size_t)4 * (sj * wd + si), 4 * sizeof(float)))
+        {
+          all_exact = false;
+          break;
+        }
+      }
+    _teardown(&m, &piece);
+  }
+  CHECK(all_dims, "modify_roi_in asks for the whole input");
+  CHECK(all_exact, "process() is a lossless remap for all orientations");
+  CHECK(all_same, "warp through the point map matches process() bit for bit");
+
+  // rotate 90° CCW: output (0, 0) is the input top-right corner
+  {
+    dt_iop_module_t m;
+    dt_dev_pixelpipe_iop_t piece;
+    _flip_params_t p = { ORIENTATION_ROTATE_CCW_90_DEG };
+    _setup(&so, &m, &piece, &p, &full);
+    CHECK(piece.buf_out.width == ht && piece.buf_out.height == wd,
+          "swapping orientation swaps the output size");
+    const dt_iop_roi_t roi_out = piece.buf_out;
+    dt_iop_roi_t roi_in;
+    m.modify_roi_in(&m, &piece, &roi_out, &roi_in);
+    m.process_plain(&m, &piece, in, a, &roi_in, &roi_out);
+    CHECK(a[0] == (float)(wd - 1) && a[1] == 0.0f, "rotation maps the right corner");
+    _teardown(&m, &piece);
+  }
+
+done:
+  dt_free_align(in);
+  dt_free_align(a);
+  dt_free_align(b);
+}
+
+/* ── Test 2: crop ────────────────────────────────────────────────────────── */
+
+static void test_crop(void)
+{
+  printf("\n--- Test 2: crop is a shifted window ---\n");
+
+  const int wd = 64, ht = 48;
+  const dt_iop_roi_t full = { 0, 0, wd, ht, 1.0f };
+  float *in = _make_rgba(wd, ht);
+  float *a = dt_alloc_align_float((size_t)4 * wd * ht);
+  float *b = dt_alloc_align_float((size_t)4 * wd * ht);
+  CHECK(in && a && b, "buffers allocated");
+  if(!in || !a || !b) goto done;
+
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_crop_init_global(&so);
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  _crop_params_t p = { 0.25f, 0.125f, 0.75f, 0.875f, -1, -1 };
+  _setup(&so, &m, &piece, &p, &full);
+
+  const dt_iop_roi_t roi_out = piece.buf_out;
+  CHECK(roi_out.width == 32 && roi_out.height == 36, "output is the crop box");
+
+  // the window the pipe reads from: shifted, same size
+  dt_iop_roi_t roi_in;
+  m.modify_roi_in(&m, &piece, &roi_out, &roi_in);
+  CHECK(roi_in.x == 16 && roi_in.y == 6, "roi_in starts at the crop offset");
+  CHECK(roi_in.width == roi_out.width && roi_in.height == roi_out.height,
+        "roi_in keeps the output size");
+
+  // the pipe hands over the window as its own buffer
+  for(int j = 0; j < roi_in.height; j++)
+    memcpy(a + (size_t)4 * j * roi_in.width,
+           in + (size_t)4 * ((j + roi_in.y) * wd + roi_in.x),
+           sizeof(float) * 4 * roi_in.width);
+  dt_dev_pixelpipe_warp((dt_dev_pixelpipe_iop_t *const[]){ &piece }, 1,
+                        a, b, &roi_in, &roi_out);
+  CHECK(!memcmp(a, b, sizeof(float) * 4 * roi_out.width * roi_out.height),
+        "warp through the crop is an exact copy");
+  CHECK(b[0] == 16.0f && b[1] == 6.0f, "first pixel is the crop corner");
+
+  _teardown(&m, &piece);
+
+done:
+  dt_free_align(in);
+  dt_free_align(a);
+  dt_free_align(b);
+}
+
+/* ── Test 3: flip + crop in one warp ─────────────────────────────────────── */
+
+static void test_fused(void)
+{
+  printf("\n--- Test 3: flip and crop folded into one warp ---\n");
+
+  const int wd = 53, ht = 31;
+  const dt_iop_roi_t full = { 0, 0, wd, ht, 1.0f };
+  float *in = _make_rgba(wd, ht);
+  float *flipped = dt_alloc_align_float((size_t)4 * wd * ht);
+  float *a = dt_alloc_align_float((size_t)4 * wd * ht);
+  float *b = dt_alloc_align_float((size_t)4 * wd * ht);
+  CHECK(in && flipped && a && b, "buffers allocated");
+  if(!in || !flipped || !a || !b) goto done;
+
+  dt_iop_module_so_t fso = { 0 }, cso = { 0 };
+  dt_iop_flip_init_global(&fso);
+  dt_iop_crop_init_global(&cso);
+
+  bool all_same = true;
+  for(int o = 1; o < 8; o++)
+  {
+    dt_iop_module_t fm, cm;
+    dt_dev_pixelpipe_iop_t fp, cp;
+    _flip_params_t f = { o };
+    _crop_params_t c = { 0.1f, 0.2f, 0.8f, 0.9f, -1, -1 };
+    _setup(&fso, &fm, &fp, &f, &full);
+    _setup(&cso, &cm, &cp, &c, &fp.buf_out);
+
+    // two passes: flip the whole image, then crop the flipped rows
+    const dt_iop_roi_t froi_out = fp.buf_out;
+    dt_iop_roi_t froi_in;
+    fm.modify_roi_in(&fm, &fp, &froi_out, &froi_in);
+    fm.process_plain(&fm, &fp, in, flipped, &froi_in, &froi_out);
+
+    const dt_iop_roi_t roi_out = cp.buf_out;
+    dt_iop_roi_t croi_in;
+    cm.modify_roi_in(&cm, &cp, &roi_out, &croi_in);
+    for(int j = 0; j < roi_out.height; j++)
+      memcpy(a + (size_t)4 * j * roi_out.width,
+             flipped + (size_t)4 * ((j + croi_in.y) * froi_out.width + croi_in.x),
+             sizeof(float) * 4 * roi_out.width);
+
+    // one pass: both point maps composed over the unflipped input
+    dt_iop_roi_t roi_in;
+    fm.modify_roi_in(&fm, &fp, &croi_in, &roi_in);
+    const float *src = in + (size_t)4 * (roi_in.y * wd + roi_in.x);
+    float *win = flipped;
+    for(int j = 0; j < roi_in.height; j++)
+      memcpy(win + (size_t)4 * j * roi_in.width, src + (size_t)4 * j * wd,
+             sizeof(float) * 4 * roi_in.width);
+    dt_dev_pixelpipe_warp((dt_dev_pixelpipe_iop_t *const[]){ &fp, &cp }, 2,
+                          win, b, &roi_in, &roi_out);
+
+    if(memcmp(a, b, sizeof(float) * 4 * roi_out.width * roi_out.height))
+      all_same = false;
+
+    _teardown(&cm, &cp);
+    _teardown(&fm, &fp);
+  }
+  CHECK(all_same, "composed warp matches flip then crop for all orientations");
+
+done:
+  dt_free_align(in);
+  dt_free_align(flipped);
+  dt_free_align(a);
+  dt_free_align(b);
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_geometry ===\n");
+
+  test_flip();
+  test_crop();
+  test_fused();
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
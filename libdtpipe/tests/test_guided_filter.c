@@ -0,0 +1,375 @@
+/*
+ * test_guided_filter.c
+ *
+ * Internal unit test for the row-streamed guided filter and EIGF,
+ * src/common/fast_guided_filter.c.
+ *
+ * Checks, on synthetic grey guides:
+ *   1. A constant guide comes out unchanged from both filters.
+ *   2. One iteration of the guided filter matches darktable's
+ *      fast_surface_blur() pipeline run on a full-resolution buffer
+ *      (downsample, quantize, box variance analysis, upsample, blend).
+ *   3. Same for the EIGF with mask quantization (fast_eigf_surface_blur()).
+ *   4. The low-resolution state and the peak working memory stay below one
+ *      full-resolution grey mask for a 24 Mpx image.
+ *
+ * No image file is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/fast_guided_filter.h"
+#include "common/gaussian.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+#define MIN_FLOAT exp2f(-16.0f)
+
+typedef struct _guide_t
+{
+  const float *buf;
+  int width;
+} _guide_t;
+
+static void _guide_row(const void *data, const int row, float *const out)
+{
+  const _guide_t *g = data;
+  memcpy(out, g->buf + (size_t)row * g->width, sizeof(float) * g->width);
+}
+
+/* Luminance-like test pattern in [2^-10, 1]: smooth gradient plus edges. */
+static float *_make_guide(const int wd, const int ht)
+{
+  float *buf = dt_alloc_align_float((size_t)wd * ht);
+  if(!buf) return NULL;
+  for(int j = 0; j < ht; j++)
+    for(int i = 0; i < wd; i++)
+    {
+      const float ev = -5.0f + 3.0f * sinf(i * 0.017f) * cosf(j * 0.011f)
+                       + (((i / 23) + (j / 17)) & 1 ? 1.5f : -1.5f);
+      buf[(size_t)j * wd + i] = exp2f(ev);
+    }
+  return buf;
+}
+
+/* darktable's interpolate_bilinear() */
+static void _ref_bilinear(const float *in, const int w_in, const int h_in,
+                          float *out, const int w_out, const int h_out, const int ch)
+{
+  for(int i = 0; i < h_out; i++)
+    for(int j = 0; j < w_out; j++)
+    {
+      const float y_in = ((float)i / (float)h_out) * (float)h_in;
+      const float x_in = ((float)j / (float)w_out) * (float)w_in;
+      const int y_prev = MIN((int)floorf(y_in), h_in - 1);
+      const int x_prev = MIN((int)floorf(x_in), w_in - 1);
+      const int y_next = MIN((int)floorf(y_in) + 1, h_in - 1);
+      const int x_next = MIN((int)floorf(x_in) + 1, w_in - 1);
+      const float Dy_next = (float)y_next - y_in;
+      const float Dx_next = (float)x_next - x_in;
+      const float Dy_prev = 1.f - Dy_next;
+      const float Dx_prev = 1.f - Dx_next;
+      for(int c = 0; c < ch; c++)
+      {
+        const float Q_NW = in[((size_t)y_prev * w_in + x_prev) * ch + c];
+        const float Q_NE = in[((size_t)y_prev * w_in + x_next) * ch + c];
+        const float Q_SE = in[((size_t)y_next * w_in + x_next) * ch + c];
+        const float Q_SW = in[((size_t)y_next * w_in + x_prev) * ch + c];
+        out[((size_t)i * w_out + j) * ch + c]
+            = Dy_prev * (Q_SW * Dx_next + Q_SE * Dx_prev) + Dy_next * (Q_NW * Dx_next + Q_NE * Dx_prev);
+      }
+    }
+}
+
+/* box average over the window clipped to the image, as dt_box_mean() */
+static void _ref_box_mean(float *buf, const int w, const int h, const int ch, const int r)
+{
+  float *tmp = malloc(sizeof(float) * w * h * ch);
+  for(int i = 0; i < h; i++)
+    for(int j = 0; j < w; j++)
+      for(int c = 0; c < ch; c++)
+      {
+        double sum = 0.0;
+        int n = 0;
+        for(int ii = MAX(0, i - r); ii <= MIN(h - 1, i + r); ii++)
+          for(int jj = MAX(0, j - r); jj <= MIN(w - 1, j + r); jj++, n++)
+            sum += buf[((size_t)ii * w + jj) * ch + c];
+        tmp[((size_t)i * w + j) * ch + c] = sum / n;
+      }
+  memcpy(buf, tmp, sizeof(float) * w * h * ch);
+  free(tmp);
+}
+
+static float _ref_quantize(const float v, const float q)
+{
+  if(q == 0.0f) return v;
+  return fmaxf(fminf(exp2f(floorf(log2f(v) / q) * q), 4.0f), exp2f(-14.0f));
+}
+
+/* fast_surface_blur(), one iteration, linear blending */
+static void _ref_guided(float *image, const int w, const int h, const int radius,
+                        const float feathering, const float quantization)
+{
+  const int ds_w = w / 4, ds_h = h / 4;
+  const int ds_radius = (radius < 4) ? 1 : radius / 4;
+  const size_t n = (size_t)ds_w * ds_h;
+  float *ds_image = malloc(sizeof(float) * n);
+  float *ab = malloc(sizeof(float) * 2 * n);
+  float *var = malloc(sizeof(float) * 4 * n);
+  float *ab_full = malloc(sizeof(float) * 2 * w * h);
+
+  _ref_bilinear(image, w, h, ds_image, ds_w, ds_h, 1);
+  for(size_t k = 0; k < n; k++)
+  {
+    const float g = _ref_quantize(ds_image[k], quantization), m = ds_image[k];
+    var[4 * k] = g;
+    var[4 * k + 1] = m;
+    var[4 * k + 2] = g * g;
+    var[4 * k + 3] = g * m;
+  }
+  _ref_box_mean(var, ds_w, ds_h, 4, ds_radius);
+  for(size_t k = 0; k < n; k++)
+  {
+    const float d = fmaxf((var[4*k+2] - var[4*k] * var[4*k]) + feathering, 1e-15f);
+    const float a = (var[4*k+3] - var[4*k] * var[4*k+1]) / d;
+    ab[2 * k] = a;
+    ab[2 * k + 1] = var[4*k+1] - a * var[4*k];
+  }
+  _ref_box_mean(ab, ds_w, ds_h, 2, ds_radius);
+  _ref_bilinear(ab, ds_w, ds_h, ab_full, w, h, 2);
+  for(size_t k = 0; k < (size_t)w * h; k++)
+    image[k] = fmaxf(image[k] * ab_full[2 * k] + ab_full[2 * k + 1], MIN_FLOAT);
+
+  free(ds_image);
+  free(ab);
+  free(var);
+  free(ab_full);
+}
+
+/* fast_eigf_surface_blur() with quantization, one iteration, linear blending */
+static void _ref_eigf(float *image, const int w, const int h, const float sigma,
+                      const float feathering, const float quantization)
+{
+  const float scaling = fmaxf(fminf(sigma, 4.0f), 1.0f);
+  const float ds_sigma = fmaxf(sigma / scaling, 1.0f);
+  const int ds_w = w / scaling, ds_h = h / scaling;
+  const size_t n = (size_t)ds_w * ds_h, N = (size_t)w * h;
+  float *mask = malloc(sizeof(float) * N);
+  float *ds_image = malloc(sizeof(float) * n);
+  float *ds_mask = malloc(sizeof(float) * n);
+  float *in = dt_alloc_align_float(4 * n);
+  float *av = dt_alloc_align_float(4 * n);
+  float *av_full = malloc(sizeof(float) * 4 * N);
+
+  for(size_t k = 0; k < N; k++) mask[k] = _ref_quantize(image[k], quantization);
+  _ref_bilinear(image, w, h, ds_image, ds_w, ds_h, 1);
+  _ref_bilinear(mask, w, h, ds_mask, ds_w, ds_h, 1);
+
+  dt_aligned_pixel_t mx = { 0.0f }, mn = { 1e7f, 1e7f, 1e7f, 1e7f };
+  for(size_t k = 0; k < n; k++)
+  {
+    const float g = ds_mask[k], m = ds_image[k];
+    const float px[4] = { g, g * g, m, m * g };
+    for(int c = 0; c < 4; c++)
+    {
+      in[4 * k + c] = px[c];
+      mx[c] = fmaxf(mx[c], px[c]);
+      mn[c] = fminf(mn[c], px[c]);
+    }
+  }
+  dt_gaussian_t *g = dt_gaussian_init(ds_w, ds_h, 4, mx, mn, ds_sigma, 0);
+  dt_gaussian_blur_4c(g, in, av);
+  dt_gaussian_free(g);
+  for(size_t k = 0; k < n; k++)
+  {
+    av[4 * k + 1] -= av[4 * k] * av[4 * k];
+    av[4 * k + 3] -= av[4 * k] * av[4 * k + 2];
+  }
+  _ref_bilinear(av, ds_w, ds_h, av_full, w, h, 4);
+  for(size_t k = 0; k < N; k++)
+  {
+    const float *p = av_full + 4 * k;
+    const float norm_g = fmaxf(p[0] * image[k], 1E-6);
+    const float norm_m = fmaxf(p[2] * mask[k], 1E-6);
+    const float a = (p[3] / sqrtf(norm_g * norm_m)) / (p[1] / norm_g + feathering);
+    const float b = p[2] - a * p[0];
+    image[k] = fmaxf(image[k] * a + b, MIN_FLOAT);
+  }
+
+  free(mask);
+  free(ds_image);
+  free(ds_mask);
+  dt_free_align(in);
+  dt_free_align(av);
+  free(av_full);
+}
+
+/* runs the row-streamed filter over a whole buffer, in place */
+static int _filter(float *image, const int w, const int h, dt_guided_filter_t *g)
+{
+  _guide_t src = { image, w };
+  if(!dt_guided_filter_analyse(g, _guide_row, &src)) return 0;
+  float *scratch = dt_alloc_align_float(dt_guided_filter_scratch_size(g));
+  for(int i = 0; i < h; i++)
+    dt_guided_filter_blend_row(g, i, image + (size_t)i * w, scratch);
+  dt_free_align(scratch);
+  return 1;
+}
+
+static float _max_rel_error(const float *a, const float *b, const size_t n)
+{
+  float err = 0.0f;
+  for(size_t k = 0; k < n; k++)
+    err = fmaxf(err, fabsf(a[k] - b[k]) / fmaxf(fabsf(b[k]), 1e-6f));
+  return err;
+}
+
+/* ── Test 1: constant guide ──────────────────────────────────────────────── */
+
+static void test_constant(void)
+{
+  printf("\n--- Test 1: constant guide ---\n");
+
+  const int wd = 203, ht = 151;
+  float *img = dt_alloc_align_float((size_t)wd * ht);
+  CHECK(img != NULL, "buffer allocated");
+  if(!img) return;
+
+  for(int type = DT_GF_GUIDED; type <= DT_GF_EIGF; type++)
+  {
+    for(size_t k = 0; k < (size_t)wd * ht; k++) img[k] = 0.125f;
+    dt_guided_filter_t *g = dt_guided_filter_init(wd, ht, type, 12.0f, 1.0f, 3,
+                                                  DT_GF_BLENDING_LINEAR, 0.0f,
+                                                  exp2f(-14.0f), 4.0f);
+    CHECK(g && _filter(img, wd, ht, g), "filter ran");
+    float err = 0.0f;
+    for(size_t k = 0; k < (size_t)wd * ht; k++) err = fmaxf(err, fabsf(img[k] - 0.125f));
+    CHECK(err < 1e-5f, type == DT_GF_GUIDED ? "guided filter keeps a constant guide"
+                                            : "EIGF keeps a constant guide");
+    dt_guided_filter_free(g);
+  }
+
+  dt_free_align(img);
+}
+
+/* ── Test 2: guided filter vs. full-resolution reference ─────────────────── */
+
+static void test_guided_reference(void)
+{
+  printf("\n--- Test 2: guided filter matches fast_surface_blur ---\n");
+
+  const int wd = 317, ht = 229;
+  float *img = _make_guide(wd, ht);
+  float *ref = _make_guide(wd, ht);
+  CHECK(img && ref, "buffers allocated");
+  if(!img || !ref) goto done;
+
+  _ref_guided(ref, wd, ht, 20, 0.01f, 1.0f);
+  dt_guided_filter_t *g = dt_guided_filter_init(wd, ht, DT_GF_GUIDED, 20.0f, 0.01f, 1,
+                                                DT_GF_BLENDING_LINEAR, 1.0f,
+                                                exp2f(-14.0f), 4.0f);
+  CHECK(g && _filter(img, wd, ht, g), "filter ran");
+  const float err = _max_rel_error(img, ref, (size_t)wd * ht);
+  printf("  max relative error %g\n", err);
+  CHECK(err < 1e-4f, "row-streamed guided filter matches the full-resolution one");
+  dt_guided_filter_free(g);
+
+done:
+  dt_free_align(img);
+  dt_free_align(ref);
+}
+
+/* ── Test 3: EIGF vs. full-resolution reference ──────────────────────────── */
+
+static void test_eigf_reference(void)
+{
+  printf("\n--- Test 3: EIGF matches fast_eigf_surface_blur ---\n");
+
+  const int wd = 317, ht = 229;
+  float *img = _make_guide(wd, ht);
+  float *ref = _make_guide(wd, ht);
+  CHECK(img && ref, "buffers allocated");
+  if(!img || !ref) goto done;
+
+  _ref_eigf(ref, wd, ht, 14.0f, 1.0f, 0.5f);
+  dt_guided_filter_t *g = dt_guided_filter_init(wd, ht, DT_GF_EIGF, 14.0f, 1.0f, 1,
+                                                DT_GF_BLENDING_LINEAR, 0.5f,
+                                                exp2f(-14.0f), 4.0f);
+  CHECK(g && g->channels == 4, "EIGF with quantization keeps 4 coefficients");
+  CHECK(g && _filter(img, wd, ht, g), "filter ran");
+  const float err = _max_rel_error(img, ref, (size_t)wd * ht);
+  printf("  max relative error %g\n", err);
+  CHECK(err < 1e-4f, "row-streamed EIGF matches the full-resolution one");
+  dt_guided_filter_free(g);
+
+done:
+  dt_free_align(img);
+  dt_free_align(ref);
+}
+
+/* ── Test 4: memory ──────────────────────────────────────────────────────── */
+
+static void test_memory(void)
+{
+  printf("\n--- Test 4: low-resolution state ---\n");
+
+  const int wd = 6000, ht = 4000;
+  const size_t grey = sizeof(float) * wd * ht;
+  const size_t eigf = dt_guided_filter_memory_use(wd, ht, DT_GF_EIGF, 150.0f);
+  const size_t guided = dt_guided_filter_memory_use(wd, ht, DT_GF_GUIDED, 150.0f);
+  printf("  EIGF %.1f MB, guided %.1f MB, grey mask %.1f MB\n",
+         eigf / 1048576.0, guided / 1048576.0, grey / 1048576.0);
+  CHECK(eigf < grey, "EIGF working memory below one full-resolution mask");
+  CHECK(guided < grey, "guided filter working memory below one full-resolution mask");
+
+  dt_guided_filter_t *g = dt_guided_filter_init(wd, ht, DT_GF_EIGF, 150.0f, 1.0f, 1,
+                                                DT_GF_BLENDING_LINEAR, 1.0f,
+                                                exp2f(-14.0f), 4.0f);
+  CHECK(g != NULL, "filter state created");
+  if(g)
+  {
+    const size_t state = sizeof(float) * (size_t)g->ds_width * g->ds_height * g->channels;
+    CHECK(state * 3 < grey, "cached coefficients under a third of a grey mask");
+  }
+  dt_guided_filter_free(g);
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_guided_filter ===\n");
+
+  test_constant();
+  test_guided_reference();
+  test_eigf_reference();
+  test_memory();
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * test_local_contrast.c
+ *
+ * Internal unit test for the two local contrast backends,
+ * src/common/bilateral.c and src/common/locallaplacian.c.
+ *
+ * Checks, on synthetic Lab buffers:
+ *   1. The bilateral splat keeps the whole payload (no contribution is lost
+ *      when the per-thread grid bands are reduced), and detail 0 leaves
+ *      the image unchanged.
+ *   2. dt_bilateral_scaled_sigma_s() clamps against the full image and
+ *      carries the cell size over to the roi scale.
+ *   3. The local laplacian with an identity curve reconstructs its input
+ *      across tile seams, and copies the colour channels.
+ *   4. The local laplacian working memory stays bounded for a 24 Mpx image.
+ *
+ * No image file is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/bilateral.h"
+#include "common/locallaplacian.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+/* Lab test pattern: smooth gradient, a checkerboard and fixed a/b. */
+static float *_make_lab(const int wd, const int ht)
+{
+  float *buf = dt_alloc_align_float((size_t)4 * wd * ht);
+  if(!buf) return NULL;
+  for(int j = 0; j < ht; j++)
+    for(int i = 0; i < wd; i++)
+    {
+      float *px = buf + (size_t)4 * (j * wd + i);
+      px[0] = 50.0f + 30.0f * sinf(i * 0.013f) * cosf(j * 0.021f)
+              + (((i / 7) + (j / 5)) & 1 ? 8.0f : -8.0f);
+      px[1] = (float)(i % 11) - 5.0f;
+      px[2] = (float)(j % 13) - 6.0f;
+      px[3] = 1.0f;
+    }
+  return buf;
+}
+
+/* ── Test 1: bilateral grid ──────────────────────────────────────────────── */
+
+static void test_bilateral_grid(void)
+{
+  printf("\n--- Test 1: bilateral grid splat / slice ---\n");
+
+  const int wd = 517, ht = 389;
+  float *in = _make_lab(wd, ht);
+  float *out = dt_alloc_align_float((size_t)4 * wd * ht);
+  CHECK(in && out, "buffers allocated");
+  if(!in || !out) goto done;
+
+  dt_bilateral_t *b = dt_bilateral_init(wd, ht, 6.0f, 20.0f);
+  CHECK(b != NULL, "grid created");
+  if(!b) goto done;
+
+  dt_bilateral_splat(b, in);
+  // every pixel splats 100 / sigma_s^2 spread over 8 cells
+  double sum = 0.0;
+  const size_t cells = b->size_x * b->size_y * b->size_z;
+  for(size_t k = 0; k < cells; k++) sum += b->buf[k];
+  const double expect = (double)wd * ht * 100.0 / (b->sigma_s * b->sigma_s);
+  CHECK(fabs(sum - expect) < 1e-4 * expect, "splat keeps the whole payload");
+
+  dt_bilateral_blur(b);
+  dt_bilateral_slice(b, in, out, 0.0f);
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < (size_t)4 * wd * ht; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(out[k] - in[k]));
+  CHECK(maxdiff == 0.0f, "detail 0 leaves the image unchanged");
+
+  dt_bilateral_slice(b, in, out, 1.0f);
+  maxdiff = 0.0f;
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(out[4 * k] - in[4 * k]));
+  CHECK(maxdiff > 0.1f, "detail 1 changes L");
+  CHECK(out[1] == in[1] && out[2] == in[2], "colour channels copied");
+
+  dt_bilateral_free(b);
+done:
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
+/* ── Test 2: scale-aware spatial sigma ───────────────────────────────────── */
+
+static void test_scaled_sigma(void)
+{
+  printf("\n--- Test 2: scale-aware bilateral sigma ---\n");
+
+  CHECK(fabsf(dt_bilateral_scaled_sigma_s(6000, 4000, 50.0f, 1.0f) - 50.0f) < 0.1f,
+        "full size keeps sigma_s");
+  CHECK(fabsf(dt_bilateral_scaled_sigma_s(6000, 4000, 50.0f, 0.1f) - 5.0f) < 0.01f,
+        "downscaled roi scales sigma_s");
+  CHECK(fabsf(dt_bilateral_scaled_sigma_s(6000, 4000, 50.0f, 2.0f) - 50.0f) < 0.1f,
+        "magnified roi keeps the full-size sigma_s");
+  // 12000 px at sigma 1 would be 12000 cells: clamped to 3000 (4 px)
+  CHECK(fabsf(dt_bilateral_scaled_sigma_s(12000, 8000, 1.0f, 0.25f) - 1.0f) < 0.01f,
+        "grid clamped against the full image, not the roi");
+}
+
+/* ── Test 3: local laplacian reconstruction ──────────────────────────────── */
+
+static void test_local_laplacian(void)
+{
+  printf("\n--- Test 3: tiled local laplacian ---\n");
+
+  // large enough for several tiles in both directions
+  const int wd = 1203, ht = 877;
+  float *in = _make_lab(wd, ht);
+  float *out = dt_alloc_align_float((size_t)4 * wd * ht);
+  CHECK(in && out, "buffers allocated");
+  if(!in || !out) goto done;
+
+  // shadows = highlights = 1 and no clarity make the remapping curve the
+  // identity, so collapsing the pyramid must give back the input
+  local_laplacian(in, out, wd, ht, 0.5f, 1.0f, 1.0f, 0.0f);
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(out[4 * k] - in[4 * k]));
+  printf("  identity max |dL| = %g\n", maxdiff);
+  CHECK(maxdiff < 1e-3f, "identity curve reconstructs L across tiles");
+
+  int colour_ok = 1;
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+    colour_ok &= out[4 * k + 1] == in[4 * k + 1] && out[4 * k + 2] == in[4 * k + 2];
+  CHECK(colour_ok, "colour channels copied");
+
+  local_laplacian(in, out, wd, ht, 0.5f, 1.0f, 1.0f, 1.0f);
+  maxdiff = 0.0f;
+  for(size_t k = 0; k < (size_t)wd * ht; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(out[4 * k] - in[4 * k]));
+  CHECK(maxdiff > 0.5f, "clarity changes L");
+
+done:
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
+/* ── Test 4: bounded working memory ──────────────────────────────────────── */
+
+static void test_memory_bound(void)
+{
+  printf("\n--- Test 4: local laplacian memory ---\n");
+
+  const size_t image = sizeof(float) * 4 * 6000 * 4000;
+  const size_t use = local_laplacian_memory_use(6000, 4000);
+  printf("  6000x4000: %zu MiB working memory (image %zu MiB)\n", use >> 20, image >> 20);
+  CHECK(use < image / 4, "working memory well below one image buffer");
+  CHECK(local_laplacian_singlebuffer_size(6000, 4000) <= use, "single buffer within the total");
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_local_contrast ===\n");
+
+  test_bilateral_grid();
+  test_scaled_sigma();
+  test_local_laplacian();
+  test_memory_bound();
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ * test_lut3d_cache.c
+ *
+ * Internal unit test for the shared 3D LUT cache in src/common/lut3d_cache.c
+ * (dt_lut3d_acquire / dt_lut3d_release / dt_lut3d_cache_cleanup).
+ *
+ * Checks, on small .cube and .3dl files written to the temp directory:
+ *   1. Nodes are parsed into the padded RGBA layout, red fastest.
+ *   2. A second acquire of the same file returns the same LUT.
+ *   3. A file modified on disk is parsed again.
+ *   4. .3dl files are reordered and normalised like .cube files.
+ *   5. Missing and malformed files return NULL.
+ *
+ * No image file is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/lut3d_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+/* node (r, g, b) of a level-N cube written by _write_cube() */
+static float _node(const int level, const int i, const float scale)
+{
+  return scale * (float)i / (float)(level - 1);
+}
+
+/* identity LUT scaled by `scale`, with a swapped red/blue output */
+static int _write_cube(const char *path, const int level, const float scale)
+{
+  FILE *f = fopen(path, "w");
+  if(!f) return 0;
+  fprintf(f, "TITLE \"test\"\n# comment\nLUT_3D_SIZE %d\n", level);
+  for(int b = 0; b < level; b++)
+    for(int g = 0; g < level; g++)
+      for(int r = 0; r < level; r++)
+        fprintf(f, "%.6f %.6f %.6f\n", _node(level, b, scale), _node(level, g, scale),
+                _node(level, r, scale));
+  fclose(f);
+  return 1;
+}
+
+static void _bump_mtime(const char *path)
+{
+  struct stat st;
+  if(stat(path, &st) != 0) return;
+  struct utimbuf t = { st.st_atime, st.st_mtime + 10 };
+  utime(path, &t);
+}
+
+/* ── Test 1: layout ──────────────────────────────────────────────────────── */
+
+static void test_layout(const char *path)
+{
+  printf("\n--- Test 1: padded node layout ---\n");
+
+  CHECK(_write_cube(path, 5, 1.0f), "write .cube");
+  const dt_lut3d_t *lut = dt_lut3d_acquire(path);
+  CHECK(lut != NULL, "acquire .cube");
+  if(!lut) return;
+
+  CHECK(lut->level == 5, "level parsed");
+  CHECK(((uintptr_t)lut->clut & 15) == 0, "nodes are 16-byte aligned");
+
+  int ok = 1;
+  for(int b = 0; b < 5; b++)
+    for(int g = 0; g < 5; g++)
+      for(int r = 0; r < 5; r++)
+      {
+        const float *n = lut->clut + 4 * (r + 5 * g + 25 * b);
+        if(fabsf(n[0] - _node(5, b, 1.0f)) > 1e-6f || fabsf(n[1] - _node(5, g, 1.0f)) > 1e-6f
+           || fabsf(n[2] - _node(5, r, 1.0f)) > 1e-6f || n[3] != 0.0f)
+          ok = 0;
+      }
+  CHECK(ok, "nodes in .cube order, padding lane is 0");
+
+  dt_lut3d_release(lut);
+}
+
+/* ── Test 2 / 3: sharing and reload ──────────────────────────────────────── */
+
+static void test_sharing(const char *path)
+{
+  printf("\n--- Test 2: shared across acquires ---\n");
+
+  const dt_lut3d_t *a = dt_lut3d_acquire(path);
+  const dt_lut3d_t *b = dt_lut3d_acquire(path);
+  CHECK(a != NULL && a == b, "same file returns the same LUT");
+  CHECK(a && a->users == 2, "two users counted");
+
+  printf("\n--- Test 3: reload after modification ---\n");
+
+  CHECK(_write_cube(path, 3, 0.5f), "rewrite .cube");
+  _bump_mtime(path);
+  const dt_lut3d_t *c = dt_lut3d_acquire(path);
+  CHECK(c != NULL && c != a, "modified file is parsed again");
+  CHECK(c && c->level == 3, "new level");
+  CHECK(c && fabsf(c->clut[4 * 26 + 1] - 0.5f) < 1e-6f, "new content");
+  CHECK(a && a->level == 5 && !a->cached, "old LUT still valid for its users");
+
+  dt_lut3d_release(a);
+  dt_lut3d_release(b);
+  dt_lut3d_release(c);
+}
+
+/* ── Test 4: .3dl ────────────────────────────────────────────────────────── */
+
+static void test_3dl(const char *path)
+{
+  printf("\n--- Test 4: .3dl reorder and normalisation ---\n");
+
+  /* 4x4x4, 10-bit, blue fastest; the shaper line gives the level */
+  FILE *f = fopen(path, "w");
+  CHECK(f != NULL, "write .3dl");
+  if(!f) return;
+  fprintf(f, "0 341 682 1023\n");
+  for(int r = 0; r < 4; r++)
+    for(int g = 0; g < 4; g++)
+      for(int b = 0; b < 4; b++)
+        fprintf(f, "%d %d %d\n", r * 341, g * 341, b * 341);
+  fclose(f);
+
+  const dt_lut3d_t *lut = dt_lut3d_acquire(path);
+  CHECK(lut != NULL && lut->level == 4, "acquire .3dl");
+  if(!lut) return;
+
+  int ok = 1;
+  for(int b = 0; b < 4; b++)
+    for(int g = 0; g < 4; g++)
+      for(int r = 0; r < 4; r++)
+      {
+        const float *n = lut->clut + 4 * (r + 4 * g + 16 * b);
+        if(fabsf(n[0] - r / 3.0f) > 1e-6f || fabsf(n[1] - g / 3.0f) > 1e-6f
+           || fabsf(n[2] - b / 3.0f) > 1e-6f)
+          ok = 0;
+      }
+  CHECK(ok, "identity after reorder to red fastest");
+
+  dt_lut3d_release(lut);
+}
+
+/* ── Test 5: invalid files ───────────────────────────────────────────────── */
+
+static void test_invalid(const char *path)
+{
+  printf("\n--- Test 5: invalid files ---\n");
+
+  CHECK(dt_lut3d_acquire("/nonexistent/dir/look.cube") == NULL, "missing file");
+
+  FILE *f = fopen(path, "w");
+  if(f)
+  {
+    fprintf(f, "LUT_3D_SIZE 4\n0 0 0\n1 1 1\n");
+    fclose(f);
+  }
+  CHECK(dt_lut3d_acquire(path) == NULL, "truncated .cube");
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_lut3d_cache ===\n");
+
+  const char *tmp = getenv("TMPDIR");
+  if(!tmp || !tmp[0]) tmp = "/tmp";
+  char cube[512], cube_bad[512], lut3dl[512];
+  snprintf(cube, sizeof(cube), "%s/dtpipe_test_%d.cube", tmp, (int)getpid());
+  snprintf(cube_bad, sizeof(cube_bad), "%s/dtpipe_test_bad_%d.cube", tmp, (int)getpid());
+  snprintf(lut3dl, sizeof(lut3dl), "%s/dtpipe_test_%d.3dl", tmp, (int)getpid());
+
+  test_layout(cube);
+  test_sharing(cube);
+  test_3dl(lut3dl);
+  test_invalid(cube_bad);
+
+  dt_lut3d_cache_cleanup();
+  remove(cube);
+  remove(cube_bad);
+  remove(lut3dl);
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
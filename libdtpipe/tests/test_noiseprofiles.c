@@ -0,0 +1,207 @@
+/*
+ * test_noiseprofiles.c
+ *
+ * Internal unit test for the noise profile database in
+ * src/common/noiseprofiles.c (dt_noiseprofile_init / get_matching /
+ * interpolate / cleanup).
+ *
+ * Checks, on a small noiseprofiles.json written to the temp directory:
+ *   1. The file loads; a camera's profiles come back sorted by ISO with
+ *      skipped entries dropped.
+ *   2. The maker matches as a substring, the model exactly.
+ *   3. Interpolation between two ISOs is linear and clamped.
+ *   4. Invalid and missing files are rejected and keep the loaded table.
+ *
+ * No image file is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/noiseprofiles.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+static const char *_valid_json =
+  "{\n"
+  "  \"version\": 0,\n"
+  "  \"noiseprofiles\": [\n"
+  "    {\n"
+  "      \"maker\": \"Canon\",\n"
+  "      \"models\": [\n"
+  "        {\n"
+  "          \"model\": \"EOS 5D\",\n"
+  "          \"comment\": \"out of order on purpose\",\n"
+  "          \"profiles\": [\n"
+  "            {\"name\": \"EOS 5D iso 800\", \"iso\": 800, \"a\": [4e-05, 3e-05, 5e-05], \"b\": [-2e-07, -1e-07, -3e-07]},\n"
+  "            {\"name\": \"EOS 5D iso 100\", \"iso\": 100, \"a\": [1e-05, 1e-05, 2e-05], \"b\": [1e-07, 1e-07, 1e-07]},\n"
+  "            {\"name\": \"EOS 5D iso 400\", \"iso\": 400, \"a\": [2e-05, 2e-05, 3e-05], \"b\": [0, 0, 0], \"skip\": true},\n"
+  "            {\"name\": \"EOS 5D iso 200\", \"iso\": 200, \"a\": [2e-05, 2e-05, 3e-05], \"b\": [0, 0, 0]}\n"
+  "          ]\n"
+  "        },\n"
+  "        {\n"
+  "          \"model\": \"EOS 5D Mark II\",\n"
+  "          \"profiles\": [\n"
+  "            {\"name\": \"Mark II iso 100\", \"iso\": 100, \"a\": [1e-06, 1e-06, 1e-06], \"b\": [0, 0, 0]}\n"
+  "          ]\n"
+  "        }\n"
+  "      ]\n"
+  "    }\n"
+  "  ]\n"
+  "}\n";
+
+static int _write(const char *path, const char *text)
+{
+  FILE *f = fopen(path, "w");
+  if(!f) return 0;
+  fputs(text, f);
+  fclose(f);
+  return 1;
+}
+
+static dt_image_t _camera(const char *maker, const char *model)
+{
+  dt_image_t img;
+  memset(&img, 0, sizeof(img));
+  g_strlcpy(img.camera_maker, maker, sizeof(img.camera_maker));
+  g_strlcpy(img.camera_model, model, sizeof(img.camera_model));
+  return img;
+}
+
+/* ── Test 1: load and sort ───────────────────────────────────────────────── */
+
+static void test_load(const char *path)
+{
+  printf("\n--- Test 1: load, sort by ISO, drop skipped ---\n");
+
+  CHECK(_write(path, _valid_json), "write noiseprofiles.json");
+  CHECK(dt_noiseprofile_init(path), "valid file loads");
+
+  const dt_image_t img = _camera("Canon", "EOS 5D");
+  const dt_noiseprofile_t *p = NULL;
+  const int n = dt_noiseprofile_get_matching(&img, &p);
+  CHECK(n == 3 && p != NULL, "three profiles (skipped one dropped)");
+  if(n != 3 || !p) return;
+
+  CHECK(p[0].iso == 100 && p[1].iso == 200 && p[2].iso == 800, "sorted by ISO");
+  CHECK(strcmp(p[2].name, "EOS 5D iso 800") == 0, "name kept with its profile");
+  CHECK(strcmp(p[0].maker, "Canon") == 0 && strcmp(p[0].model, "EOS 5D") == 0,
+        "maker and model filled in");
+  CHECK(fabsf(p[2].a[1] - 3e-05f) < 1e-10f && fabsf(p[2].b[2] + 3e-07f) < 1e-12f,
+        "coefficients parsed");
+}
+
+/* ── Test 2: matching ────────────────────────────────────────────────────── */
+
+static void test_matching(void)
+{
+  printf("\n--- Test 2: maker substring, model exact ---\n");
+
+  const dt_noiseprofile_t *p = NULL;
+
+  const dt_image_t long_maker = _camera("Canon Inc.", "EOS 5D Mark II");
+  CHECK(dt_noiseprofile_get_matching(&long_maker, &p) == 1 && p && p[0].iso == 100
+        && strcmp(p[0].model, "EOS 5D Mark II") == 0,
+        "maker matched as substring, longer model distinct");
+
+  const dt_image_t prefix = _camera("Canon", "EOS 5");
+  CHECK(dt_noiseprofile_get_matching(&prefix, &p) == 0 && p == NULL, "model prefix does not match");
+
+  const dt_image_t other = _camera("Nikon", "EOS 5D");
+  CHECK(dt_noiseprofile_get_matching(&other, &p) == 0, "other maker does not match");
+
+  const dt_image_t empty = _camera("", "");
+  CHECK(dt_noiseprofile_get_matching(&empty, &p) == 0, "no exif, no profile");
+}
+
+/* ── Test 3: interpolation ───────────────────────────────────────────────── */
+
+static void test_interpolate(void)
+{
+  printf("\n--- Test 3: interpolation ---\n");
+
+  const dt_noiseprofile_t lo = { "lo", "", "", 100, { 1.0f, 2.0f, 3.0f }, { 0.0f, 0.0f, 0.0f } };
+  const dt_noiseprofile_t hi = { "hi", "", "", 300, { 3.0f, 4.0f, 5.0f }, { 2.0f, 2.0f, 2.0f } };
+
+  dt_noiseprofile_t out = { 0 };
+  out.iso = 200;
+  dt_noiseprofile_interpolate(&lo, &hi, &out);
+  CHECK(fabsf(out.a[0] - 2.0f) < 1e-6f && fabsf(out.a[2] - 4.0f) < 1e-6f
+        && fabsf(out.b[1] - 1.0f) < 1e-6f, "midpoint");
+
+  out.iso = 1000;
+  dt_noiseprofile_interpolate(&lo, &hi, &out);
+  CHECK(fabsf(out.a[1] - 4.0f) < 1e-6f, "clamped above");
+}
+
+/* ── Test 4: invalid files ───────────────────────────────────────────────── */
+
+static void test_invalid(const char *path)
+{
+  printf("\n--- Test 4: invalid files ---\n");
+
+  CHECK(_write(path, "{ \"version\": 0, \"noiseprofiles\": [ { \"maker\": \"X\", \"models\": "
+                     "[ { \"model\": \"Y\", \"profiles\": [ { \"name\": \"n\", \"a\": [1,1,1], "
+                     "\"b\": [0,0,0] } ] } ] } ] }"),
+        "write file without iso");
+  CHECK(!dt_noiseprofile_init(path), "missing iso rejected");
+
+  CHECK(_write(path, "{ \"version\": 1, \"noiseprofiles\": [] }"), "write future version");
+  CHECK(!dt_noiseprofile_init(path), "unknown version rejected");
+
+  CHECK(!dt_noiseprofile_init("/nonexistent/dir/noiseprofiles.json"), "missing file rejected");
+
+  const dt_image_t img = _camera("Canon", "EOS 5D");
+  const dt_noiseprofile_t *p = NULL;
+  CHECK(dt_noiseprofile_get_matching(&img, &p) == 3, "previous table still loaded");
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_noiseprofiles ===\n");
+
+  const char *tmp = getenv("TMPDIR");
+  if(!tmp || !tmp[0]) tmp = "/tmp";
+  char good[512], bad[512];
+  snprintf(good, sizeof(good), "%s/dtpipe_test_np_%d.json", tmp, (int)getpid());
+  snprintf(bad, sizeof(bad), "%s/dtpipe_test_np_bad_%d.json", tmp, (int)getpid());
+
+  test_load(good);
+  test_matching();
+  test_interpolate();
+  test_invalid(bad);
+
+  dt_noiseprofile_cleanup();
+  remove(good);
+  remove(bad);
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
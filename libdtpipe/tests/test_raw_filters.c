@@ -0,0 +1,371 @@
+/*
+ * test_raw_filters.c
+ *
+ * Internal unit test for the raw stage filters: src/iop/hotpixels.c,
+ * src/iop/cacorrect.c and the hot pixel pass folded into
+ * src/iop/rawprepare.c.
+ *
+ * Checks, on a synthetic Bayer mosaic:
+ *   1. the hot pixels module removes planted hot sensels and leaves the
+ *      rest of the mosaic alone.
+ *   2. rawprepare with the filter folded in gives the same bits as
+ *      rawprepare followed by the hot pixels module.
+ *   3. with white balance in between, the fused rawprepare followed by
+ *      temperature matches rawprepare, temperature, hot pixels.
+ *   4. cacorrect keeps a CA-free mosaic close to its input and gives the
+ *      same output when it runs again from its cached fit.
+ *
+ * The modules are driven through their init_global hooks, no image file
+ * is needed.
+ *
+ * Exit codes:
+ *   0 – all checks passed
+ *   1 – one or more checks failed
+ */
+
+#include "dtpipe_internal.h"
+#include "common/hotpixels.h"
+#include "iop/iop_math.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void dt_iop_rawprepare_init_global(dt_iop_module_so_t *so);
+void dt_iop_temperature_init_global(dt_iop_module_so_t *so);
+void dt_iop_hotpixels_init_global(dt_iop_module_so_t *so);
+void dt_iop_cacorrect_init_global(dt_iop_module_so_t *so);
+
+/* ── helpers ─────────────────────────────────────────────────────────────── */
+
+static int g_failures = 0;
+
+#define CHECK(cond, msg)                                                       \
+  do {                                                                         \
+    if(!(cond)) {                                                              \
+      fprintf(stderr, "FAIL [%s:%d] %s\n", __FILE__, __LINE__, (msg));        \
+      g_failures++;                                                            \
+    } else {                                                                   \
+      printf("  OK  %s\n", (msg));                                            \
+    }                                                                          \
+  } while(0)
+
+/* Layouts match the params structs in src/pipe/params.c. */
+typedef struct
+{
+  int32_t left, top, right, bottom;
+  uint16_t raw_black_level_separate[4];
+  uint32_t raw_white_point;
+  int32_t flat_field;
+} _rawprepare_params_t;
+typedef struct { float red, green, blue, various; int32_t preset; } _temperature_params_t;
+typedef struct { float strength, threshold; int32_t markfixed, permissive; } _hotpixels_params_t;
+typedef struct { int32_t avoidshift, iterations; } _cacorrect_params_t;
+
+#define WD 96
+#define HT 80
+#define FILTERS_RGGB 0x94949494u
+
+static dt_dev_pixelpipe_t g_pipe;
+
+static void _reset_pipe(void)
+{
+  memset(&g_pipe, 0, sizeof(g_pipe));
+  g_pipe.image.flags = DT_IMAGE_RAW;
+  g_pipe.image.buf_dsc.filters = FILTERS_RGGB;
+  g_pipe.dsc.filters = FILTERS_RGGB;
+  g_pipe.dsc.channels = 1;
+  g_pipe.dsc.datatype = TYPE_FLOAT;
+  g_pipe.iwidth = WD;
+  g_pipe.iheight = HT;
+  g_pipe.iscale = 1.0f;
+  g_pipe.type = DT_DEV_PIXELPIPE_EXPORT;
+  for(int k = 0; k < 4; k++)
+    g_pipe.dsc.processed_maximum[k] = 1.0f;
+}
+
+/* Smooth per-colour ramps with a few planted hot sensels, in raw units. */
+static uint16_t *_make_mosaic(void)
+{
+  uint16_t *buf = malloc(sizeof(uint16_t) * WD * HT);
+  if(!buf) return NULL;
+  for(int j = 0; j < HT; j++)
+    for(int i = 0; i < WD; i++)
+    {
+      const int c = FC(j, i, FILTERS_RGGB);
+      buf[j * WD + i] = (uint16_t)(600 + 4 * i + 3 * j + 200 * c + ((i * 7 + j * 13) % 11));
+    }
+  static const int hot[][2] = { { 10, 10 }, { 31, 20 }, { 50, 41 }, { 77, 60 }, { 5, 70 } };
+  for(size_t k = 0; k < sizeof(hot) / sizeof(hot[0]); k++)
+    buf[hot[k][1] * WD + hot[k][0]] = 16000;
+  return buf;
+}
+
+/* Module and piece wired the way create.c does it, with committed params. */
+static void _setup(dt_iop_module_so_t *so,
+                   dt_iop_module_t *m,
+                   dt_dev_pixelpipe_iop_t *piece,
+                   void *params)
+{
+  memset(m, 0, sizeof(*m));
+  memset(piece, 0, sizeof(*piece));
+  m->so            = so;
+  m->process_plain = so->process_plain;
+  m->init_pipe     = so->init_pipe;
+  m->cleanup_pipe  = so->cleanup_pipe;
+  m->commit_params = so->commit_params;
+  m->modify_roi_in = so->modify_roi_in;
+  m->raw_gains     = so->raw_gains;
+  m->raw_prefilter = so->raw_prefilter;
+  m->enabled       = true;
+
+  piece->module   = m;
+  piece->pipe     = &g_pipe;
+  piece->colors   = 1;
+  piece->enabled  = true;
+  piece->iscale   = 1.0f;
+  piece->dsc_in   = g_pipe.dsc;
+  piece->buf_in   = (dt_iop_roi_t){ 0, 0, WD, HT, 1.0f };
+  m->init_pipe(m, &g_pipe, piece);
+  m->commit_params(m, params, &g_pipe, piece);
+}
+
+static void _teardown(dt_iop_module_t *m, dt_dev_pixelpipe_iop_t *piece)
+{
+  m->cleanup_pipe(m, &g_pipe, piece);
+}
+
+static const _rawprepare_params_t g_rawprepare = { 0, 0, 0, 0, { 512, 512, 512, 512 }, 16383, 0 };
+static const _hotpixels_params_t g_hotpixels = { 0.25f, 0.05f, 0, 0 };
+
+/* rawprepare on the uint16 mosaic, optionally with a hot pixel filter. */
+static void _run_rawprepare(const uint16_t *mosaic, float *out,
+                            const dt_hotpixels_t *filter, const float gains[4])
+{
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_rawprepare_init_global(&so);
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  _setup(&so, &m, &piece, (void *)&g_rawprepare);
+  piece.dsc_in.datatype = TYPE_UINT16;
+  piece.fused_hotpixels = filter;
+  for(int k = 0; k < 4; k++)
+    piece.fused_raw_gains[k] = gains ? gains[k] : 1.0f;
+
+  const dt_iop_roi_t roi = { 0, 0, WD, HT, 1.0f };
+  m.process_plain(&m, &piece, mosaic, out, &roi, &roi);
+  _teardown(&m, &piece);
+}
+
+static void _run_module(void (*init_global)(dt_iop_module_so_t *), void *params,
+                        const float *in, float *out)
+{
+  dt_iop_module_so_t so = { 0 };
+  init_global(&so);
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  _setup(&so, &m, &piece, params);
+  const dt_iop_roi_t roi = { 0, 0, WD, HT, 1.0f };
+  m.process_plain(&m, &piece, in, out, &roi, &roi);
+  _teardown(&m, &piece);
+}
+
+/* The filter the hot pixels module hands to the planner. */
+static const dt_hotpixels_t *_hotpixels_filter(dt_iop_module_so_t *so,
+                                               dt_iop_module_t *m,
+                                               dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_iop_hotpixels_init_global(so);
+  _setup(so, m, piece, (void *)&g_hotpixels);
+  return m->raw_prefilter(m, piece);
+}
+
+/* ── Test 1: hot pixels ──────────────────────────────────────────────────── */
+
+static void test_hotpixels(const uint16_t *mosaic)
+{
+  printf("\n--- Test 1: hot pixels removed, clean sensels untouched ---\n");
+
+  float *a = dt_alloc_align_float((size_t)WD * HT);
+  float *b = dt_alloc_align_float((size_t)WD * HT);
+  CHECK(a && b, "buffers allocated");
+  if(!a || !b) goto done;
+
+  _reset_pipe();
+  _run_rawprepare(mosaic, a, NULL, NULL);
+  _run_module(dt_iop_hotpixels_init_global, (void *)&g_hotpixels, a, b);
+
+  int changed = 0, fixed = 0;
+  for(int j = 2; j < HT - 2; j++)
+    for(int i = 2; i < WD - 2; i++)
+    {
+      const size_t k = (size_t)j * WD + i;
+      if(a[k] != b[k]) changed++;
+      if(mosaic[k] == 16000 && b[k] < 0.5f) fixed++;
+    }
+  CHECK(fixed == 5, "all five planted hot sensels replaced");
+  CHECK(changed == 5, "no other sensel changed");
+
+done:
+  dt_free_align(a);
+  dt_free_align(b);
+}
+
+/* ── Test 2: fused into rawprepare ───────────────────────────────────────── */
+
+static void test_fused(const uint16_t *mosaic)
+{
+  printf("\n--- Test 2: hot pixels folded into rawprepare ---\n");
+
+  float *a = dt_alloc_align_float((size_t)WD * HT);
+  float *b = dt_alloc_align_float((size_t)WD * HT);
+  float *c = dt_alloc_align_float((size_t)WD * HT);
+  CHECK(a && b && c, "buffers allocated");
+  if(!a || !b || !c) goto done;
+
+  _reset_pipe();
+  _run_rawprepare(mosaic, a, NULL, NULL);
+  _run_module(dt_iop_hotpixels_init_global, (void *)&g_hotpixels, a, b);
+
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  _reset_pipe();
+  const dt_hotpixels_t *filter = _hotpixels_filter(&so, &m, &piece);
+  CHECK(filter != NULL, "Bayer hot pixels offer a raw prefilter");
+  if(filter)
+  {
+    _run_rawprepare(mosaic, c, filter, NULL);
+    CHECK(!memcmp(b, c, sizeof(float) * WD * HT), "fused pass matches the two modules");
+  }
+  _teardown(&m, &piece);
+
+done:
+  dt_free_align(a);
+  dt_free_align(b);
+  dt_free_align(c);
+}
+
+/* ── Test 3: gains in between ────────────────────────────────────────────── */
+
+static void test_gains(const uint16_t *mosaic)
+{
+  printf("\n--- Test 3: white balance between rawprepare and hot pixels ---\n");
+
+  float *a = dt_alloc_align_float((size_t)WD * HT);
+  float *b = dt_alloc_align_float((size_t)WD * HT);
+  float *c = dt_alloc_align_float((size_t)WD * HT);
+  CHECK(a && b && c, "buffers allocated");
+  if(!a || !b || !c) goto done;
+
+  /* powers of two, so both orders round the same way */
+  _temperature_params_t wb = { 2.0f, 1.0f, 4.0f, 1.0f, 0 };
+
+  _reset_pipe();
+  _run_rawprepare(mosaic, a, NULL, NULL);
+  _run_module(dt_iop_temperature_init_global, &wb, a, b);
+  _run_module(dt_iop_hotpixels_init_global, (void *)&g_hotpixels, b, a);
+
+  dt_iop_module_so_t tso = { 0 };
+  dt_iop_temperature_init_global(&tso);
+  dt_iop_module_t tm;
+  dt_dev_pixelpipe_iop_t tpiece;
+  _reset_pipe();
+  _setup(&tso, &tm, &tpiece, &wb);
+  float gains[4] = { 0.0f };
+  CHECK(tm.raw_gains && tm.raw_gains(&tm, &tpiece, gains), "temperature reports its gains");
+  CHECK(gains[0] == 2.0f && gains[2] == 4.0f, "gains are the white balance coefficients");
+  _teardown(&tm, &tpiece);
+
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  const dt_hotpixels_t *filter = _hotpixels_filter(&so, &m, &piece);
+  if(filter)
+  {
+    _run_rawprepare(mosaic, c, filter, gains);
+    _run_module(dt_iop_temperature_init_global, &wb, c, b);
+    CHECK(!memcmp(a, b, sizeof(float) * WD * HT), "fused pass with gains matches the three modules");
+  }
+  _teardown(&m, &piece);
+
+done:
+  dt_free_align(a);
+  dt_free_align(b);
+  dt_free_align(c);
+}
+
+/* ── Test 4: cacorrect ───────────────────────────────────────────────────── */
+
+static void test_cacorrect(const uint16_t *mosaic)
+{
+  printf("\n--- Test 4: cacorrect on a CA-free mosaic, cached fit ---\n");
+
+  float *a = dt_alloc_align_float((size_t)WD * HT);
+  float *b = dt_alloc_align_float((size_t)WD * HT);
+  float *c = dt_alloc_align_float((size_t)WD * HT);
+  CHECK(a && b && c, "buffers allocated");
+  if(!a || !b || !c) goto done;
+
+  _reset_pipe();
+  _run_rawprepare(mosaic, a, NULL, NULL);
+
+  dt_iop_module_so_t so = { 0 };
+  dt_iop_cacorrect_init_global(&so);
+  dt_iop_module_t m;
+  dt_dev_pixelpipe_iop_t piece;
+  _cacorrect_params_t p = { 0, 2 };
+  _setup(&so, &m, &piece, &p);
+  CHECK(piece.enabled, "enabled on a Bayer raw");
+
+  const dt_iop_roi_t roi = { 0, 0, WD, HT, 1.0f };
+  m.process_plain(&m, &piece, a, b, &roi, &roi);
+  m.process_plain(&m, &piece, a, c, &roi, &roi);
+  _teardown(&m, &piece);
+
+  float maxdiff = 0.0f;
+  bool finite = true;
+  for(size_t k = 0; k < (size_t)WD * HT; k++)
+  {
+    if(!isfinite(b[k])) finite = false;
+    if(mosaic[k] != 16000) maxdiff = fmaxf(maxdiff, fabsf(b[k] - a[k]));
+  }
+  CHECK(finite, "output is finite");
+  CHECK(maxdiff < 0.02f, "CA-free mosaic stays close to its input");
+  CHECK(!memcmp(b, c, sizeof(float) * WD * HT), "second run from the cached fit is identical");
+
+done:
+  dt_free_align(a);
+  dt_free_align(b);
+  dt_free_align(c);
+}
+
+/* ── main ────────────────────────────────────────────────────────────────── */
+
+int main(void)
+{
+  printf("=== test_raw_filters ===\n");
+
+  uint16_t *mosaic = _make_mosaic();
+  if(!mosaic)
+  {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  test_hotpixels(mosaic);
+  test_fused(mosaic);
+  test_gains(mosaic);
+  test_cacorrect(mosaic);
+
+  free(mosaic);
+
+  if(g_failures)
+  {
+    fprintf(stderr, "\n%d check(s) FAILED\n", g_failures);
+    return 1;
+  }
+  printf("\nAll checks passed.\n");
+  return 0;
+}
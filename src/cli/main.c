@@ -25,6 +25,7 @@
  *  - profit
  */
 
+#include "common/atomic.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -98,6 +99,7 @@ fprintf(stderr, "darktable %s\n"
                 "   --icc-file <file> specify icc filename, default to NONE\n"
                 "   --icc-intent <intent> specify icc intent, default to LAST\n"
                 "                     use --help icc-intent for list of supported intents\n"
+                "   -j, --jobs <N> number of images exported at once, default: 1\n"
                 "   --verbose\n"
                 "   -h, --help [option]\n"
                 "   -v, --version\n",
@@ -196,6 +198,72 @@ static dt_iop_color_intent_t get_icc_intent(const char* option)
 }
 #undef ICC_INTENT_FROM_STR
 
+// the export workers of --jobs, one pixelpipe each. the pipelines run in
+// the same process so they share the colour profiles, the module data
+// (LUTs) and the lens database instead of loading them per instance. each
+// pipeline tiles within its share of the host memory.
+typedef struct _export_t
+{
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *sdata;
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_data_t *fdata;
+  const int *ids;
+  int total;
+  gboolean high_quality, upscale, export_masks, custom_presets;
+  dt_colorspaces_color_profile_type_t icc_type;
+  const gchar *icc_filename;
+  dt_iop_color_intent_t icc_intent;
+  int omp_threads;
+  dt_atomic_int next;
+  dt_atomic_int failed;
+} _export_t;
+
+static void _export_run(_export_t *e, dt_imageio_module_data_t *fdata)
+{
+#ifdef _OPENMP
+  // the threads are split between the workers, this only applies to the calling thread
+  omp_set_num_threads(e->omp_threads);
+#endif
+
+  int i;
+  while((i = dt_atomic_add_int(&e->next, 1)) < e->total)
+  {
+    const dt_imgid_t id = e->ids[i];
+    dt_export_metadata_t metadata;
+    // TODO: have a parameter in command line to get the export presets
+    if(e->custom_presets)
+    {
+      metadata.flags = dt_lib_export_metadata_get_conf_flags();
+      metadata.list = dt_util_str_to_glist("\1", dt_lib_export_metadata_get_conf());
+      if(metadata.list)
+        metadata.list = g_list_remove(metadata.list, metadata.list->data);
+    }
+    else
+    {
+      metadata.flags = dt_lib_export_metadata_default_flags();
+      metadata.list = NULL;
+    }
+    // the sequence number is the position in the list, whatever the order the workers finish in
+    if(e->storage->store(e->storage, e->sdata, id, e->format, fdata, i + 1, e->total, e->high_quality,
+                         e->upscale, FALSE, 1.0, e->export_masks,
+                         e->icc_type, e->icc_filename, e->icc_intent, &metadata) != 0)
+      dt_atomic_set_int(&e->failed, 1);
+  }
+}
+
+static void *_export_worker(void *data)
+{
+  _export_t *e = (_export_t *)data;
+  // the export sets the output size in the format parameters, so each worker has its own copy
+  dt_imageio_module_data_t *fdata = e->format->get_params(e->format);
+  if(!fdata) return NULL;
+  memcpy(fdata, e->fdata, e->format->params_size(e->format));
+  _export_run(e, fdata);
+  e->format->free_params(e->format, fdata);
+  return NULL;
+}
+
 int main(int argc, char *arg[])
 {
 #ifdef __APPLE__
@@ -217,7 +285,7 @@ int main(int argc, char *arg[])
   gchar *output_ext = NULL;
   char *style = NULL;
   int file_counter = 0;
-  int width = 0, height = 0, bpp = 0;
+  int width = 0, height = 0, bpp = 0, jobs = 1;
   gboolean verbose = FALSE, high_quality = TRUE, upscale = FALSE,
            style_overwrite = FALSE, custom_presets = TRUE, export_masks = FALSE,
            output_to_dir = FALSE;
@@ -407,6 +475,11 @@ int main(int argc, char *arg[])
       {
         verbose = TRUE;
       }
+      else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+      {
+        k++;
+        jobs = MAX(atoi(arg[k]), 1);
+      }
       else if(!strcmp(arg[k], "--core"))
       {
         // everything from here on should be passed to the core
@@ -804,29 +877,56 @@ int main(int argc, char *arg[])
 
   // TODO: add a callback to set the bpp without going through the config
 
-  int num = 1, res = 0;
-  for(GList *iter = id_list; iter; iter = g_list_next(iter), num++)
-  {
-    const int id = GPOINTER_TO_INT(iter->data);
-    dt_export_metadata_t metadata;
-    // TODO: have a parameter in command line to get the export presets
-    if(custom_presets)
-    {
-      metadata.flags = dt_lib_export_metadata_get_conf_flags();
-      metadata.list = dt_util_str_to_glist("\1", dt_lib_export_metadata_get_conf());
-      if(metadata.list)
-        metadata.list = g_list_remove(metadata.list, metadata.list->data);
-    }
-    else
-    {
-      metadata.flags = dt_lib_export_metadata_default_flags();
-      metadata.list = NULL;
-    }
-    if(storage->store(storage, sdata, id, format, fdata, num, total, high_quality,
-                      upscale, FALSE, 1.0, export_masks,
-                      icc_type, icc_filename, icc_intent, &metadata) != 0)
-      res = 1;
-  }
+  // the images may have been reordered or dropped by the storage
+  const int count = g_list_length(id_list);
+  int *ids = g_malloc_n(MAX(count, 1), sizeof(int));
+  int n = 0;
+  for(GList *iter = id_list; iter; iter = g_list_next(iter))
+    ids[n++] = GPOINTER_TO_INT(iter->data);
+
+  // a few images at a time, each pipeline with its share of the threads
+  // and of the host memory. tiling needs at least 512MB per pipeline, and
+  // a format collecting all images into one file takes them one by one.
+  const int threads = dt_get_num_threads();
+  jobs = CLAMP(jobs, 1, MAX(count, 1));
+  jobs = MIN(jobs, MAX(1, dt_get_available_mem() / (512lu * DT_MEGA)));
+  if(format->flags(fdata) & FORMAT_FLAGS_SINGLE_FILE)
+    jobs = 1;
+  darktable.dtresources.export_jobs = jobs;
+
+  _export_t e = { .storage = storage,
+                  .sdata = sdata,
+                  .format = format,
+                  .fdata = fdata,
+                  .ids = ids,
+                  .total = count,
+                  .high_quality = high_quality,
+                  .upscale = upscale,
+                  .export_masks = export_masks,
+                  .custom_presets = custom_presets,
+                  .icc_type = icc_type,
+                  .icc_filename = icc_filename,
+                  .icc_intent = icc_intent,
+                  .omp_threads = MAX(1, threads / jobs) };
+  dt_atomic_set_int(&e.next, 0);
+  dt_atomic_set_int(&e.failed, 0);
+
+  if(jobs > 1 && verbose)
+    printf(_("exporting %d images with %d jobs of %d threads\n"), count, jobs, e.omp_threads);
+
+  pthread_t *workers = g_malloc0(sizeof(pthread_t) * jobs);
+  int started = 0;
+  for(int j = 1; j < jobs; j++)
+    if(!dt_pthread_create(&workers[started], _export_worker, &e))
+      started++;
+  // this thread is a worker too, with the parameters set up above
+  _export_run(&e, fdata);
+  for(int j = 0; j < started; j++)
+    pthread_join(workers[j], NULL);
+  g_free(workers);
+
+  g_free(ids);
+  const int res = dt_atomic_get_int(&e.failed);
 
   // cleanup time
   if(storage->finalize_store) storage->finalize_store(storage, sdata);
@@ -25,54 +25,219 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// this implements a concurrent LRU cache
+// this implements a concurrent LRU cache.
+//
+// keys are spread over DT_CACHE_SHARDS lock stripes, so threads working on
+// different images rarely meet on the same mutex. within a shard, lookups go
+// through an open addressing hash table and the lru order is an intrusive
+// doubly linked list, so a hit costs O(1) under the shard lock. the quota is
+// global: the sum of all entry costs is kept in cache->cost and garbage
+// collection visits the shards round robin.
+
+static inline uint32_t _hash(const uint32_t key)
+{
+  // murmur3 finalizer: image ids are dense, spread them over shards and slots
+  uint32_t h = key;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline dt_cache_shard_t *_shard(const dt_cache_t *cache,
+                                       const uint32_t hash)
+{
+  return cache->shards + (hash & (DT_CACHE_SHARDS - 1));
+}
+
+static inline uint32_t _home_slot(const dt_cache_shard_t *shard,
+                                  const uint32_t hash)
+{
+  // the low bits already picked the shard
+  return (hash / DT_CACHE_SHARDS) & (shard->table_size - 1);
+}
+
+static inline size_t _cost(const dt_cache_t *cache)
+{
+  return __atomic_load_n(&cache->cost, __ATOMIC_RELAXED);
+}
+
+// slot holding key, or -1. the table is never full, so probing ends.
+static int64_t _find(const dt_cache_shard_t *shard,
+                     const uint32_t key,
+                     const uint32_t hash)
+{
+  const uint32_t mask = shard->table_size - 1;
+  for(uint32_t i = _home_slot(shard, hash);; i = (i + 1) & mask)
+  {
+    const dt_cache_entry_t *entry = shard->table[i];
+    if(!entry) return -1;
+    if(entry->key == key) return i;
+  }
+}
+
+static void _table_put(dt_cache_shard_t *shard,
+                       dt_cache_entry_t *entry)
+{
+  const uint32_t mask = shard->table_size - 1;
+  uint32_t i = _home_slot(shard, _hash(entry->key));
+  while(shard->table[i]) i = (i + 1) & mask;
+  shard->table[i] = entry;
+}
+
+// keep the load factor at or below 3/4
+static void _table_reserve(dt_cache_shard_t *shard,
+                           const uint32_t count)
+{
+  if((size_t)count * 4 <= (size_t)shard->table_size * 3) return;
+
+  dt_cache_entry_t **old = shard->table;
+  const uint32_t old_size = shard->table_size;
+  shard->table_size = old_size * 2;
+  shard->table = g_new0(dt_cache_entry_t *, shard->table_size);
+  for(uint32_t i = 0; i < old_size; i++)
+    if(old[i]) _table_put(shard, old[i]);
+  g_free(old);
+}
+
+// backward shift deletion: close the hole so no tombstones are needed
+static void _table_erase(dt_cache_shard_t *shard,
+                         const uint32_t slot)
+{
+  const uint32_t mask = shard->table_size - 1;
+  uint32_t hole = slot;
+  for(uint32_t j = (hole + 1) & mask; shard->table[j]; j = (j + 1) & mask)
+  {
+    const uint32_t home = _home_slot(shard, _hash(shard->table[j]->key));
+    // the entry may move back unless its home lies after the hole
+    if(((j - home) & mask) >= ((j - hole) & mask))
+    {
+      shard->table[hole] = shard->table[j];
+      hole = j;
+    }
+  }
+  shard->table[hole] = NULL;
+}
+
+static inline void _lru_unlink(dt_cache_shard_t *shard,
+                               dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else shard->lru = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else shard->mru = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static inline void _lru_push(dt_cache_shard_t *shard,
+                             dt_cache_entry_t *entry)
+{
+  entry->lru_prev = shard->mru;
+  entry->lru_next = NULL;
+  if(shard->mru) shard->mru->lru_next = entry;
+  else shard->lru = entry;
+  shard->mru = entry;
+}
+
+// bubble up in lru list
+static inline void _lru_touch(dt_cache_shard_t *shard,
+                              dt_cache_entry_t *entry)
+{
+  if(shard->mru == entry) return;
+  _lru_unlink(shard, entry);
+  _lru_push(shard, entry);
+}
+
+// take a write locked entry out of its shard and free it. shard lock held.
+static void _evict(dt_cache_t *cache,
+                   dt_cache_shard_t *shard,
+                   dt_cache_entry_t *entry,
+                   const uint32_t slot)
+{
+  _table_erase(shard, slot);
+  _lru_unlink(shard, entry);
+  shard->count--;
+  __atomic_fetch_sub(&cache->cost, entry->cost, __ATOMIC_RELAXED);
+
+  if(cache->cleanup)
+  {
+    assert(entry->data_size);
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+
+    cache->cleanup(cache->cleanup_data, entry);
+  }
+  else
+    dt_free_align(entry->data);
+
+  dt_pthread_rwlock_unlock(&entry->lock);
+  dt_pthread_rwlock_destroy(&entry->lock);
+  g_slice_free1(sizeof(*entry), entry);
+}
 
 void dt_cache_init(dt_cache_t *cache,
                    const size_t entry_size,
                    const size_t cost_quota)
 {
   cache->cost = 0;
-  cache->lru = 0;
   cache->entry_size = entry_size;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
+  cache->gc_shard = 0;
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+  cache->shards = dt_alloc_aligned(sizeof(dt_cache_shard_t) * DT_CACHE_SHARDS);
+  for(int s = 0; s < DT_CACHE_SHARDS; s++)
+  {
+    dt_cache_shard_t *shard = cache->shards + s;
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->table_size = 16;
+    shard->table = g_new0(dt_cache_entry_t *, shard->table_size);
+    shard->count = 0;
+    shard->lru = shard->mru = NULL;
+  }
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  for(GList *l = cache->lru; l; l = g_list_next(l))
+  for(int s = 0; s < DT_CACHE_SHARDS; s++)
   {
-    dt_cache_entry_t *entry = l->data;
-
-    if(cache->cleanup)
+    dt_cache_shard_t *shard = cache->shards + s;
+    dt_cache_entry_t *next = NULL;
+    for(dt_cache_entry_t *entry = shard->lru; entry; entry = next)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+      next = entry->lru_next;
 
-      cache->cleanup(cache->cleanup_data, entry);
-    }
-    else
-      dt_free_align(entry->data);
+      if(cache->cleanup)
+      {
+        assert(entry->data_size);
+        ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
 
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
+        cache->cleanup(cache->cleanup_data, entry);
+      }
+      else
+        dt_free_align(entry->data);
+
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+    }
+    g_free(shard->table);
+    dt_pthread_mutex_destroy(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
+  dt_free_align(cache->shards);
+  cache->shards = NULL;
 }
 
 gboolean dt_cache_contains(dt_cache_t *cache,
                           const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  const uint32_t hash = _hash(key);
+  dt_cache_shard_t *shard = _shard(cache, hash);
+  dt_pthread_mutex_lock(&shard->lock);
+  const gboolean result = _find(shard, key, hash) >= 0;
+  dt_pthread_mutex_unlock(&shard->lock);
   return result;
 }
 
@@ -82,16 +247,14 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
                                    const uint32_t key,
                                    const char mode)
 {
-  gpointer orig_key, value;
   const double start = dt_get_debug_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  if(res)
+  const uint32_t hash = _hash(key);
+  dt_cache_shard_t *shard = _shard(cache, hash);
+  dt_pthread_mutex_lock(&shard->lock);
+  const int64_t slot = _find(shard, key, hash);
+  if(slot >= 0)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
+    dt_cache_entry_t *entry = shard->table[slot];
     // lock the cache entry
     const int result = (mode == 'w')
       ? dt_pthread_rwlock_trywrlock(&entry->lock)
@@ -99,13 +262,11 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       return NULL;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     const double end = dt_get_debug_wtime();
     if(end - start > 0.1)
       dt_print(DT_DEBUG_ALWAYS, "try+ wait time %.06fs mode %c", end - start, mode);
@@ -120,7 +281,7 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache,
 
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "try- wait time %.06fs", end - start);
@@ -136,31 +297,28 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache,
                                            const char *file,
                                            const int line)
 {
-  gpointer orig_key, value;
   const double start = dt_get_debug_wtime();
+  const uint32_t hash = _hash(key);
+  dt_cache_shard_t *shard = _shard(cache, hash);
+  gboolean collected = FALSE;
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  if(res)
+  dt_pthread_mutex_lock(&shard->lock);
+  const int64_t slot = _find(shard, key, hash);
+  if(slot >= 0)
   { // yay, found. read lock and pass on.
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
+    dt_cache_entry_t *entry = shard->table[slot];
     const int result = (mode == 'w')
                       ? dt_pthread_rwlock_trywrlock_with_caller(&entry->lock, file, line)
                       : dt_pthread_rwlock_tryrdlock_with_caller(&entry->lock, file, line);
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       g_usleep(5);
       goto restart;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
 
 #ifdef _DEBUG
     const pthread_t writer = dt_pthread_rwlock_get_writer(&entry->lock);
@@ -187,12 +345,14 @@ restart:
 
   // else, not found, need to allocate.
 
-  // first try to clean up.
-  // also wait if we can't free more than the requested fill ratio.
-  if(cache->cost > 0.8f * cache->cost_quota)
+  // first try to clean up. the collector takes the shard locks one at a
+  // time, so drop ours and look again afterwards.
+  if(!collected && _cost(cache) > 0.8f * cache->cost_quota)
   {
-    // need to roll back all the way to get a consistent lock state:
+    dt_pthread_mutex_unlock(&shard->lock);
     dt_cache_gc(cache, 0.8f);
+    collected = TRUE;
+    goto restart;
   }
 
   // here dies your 32-bit system:
@@ -202,11 +362,13 @@ restart:
   entry->data = 0;
   entry->data_size = cache->entry_size;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = NULL;
   entry->key = key;
   entry->_lock_demoting = FALSE;
 
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  _table_reserve(shard, shard->count + 1);
+  _table_put(shard, entry);
+  shard->count++;
 
   assert(cache->allocate || entry->data_size);
 
@@ -226,12 +388,12 @@ restart:
   else
     dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
 
-  cache->cost += entry->cost;
+  __atomic_fetch_add(&cache->cost, entry->cost, __ATOMIC_RELAXED);
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_push(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   const double end = dt_get_debug_wtime();
   if(end - start > 0.1)
     dt_print(DT_DEBUG_ALWAYS, "wait time %.06fs", end - start);
@@ -244,25 +406,22 @@ restart:
 gboolean dt_cache_remove(dt_cache_t *cache,
                          const uint32_t key)
 {
-  dt_cache_entry_t *entry;
-  gpointer orig_key, value;
+  const uint32_t hash = _hash(key);
+  dt_cache_shard_t *shard = _shard(cache, hash);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
-
-  const gboolean res = g_hash_table_lookup_extended(cache->hashtable,
-                                                    GINT_TO_POINTER(key),
-                                                    &orig_key,
-                                                    &value);
-  entry = (dt_cache_entry_t *)value;
-  if(!res)
+  dt_pthread_mutex_lock(&shard->lock);
+
+  const int64_t slot = _find(shard, key, hash);
+  if(slot < 0)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     return TRUE;
   }
+  dt_cache_entry_t *entry = shard->table[slot];
   // need write lock to be able to delete:
   if(dt_pthread_rwlock_trywrlock(&entry->lock))
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
@@ -272,51 +431,26 @@ restart:
     // oops, we are currently demoting (rw -> r) lock to this entry in
     // some thread. do not touch!
     dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
 
-  const gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
-  (void)removed; // make non-assert compile happy
-  assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
-
-  if(cache->cleanup)
-  {
-    assert(entry->data_size);
-    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-    cache->cleanup(cache->cleanup_data, entry);
-  }
-  else
-    dt_free_align(entry->data);
-
-  dt_pthread_rwlock_unlock(&entry->lock);
-  dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
-  g_slice_free1(sizeof(*entry), entry);
+  _evict(cache, shard, entry, slot);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   return FALSE;
 }
 
-// best-effort garbage collection. never blocks, never fails. well,
-// sometimes it just doesn't free anything.
-void dt_cache_gc(dt_cache_t *cache,
-                 const float fill_ratio)
+// kick the least recently used entry nobody holds a lock on. FALSE if all
+// entries of the shard are in use.
+static gboolean _gc_shard(dt_cache_t *cache,
+                          dt_cache_shard_t *shard)
 {
-  GList *l = cache->lru;
-  while(l)
+  gboolean freed = FALSE;
+  dt_pthread_mutex_lock(&shard->lock);
+  for(dt_cache_entry_t *entry = shard->lru; entry; entry = entry->lru_next)
   {
-    dt_cache_entry_t *entry = l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to
-                        // the next one while we still have the
-                        // pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio)
-      break;
-
     // if still locked by anyone else give up:
     if(dt_pthread_rwlock_trywrlock(&entry->lock))
       continue;
@@ -330,23 +464,32 @@ void dt_cache_gc(dt_cache_t *cache,
     }
 
     // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
+    _evict(cache, shard, entry, _find(shard, entry->key, _hash(entry->key)));
+    freed = TRUE;
+    break;
+  }
+  dt_pthread_mutex_unlock(&shard->lock);
+  return freed;
+}
 
-    if(cache->cleanup)
+// best-effort garbage collection. never blocks, never fails. well,
+// sometimes it just doesn't free anything.
+void dt_cache_gc(dt_cache_t *cache,
+                 const float fill_ratio)
+{
+  // one entry per shard and round, until below quota or a whole round
+  // found everything locked
+  gboolean freed = TRUE;
+  while(freed && _cost(cache) >= cache->cost_quota * fill_ratio)
+  {
+    freed = FALSE;
+    for(int n = 0; n < DT_CACHE_SHARDS; n++)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-      cache->cleanup(cache->cleanup_data, entry);
+      if(_cost(cache) < cache->cost_quota * fill_ratio)
+        break;
+      const uint32_t s = __atomic_fetch_add(&cache->gc_shard, 1, __ATOMIC_RELAXED);
+      freed |= _gc_shard(cache, cache->shards + (s & (DT_CACHE_SHARDS - 1)));
     }
-    else
-      dt_free_align(entry->data);
-
-    dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
   }
 }
 
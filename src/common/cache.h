@@ -28,7 +28,9 @@ typedef struct dt_cache_entry_t
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  // intrusive lru list of the shard, protected by the shard lock
+  struct dt_cache_entry_t *lru_prev;
+  struct dt_cache_entry_t *lru_next;
   dt_pthread_rwlock_t lock;
   gboolean _lock_demoting;
   uint32_t key;
@@ -37,16 +39,30 @@ typedef struct dt_cache_entry_t
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
+// number of lock stripes, power of two. a key always maps to the same shard.
+#define DT_CACHE_SHARDS 16
+
+// one lock stripe: an open addressing hash table (linear probing, backward
+// shift deletion, no tombstones) and an lru list, on its own cache line.
+typedef struct dt_cache_shard_t
+{
+  dt_pthread_mutex_t lock;
+  dt_cache_entry_t **table; // table_size slots, NULL is empty
+  uint32_t table_size;      // power of two
+  uint32_t count;           // entries in this shard
+  dt_cache_entry_t *lru;    // least recently used, first to be kicked
+  dt_cache_entry_t *mru;    // most recently used
+} __attribute__((aligned(64))) dt_cache_shard_t;
+
 typedef struct dt_cache_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_cache_shard_t *shards; // DT_CACHE_SHARDS stripes, each with its own lock
 
   size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
+  size_t cost;       // user supplied cost per cache line (bytes?), sum over all shards, updated atomically
   size_t cost_quota; // quota to try and meet. but don't use as hard limit.
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+  uint32_t gc_shard; // shard the next garbage collection starts at
 
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
@@ -97,10 +113,11 @@ void dt_cache_release_with_caller(dt_cache_t *cache,
 gboolean dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns FALSE on success, TRUE if the key was not found.
 gboolean dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
+// removes from the tip of the lru lists, until the fill ratio of the cache
 // goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
-// is locked)
+// shards are visited round robin, one at a time, so this approximates a
+// global lru order. will never block on an entry and never fail, but
+// sometimes not free memory (in case all is locked)
 void dt_cache_gc(dt_cache_t *cache,
                  const float fill_ratio);
 
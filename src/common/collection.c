@@ -50,6 +50,29 @@
 #define SELECT_QUERY "SELECT DISTINCT * FROM %s"
 #define LIMIT_QUERY "LIMIT ?1, ?2"
 
+// query results kept per collection
+#define DT_COLLECTION_MAX_RESULTS 8
+
+/* the result of a query: the image ids in order, or only their number
+ * when nothing else was needed. it stays valid as long as nothing which
+ * could change it has been written to the database, so going back to a
+ * previous filter or sort order does not run the query again. */
+typedef struct _collection_result_t
+{
+  gchar *query;
+  int changes; // dt_database_get_data_changes() before the query ran
+  uint32_t count;
+  GArray *ids;
+} _collection_result_t;
+
+/* the ids in memory.collected_images, in rowid order. NULL when unknown. */
+static GArray *_collected_ids = NULL;
+
+/* the collections are updated from job threads as well as from the gui,
+ * this protects the query results of all of them and _collected_ids */
+static dt_pthread_mutex_t _results_mutex;
+static gsize _results_mutex_initialized = 0;
+
 /* Stores the collection query, returns 1 if changed.. */
 static int _dt_collection_store(const dt_collection_t *collection,
                                 gchar *query,
@@ -82,6 +105,12 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
 {
   dt_collection_t *collection = g_malloc0(sizeof(dt_collection_t));
 
+  if(g_once_init_enter(&_results_mutex_initialized))
+  {
+    dt_pthread_mutex_init(&_results_mutex, NULL);
+    g_once_init_leave(&_results_mutex_initialized, 1);
+  }
+
   /* initialize collection context*/
   if(clone) /* if clone is provided let's copy it into this context */
   {
@@ -110,10 +139,21 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
   return collection;
 }
 
+static void _collection_result_free(gpointer data)
+{
+  _collection_result_t *r = data;
+  g_free(r->query);
+  if(r->ids) g_array_free(r->ids, TRUE);
+  g_free(r);
+}
+
 void dt_collection_free(const dt_collection_t *collection)
 {
   DT_CONTROL_SIGNAL_DISCONNECT_ALL(collection, "collection");
 
+  dt_pthread_mutex_lock(&_results_mutex);
+  g_list_free_full(collection->results, _collection_result_free);
+  dt_pthread_mutex_unlock(&_results_mutex);
   g_free(collection->query);
   g_free(collection->query_no_group);
   g_strfreev(collection->where_ext);
@@ -147,43 +187,199 @@ static char * and_operator(int *term)
   assert(0); // Not reached.
 }
 
-void dt_collection_memory_update()
+static _collection_result_t *_collection_result_lookup(const dt_collection_t *collection,
+                                                       const gchar *query,
+                                                       const gboolean need_ids)
 {
-  if(!darktable.collection || !darktable.db) return;
-  sqlite3_stmt *stmt;
+  dt_collection_t *c = (dt_collection_t *)collection;
+  const int changes = dt_database_get_data_changes(darktable.db);
+  for(GList *l = c->results; l; l = g_list_next(l))
+  {
+    _collection_result_t *r = l->data;
+    if(strcmp(r->query, query)) continue;
 
-  /* check if we can get a query from collection */
-  gchar *query = g_strdup(dt_collection_get_query(darktable.collection));
-  if(!query) return;
+    // a shuffled order is drawn again on each query
+    if(r->changes != changes || (need_ids && !r->ids) || strstr(query, "RANDOM()"))
+    {
+      c->results = g_list_delete_link(c->results, l);
+      _collection_result_free(r);
+      return NULL;
+    }
+    // most recently used first
+    c->results = g_list_remove_link(c->results, l);
+    c->results = g_list_concat(l, c->results);
+    return r;
+  }
+  return NULL;
+}
 
-  // we have a new query for the collection of images to display. For
-  // speed reason we collect all images into a temporary (in-memory)
-  // table (collected_images).
+static _collection_result_t *_collection_result_store(const dt_collection_t *collection,
+                                                      const gchar *query,
+                                                      const int changes,
+                                                      const uint32_t count,
+                                                      GArray *ids)
+{
+  dt_collection_t *c = (dt_collection_t *)collection;
+  _collection_result_t *r = g_malloc0(sizeof(_collection_result_t));
+  r->query = g_strdup(query);
+  r->changes = changes;
+  r->count = count;
+  r->ids = ids;
 
-  // 1. drop previous data
+  c->results = g_list_prepend(c->results, r);
+  while(g_list_length(c->results) > DT_COLLECTION_MAX_RESULTS)
+  {
+    GList *last = g_list_last(c->results);
+    _collection_result_free(last->data);
+    c->results = g_list_delete_link(c->results, last);
+  }
+  return r;
+}
 
+static _collection_result_t *_collection_read_ids(const dt_collection_t *collection,
+                                                  const gchar *query)
+{
+  const int changes = dt_database_get_data_changes(darktable.db);
+  GArray *ids = g_array_new(FALSE, FALSE, sizeof(dt_imgid_t));
+
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+  }
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(ids, imgid);
+  }
+  sqlite3_finalize(stmt);
+
+  return _collection_result_store(collection, query, changes, ids->len, ids);
+}
+
+// TRUE if memory.collected_images still holds _collected_ids as far as
+// its size and last row tell. this is cheap and catches the table being
+// written or rolled back behind our back.
+static gboolean _collection_memory_check(void)
+{
+  if(!_collected_ids) return FALSE;
+
+  const guint len = _collected_ids->len;
+  sqlite3_stmt *stmt;
   // clang-format off
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM memory.collected_images",
-                        NULL, NULL, NULL);
-  // reset autoincrement. need in star_key_accel_callback
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
-                        "DELETE FROM memory.sqlite_sequence"
-                        " WHERE name='collected_images'",
-                        NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT COUNT(*),"
+                              "       (SELECT imgid FROM memory.collected_images WHERE rowid = ?1)"
+                              " FROM memory.collected_images",
+                              -1, &stmt, NULL);
   // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, len);
+  gboolean ok = FALSE;
+  if(sqlite3_step(stmt) == SQLITE_ROW)
+    ok = sqlite3_column_int(stmt, 0) == len
+         && (len == 0 || sqlite3_column_int(stmt, 1) == g_array_index(_collected_ids, dt_imgid_t, len - 1));
+  sqlite3_finalize(stmt);
+  return ok;
+}
 
-  // 2. insert collected images into the temporary table
-  gchar *ins_query = g_strdup_printf("INSERT INTO memory.collected_images (imgid) %s", query);
+// bring memory.collected_images to the given ids. the rowid is the
+// position in the collection, so the rows in front of the first
+// difference are kept and only the rest is written again. called with
+// _results_mutex held.
+static void _collection_memory_sync(const GArray *ids)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), ins_query, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
-  sqlite3_step(stmt);
+  if(!_collection_memory_check() && _collected_ids)
+  {
+    g_array_free(_collected_ids, TRUE);
+    _collected_ids = NULL;
+  }
+
+  guint keep = 0;
+  if(_collected_ids)
+  {
+    while(keep < _collected_ids->len && keep < ids->len
+          && g_array_index(_collected_ids, dt_imgid_t, keep) == g_array_index(ids, dt_imgid_t, keep))
+      keep++;
+    if(keep == _collected_ids->len && keep == ids->len) return;
+  }
+
+  // unknown until the rows below are written
+  if(_collected_ids) g_array_free(_collected_ids, TRUE);
+  _collected_ids = NULL;
+
+  dt_database_start_transaction(darktable.db);
+  sqlite3_stmt *stmt;
+  if(keep == 0)
+  {
+    // clang-format off
+    DT_DEBUG_SQLITE3_EXEC(db, "DELETE FROM memory.collected_images", NULL, NULL, NULL);
+    // reset autoincrement. need in star_key_accel_callback
+    DT_DEBUG_SQLITE3_EXEC(db,
+                          "DELETE FROM memory.sqlite_sequence"
+                          " WHERE name='collected_images'",
+                          NULL, NULL, NULL);
+    // clang-format on
+  }
+  else
+  {
+    DT_DEBUG_SQLITE3_PREPARE_V2(db, "DELETE FROM memory.collected_images WHERE rowid > ?1",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, keep);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                                "UPDATE memory.sqlite_sequence SET seq = ?1"
+                                " WHERE name='collected_images'",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, keep);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(db,
+                              "INSERT INTO memory.collected_images (rowid, imgid) VALUES (?1, ?2)",
+                              -1, &stmt, NULL);
+  gboolean failed = FALSE;
+  for(guint i = keep; i < ids->len && !failed; i++)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, i + 1);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, g_array_index(ids, dt_imgid_t, i));
+    failed = sqlite3_step(stmt) != SQLITE_DONE;
+    sqlite3_reset(stmt);
+  }
   sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
 
-  g_free(query);
-  g_free(ins_query);
+  // on failure the next update writes everything again
+  if(!failed)
+  {
+    _collected_ids = g_array_sized_new(FALSE, FALSE, sizeof(dt_imgid_t), ids->len);
+    g_array_append_vals(_collected_ids, ids->data, ids->len);
+  }
+}
+
+void dt_collection_memory_update()
+{
+  if(!darktable.collection || !darktable.db) return;
+
+  /* check if we can get a query from collection */
+  const gchar *query = dt_collection_get_query(darktable.collection);
+  if(!query) return;
+
+  // we have a new query for the collection of images to display. For
+  // speed reason we collect all images into a temporary (in-memory)
+  // table (collected_images). the query only runs if its result is not
+  // known yet.
+  dt_pthread_mutex_lock(&_results_mutex);
+  _collection_result_t *r = _collection_result_lookup(darktable.collection, query, TRUE);
+  if(!r) r = _collection_read_ids(darktable.collection, query);
+
+  _collection_memory_sync(r->ids);
+  dt_pthread_mutex_unlock(&_results_mutex);
 }
 
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection,
@@ -868,6 +1064,18 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
   const gchar *query = no_group
     ? dt_collection_get_query_no_group(collection)
     : dt_collection_get_query(collection);
+
+  dt_pthread_mutex_lock(&_results_mutex);
+  const _collection_result_t *r = _collection_result_lookup(collection, query, FALSE);
+  // the images of the shown collection are collected right after, so read them at once
+  if(!r && collection == darktable.collection
+     && !g_strcmp0(query, dt_collection_get_query(collection)))
+    r = _collection_read_ids(collection, query);
+  if(r) count = r->count;
+  dt_pthread_mutex_unlock(&_results_mutex);
+  if(r) return count;
+
+  const int changes = dt_database_get_data_changes(darktable.db);
   gchar *count_query = NULL;
 
   gchar *fq = g_strstr_len(query, strlen(query), "FROM");
@@ -885,6 +1093,9 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection,
 
   sqlite3_finalize(stmt);
   g_free(count_query);
+  dt_pthread_mutex_lock(&_results_mutex);
+  _collection_result_store(collection, query, changes, count, NULL);
+  dt_pthread_mutex_unlock(&_results_mutex);
   return count;
 }
 
@@ -164,6 +164,7 @@ typedef struct dt_collection_t
   uint32_t tagid;
   dt_collection_params_t params;
   dt_collection_params_t store;
+  GList *results; // results of the recent queries, most recent first
 } dt_collection_t;
 
 /* returns the name for the given collection property */
@@ -1064,6 +1064,156 @@ cmsHPROFILE dt_colorspaces_make_temporary_profile(cmsHPROFILE profile)
   return profile;
 }
 
+// idle transforms kept for the next user, the least recently used ones go first
+#define DT_COLORSPACES_IDLE_TRANSFORMS 16
+
+typedef struct dt_colorspaces_transform_t
+{
+  gchar *key;
+  cmsHTRANSFORM xform;
+  int users;
+  uint64_t last_used;
+} dt_colorspaces_transform_t;
+
+static void _transform_free(gpointer data)
+{
+  dt_colorspaces_transform_t *t = data;
+  cmsDeleteTransform(t->xform);
+  g_free(t->key);
+  free(t);
+}
+
+static void _transform_key_add_profile(GChecksum *checksum, cmsHPROFILE profile)
+{
+  // the profile id is the md5 of the profile, if the file came with one we are done
+  cmsUInt8Number id[16] = { 0 };
+  cmsGetHeaderProfileID(profile, id);
+  gboolean has_id = FALSE;
+  for(int k = 0; k < 16; k++) has_id |= id[k] != 0;
+  if(has_id)
+  {
+    g_checksum_update(checksum, id, sizeof(id));
+    return;
+  }
+
+  // otherwise the serialized profile is hashed, the built-in ones are small
+  cmsUInt32Number size = 0;
+  if(cmsSaveProfileToMem(profile, NULL, &size) && size > 0)
+  {
+    guchar *data = g_malloc(size);
+    if(cmsSaveProfileToMem(profile, data, &size))
+      g_checksum_update(checksum, data, size);
+    g_free(data);
+  }
+  else
+    g_checksum_update(checksum, (const guchar *)&profile, sizeof(profile));
+}
+
+static gchar *_transform_key(cmsHPROFILE input,
+                             const cmsUInt32Number input_format,
+                             cmsHPROFILE output,
+                             const cmsUInt32Number output_format,
+                             cmsHPROFILE proofing,
+                             const int intent,
+                             const int proofing_intent,
+                             const cmsUInt32Number flags)
+{
+  GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
+  _transform_key_add_profile(checksum, input);
+  _transform_key_add_profile(checksum, output);
+  if(proofing) _transform_key_add_profile(checksum, proofing);
+  const uint32_t params[5] = { input_format, output_format, intent,
+                               proofing ? proofing_intent : -1, flags };
+  g_checksum_update(checksum, (const guchar *)params, sizeof(params));
+  gchar *key = g_strdup(g_checksum_get_string(checksum));
+  g_checksum_free(checksum);
+  return key;
+}
+
+static void _transform_trim(dt_colorspaces_t *self)
+{
+  while(TRUE)
+  {
+    int idle = 0;
+    dt_colorspaces_transform_t *oldest = NULL;
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, self->transforms);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      dt_colorspaces_transform_t *t = value;
+      if(t->users) continue;
+      idle++;
+      if(!oldest || t->last_used < oldest->last_used) oldest = t;
+    }
+    if(idle <= DT_COLORSPACES_IDLE_TRANSFORMS) return;
+    g_hash_table_remove(self->transform_users, oldest->xform);
+    g_hash_table_remove(self->transforms, oldest->key);
+  }
+}
+
+cmsHTRANSFORM dt_colorspaces_get_transform(cmsHPROFILE input,
+                                           const cmsUInt32Number input_format,
+                                           cmsHPROFILE output,
+                                           const cmsUInt32Number output_format,
+                                           cmsHPROFILE proofing,
+                                           const int intent,
+                                           const int proofing_intent,
+                                           const cmsUInt32Number flags)
+{
+  if(!input || !output) return NULL;
+
+  dt_colorspaces_t *self = darktable.color_profiles;
+  gchar *key = _transform_key(input, input_format, output, output_format,
+                              proofing, intent, proofing_intent, flags);
+
+  // held while creating, so that two pipelines asking for the same transform create it once
+  dt_pthread_mutex_lock(&self->transform_lock);
+  dt_colorspaces_transform_t *t = g_hash_table_lookup(self->transforms, key);
+  if(t)
+    g_free(key);
+  else
+  {
+    cmsHTRANSFORM xform = cmsCreateProofingTransform(input, input_format, output, output_format,
+                                                     proofing, intent, proofing_intent, flags);
+    if(!xform)
+    {
+      dt_pthread_mutex_unlock(&self->transform_lock);
+      g_free(key);
+      return NULL;
+    }
+    t = calloc(1, sizeof(dt_colorspaces_transform_t));
+    t->key = key;
+    t->xform = xform;
+    g_hash_table_insert(self->transforms, t->key, t);
+    g_hash_table_insert(self->transform_users, xform, t);
+    dt_print(DT_DEBUG_DEV, "[colorspaces] new transform %s, %u cached",
+             key, g_hash_table_size(self->transforms));
+  }
+  t->users++;
+  t->last_used = ++self->transform_clock;
+  cmsHTRANSFORM xform = t->xform;
+  dt_pthread_mutex_unlock(&self->transform_lock);
+  return xform;
+}
+
+void dt_colorspaces_release_transform(cmsHTRANSFORM xform)
+{
+  if(!xform) return;
+
+  dt_colorspaces_t *self = darktable.color_profiles;
+  dt_pthread_mutex_lock(&self->transform_lock);
+  dt_colorspaces_transform_t *t = g_hash_table_lookup(self->transform_users, xform);
+  if(t)
+  {
+    // kept for the next user unless too many are idle
+    if(--t->users == 0) _transform_trim(self);
+  }
+  else
+    dt_print(DT_DEBUG_ALWAYS, "[colorspaces] releasing a transform which is not cached");
+  dt_pthread_mutex_unlock(&self->transform_lock);
+}
+
 void dt_colorspaces_get_profile_name(cmsHPROFILE p,
                                      const char *language,
                                      const char *country,
@@ -1402,6 +1552,10 @@ dt_colorspaces_t *dt_colorspaces_init()
 
   pthread_rwlock_init(&res->xprofile_lock, NULL);
 
+  dt_pthread_mutex_init(&res->transform_lock, NULL);
+  res->transforms = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _transform_free);
+  res->transform_users = g_hash_table_new(g_direct_hash, g_direct_equal);
+
   int in_pos = -1,
       out_pos = -1,
       display_pos = -1,
@@ -1716,6 +1870,10 @@ void dt_colorspaces_cleanup(dt_colorspaces_t *self)
   }
   g_list_free_full(self->profiles, free);
 
+  g_hash_table_destroy(self->transform_users);
+  g_hash_table_destroy(self->transforms);
+  dt_pthread_mutex_destroy(&self->transform_lock);
+
   pthread_rwlock_destroy(&self->xprofile_lock);
   g_free(self->colord_profile_file);
   g_free(self->xprofile_data);
@@ -191,6 +191,12 @@ typedef struct dt_colorspaces_t
   cmsHTRANSFORM transform_srgb_to_display, transform_adobe_rgb_to_display;
   cmsHTRANSFORM transform_srgb_to_display2, transform_adobe_rgb_to_display2;
 
+  // lcms2 transforms shared by all pipelines, see dt_colorspaces_get_transform()
+  dt_pthread_mutex_t transform_lock;
+  GHashTable *transforms;      // key -> dt_colorspaces_transform_t
+  GHashTable *transform_users; // cmsHTRANSFORM -> dt_colorspaces_transform_t
+  uint64_t transform_clock;
+
 } dt_colorspaces_t;
 
 typedef struct dt_colorspaces_color_profile_t
@@ -253,7 +259,7 @@ cmsHPROFILE dt_colorspaces_get_rgb_profile_from_mem(uint8_t *data,
 void dt_colorspaces_cleanup_profile(cmsHPROFILE p);
 
 /** extracts tonecurves and color matrix prof to XYZ from a given input profile, returns 0 on success (curves
- * and matrix are inverted for input) */
+ * and matrix are inverted for input). pass NULL luts to only get the matrix, a lut needs at least 2 samples. */
 int dt_colorspaces_get_matrix_from_input_profile(cmsHPROFILE prof,
                                                  dt_colormatrix_t matrix,
                                                  float *lutr,
@@ -262,7 +268,7 @@ int dt_colorspaces_get_matrix_from_input_profile(cmsHPROFILE prof,
                                                  const int lutsize);
 
 /** extracts tonecurves and color matrix prof to XYZ from a given
- * output profile, returns 0 on success. */
+ * output profile, returns 0 on success. luts as for the input profile. */
 int dt_colorspaces_get_matrix_from_output_profile(cmsHPROFILE prof,
                                                   dt_colormatrix_t matrix,
                                                   float *lutr,
@@ -273,6 +279,24 @@ int dt_colorspaces_get_matrix_from_output_profile(cmsHPROFILE prof,
 /** create a temporary profile to be removed by dt_colorspaces_cleanup_profile */
 cmsHPROFILE dt_colorspaces_make_temporary_profile(cmsHPROFILE profile);
 
+/** get a transform like cmsCreateProofingTransform() would create it,
+ * proofing may be NULL. transforms are kept in a process-wide cache and
+ * shared by all their users, profiles are told apart by their content so
+ * a temporary copy of a profile finds the same transform. NULL if lcms2
+ * cannot create it, otherwise give it back with
+ * dt_colorspaces_release_transform(). */
+cmsHTRANSFORM dt_colorspaces_get_transform(cmsHPROFILE input,
+                                           const cmsUInt32Number input_format,
+                                           cmsHPROFILE output,
+                                           const cmsUInt32Number output_format,
+                                           cmsHPROFILE proofing,
+                                           const int intent,
+                                           const int proofing_intent,
+                                           const cmsUInt32Number flags);
+
+/** release a transform from dt_colorspaces_get_transform(), NULL is ignored */
+void dt_colorspaces_release_transform(cmsHTRANSFORM xform);
+
 /** wrapper to get the name from a color profile. this tries to handle character encodings. */
 void dt_colorspaces_get_profile_name(cmsHPROFILE p,
                                      const char *language,
@@ -51,6 +51,7 @@
 #include "common/points.h"
 #include "common/resource_limits.h"
 #include "common/undo.h"
+#include "common/wavelet.h"
 #include "common/gimp.h"
 #include "common/pfm.h"
 #include "control/conf.h"
@@ -62,6 +63,7 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/tiling.h"
 #include "gui/accelerators.h"
 #include "gui/workspace.h"
 #include "gui/gtk.h"
@@ -1841,6 +1843,8 @@ int dt_init(int argc,
   dt_image_cache_init();
 
   dt_mipmap_cache_init();
+  dt_wavelet_pool_init();
+  dt_tiling_init();
 
   // set up the list of exiv2 metadata
   dt_exif_set_exiv2_taglist();
@@ -2180,6 +2184,7 @@ void dt_cleanup()
 
   dt_image_cache_cleanup();
   dt_mipmap_cache_cleanup();
+  dt_wavelet_pool_cleanup();
 
   dt_colorspaces_cleanup(darktable.color_profiles);
   dt_conf_cleanup(darktable.conf);
@@ -330,6 +330,7 @@ typedef struct dt_sys_resources_t
   int *fractions;   // fractions are calculated as res=input / 1024  * fraction
   int *refresource; // for the debug resource modes we use fixed settings
   int level;
+  int export_jobs;  // pipelines of darktable-cli and darktable-generate-cache --jobs, they split the available memory
 } dt_sys_resources_t;
 
 typedef struct dt_backthumb_t
@@ -566,6 +567,13 @@ static inline void dt_lock_image(const dt_imgid_t imgid)
   dt_pthread_mutex_lock(&(darktable.db_image[imgid & (DT_IMAGE_DBLOCKS-1)]));
 }
 
+// returns TRUE if the image has been locked
+static inline gboolean dt_trylock_image(const dt_imgid_t imgid)
+  TRY_ACQUIRE(TRUE, darktable.db_image[imgid & (DT_IMAGE_DBLOCKS-1)])
+{
+  return dt_pthread_mutex_trylock(&(darktable.db_image[imgid & (DT_IMAGE_DBLOCKS-1)])) == 0;
+}
+
 static inline void dt_unlock_image(const dt_imgid_t imgid)
   RELEASE(darktable.db_image[imgid & (DT_IMAGE_DBLOCKS-1)])
 {
@@ -43,6 +43,7 @@
 #include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 
 // NEVER change these; after these versions, NEVER update _create_*_schema(), either
 // For consistency and reducing duplication / effort, after these versions, the full schema
@@ -51,14 +52,32 @@
 #define LAST_FULL_DATABASE_VERSION_DATA    10
 
 // You HAVE TO bump THESE versions whenever you add an update branches to _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 57
+#define CURRENT_DATABASE_VERSION_LIBRARY 58
 #define CURRENT_DATABASE_VERSION_DATA    13
 
 #define USE_NESTED_TRANSACTIONS
 #define MAX_NESTED_TRANSACTIONS 5
+// seconds a transaction waits for a batch before it acts, see _transaction_enter()
+#define MAX_BATCH_WAIT 2
 /* transaction id */
 static dt_atomic_int _trxid;
 
+/* transactions against batches, see dt_database_start_batch() */
+typedef enum _batch_state_t
+{
+  _BATCH_NONE,
+  _BATCH_WAITING,   // for the open transactions to end
+  _BATCH_RUNNING,
+  _BATCH_SUSPENDED  // committed early for another thread, until its owner releases it
+} _batch_state_t;
+
+static dt_pthread_mutex_t _trx_mutex;
+static pthread_cond_t _trx_cond;
+static int _trx_users = 0;  // transactions started and not yet ended
+static _batch_state_t _batch = _BATCH_NONE;
+static pthread_t _batch_thread;
+static int _batch_depth = 0; // transactions of the batch thread open inside the batch
+
 typedef struct dt_database_t
 {
   gboolean lock_acquired;
@@ -74,8 +93,18 @@ typedef struct dt_database_t
 
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* idle statements of dt_database_prepare_cached(), sql text -> sqlite3_stmt */
+  dt_pthread_mutex_t stmt_cache_mutex;
+  GHashTable *stmt_cache;
+
+  /* rows changed in the persistent tables, see dt_database_get_data_changes() */
+  dt_atomic_int data_changes;
 } dt_database_t;
 
+// statements kept at most by dt_database_release_cached()
+#define MAX_CACHED_STATEMENTS 64
+
 
 /* migrates database from old place to new */
 static void _database_migrate_to_xdg_structure();
@@ -2967,6 +2996,19 @@ static int _upgrade_library_schema_step(dt_database_t *db,
              "[init] can't add `flash_tagvalue' column to images table in database\n");
     new_version = 57;
   }
+  else if(version == 57)
+  {
+    // covering indexes for the common sort orders of the collection
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_datetime_sort_index"
+             " ON images (datetime_taken, filename, version)",
+             "[init] can't create index `images_datetime_sort_index'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_rating_sort_index"
+             " ON images ((CASE WHEN flags & 8 = 8 THEN -1 ELSE flags & 7 END), filename, version)",
+             "[init] can't create index `images_rating_sort_index'");
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.color_labels_color_index ON color_labels (color, imgid)",
+             "[init] can't create index `color_labels_color_index'");
+    new_version = 58;
+  }
   else
     new_version = version; // should be the fallback so that calling code sees that we are in an infinite loop
 
@@ -3480,6 +3522,14 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle,
                "CREATE INDEX main.images_datetime_taken_nc ON images (datetime_taken)",
                NULL, NULL, NULL);
+  // covering indexes for the common sort orders of the collection
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_datetime_sort_index ON images (datetime_taken, filename, version)",
+               NULL, NULL, NULL);
+  sqlite3_exec(db->handle,
+               "CREATE INDEX main.images_rating_sort_index"
+               " ON images ((CASE WHEN flags & 8 = 8 THEN -1 ELSE flags & 7 END), filename, version)",
+               NULL, NULL, NULL);
 
   ////////////////////////////// selected_images
   sqlite3_exec(db->handle,
@@ -3523,6 +3573,8 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle, "CREATE INDEX main.tagged_images_position_index ON tagged_images (position)", NULL, NULL, NULL);
   ////////////////////////////// color_labels
   sqlite3_exec(db->handle, "CREATE TABLE main.color_labels (imgid INTEGER, color INTEGER)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.color_labels_color_index ON color_labels (color, imgid)", NULL, NULL,
+               NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.color_labels_idx ON color_labels (imgid, color)", NULL, NULL,
                NULL);
   ////////////////////////////// meta_data
@@ -4249,6 +4301,12 @@ gchar* _get_pragma_string_val(sqlite3 *db,
   return val;
 }
 
+static void _database_update_hook(void *data,
+                                  const int op,
+                                  const char *dbname,
+                                  const char *table,
+                                  const sqlite3_int64 rowid);
+
 dt_database_t *dt_database_init(const char *alternative,
                                 const gboolean load_data,
                                 const gboolean has_gui)
@@ -4340,10 +4398,13 @@ start:
 
   /* create database */
   dt_database_t *db = g_malloc0(sizeof(dt_database_t));
+  dt_pthread_mutex_init(&db->stmt_cache_mutex, NULL);
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
 
   dt_atomic_set_int(&_trxid, 0);
+  dt_pthread_mutex_init(&_trx_mutex, NULL);
+  pthread_cond_init(&_trx_cond, NULL);
 
   /* make sure the folder exists. this might not be the case for new databases */
   /* also check if a database backup is needed */
@@ -4397,6 +4458,8 @@ start:
     return NULL;
   }
 
+  sqlite3_update_hook(db->handle, _database_update_hook, db);
+
   /* attach a memory database to db connection for use with temporary tables
      used during instance life time, which is discarded on exit.
   */
@@ -4886,8 +4949,79 @@ void dt_upgrade_maker_model(const dt_database_t *db)
   sqlite3_finalize(stmt);
 }
 
+static void _database_update_hook(void *data,
+                                  const int op,
+                                  const char *dbname,
+                                  const char *table,
+                                  const sqlite3_int64 rowid)
+{
+  dt_database_t *db = data;
+  // the collected images are written from cached results and no query depends on the selection
+  if(!g_strcmp0(table, "selected_images")
+     || (!g_strcmp0(dbname, "memory")
+         && (!g_strcmp0(table, "collected_images") || !g_strcmp0(table, "sqlite_sequence"))))
+    return;
+  dt_atomic_add_int(&db->data_changes, 1);
+}
+
+int dt_database_get_data_changes(const dt_database_t *db)
+{
+  return dt_atomic_get_int(&((dt_database_t *)db)->data_changes);
+}
+
+static void _database_clear_stmt_cache(const dt_database_t *db)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  dt_pthread_mutex_lock(&d->stmt_cache_mutex);
+  if(d->stmt_cache) g_hash_table_destroy(d->stmt_cache);
+  d->stmt_cache = NULL;
+  dt_pthread_mutex_unlock(&d->stmt_cache_mutex);
+}
+
+sqlite3_stmt *dt_database_prepare_cached(const dt_database_t *db, const char *sql)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  sqlite3_stmt *stmt = NULL;
+
+  dt_pthread_mutex_lock(&d->stmt_cache_mutex);
+  gpointer key = NULL;
+  if(d->stmt_cache && g_hash_table_lookup_extended(d->stmt_cache, sql, &key, (gpointer *)&stmt))
+  {
+    g_hash_table_steal(d->stmt_cache, sql);
+    g_free(key);
+  }
+  dt_pthread_mutex_unlock(&d->stmt_cache_mutex);
+
+  if(!stmt)
+    DT_DEBUG_SQLITE3_PREPARE_V2(d->handle, sql, -1, &stmt, NULL);
+  return stmt;
+}
+
+void dt_database_release_cached(const dt_database_t *db, sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+  dt_database_t *d = (dt_database_t *)db;
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  dt_pthread_mutex_lock(&d->stmt_cache_mutex);
+  if(!d->stmt_cache)
+    d->stmt_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)sqlite3_finalize);
+  const char *sql = sqlite3_sql(stmt);
+  // another thread had the same query out at the same time, one of them is enough
+  const gboolean keep = !g_hash_table_contains(d->stmt_cache, sql)
+                        && g_hash_table_size(d->stmt_cache) < MAX_CACHED_STATEMENTS;
+  if(keep) g_hash_table_insert(d->stmt_cache, g_strdup(sql), stmt);
+  dt_pthread_mutex_unlock(&d->stmt_cache_mutex);
+
+  if(!keep) sqlite3_finalize(stmt);
+}
+
 void dt_database_destroy(const dt_database_t *db)
 {
+  _database_clear_stmt_cache(db);
   sqlite3_close(db->handle);
   if(db->lockfile_data)
   {
@@ -4901,6 +5035,7 @@ void dt_database_destroy(const dt_database_t *db)
   }
   g_free(db->dbfilename_data);
   g_free(db->dbfilename_library);
+  dt_pthread_mutex_destroy(&((dt_database_t *)db)->stmt_cache_mutex);
   g_free((dt_database_t *)db);
 
   sqlite3_shutdown();
@@ -4973,6 +5108,8 @@ gboolean dt_database_get_lock_acquired(const dt_database_t *db)
 
 void dt_database_cleanup_busy_statements(const dt_database_t *db)
 {
+  // the cached ones are not leaks, they are finalized by the cache
+  _database_clear_stmt_cache(db);
   sqlite3_stmt *stmt = NULL;
   while( (stmt = sqlite3_next_stmt(db->handle, NULL)) != NULL)
   {
@@ -5830,8 +5967,75 @@ gchar *dt_database_get_most_recent_snap(const char* db_filename)
 //       transaction routines. And it has been done to help further implementation for
 //       proper threading and nested transaction support.
 //
+static gboolean _batch_owner(void)
+{
+  return _batch != _BATCH_NONE && pthread_equal(_batch_thread, pthread_self());
+}
+
+// commits a running batch for another thread. only done while no transaction of the batch
+// thread is open inside it, so that no savepoint of that thread is closed with it.
+static gboolean _suspend_batch(const dt_database_t *db)
+{
+  if(_batch != _BATCH_RUNNING || _batch_depth > 0)
+    return FALSE;
+  if(sqlite3_exec(dt_database_get(db), "COMMIT TRANSACTION", NULL, NULL, NULL) != SQLITE_OK)
+    return FALSE;
+
+  dt_atomic_sub_int(&_trxid, 1);
+  _batch = _BATCH_SUSPENDED;
+  dt_print(DT_DEBUG_ALWAYS,
+           "[dt_database_start_transaction] batch committed early after waiting %ds",
+           MAX_BATCH_WAIT);
+  return TRUE;
+}
+
+static void _transaction_enter(const dt_database_t *db)
+{
+  dt_pthread_mutex_lock(&_trx_mutex);
+  if(_batch == _BATCH_RUNNING && _batch_owner())
+  {
+    // the transactions of the batch thread nest into the batch
+    _batch_depth++;
+  }
+  else
+  {
+    // a running batch keeps every other transaction waiting, a batch waiting to start only
+    // the top level ones. the nested ones go on so that the open transactions can end.
+    // a transaction never nests into the batch of another thread: the batch could end it.
+    // as the batch thread could itself wait for a lock this thread holds, a wait running
+    // out commits the batch between two of its transactions instead.
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += MAX_BATCH_WAIT;
+    while(_batch == _BATCH_RUNNING || (_batch == _BATCH_WAITING && _trx_users == 0))
+    {
+      if(pthread_cond_timedwait(&_trx_cond, &_trx_mutex.mutex, &deadline) == ETIMEDOUT)
+      {
+        if(_suspend_batch(db))
+          break;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += MAX_BATCH_WAIT;
+      }
+    }
+  }
+  _trx_users++;
+  dt_pthread_mutex_unlock(&_trx_mutex);
+}
+
+static void _transaction_leave(void)
+{
+  dt_pthread_mutex_lock(&_trx_mutex);
+  if(_batch == _BATCH_RUNNING && _batch_owner() && _batch_depth > 0)
+    _batch_depth--;
+  if(_trx_users > 0) _trx_users--;
+  if(_trx_users == 0) pthread_cond_broadcast(&_trx_cond);
+  dt_pthread_mutex_unlock(&_trx_mutex);
+}
+
 void dt_database_start_transaction(const dt_database_t *db)
 {
+  _transaction_enter(db);
+
   const int trxid = dt_atomic_add_int(&_trxid, 1);
 
   // if top level a simple unamed transaction is used BEGIN / COMMIT / ROLLBACK
@@ -5890,6 +6094,8 @@ void dt_database_release_transaction(const dt_database_t *db)
              trxid);
   }
 #endif
+
+  _transaction_leave();
 }
 
 void dt_database_rollback_transaction(const dt_database_t *db)
@@ -5918,6 +6124,62 @@ void dt_database_rollback_transaction(const dt_database_t *db)
              trxid);
   }
 #endif
+
+  _transaction_leave();
+}
+
+void dt_database_start_batch(const dt_database_t *db)
+{
+  dt_pthread_mutex_lock(&_trx_mutex);
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += MAX_BATCH_WAIT;
+
+  // the batch is an optimisation, rather than waiting long for one it is left out and the
+  // transactions of this thread run on their own
+  while(_batch != _BATCH_NONE)
+    if(pthread_cond_timedwait(&_trx_cond, &_trx_mutex.mutex, &deadline) == ETIMEDOUT)
+    {
+      dt_pthread_mutex_unlock(&_trx_mutex);
+      dt_print(DT_DEBUG_SQL, "[dt_database_start_batch] another batch is running, none started");
+      return;
+    }
+
+  _batch = _BATCH_WAITING;
+  _batch_thread = pthread_self();
+  while(_trx_users > 0)
+    if(pthread_cond_timedwait(&_trx_cond, &_trx_mutex.mutex, &deadline) == ETIMEDOUT)
+    {
+      _batch = _BATCH_NONE;
+      pthread_cond_broadcast(&_trx_cond);
+      dt_pthread_mutex_unlock(&_trx_mutex);
+      dt_print(DT_DEBUG_SQL, "[dt_database_start_batch] transactions still open, none started");
+      return;
+    }
+
+  // the batch is the top level transaction, the ones of its thread become savepoints
+  _batch = _BATCH_RUNNING;
+  _batch_depth = 0;
+  dt_atomic_add_int(&_trxid, 1);
+  DT_DEBUG_SQLITE3_EXEC(dt_database_get(db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+  dt_pthread_mutex_unlock(&_trx_mutex);
+}
+
+void dt_database_release_batch(const dt_database_t *db)
+{
+  dt_pthread_mutex_lock(&_trx_mutex);
+  // nothing to do if the batch was not started, or was committed early for another thread
+  if(_batch_owner())
+  {
+    if(_batch == _BATCH_RUNNING)
+    {
+      dt_atomic_sub_int(&_trxid, 1);
+      DT_DEBUG_SQLITE3_EXEC(dt_database_get(db), "COMMIT TRANSACTION", NULL, NULL, NULL);
+    }
+    _batch = _BATCH_NONE;
+    pthread_cond_broadcast(&_trx_cond);
+  }
+  dt_pthread_mutex_unlock(&_trx_mutex);
 }
 
 // clang-format off
@@ -57,12 +57,34 @@ char **dt_database_snaps_to_remove(const struct dt_database_t *db);
 gchar *dt_database_get_most_recent_snap(const char* db_filename);
 
 int32_t dt_database_last_insert_rowid(const struct dt_database_t *);
+
+/** prepared statements kept for reuse, for queries run again and again such as per image on import.
+  * take one with dt_database_prepare_cached(), bind and step it as usual, then give it back with
+  * dt_database_release_cached() instead of sqlite3_finalize(). the sql text is the key, the statement
+  * comes back reset with cleared bindings. */
+struct sqlite3_stmt *dt_database_prepare_cached(const struct dt_database_t *db, const char *sql);
+void dt_database_release_cached(const struct dt_database_t *db, struct sqlite3_stmt *stmt);
+
+/** a counter of the rows inserted, updated or deleted through the connection, apart from the
+  * collected images and the selection. a cached query result is still valid as long as it
+  * has not changed. */
+int dt_database_get_data_changes(const struct dt_database_t *db);
 // nested transactions support
 
 void dt_database_start_transaction(const struct dt_database_t *db);
 void dt_database_release_transaction(const struct dt_database_t *db);
 void dt_database_rollback_transaction(const struct dt_database_t *db);
 
+/** a batch is a top level transaction for a single writer such as an import. it waits for
+  * the open transactions to end and keeps the ones of other threads waiting until it is
+  * released, so that they never nest into it. transactions started on the thread of the
+  * batch nest into it as savepoints. as the batch thread may wait for a lock held by a
+  * thread which waits for it, such a wait running out for a few seconds commits the batch
+  * early, between two transactions of the batch thread. starting a batch gives up after a
+  * few seconds too, the transactions then run on their own. keep batches short. */
+void dt_database_start_batch(const struct dt_database_t *db);
+void dt_database_release_batch(const struct dt_database_t *db);
+
 void dt_upgrade_maker_model(const struct dt_database_t *db);
 
 G_END_DECLS
@@ -19,6 +19,7 @@
 #include "common/darktable.h"
 #include "common/imagebuf.h"
 #include "control/control.h"
+#include "common/wavelet.h"
 #include "develop/imageop.h"
 #include "dwt.h"
 
@@ -109,113 +110,6 @@ static void dwt_get_image_layer(float *const layer, dwt_params_t *const p)
     dt_iop_image_copy_by_size(p->image, layer, p->width, p->height, p->ch);
 }
 
-// first, "vertical" pass of wavelet decomposition
-static void dwt_decompose_vert(float *const restrict out, const float *const restrict in,
-                               const size_t height, const size_t width, const size_t lev)
-{
-  const size_t vscale = MIN(1 << lev, height-1);
-  DT_OMP_FOR()
-  for(int rowid = 0; rowid < height ; rowid++)
-  {
-    const size_t row = dwt_interleave_rows(rowid,height,vscale);
-    // perform a weighted sum of the current pixel row with the rows 'scale' pixels above and below
-    // if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
-    // i.e. we move as many rows in from the edge as we would have been beyond the edge
-    // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
-    //   we need to reflect around height
-    const size_t rowstart = (size_t)4 * row * width;
-    const size_t above_row = (row > vscale) ? row - vscale : vscale - row;
-    const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
-    const float* const restrict center = in + rowstart;
-    const float* const restrict above = in + 4 * above_row * width;
-    const float* const restrict below = in + 4 * below_row * width;
-    float* const restrict temprow = out + rowstart;
-    for(size_t col = 0; col < 4*width; col += 4)
-    {
-      for_each_channel(c,aligned(center, above, below, temprow : 16))
-      {
-        temprow[col + c] = 2.f * center[col+c] + above[col+c] + below[col+c];
-      }
-    }
-  }
-}
-
-// second, horizontal pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites
-//   the input buffer with 'details'
-static void dwt_decompose_horiz(
-    float *const restrict out,
-    float *const restrict in,
-    float *const temp,
-    size_t padded_size,
-    const size_t height,
-    const size_t width,
-    const size_t lev)
-{
-  const int hscale = MIN(1 << lev, width);  //(int because we need a signed difference below)
-  DT_OMP_FOR()
-  for(int row = 0; row < height ; row++)
-  {
-    // perform a weighted sum of the current pixel with the ones 'scale' pixels to the left and right, using
-    // reflection to get a value if either of those positions is out of bounds, i.e. we move as many columns
-    // in from the edge as we would have been beyond the edge to avoid an additional pass, we also rescale the
-    // final sum and split the original input into 'coarse' and 'details' by subtracting the scaled sum from
-    // the original input.
-    const size_t rowindex = (size_t)4 * (row * width);
-    float* const restrict temprow = dt_get_perthread(temp,padded_size);
-    float* const restrict details = in + rowindex;
-    float* const restrict coarse = out + rowindex;
-
-    for(int col = 0; col < width - hscale; col++)
-    {
-      const size_t leftpos = (size_t)4*abs(col-hscale);	// the abs() handles reflection at the left edge
-      const size_t rightpos = (size_t)4*(col+hscale);
-      for_each_channel(c,aligned(temprow, details, coarse : 16))
-      {
-        const float left = coarse[leftpos+c];
-        const float right = coarse[rightpos+c];
-        // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-        const float hat = (2.f * coarse[4*col+c] + left + right) / 16.f;
-        // the normalized value is our 'coarse' result; 'details' is the difference between original input and 'coarse'
-        temprow[4*col+c] = hat;
-        details[4*col+c] -= hat;
-      }
-    }
-    // handle reflection at right edge
-    for(int col = width - hscale; col < width; col++)
-    {
-      const size_t leftpos = (size_t)4 * abs(col-hscale); // still need to handle reflection, if hscale>=width/2
-      const size_t rightpos = (size_t)4 * (2*width - 2 - (col+hscale));
-      for_each_channel(c,aligned(temprow, details, coarse : 16))
-      {
-        const float left = coarse[leftpos+c];
-        const float right = coarse[rightpos+c];
-        // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-        const float hat = (2.f * coarse[4*col+c] + left + right) / 16.f;
-        // the normalized value is our 'coarse' result; 'details' is the difference between original input and 'coarse'
-        temprow[4*col+c] = hat;
-        details[4*col+c] -= hat;
-      }
-    }
-    // now that we're done with the row of pixels, we can overwrite the intermediate result from the
-    // first pass with the final decomposition
-    memcpy(coarse, temprow, sizeof(float) * 4 * width);
-  }
-}
-
-// split input into 'coarse' and 'details'; put 'details' back into the input buffer
-static void dwt_decompose_layer(
-    float *const restrict out,
-    float *const restrict in,
-    float *const temp,
-    size_t padded_size,
-    const int lev,
-    const dwt_params_t *const p)
-{
-  dwt_decompose_vert(out, in, p->height, p->width, lev);
-  dwt_decompose_horiz(out, in, temp, padded_size, p->height, p->width, lev);
-  return;
-}
-
 /* actual decomposing algorithm */
 static void dwt_wavelet_decompose(float *img,
                                   dwt_params_t *const p,
@@ -223,10 +117,10 @@ static void dwt_wavelet_decompose(float *img,
 {
   assert(p->ch == 4);
 
-  float *temp = NULL;		// scratch buffer for decomposition
   float *layers = NULL;		// buffer to reconstruct the image
   float *merged_layers = NULL;
   float *buffer[2] = { 0, 0 };
+  float *scratch = NULL;
 
   if(layer_func) layer_func(img, p, 0);
 
@@ -236,20 +130,21 @@ static void dwt_wavelet_decompose(float *img,
   /* image buffers */
   buffer[0] = img;
 
-  /* allocate temporary storage */
-  dt_iop_roi_t roi = { .x = 0, .y = 0, .height = p->height, .width = p->width };
-  size_t padded_size;
+  /* allocate temporary storage, the reconstruction is only needed when
+     the whole image is returned */
+  const size_t nfloats = (size_t)4 * p->width * p->height;
   const int do_merge = p->merge_from_scale > 0;
-  if(!dt_iop_alloc_image_buffers(NULL, &roi, &roi,
-                                 4 | DT_IMGSZ_INPUT, &buffer[1],
-                                 4 | DT_IMGSZ_INPUT | DT_IMGSZ_CLEARBUF, &layers,
-                                 4 | DT_IMGSZ_WIDTH | DT_IMGSZ_PERTHREAD, &temp, &padded_size,
-                                 (do_merge ? 4 | DT_IMGSZ_INPUT | DT_IMGSZ_CLEARBUF : 0), &merged_layers,
-                                 0, NULL))
+  const int do_layers = p->return_layer == 0;
+  buffer[1] = dt_wavelet_alloc(nfloats);
+  scratch = dt_wavelet_hat_alloc_scratch(p->width, p->ch);
+  if(do_layers) layers = dt_wavelet_alloc_clear(nfloats);
+  if(do_merge) merged_layers = dt_wavelet_alloc_clear(nfloats);
+  // everything is allocated up front, img is overwritten by the first scale
+  if(!buffer[1] || !scratch || (do_layers && !layers) || (do_merge && !merged_layers))
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[dwt] unable to alloc working memory, skipping wavelet decomposition");
-    return;
+    goto cleanup;
   }
 
   // iterate over wavelet scales
@@ -259,7 +154,10 @@ static void dwt_wavelet_decompose(float *img,
   {
     unsigned int lpass = (1 - (lev & 1));
 
-    dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, padded_size, lev, p);
+    // split into 'coarse' and 'details', the details replace the finer level
+    dt_wavelet_hat_decompose(buffer[lpass], buffer[hpass], NULL, 0.0f,
+                             p->width, p->height, p->ch, lev, scratch);
+    dt_wavelet_detail(buffer[hpass], buffer[lpass], nfloats);
 
     // no merge scales or we didn't reach the merge scale from yet
     if(p->merge_from_scale == 0 || p->merge_from_scale > lev + 1)
@@ -337,11 +235,11 @@ static void dwt_wavelet_decompose(float *img,
     }
   }
 
-  dt_free_align(temp);
-  dt_free_align(layers);
-  dt_free_align(buffer[1]);
-  if(merged_layers)
-    dt_free_align(merged_layers);
+cleanup:
+  dt_wavelet_free(scratch);
+  dt_wavelet_free(layers);
+  dt_wavelet_free(buffer[1]);
+  dt_wavelet_free(merged_layers);
 }
 
 /* this function prepares for decomposing, which is done in the function dwt_wavelet_decompose() */
@@ -374,116 +272,6 @@ void dwt_decompose(dwt_params_t *p, _dwt_layer_func layer_func)
   dwt_wavelet_decompose(p->image, p, layer_func);
 }
 
-// first, "vertical" pass of wavelet decomposition
-static void dwt_denoise_vert_1ch(
-    float *const restrict out,
-    const float *const restrict in,
-    const size_t height,
-    const size_t width,
-    const size_t lev)
-{
-  const int vscale = MIN(1 << lev, height);
-  DT_OMP_FOR()
-  for(int rowid = 0; rowid < height ; rowid++)
-  {
-    const int row = dwt_interleave_rows(rowid,height,vscale);
-    // perform a weighted sum of the current pixel row with the rows 'scale' pixels above and below
-    // if either of those is beyond the edge of the image, we use reflection to get a value for averaging,
-    // i.e. we move as many rows in from the edge as we would have been beyond the edge
-    // for the top edge, this means we can simply use the absolute value of row-vscale; for the bottom edge,
-    //   we need to reflect around height
-    const size_t rowstart = (size_t)row * width;
-    const size_t below_row = (row + vscale < height) ? (row + vscale) : 2*(height-1) - (row + vscale);
-    const float *const restrict center = in + rowstart;
-    const float *const restrict above =  in + abs(row - vscale) * width;
-    const float *const restrict below = in + below_row * width;
-    float* const restrict outrow = out + rowstart;
-    DT_OMP_SIMD()
-    for(int col= 0; col < width; col++)
-    {
-      outrow[col] = 2.f * center[col] + above[col] + below[col];
-    }
-  }
-}
-
-// second, horizontal pass of wavelet decomposition; generates 'coarse' into the output buffer and overwrites
-//   the input buffer with 'details'
-static void dwt_denoise_horiz_1ch(
-    float *const restrict out,
-    float *const restrict in,
-    float *const restrict accum,
-    const size_t height,
-    const size_t width,
-    const size_t lev,
-    const float thold,
-    const int last)
-{
-  const int hscale = MIN(1 << lev, width);
-  DT_OMP_FOR()
-  for(int row = 0; row < height ; row++)
-  {
-    // perform a weighted sum of the current pixel with the ones 'scale' pixels to the left and right, using
-    // reflection to get a value if either of those positions is out of bounds, i.e. we move as many columns
-    // in from the edge as we would have been beyond the edge to avoid an additional pass, we also rescale the
-    // final sum and split the original input into 'coarse' and 'details' by subtracting the scaled sum from
-    // the original input.
-    const size_t rowindex = (size_t)row * width;
-    float *const restrict details = in + rowindex;
-    float *const restrict coarse = out + rowindex;
-    float *const restrict accum_row = accum + rowindex;
-    // handle reflection at left edge
-    DT_OMP_SIMD()
-    for(int col = 0; col < hscale; col++)
-    {
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[hscale-col] + coarse[col+hscale]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
-      // alternatives produces exactly the same result, and *that* does get vectorized
-      //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    DT_OMP_SIMD()
-    for(int col = hscale; col < width - hscale; col++)
-    {
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + coarse[col+hscale]) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      // GCC8 won't vectorize if we use the following line, but it turns out that just adding the two conditional
-      // alternatives produces exactly the same result, and *that* does get vectorized
-      //const float excess = diff < 0.0 ? MIN(diff + thold, 0.0f) : MAX(diff - thold, 0.0f);
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    // handle reflection at right edge
-    DT_OMP_SIMD()
-    for(int col = width - hscale; col < width; col++)
-    {
-      const float right = coarse[2*width - 2 - (col+hscale)];
-      // add up left/center/right, and renormalize by dividing by the total weight of all numbers added together
-      const float hat = (2.f * coarse[col] + coarse[col-hscale] + right) / 16.f;
-      // the normalized value is our 'coarse' result; 'diff' is the difference between original input and 'coarse'
-      // (which would ordinarily be stored as the details scale, but we don't need it any further)
-      const float diff = details[col] - hat;
-      details[col] = hat;		// done with original input, so we can overwrite it with 'coarse'
-      accum_row[col] += MAX(diff - thold,0.0f) + MIN(diff + thold, 0.0f);
-    }
-    if(last)
-    {
-      // add the details to the residue to create the final denoised result
-      for(int col = 0; col < width; col++)
-      {
-        details[col] += accum_row[col];
-      }
-    }
-  }
-}
-
 /* this function denoises an image by decomposing it into the specified number of wavelet scales and
  * recomposing the result from just the portion of each scale which exceeds the magnitude of the given
  * threshold for that scale.
@@ -494,32 +282,41 @@ void dwt_denoise(float *const img,
                  const int bands,
                  const float *const noise)
 {
-  float *const details = dt_alloc_align_float((size_t)2 * width * height);
-  if(!details)
+  const size_t npixels = (size_t)width * height;
+  float *const details = dt_wavelet_alloc_clear(npixels);
+  float *const interm = dt_wavelet_alloc(npixels);	// coarse scale of each pass
+  float *const scratch = dt_wavelet_hat_alloc_scratch(width, 1);
+  if(!details || !interm || !scratch)
   {
     dt_print(DT_DEBUG_ALWAYS,"[dwt_denoise] unable to alloc working memory, skipping denoise");
+    dt_wavelet_free(details);
+    dt_wavelet_free(interm);
+    dt_wavelet_free(scratch);
     return;
   }
-  float *const interm = details + width * height;	// temporary storage for use during each pass
-
-  // zero the accumulator
-  dt_iop_image_fill(details, 0.0f, width, height, 1);
 
+  // the coarse scale of each pass is the input of the next one, the two
+  // buffers trade places. the portion of each detail scale that is above
+  // the noise threshold is accumulated into 'details' while the scale is
+  // computed, so it is never stored.
+  float *fine = img;
+  float *coarse = interm;
   for(int lev = 0; lev < bands; lev++)
   {
-    const int last = (lev+1) == bands;
-
-    // "vertical" pass, averages pixels with those 'scale' rows above
-    // and below and puts result in 'interm'
-    dwt_denoise_vert_1ch(interm, img, height, width, lev);
-    // horizontal filtering pass, averages pixels in 'interm' with
-    // those 'scale' rows to the left and right
-    // accumulates the portion of the detail scale that is above the
-    // noise threshold into 'details'; this will be added to the
-    // residue left in 'img' on the last iteration
-    dwt_denoise_horiz_1ch(interm, img, details, height, width, lev, noise[lev], last);
+    dt_wavelet_hat_decompose(coarse, fine, details, noise[lev], width, height, 1, lev, scratch);
+    float *const swap = fine;
+    fine = coarse;
+    coarse = swap;
   }
-  dt_free_align(details);
+
+  // add the details to the residue to create the final denoised result
+  DT_OMP_FOR_SIMD()
+  for(size_t k = 0; k < npixels; k++)
+    img[k] = fine[k] + details[k];
+
+  dt_wavelet_free(scratch);
+  dt_wavelet_free(interm);
+  dt_wavelet_free(details);
 }
 
 #ifdef HAVE_OPENCL
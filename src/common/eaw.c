@@ -263,12 +263,10 @@ static inline float dn_weight(const float *c1, const float *c2, const float inv_
     det[c] = (px[c] - sum[c]);									             \
     sum_sq[c] += (det[c]*det[c]);					                                     \
   }                                                                       				     \
-  copy_pixel_nontemporal(pdetail, det);                                                                      \
   px += 4;                                                                                                   \
-  pdetail += 4;                                                                                              \
   pcoarse += 4;
 
-void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
+void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
                       dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
                       const int32_t width, const int32_t height)
 {
@@ -293,7 +291,6 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
     const size_t j = dwt_interleave_rows(rowid, height, mult);
     const float *px = ((float *)in) + (size_t)4 * j * width;
     const float *px2;
-    float *pdetail = detail + (size_t)4 * j * width;
     float *pcoarse = out + (size_t)4 * j * width;
 
     // for the first and last 'boundary' rows, we have to perform boundary tests for the entire row;
@@ -366,6 +363,26 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
 #undef SUM_PIXEL_PROLOGUE
 #undef SUM_PIXEL_EPILOGUE
 
+void eaw_dn_synthesize(float *const restrict out, const float *const restrict fine,
+                       const float *const restrict coarse, const float *const restrict threshold,
+                       const float *const restrict boost, const int32_t width, const int32_t height)
+{
+  const dt_aligned_pixel_t thresh = { threshold[0], threshold[1], threshold[2], threshold[3] };
+  const dt_aligned_pixel_t boostval = { boost[0], boost[1], boost[2], boost[3] };
+  const size_t npixels = (size_t)width * height;
+
+  DT_OMP_FOR()
+  for(size_t k = 0; k < npixels; k++)
+  {
+    // the detail band is the difference of two consecutive scales, it is
+    // cheaper to recompute than to store and read back
+    dt_aligned_pixel_t detail;
+    for_four_channels(c, aligned(fine, coarse))
+      detail[c] = fine[4*k + c] - coarse[4*k + c];
+    accumulate(out + 4*k, detail, thresh, boostval);
+  }
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
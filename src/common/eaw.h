@@ -46,14 +46,26 @@ void eaw_synthesize(float *const restrict out,
                     const int32_t width,
                     const int32_t height);
 
-typedef void((*eaw_dn_decompose_t)(float *const restrict out, const float *const restrict in, float *const restrict detail,
+// writes the coarse scale to out and the sum of the squared details to sum_squared, the details
+// themselves are not stored: eaw_dn_synthesize() recomputes them from in and out
+typedef void((*eaw_dn_decompose_t)(float *const restrict out, const float *const restrict in,
                                    dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
                                    const int32_t width, const int32_t height));
 
-void eaw_dn_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
+void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
                       dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
                       const int32_t width, const int32_t height);
 
+// adds the thresholded and boosted details fine - coarse to out
+typedef void((*eaw_dn_synthesize_t)(float *const restrict out, const float *const restrict fine,
+                                    const float *const restrict coarse, const float *const restrict thrsf,
+                                    const float *const restrict boostf, const int32_t width,
+                                    const int32_t height));
+
+void eaw_dn_synthesize(float *const restrict out, const float *const restrict fine,
+                       const float *const restrict coarse, const float *const restrict thrsf,
+                       const float *const restrict boostf, const int32_t width, const int32_t height);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -35,6 +35,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
 
@@ -2514,31 +2515,15 @@ gboolean dt_exif_get_thumbnail(const char *path,
   }
 }
 
-/* Read the metadata of an image.
- * XMP data trumps IPTC data trumps EXIF data.
- */
-gboolean dt_exif_read(dt_image_t *img,
-                      const char *path)
+// decode the metadata of an opened image into img. mono_preview is the result of
+// dt_imageio_has_mono_preview(path) if already known, -1 otherwise.
+static gboolean _exif_read_image(dt_image_t *img,
+                                 const char *path,
+                                 Exiv2::Image *image,
+                                 const int mono_preview)
 {
-  if(!img)
-  {
-    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_read] failed as no img was provided");
-    return TRUE;
-  }
-  // At least set 'datetime taken' to something useful in case there is
-  // no Exif data in this file (pfm, png, ...)
-  struct stat statbuf;
-
-  if(!stat(path, &statbuf))
-  {
-    dt_datetime_unix_to_img(img, &statbuf.st_mtime);
-  }
-
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
     bool res = true;
 
     // EXIF metadata
@@ -2551,7 +2536,7 @@ gboolean dt_exif_read(dt_image_t *img,
         const int oldflags =
           dt_image_monochrome_flags(img)
           | (img->flags & DT_IMAGE_MONOCHROME_WORKFLOW);
-        if(dt_imageio_has_mono_preview(path))
+        if(mono_preview >= 0 ? mono_preview : dt_imageio_has_mono_preview(path))
           img->flags |= (DT_IMAGE_MONOCHROME_PREVIEW
                          | DT_IMAGE_MONOCHROME_WORKFLOW);
         else
@@ -2597,6 +2582,241 @@ gboolean dt_exif_read(dt_image_t *img,
   }
 }
 
+// At least set 'datetime taken' to something useful in case there is
+// no Exif data in this file (pfm, png, ...)
+static void _exif_read_file_datetime(dt_image_t *img, const char *path)
+{
+  struct stat statbuf;
+
+  if(!stat(path, &statbuf))
+  {
+    dt_datetime_unix_to_img(img, &statbuf.st_mtime);
+  }
+}
+
+/* Read the metadata of an image.
+ * XMP data trumps IPTC data trumps EXIF data.
+ */
+gboolean dt_exif_read(dt_image_t *img,
+                      const char *path)
+{
+  if(!img)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[dt_exif_read] failed as no img was provided");
+    return TRUE;
+  }
+  _exif_read_file_datetime(img, path);
+
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    assert(image.get() != 0);
+    read_metadata_threadsafe(image);
+    return _exif_read_image(img, path, image.get(), -1);
+  }
+  catch(const Exiv2::AnyError &e)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[exiv2 dt_exif_read] %s: %s",
+             path,
+             e.what());
+    return TRUE;
+  }
+}
+
+// metadata read ahead for an import, see dt_exif_prefetch_start()
+
+typedef enum dt_exif_prefetch_state_t
+{
+  DT_EXIF_PREFETCH_PENDING,
+  DT_EXIF_PREFETCH_RUNNING,
+  DT_EXIF_PREFETCH_DONE,
+  DT_EXIF_PREFETCH_TAKEN
+} dt_exif_prefetch_state_t;
+
+typedef struct dt_exif_prefetch_entry_t
+{
+  char *filename;                     // a copy of the one given, the key
+  dt_exif_prefetch_state_t state;
+  Exiv2::Image *image;                // NULL if it could not be read
+  int mono_preview;                   // -1 if not known
+} dt_exif_prefetch_entry_t;
+
+struct dt_exif_prefetch_t
+{
+  dt_pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  dt_exif_prefetch_entry_t *entries;
+  GHashTable *index;                  // filename -> entry
+  size_t count;
+  size_t next;                        // next entry for a worker
+  size_t consumed;                    // entries before this one have been taken
+  size_t window;                      // how far workers may read ahead of consumed
+  gboolean stop;
+  int num_threads;
+  pthread_t *threads;
+};
+
+static void _exif_prefetch_entry(dt_exif_prefetch_entry_t *e)
+{
+  char *path = dt_util_normalize_path(e->filename);
+  if(!path) return;
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image;
+    {
+      Lock lock;
+      image = Exiv2::ImageFactory::open(WIDEN(path));
+      assert(image.get() != 0);
+      image->readMetadata();
+    }
+    if(!image->exifData().empty() && dt_conf_get_bool("ui/detect_mono_exif"))
+      e->mono_preview = dt_imageio_has_mono_preview(path) ? 1 : 0;
+    e->image = image.release();
+  }
+  catch(const Exiv2::AnyError &ex)
+  {
+    // left to dt_exif_read() on the importing thread, which reports it
+    e->image = NULL;
+  }
+  g_free(path);
+}
+
+static void *_exif_prefetch_worker(void *data)
+{
+  dt_exif_prefetch_t *pf = (dt_exif_prefetch_t *)data;
+  dt_pthread_setname("exif prefetch");
+
+  dt_pthread_mutex_lock(&pf->mutex);
+  while(!pf->stop)
+  {
+    if(pf->next < pf->count && pf->next < pf->consumed + pf->window)
+    {
+      dt_exif_prefetch_entry_t *e = &pf->entries[pf->next++];
+      if(e->state != DT_EXIF_PREFETCH_PENDING) continue;
+      e->state = DT_EXIF_PREFETCH_RUNNING;
+      dt_pthread_mutex_unlock(&pf->mutex);
+
+      _exif_prefetch_entry(e);
+
+      dt_pthread_mutex_lock(&pf->mutex);
+      e->state = DT_EXIF_PREFETCH_DONE;
+      pthread_cond_broadcast(&pf->cond);
+    }
+    else if(pf->next >= pf->count)
+      break;
+    else
+      dt_pthread_cond_wait(&pf->cond, &pf->mutex);
+  }
+  dt_pthread_mutex_unlock(&pf->mutex);
+  return NULL;
+}
+
+dt_exif_prefetch_t *dt_exif_prefetch_start(GList *filenames)
+{
+  const size_t count = g_list_length(filenames);
+  if(count < 2) return NULL;
+
+  dt_exif_prefetch_t *pf = (dt_exif_prefetch_t *)g_malloc0(sizeof(dt_exif_prefetch_t));
+  pf->entries = (dt_exif_prefetch_entry_t *)g_malloc0(count * sizeof(dt_exif_prefetch_entry_t));
+  pf->index = g_hash_table_new(g_str_hash, g_str_equal);
+  for(GList *f = filenames; f; f = g_list_next(f))
+  {
+    dt_exif_prefetch_entry_t *e = &pf->entries[pf->count];
+    // copied: the workers may still look at it after the caller is done with the list
+    e->filename = g_strdup((const char *)f->data);
+    e->state = DT_EXIF_PREFETCH_PENDING;
+    e->mono_preview = -1;
+    // a file listed twice is only read ahead once
+    if(!g_hash_table_contains(pf->index, e->filename))
+      g_hash_table_insert(pf->index, (gpointer)e->filename, e);
+    else
+      e->state = DT_EXIF_PREFETCH_TAKEN;
+    pf->count++;
+  }
+
+  // exiv2 is only entered under its lock, so more threads would only wait for each other.
+  // two keep the lock busy while one of them checks for a mono preview.
+  pf->num_threads = 2;
+  pf->window = 16;
+  dt_pthread_mutex_init(&pf->mutex, NULL);
+  pthread_cond_init(&pf->cond, NULL);
+  pf->threads = (pthread_t *)g_malloc0(pf->num_threads * sizeof(pthread_t));
+  int started = 0;
+  for(int k = 0; k < pf->num_threads; k++)
+    if(!dt_pthread_create(&pf->threads[started], _exif_prefetch_worker, pf))
+      started++;
+  pf->num_threads = started;
+  if(!started)
+  {
+    dt_exif_prefetch_stop(pf);
+    return NULL;
+  }
+
+  dt_print(DT_DEBUG_PERF, "[exif prefetch] %zu files, %d threads", pf->count, started);
+  return pf;
+}
+
+gboolean dt_exif_read_prefetched(dt_image_t *img,
+                                 const char *path,
+                                 dt_exif_prefetch_t *prefetch,
+                                 const char *filename)
+{
+  if(!img || !prefetch) return dt_exif_read(img, path);
+
+  dt_pthread_mutex_lock(&prefetch->mutex);
+  dt_exif_prefetch_entry_t *e =
+    (dt_exif_prefetch_entry_t *)g_hash_table_lookup(prefetch->index, filename);
+  if(e)
+  {
+    while(e->state == DT_EXIF_PREFETCH_RUNNING)
+      dt_pthread_cond_wait(&prefetch->cond, &prefetch->mutex);
+    if(e->state == DT_EXIF_PREFETCH_TAKEN)
+      e = NULL;
+    else
+    {
+      // if not read yet, it is read here and the workers skip it
+      e->state = DT_EXIF_PREFETCH_TAKEN;
+      prefetch->consumed = MAX(prefetch->consumed, (size_t)(e - prefetch->entries) + 1);
+      pthread_cond_broadcast(&prefetch->cond);
+    }
+  }
+  dt_pthread_mutex_unlock(&prefetch->mutex);
+
+  if(!e || !e->image) return dt_exif_read(img, path);
+
+  std::unique_ptr<Exiv2::Image> image(e->image);
+  e->image = NULL;
+  _exif_read_file_datetime(img, path);
+  return _exif_read_image(img, path, image.get(), e->mono_preview);
+}
+
+void dt_exif_prefetch_stop(dt_exif_prefetch_t *prefetch)
+{
+  if(!prefetch) return;
+
+  dt_pthread_mutex_lock(&prefetch->mutex);
+  prefetch->stop = TRUE;
+  pthread_cond_broadcast(&prefetch->cond);
+  dt_pthread_mutex_unlock(&prefetch->mutex);
+  for(int k = 0; k < prefetch->num_threads; k++)
+    pthread_join(prefetch->threads[k], NULL);
+  g_free(prefetch->threads);
+
+  // whatever the import did not get to, as it was cancelled
+  for(size_t k = 0; k < prefetch->count; k++)
+  {
+    delete prefetch->entries[k].image;
+    g_free(prefetch->entries[k].filename);
+  }
+
+  g_hash_table_destroy(prefetch->index);
+  pthread_cond_destroy(&prefetch->cond);
+  dt_pthread_mutex_destroy(&prefetch->mutex);
+  g_free(prefetch->entries);
+  g_free(prefetch);
+}
+
 int dt_exif_write_blob(uint8_t *blob,
                        uint32_t size,
                        const char *path,
@@ -6185,6 +6405,17 @@ static void _exif_log_handler(const int log_level,
   }
 }
 
+static std::recursive_mutex _exif_xmp_mutex;
+
+static void _exif_xmp_lock(void *data, bool lock)
+{
+  std::recursive_mutex *mutex = (std::recursive_mutex *)data;
+  if(lock)
+    mutex->lock();
+  else
+    mutex->unlock();
+}
+
 void dt_exif_init()
 {
   // Preface the Exiv2 messages with "[exiv2] "
@@ -6194,7 +6425,8 @@ void dt_exif_init()
   Exiv2::enableBMFF();
   #endif
 
-  Exiv2::XmpParser::initialize();
+  // the xmp toolkit is not thread safe by itself, exiv2 serialises its use with this lock
+  Exiv2::XmpParser::initialize(_exif_xmp_lock, &_exif_xmp_mutex);
 
   // This has to stay with the old url (namespace already propagated outside dt).
   Exiv2::XmpProperties::registerNs("http://darktable.sf.net/", "darktable");
@@ -80,6 +80,20 @@ void dt_exif_sanitize_datetime(char *datetime);
  * struct. returns TRUE if no success. */
 gboolean dt_exif_read(dt_image_t *img, const char *path);
 
+/** reads the metadata of a list of files ahead on two threads, for an import going through
+ * the list in the same order. decoding into the image struct, which also writes tags and metadata
+ * to the database, is left to dt_exif_read_prefetched() on the importing thread. NULL for less
+ * than two files. the filenames are copied, the list may be freed before dt_exif_prefetch_stop()
+ * but that must be called on every path leaving the import, cancellation included. */
+typedef struct dt_exif_prefetch_t dt_exif_prefetch_t;
+dt_exif_prefetch_t *dt_exif_prefetch_start(GList *filenames);
+/** same as dt_exif_read(), from the metadata read ahead for filename as passed to
+ * dt_exif_prefetch_start() if there is any. */
+gboolean dt_exif_read_prefetched(dt_image_t *img, const char *path, dt_exif_prefetch_t *prefetch,
+                                 const char *filename);
+/** waits for the threads and frees what has not been taken. */
+void dt_exif_prefetch_stop(dt_exif_prefetch_t *prefetch);
+
 /** read exif data to image struct from given data blob, wherever you got it from.
     returns TRUE in case of an error */
 gboolean dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
@@ -26,6 +26,12 @@
 
 #define BLOCKSIZE (1 << 6)
 
+// adjacent columns filtered together in the vertical pass of dt_gaussian_blur()
+#define GAUSS_COLUMNS 16
+// floats per transposed pixel in the horizontal pass, whole pixels of a strip of rows
+#define GAUSS_LANES 16
+#define GAUSS_MAX_LANES (4 * GAUSS_COLUMNS)
+
 static void _compute_gauss_params(const float sigma,
                                   dt_gaussian_order_t order,
                                   float *a0,
@@ -171,6 +177,7 @@ dt_gaussian_t *dt_gaussian_init(const int width,    // width of input image
   g->sigma = sigma;
   g->order = order;
   g->buf = NULL;
+  g->scratch = NULL;
   g->max = calloc(channels, sizeof(float));
   g->min = calloc(channels, sizeof(float));
 
@@ -185,9 +192,14 @@ dt_gaussian_t *dt_gaussian_init(const int width,    // width of input image
   g->buf = dt_alloc_align_float((size_t)channels * width * height);
   if(!g->buf) goto error;
 
+  // transposed strip of rows and its filtered copy for the horizontal pass
+  g->scratch = dt_alloc_perthread_float(2 * (size_t)width * GAUSS_LANES, &g->scratch_size);
+  if(!g->scratch) goto error;
+
   return g;
 
 error:
+  dt_free_align(g->scratch);
   dt_free_align(g->buf);
   free(g->max);
   free(g->min);
@@ -196,315 +208,193 @@ error:
 }
 
 
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+typedef struct _gauss_coeffs_t
 {
-
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
-
   float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  float *temp = g->buf;
-
-  float *Labmax = g->max;
-  float *Labmin = g->min;
-
-// vertical blur column by column
-  DT_OMP_FOR()
-  for(int i = 0; i < width; i++)
+} _gauss_coeffs_t;
+
+/* The recursive filter along `len` samples spaced `stride` floats apart,
+   for `n` adjacent floats at once. Each float is an independent lane with
+   its own clamping range, so the inner loops run in SIMD registers across
+   the lanes while the recursion runs down the samples. The arithmetic per
+   lane is the same as for a single column. */
+static inline void _gauss_lanes(const float *const restrict in,
+                                float *const restrict out,
+                                const size_t stride,
+                                const size_t len,
+                                const int n,
+                                const float *const restrict lmin,
+                                const float *const restrict lmax,
+                                const _gauss_coeffs_t *const c)
+{
+  const float a0 = c->a0, a1 = c->a1, a2 = c->a2, a3 = c->a3;
+  const float b1 = c->b1, b2 = c->b2;
+
+  // forward filter
+  float DT_ALIGNED_ARRAY xp[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY yb[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY yp[GAUSS_MAX_LANES];
+  for(int k = 0; k < n; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
-
-    // forward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        temp[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
-
-    // backward filter
-    for(int k = 0; k < ch; k++)
-    {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        temp[offset + k] += yc[k];
-      }
-    }
+    xp[k] = CLAMPF(in[k], lmin[k], lmax[k]);
+    yb[k] = xp[k] * c->coefp;
+    yp[k] = yb[k];
   }
 
-// horizontal blur line by line
-  DT_OMP_FOR()
-  for(int j = 0; j < height; j++)
+  for(size_t j = 0; j < len; j++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
-
-    // forward filter
-    for(int k = 0; k < ch; k++)
+    const float *const restrict row_in = in + j * stride;
+    float *const restrict row_out = out + j * stride;
+    DT_OMP_SIMD()
+    for(int k = 0; k < n; k++)
     {
-      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      const float xc = CLAMPF(row_in[k], lmin[k], lmax[k]);
+      const float yc = (a0 * xc) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+      row_out[k] = yc;
+      xp[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
     }
+  }
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        out[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+  // backward filter
+  float DT_ALIGNED_ARRAY xn[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY xa[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY yn[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY ya[GAUSS_MAX_LANES];
+  const float *const last = in + (len - 1) * stride;
+  for(int k = 0; k < n; k++)
+  {
+    xn[k] = CLAMPF(last[k], lmin[k], lmax[k]);
+    xa[k] = xn[k];
+    yn[k] = xn[k] * c->coefn;
+    ya[k] = yn[k];
+  }
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+  for(size_t j = len; j > 0; j--)
+  {
+    const float *const restrict row_in = in + (j - 1) * stride;
+    float *const restrict row_out = out + (j - 1) * stride;
+    DT_OMP_SIMD()
+    for(int k = 0; k < n; k++)
     {
-      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
+      const float xc = CLAMPF(row_in[k], lmin[k], lmax[k]);
+      const float yc = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xc;
       ya[k] = yn[k];
+      yn[k] = yc;
+      row_out[k] += yc;
     }
+  }
+}
 
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+/* vertical pass: blocks of GAUSS_COLUMNS adjacent columns are filtered
+   together, each row of a block is a few contiguous cache lines. */
+static void _gauss_vertical(const float *const in,
+                            float *const out,
+                            const size_t width,
+                            const size_t height,
+                            const int ch,
+                            const float *const lmin,
+                            const float *const lmax,
+                            const _gauss_coeffs_t *const c)
+{
+  const size_t rowfloats = width * ch;
+  const size_t block = (size_t)GAUSS_COLUMNS * ch;
+  const size_t nblocks = (rowfloats + block - 1) / block;
 
-        out[offset + k] += yc[k];
-      }
-    }
+  DT_OMP_FOR()
+  for(size_t b = 0; b < nblocks; b++)
+  {
+    const size_t start = b * block;
+    const int n = MIN(block, rowfloats - start);
+    _gauss_lanes(in + start, out + start, rowfloats, height, n, lmin, lmax, c);
   }
 }
 
-void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+/* horizontal pass: a strip of rows is transposed into the thread's scratch
+   buffer so that the pixels of one column of the strip are adjacent, run
+   through the same lane filter and transposed back. */
+static void _gauss_horizontal(const dt_gaussian_t *const g,
+                              const float *const in,
+                              float *const out,
+                              const int ch,
+                              const float *const lmin,
+                              const float *const lmax,
+                              const _gauss_coeffs_t *const c)
 {
-  assert(g->channels == 4);
   const size_t width = g->width;
   const size_t height = g->height;
+  const int rows = MAX(1, GAUSS_LANES / ch);
+  const int lanes = rows * ch;
+  const size_t nstrips = (height + rows - 1) / rows;
 
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  _compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  float *const temp = g->buf;
-
-  dt_aligned_pixel_t Labmin, Labmax;
-  copy_pixel(Labmin, g->min);
-  copy_pixel(Labmax, g->max);
-
-// vertical blur column by column
   DT_OMP_FOR()
-  for(size_t i = 0; i < width; i++)
+  for(size_t s = 0; s < nstrips; s++)
   {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(in[4*i + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
+    float *const restrict tin = dt_get_perthread(g->scratch, g->scratch_size);
+    float *const restrict tout = tin + width * lanes;
+    const size_t row0 = s * rows;
+    const int nrows = MIN(rows, height - row0);
 
-    dt_aligned_pixel_t xc;
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    for(size_t j = 0; j < height; j++)
+    for(int r = 0; r < nrows; r++)
     {
-      size_t offset = 4 * (j * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-      copy_pixel(temp + offset, yc);
+      const float *const restrict row = in + (row0 + r) * width * ch;
+      for(size_t i = 0; i < width; i++)
+        for(int k = 0; k < ch; k++)
+          tin[i * lanes + r * ch + k] = row[i * ch + k];
     }
 
-    // backward filter
-    dt_aligned_pixel_t yn;
-    dt_aligned_pixel_t ya;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(in[4*((height - 1) * width + i) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
+    _gauss_lanes(tin, tout, lanes, width, nrows * ch, lmin, lmax, c);
 
-    for(size_t j = height; j > 0; j--)
+    for(int r = 0; r < nrows; r++)
     {
-      size_t offset = 4 * ((j-1) * width + i);
-
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-        temp[offset + k] += yc[k];
-      }
+      float *const restrict row = out + (row0 + r) * width * ch;
+      for(size_t i = 0; i < width; i++)
+        for(int k = 0; k < ch; k++)
+          row[i * ch + k] = tout[i * lanes + r * ch + k];
     }
   }
+}
 
-// horizontal blur line by line
-  DT_OMP_FOR()
-  for(size_t j = 0; j < height; j++)
-  {
-    // forward filter
-    dt_aligned_pixel_t xp;
-    dt_aligned_pixel_t yb;
-    dt_aligned_pixel_t yp;
-    dt_aligned_pixel_t xc;
-    for_four_channels(k)
-    {
-      xp[k] = CLAMPF(temp[4*(j * width) + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-    }
-
-    for(size_t i = 0; i < width; i++)
-    {
-      size_t offset = 4 * (j * width + i);
-      dt_aligned_pixel_t yc;
-
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        out[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
-
-    // backward filter
-    dt_aligned_pixel_t xn;
-    dt_aligned_pixel_t xa;
-    dt_aligned_pixel_t ya;
-    dt_aligned_pixel_t yn;
-    for_four_channels(k)
-    {
-      xn[k] = CLAMPF(temp[4*((j + 1) * width - 1) + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
-    }
-
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = 4 * (j * width + i);
+static void _gauss_blur(dt_gaussian_t *g,
+                        const float *const in,
+                        float *const out,
+                        const int ch)
+{
+  _gauss_coeffs_t c;
+  _compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2, &c.coefp, &c.coefn);
 
-      dt_aligned_pixel_t yc;
-      for_four_channels(k)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
+  // clamping range per lane, lanes always start on a pixel boundary
+  float DT_ALIGNED_ARRAY lmin[GAUSS_MAX_LANES];
+  float DT_ALIGNED_ARRAY lmax[GAUSS_MAX_LANES];
+  for(int k = 0; k < GAUSS_MAX_LANES; k++)
+  {
+    lmin[k] = g->min[k % ch];
+    lmax[k] = g->max[k % ch];
+  }
 
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+  _gauss_vertical(in, g->buf, g->width, g->height, ch, lmin, lmax, &c);
+  _gauss_horizontal(g, g->buf, out, ch, lmin, lmax, &c);
+}
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  _gauss_blur(g, in, out, MIN(4, g->channels));
+}
 
-        out[offset + k] += yc[k];
-      }
-    }
-  }
+void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  assert(g->channels == 4);
+  _gauss_blur(g, in, out, 4);
 }
 
 void dt_gaussian_free(dt_gaussian_t *g)
 {
   if(!g) return;
   dt_free_align(g->buf);
+  dt_free_align(g->scratch);
   free(g->min);
   free(g->max);
   free(g);
@@ -38,6 +38,8 @@ typedef struct dt_gaussian_t
   float *max;
   float *min;
   float *buf;
+  float *scratch;      // per thread, for the horizontal pass
+  size_t scratch_size;
 } dt_gaussian_t;
 
 dt_gaussian_t *dt_gaussian_init(const int width, const int height, const int channels, const float *max,
@@ -1797,7 +1797,8 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
                                          const char *filename,
                                          const gboolean override_ignore_nonraws,
                                          const gboolean lua_locking,
-                                         const gboolean raise_signals)
+                                         const gboolean raise_signals,
+                                         dt_exif_prefetch_t *prefetch)
 {
   char *normalized_filename = dt_util_normalize_path(filename);
   if(!normalized_filename || !dt_util_test_image_file(normalized_filename))
@@ -1890,14 +1891,13 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
 
   //insert a v0 record (which may be updated later if no v0 xmp exists)
   // clang-format off
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+  stmt = dt_database_prepare_cached
+    (darktable.db,
      "INSERT INTO main.images (id, film_id, filename, flags, version, "
      "                         max_version, history_end, position, import_timestamp)"
      " SELECT NULL, ?1, ?2, ?3, 0, 0, 0,"
      "        (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4"
-     " FROM images",
-     -1, &stmt, NULL);
+     " FROM images");
   // clang-format on
 
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
@@ -1909,7 +1909,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   if(rc != SQLITE_DONE)
     dt_print(DT_DEBUG_ALWAYS,
              "[image_import_internal] sqlite3 error %d in `%s`", rc, filename);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 
   id = dt_image_get_id(film_id, imgfname);
 
@@ -1925,14 +1925,12 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
   // we need to change group representative
   if(dt_imageio_is_raw_by_extension(ext) || !strcmp(ext, "dng"))
   {
-    sqlite3_stmt *stmt2;
     // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_prepare_cached
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id", -1, &stmt2,
-      NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id");
     // clang-format on
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
@@ -1981,17 +1979,16 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     {
       group_id = id;
     }
-    sqlite3_finalize(stmt2);
+    dt_database_release_cached(darktable.db, stmt2);
   }
   else
   {
-    sqlite3_stmt *stmt2;
     // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_prepare_cached
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3", -1, &stmt2, NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3");
     // clang-format on
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
@@ -2000,16 +1997,15 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
       group_id = sqlite3_column_int(stmt2, 0);
     else
       group_id = id;
-    sqlite3_finalize(stmt2);
+    dt_database_release_cached(darktable.db, stmt2);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "UPDATE main.images SET group_id = ?1 WHERE id = ?2",
-     -1, &stmt, NULL);
+  stmt = dt_database_prepare_cached
+    (darktable.db,
+     "UPDATE main.images SET group_id = ?1 WHERE id = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, group_id);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, id);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
 
   // printf("[image_import] importing `%s' to img id %d\n", imgfname, id);
 
@@ -2021,7 +2017,7 @@ static dt_imgid_t _image_import_internal(const dt_filmid_t film_id,
     img->group_id = group_id;
 
     // read dttags and exif for database queries!
-    if(dt_exif_read(img, normalized_filename))
+    if(dt_exif_read_prefetched(img, normalized_filename, prefetch, filename))
       img->exif_inited = FALSE;
     char dtfilename[PATH_MAX] = { 0 };
     g_strlcpy(dtfilename, normalized_filename, sizeof(dtfilename));
@@ -2124,16 +2120,15 @@ dt_imgid_t dt_image_get_id(const dt_filmid_t film_id,
                            const gchar *filename)
 {
   dt_imgid_t id = NO_IMGID;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2",
-     -1, &stmt, NULL);
+  // run twice per imported image
+  sqlite3_stmt *stmt = dt_database_prepare_cached
+    (darktable.db,
+     "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, filename, -1, SQLITE_TRANSIENT);
   if(sqlite3_step(stmt) == SQLITE_ROW)
     id=sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  dt_database_release_cached(darktable.db, stmt);
   return id;
 }
 
@@ -2143,14 +2138,24 @@ dt_imgid_t dt_image_import(const dt_filmid_t film_id,
                            const gboolean raise_signals)
 {
   return _image_import_internal(film_id, filename, override_ignore_nonraws,
-                                TRUE, raise_signals);
+                                TRUE, raise_signals, NULL);
+}
+
+dt_imgid_t dt_image_import_prefetched(const dt_filmid_t film_id,
+                                      const char *filename,
+                                      const gboolean override_ignore_nonraws,
+                                      const gboolean raise_signals,
+                                      dt_exif_prefetch_t *prefetch)
+{
+  return _image_import_internal(film_id, filename, override_ignore_nonraws,
+                                TRUE, raise_signals, prefetch);
 }
 
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
                                const char *filename,
                                const gboolean override_ignore_nonraws)
 {
-  return _image_import_internal(film_id, filename, override_ignore_nonraws, FALSE, TRUE);
+  return _image_import_internal(film_id, filename, override_ignore_nonraws, FALSE, TRUE, NULL);
 }
 
 void dt_image_init(dt_image_t *img)
@@ -448,6 +448,14 @@ dt_imgid_t dt_image_import(dt_filmid_t film_id,
                            const char *filename,
                            const gboolean override_ignore_nonraws,
                            const gboolean raise_signals);
+struct dt_exif_prefetch_t;
+/** same as dt_image_import(), with the metadata of filename read ahead by prefetch (see
+ * dt_exif_prefetch_start()), NULL to read it here. */
+dt_imgid_t dt_image_import_prefetched(dt_filmid_t film_id,
+                                      const char *filename,
+                                      const gboolean override_ignore_nonraws,
+                                      const gboolean raise_signals,
+                                      struct dt_exif_prefetch_t *prefetch);
 /** imports a new image from raw/etc file and adds it to the data base
  * and image cache. Use from lua thread.*/
 dt_imgid_t dt_image_import_lua(const dt_filmid_t film_id,
@@ -48,6 +48,10 @@ enum border_mode
 // !! Make sure to sync this with the filter array !!
 #define MAX_HALF_FILTER_WIDTH 3
 
+/* Pixels of a row warped at once by dt_interpolation_warp4c(), their
+ * coordinates are kept on the stack */
+#define WARP_SPAN 256
+
 // Add *verbose* (like one msg per pixel out) debug message to stderr
 #define DEBUG_PRINT_VERBOSE 0
 
@@ -490,224 +494,423 @@ static inline void _compute_downsampling_kernel(const dt_interpolation_t *itor,
 }
 
 /* --------------------------------------------------------------------------
- * Sample interpolation function (see usage in iop/lens.c and iop/clipping.c)
+ * Upsampling tap tables
  * ------------------------------------------------------------------------*/
 
 #define MAX_KERNEL_REQ ((2 * (MAX_HALF_FILTER_WIDTH) + 3) & (~3))
 
-float dt_interpolation_compute_sample(const dt_interpolation_t *itor,
-                                      const float *in,
-                                      const float x,
-                                      const float y,
-                                      const int width,
-                                      const int height,
-                                      const int samplestride,
-                                      const int linestride)
-{
-  assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
-
-  float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
-  float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+// Number of fractional offsets per pixel for which the upsampling
+// kernels are tabulated, taps in between are interpolated linearly
+#define TAP_TABLE_PHASES 64
 
-  // Compute both horizontal and vertical kernels
-  float normh = _compute_upsampling_kernel(itor, kernelh, NULL, x);
-  float normv = _compute_upsampling_kernel(itor, kernelv, NULL, y);
+/* Normalized taps of each interpolator for the fractional offsets
+ * 0, 1/TAP_TABLE_PHASES, ... 1 of a sample position, plus one row so
+ * that an offset rounded up to 1.0f still has a right neighbour. Filled
+ * once by dt_interpolation_new() as every interpolator is obtained from
+ * there */
+static float DT_ALIGNED_ARRAY _tap_table[DT_INTERPOLATION_LAST][TAP_TABLE_PHASES + 2][MAX_KERNEL_REQ];
+static gsize _tap_table_ready = 0;
 
-  int ix = (int)x;
-  int iy = (int)y;
+static void _init_tap_tables(void)
+{
+  if(!g_once_init_enter(&_tap_table_ready)) return;
 
-  /* Now 2 cases, the pixel + filter width goes outside the image
-   * in that case we have to use index clipping to keep all reads
-   * in the input image (slow path) or we are sure it won't fall
-   * outside and can do more simple code */
-  float r;
-  if(ix >= (itor->width - 1)
-      && iy >= (itor->width - 1)
-      && ix < (width - itor->width)
-      && iy < (height - itor->width))
+  for(int i = DT_INTERPOLATION_FIRST; i < DT_INTERPOLATION_LAST; i++)
   {
-    // Inside image boundary case
-
-    // Go to top left pixel
-    in = (float *)in + linestride * iy + ix * samplestride;
-    in = in - (itor->width - 1) * (samplestride + linestride);
-
-    // Apply the kernel
-    float s = 0.f;
-    for(int i = 0; i < 2 * itor->width; i++)
+    const dt_interpolation_t *itor = &dt_interpolator[i];
+    const int taps = 2 * itor->width;
+    for(int p = 0; p <= TAP_TABLE_PHASES + 1; p++)
     {
-      float h = 0.0f;
-      for(int j = 0; j < 2 * itor->width; j++)
-      {
-        h += kernelh[j] * in[j * samplestride];
-      }
-      s += kernelv[i] * h;
-      in += linestride;
+      float *const kernel = _tap_table[i][p];
+      // same arguments as the upsampling kernel of a position p/TAP_TABLE_PHASES
+      const float t = (float)p / (float)TAP_TABLE_PHASES + (float)(itor->width - 1);
+      const float norm = itor->maketaps(kernel, taps, itor->width, t, -1.0f);
+      for(int k = 0; k < MAX_KERNEL_REQ; k++)
+        kernel[k] = k < taps ? kernel[k] / norm : 0.0f;
     }
-    r = fmaxf(0.0f, s / (normh * normv));
   }
-  else if(ix >= 0 && iy >= 0 && ix < width && iy < height)
+  g_once_init_leave(&_tap_table_ready, 1);
+}
+
+/** Computes the normalized upsampling taps for the position t
+ *
+ * The first tap applies to pixel floorf(t) - itor->width + 1. Bilinear
+ * taps are computed exactly, the others are interpolated from the table.
+ */
+static inline void _upsampling_taps(const dt_interpolation_t *itor,
+                                    const float t,
+                                    float *const kernel)
+{
+  const float f = t - floorf(t);
+  if(itor->width == 1)
   {
-    // At least a valid coordinate
+    kernel[0] = 1.0f - f;
+    kernel[1] = f;
+    return;
+  }
 
-    // Point to the upper left pixel index wise
-    iy -= itor->width - 1;
-    ix -= itor->width - 1;
+  const float phase = f * (float)TAP_TABLE_PHASES;
+  const int p = (int)phase;
+  const float r = phase - (float)p;
+  const float *const k0 = _tap_table[itor->id][p];
+  const float *const k1 = _tap_table[itor->id][p + 1];
+  for(int k = 0; k < MAX_KERNEL_REQ; k++)
+    kernel[k] = k0[k] + r * (k1[k] - k0[k]);
+}
 
-    static const enum border_mode bordermode = INTERPOLATION_BORDER_MODE;
-    assert(bordermode != BORDER_CLAMP); // XXX in clamp mode, norms would be wrong
+/* --------------------------------------------------------------------------
+ * Sample interpolation function (see usage in iop/lens.c and iop/clipping.c)
+ * ------------------------------------------------------------------------*/
 
-    int xtap_first;
-    int xtap_last;
-    _prepare_tap_boundaries(&xtap_first, &xtap_last,
-                           bordermode, 2 * itor->width, ix, width);
+static inline float _sample_border(const float *const in,
+                                   const float *const kernelh,
+                                   const float *const kernelv,
+                                   const int itor_width,
+                                   int ix,
+                                   int iy,
+                                   const int width,
+                                   const int height,
+                                   const int samplestride,
+                                   const int linestride)
+{
+  // Point to the upper left pixel index wise
+  iy -= itor_width - 1;
+  ix -= itor_width - 1;
+
+  static const enum border_mode bordermode = INTERPOLATION_BORDER_MODE;
+  assert(bordermode != BORDER_CLAMP); // XXX in clamp mode, norms would be wrong
+
+  int xtap_first;
+  int xtap_last;
+  _prepare_tap_boundaries(&xtap_first, &xtap_last,
+                         bordermode, 2 * itor_width, ix, width);
+
+  int ytap_first;
+  int ytap_last;
+  _prepare_tap_boundaries(&ytap_first, &ytap_last,
+                         bordermode, 2 * itor_width, iy, height);
+
+  // Apply the kernel
+  float s = 0.f;
+  for(ssize_t i = ytap_first; i < ytap_last; i++)
+  {
+    const ssize_t clip_y = _clip(iy + i, 0, height - 1, bordermode);
+    float h = 0.0f;
+    for(ssize_t j = xtap_first; j < xtap_last; j++)
+    {
+      const ssize_t clip_x = _clip(ix + j, 0, width - 1, bordermode);
+      const float *ipixel = in + clip_y * linestride + clip_x * samplestride;
+      h += kernelh[j] * ipixel[0];
+    }
+    s += kernelv[i] * h;
+  }
+  return fmaxf(0.0f, s);
+}
 
-    int ytap_first;
-    int ytap_last;
-    _prepare_tap_boundaries(&ytap_first, &ytap_last,
-                           bordermode, 2 * itor->width, iy, height);
+// taps is a constant in the callers so the loops get unrolled for each kernel size
+static inline void _compute_samples(const dt_interpolation_t *itor,
+                                    const int taps,
+                                    const float *const in,
+                                    float *out,
+                                    const int out_stride,
+                                    const float *xy,
+                                    const int xy_stride,
+                                    const size_t n,
+                                    const int width,
+                                    const int height,
+                                    const int samplestride,
+                                    const int linestride)
+{
+  const int w = taps / 2;
 
-    // Apply the kernel
-    float s = 0.f;
-    for(ssize_t i = ytap_first; i < ytap_last; i++)
+  for(size_t k = 0; k < n; k++, xy += xy_stride, out += out_stride)
+  {
+    const float x = xy[0];
+    const float y = xy[1];
+    const int ix = (int)x;
+    const int iy = (int)y;
+
+    /* Now 2 cases, the pixel + filter width goes outside the image
+     * in that case we have to use index clipping to keep all reads
+     * in the input image (slow path) or we are sure it won't fall
+     * outside and can do more simple code */
+    if(ix >= (w - 1)
+       && iy >= (w - 1)
+       && ix < (width - w)
+       && iy < (height - w))
     {
-      const ssize_t clip_y = _clip(iy + i, 0, height - 1, bordermode);
-      float h = 0.0f;
-      for(ssize_t j = xtap_first; j < xtap_last; j++)
+      float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+      float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+      _upsampling_taps(itor, x, kernelh);
+      _upsampling_taps(itor, y, kernelv);
+
+      // Go to top left pixel
+      const float *ipixel = in + (ssize_t)linestride * (iy - w + 1)
+                               + (ssize_t)samplestride * (ix - w + 1);
+
+      float s = 0.f;
+      for(int i = 0; i < taps; i++, ipixel += linestride)
       {
-        const ssize_t clip_x = _clip(ix + j, 0, width - 1, bordermode);
-        const float *ipixel = in + clip_y * linestride + clip_x * samplestride;
-        h += kernelh[j] * ipixel[0];
+        float h = 0.0f;
+        for(int j = 0; j < taps; j++)
+          h += kernelh[j] * ipixel[j * samplestride];
+        s += kernelv[i] * h;
       }
-      s += kernelv[i] * h;
+      *out = fmaxf(0.0f, s);
+    }
+    else if(ix >= 0 && iy >= 0 && ix < width && iy < height)
+    {
+      // At least a valid coordinate
+      float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+      float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+      _upsampling_taps(itor, x, kernelh);
+      _upsampling_taps(itor, y, kernelv);
+      *out = _sample_border(in, kernelh, kernelv, w, ix, iy,
+                            width, height, samplestride, linestride);
+    }
+    else
+    {
+      // invalid coordinate
+      *out = 0.0f;
     }
-
-    r = fmaxf(0.0f, s / (normh * normv));
-  }
-  else
-  {
-    // invalid coordinate
-    r = 0.0f;
   }
-  return r;
 }
 
-/* --------------------------------------------------------------------------
- * Pixel interpolation function (see usage in iop/lens.c and iop/clipping.c)
- * ------------------------------------------------------------------------*/
-
-void dt_interpolation_compute_pixel4c(const dt_interpolation_t *itor,
+void dt_interpolation_compute_samples(const dt_interpolation_t *itor,
                                       const float *in,
                                       float *out,
-                                      const float x,
-                                      const float y,
+                                      const int out_stride,
+                                      const float *xy,
+                                      const int xy_stride,
+                                      const size_t n,
                                       const int width,
                                       const int height,
+                                      const int samplestride,
                                       const int linestride)
 {
   assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
 
-  // Quite a bit of space for kernels
-  float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
-  float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
-
-  // Compute both horizontal and vertical kernels
-  float normh = _compute_upsampling_kernel(itor, kernelh, NULL, x);
-  float normv = _compute_upsampling_kernel(itor, kernelv, NULL, y);
-
-  // Precompute the inverse of the filter norm for later use
-  const float oonorm = (1.f / (normh * normv));
-
-  /* Now 2 cases, the pixel + filter width goes outside the image
-   * in that case we have to use index clipping to keep all reads
-   * in the input image (slow path) or we are sure it won't fall
-   * outside and can do more simple code */
-  int ix = (int)x;
-  int iy = (int)y;
-
-  if(ix >= (itor->width - 1)
-    && iy >= (itor->width - 1)
-    && ix < (width - itor->width)
-    && iy < (height - itor->width))
+  switch(itor->width)
   {
-    // Inside image boundary case
+    case 1:
+      _compute_samples(itor, 2, in, out, out_stride, xy, xy_stride, n,
+                       width, height, samplestride, linestride);
+      break;
+    case 2:
+      _compute_samples(itor, 4, in, out, out_stride, xy, xy_stride, n,
+                       width, height, samplestride, linestride);
+      break;
+    default:
+      _compute_samples(itor, 6, in, out, out_stride, xy, xy_stride, n,
+                       width, height, samplestride, linestride);
+      break;
+  }
+}
 
-    // Go to top left pixel
-    in = (float *)in + linestride * iy + ix * 4;
-    in = in - (itor->width - 1) * (4 + linestride);
+float dt_interpolation_compute_sample(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int samplestride,
+                                      const int linestride)
+{
+  const float xy[2] = { x, y };
+  float r;
+  dt_interpolation_compute_samples(itor, in, &r, 1, xy, 2, 1,
+                                   width, height, samplestride, linestride);
+  return r;
+}
 
-    const size_t itor_width = 2 * itor->width;
+/* --------------------------------------------------------------------------
+ * Pixel interpolation function (see usage in iop/lens.c and iop/clipping.c)
+ * ------------------------------------------------------------------------*/
 
-    // Apply the kernel
-    dt_aligned_pixel_t pixel = { 0.0f, 0.0f, 0.0f, 0.0f };
-    for(size_t i = 0; i < itor_width; i++)
+static inline void _pixel4c_border(const float *const in,
+                                   float *const out,
+                                   const float *const kernelh,
+                                   const float *const kernelv,
+                                   const int itor_width,
+                                   int ix,
+                                   int iy,
+                                   const int width,
+                                   const int height,
+                                   const int linestride)
+{
+  // Point to the upper left pixel index wise
+  iy -= itor_width - 1;
+  ix -= itor_width - 1;
+
+  static const enum border_mode bordermode = INTERPOLATION_BORDER_MODE;
+  assert(bordermode != BORDER_CLAMP); // XXX in clamp mode, norms would be wrong
+
+  int xtap_first;
+  int xtap_last;
+  _prepare_tap_boundaries(&xtap_first, &xtap_last,
+                         bordermode, 2 * itor_width, ix, width);
+
+  int ytap_first;
+  int ytap_last;
+  _prepare_tap_boundaries(&ytap_first, &ytap_last,
+                         bordermode, 2 * itor_width, iy, height);
+
+  // Apply the kernel
+  dt_aligned_pixel_t pixel = { 0.0f, 0.0f, 0.0f, 0.0f };
+  for(ssize_t i = ytap_first; i < ytap_last; i++)
+  {
+    const ssize_t clip_y = _clip(iy + i, 0, height - 1, bordermode);
+    dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float *ipixel = in + clip_y * linestride;
+    for(ssize_t j = xtap_first; j < xtap_last; j++)
     {
-      dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
-      for(size_t j = 0; j < itor_width; j++)
-      {
-        const float kern = kernelh[j];
-        dt_aligned_pixel_t inpx;
-        copy_pixel(inpx, in + 4*j);
-        for_each_channel(c)
-          h[c] = h[c] + kern * inpx[c];
-      }
+      const ssize_t clip_x = _clip(ix + j, 0, width - 1, bordermode);
+      dt_aligned_pixel_t inpx;
+      copy_pixel(inpx, ipixel + 4 * clip_x);
+      const float kern = kernelh[j];
       for_each_channel(c)
-        pixel[c] += kernelv[i] * h[c];
-      in += linestride;
+        h[c] += kern * inpx[c];
     }
-
-    for_each_channel(c,aligned(out))
-      out[c] = fmaxf(0.0f, oonorm * pixel[c]);
+    for_each_channel(c)
+      pixel[c] += kernelv[i] * h[c];
   }
-  else if(ix >= 0 && iy >= 0 && ix < width && iy < height)
-  {
-    // At least a valid coordinate
-
-    // Point to the upper left pixel index wise
-    iy -= itor->width - 1;
-    ix -= itor->width - 1;
-
-    static const enum border_mode bordermode = INTERPOLATION_BORDER_MODE;
-    assert(bordermode != BORDER_CLAMP); // XXX in clamp mode, norms would be wrong
 
-    int xtap_first;
-    int xtap_last;
-    _prepare_tap_boundaries(&xtap_first, &xtap_last,
-                           bordermode, 2 * itor->width, ix, width);
+  for_each_channel(c)
+    out[c] = fmaxf(0.0f, pixel[c]);
+}
 
-    int ytap_first;
-    int ytap_last;
-    _prepare_tap_boundaries(&ytap_first, &ytap_last,
-                           bordermode, 2 * itor->width, iy, height);
+// taps is a constant in the callers so the loops get unrolled for each kernel size
+static inline void _compute_pixels4c(const dt_interpolation_t *itor,
+                                     const int taps,
+                                     const float *const in,
+                                     float *out,
+                                     const float *xy,
+                                     const size_t n,
+                                     const int width,
+                                     const int height,
+                                     const int linestride)
+{
+  const int w = taps / 2;
 
-    // Apply the kernel
-    dt_aligned_pixel_t pixel = { 0.0f, 0.0f, 0.0f, 0.0f };
-    for(ssize_t i = ytap_first; i < ytap_last; i++)
+  for(size_t k = 0; k < n; k++, xy += 2, out += 4)
+  {
+    const float x = xy[0];
+    const float y = xy[1];
+    const int ix = (int)x;
+    const int iy = (int)y;
+
+    if(ix >= (w - 1)
+       && iy >= (w - 1)
+       && ix < (width - w)
+       && iy < (height - w))
     {
-      const ssize_t clip_y = _clip(iy + i, 0, height - 1, bordermode);
-      dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
-      const float *ipixel = in + clip_y * linestride;
-      for(ssize_t j = xtap_first; j < xtap_last; j++)
+      // Inside image boundary case
+      float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+      float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+      _upsampling_taps(itor, x, kernelh);
+      _upsampling_taps(itor, y, kernelv);
+
+      // Go to top left pixel
+      const float *ipixel = in + (ssize_t)linestride * (iy - w + 1) + (ssize_t)4 * (ix - w + 1);
+
+      // gather the taps of each line and accumulate all four channels at once
+      dt_aligned_pixel_t pixel = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int i = 0; i < taps; i++, ipixel += linestride)
       {
-        const ssize_t clip_x = _clip(ix + j, 0, width - 1, bordermode);
-        dt_aligned_pixel_t inpx;
-        copy_pixel(inpx, ipixel + 4 * clip_x);
-        const float kern = kernelh[j];
+        dt_aligned_pixel_t h = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int j = 0; j < taps; j++)
+        {
+          const float kern = kernelh[j];
+          dt_aligned_pixel_t inpx;
+          copy_pixel(inpx, ipixel + 4*j);
+          for_each_channel(c)
+            h[c] = h[c] + kern * inpx[c];
+        }
+        const float kern = kernelv[i];
         for_each_channel(c)
-          h[c] += kern * inpx[c];
+          pixel[c] += kern * h[c];
       }
+
       for_each_channel(c)
-        pixel[c] += kernelv[i] * h[c];
+        out[c] = fmaxf(0.0f, pixel[c]);
+    }
+    else if(ix >= 0 && iy >= 0 && ix < width && iy < height)
+    {
+      // At least a valid coordinate
+      float DT_ALIGNED_ARRAY kernelh[MAX_KERNEL_REQ];
+      float DT_ALIGNED_ARRAY kernelv[MAX_KERNEL_REQ];
+      _upsampling_taps(itor, x, kernelh);
+      _upsampling_taps(itor, y, kernelv);
+      _pixel4c_border(in, out, kernelh, kernelv, w, ix, iy, width, height, linestride);
     }
+    else
+    {
+      // data for *out has no valid *in location so just set to zero.
+      for_each_channel(c)
+        out[c] = 0.0f;
+    }
+  }
+}
+
+void dt_interpolation_compute_pixels4c(const dt_interpolation_t *itor,
+                                       const float *in,
+                                       float *out,
+                                       const float *xy,
+                                       const size_t n,
+                                       const int width,
+                                       const int height,
+                                       const int linestride)
+{
+  assert(itor->width < (MAX_HALF_FILTER_WIDTH + 1));
 
-    for_each_channel(c,aligned(out))
-      out[c] = fmaxf(0.0f, oonorm * pixel[c]);
+  switch(itor->width)
+  {
+    case 1:
+      _compute_pixels4c(itor, 2, in, out, xy, n, width, height, linestride);
+      break;
+    case 2:
+      _compute_pixels4c(itor, 4, in, out, xy, n, width, height, linestride);
+      break;
+    default:
+      _compute_pixels4c(itor, 6, in, out, xy, n, width, height, linestride);
+      break;
   }
-  else
+}
+
+void dt_interpolation_compute_pixel4c(const dt_interpolation_t *itor,
+                                      const float *in,
+                                      float *out,
+                                      const float x,
+                                      const float y,
+                                      const int width,
+                                      const int height,
+                                      const int linestride)
+{
+  const float xy[2] = { x, y };
+  dt_interpolation_compute_pixels4c(itor, in, out, xy, 1, width, height, linestride);
+}
+
+void dt_interpolation_warp4c(const dt_interpolation_t *itor,
+                             float *out,
+                             const int out_width,
+                             const int out_height,
+                             const float *const in,
+                             const int in_width,
+                             const int in_height,
+                             dt_interpolation_warp_map_t map,
+                             void *data)
+{
+  DT_OMP_FOR()
+  for(int row = 0; row < out_height; row++)
   {
-    // data for *out has no valid *in location so just set to zero.
-    for_each_channel(c,aligned(out))
-      out[c] = 0.0f;
+    float DT_ALIGNED_ARRAY xy[2 * WARP_SPAN];
+    for(int col = 0; col < out_width; col += WARP_SPAN)
+    {
+      const int n = MIN(WARP_SPAN, out_width - col);
+      map(xy, row, col, n, data);
+      dt_interpolation_compute_pixels4c(itor, in, out + (size_t)4 * ((size_t)row * out_width + col),
+                                        xy, n, in_width, in_height, 4 * in_width);
+    }
   }
 }
 
@@ -719,6 +922,8 @@ const dt_interpolation_t *dt_interpolation_new(enum dt_interpolation_type type)
 {
   const dt_interpolation_t *itor = NULL;
 
+  _init_tap_tables();
+
   if(type == DT_INTERPOLATION_USERPREF)
   {
     // Find user preferred interpolation method
@@ -101,6 +101,48 @@ void dt_interpolation_compute_pixel4c(const dt_interpolation_t *itor, const floa
                                       const float x, const float y, const int width, const int height,
                                       const int linestride);
 
+/** Compute a row of interpolated samples.
+ *
+ * Same as dt_interpolation_compute_sample() for n positions at once, the
+ * kernel taps come from tables of fractional offsets instead of being
+ * computed for each sample.
+ *
+ * @param in Input image
+ * @param out Output samples, out_stride floats apart
+ * @param xy Pairs of X,Y coordinates of the samples, xy_stride floats apart
+ * @param n Number of samples
+ */
+void dt_interpolation_compute_samples(const dt_interpolation_t *itor, const float *in, float *out,
+                                      const int out_stride, const float *xy, const int xy_stride,
+                                      const size_t n, const int width, const int height,
+                                      const int samplestride, const int linestride);
+
+/** Compute a row of interpolated 4 component pixels.
+ *
+ * Same as dt_interpolation_compute_pixel4c() for n positions at once, the
+ * kernels of each size have their own unrolled loop.
+ *
+ * @param xy n pairs of X,Y coordinates, one for each output pixel
+ */
+void dt_interpolation_compute_pixels4c(const dt_interpolation_t *itor, const float *in, float *out,
+                                       const float *xy, const size_t n, const int width,
+                                       const int height, const int linestride);
+
+/** Fills xy with the input coordinates of width pixels of an output row, starting at column col */
+typedef void (*dt_interpolation_warp_map_t)(float *xy, const int row, const int col, const int width,
+                                            void *data);
+
+/** Warp a 4 component image.
+ *
+ * Each output pixel is interpolated at the input position given by the
+ * coordinate map, which is asked for a span of a row at a time. Coordinates
+ * are relative to the input buffer. Rows are processed in parallel, so map
+ * must be safe to call from several threads.
+ */
+void dt_interpolation_warp4c(const dt_interpolation_t *itor, float *out, const int out_width,
+                             const int out_height, const float *const in, const int in_width,
+                             const int in_height, dt_interpolation_warp_map_t map, void *data);
+
 /** Get an interpolator from type
  * @param type Interpolator to search for
  * @return requested interpolator or default if not found (this function can't fail)
@@ -138,7 +138,9 @@ static void _transform_from_to_rgb_lab_lcms2(const float *const image_in,
     output_format = TYPE_RGBA_FLT;
   }
 
-  xform = cmsCreateTransform(input_profile, input_format, output_profile, output_format, intent, 0);
+  // shared with every other conversion between the same profiles
+  xform = dt_colorspaces_get_transform(input_profile, input_format, output_profile, output_format,
+                                       NULL, intent, intent, 0);
 
   if(type == DT_COLORSPACE_DISPLAY || type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
@@ -158,7 +160,7 @@ static void _transform_from_to_rgb_lab_lcms2(const float *const image_in,
     dt_print(DT_DEBUG_ALWAYS,
              "[_transform_from_to_rgb_lab_lcms2] cannot create transform");
 
-  if(xform) cmsDeleteTransform(xform);
+  dt_colorspaces_release_transform(xform);
 }
 
 static void _transform_rgb_to_rgb_lcms2
@@ -240,15 +242,15 @@ static void _transform_rgb_to_rgb_lcms2
     cmsHPROFILE tmp_rgb_profile = dt_colorspaces_get_profile(DT_COLORSPACE_LIN_REC2020, "", DT_PROFILE_DIRECTION_ANY)->profile;
 
     uint32_t transformFlags = cmsFLAGS_SOFTPROOFING | cmsFLAGS_BLACKPOINTCOMPENSATION | cmsFLAGS_COPY_ALPHA;
-    xform = cmsCreateProofingTransform(
-        from_rgb_profile, TYPE_RGBA_FLT,
-        tmp_rgb_profile, TYPE_RGBA_FLT,
-        to_rgb_profile,
-        intent, intent, transformFlags);
+    xform = dt_colorspaces_get_transform(from_rgb_profile, TYPE_RGBA_FLT,
+                                         tmp_rgb_profile, TYPE_RGBA_FLT,
+                                         to_rgb_profile,
+                                         intent, intent, transformFlags);
   }
   else if(from_rgb_profile && to_rgb_profile)
   {
-    xform = cmsCreateTransform(from_rgb_profile, TYPE_RGBA_FLT, to_rgb_profile, TYPE_RGBA_FLT, intent, 0);
+    xform = dt_colorspaces_get_transform(from_rgb_profile, TYPE_RGBA_FLT, to_rgb_profile, TYPE_RGBA_FLT,
+                                         NULL, intent, intent, 0);
   }
 
   if(type_from == DT_COLORSPACE_DISPLAY
@@ -269,7 +271,7 @@ static void _transform_rgb_to_rgb_lcms2
   else
     dt_print(DT_DEBUG_ALWAYS, "[_transform_rgb_to_rgb_lcms2] cannot create transform");
 
-  if(xform) cmsDeleteTransform(xform);
+  dt_colorspaces_release_transform(xform);
 }
 
 static void _transform_lcms2(struct dt_iop_module_t *self,
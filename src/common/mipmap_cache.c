@@ -63,7 +63,8 @@ typedef enum dt_mipmap_buffer_dsc_flags
 {
   DT_MIPMAP_BUFFER_DSC_FLAG_NONE = 0,
   DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE = 1 << 0,
-  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
+  DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1,
+  DT_MIPMAP_BUFFER_DSC_FLAG_LOOSE = 1 << 2 // read from a loose file, moved into the pack on eviction
 } dt_mipmap_buffer_dsc_flags;
 
 // the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
@@ -455,6 +456,57 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+static gboolean _mipmap_cache_disk_backend(const dt_mipmap_cache_t *cache,
+                                           const dt_mipmap_size_t mip)
+{
+  return cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+                                || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8));
+}
+
+// is there a thumbnail of this size on disk, in the pack or as a loose file?
+static gboolean _mipmap_cache_ondisk_exists(const dt_mipmap_cache_t *cache,
+                                           const dt_imgid_t imgid,
+                                           const dt_mipmap_size_t mip)
+{
+  if(mip < DT_MIPMAP_F && cache->pack[mip] && dt_mipmap_pack_contains(cache->pack[mip], imgid))
+    return TRUE;
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return g_file_test(filename, G_FILE_TEST_EXISTS);
+}
+
+static gboolean _mipmap_cache_read_pack(dt_mipmap_cache_t *cache,
+                                        dt_cache_entry_t *entry,
+                                        const dt_mipmap_size_t mip)
+{
+  dt_mipmap_pack_blob_t blob;
+  const dt_imgid_t imgid = _get_imgid(entry->key);
+  if(!dt_mipmap_pack_read(cache->pack[mip], imgid, &blob)) return FALSE;
+
+  dt_mipmap_buffer_dsc_t *dsc = entry->data;
+  dt_imageio_jpeg_t jpg;
+  const gboolean failed = dt_imageio_jpeg_decompress_header(blob.data, blob.length, &jpg)
+    || jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip]
+    || dt_imageio_jpeg_decompress(&jpg, (uint8_t *)entry->data + sizeof(*dsc));
+  if(failed)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] failed to decompress thumbnail for ID=%d from pack", imgid);
+    dt_mipmap_pack_remove(cache->pack[mip], imgid);
+  }
+  else
+  {
+    dt_print(DT_DEBUG_CACHE,
+             "[mipmap_cache] grab mip %d for ID=%d from disk pack", mip, imgid);
+    dsc->width = jpg.width;
+    dsc->height = jpg.height;
+    dsc->iscale = 1.0f;
+    dsc->color_space = blob.color_space;
+  }
+  dt_mipmap_pack_blob_release(&blob);
+  return !failed;
+}
+
 // callback for the cache backend to initialize payload pointers
 static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -516,16 +568,21 @@ static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   assert(dsc->size >= sizeof(*dsc));
 
   int loaded_from_disk = 0;
+  gboolean loaded_loose = FALSE;
   if(mip < DT_MIPMAP_F)
   {
-    if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                              || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+    if(_mipmap_cache_disk_backend(cache, mip))
     {
       // try and load from disk, if successful set flag
+      if(cache->pack[mip])
+        loaded_from_disk = _mipmap_cache_read_pack(cache, entry, mip);
+
+      // loose files are still read when the pack is in use, they move into
+      // the pack when the thumbnail is evicted again
       char filename[PATH_MAX] = {0};
       snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
                _get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
+      FILE *f = loaded_from_disk ? NULL : g_fopen(filename, "rb");
       if(f)
       {
         uint8_t *blob = 0;
@@ -557,6 +614,7 @@ static void _mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
         dsc->iscale = 1.0f;
         dsc->color_space = color_space;
         loaded_from_disk = 1;
+        loaded_loose = TRUE;
         if(0)
         {
 read_error:
@@ -570,7 +628,7 @@ read_error:
 
   if(!loaded_from_disk)
     dsc->flags = DT_MIPMAP_BUFFER_DSC_FLAG_GENERATE;
-  else dsc->flags = 0;
+  else dsc->flags = loaded_loose ? DT_MIPMAP_BUFFER_DSC_FLAG_LOOSE : 0;
 
   // cost is just flat one for the buffer, as the buffers might have different sizes,
   // to make sure quota is meaningful.
@@ -597,6 +655,64 @@ static void _mipmap_cache_unlink_ondisk_thumbnail(void *data,
     snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
     g_unlink(filename);
   }
+  if(mip < DT_MIPMAP_F && cache->pack[mip])
+    dt_mipmap_pack_remove(cache->pack[mip], imgid);
+}
+
+static gboolean _mipmap_cache_disk_full(const char *path)
+{
+  struct statvfs vfsbuf;
+  if(statvfs(path, &vfsbuf))
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] aborting image write since couldn't determine free space available to write %s",
+             path);
+    return TRUE;
+  }
+  const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
+  if(free_mb < 100)
+  {
+    dt_print(DT_DEBUG_ALWAYS,
+             "[mipmap_cache] aborting image write as only %" PRId64 " MB free to write %s",
+             free_mb, path);
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static void _mipmap_cache_write_pack(dt_mipmap_cache_t *cache,
+                                     dt_cache_entry_t *entry,
+                                     const dt_mipmap_size_t mip)
+{
+  const dt_imgid_t imgid = _get_imgid(entry->key);
+  const dt_mipmap_buffer_dsc_t *dsc = entry->data;
+  char dirname[PATH_MAX] = {0};
+  snprintf(dirname, sizeof(dirname), "%s.d/%d", cache->cachedir, (int)mip);
+
+  // don't rewrite thumbnails we already have, both performance and quality
+  // (lossy jpg) suffer
+  if(!dt_mipmap_pack_contains(cache->pack[mip], imgid) && !_mipmap_cache_disk_full(dirname))
+  {
+    const int cache_quality = dt_conf_get_int("database_cache_quality");
+    // the colour space goes into the pack record, no need for exif
+    uint8_t *jpeg = dt_alloc_aligned((size_t)4 * dsc->width * dsc->height);
+    const int length = jpeg ? dt_imageio_jpeg_compress((uint8_t *)entry->data + sizeof(*dsc), jpeg,
+                                                       dsc->width, dsc->height,
+                                                       MIN(100, MAX(10, cache_quality)))
+                            : 0;
+    if(length > 1)
+      dt_mipmap_pack_write(cache->pack[mip], imgid, jpeg, length, dsc->color_space);
+    dt_free_align(jpeg);
+  }
+
+  // a thumbnail read from a loose file has moved into the pack, drop the file
+  if((dsc->flags & DT_MIPMAP_BUFFER_DSC_FLAG_LOOSE)
+     && dt_mipmap_pack_contains(cache->pack[mip], imgid))
+  {
+    char filename[PATH_MAX] = {0};
+    snprintf(filename, sizeof(filename), "%s/%" PRIu32 ".jpg", dirname, imgid);
+    g_unlink(filename);
+  }
 }
 
 static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
@@ -613,8 +729,11 @@ static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry
       {
         _mipmap_cache_unlink_ondisk_thumbnail(data, _get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                                     || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+      else if(_mipmap_cache_disk_backend(cache, mip) && cache->pack[mip])
+      {
+        _mipmap_cache_write_pack(cache, entry, mip);
+      }
+      else if(_mipmap_cache_disk_backend(cache, mip))
       {
         // serialize to disk
         char filename[PATH_MAX] = {0};
@@ -629,25 +748,7 @@ static void _mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry
           if(!g_file_test(filename, G_FILE_TEST_EXISTS) && (f = g_fopen(filename, "wb")))
           {
             // first check the disk isn't full
-            struct statvfs vfsbuf;
-            if(!statvfs(filename, &vfsbuf))
-            {
-              const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
-              if(free_mb < 100)
-              {
-                dt_print(DT_DEBUG_ALWAYS,
-                         "[mipmap_cache] aborting image write as only %" PRId64 " MB free to write %s",
-                         free_mb, filename);
-                goto write_error;
-              }
-            }
-            else
-            {
-              dt_print(DT_DEBUG_ALWAYS,
-                       "[mipmap_cache] aborting image write since couldn't determine free space available to write %s",
-                       filename);
-              goto write_error;
-            }
+            if(_mipmap_cache_disk_full(filename)) goto write_error;
 
             const int cache_quality = dt_conf_get_int("database_cache_quality");
             const uint8_t *exif = NULL;
@@ -766,6 +867,20 @@ void dt_mipmap_cache_init()
   cache->buffer_size[DT_MIPMAP_F] = sizeof(dt_mipmap_buffer_dsc_t)
                                         + 4 * sizeof(float) * cache->max_width[DT_MIPMAP_F]
                                           * cache->max_height[DT_MIPMAP_F];
+
+  // packed disk backend, opened once as the packs keep their index in memory
+  if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend_pack"))
+  {
+    for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
+    {
+      if(!_mipmap_cache_disk_backend(cache, mip)) continue;
+      char dirname[PATH_MAX] = {0};
+      snprintf(dirname, sizeof(dirname), "%s.d/%d", cache->cachedir, (int)mip);
+      cache->pack[mip] = dt_mipmap_pack_open(dirname);
+      if(!cache->pack[mip])
+        dt_print(DT_DEBUG_ALWAYS, "[mipmap_cache] can't open thumbnail pack in `%s'", dirname);
+    }
+  }
 }
 
 void dt_mipmap_cache_cleanup()
@@ -773,9 +888,12 @@ void dt_mipmap_cache_cleanup()
   dt_mipmap_cache_t *cache = darktable.mipmap_cache;
   if(!cache) return;
 
+  // the caches flush their thumbnails into the packs on cleanup
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
+    dt_mipmap_pack_close(cache->pack[mip]);
   darktable.mipmap_cache = NULL;
   free(cache);
 }
@@ -914,10 +1032,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || mip < DT_MIPMAP_0)
       return;
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!_mipmap_cache_ondisk_exists(cache, imgid, mip)) return;
     dt_control_add_job(DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -1144,13 +1260,8 @@ void dt_mipmap_cache_get_with_caller(dt_mipmap_buffer_t *buf,
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(cache->cachedir[0] && _mipmap_cache_ondisk_exists(cache, imgid, mip))
+      dt_mipmap_cache_get(0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = NO_IMGID;
@@ -1543,8 +1654,8 @@ static void _init_8(uint8_t *buf,
                "[mipmap_cache] generate mip %d for ID=%d from level %d",
                size, imgid, k);
       *color_space = tmp.color_space;
-      // downsample
-      dt_iop_flip_and_zoom_8(tmp.buf, tmp.width, tmp.height, buf, wd, ht, ORIENTATION_NONE, width, height);
+      // downsample, area averaged as a chain of these is how smaller sizes are made
+      dt_iop_downscale_8(tmp.buf, tmp.width, tmp.height, buf, wd, ht, width, height);
 
       dt_mipmap_cache_release(&tmp);
       res = FALSE;
@@ -1620,6 +1731,13 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
     {
+      dt_mipmap_pack_blob_t blob;
+      if(cache->pack[mip] && dt_mipmap_pack_read(cache->pack[mip], src_imgid, &blob))
+      {
+        dt_mipmap_pack_write(cache->pack[mip], dst_imgid, blob.data, blob.length, blob.color_space);
+        dt_mipmap_pack_blob_release(&blob);
+        continue;
+      }
       // try and load from disk, if successful set flag
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
@@ -1637,6 +1755,33 @@ void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid,
   }
 }
 
+gboolean dt_mipmap_cache_ondisk_exists(const dt_imgid_t imgid,
+                                       const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || !cache->cachedir[0]) return FALSE;
+
+  // the pack checks the record against its checksum, a corrupt one is dropped
+  dt_mipmap_pack_blob_t blob;
+  if(mip < DT_MIPMAP_F && cache->pack[mip] && dt_mipmap_pack_read(cache->pack[mip], imgid, &blob))
+  {
+    dt_mipmap_pack_blob_release(&blob);
+    return TRUE;
+  }
+  char filename[PATH_MAX] = {0};
+  snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
+  return dt_util_test_image_file(filename);
+}
+
+void dt_mipmap_cache_prefetch_page(const dt_imgid_t *imgids,
+                                   const int count,
+                                   const dt_mipmap_size_t mip)
+{
+  dt_mipmap_cache_t *cache = darktable.mipmap_cache;
+  if(!cache || mip >= DT_MIPMAP_F || !cache->pack[mip]) return;
+  dt_mipmap_pack_prefetch(cache->pack[mip], imgids, count);
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -21,6 +21,7 @@
 #include "common/cache.h"
 #include "common/colorspaces.h"
 #include "common/image.h"
+#include "common/mipmap_pack.h"
 
 G_BEGIN_DECLS
 
@@ -102,6 +103,8 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // packed disk backend per thumbnail level, NULL when not in use
+  dt_mipmap_pack_t *pack[DT_MIPMAP_F];
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -153,6 +156,15 @@ dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace(void);
 // only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
 void dt_mipmap_cache_copy_thumbnails(const dt_imgid_t dst_imgid, const dt_imgid_t src_imgid);
 
+// is a valid thumbnail of this size stored by the disk backend, in the pack or as a file?
+// the stored data is read and checked, use it for maintenance rather than in a view.
+gboolean dt_mipmap_cache_ondisk_exists(const dt_imgid_t imgid, const dt_mipmap_size_t mip);
+
+// hint that the thumbnails of these images at this size will be requested
+// shortly. with the packed disk backend they are read in as few sequential
+// reads as possible, otherwise this does nothing.
+void dt_mipmap_cache_prefetch_page(const dt_imgid_t *imgids, const int count, const dt_mipmap_size_t mip);
+
 // return the mipmap corresponding to text value saved in prefs
 dt_mipmap_size_t dt_mipmap_cache_get_min_mip_from_pref(const char *value);
 
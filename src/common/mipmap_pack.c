@@ -0,0 +1,650 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define PACK_MAGIC  0x4b505444u // "DTPK"
+#define INDEX_MAGIC 0x49505444u // "DTPI"
+#define RECORD_MAGIC 0x52505444u // "DTPR"
+#define PACK_VERSION 1
+
+// write an index snapshot after this many appends, bounds the replay on open
+#define PACK_INDEX_INTERVAL 256
+// records closer than this are fetched in one read by the prefetch
+#define PACK_PREFETCH_GAP (256 << 10)
+// records written past the mapping are read from the file until they add up
+// to this, then the whole pack is mapped again
+#define PACK_REMAP_STEP (32 << 20)
+
+typedef struct _pack_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation; // new for every compaction, ties an index to its pack
+} _pack_header_t;
+
+typedef struct _pack_record_t
+{
+  uint32_t magic;
+  int32_t imgid;
+  uint32_t length;      // jpeg bytes that follow, 0 drops imgid
+  int32_t color_space;
+  uint32_t checksum;    // of the jpeg bytes
+  uint32_t reserved;
+} _pack_record_t;
+
+typedef struct _index_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+  uint64_t covered;     // pack size the snapshot describes
+  uint64_t count;
+} _index_header_t;
+
+typedef struct _index_entry_t
+{
+  int32_t imgid;
+  uint32_t length;
+  uint64_t offset;      // of the jpeg data
+  int32_t color_space;
+  uint32_t checksum;
+} _index_entry_t;
+
+struct dt_mipmap_pack_t
+{
+  dt_pthread_mutex_t lock;
+  gchar *pack_path;
+  gchar *index_path;
+  uint64_t generation;
+
+  FILE *f;              // append handle
+  uint64_t size;        // bytes written to the pack
+  uint64_t synced;      // bytes known to be on disk
+  uint64_t dead;        // bytes of replaced or dropped records
+  int unindexed;        // appends since the last index snapshot
+
+  GHashTable *index;    // imgid -> _index_entry_t
+  GMappedFile *map;     // read-only mapping of the first mapped bytes
+  uint64_t mapped;
+};
+
+static uint32_t _checksum(const uint8_t *data, const size_t length)
+{
+  // FNV-1a, catches torn and stale writes, not an adversary
+  uint32_t h = 2166136261u;
+  for(size_t k = 0; k < length; k++)
+    h = (h ^ data[k]) * 16777619u;
+  return h;
+}
+
+static inline uint64_t _entry_bytes(const _index_entry_t *e)
+{
+  return sizeof(_pack_record_t) + e->length;
+}
+
+static void _index_set(dt_mipmap_pack_t *pack, const _index_entry_t *entry)
+{
+  _index_entry_t *old = g_hash_table_lookup(pack->index, GINT_TO_POINTER(entry->imgid));
+  if(old) pack->dead += _entry_bytes(old);
+  if(entry->length)
+  {
+    _index_entry_t *e = g_new(_index_entry_t, 1);
+    *e = *entry;
+    g_hash_table_insert(pack->index, GINT_TO_POINTER(entry->imgid), e);
+  }
+  else
+  {
+    // the removal record itself is dead weight too
+    pack->dead += sizeof(_pack_record_t);
+    g_hash_table_remove(pack->index, GINT_TO_POINTER(entry->imgid));
+  }
+}
+
+// map the pack up to at least `needed` bytes. lock held.
+static gboolean _remap(dt_mipmap_pack_t *pack, const uint64_t needed)
+{
+  if(pack->map && pack->mapped >= needed) return TRUE;
+  if(pack->f) fflush(pack->f);
+  GError *error = NULL;
+  GMappedFile *map = g_mapped_file_new(pack->pack_path, FALSE, &error);
+  if(!map)
+  {
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] can't map `%s': %s", pack->pack_path, error->message);
+    g_error_free(error);
+    return FALSE;
+  }
+  if(pack->map) g_mapped_file_unref(pack->map);
+  pack->map = map;
+  pack->mapped = g_mapped_file_get_length(map);
+  return pack->mapped >= needed;
+}
+
+static gboolean _sync(FILE *f)
+{
+  if(fflush(f)) return FALSE;
+#ifdef _WIN32
+  return _commit(_fileno(f)) == 0;
+#else
+  return fsync(fileno(f)) == 0;
+#endif
+}
+
+// replace `path` by `tmp`, atomically where the platform allows it
+static gboolean _replace(const char *tmp, const char *path)
+{
+#ifdef _WIN32
+  g_unlink(path);
+#endif
+  return g_rename(tmp, path) == 0;
+}
+
+static void _write_index(dt_mipmap_pack_t *pack)
+{
+  // the snapshot must never point past data that is on disk
+  if(pack->f && pack->synced < pack->size)
+  {
+    if(!_sync(pack->f)) return;
+    pack->synced = pack->size;
+  }
+
+  gchar *tmp = g_strdup_printf("%s.tmp", pack->index_path);
+  FILE *f = g_fopen(tmp, "wb");
+  if(!f)
+  {
+    g_free(tmp);
+    return;
+  }
+  const _index_header_t header = { INDEX_MAGIC, PACK_VERSION, pack->generation, pack->synced,
+                                   g_hash_table_size(pack->index) };
+  gboolean ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+  GHashTableIter it;
+  gpointer value;
+  g_hash_table_iter_init(&it, pack->index);
+  while(ok && g_hash_table_iter_next(&it, NULL, &value))
+    ok = fwrite(value, sizeof(_index_entry_t), 1, f) == 1;
+
+  ok = ok && _sync(f);
+  fclose(f);
+  if(!ok || !_replace(tmp, pack->index_path))
+    g_unlink(tmp);
+  else
+    pack->unindexed = 0;
+  g_free(tmp);
+}
+
+// load the snapshot if it belongs to this pack. returns the pack offset
+// from which records still have to be replayed.
+static uint64_t _read_index(dt_mipmap_pack_t *pack, const uint64_t pack_size)
+{
+  FILE *f = g_fopen(pack->index_path, "rb");
+  if(!f) return sizeof(_pack_header_t);
+
+  _index_header_t header;
+  uint64_t covered = sizeof(_pack_header_t);
+  if(fread(&header, sizeof(header), 1, f) == 1
+     && header.magic == INDEX_MAGIC
+     && header.version == PACK_VERSION
+     && header.generation == pack->generation
+     && header.covered >= sizeof(_pack_header_t)
+     && header.covered <= pack_size)
+  {
+    _index_entry_t entry;
+    uint64_t k = 0;
+    for(; k < header.count && fread(&entry, sizeof(entry), 1, f) == 1; k++)
+    {
+      if(entry.offset < sizeof(_pack_header_t) + sizeof(_pack_record_t)
+         || entry.offset + entry.length > header.covered)
+        break;
+      _index_set(pack, &entry);
+    }
+    if(k == header.count)
+      covered = header.covered;
+    else
+      g_hash_table_remove_all(pack->index);
+  }
+  fclose(f);
+
+  // everything before the covered part that is not indexed is dead
+  if(covered > sizeof(_pack_header_t))
+  {
+    uint64_t live = sizeof(_pack_header_t);
+    GHashTableIter it;
+    gpointer value;
+    g_hash_table_iter_init(&it, pack->index);
+    while(g_hash_table_iter_next(&it, NULL, &value))
+      live += _entry_bytes(value);
+    pack->dead = covered > live ? covered - live : 0;
+  }
+  return covered;
+}
+
+// replay the records behind the snapshot. returns the end of the last
+// intact record.
+static uint64_t _replay(dt_mipmap_pack_t *pack, uint64_t offset)
+{
+  if(!_remap(pack, offset)) return sizeof(_pack_header_t);
+  const uint8_t *base = (const uint8_t *)g_mapped_file_get_contents(pack->map);
+  const uint64_t end = pack->mapped;
+
+  while(offset + sizeof(_pack_record_t) <= end)
+  {
+    _pack_record_t rec;
+    memcpy(&rec, base + offset, sizeof(rec));
+    const uint64_t data = offset + sizeof(rec);
+    if(rec.magic != RECORD_MAGIC || data + rec.length > end
+       || (rec.length && _checksum(base + data, rec.length) != rec.checksum))
+      break;
+    const _index_entry_t entry = { rec.imgid, rec.length, data, rec.color_space, rec.checksum };
+    _index_set(pack, &entry);
+    offset = data + rec.length;
+  }
+  return offset;
+}
+
+static gboolean _create(const char *path, const uint64_t generation)
+{
+  FILE *f = g_fopen(path, "wb");
+  if(!f) return FALSE;
+  const _pack_header_t header = { PACK_MAGIC, PACK_VERSION, generation };
+  const gboolean ok = fwrite(&header, sizeof(header), 1, f) == 1 && _sync(f);
+  fclose(f);
+  return ok;
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *dirname)
+{
+  if(g_mkdir_with_parents(dirname, 0750)) return NULL;
+
+  dt_mipmap_pack_t *pack = g_new0(dt_mipmap_pack_t, 1);
+  dt_pthread_mutex_init(&pack->lock, NULL);
+  pack->pack_path = g_build_filename(dirname, "thumbs.pack", NULL);
+  pack->index_path = g_build_filename(dirname, "thumbs.idx", NULL);
+  pack->index = g_hash_table_new_full(NULL, NULL, NULL, g_free);
+
+  // read the header, start a fresh pack if it is missing or foreign
+  _pack_header_t header = { 0 };
+  FILE *f = g_fopen(pack->pack_path, "rb");
+  const gboolean valid = f && fread(&header, sizeof(header), 1, f) == 1
+                         && header.magic == PACK_MAGIC && header.version == PACK_VERSION;
+  if(f) fclose(f);
+  if(!valid)
+  {
+    header.generation = g_get_real_time();
+    if(!_create(pack->pack_path, header.generation))
+    {
+      dt_mipmap_pack_close(pack);
+      return NULL;
+    }
+  }
+  pack->generation = header.generation;
+
+  GStatBuf st;
+  const uint64_t pack_size = g_stat(pack->pack_path, &st) ? 0 : (uint64_t)st.st_size;
+  const uint64_t covered = _read_index(pack, pack_size);
+  const uint64_t end = _replay(pack, covered);
+
+  if(end < pack_size)
+  {
+    // torn or foreign tail, cut it off so appends start on a record boundary
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] dropping %" PRIu64 " bytes of torn data in `%s'",
+             pack_size - end, pack->pack_path);
+    if(pack->map) g_mapped_file_unref(pack->map);
+    pack->map = NULL;
+    pack->mapped = 0;
+#ifdef _WIN32
+    FILE *t = g_fopen(pack->pack_path, "r+b");
+    if(t)
+    {
+      _chsize_s(_fileno(t), end);
+      fclose(t);
+    }
+#else
+    if(truncate(pack->pack_path, end))
+      dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] can't truncate `%s'", pack->pack_path);
+#endif
+  }
+
+  pack->f = g_fopen(pack->pack_path, "ab");
+  if(!pack->f)
+  {
+    dt_mipmap_pack_close(pack);
+    return NULL;
+  }
+  pack->size = pack->synced = end;
+  if(end != covered) _write_index(pack);
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] `%s': %u thumbnails, %" PRIu64 " of %" PRIu64 " bytes dead",
+           pack->pack_path, g_hash_table_size(pack->index), pack->dead, pack->size);
+  return pack;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  if(pack->f)
+  {
+    if(pack->dead > (16u << 20) && pack->dead * 2 > pack->size)
+      dt_mipmap_pack_compact(pack);
+    else if(pack->unindexed || pack->synced < pack->size)
+      _write_index(pack);
+  }
+  if(pack->f) fclose(pack->f);
+  if(pack->map) g_mapped_file_unref(pack->map);
+  g_hash_table_destroy(pack->index);
+  g_free(pack->pack_path);
+  g_free(pack->index_path);
+  dt_pthread_mutex_destroy(&pack->lock);
+  g_free(pack);
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean found = g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->lock);
+  return found;
+}
+
+#ifndef _WIN32
+// one record read from the file, NULL on error. lock held, so that a
+// compaction does not replace the file meanwhile.
+static uint8_t *_read_record(const char *path, const uint64_t offset, const uint32_t length)
+{
+  const int fd = g_open(path, O_RDONLY, 0);
+  if(fd < 0) return NULL;
+  uint8_t *data = g_malloc(length);
+  const gboolean ok = pread(fd, data, length, (off_t)offset) == (ssize_t)length;
+  close(fd);
+  if(!ok)
+  {
+    g_free(data);
+    return NULL;
+  }
+  return data;
+}
+#endif
+
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             dt_mipmap_pack_blob_t *blob)
+{
+  memset(blob, 0, sizeof(*blob));
+  dt_pthread_mutex_lock(&pack->lock);
+  const _index_entry_t *e = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgid));
+  if(!e)
+  {
+    dt_pthread_mutex_unlock(&pack->lock);
+    return FALSE;
+  }
+  const _index_entry_t entry = *e;
+
+#ifndef _WIN32
+  // a record written since the pack was mapped, the whole pack is only
+  // mapped again once enough of them have piled up
+  if(pack->map && entry.offset >= pack->mapped && pack->size - pack->mapped < PACK_REMAP_STEP)
+  {
+    if(pack->f) fflush(pack->f);
+    blob->copy = _read_record(pack->pack_path, entry.offset, entry.length);
+    dt_pthread_mutex_unlock(&pack->lock);
+    if(!blob->copy) return FALSE;
+    blob->data = blob->copy;
+  }
+  else
+#endif
+  {
+    if(!_remap(pack, entry.offset + entry.length))
+    {
+      dt_pthread_mutex_unlock(&pack->lock);
+      return FALSE;
+    }
+    blob->map = g_mapped_file_ref(pack->map);
+    dt_pthread_mutex_unlock(&pack->lock);
+
+    // decode from the mapping without holding the lock, the reference keeps
+    // it valid even if a writer remaps meanwhile
+    blob->data = (const uint8_t *)g_mapped_file_get_contents(blob->map) + entry.offset;
+  }
+  blob->length = entry.length;
+  blob->color_space = entry.color_space;
+  if(_checksum(blob->data, blob->length) != entry.checksum)
+  {
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] corrupt thumbnail for ID=%d in `%s'",
+             imgid, pack->pack_path);
+    dt_mipmap_pack_blob_release(blob);
+    dt_mipmap_pack_remove(pack, imgid);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+void dt_mipmap_pack_blob_release(dt_mipmap_pack_blob_t *blob)
+{
+  if(blob->map) g_mapped_file_unref(blob->map);
+  g_free(blob->copy);
+  memset(blob, 0, sizeof(*blob));
+}
+
+// lock held
+static gboolean _append(dt_mipmap_pack_t *pack,
+                        const dt_imgid_t imgid,
+                        const uint8_t *jpeg,
+                        const size_t length,
+                        const int32_t color_space)
+{
+  const _pack_record_t rec = { RECORD_MAGIC, imgid, (uint32_t)length, color_space,
+                               length ? _checksum(jpeg, length) : 0, 0 };
+  if(fwrite(&rec, sizeof(rec), 1, pack->f) != 1
+     || (length && fwrite(jpeg, 1, length, pack->f) != length))
+  {
+    // leave a torn record to the replay on the next open, stop appending
+    dt_print(DT_DEBUG_ALWAYS, "[mipmap_pack] write to `%s' failed", pack->pack_path);
+    fclose(pack->f);
+    pack->f = NULL;
+    return FALSE;
+  }
+  const _index_entry_t entry = { imgid, (uint32_t)length, pack->size + sizeof(rec), color_space,
+                                 rec.checksum };
+  pack->size += sizeof(rec) + length;
+  _index_set(pack, &entry);
+  if(++pack->unindexed >= PACK_INDEX_INTERVAL)
+    _write_index(pack);
+  return TRUE;
+}
+
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint8_t *jpeg,
+                              const size_t length,
+                              const dt_colorspaces_color_profile_type_t color_space)
+{
+  if(!length || length > UINT32_MAX) return FALSE;
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean ok = pack->f && _append(pack, imgid, jpeg, length, color_space);
+  dt_pthread_mutex_unlock(&pack->lock);
+  return ok;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  if(pack->f && g_hash_table_contains(pack->index, GINT_TO_POINTER(imgid)))
+    _append(pack, imgid, NULL, 0, 0);
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+static int _sort_offset(const void *a, const void *b)
+{
+  const _index_entry_t *ea = a, *eb = b;
+  return (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+static void _read_ahead(const uint8_t *base, const uint64_t start, const uint64_t end)
+{
+#if !defined(_WIN32) && defined(POSIX_MADV_WILLNEED)
+  // the kernel turns this into one read of the whole span
+  const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  const uint64_t aligned = start & ~(page - 1);
+  posix_madvise((void *)(base + aligned), end - aligned, POSIX_MADV_WILLNEED);
+#else
+  // touch the pages in order
+  volatile uint8_t sink = 0;
+  for(uint64_t k = start; k < end; k += 4096) sink ^= base[k];
+  (void)sink;
+#endif
+}
+
+void dt_mipmap_pack_prefetch(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t *imgids,
+                             const int count)
+{
+  if(count <= 0) return;
+  _index_entry_t *found = g_new(_index_entry_t, count);
+  int n = 0;
+  uint64_t end = 0;
+
+  dt_pthread_mutex_lock(&pack->lock);
+  for(int k = 0; k < count; k++)
+  {
+    const _index_entry_t *e = g_hash_table_lookup(pack->index, GINT_TO_POINTER(imgids[k]));
+    if(!e) continue;
+    found[n++] = *e;
+    end = MAX(end, e->offset + e->length);
+  }
+  GMappedFile *map = (n && _remap(pack, end)) ? g_mapped_file_ref(pack->map) : NULL;
+  dt_pthread_mutex_unlock(&pack->lock);
+
+  if(map)
+  {
+    // merge neighbouring records into runs, one read per run
+    qsort(found, n, sizeof(_index_entry_t), _sort_offset);
+    const uint8_t *base = (const uint8_t *)g_mapped_file_get_contents(map);
+    uint64_t run_start = found[0].offset, run_end = found[0].offset + found[0].length;
+    for(int k = 1; k < n; k++)
+    {
+      if(found[k].offset > run_end + PACK_PREFETCH_GAP)
+      {
+        _read_ahead(base, run_start, run_end);
+        run_start = found[k].offset;
+      }
+      run_end = MAX(run_end, found[k].offset + found[k].length);
+    }
+    _read_ahead(base, run_start, run_end);
+    g_mapped_file_unref(map);
+  }
+  g_free(found);
+}
+
+static int _sort_imgid(const void *a, const void *b)
+{
+  const _index_entry_t *ea = a, *eb = b;
+  return (ea->imgid > eb->imgid) - (ea->imgid < eb->imgid);
+}
+
+void dt_mipmap_pack_compact(dt_mipmap_pack_t *pack)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  if(!pack->f || !_remap(pack, pack->size))
+  {
+    dt_pthread_mutex_unlock(&pack->lock);
+    return;
+  }
+
+  const guint n = g_hash_table_size(pack->index);
+  _index_entry_t *live = g_new(_index_entry_t, MAX(n, 1));
+  GHashTableIter it;
+  gpointer value;
+  guint k = 0;
+  g_hash_table_iter_init(&it, pack->index);
+  while(g_hash_table_iter_next(&it, NULL, &value))
+    live[k++] = *(_index_entry_t *)value;
+  qsort(live, n, sizeof(_index_entry_t), _sort_imgid);
+
+  gchar *tmp = g_strdup_printf("%s.tmp", pack->pack_path);
+  const uint64_t generation = MAX(g_get_real_time(), pack->generation + 1);
+  gboolean ok = _create(tmp, generation);
+  FILE *f = ok ? g_fopen(tmp, "ab") : NULL;
+  ok = ok && f;
+
+  const uint8_t *base = (const uint8_t *)g_mapped_file_get_contents(pack->map);
+  uint64_t offset = sizeof(_pack_header_t);
+  for(k = 0; ok && k < n; k++)
+  {
+    const _pack_record_t rec = { RECORD_MAGIC, live[k].imgid, live[k].length, live[k].color_space,
+                                 live[k].checksum, 0 };
+    ok = fwrite(&rec, sizeof(rec), 1, f) == 1
+         && fwrite(base + live[k].offset, 1, live[k].length, f) == live[k].length;
+    live[k].offset = offset + sizeof(rec);
+    offset += sizeof(rec) + live[k].length;
+  }
+  ok = ok && _sync(f);
+  if(f) fclose(f);
+
+  // a mapped or open file can't be replaced on windows, so let go of the
+  // old pack first. blobs handed out keep their own reference, if one is
+  // still in use there the rename fails and the old pack stays.
+  g_mapped_file_unref(pack->map);
+  pack->map = NULL;
+  pack->mapped = 0;
+  fclose(pack->f);
+  pack->f = NULL;
+
+  // the new pack is complete on disk before it replaces the old one. a crash
+  // before the index is written leaves a generation mismatch, and the next
+  // open rebuilds the index by replaying the whole pack.
+  if(ok && _replace(tmp, pack->pack_path))
+  {
+    pack->generation = generation;
+    pack->size = pack->synced = offset;
+    pack->dead = 0;
+    g_hash_table_remove_all(pack->index);
+    for(k = 0; k < n; k++) _index_set(pack, live + k);
+    pack->f = g_fopen(pack->pack_path, "ab");
+    _write_index(pack);
+    dt_print(DT_DEBUG_CACHE, "[mipmap_pack] compacted `%s' to %" PRIu64 " bytes", pack->pack_path, offset);
+  }
+  else
+  {
+    g_unlink(tmp);
+    pack->f = g_fopen(pack->pack_path, "ab");
+  }
+  _remap(pack, pack->size);
+
+  g_free(tmp);
+  g_free(live);
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,88 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/image.h"
+
+#include <glib.h>
+#include <inttypes.h>
+
+G_BEGIN_DECLS
+
+// packed on-disk store for the thumbnails of one mip level, an
+// alternative to one jpeg file per image.
+//
+// thumbs.pack is append-only: every record carries its image id, colour
+// space, length and a checksum, followed by the jpeg data. a record of
+// length zero drops the image. the file is read through a shared read-only
+// mapping. thumbs.idx is a snapshot of the in-memory index (image id ->
+// offset) covering the pack up to a given size. it is replaced atomically
+// (write, sync, rename) and only ever points at synced data. on open, the
+// records behind the snapshot are replayed and a torn record at the end is
+// cut off, so a crash loses at most the thumbnails written since the last
+// sync. dead space (replaced or dropped records) is reclaimed by
+// dt_mipmap_pack_compact(), which rewrites the live records in image id
+// order, so that a page of the lighttable is one contiguous span.
+
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+// a reference to one stored jpeg, valid until dt_mipmap_pack_blob_release()
+typedef struct dt_mipmap_pack_blob_t
+{
+  const uint8_t *data;
+  size_t length;
+  dt_colorspaces_color_profile_type_t color_space;
+  GMappedFile *map; // keeps the mapping alive while data is in use
+  uint8_t *copy;    // or owns data, for a record read past the mapping
+} dt_mipmap_pack_blob_t;
+
+// open or create the pack in directory dirname. NULL if the directory can't
+// be used.
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *dirname);
+// write the index and compact when at least half of the pack is dead.
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+// TRUE and a verified blob if imgid is stored.
+gboolean dt_mipmap_pack_read(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t imgid,
+                             dt_mipmap_pack_blob_t *blob);
+void dt_mipmap_pack_blob_release(dt_mipmap_pack_blob_t *blob);
+// append a jpeg for imgid, replacing an older one. TRUE on success.
+gboolean dt_mipmap_pack_write(dt_mipmap_pack_t *pack,
+                              const dt_imgid_t imgid,
+                              const uint8_t *jpeg,
+                              const size_t length,
+                              const dt_colorspaces_color_profile_type_t color_space);
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const dt_imgid_t imgid);
+// pull the records of these images into the page cache, merged into as few
+// sequential reads as their placement allows.
+void dt_mipmap_pack_prefetch(dt_mipmap_pack_t *pack,
+                             const dt_imgid_t *imgids,
+                             const int count);
+// rewrite the live records, sorted by image id, into a fresh pack.
+void dt_mipmap_pack_compact(dt_mipmap_pack_t *pack);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
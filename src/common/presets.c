@@ -466,6 +466,126 @@ char *dt_presets_get_module_label(const char *module_name,
   return result;
 }
 
+// a row of data.presets as far as dt_presets_get_module_label() looks at it
+typedef struct _preset_label_t
+{
+  GBytes *op_params;      // NULL for presets without parameters
+  GBytes *blendop_params;
+  gchar *name;
+  gchar *multi_name;
+} _preset_label_t;
+
+struct dt_presets_labels_t
+{
+  GHashTable *operations; // operation -> GPtrArray of _preset_label_t, in rowid order
+};
+
+static GBytes *_preset_label_blob(sqlite3_stmt *stmt, const int col)
+{
+  if(sqlite3_column_type(stmt, col) == SQLITE_NULL) return NULL;
+  return g_bytes_new(sqlite3_column_blob(stmt, col), sqlite3_column_bytes(stmt, col));
+}
+
+static void _preset_label_free(gpointer data)
+{
+  _preset_label_t *label = data;
+  if(label->op_params) g_bytes_unref(label->op_params);
+  if(label->blendop_params) g_bytes_unref(label->blendop_params);
+  g_free(label->name);
+  g_free(label->multi_name);
+  g_free(label);
+}
+
+dt_presets_labels_t *dt_presets_labels_new(const GList *operations)
+{
+  dt_presets_labels_t *labels = g_malloc0(sizeof(dt_presets_labels_t));
+  labels->operations = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             (GDestroyNotify)g_ptr_array_unref);
+
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT op_params, blendop_params, name, multi_name"
+                              " FROM data.presets"
+                              " WHERE operation = ?1"
+                              " ORDER BY rowid",
+                              -1, &stmt, NULL);
+  // clang-format on
+
+  for(const GList *op = operations; op; op = g_list_next(op))
+  {
+    const char *operation = op->data;
+    if(g_hash_table_contains(labels->operations, operation)) continue;
+
+    GPtrArray *rows = g_ptr_array_new_with_free_func(_preset_label_free);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, operation, -1, SQLITE_TRANSIENT);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+    {
+      _preset_label_t *label = g_malloc0(sizeof(_preset_label_t));
+      label->op_params = _preset_label_blob(stmt, 0);
+      label->blendop_params = _preset_label_blob(stmt, 1);
+      label->name = g_strdup((const char *)sqlite3_column_text(stmt, 2));
+      label->multi_name = g_strdup((const char *)sqlite3_column_text(stmt, 3));
+      g_ptr_array_add(rows, label);
+    }
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    g_hash_table_insert(labels->operations, g_strdup(operation), rows);
+  }
+  sqlite3_finalize(stmt);
+
+  return labels;
+}
+
+static gboolean _preset_label_blob_equal(GBytes *blob,
+                                         const void *data,
+                                         const uint32_t size)
+{
+  // sqlite binds a NULL pointer as NULL, which equals nothing
+  if(!blob || !data) return FALSE;
+  gsize blob_size = 0;
+  const void *blob_data = g_bytes_get_data(blob, &blob_size);
+  return blob_size == size && (size == 0 || memcmp(blob_data, data, size) == 0);
+}
+
+char *dt_presets_labels_get(const dt_presets_labels_t *labels,
+                            const char *module_name,
+                            const void *params,
+                            const uint32_t param_size,
+                            const gboolean is_default_params,
+                            const void *blend_params,
+                            const uint32_t blend_params_size)
+{
+  if(!dt_conf_get_bool("darkroom/ui/auto_module_name_update"))
+    return NULL;
+
+  const GPtrArray *rows = g_hash_table_lookup(labels->operations, module_name);
+  if(!rows) return NULL;
+
+  // the same match as the query of dt_presets_get_module_label()
+  for(guint i = 0; i < rows->len; i++)
+  {
+    const _preset_label_t *label = g_ptr_array_index(rows, i);
+    if((_preset_label_blob_equal(label->op_params, params, param_size)
+        || (is_default_params && !label->op_params))
+       && _preset_label_blob_equal(label->blendop_params, blend_params, blend_params_size))
+    {
+      if(label->multi_name
+         && (strlen(label->multi_name) == 0 || label->multi_name[0] != ' '))
+        return dt_presets_get_multi_name(label->name, label->multi_name, FALSE);
+      return NULL;
+    }
+  }
+  return NULL;
+}
+
+void dt_presets_labels_free(dt_presets_labels_t *labels)
+{
+  if(!labels) return;
+  g_hash_table_destroy(labels->operations);
+  g_free(labels);
+}
+
 char *dt_presets_get_multi_name(const char *name,
                                 const char *multi_name,
                                 const gboolean localize)
@@ -43,6 +43,20 @@ char *dt_presets_get_module_label(const char *module_name,
                                   const void *blend_params,
                                   const uint32_t blend_params_size);
 
+/** the presets of some modules read at once, so that their labels can be
+    looked up without querying the database for every module */
+typedef struct dt_presets_labels_t dt_presets_labels_t;
+dt_presets_labels_t *dt_presets_labels_new(const GList *operations);
+/** like dt_presets_get_module_label() for one of the operations read */
+char *dt_presets_labels_get(const dt_presets_labels_t *labels,
+                            const char *module_name,
+                            const void *params,
+                            const uint32_t param_size,
+                            const gboolean is_default_params,
+                            const void *blend_params,
+                            const uint32_t blend_params_size);
+void dt_presets_labels_free(dt_presets_labels_t *labels);
+
 /* returns the module's multi-name to use given the name of the preset
    and the recorded preset's multi_name. This depends on the preference
    darkroom/ui/auto_module_name_update
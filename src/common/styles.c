@@ -25,6 +25,7 @@
 #include "common/history.h"
 #include "common/history_snapshot.h"
 #include "common/image_cache.h"
+#include "common/presets.h"
 #include "common/tags.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -799,199 +800,389 @@ void dt_styles_apply_style_item(dt_develop_t *dev,
   }
 }
 
-void _styles_apply_to_image_ext(const char *name,
-                                const gboolean duplicate,
-                                const gboolean overwrite,
-                                const dt_imgid_t imgid,
-                                const gboolean undo)
+struct dt_style_compiled_t
 {
-  sqlite3_stmt *stmt;
+  gchar *name;
+  int32_t id;
+  GList *items;    // dt_style_item_t, in the order they are merged
+  GList *iop_list; // module order of the style, NULL if it has none
+  guint tagid;     // darktable|style|<name>
+  guint changed_tagid;
+  dt_presets_labels_t *labels; // presets of the operations of the items
+};
 
-  const int style_id = dt_styles_get_id_by_name(name);
+// state of one image while a compiled style is applied on it
+typedef struct _style_apply_t
+{
+  dt_imgid_t imgid;    // image the style is applied on
+  dt_imgid_t newimgid; // image receiving the history, imgid or its duplicate
+  dt_develop_t dev;
+  dt_undo_lt_history_t *hist;
+  gboolean written;
+} _style_apply_t;
+
+static GList *_styles_read_items(const int32_t style_id)
+{
+  sqlite3_stmt *stmt;
+  // clang-format off
+  DT_DEBUG_SQLITE3_PREPARE_V2
+    (dt_database_get(darktable.db),
+     "SELECT num, module, operation, op_params, enabled,"
+     "       blendop_params, blendop_version, multi_priority,"
+     "       multi_name, multi_name_hand_edited"
+     " FROM data.style_items WHERE styleid=?1 "
+     " ORDER BY operation, multi_priority",
+     -1, &stmt, NULL);
+  // clang-format on
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
 
-  if(style_id != 0)
+  GList *si_list = NULL;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    dt_imgid_t newimgid = NO_IMGID;
+    dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
+
+    style_item->num = sqlite3_column_int(stmt, 0);
+    style_item->selimg_num = 0;
+    style_item->enabled = sqlite3_column_int(stmt, 4);
+    style_item->multi_priority = sqlite3_column_int(stmt, 7);
+    style_item->name = NULL;
+    style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
+    style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
+    // see dt_iop_get_instance_name() for why multi_name is handled this way
+    style_item->multi_name =
+      g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
+               ? (char *)sqlite3_column_text(stmt, 8)
+               : "");
+    style_item->module_version = sqlite3_column_int(stmt, 1);
+    style_item->blendop_version = sqlite3_column_int(stmt, 6);
+    style_item->params_size = sqlite3_column_bytes(stmt, 3);
+    style_item->params = (void *)malloc(style_item->params_size);
+    memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
+           style_item->params_size);
+    style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
+    style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
+    memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
+           style_item->blendop_params_size);
+    style_item->iop_order = 0;
+
+    si_list = g_list_prepend(si_list, style_item);
+  }
+  sqlite3_finalize(stmt);
+  return g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
+}
+
+static gpointer _style_item_copy(gconstpointer src, gpointer data)
+{
+  const dt_style_item_t *item = (const dt_style_item_t *)src;
+  dt_style_item_t *copy = malloc(sizeof(dt_style_item_t));
+
+  *copy = *item;
+  copy->name = g_strdup(item->name);
+  copy->operation = g_strdup(item->operation);
+  copy->multi_name = g_strdup(item->multi_name);
+  copy->params = (void *)malloc(item->params_size);
+  memcpy(copy->params, item->params, item->params_size);
+  copy->blendop_params = (void *)malloc(item->blendop_params_size);
+  memcpy(copy->blendop_params, item->blendop_params, item->blendop_params_size);
+  return copy;
+}
+
+dt_style_compiled_t *dt_styles_compile(const char *name)
+{
+  const int32_t style_id = dt_styles_get_id_by_name(name);
+  if(style_id == 0) return NULL;
+
+  dt_style_compiled_t *style = g_malloc0(sizeof(dt_style_compiled_t));
+  style->name = g_strdup(name);
+  style->id = style_id;
+  style->items = _styles_read_items(style_id);
+  style->iop_list = dt_styles_module_order_list(name);
+
+  GList *operations = NULL;
+  for(GList *l = style->items; l; l = g_list_next(l))
+    operations = g_list_prepend(operations, ((dt_style_item_t *)l->data)->operation);
+  style->labels = dt_presets_labels_new(operations);
+  g_list_free(operations);
+
+  gchar ntag[512] = { 0 };
+  gchar *local_name = dt_util_localize_segmented_name(name, FALSE);
+  g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", local_name);
+  g_free(local_name);
+
+  if(!dt_tag_new(ntag, &style->tagid)) style->tagid = 0;
+  if(!dt_tag_new("darktable|changed", &style->changed_tagid)) style->changed_tagid = 0;
+
+  return style;
+}
+
+void dt_styles_compiled_free(dt_style_compiled_t *style)
+{
+  if(!style) return;
+  g_free(style->name);
+  g_list_free_full(style->items, dt_style_item_free);
+  g_list_free_full(style->iop_list, g_free);
+  dt_presets_labels_free(style->labels);
+  g_free(style);
+}
 
-    /* check if we should make a duplicate before applying style */
-    if(duplicate)
+// makes the duplicate and writes the module order
+static void _styles_prepare_image(const dt_style_compiled_t *style,
+                                  _style_apply_t *a,
+                                  const gboolean duplicate,
+                                  const gboolean overwrite,
+                                  const gboolean undo)
+{
+  /* check if we should make a duplicate before applying style */
+  if(duplicate)
+  {
+    a->newimgid = dt_image_duplicate(a->imgid);
+    if(dt_is_valid_imgid(a->newimgid))
     {
-      newimgid = dt_image_duplicate(imgid);
-      if(dt_is_valid_imgid(newimgid))
-      {
-        if(overwrite)
-          dt_history_delete_on_image_ext(newimgid, FALSE, TRUE);
-        else
-          dt_history_copy_and_paste_on_image(imgid, newimgid, FALSE, NULL, TRUE, TRUE, TRUE);
-      }
+      if(overwrite)
+        dt_history_delete_on_image_ext(a->newimgid, FALSE, TRUE);
+      else
+        dt_history_copy_and_paste_on_image(a->imgid, a->newimgid,
+                                           FALSE, NULL, TRUE, TRUE, TRUE);
     }
-    else
-      newimgid = imgid;
+  }
+  else
+    a->newimgid = a->imgid;
 
-    // now deal with the history
-    GList *modules_used = NULL;
+  // now let's deal with the iop-order (possibly merging style & target lists)
+  if(style->iop_list)
+  {
+    GList *iop_list = dt_ioppr_iop_order_copy_deep(style->iop_list);
+    // the style has an iop-order, we need to merge the multi-instance from target image
+    // get target image iop-order list:
+    GList *img_iop_order_list = dt_ioppr_get_iop_order_list(a->newimgid, FALSE);
+    // get multi-instance modules if any:
+    GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
+    // if some where found merge them with the style list
+    if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
+    // finally we have the final list for the image
+    dt_ioppr_write_iop_order_list(iop_list, a->newimgid);
+    g_list_free_full(iop_list, g_free);
+    g_list_free_full(img_iop_order_list, g_free);
+    g_list_free_full(mi, g_free);
+  }
 
-    dt_develop_t _dev_dest = { 0 };
+  if(undo)
+  {
+    a->hist = dt_history_snapshot_item_init();
+    a->hist->imgid = a->newimgid;
+    dt_history_snapshot_undo_create
+      (a->hist->imgid, &a->hist->before, &a->hist->before_history_end);
+  }
+}
 
-    dt_develop_t *dev_dest = &_dev_dest;
+// reads the history of the image the style is merged into
+static void _styles_read_image(const dt_style_compiled_t *style,
+                               _style_apply_t *a)
+{
+  dt_develop_t *dev_dest = &a->dev;
 
-    dt_dev_init(dev_dest, FALSE);
+  dt_dev_init(dev_dest, FALSE);
 
-    dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
-    dev_dest->image_storage.id = imgid;
+  dev_dest->iop = dt_iop_load_modules_ext(dev_dest, TRUE);
+  dev_dest->image_storage.id = a->imgid;
 
-    // now let's deal with the iop-order (possibly merging style & target lists)
-    GList *iop_list = dt_styles_module_order_list(name);
-    if(iop_list)
-    {
-      // the style has an iop-order, we need to merge the multi-instance from target image
-      // get target image iop-order list:
-      GList *img_iop_order_list = dt_ioppr_get_iop_order_list(newimgid, FALSE);
-      // get multi-instance modules if any:
-      GList *mi = dt_ioppr_extract_multi_instances_list(img_iop_order_list);
-      // if some where found merge them with the style list
-      if(mi) iop_list = dt_ioppr_merge_multi_instance_iop_order_list(iop_list, mi);
-      // finally we have the final list for the image
-      dt_ioppr_write_iop_order_list(iop_list, newimgid);
-      g_list_free_full(iop_list, g_free);
-      g_list_free_full(img_iop_order_list, g_free);
-      g_list_free_full(mi, g_free);
-    }
+  dt_dev_read_history_ext(dev_dest, a->newimgid, TRUE);
 
-    dt_dev_read_history_ext(dev_dest, newimgid, TRUE);
+  dt_ioppr_check_iop_order(dev_dest, a->newimgid, "dt_styles_apply_to_image ");
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image ");
+  dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
 
-    dt_dev_pop_history_items_ext(dev_dest, dev_dest->history_end);
+  dt_ioppr_check_iop_order(dev_dest, a->newimgid, "dt_styles_apply_to_image 1");
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 1");
+  // the modules are named from the presets read with the style
+  dev_dest->preset_labels = style->labels;
+}
 
-    dt_print(DT_DEBUG_IOPORDER | DT_DEBUG_PIPE,
-             "[styles_apply_to_image_ext] Apply `%s' on ID=%i, history size %i",
-             name, newimgid, dev_dest->history_end);
+// merges the style into the history read by _styles_read_image(). this
+// loads and duplicates modules, which shares state between images, so it
+// runs on the calling thread only
+static void _styles_merge_image(const dt_style_compiled_t *style,
+                                _style_apply_t *a)
+{
+  GList *modules_used = NULL;
 
-    // go through all entries in style
-    // clang-format off
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
-       "SELECT num, module, operation, op_params, enabled,"
-       "       blendop_params, blendop_version, multi_priority,"
-       "       multi_name, multi_name_hand_edited"
-       " FROM data.style_items WHERE styleid=?1 "
-       " ORDER BY operation, multi_priority",
-       -1, &stmt, NULL);
-    // clang-format on
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, style_id);
+  dt_develop_t *dev_dest = &a->dev;
 
-    GList *si_list = NULL;
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      dt_style_item_t *style_item = malloc(sizeof(dt_style_item_t));
-
-      style_item->num = sqlite3_column_int(stmt, 0);
-      style_item->selimg_num = 0;
-      style_item->enabled = sqlite3_column_int(stmt, 4);
-      style_item->multi_priority = sqlite3_column_int(stmt, 7);
-      style_item->name = NULL;
-      style_item->operation = g_strdup((char *)sqlite3_column_text(stmt, 2));
-      style_item->multi_name_hand_edited = sqlite3_column_int(stmt, 9);
-      // see dt_iop_get_instance_name() for why multi_name is handled this way
-      style_item->multi_name =
-        g_strdup((style_item->multi_priority > 0 || style_item->multi_name_hand_edited)
-                 ? (char *)sqlite3_column_text(stmt, 8)
-                 : "");
-      style_item->module_version = sqlite3_column_int(stmt, 1);
-      style_item->blendop_version = sqlite3_column_int(stmt, 6);
-      style_item->params_size = sqlite3_column_bytes(stmt, 3);
-      style_item->params = (void *)malloc(style_item->params_size);
-      memcpy(style_item->params, (void *)sqlite3_column_blob(stmt, 3),
-             style_item->params_size);
-      style_item->blendop_params_size = sqlite3_column_bytes(stmt, 5);
-      style_item->blendop_params = (void *)malloc(style_item->blendop_params_size);
-      memcpy(style_item->blendop_params, (void *)sqlite3_column_blob(stmt, 5),
-             style_item->blendop_params_size);
-      style_item->iop_order = 0;
-
-      si_list = g_list_prepend(si_list, style_item);
-    }
-    sqlite3_finalize(stmt);
-    si_list = g_list_reverse(si_list); // list was built in reverse order, so un-reverse it
+  dt_print(DT_DEBUG_IOPORDER | DT_DEBUG_PIPE,
+           "[styles_apply_to_image_ext] Apply `%s' on ID=%i, history size %i",
+           style->name, a->newimgid, dev_dest->history_end);
 
-    dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
+  // the items get the iop-order of this image, so work on a copy
+  GList *si_list = g_list_copy_deep(style->items, _style_item_copy, NULL);
 
-    for(GList *l = si_list; l; l = g_list_next(l))
-    {
-      dt_style_item_t *style_item = l->data;
-      dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
-    }
+  dt_ioppr_update_for_style_items(dev_dest, si_list, FALSE);
 
-    g_list_free_full(si_list, dt_style_item_free);
+  // go through all entries in style
+  for(GList *l = si_list; l; l = g_list_next(l))
+  {
+    dt_style_item_t *style_item = l->data;
+    dt_styles_apply_style_item(dev_dest, style_item, &modules_used, FALSE);
+  }
 
-    dt_ioppr_check_iop_order(dev_dest, newimgid, "dt_styles_apply_to_image 2");
+  g_list_free_full(si_list, dt_style_item_free);
+  g_list_free(modules_used);
 
-    dt_undo_lt_history_t *hist = NULL;
-    if(undo)
-    {
-      hist = dt_history_snapshot_item_init();
-      hist->imgid = newimgid;
-      dt_history_snapshot_undo_create
-        (hist->imgid, &hist->before, &hist->before_history_end);
-    }
+  dt_ioppr_check_iop_order(dev_dest, a->newimgid, "dt_styles_apply_to_image 2");
+}
 
-    // write history and forms to db
-    dt_dev_write_history_ext(dev_dest, newimgid);
+// writes history and tags, expected to run inside a transaction or a batch
+static void _styles_write_image(const dt_style_compiled_t *style,
+                                _style_apply_t *a)
+{
+  a->written = TRUE;
 
-    if(undo)
-    {
-      dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
-      dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
-      dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
-                     dt_history_snapshot_undo_pop,
-                     dt_history_snapshot_undo_lt_history_data_free);
-      dt_undo_end_group(darktable.undo);
-    }
+  // write history and forms to db
+  dt_dev_write_history_ext(&a->dev, a->newimgid);
+  dt_dev_cleanup(&a->dev);
 
-    dt_dev_cleanup(dev_dest);
+  /* add tag */
+  if(style->tagid) dt_tag_attach(style->tagid, a->newimgid, FALSE, FALSE);
+  if(style->changed_tagid) dt_tag_attach(style->changed_tagid, a->newimgid, FALSE, FALSE);
+}
 
-    g_list_free(modules_used);
+static void _styles_finish_image(const dt_style_compiled_t *style,
+                                 _style_apply_t *a)
+{
+  if(a->hist)
+  {
+    dt_history_snapshot_undo_create(a->hist->imgid, &a->hist->after,
+                                    &a->hist->after_history_end);
+    dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
+    dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)a->hist,
+                   dt_history_snapshot_undo_pop,
+                   dt_history_snapshot_undo_lt_history_data_free);
+    dt_undo_end_group(darktable.undo);
+  }
 
-    /* add tag */
-    guint tagid = 0;
-    gchar ntag[512] = { 0 };
-    gchar *local_name = dt_util_localize_segmented_name(name, FALSE);
-    g_snprintf(ntag, sizeof(ntag), "darktable|style|%s", local_name);
-    g_free(local_name);
+  if(style->changed_tagid)
+    dt_image_cache_set_change_timestamp(a->imgid);
+
+  /* if current image in develop reload history */
+  if(dt_dev_is_current_image(darktable.develop, a->newimgid))
+  {
+    dt_dev_reload_history_items(darktable.develop);
+    dt_dev_modulegroups_set(darktable.develop,
+                            dt_dev_modulegroups_get(darktable.develop));
+  }
+
+  /* remove old obsolete thumbnails */
+  dt_mipmap_cache_remove(a->newimgid);
+  dt_image_update_final_size(a->newimgid);
+
+  /* update the aspect ratio. recompute only if really needed for performance reasons */
+  if(darktable.collection->params.sorts[DT_COLLECTION_SORT_ASPECT_RATIO])
+    dt_image_set_aspect_ratio(a->newimgid, TRUE);
+  else
+    dt_image_reset_aspect_ratio(a->newimgid, TRUE);
+
+  /* update xmp file */
+  dt_image_synch_xmp(a->newimgid);
+
+  /* redraw center view to update visible mipmaps */
+  DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, a->newimgid);
+}
+
+void dt_styles_apply_compiled_to_image(const dt_style_compiled_t *style,
+                                       const dt_imgid_t imgid,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const gboolean undo)
+{
+  if(!style || !dt_is_valid_imgid(imgid)) return;
+
+  _style_apply_t a = { .imgid = imgid, .newimgid = NO_IMGID };
+
+  _styles_prepare_image(style, &a, duplicate, overwrite, undo);
+
+  if(dt_is_valid_imgid(a.newimgid))
+  {
+    _styles_read_image(style, &a);
+    _styles_merge_image(style, &a);
+
+    dt_database_start_transaction(darktable.db);
+    _styles_write_image(style, &a);
+    dt_database_release_transaction(darktable.db);
+
+    _styles_finish_image(style, &a);
+  }
+  else if(a.hist)
+    dt_history_snapshot_undo_lt_history_data_free(a.hist);
+}
+
+void dt_styles_apply_compiled_to_images(const dt_style_compiled_t *style,
+                                        const dt_imgid_t *imgs,
+                                        const int count,
+                                        const gboolean duplicate,
+                                        const gboolean overwrite,
+                                        const gboolean undo)
+{
+  if(!style || count <= 0) return;
+
+  _style_apply_t *images = g_malloc0_n(count, sizeof(_style_apply_t));
 
-    if(dt_tag_new(ntag, &tagid)) dt_tag_attach(tagid, newimgid, FALSE, FALSE);
-    if(dt_tag_new("darktable|changed", &tagid))
+  // the histories are read and merged first, so that all of them are written
+  // in one batch
+  for(int i = 0; i < count; i++)
+  {
+    images[i].imgid = imgs[i];
+    images[i].newimgid = NO_IMGID;
+    if(!dt_is_valid_imgid(imgs[i])) continue;
+
+    _styles_prepare_image(style, &images[i], duplicate, overwrite, undo);
+    if(dt_is_valid_imgid(images[i].newimgid))
     {
-      dt_tag_attach(tagid, newimgid, FALSE, FALSE);
-      dt_image_cache_set_change_timestamp(imgid);
+      _styles_read_image(style, &images[i]);
+      _styles_merge_image(style, &images[i]);
     }
+  }
 
-    /* if current image in develop reload history */
-    if(dt_dev_is_current_image(darktable.develop, newimgid))
+  // the batch must not wait for an image lock, a thread holding it could be
+  // waiting for the batch to start a transaction. such images are written after it.
+  dt_database_start_batch(darktable.db);
+  for(int i = 0; i < count; i++)
+    if(dt_is_valid_imgid(images[i].newimgid) && dt_trylock_image(images[i].newimgid))
     {
-      dt_dev_reload_history_items(darktable.develop);
-      dt_dev_modulegroups_set(darktable.develop,
-                              dt_dev_modulegroups_get(darktable.develop));
+      _styles_write_image(style, &images[i]);
+      dt_unlock_image(images[i].newimgid);
     }
+  dt_database_release_batch(darktable.db);
 
-    /* remove old obsolete thumbnails */
-    dt_mipmap_cache_remove(newimgid);
-    dt_image_update_final_size(newimgid);
+  for(int i = 0; i < count; i++)
+  {
+    if(dt_is_valid_imgid(images[i].newimgid))
+    {
+      if(!images[i].written)
+      {
+        dt_database_start_transaction(darktable.db);
+        _styles_write_image(style, &images[i]);
+        dt_database_release_transaction(darktable.db);
+      }
+      _styles_finish_image(style, &images[i]);
+    }
+    else if(images[i].hist)
+      dt_history_snapshot_undo_lt_history_data_free(images[i].hist);
+  }
 
-    /* update the aspect ratio. recompute only if really needed for performance reasons */
-    if(darktable.collection->params.sorts[DT_COLLECTION_SORT_ASPECT_RATIO])
-      dt_image_set_aspect_ratio(newimgid, TRUE);
-    else
-      dt_image_reset_aspect_ratio(newimgid, TRUE);
+  g_free(images);
+}
 
-    /* update xmp file */
-    dt_image_synch_xmp(newimgid);
+static void _styles_apply_to_image_ext(const char *name,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const dt_imgid_t imgid,
+                                       const gboolean undo)
+{
+  dt_style_compiled_t *style = dt_styles_compile(name);
 
-    /* redraw center view to update visible mipmaps */
-    DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_DEVELOP_MIPMAP_UPDATED, newimgid);
+  if(style)
+  {
+    dt_styles_apply_compiled_to_image(style, imgid, duplicate, overwrite, undo);
+    dt_styles_compiled_free(style);
   }
 }
 
@@ -55,6 +55,10 @@ typedef struct dt_style_item_t
   int32_t params_size, blendop_params_size;
 } dt_style_item_t;
 
+/** a style loaded once from the database to be applied on many images,
+    see dt_styles_compile() */
+typedef struct dt_style_compiled_t dt_style_compiled_t;
+
 /** helpers that free a style or style_item. can be used in g_list_free_full() */
 void dt_style_free(gpointer data);
 void dt_style_item_free(gpointer data);
@@ -102,6 +106,28 @@ void dt_styles_apply_to_image(const char *name,
                               const gboolean overwrite,
                               const dt_imgid_t imgid);
 
+/** loads the items, module order and tags of a style for applying it on many images,
+    returns NULL if the style does not exist. free with dt_styles_compiled_free() */
+dt_style_compiled_t *dt_styles_compile(const char *name);
+void dt_styles_compiled_free(dt_style_compiled_t *style);
+
+/** applies a compiled style on an image like dt_styles_apply_to_image(), the history
+    is written back in a transaction of its own */
+void dt_styles_apply_compiled_to_image(const dt_style_compiled_t *style,
+                                       const dt_imgid_t imgid,
+                                       const gboolean duplicate,
+                                       const gboolean overwrite,
+                                       const gboolean undo);
+
+/** applies a compiled style on several images. the histories are read one after the
+    other, merged in parallel and written back in a single database batch */
+void dt_styles_apply_compiled_to_images(const dt_style_compiled_t *style,
+                                        const dt_imgid_t *imgs,
+                                        const int count,
+                                        const gboolean duplicate,
+                                        const gboolean overwrite,
+                                        const gboolean undo);
+
 /** applies the style to the currently edited image in the darkroom.
     does nothing if not called with a proper dev struct initialized */
 void dt_styles_apply_to_dev(const char *name, const dt_imgid_t imgid);
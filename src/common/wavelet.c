@@ -0,0 +1,397 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/wavelet.h"
+#include "control/control.h"     // needed by dwt.h
+#include "common/dwt.h"          // for dwt_interleave_rows
+#include "develop/imageop.h"
+
+#include <stdarg.h>
+
+// enough for two pipes decomposing at the same time, each holding a few
+// full-size buffers and a row scratch
+#define POOL_SLOTS 16
+
+typedef struct _pool_slot_t
+{
+  float *buf;
+  size_t size;      // bytes
+  gboolean busy;
+} _pool_slot_t;
+
+static struct
+{
+  dt_pthread_mutex_t lock;
+  _pool_slot_t slot[POOL_SLOTS];
+  size_t limit;
+  dt_wavelet_pool_stats_t stats;
+} _pool;
+
+void dt_wavelet_pool_init(void)
+{
+  memset(&_pool, 0, sizeof(_pool));
+  dt_pthread_mutex_init(&_pool.lock, NULL);
+}
+
+static size_t _pool_limit(void)
+{
+  return _pool.limit ? _pool.limit : dt_get_singlebuffer_mem();
+}
+
+// drop idle buffers, largest first, until at most `keep` bytes are idle.
+// called with the lock held, the buffers are collected in `drop` and freed
+// by the caller after unlocking.
+static int _pool_trim(const size_t keep, float **drop)
+{
+  int ndrop = 0;
+  while(_pool.stats.idle > keep)
+  {
+    int largest = -1;
+    for(int k = 0; k < POOL_SLOTS; k++)
+      if(_pool.slot[k].buf && !_pool.slot[k].busy
+         && (largest < 0 || _pool.slot[k].size > _pool.slot[largest].size))
+        largest = k;
+    if(largest < 0) break;
+    drop[ndrop++] = _pool.slot[largest].buf;
+    _pool.stats.idle -= _pool.slot[largest].size;
+    _pool.slot[largest].buf = NULL;
+    _pool.slot[largest].size = 0;
+  }
+  return ndrop;
+}
+
+float *dt_wavelet_alloc(const size_t nfloats)
+{
+  const size_t size = dt_round_size(MAX(nfloats, 1) * sizeof(float), DT_CACHELINE_BYTES);
+
+  dt_pthread_mutex_lock(&_pool.lock);
+  // best fit among the idle buffers, but don't tie up one more than twice
+  // the size needed
+  int best = -1;
+  for(int k = 0; k < POOL_SLOTS; k++)
+  {
+    const _pool_slot_t *s = &_pool.slot[k];
+    if(s->buf && !s->busy && s->size >= size && s->size / 2 <= size
+       && (best < 0 || s->size < _pool.slot[best].size))
+      best = k;
+  }
+  if(best >= 0)
+  {
+    _pool_slot_t *s = &_pool.slot[best];
+    s->busy = TRUE;
+    _pool.stats.reused++;
+    _pool.stats.idle -= s->size;
+    _pool.stats.in_use += s->size;
+    _pool.stats.peak = MAX(_pool.stats.peak, _pool.stats.in_use);
+    dt_pthread_mutex_unlock(&_pool.lock);
+    return s->buf;
+  }
+  dt_pthread_mutex_unlock(&_pool.lock);
+
+  float *buf = dt_alloc_align_float(size / sizeof(float));
+  if(!buf)
+  {
+    // what we keep around might be what's missing
+    dt_wavelet_pool_cleanup();
+    buf = dt_alloc_align_float(size / sizeof(float));
+    if(!buf) return NULL;
+  }
+
+  float *drop = NULL;
+  dt_pthread_mutex_lock(&_pool.lock);
+  _pool.stats.allocations++;
+  // take an empty slot, or the slot of the largest idle buffer, which had
+  // no use for this request anyway. with all slots busy the buffer stays
+  // outside of the pool and is freed on release.
+  int slot = -1;
+  for(int k = 0; k < POOL_SLOTS && slot < 0; k++)
+    if(!_pool.slot[k].buf) slot = k;
+  if(slot < 0)
+    for(int k = 0; k < POOL_SLOTS; k++)
+      if(!_pool.slot[k].busy && (slot < 0 || _pool.slot[k].size > _pool.slot[slot].size))
+        slot = k;
+  if(slot >= 0)
+  {
+    _pool_slot_t *s = &_pool.slot[slot];
+    if(s->buf)
+    {
+      drop = s->buf;
+      _pool.stats.idle -= s->size;
+    }
+    s->buf = buf;
+    s->size = size;
+    s->busy = TRUE;
+    _pool.stats.in_use += size;
+    _pool.stats.peak = MAX(_pool.stats.peak, _pool.stats.in_use);
+  }
+  dt_pthread_mutex_unlock(&_pool.lock);
+
+  dt_free_align(drop);
+  return buf;
+}
+
+float *dt_wavelet_alloc_clear(const size_t nfloats)
+{
+  float *buf = dt_wavelet_alloc(nfloats);
+  if(buf) memset(buf, 0, nfloats * sizeof(float));
+  return buf;
+}
+
+void dt_wavelet_free(float *buf)
+{
+  if(!buf) return;
+
+  float *drop[POOL_SLOTS];
+  int ndrop = 0;
+  gboolean pooled = FALSE;
+  dt_pthread_mutex_lock(&_pool.lock);
+  for(int k = 0; k < POOL_SLOTS; k++)
+  {
+    _pool_slot_t *s = &_pool.slot[k];
+    if(s->buf == buf)
+    {
+      s->busy = FALSE;
+      _pool.stats.in_use -= s->size;
+      _pool.stats.idle += s->size;
+      pooled = TRUE;
+      break;
+    }
+  }
+  if(pooled)
+    ndrop = _pool_trim(_pool_limit(), drop);
+  dt_pthread_mutex_unlock(&_pool.lock);
+
+  if(!pooled) dt_free_align(buf);
+  for(int k = 0; k < ndrop; k++)
+    dt_free_align(drop[k]);
+}
+
+gboolean dt_wavelet_alloc_buffers(dt_iop_module_t *module,
+                                  const size_t nfloats,
+                                  ...)
+{
+  gboolean success = TRUE;
+  va_list args;
+  va_start(args, nfloats);
+  float **bufptr;
+  while((bufptr = va_arg(args, float **)))
+  {
+    *bufptr = success ? dt_wavelet_alloc(nfloats) : NULL;
+    if(!*bufptr) success = FALSE;
+  }
+  va_end(args);
+
+  if(success)
+  {
+    if(module)
+      dt_iop_set_module_trouble_message(module, NULL, NULL, NULL);
+    return TRUE;
+  }
+
+  va_start(args, nfloats);
+  while((bufptr = va_arg(args, float **)))
+  {
+    dt_wavelet_free(*bufptr);
+    *bufptr = NULL;
+  }
+  va_end(args);
+  if(module)
+    dt_iop_set_module_trouble_message(module, _("insufficient memory"),
+                                      _("this module was unable to allocate\n"
+                                        "all of the memory required to process\n"
+                                        "the image.  some or all processing\n"
+                                        "has been skipped."),
+                                      "unable to allocate working memory");
+  return FALSE;
+}
+
+void dt_wavelet_pool_set_limit(const size_t bytes)
+{
+  float *drop[POOL_SLOTS];
+  dt_pthread_mutex_lock(&_pool.lock);
+  _pool.limit = bytes;
+  const int ndrop = _pool_trim(_pool_limit(), drop);
+  dt_pthread_mutex_unlock(&_pool.lock);
+  for(int k = 0; k < ndrop; k++)
+    dt_free_align(drop[k]);
+}
+
+void dt_wavelet_pool_cleanup(void)
+{
+  float *drop[POOL_SLOTS];
+  dt_pthread_mutex_lock(&_pool.lock);
+  const int ndrop = _pool_trim(0, drop);
+  dt_pthread_mutex_unlock(&_pool.lock);
+  for(int k = 0; k < ndrop; k++)
+    dt_free_align(drop[k]);
+}
+
+void dt_wavelet_pool_stats(dt_wavelet_pool_stats_t *stats)
+{
+  dt_pthread_mutex_lock(&_pool.lock);
+  *stats = _pool.stats;
+  dt_pthread_mutex_unlock(&_pool.lock);
+}
+
+void dt_wavelet_pool_reset_peak(void)
+{
+  dt_pthread_mutex_lock(&_pool.lock);
+  _pool.stats.peak = _pool.stats.in_use;
+  dt_pthread_mutex_unlock(&_pool.lock);
+}
+
+// 2 * center + above + below, with the rows 'vscale' above and below
+// reflected at the top and bottom edges
+static inline void _hat_vertical(float *const restrict out,
+                                 const float *const restrict in,
+                                 const int row,
+                                 const size_t rowlen,
+                                 const int height,
+                                 const int vscale)
+{
+  const int above_row = abs(row - vscale);
+  const int below_row = (row + vscale < height) ? row + vscale : 2 * (height - 1) - (row + vscale);
+  const float *const restrict center = in + row * rowlen;
+  const float *const restrict above = in + above_row * rowlen;
+  const float *const restrict below = in + below_row * rowlen;
+  DT_OMP_SIMD()
+  for(size_t k = 0; k < rowlen; k++)
+    out[k] = 2.f * center[k] + above[k] + below[k];
+}
+
+static inline void _hat_pixel(float *const restrict coarse,
+                              const float *const restrict vert,
+                              const float *const restrict fine,
+                              float *const restrict accum,
+                              const float threshold,
+                              const int col,
+                              const int width,
+                              const int ch,
+                              const int hscale)
+{
+  const int left = abs(col - hscale);
+  const int right = (col + hscale < width) ? col + hscale : 2 * (width - 1) - (col + hscale);
+  for(int c = 0; c < ch; c++)
+  {
+    const size_t k = (size_t)col * ch + c;
+    const float hat = (2.f * vert[k] + vert[(size_t)left * ch + c] + vert[(size_t)right * ch + c]) / 16.f;
+    coarse[k] = hat;
+    if(accum)
+    {
+      const float diff = fine[k] - hat;
+      accum[k] += MAX(diff - threshold, 0.0f) + MIN(diff + threshold, 0.0f);
+    }
+  }
+}
+
+// 2 * center + left + right, normalized by the weight of both passes. the
+// columns between the reflected borders don't care about channels, they
+// are one contiguous run of floats.
+static inline void _hat_horizontal(float *const restrict coarse,
+                                   const float *const restrict vert,
+                                   const float *const restrict fine,
+                                   float *const restrict accum,
+                                   const float threshold,
+                                   const int width,
+                                   const int ch,
+                                   const int hscale)
+{
+  const int lend = MIN(hscale, width);
+  const int rstart = MAX(lend, width - hscale);
+  for(int col = 0; col < lend; col++)
+    _hat_pixel(coarse, vert, fine, accum, threshold, col, width, ch, hscale);
+
+  const size_t off = (size_t)hscale * ch;
+  const size_t end = (size_t)rstart * ch;
+  if(accum)
+  {
+    DT_OMP_SIMD()
+    for(size_t k = (size_t)lend * ch; k < end; k++)
+    {
+      const float hat = (2.f * vert[k] + vert[k - off] + vert[k + off]) / 16.f;
+      const float diff = fine[k] - hat;
+      coarse[k] = hat;
+      // the sum of both clamped alternatives vectorizes, copysignf() doesn't
+      accum[k] += MAX(diff - threshold, 0.0f) + MIN(diff + threshold, 0.0f);
+    }
+  }
+  else
+  {
+    DT_OMP_SIMD()
+    for(size_t k = (size_t)lend * ch; k < end; k++)
+      coarse[k] = (2.f * vert[k] + vert[k - off] + vert[k + off]) / 16.f;
+  }
+
+  for(int col = rstart; col < width; col++)
+    _hat_pixel(coarse, vert, fine, accum, threshold, col, width, ch, hscale);
+}
+
+static inline size_t _hat_scratch_row(const int width, const int ch)
+{
+  return dt_round_size((size_t)width * ch, DT_CACHELINE_BYTES / sizeof(float));
+}
+
+float *dt_wavelet_hat_alloc_scratch(const int width, const int ch)
+{
+  return dt_wavelet_alloc(_hat_scratch_row(width, ch) * dt_get_num_threads());
+}
+
+void dt_wavelet_hat_decompose(float *const coarse,
+                              const float *const fine,
+                              float *const accum,
+                              const float threshold,
+                              const int width,
+                              const int height,
+                              const int ch,
+                              const int lev,
+                              float *const scratch)
+{
+  // a scale reaching across the whole image is reflected at the far edge
+  const int vscale = MIN(1 << lev, height - 1);
+  const int hscale = MIN(1 << lev, width - 1);
+  const size_t rowlen = (size_t)width * ch;
+  const size_t padded = _hat_scratch_row(width, ch);
+
+  DT_OMP_FOR()
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    // consecutive rows of one thread are vscale apart, two of the three
+    // rows needed by the vertical pass are still cached from the last one
+    const int row = dwt_interleave_rows(rowid, height, MAX(vscale, 1));
+    float *const restrict vert = dt_get_perthread(scratch, padded);
+    const size_t rowstart = (size_t)row * rowlen;
+    _hat_vertical(vert, fine, row, rowlen, height, vscale);
+    _hat_horizontal(coarse + rowstart, vert, fine + rowstart,
+                    accum ? accum + rowstart : NULL, threshold, width, ch, hscale);
+  }
+}
+
+void dt_wavelet_detail(float *const fine,
+                       const float *const coarse,
+                       const size_t nfloats)
+{
+  DT_OMP_FOR_SIMD()
+  for(size_t k = 0; k < nfloats; k++)
+    fine[k] -= coarse[k];
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
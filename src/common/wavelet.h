@@ -0,0 +1,112 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+G_BEGIN_DECLS
+
+struct dt_iop_module_t;
+
+// shared parts of the multiscale transforms: the à trous hat decomposition
+// used by dwt.c, and the scratch memory of dwt.c, eaw.c and the modules
+// built on them.
+//
+// a decomposition needs the same few full-size buffers on every process
+// call, so instead of going through the allocator each time they come from
+// a small pool of aligned buffers which are kept after use. idle buffers
+// are bounded by dt_get_singlebuffer_mem() (or the limit given to
+// dt_wavelet_pool_set_limit()), the largest idle ones are dropped first.
+
+// an aligned, uninitialised buffer of at least nfloats floats, NULL if out
+// of memory. give it back with dt_wavelet_free().
+float *dt_wavelet_alloc(const size_t nfloats);
+// same, cleared to zero
+float *dt_wavelet_alloc_clear(const size_t nfloats);
+// return a buffer to the pool, NULL is ignored
+void dt_wavelet_free(float *buf);
+
+// like dt_iop_alloc_image_buffers(): takes a NULL terminated list of
+// float ** and fills each with a buffer of nfloats from the pool. if one of
+// them fails all are given back, the module's trouble message is set and
+// FALSE is returned.
+gboolean dt_wavelet_alloc_buffers(struct dt_iop_module_t *module,
+                                  const size_t nfloats,
+                                  ...);
+
+// once at startup, before the first buffer is asked for
+void dt_wavelet_pool_init(void);
+// bytes of idle buffers the pool may keep, 0 for the default
+void dt_wavelet_pool_set_limit(const size_t bytes);
+// free all idle buffers. done when a pipe is cleaned up, when an allocation
+// fails and at shutdown, so that idle buffers outlive neither the pipes
+// which used them nor the memory they could free.
+void dt_wavelet_pool_cleanup(void);
+
+typedef struct dt_wavelet_pool_stats_t
+{
+  size_t allocations;   // buffers which had to be allocated
+  size_t reused;        // requests served from the pool
+  size_t in_use;        // bytes handed out right now
+  size_t peak;          // largest in_use seen
+  size_t idle;          // bytes kept for the next caller
+} dt_wavelet_pool_stats_t;
+
+void dt_wavelet_pool_stats(dt_wavelet_pool_stats_t *stats);
+void dt_wavelet_pool_reset_peak(void);
+
+// one level of the separable à trous hat transform: weights 1 2 1 at a
+// distance of 2^lev in both directions, reflected at the borders. writes
+// the coarse approximation of fine (ch floats per pixel) to coarse, fine is
+// not modified. each row is filtered vertically into a per-thread row and
+// horizontally from there, rows are visited such that a thread's next row
+// is 2^lev below, so the working set is a few rows instead of a full-size
+// intermediate.
+//
+// if accum is not NULL, the detail band fine - coarse is shrunk towards
+// zero by threshold and added to accum on the fly, so denoising by
+// thresholding never stores a detail band.
+//
+// scratch holds a row per thread, from dt_wavelet_hat_alloc_scratch(). it is
+// allocated by the caller so that a decomposition can't fail half way.
+void dt_wavelet_hat_decompose(float *const coarse,
+                              const float *const fine,
+                              float *const accum,
+                              const float threshold,
+                              const int width,
+                              const int height,
+                              const int ch,
+                              const int lev,
+                              float *const scratch);
+// the row scratch of dt_wavelet_hat_decompose() for images width pixels of
+// ch floats wide, NULL if out of memory. give it back with dt_wavelet_free().
+float *dt_wavelet_hat_alloc_scratch(const int width, const int ch);
+
+// fine -= coarse: turns the finer level into the detail band, in place
+void dt_wavelet_detail(float *const fine,
+                       const float *const coarse,
+                       const size_t nfloats);
+
+G_END_DECLS
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -204,6 +204,7 @@ void dt_control_init(const gboolean withgui)
   dt_atomic_set_int(&s->quitting, 0);
   dt_atomic_set_int(&s->pending_jobs, 0);
   dt_atomic_set_int(&s->running_jobs, 0);
+  dt_atomic_set_int(&s->system_fg_running, 0);
   s->cups_started = FALSE;
 
   dt_action_define_fallback(DT_ACTION_TYPE_IOP, &dt_action_def_iop);
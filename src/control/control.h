@@ -182,6 +182,7 @@ typedef struct dt_control_t
   dt_atomic_int quitting;
   dt_atomic_int pending_jobs;
   dt_atomic_int running_jobs;
+  dt_atomic_int system_fg_running; // jobs of the system foreground queue being executed
   gboolean cups_started;
   gboolean export_scheduled;
   dt_pthread_mutex_t queue_mutex, cond_mutex;
@@ -191,7 +192,10 @@ typedef struct dt_control_t
   dt_job_t **job;
 
   GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  size_t queue_length[DT_JOB_QUEUE_MAX]; // including the jobs in the deques
+  // per worker and queue, the jobs added by the job running on that worker. it takes the
+  // newest first, idle workers steal the oldest. see _control_schedule_job()
+  GQueue (*deques)[DT_JOB_QUEUE_MAX];
 
   dt_pthread_mutex_t res_mutex;
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
@@ -884,6 +884,8 @@ static int _update_img_thumbs(const dt_imgid_t imgid,
     dt_mipmap_buffer_t buf;
     dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
     dt_mipmap_cache_release(&buf);
+    // thumbnails requested for the visible area go first, this worker runs them
+    dt_control_job_yield(TRUE);
   }
 
   if(bt->state != DT_JOB_STATE_RUNNING)
@@ -922,10 +924,29 @@ static int _update_all_thumbs(const dt_mipmap_size_t max_mip)
                               " ORDER BY id DESC",
                                 -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, max_mip);
-  while(sqlite3_step(stmt) == SQLITE_ROW && _still_thumbing())
+
+  // the images are collected first, the statement must not stay open while
+  // foreground jobs run inline and write to the database
+  typedef struct _thumb_todo_t
+  {
+    dt_imgid_t imgid;
+    int64_t stamp;
+  } _thumb_todo_t;
+  GArray *todo = g_array_new(FALSE, FALSE, sizeof(_thumb_todo_t));
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const _thumb_todo_t t =
+      { .imgid = sqlite3_column_int(stmt, 0),
+        .stamp = MAX(sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2)) };
+    g_array_append_val(todo, t);
+  }
+  sqlite3_finalize(stmt);
+
+  for(guint k = 0; k < todo->len && _still_thumbing(); k++)
   {
-    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const int64_t stamp = MAX(sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2));
+    dt_control_job_yield(TRUE);
+    const dt_imgid_t imgid = g_array_index(todo, _thumb_todo_t, k).imgid;
+    const int64_t stamp = g_array_index(todo, _thumb_todo_t, k).stamp;
 
     char path[PATH_MAX] = { 0 };
     dt_image_full_path(imgid, path, sizeof(path), NULL);
@@ -939,7 +960,7 @@ static int _update_all_thumbs(const dt_mipmap_size_t max_mip)
       dt_print(DT_DEBUG_CACHE, "[thumb crawler] '%s' ID=%d NOT available", path, imgid);
     }
   }
-  sqlite3_finalize(stmt);
+  g_array_free(todo, TRUE);
 
   if(updated)
     dt_print(DT_DEBUG_CACHE,
@@ -21,6 +21,10 @@
 
 #define DT_CONTROL_FG_PRIORITY 4
 #define DT_CONTROL_MAX_JOBS 30
+// longest a background job gives way in dt_control_job_yield(), running the thumbnails itself or just
+// waiting. the wait is short as the foreground job might be waiting for a lock the background job holds.
+#define DT_CONTROL_MAX_YIELD 5.0
+#define DT_CONTROL_MAX_WAIT 0.5
 
 /* the queue can have scheduled jobs but all
     the workers are sleeping, so this kicks the workers
@@ -60,6 +64,9 @@ typedef struct _dt_job_t
    match
     we don't want to compare result, priority or state since these will change during the course of
    processing.
+    jobs with sized params (dt_control_job_set_params_with_size()) are fully described by their params, so
+   they are equal whatever queue they were added to. the others are only compared by description within
+   the same queue.
     NOTE: maybe allow to pass a comparator for params.
  */
 static inline gboolean _control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
@@ -69,7 +76,6 @@ static inline gboolean _control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
       && j1->params_size == j2->params_size)
     return (j1->execute == j2->execute
             && j1->state_changed_cb == j2->state_changed_cb
-            && j1->queue == j2->queue
             && (memcmp(j1->params, j2->params, j1->params_size) == 0));
   return (j1->execute == j2->execute
           && j1->state_changed_cb == j2->state_changed_cb
@@ -77,6 +83,14 @@ static inline gboolean _control_job_equal(_dt_job_t *j1, _dt_job_t *j2)
           && (g_strcmp0(j1->description, j2->description) == 0));
 }
 
+// long running jobs which give way to foreground work, see dt_control_job_yield()
+static inline gboolean _control_queue_is_background(const dt_job_queue_t queue)
+{
+  return queue == DT_JOB_QUEUE_USER_BG
+      || queue == DT_JOB_QUEUE_USER_EXPORT
+      || queue == DT_JOB_QUEUE_SYSTEM_BG;
+}
+
 static void _control_job_set_state(_dt_job_t *job,
                                     dt_job_state_t state)
 {
@@ -197,6 +211,8 @@ static void _control_job_print(_dt_job_t *job, const char *info, const char *err
 
 
 static __thread int32_t threadid = -1;
+// the job run by this worker thread, NULL for the reserved workers and other threads
+static __thread _dt_job_t *current_job = NULL;
 // As threadid is `per thread` we don't have to use atomics
 static inline int32_t _control_get_threadid()
 {
@@ -248,31 +264,91 @@ static gboolean _control_run_job_res(dt_control_t *control, int32_t res)
   return FALSE;
 }
 
-static _dt_job_t *_control_schedule_job(dt_control_t *control)
+// the job of queue i the worker self would take: the newest one of its own deque, the head
+// of the global queue or the oldest one of the longest deque of another worker, whichever
+// has waited most and in that order on ties. worker is set to where it is, -1 for the global
+// queue.
+static _dt_job_t *_control_queue_candidate(dt_control_t *control,
+                                           const int i,
+                                           const int32_t self,
+                                           int *worker)
+{
+  _dt_job_t *job = NULL;
+  *worker = -1;
+  if(self < control->num_threads && !g_queue_is_empty(&control->deques[self][i]))
+  {
+    job = g_queue_peek_tail(&control->deques[self][i]);
+    *worker = self;
+  }
+
+  if(control->queues[i]
+     && (!job || ((_dt_job_t *)control->queues[i]->data)->priority > job->priority))
+  {
+    job = control->queues[i]->data;
+    *worker = -1;
+  }
+
+  int victim = -1;
+  guint longest = 0;
+  for(int k = 0; k < control->num_threads; k++)
+  {
+    if(k != self && control->deques[k][i].length > longest)
+    {
+      longest = control->deques[k][i].length;
+      victim = k;
+    }
+  }
+  if(victim >= 0)
+  {
+    _dt_job_t *stolen = g_queue_peek_head(&control->deques[victim][i]);
+    if(!job || stolen->priority > job->priority)
+    {
+      job = stolen;
+      *worker = victim;
+    }
+  }
+  return job;
+}
+
+static _dt_job_t *_control_schedule_job(dt_control_t *control, const int only_queue)
 {
   /*
    * job scheduling works like this:
-   * - when there is a single job in the queue head with a maximal priority -> pick it
+   * - every queue offers one job, see _control_queue_candidate(): jobs added by a running
+   *   job wait in a deque of its worker, which takes the newest one first while idle workers
+   *   steal the oldest one of the longest deque
+   * - when there is a single job with a maximal priority -> pick it
    * - otherwise pick among the ones with the maximal priority in the following order:
    *   * user foreground
    *   * system foreground
    *   * user background
    *   * system background
+   * - the background queues are not considered while there is foreground work queued, so
+   *   thumbnails of the visible area always come before background work
    * - the jobs that didn't get picked this round get their priority incremented
+   * with only_queue >= 0 nothing but that queue is considered.
    */
 
   dt_pthread_mutex_lock(&control->queue_mutex);
 
+  const gboolean foreground_queued = control->queue_length[DT_JOB_QUEUE_USER_FG] > 0
+                                     || control->queue_length[DT_JOB_QUEUE_SYSTEM_FG] > 0;
+  const int32_t self = _control_get_threadid();
+
   // find the job
+  _dt_job_t *candidates[DT_JOB_QUEUE_MAX] = { NULL };
+  int workers[DT_JOB_QUEUE_MAX] = { 0 };
   _dt_job_t *job = NULL;
   int winner_queue = DT_JOB_QUEUE_MAX;
   int max_priority = -1;
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(control->queues[i] == NULL) continue;
+    if(control->queue_length[i] == 0) continue;
+    if(only_queue >= 0 && i != only_queue) continue;
     if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
-    if(_job->priority > max_priority)
+    if(foreground_queued && _control_queue_is_background(i)) continue;
+    _dt_job_t *_job = candidates[i] = _control_queue_candidate(control, i, self, &workers[i]);
+    if(_job && _job->priority > max_priority)
     {
       max_priority = _job->priority;
       job = _job;
@@ -290,20 +366,32 @@ static _dt_job_t *_control_schedule_job(dt_control_t *control)
   // is strictly bigger
   // invariant -> job is the one we are looking for
 
-  // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
+  // remove the to be scheduled job from its queue or deque
+  const int worker = workers[winner_queue];
+  if(worker < 0)
+  {
+    GList **queue = &control->queues[winner_queue];
+    *queue = g_list_delete_link(*queue, *queue);
+  }
+  else if(worker == self)
+    g_queue_pop_tail(&control->deques[worker][winner_queue]);
+  else
+  {
+    g_queue_pop_head(&control->deques[worker][winner_queue]);
+    _control_job_print(job, "steal_job", "from worker", worker);
+  }
   control->queue_length[winner_queue]--;
   if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
 
   // and place it in scheduled job array (for job deduping)
-  control->job[_control_get_threadid()] = job;
+  control->job[self] = job;
 
-  // increment the priorities of the others
+  // increment the priorities of the others that were considered, background jobs don't age while
+  // they have to wait for foreground work
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    if(i == winner_queue || !candidates[i]) continue;
+    candidates[i]->priority++;
   }
 
   dt_pthread_mutex_unlock(&control->queue_mutex);
@@ -324,11 +412,13 @@ static void _control_job_execute(_dt_job_t *job)
   _control_job_print(job, "run_job-", "", DT_CTL_WORKER_RESERVED + _control_get_threadid());
 }
 
-static gboolean _control_run_job(dt_control_t *control)
+// run a job taken by _control_schedule_job() on this worker. outer is the job this worker
+// returns to afterwards, if the job has been run from dt_control_job_yield().
+static void _control_run_scheduled_job(dt_control_t *control, _dt_job_t *job, _dt_job_t *outer)
 {
-  _dt_job_t *job = _control_schedule_job(control);
-
-  if(!job) return TRUE;
+  const gboolean system_fg = job->queue == DT_JOB_QUEUE_SYSTEM_FG;
+  if(system_fg) dt_atomic_add_int(&control->system_fg_running, 1);
+  current_job = job;
 
   /* change state to running */
   dt_pthread_mutex_lock(&job->wait_mutex);
@@ -337,19 +427,105 @@ static gboolean _control_run_job(dt_control_t *control)
 
   dt_pthread_mutex_unlock(&job->wait_mutex);
 
+  current_job = outer;
+  if(system_fg) dt_atomic_sub_int(&control->system_fg_running, 1);
+
   // remove the job from scheduled job array (for job deduping)
   dt_pthread_mutex_lock(&control->queue_mutex);
-  control->job[_control_get_threadid()] = NULL;
+  control->job[_control_get_threadid()] = outer;
   if(job->queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = FALSE;
   dt_pthread_mutex_unlock(&control->queue_mutex);
 
   // and free it
   dt_control_job_dispose(job);
   dt_atomic_sub_int(&control->pending_jobs, 1);
+}
+
+static gboolean _control_run_job(dt_control_t *control)
+{
+  _dt_job_t *job = _control_schedule_job(control, -1);
+
+  if(!job) return TRUE;
 
+  _control_run_scheduled_job(control, job, NULL);
   return FALSE;
 }
 
+// interactive work (thumbnails and image loads of the system foreground queue) queued, or
+// running on another worker. the user foreground queue is not waited for, it also carries
+// long jobs like tethering or hdr merges.
+static inline gboolean _control_foreground_pending(dt_control_t *control)
+{
+  // plain reads: this is polled at every tile, a stale value only delays by one poll
+  return control->queue_length[DT_JOB_QUEUE_SYSTEM_FG] > 0
+      || dt_atomic_get_int(&control->system_fg_running) > 0;
+}
+
+gboolean dt_control_job_yield(const gboolean run_inline)
+{
+  dt_control_t *control = darktable.control;
+  _dt_job_t *job = current_job;
+  if(!control || !job || !_control_queue_is_background(job->queue)
+     || !_control_foreground_pending(control))
+    return FALSE;
+
+  _control_job_print(job, "yield", "", DT_CTL_WORKER_RESERVED + _control_get_threadid());
+
+  const double deadline = dt_get_wtime() + (run_inline ? DT_CONTROL_MAX_YIELD : DT_CONTROL_MAX_WAIT);
+  while(dt_control_running()
+        && dt_get_wtime() < deadline
+        && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED
+        && _control_foreground_pending(control))
+  {
+    // thumbnails are run right here, this worker takes them over instead of leaving them to
+    // wait for a free one
+    _dt_job_t *fg_job = run_inline ? _control_schedule_job(control, DT_JOB_QUEUE_SYSTEM_FG) : NULL;
+    if(fg_job)
+      _control_run_scheduled_job(control, fg_job, job);
+    else
+      g_usleep(5000);
+  }
+  return TRUE;
+}
+
+// a job equal to job waiting in a queue or a deque, with where it is. jobs without sized
+// params are only looked for in the system foreground queue, see _control_job_equal().
+static GList *_control_find_queued(dt_control_t *control,
+                                   _dt_job_t *job,
+                                   int *queue,
+                                   int *worker)
+{
+  const gboolean anywhere = job->params_size != 0;
+  if(!anywhere && job->queue != DT_JOB_QUEUE_SYSTEM_FG) return NULL;
+
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    if(!anywhere && i != job->queue) continue;
+    for(GList *iter = control->queues[i]; iter; iter = g_list_next(iter))
+    {
+      if(_control_job_equal(job, iter->data))
+      {
+        *queue = i;
+        *worker = -1;
+        return iter;
+      }
+    }
+    for(int k = 0; k < control->num_threads; k++)
+    {
+      for(GList *iter = control->deques[k][i].head; iter; iter = g_list_next(iter))
+      {
+        if(_control_job_equal(job, iter->data))
+        {
+          *queue = i;
+          *worker = k;
+          return iter;
+        }
+      }
+    }
+  }
+  return NULL;
+}
+
 gboolean dt_control_add_job_res(_dt_job_t *job, const int32_t res)
 {
   dt_control_t *control = darktable.control;
@@ -411,18 +587,14 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
 
   dt_pthread_mutex_lock(&control->queue_mutex);
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
-
-  _control_job_print(job, "add_job", "", (int32_t)length);
+  _control_job_print(job, "add_job", "", (int32_t)control->queue_length[queue_id]);
 
   dt_atomic_add_int(&control->pending_jobs, 1);
-  if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
-  {
-    // this is a stack with limited size and bubble up and all that stuff
-    job->priority = DT_CONTROL_FG_PRIORITY;
 
-    // check if we have already scheduled the job
+  // check if we have already scheduled the job. jobs of the other queues which are only known
+  // by their description may well be different.
+  if(job->params_size || queue_id == DT_JOB_QUEUE_SYSTEM_FG)
+  {
     for(int k = 0; k < control->num_threads; k++)
     {
       _dt_job_t *other_job = control->job[k];
@@ -439,29 +611,52 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
         return 0; // there can't be any further copy
       }
     }
+  }
 
-    // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
-    {
-      _dt_job_t *other_job = iter->data;
-      if(_control_job_equal(job, other_job))
-      {
-        _control_job_print(other_job, "add_job", "found job already in queue", -1);
+  // if the job is already waiting it is kept. it moves to this queue if that comes first,
+  // a thumbnail requested again moves to the top of the stack.
+  int other_queue = DT_JOB_QUEUE_MAX;
+  int other_worker = -1;
+  GList *other = _control_find_queued(control, job, &other_queue, &other_worker);
+  if(other)
+  {
+    _dt_job_t *other_job = other->data;
+    _control_job_print(other_job, "add_job", "found job already in queue", other_queue);
 
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
-        dt_atomic_sub_int(&control->pending_jobs, 1);
+    if(other_queue < queue_id
+       || (other_queue == queue_id && queue_id != DT_JOB_QUEUE_SYSTEM_FG))
+    {
+      dt_pthread_mutex_unlock(&control->queue_mutex);
 
-        job_for_disposal = job;
+      _control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(job);
+      dt_atomic_sub_int(&control->pending_jobs, 1);
 
-        job = other_job;
-        break; // there can't be any further copy in the list
-      }
+      return FALSE;
     }
 
+    if(other_worker < 0)
+      control->queues[other_queue] = g_list_delete_link(control->queues[other_queue], other);
+    else
+      g_queue_delete_link(&control->deques[other_worker][other_queue], other);
+    control->queue_length[other_queue]--;
+    dt_atomic_sub_int(&control->pending_jobs, 1);
+
+    job_for_disposal = job;
+
+    job = other_job;
+    job->queue = queue_id;
+  }
+
+  if(queue_id == DT_JOB_QUEUE_SYSTEM_FG)
+  {
+    // this is a stack with limited size and bubble up and all that stuff
+    job->priority = DT_CONTROL_FG_PRIORITY;
+
     // now we can add the new job to the list
+    GList **queue = &control->queues[queue_id];
     *queue = g_list_prepend(*queue, job);
-    length++;
+    size_t length = ++control->queue_length[queue_id];
 
     // and take care of the maximal queue size
     if(length > DT_CONTROL_MAX_JOBS)
@@ -485,7 +680,12 @@ gboolean dt_control_add_job(dt_job_queue_t queue_id, _dt_job_t *job)
       job->priority = 0;
     else
       job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
+
+    // added by a job running on a worker: into the deque of that worker
+    if(current_job)
+      g_queue_push_tail(&control->deques[_control_get_threadid()][queue_id], job);
+    else
+      control->queues[queue_id] = g_list_append(control->queues[queue_id], job);
     control->queue_length[queue_id]++;
   }
   _control_job_set_state(job, DT_JOB_STATE_QUEUED);
@@ -619,6 +819,7 @@ void dt_control_jobs_init()
   control->num_threads = dt_worker_threads();
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
   control->job = (dt_job_t **)calloc(control->num_threads, sizeof(dt_job_t *));
+  control->deques = calloc(control->num_threads, sizeof(*control->deques));
 
   g_atomic_int_set(&control->running, DT_CONTROL_STATE_RUNNING);
 
@@ -689,6 +890,8 @@ void dt_control_jobs_cleanup()
   dt_control_t *control = darktable.control;
   free(control->job);
   control->job = NULL;
+  free(control->deques);
+  control->deques = NULL;
   free(control->thread);
   control->thread = NULL;
 }
@@ -86,6 +86,11 @@ gboolean dt_control_all_running(void);
 
 gboolean dt_control_add_job(dt_job_queue_t queue_id, dt_job_t *job);
 gboolean dt_control_add_job_res(dt_job_t *job, const int32_t res);
+/** called by long running background jobs at points where they can pause. while jobs of the
+  * system foreground queue are queued or running this waits for them, or with run_inline runs the queued thumbnail jobs right
+  * here. only pass run_inline when no locks are held which a thumbnail job may need.
+  * returns TRUE if it had to wait, a no-op returning FALSE outside background jobs. */
+gboolean dt_control_job_yield(const gboolean run_inline);
 
 dt_view_type_flags_t dt_control_job_get_view_creator(const dt_job_t *job);
 gboolean dt_control_job_is_synchronous(const dt_job_t *job);
@@ -37,6 +37,7 @@
 #include "common/datetime.h"
 #include "common/overlay.h"
 #include "control/conf.h"
+#include "control/jobs/film_jobs.h"
 #include "develop/imageop_math.h"
 #include "imageio/imageio_common.h"
 #include "imageio/imageio_dng.h"
@@ -70,6 +71,8 @@
 // impression that the import has gotten stuck.  Setting this too low
 // will impact the overall time for a large import.
 #define PROGRESS_UPDATE_INTERVAL 0.5
+// images merged together and written in one database batch when applying styles
+#define STYLES_BATCH_SIZE 64
 // How lon in seconds between issuing a collection-query update?
 #define COLLECTION_UPDATE_INTERVAL 3.0
 
@@ -1759,40 +1762,64 @@ static int32_t _control_apply_styles_job_run(dt_job_t *job)
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
 
   const gboolean is_overwrite = style_data->overwrite;
+  // with a single style in overwrite mode the undo covers the history deletion too
+  const gboolean job_undo = is_overwrite && g_list_is_singleton(styles);
 
-  double prev_time = 0;
-  for(GList *t = imgs ; t && !_job_cancelled(job); t = g_list_next(t))
+  // the styles are read once, then applied on batches of images
+  GList *compiled = NULL;
+  for(GList *style = styles; style; style = g_list_next(style))
   {
-    const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
-    if(!dt_is_valid_imgid(imgid)) continue;
+    dt_style_compiled_t *cs = dt_styles_compile((const char *)style->data);
+    if(cs) compiled = g_list_prepend(compiled, cs);
+  }
+  compiled = g_list_reverse(compiled);
 
-    dt_undo_lt_history_t *hist = NULL;
-    if(is_overwrite && g_list_is_singleton(styles))
-    {
-      hist = dt_history_snapshot_item_init();
-      hist->imgid = imgid;
-      dt_history_snapshot_undo_create(hist->imgid, &hist->before,
-                                      &hist->before_history_end);
-      dt_undo_disable_next(darktable.undo);
-    }
-    if(is_overwrite && !duplicate)
-      dt_history_delete_on_image_ext(imgid, FALSE, TRUE);
+  dt_imgid_t batch[STYLES_BATCH_SIZE];
+  dt_undo_lt_history_t *hist[STYLES_BATCH_SIZE];
 
-    for(GList *style = styles; style; style = g_list_next(style))
+  double prev_time = 0;
+  GList *t = imgs;
+  while(t && !_job_cancelled(job))
+  {
+    int count = 0;
+    int processed = 0;
+    for(; t && count < STYLES_BATCH_SIZE; t = g_list_next(t))
     {
-      dt_styles_apply_to_image((const char*)style->data, duplicate, is_overwrite, imgid);
+      const dt_imgid_t imgid = GPOINTER_TO_INT(t->data);
+      processed++;
+      if(!dt_is_valid_imgid(imgid)) continue;
+
+      hist[count] = NULL;
+      if(job_undo)
+      {
+        hist[count] = dt_history_snapshot_item_init();
+        hist[count]->imgid = imgid;
+        dt_history_snapshot_undo_create(hist[count]->imgid, &hist[count]->before,
+                                        &hist[count]->before_history_end);
+      }
+      if(is_overwrite && !duplicate)
+        dt_history_delete_on_image_ext(imgid, FALSE, TRUE);
+
+      batch[count++] = imgid;
     }
 
-    if(is_overwrite && g_list_is_singleton(styles))
+    for(GList *cs = compiled; cs; cs = g_list_next(cs))
+      dt_styles_apply_compiled_to_images(cs->data, batch, count,
+                                         duplicate, is_overwrite, !job_undo);
+
+    for(int i = 0; i < count; i++)
     {
-      dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
-      dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
+      if(!hist[i]) continue;
+      dt_history_snapshot_undo_create(hist[i]->imgid, &hist[i]->after,
+                                      &hist[i]->after_history_end);
+      dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist[i],
                      dt_history_snapshot_undo_pop,
                      dt_history_snapshot_undo_lt_history_data_free);
     }
-    fraction += 1.0 / total;
+    fraction += (double)processed / total;
     _update_progress(job, fraction, &prev_time);
   }
+  g_list_free_full(compiled, (GDestroyNotify)dt_styles_compiled_free);
   dt_undo_end_group(darktable.undo);
   DT_CONTROL_SIGNAL_RAISE(DT_SIGNAL_TAG_CHANGED);
 
@@ -2900,13 +2927,14 @@ static int _control_import_image_copy(const char *filename,
 static int _control_import_image_insitu(const char *filename,
                                         GList **imgs,
                                         double *last_update,
-                                        double *update_interval)
+                                        double *update_interval,
+                                        dt_exif_prefetch_t *prefetch)
 {
   dt_conf_set_int("ui_last/import_last_image", -1);
   char *dirname = dt_util_path_get_dirname(filename);
   dt_film_t film;
   const dt_filmid_t filmid = dt_film_new(&film, dirname);
-  const dt_imgid_t imgid = dt_image_import(filmid, filename, FALSE, FALSE);
+  const dt_imgid_t imgid = dt_image_import_prefetched(filmid, filename, FALSE, FALSE, prefetch);
   if(!dt_is_valid_imgid(imgid)) dt_control_log(_("error loading file `%s'"), filename);
   else
   {
@@ -2997,8 +3025,16 @@ static int32_t _control_import_job_run(dt_job_t *job)
   double update_interval = INIT_UPDATE_INTERVAL;
   char *prev_filename = NULL;
   char *prev_output = NULL;
+  // in place, the metadata of the next images is parsed by the prefetch threads while this
+  // one writes the database, in batches of several images. copies only exist once they
+  // have been written.
+  dt_exif_prefetch_t *prefetch = data->session ? NULL : dt_exif_prefetch_start(t);
+  int batch = 0;
   for(GList *img = t; img && !_job_cancelled(job); img = g_list_next(img))
   {
+    if(batch++ == 0)
+      dt_database_start_batch(darktable.db);
+
     if(data->session)
     {
       filmid = _control_import_image_copy((char *)img->data,
@@ -3028,12 +3064,18 @@ static int32_t _control_import_job_run(dt_job_t *job)
     }
     else
       filmid = _control_import_image_insitu((char *)img->data, &imgs,
-                                            &last_coll_update, &update_interval);
+                                            &last_coll_update, &update_interval, prefetch);
     if(filmid != -1)
       cntr++;
     fraction += 1.0 / total;
     const double currtime  = dt_get_wtime();
-    if(currtime - last_prog_update > PROGRESS_UPDATE_INTERVAL)
+    const gboolean report = currtime - last_prog_update > PROGRESS_UPDATE_INTERVAL;
+    if(report || batch >= DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_batch(darktable.db);
+      batch = 0;
+    }
+    if(report)
     {
       last_prog_update = currtime;
       dt_control_job_set_progress_message(job, ngettext("importing %d/%d image",
@@ -3042,6 +3084,9 @@ static int32_t _control_import_job_run(dt_job_t *job)
       g_usleep(100);
     }
   }
+  if(batch)
+    dt_database_release_batch(darktable.db);
+  dt_exif_prefetch_stop(prefetch);
   g_free(prev_output);
 
   dt_control_log(ngettext("imported %d image", "imported %d images", cntr), cntr);
@@ -18,6 +18,7 @@
 #include "control/jobs/film_jobs.h"
 #include "common/darktable.h"
 #include "common/collection.h"
+#include "common/exif.h"
 #include "common/film.h"
 #include <stdlib.h>
 
@@ -303,8 +304,15 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
   dt_film_t *cfr = film;
   int pending = 0;
   double last_update = dt_get_wtime();
+  // the metadata of the next images is parsed by the prefetch threads while this one writes
+  // the database, in batches of several images
+  dt_exif_prefetch_t *prefetch = dt_exif_prefetch_start(images);
+  int batch = 0;
   for(GList *image = images; image; image = g_list_next(image))
   {
+    if(batch++ == 0)
+      dt_database_start_batch(darktable.db);
+
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
 
     /* check if we need to initialize a new filmroll */
@@ -333,7 +341,8 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     g_free(cdn);
 
     /* import image */
-    const dt_imgid_t imgid = dt_image_import(cfr->id, (const gchar *)image->data, FALSE, FALSE);
+    const dt_imgid_t imgid = dt_image_import_prefetched(cfr->id, (const gchar *)image->data,
+                                                        FALSE, FALSE, prefetch);
     pending++;  // we have another image which hasn't been reported yet
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
@@ -343,7 +352,13 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     const double curr_time = dt_get_wtime();
     // if we've imported at least four images without an update, and it's been at least half a second since the last
     //   one, update the interface
-    if(pending >= 4 && curr_time - last_update > 0.5)
+    const gboolean update = pending >= 4 && curr_time - last_update > 0.5;
+    if(update || batch >= DT_IMPORT_BATCH_SIZE)
+    {
+      dt_database_release_batch(darktable.db);
+      batch = 0;
+    }
+    if(update)
     {
       dt_collection_update_query(darktable.collection, DT_COLLECTION_CHANGE_RELOAD, DT_COLLECTION_PROP_UNDEF,
                                  g_list_copy(imgs));
@@ -356,6 +371,9 @@ static void _film_import1(dt_job_t *job, dt_film_t *film, GList *images)
     if(dt_control_job_get_state(job) == DT_JOB_STATE_CANCELLED)
       break;
   }
+  if(batch)
+    dt_database_release_batch(darktable.db);
+  dt_exif_prefetch_stop(prefetch);
 
   g_list_free_full(images, g_free);
   all_imgs = g_list_reverse(all_imgs);
@@ -22,6 +22,10 @@
 #include "control/control.h"
 #include <inttypes.h>
 
+// images imported in one database batch by the import jobs, see dt_database_start_batch().
+// a batch is also closed whenever the job updates the interface.
+#define DT_IMPORT_BATCH_SIZE 64
+
 dt_job_t *dt_film_import1_create(dt_film_t *film);
 dt_job_t *dt_pathlist_import_create(int argc, char *argv[]);
 
@@ -795,10 +795,15 @@ static void _dev_auto_module_label(dt_develop_t *dev,
     const gboolean is_default_params =
       memcmp(module->params, module->default_params, module->params_size) == 0;
 
-    char *preset_name = dt_presets_get_module_label
-      (module->op,
-       module->params, module->params_size, is_default_params,
-       module->blend_params, sizeof(dt_develop_blend_params_t));
+    char *preset_name = dev->preset_labels
+      ? dt_presets_labels_get
+          (dev->preset_labels, module->op,
+           module->params, module->params_size, is_default_params,
+           module->blend_params, sizeof(dt_develop_blend_params_t))
+      : dt_presets_get_module_label
+          (module->op,
+           module->params, module->params_size, is_default_params,
+           module->blend_params, sizeof(dt_develop_blend_params_t));
 
     // if we have a preset-name, use it. otherwise set the label to the multi-priority
     // except for 0 where the multi-name is cleared.
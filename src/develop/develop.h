@@ -169,6 +169,8 @@ typedef struct dt_develop_t
   gboolean focus_hash;   // determines whether to start a new history item or to merge down.
   gboolean history_updating, image_force_reload, first_load;
   gboolean autosaving;
+  // when set, modules are named from these presets instead of querying the database
+  const struct dt_presets_labels_t *preset_labels;
   double autosave_time;
   int32_t image_invalid_cnt;
   uint32_t timestamp;
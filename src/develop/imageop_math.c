@@ -94,6 +94,68 @@ void dt_iop_flip_and_zoom_8(const uint8_t *in,
   }
 }
 
+void dt_iop_downscale_8(const uint8_t *in,
+                        const int32_t iw,
+                        const int32_t ih,
+                        uint8_t *out,
+                        const int32_t ow,
+                        const int32_t oh,
+                        uint32_t *width,
+                        uint32_t *height)
+{
+  // same output size as dt_iop_flip_and_zoom_8(), no upscaling
+  const float scale = fmaxf(1.0, fmaxf(iw / (float)ow, ih / (float)oh));
+  const uint32_t wd = *width = MIN(ow, iw / scale);
+  const uint32_t ht = *height = MIN(oh, ih / scale);
+  if(!wd || !ht) return;
+
+  const float sx = iw / (float)wd;
+  const float sy = ih / (float)ht;
+  size_t padded;
+  float *const rows = dt_alloc_perthread_float((size_t)4 * iw, &padded);
+  if(!rows)
+  {
+    dt_iop_flip_and_zoom_8(in, iw, ih, out, ow, oh, ORIENTATION_NONE, width, height);
+    return;
+  }
+
+  DT_OMP_FOR()
+  for(uint32_t j = 0; j < ht; j++)
+  {
+    // the input rows under this output row, weighted by how much of them it covers
+    float *const row = dt_get_perthread(rows, padded);
+    memset(row, 0, sizeof(float) * 4 * iw);
+    const float y0 = j * sy;
+    const float y1 = MIN((j + 1) * sy, (float)ih);
+    for(int y = (int)y0; y < y1 && y < ih; y++)
+    {
+      const float w = MIN(y + 1.0f, y1) - MAX((float)y, y0);
+      const uint8_t *const in_row = in + (size_t)4 * iw * y;
+      for(size_t x = 0; x < (size_t)4 * iw; x++)
+        row[x] += w * in_row[x];
+    }
+
+    // then the same across the columns
+    uint8_t *const out_row = out + (size_t)4 * wd * j;
+    for(uint32_t i = 0; i < wd; i++)
+    {
+      const float x0 = i * sx;
+      const float x1 = MIN((i + 1) * sx, (float)iw);
+      dt_aligned_pixel_t sum = { 0.0f };
+      for(int x = (int)x0; x < x1 && x < iw; x++)
+      {
+        const float w = MIN(x + 1.0f, x1) - MAX((float)x, x0);
+        for_four_channels(c) sum[c] += w * row[4 * x + c];
+      }
+      const float norm = 1.0f / ((x1 - x0) * (y1 - y0));
+      for(int c = 0; c < 3; c++)
+        out_row[4 * i + c] = CLAMP((int)(sum[c] * norm + 0.5f), 0, 255);
+      out_row[4 * i + 3] = 0;
+    }
+  }
+  dt_free_align(rows);
+}
+
 void dt_iop_clip_and_zoom_8(const uint8_t *i,
                             const int32_t ix,
                             const int32_t iy,
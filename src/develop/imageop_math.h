@@ -32,6 +32,12 @@
 void dt_iop_flip_and_zoom_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
                             const dt_image_orientation_t orientation, uint32_t *width, uint32_t *height);
 
+/** downscale to fit the given size without flipping, each output pixel averages the exact area it
+ * covers. slower than dt_iop_flip_and_zoom_8() but without its aliasing, for smaller thumbnails
+ * derived from larger ones. */
+void dt_iop_downscale_8(const uint8_t *in, int32_t iw, int32_t ih, uint8_t *out, int32_t ow, int32_t oh,
+                        uint32_t *width, uint32_t *height);
+
 /** for homebrew pixel pipe: zoom pixel array. */
 void dt_iop_clip_and_zoom(float *out, const float *const in, const struct dt_iop_roi_t *const roi_out,
                           const struct dt_iop_roi_t *const roi_in);
@@ -21,6 +21,7 @@
 #include "develop/pixelpipe.h"
 #include "libs/lib.h"
 #include "libs/colorpicker.h"
+#include <float.h>
 #include <stdlib.h>
 
 static inline int _to_mb(size_t m)
@@ -28,6 +29,89 @@ static inline int _to_mb(size_t m)
   return (int)((m + 0x80000lu) / 0x400lu / 0x400lu);
 }
 
+// The index is an open addressing table with linear probing holding the
+// lines >= DT_PIPECACHE_MIN with a valid hash. It has at least twice as many
+// slots as there are lines so probing always ends on an empty slot.
+static inline uint32_t _index_home(const dt_dev_pixelpipe_cache_t *cache,
+                                   const dt_hash_t hash)
+{
+  return (uint32_t)(hash ^ (hash >> 32)) & cache->index_mask;
+}
+
+static int _index_find(const dt_dev_pixelpipe_cache_t *cache,
+                       const dt_hash_t hash)
+{
+  for(uint32_t slot = _index_home(cache, hash);; slot = (slot + 1) & cache->index_mask)
+  {
+    const int k = cache->index[slot];
+    if(k < 0 || cache->hash[k] == hash) return k;
+  }
+}
+
+static void _index_remove(const dt_dev_pixelpipe_cache_t *cache,
+                          const int k)
+{
+  const dt_hash_t hash = cache->hash[k];
+  if(k < DT_PIPECACHE_MIN || hash == DT_INVALID_HASH) return;
+
+  const uint32_t mask = cache->index_mask;
+  uint32_t hole = _index_home(cache, hash);
+  while(cache->index[hole] != k)
+  {
+    if(cache->index[hole] < 0) return;
+    hole = (hole + 1) & mask;
+  }
+  // shift following entries back so no probe sequence gets interrupted
+  for(uint32_t next = (hole + 1) & mask; cache->index[next] >= 0; next = (next + 1) & mask)
+  {
+    const uint32_t home = _index_home(cache, cache->hash[cache->index[next]]);
+    if(((next - home) & mask) >= ((next - hole) & mask))
+    {
+      cache->index[hole] = cache->index[next];
+      hole = next;
+    }
+  }
+  cache->index[hole] = -1;
+}
+
+// all changes of a line's hash go through here to keep the index in sync
+static void _set_hash(const dt_dev_pixelpipe_cache_t *cache,
+                      const int k,
+                      const dt_hash_t hash)
+{
+  if(cache->hash[k] == hash) return;
+  _index_remove(cache, k);
+  cache->hash[k] = hash;
+  if(k < DT_PIPECACHE_MIN || hash == DT_INVALID_HASH) return;
+
+  // a hash is unique in the index, an older line with the same hash is stale
+  const int other = _index_find(cache, hash);
+  if(other >= 0)
+  {
+    _index_remove(cache, other);
+    cache->hash[other] = DT_INVALID_HASH;
+    cache->ioporder[other] = 0;
+  }
+
+  uint32_t slot = _index_home(cache, hash);
+  while(cache->index[slot] >= 0) slot = (slot + 1) & cache->index_mask;
+  cache->index[slot] = k;
+}
+
+// the line handed out last has been filled by its module when the pipe asks
+// for the next one, so the time in between is what it costs to recompute it.
+static void _charge_pending(dt_dev_pixelpipe_t *pipe)
+{
+  dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  const int k = cache->pending;
+  if(k < 0) return;
+
+  cache->pending = -1;
+  // don't charge idle time between two runs
+  if(cache->pending_run == pipe->runs && cache->hash[k] != DT_INVALID_HASH)
+    cache->cost[k] = (float)(dt_get_wtime() - cache->pending_start);
+}
+
 gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
                                      const int entries,
                                      const size_t size,
@@ -37,15 +121,25 @@ gboolean dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_t *pipe,
 
   cache->entries = entries;
   cache->allmem = cache->hits = cache->calls = cache->tests = 0;
+  cache->misses = cache->evicted = 0;
+  cache->cost_saved = cache->cost_evicted = 0.0;
+  cache->pending = -1;
   cache->memlimit = limit;
 
-  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t);
+  const size_t csize = sizeof(void *) + sizeof(size_t) + sizeof(dt_iop_buffer_dsc_t) + 2*sizeof(int32_t) + sizeof(uint64_t) + sizeof(float);
   cache->data = (void **) calloc(entries, csize);
   cache->size = (size_t *)((void *)cache->data + entries * sizeof(void *));
   cache->dsc = (dt_iop_buffer_dsc_t *)((void *)cache->size + entries * sizeof(size_t));
   cache->hash = (dt_hash_t *)((void *)cache->dsc + entries * sizeof(dt_iop_buffer_dsc_t));
   cache->used = (int32_t *)((void *)cache->hash + entries * sizeof(dt_hash_t));
   cache->ioporder = (int32_t *)((void *)cache->used + entries * sizeof(int32_t));
+  cache->cost = (float *)((void *)cache->ioporder + entries * sizeof(int32_t));
+
+  uint32_t slots = 8;
+  while(slots < 2 * (uint32_t)entries) slots <<= 1;
+  cache->index_mask = slots - 1;
+  cache->index = (int32_t *)malloc(sizeof(int32_t) * slots);
+  for(uint32_t k = 0; k < slots; k++) cache->index[k] = -1;
 
   for(int k = 0; k < entries; k++)
   {
@@ -98,6 +192,8 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_t *pipe)
   }
   free(cache->data);
   cache->data = NULL;
+  free(cache->index);
+  cache->index = NULL;
 }
 
 static dt_hash_t _dev_pixelpipe_cache_basichash(dt_dev_pixelpipe_t *pipe,
@@ -186,34 +282,55 @@ gboolean dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_t *pipe,
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
   cache->tests++;
   // search for hash in cache and make the sizes are identical
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k >= 0 && cache->size[k] == size)
   {
-    if((cache->size[k] == size) && (cache->hash[k] == hash))
-    {
-      cache->hits++;
-      return TRUE;
-    }
+    cache->hits++;
+    return TRUE;
   }
   return FALSE;
 }
 
+// What we lose by dropping line k, per MB and falling with age. Lines of
+// unknown cost, like the pipe input, count as cheap but not free.
+static inline double _keep_value(const dt_dev_pixelpipe_cache_t *cache,
+                                 const int k)
+{
+  const double cost = fmax(cache->cost[k], 1e-3);
+  const double mb = 1.0 + (double)cache->size[k] / (1024.0 * 1024.0);
+  return cost / (mb * cache->used[k]);
+}
+
 // While looking for the oldest cacheline we always ignore the first two lines as they are used
-// for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode
+// for swapping buffers while in entries==DT_PIPECACHE_MIN or masking mode.
+// Free and invalid lines hold nothing of value so the oldest is taken, for the
+// others the line with the least recompute cost per size and age is chosen.
 static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
                                  const dt_dev_pixelpipe_cache_test_t mode)
 {
+  const gboolean weighted = mode == DT_CACHETEST_PLAIN || mode == DT_CACHETEST_USED;
   // we never want the latest used cacheline! It was <= 0 and the weight has increased just now
   int age = 1;
+  double value = DBL_MAX;
   int id = 0;
   for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
   {
-    gboolean older = (cache->used[k] > age) && (k != cache->lastline);
+    gboolean older = (cache->used[k] > (weighted ? 1 : age)) && (k != cache->lastline);
     if(older)
     {
       if(mode == DT_CACHETEST_USED)         older = cache->data[k] != NULL;
       else if(mode == DT_CACHETEST_FREE)    older = cache->data[k] == NULL;
       else if(mode == DT_CACHETEST_INVALID) older = cache->hash[k] == DT_INVALID_HASH;
-      if(older)
+      if(older && weighted)
+      {
+        const double keep = _keep_value(cache, k);
+        if(keep < value)
+        {
+          value = keep;
+          id = k;
+        }
+      }
+      else if(older)
       {
         age = cache->used[k];
         id = k;
@@ -223,6 +340,14 @@ static int _get_oldest_cacheline(dt_dev_pixelpipe_cache_t *cache,
   return id;
 }
 
+static void _account_eviction(dt_dev_pixelpipe_cache_t *cache,
+                              const int k)
+{
+  if(k < DT_PIPECACHE_MIN || cache->hash[k] == DT_INVALID_HASH) return;
+  cache->evicted++;
+  cache->cost_evicted += cache->cost[k];
+}
+
 static int _get_c_cacheline(dt_dev_pixelpipe_cache_t *cache)
 {
   int oldest = _get_oldest_cacheline(cache, DT_CACHETEST_INVALID);
@@ -245,6 +370,7 @@ static int _get_cacheline(dt_dev_pixelpipe_t *pipe)
     return cache->calls & 1;
 
   cache->lastline = _get_c_cacheline(cache);
+  _account_eviction(cache, cache->lastline);
   return cache->lastline;
 }
 
@@ -257,38 +383,35 @@ static gboolean _get_by_hash(dt_dev_pixelpipe_t *pipe,
                              dt_iop_buffer_dsc_t **dsc)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
-  for(int k = DT_PIPECACHE_MIN; k < cache->entries; k++)
+  const int k = _index_find(cache, hash);
+  if(k < 0) return FALSE;
+
+  if(cache->size[k] != size)
   {
-    if(cache->hash[k] == hash)
-    {
-      if(cache->size[k] != size)
-      {
-        /* We check for situation with a hash identity but buffer sizes don't match.
-           This could happen because of "hash overlaps" or other situations where the hash
-           doesn't reflect the complete status.
-           Anyway this has to be accepted as a dt bug so we always report
-        */
-        cache->hash[k] = DT_INVALID_HASH;
-        dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
-          pipe, module, DT_DEVICE_NONE, NULL, NULL);
-      }
-      else if(pipe->mask_display || pipe->nocache)
-      {
-        // this should not happen but we make sure
-        cache->hash[k] = DT_INVALID_HASH;
-      }
-      else
-      {
-        // we have a proper hit
-        *data = cache->data[k];
-        *dsc = &cache->dsc[k];
-        // in case of a hit it's always good to further keep the cacheline as important
-        cache->used[k] = -cache->entries;
-        return TRUE;
-      }
-    }
+    /* We check for situation with a hash identity but buffer sizes don't match.
+       This could happen because of "hash overlaps" or other situations where the hash
+       doesn't reflect the complete status.
+       Anyway this has to be accepted as a dt bug so we always report
+    */
+    _set_hash(cache, k, DT_INVALID_HASH);
+    dt_print_pipe(DT_DEBUG_ALWAYS, "CACHELINE_SIZE ERROR",
+      pipe, module, DT_DEVICE_NONE, NULL, NULL);
+    return FALSE;
   }
-  return FALSE;
+  if(pipe->mask_display || pipe->nocache)
+  {
+    // this should not happen but we make sure
+    _set_hash(cache, k, DT_INVALID_HASH);
+    return FALSE;
+  }
+
+  // we have a proper hit
+  *data = cache->data[k];
+  *dsc = &cache->dsc[k];
+  // in case of a hit it's always good to further keep the cacheline as important
+  cache->used[k] = -cache->entries;
+  cache->cost_saved += cache->cost[k];
+  return TRUE;
 }
 
 gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
@@ -300,6 +423,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
                                     const gboolean important)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
+  _charge_pending(pipe);
   cache->calls++;
   for(int k = 0; k < cache->entries; k++)
     cache->used[k]++; // age all entries
@@ -324,6 +448,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   //
   // Otherwise, get an old/free cacheline and allocate required size.
   // Check both for free and non-matching (and grow or shrink buffer).
+  cache->misses++;
   const int cline = _get_cacheline(pipe);
 
   if(((cache->entries == DT_PIPECACHE_MIN) && (cache->size[cline] < size))
@@ -350,7 +475,14 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
   *dsc = &cache->dsc[cline];
 
   const gboolean masking = pipe->mask_display != DT_DEV_PIXELPIPE_DISPLAY_NONE;
-  cache->hash[cline]      = masking ? DT_INVALID_HASH : hash;
+  _set_hash(cache, cline, masking ? DT_INVALID_HASH : hash);
+  cache->cost[cline] = 0.0f;
+  if(cache->entries > DT_PIPECACHE_MIN && !masking)
+  {
+    cache->pending = cline;
+    cache->pending_run = pipe->runs;
+    cache->pending_start = dt_get_wtime();
+  }
 
   const dt_iop_buffer_dsc_t *cdsc = *dsc;
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_VERBOSE, "pipe cache get",
@@ -369,7 +501,7 @@ gboolean dt_dev_pixelpipe_cache_get(dt_dev_pixelpipe_t *pipe,
 
 static void _mark_invalid_cacheline(const dt_dev_pixelpipe_cache_t *cache, const int k)
 {
-  cache->hash[k] = DT_INVALID_HASH;
+  _set_hash(cache, k, DT_INVALID_HASH);
   cache->ioporder[k] = 0;
 }
 
@@ -435,6 +567,7 @@ static size_t _free_cacheline(dt_dev_pixelpipe_cache_t *cache, const int k)
   cache->allmem -= removed;
   cache->size[k] = 0;
   cache->data[k] = NULL;
+  cache->cost[k] = 0.0f;
   _mark_invalid_cacheline(cache, k);
   return removed;
 }
@@ -472,6 +605,7 @@ void dt_dev_pixelpipe_cache_checkmem(dt_dev_pixelpipe_t *pipe)
     const int k = _get_oldest_cacheline(cache, DT_CACHETEST_USED);
     if(k == 0) break;
 
+    _account_eviction(cache, k);
     freed += _free_cacheline(cache, k);
   }
 
@@ -486,6 +620,7 @@ void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_t *cache = &pipe->cache;
 
+  _charge_pending(pipe);
   _cline_stats(cache);
   dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "cache report", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
     "%i lines (important=%i, used=%i, invalid=%i). Using %iMB, limit=%iMB. Hits/run=%.2f. Hits/test=%.3f",
@@ -493,6 +628,10 @@ void dt_dev_pixelpipe_cache_report(dt_dev_pixelpipe_t *pipe)
     _to_mb(cache->allmem), _to_mb(cache->memlimit),
     (double)(cache->hits) / fmax(1.0, pipe->runs),
     (double)(cache->hits) / fmax(1.0, cache->tests));
+  if(cache->entries > DT_PIPECACHE_MIN)
+    dt_print_pipe(DT_DEBUG_PIPE | DT_DEBUG_MEMORY, "cache report", pipe, NULL, DT_DEVICE_NONE, NULL, NULL,
+      "hits=%" PRIu64 " misses=%" PRIu64 " evicted=%" PRIu64 ". Recompute time saved %.3fs, evicted %.3fs",
+      cache->hits, cache->misses, cache->evicted, cache->cost_saved, cache->cost_evicted);
 }
 
 // clang-format off
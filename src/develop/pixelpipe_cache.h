@@ -29,6 +29,12 @@ struct dt_iop_roi_t;
  * corresponding to history items and zoom/pan settings in the develop module.
  * correctness is secured via the hash so make sure everything is included here.
  * No caching if cl_mem, instead copied cache buffers are used.
+ *
+ * Lines are found via an open addressing index on the hash. Each line also
+ * records what it took to produce it, the time from its own allocation to the
+ * next cache request of the pipe, which is the processing time of its module.
+ * Eviction weighs that cost against the line's size and age, so an expensive
+ * demosaic or denoise output survives longer than a cheap colorout one.
  */
 typedef struct dt_dev_pixelpipe_cache_t
 {
@@ -41,11 +47,22 @@ typedef struct dt_dev_pixelpipe_cache_t
   dt_hash_t *hash;
   int32_t *used;
   int32_t *ioporder;
+  float *cost;          // seconds to recompute the line
+  int32_t *index;       // hash -> line, -1 for an empty slot
+  uint32_t index_mask;
   uint64_t calls;
   int32_t lastline;
+  // line being produced right now and when it was handed out
+  int32_t pending;
+  uint64_t pending_run;
+  double pending_start;
   // profiling & stats:
   uint64_t tests;
   uint64_t hits;
+  uint64_t misses;
+  uint64_t evicted;
+  double cost_saved;    // recompute time of all hits
+  double cost_evicted;  // recompute time thrown away by eviction
   uint32_t lused;
   uint32_t linvalid;
   uint32_t limportant;
@@ -92,7 +109,7 @@ void dt_dev_pixelpipe_important_cacheline(const struct dt_dev_pixelpipe_t *pipe,
 /** mark the given cache line as invalid or to be ignored */
 void dt_dev_pixelpipe_invalidate_cacheline(const struct dt_dev_pixelpipe_t *pipe, const void *data);
 
-/** print out cache lines/hashes and do a cache cleanup */
+/** print out cache lines/hashes, hit/miss counts and the recompute cost saved or evicted */
 void dt_dev_pixelpipe_cache_report(struct dt_dev_pixelpipe_t *pipe);
 void dt_dev_pixelpipe_cache_checkmem(struct dt_dev_pixelpipe_t *pipe);
 
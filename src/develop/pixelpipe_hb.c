@@ -22,6 +22,7 @@
 #include "common/opencl.h"
 #include "common/iop_order.h"
 #include "common/imagebuf.h"
+#include "common/wavelet.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
@@ -282,7 +283,7 @@ gboolean dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe,
 
 size_t dt_get_available_pipe_mem(const dt_dev_pixelpipe_t *pipe)
 {
-  const size_t allmem = dt_get_available_mem();
+  const size_t allmem = dt_get_available_mem() / MAX(1, darktable.dtresources.export_jobs);
   return MAX(DT_MEGA, allmem / (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL ? 3 : 1));
 }
 
@@ -360,6 +361,10 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   }
   dt_pthread_mutex_destroy(&pipe->busy_mutex);
   dt_pthread_mutex_destroy(&pipe->mutex);
+
+  // the idle scratch of the multiscale modules is not counted against the
+  // pipes' memory, don't keep it once a pipe is gone
+  dt_wavelet_pool_cleanup();
 }
 
 void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
@@ -23,7 +23,9 @@
 #include "develop/pixelpipe.h"
 
 #include <assert.h>
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
@@ -40,6 +42,9 @@
    Needs to be increased if tiling fails due to insufficient buffer sizes. */
 #define RESERVE 5
 
+/* number of fitted output rois remembered across pipe runs, see _fit_output_to_input_roi() */
+#define ROI_FIT_CACHE_SIZE 512
+
 /* greatest common divisor */
 static unsigned _gcd(unsigned a, unsigned b)
 {
@@ -522,21 +527,143 @@ static int _nm_fit_output_to_input_roi(dt_iop_module_t *self,
 
 
 
-/* find a matching oroi_full by probing start value of oroi and get corresponding input roi into iroi_probe.
-   We search in two steps. first by a simplicistic iterative search which will succeed in most cases.
-   If this does not converge, we do a downhill simplex (nelder-mead) fitting */
-static int _fit_output_to_input_roi(dt_iop_module_t *self,
-                                    dt_dev_pixelpipe_iop_t *piece,
-                                    const dt_iop_roi_t *iroi,
-                                    dt_iop_roi_t *oroi,
-                                    int delta,
-                                    int iter)
+/* fitted rois only depend on the module stack up to this module, the image,
+   the tile geometry and the start value. they are the same for every render of
+   an unchanged edit, so we keep them and skip the search next time. */
+typedef struct _roi_fit_key_t
 {
-  dt_iop_roi_t iroi_probe = *iroi;
-  dt_iop_roi_t save_oroi = *oroi;
+  dt_hash_t hash;
+  int iwidth, iheight;
+  int delta;
+  dt_iop_roi_t iroi;
+  dt_iop_roi_t oroi;
+} _roi_fit_key_t;
+
+typedef struct _roi_fit_entry_t
+{
+  _roi_fit_key_t key;
+  dt_iop_roi_t oroi;
+  gboolean valid;
+} _roi_fit_entry_t;
 
-  // try to go the easy way. this works in many cases where output is
-  // just like input, only scaled down
+static _roi_fit_entry_t _roi_fit_cache[ROI_FIT_CACHE_SIZE];
+static dt_pthread_mutex_t _roi_fit_mutex;
+
+void dt_tiling_init(void)
+{
+  dt_pthread_mutex_init(&_roi_fit_mutex, NULL);
+}
+
+static void _roi_fit_key(dt_iop_module_t *self,
+                         dt_dev_pixelpipe_iop_t *piece,
+                         const dt_iop_roi_t *iroi,
+                         const dt_iop_roi_t *oroi,
+                         const int delta,
+                         _roi_fit_key_t *key)
+{
+  memset(key, 0, sizeof(_roi_fit_key_t));
+  // includes the image and the params of this and all earlier modules. the
+  // exif data some distortions depend on (lens) is not in the params, add it.
+  dt_hash_t hash = dt_dev_pixelpipe_piece_hash(piece, NULL, TRUE);
+  hash = dt_hash(hash, &self->iop_order, sizeof(self->iop_order));
+  hash = dt_hash(hash, &piece->pipe->image.exif_focal_length, sizeof(float));
+  hash = dt_hash(hash, &piece->pipe->image.exif_focus_distance, sizeof(float));
+  hash = dt_hash(hash, &piece->pipe->image.exif_crop, sizeof(float));
+  hash = dt_hash(hash, &piece->buf_in, sizeof(dt_iop_roi_t));
+  key->hash = hash;
+  key->iwidth = piece->iwidth;
+  key->iheight = piece->iheight;
+  key->delta = delta;
+  key->iroi = *iroi;
+  key->oroi = *oroi;
+}
+
+static inline _roi_fit_entry_t *_roi_fit_slot(const _roi_fit_key_t *key)
+{
+  const dt_hash_t h = dt_hash(key->hash, key, sizeof(_roi_fit_key_t));
+  return &_roi_fit_cache[h % ROI_FIT_CACHE_SIZE];
+}
+
+static gboolean _roi_fit_lookup(const _roi_fit_key_t *key,
+                                dt_iop_roi_t *oroi)
+{
+  dt_pthread_mutex_lock(&_roi_fit_mutex);
+  const _roi_fit_entry_t *e = _roi_fit_slot(key);
+  const gboolean hit = e->valid && !memcmp(&e->key, key, sizeof(_roi_fit_key_t));
+  if(hit) *oroi = e->oroi;
+  dt_pthread_mutex_unlock(&_roi_fit_mutex);
+  return hit;
+}
+
+static void _roi_fit_store(const _roi_fit_key_t *key,
+                           const dt_iop_roi_t *oroi)
+{
+  dt_pthread_mutex_lock(&_roi_fit_mutex);
+  _roi_fit_entry_t *e = _roi_fit_slot(key);
+  e->key = *key;
+  e->oroi = *oroi;
+  e->valid = TRUE;
+  dt_pthread_mutex_unlock(&_roi_fit_mutex);
+}
+
+/* a start value for modules that can map points forward: the bounding box of
+   the transformed input roi border. modify_roi_in() mostly does the inverse
+   via distort_backtransform(), so this is very close to the fitted roi. */
+static gboolean _transform_output_roi(dt_iop_module_t *self,
+                                      dt_dev_pixelpipe_iop_t *piece,
+                                      const dt_iop_roi_t *iroi,
+                                      dt_iop_roi_t *oroi)
+{
+  if(!self->distort_transform || !self->distort_backtransform) return FALSE;
+
+  // points are in buf_in coordinates at scale 1
+  const int samples = 16;
+  float points[2 * 4 * 16];
+  const float x0 = iroi->x / iroi->scale;
+  const float y0 = iroi->y / iroi->scale;
+  const float x1 = (iroi->x + iroi->width) / iroi->scale;
+  const float y1 = (iroi->y + iroi->height) / iroi->scale;
+  for(int i = 0; i < samples; i++)
+  {
+    const float t = (float)i / (samples - 1);
+    const float x = x0 + t * (x1 - x0);
+    const float y = y0 + t * (y1 - y0);
+    float *p = points + 8 * i;
+    p[0] = x;  p[1] = y0;
+    p[2] = x;  p[3] = y1;
+    p[4] = x0; p[5] = y;
+    p[6] = x1; p[7] = y;
+  }
+  if(!self->distort_transform(self, piece, points, 4 * samples)) return FALSE;
+
+  float xmin = FLT_MAX, ymin = FLT_MAX, xmax = -FLT_MAX, ymax = -FLT_MAX;
+  for(int i = 0; i < 4 * samples; i++)
+  {
+    xmin = fminf(xmin, points[2 * i]);
+    xmax = fmaxf(xmax, points[2 * i]);
+    ymin = fminf(ymin, points[2 * i + 1]);
+    ymax = fmaxf(ymax, points[2 * i + 1]);
+  }
+  if(!isfinite(xmin) || !isfinite(ymin) || !isfinite(xmax) || !isfinite(ymax)
+     || xmax <= xmin || ymax <= ymin)
+    return FALSE;
+
+  oroi->x = floorf(xmin * oroi->scale);
+  oroi->y = floorf(ymin * oroi->scale);
+  oroi->width = ceilf(xmax * oroi->scale) - oroi->x;
+  oroi->height = ceilf(ymax * oroi->scale) - oroi->y;
+  return TRUE;
+}
+
+/* simple iterative search: move oroi by the error of its corresponding input roi */
+static gboolean _iterate_output_to_input_roi(dt_iop_module_t *self,
+                                             dt_dev_pixelpipe_iop_t *piece,
+                                             const dt_iop_roi_t *iroi,
+                                             dt_iop_roi_t *oroi,
+                                             const int delta,
+                                             int iter)
+{
+  dt_iop_roi_t iroi_probe = *iroi;
   self->modify_roi_in(self, piece, oroi, &iroi_probe);
   while((abs((int)iroi_probe.x - (int)iroi->x) > delta || abs((int)iroi_probe.y - (int)iroi->y) > delta
          || abs((int)iroi_probe.width - (int)iroi->width) > delta
@@ -556,15 +683,55 @@ static int _fit_output_to_input_roi(dt_iop_module_t *self,
     iter--;
   }
 
-  if(iter > 0) return TRUE;
+  return iter > 0;
+}
 
-  *oroi = save_oroi;
+/* find a matching oroi_full by probing start value of oroi and get corresponding input roi into iroi_probe.
+   Results are remembered, a repeated render of the same edit takes them from the cache.
+   Otherwise we search in up to three steps. first by a simplicistic iterative search which will
+   succeed in most cases. If this does not converge, we start it again from the forward transformed
+   input roi if the module can transform points. Only then we do a downhill simplex (nelder-mead)
+   fitting */
+static int _fit_output_to_input_roi(dt_iop_module_t *self,
+                                    dt_dev_pixelpipe_iop_t *piece,
+                                    const dt_iop_roi_t *iroi,
+                                    dt_iop_roi_t *oroi,
+                                    int delta,
+                                    int iter)
+{
+  _roi_fit_key_t key;
+  _roi_fit_key(self, piece, iroi, oroi, delta, &key);
+  if(_roi_fit_lookup(&key, oroi))
+  {
+    _print_roi(oroi, "tile oroi from fit cache");
+    return TRUE;
+  }
+
+  dt_iop_roi_t save_oroi = *oroi;
+
+  // try to go the easy way. this works in many cases where output is
+  // just like input, only scaled down
+  gboolean fit = _iterate_output_to_input_roi(self, piece, iroi, oroi, delta, iter);
+
+  if(!fit)
+  {
+    *oroi = save_oroi;
+    fit = _transform_output_roi(self, piece, iroi, oroi)
+      && _iterate_output_to_input_roi(self, piece, iroi, oroi, delta, iter);
+  }
+
+  if(!fit)
+  {
+    *oroi = save_oroi;
+
+    // simplicistic approach did not converge.
+    // try simplex downhill fitting now.
+    // it's crucial that we have a good starting point in oroi, else this
+    // will not converge as well.
+    fit = _nm_fit_output_to_input_roi(self, piece, iroi, oroi, delta);
+  }
 
-  // simplicistic approach did not converge.
-  // try simplex downhill fitting now.
-  // it's crucial that we have a good starting point in oroi, else this
-  // will not converge as well.
-  int fit = _nm_fit_output_to_input_roi(self, piece, iroi, oroi, delta);
+  if(fit) _roi_fit_store(&key, oroi);
   return fit;
 }
 
@@ -735,6 +902,9 @@ static void _default_process_tiling_ptp(dt_iop_module_t *self,
     const size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
+      // between tiles a background pipe gives the cpu to queued thumbnails of the visible area,
+      // not while it holds an opencl device
+      if(piece->pipe->devid < 0) dt_control_job_yield(FALSE);
       piece->pipe->tiling = TRUE;
 
       const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
@@ -998,6 +1168,7 @@ static void _default_process_tiling_roi(dt_iop_module_t *self,
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
+      if(piece->pipe->devid < 0) dt_control_job_yield(FALSE);
       piece->pipe->tiling = TRUE;
 
       /* the output dimensions of the good part of this specific tile */
@@ -2649,6 +2649,8 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
 
     // we add the thumbs
     int nbnew = 0;
+    const int page_size = MAX(table->rows * table->thumbs_per_row - empty_start, 0);
+    dt_imgid_t *newids = g_new(dt_imgid_t, MAX(page_size, 1));
     gchar *query
         = g_strdup_printf
       ("SELECT mi.rowid, mi.imgid, si.imgid"
@@ -2710,6 +2712,7 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
         gtk_widget_set_margin_start(thumb->w_image_box, old_margin_start);
         gtk_widget_set_margin_top(thumb->w_image_box, old_margin_top);
         gtk_layout_put(GTK_LAYOUT(table->widget), thumb->w_main, posx, posy);
+        if(nbnew < page_size) newids[nbnew] = nid;
         nbnew++;
       }
       _pos_get_next(table, &posx, &posy);
@@ -2723,6 +2726,14 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table,
     // list was built in reverse order, so un-reverse it
     table->list = g_list_reverse(table->list);
 
+    // the new thumbnails are drawn in the next main loop iterations, read
+    // their disk cache entries in one go meanwhile. size the mip the
+    // same way dt_view_image_get_surface() does when drawing them
+    const int32_t mipsize = table->thumb_size * darktable.gui->ppd;
+    const dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(mipsize, mipsize);
+    dt_mipmap_cache_prefetch_page(newids, MIN(nbnew, page_size), mip);
+    g_free(newids);
+
     _pos_compute_area(table);
 
     if(darktable.view_manager->active_images
@@ -28,6 +28,7 @@
 #include <string.h>  // for strcmp
 #include <unistd.h>  // for access, R_OK
 
+#include "common/atomic.h"      // for dt_atomic_add_int
 #include "common/darktable.h"    // for darktable, darktable_t, dt_cleanup, etc
 #include "common/database.h"     // for dt_database_get
 #include "common/debug.h"        // for DT_DEBUG_SQLITE3_PREPARE_V2
@@ -44,7 +45,78 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid)
+typedef struct _image_t
+{
+  dt_imgid_t imgid;
+  gchar *filename;
+  gboolean synced; // thumbnails on disk, if any, are from the current history
+} _image_t;
+
+typedef struct _worker_t
+{
+  const _image_t *images;
+  size_t image_count;
+  dt_mipmap_size_t min_mip, max_mip;
+  int omp_threads;
+  dt_atomic_int next;
+  dt_atomic_int done;
+  dt_atomic_int skipped;
+} _worker_t;
+
+static void _generate_image(const _image_t *image,
+                            const dt_mipmap_size_t min_mip,
+                            const dt_mipmap_size_t max_mip)
+{
+  // stale thumbnails from an older history are dropped, the whole chain is made again
+  if(!image->synced)
+    dt_mipmap_cache_remove(image->imgid);
+
+  // the biggest size is processed (or read from disk if it is there), every smaller one is
+  // downscaled from the next bigger one still in the memory cache
+  for(int k = max_mip; k >= min_mip && k >= 0; k--)
+  {
+    dt_mipmap_buffer_t buf;
+    dt_mipmap_cache_get(&buf, image->imgid, k, DT_MIPMAP_BLOCKING, 'r');
+    dt_mipmap_cache_release(&buf);
+  }
+
+  // and immediately write thumbs to disc and remove from mipmap cache.
+  dt_mipmap_cache_evict(image->imgid);
+  // thumbnail in sync with image
+  dt_history_hash_set_mipmap(image->imgid);
+}
+
+static void *_generate_worker(void *data)
+{
+  _worker_t *w = (_worker_t *)data;
+#ifdef _OPENMP
+  // the threads are split between the workers, this only applies to the calling thread
+  omp_set_num_threads(w->omp_threads);
+#endif
+
+  size_t i;
+  while((i = dt_atomic_add_int(&w->next, 1)) < w->image_count)
+  {
+    const _image_t *image = &w->images[i];
+
+    gboolean current = image->synced;
+    for(int k = w->max_mip; current && k >= w->min_mip && k >= 0; k--)
+      current = dt_mipmap_cache_ondisk_exists(image->imgid, k);
+
+    if(current)
+      dt_atomic_add_int(&w->skipped, 1);
+    else
+      _generate_image(image, w->min_mip, w->max_mip);
+
+    const int counter = dt_atomic_add_int(&w->done, 1) + 1;
+    fprintf(stderr, "image %d/%zu (%.02f%%) (id:%d, file=%s)%s\n", counter, w->image_count,
+            100.0 * counter / (float)w->image_count, image->imgid, image->filename,
+            current ? _(" up to date") : "");
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const dt_imgid_t min_imgid, const int32_t max_imgid, int jobs)
 {
   fprintf(stderr, _("creating cache directories\n"));
   for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
@@ -60,24 +132,30 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // some progress counter
+  // go through all images, an image without history has its thumbnails from the raw file
   sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
+  // clang-format off
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT mi.id, mi.filename,"
+                              "       h.current_hash IS NULL OR IFNULL(h.mipmap_hash == h.current_hash, 0)"
+                              " FROM main.images AS mi"
+                              " LEFT JOIN main.history_hash AS h ON h.imgid = mi.id"
+                              " WHERE mi.id >= ?1 AND mi.id <= ?2"
+                              " ORDER BY mi.id", -1, &stmt, 0);
+  // clang-format on
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    image_count = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
-  }
-  else
+  GArray *images = g_array_new(FALSE, FALSE, sizeof(_image_t));
+  while(sqlite3_step(stmt) == SQLITE_ROW)
   {
-    return 1;
+    const _image_t image = { .imgid = sqlite3_column_int(stmt, 0),
+                             .filename = g_strdup((const char *)sqlite3_column_text(stmt, 1)),
+                             .synced = sqlite3_column_int(stmt, 2) };
+    g_array_append_val(images, image);
   }
+  sqlite3_finalize(stmt);
 
-  if(!image_count)
+  if(!images->len)
   {
     fprintf(stderr, _("warning: no images are matching the requested image id range\n"));
     if(min_imgid > max_imgid)
@@ -86,41 +164,42 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // go through all images:
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, filename FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const dt_imgid_t imgid = sqlite3_column_int(stmt, 0);
-    const char *imgfilename = (const char*)sqlite3_column_text(stmt, 1);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d, file=%s)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid, imgfilename);
-
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
-    {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-      // if a valid thumbnail file is already on disc - do nothing
-      if(dt_util_test_image_file(filename)) continue;
-
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(&buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(&buf);
-    }
-
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mipmap_cache_evict(imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
-  }
-
-  sqlite3_finalize(stmt);
-  fprintf(stderr, "done\n");
+  // a few images at a time, each pipeline with its share of the threads and of the host
+  // memory. the serial parts of processing an image (loading the raw, writing the thumbnails)
+  // then overlap. tiling needs at least 512MB per pipeline.
+  const int threads = dt_get_num_threads();
+  if(jobs <= 0) jobs = MAX(1, threads / 4);
+  jobs = MIN(jobs, MAX(1, (int)images->len));
+  jobs = MIN(jobs, MAX(1, dt_get_available_mem() / (512lu * DT_MEGA)));
+  darktable.dtresources.export_jobs = jobs;
+
+  _worker_t w = { .images = (_image_t *)images->data,
+                  .image_count = images->len,
+                  .min_mip = min_mip,
+                  .max_mip = max_mip,
+                  .omp_threads = MAX(1, threads / jobs) };
+  dt_atomic_set_int(&w.next, 0);
+  dt_atomic_set_int(&w.done, 0);
+  dt_atomic_set_int(&w.skipped, 0);
+
+  fprintf(stderr, _("processing %zu images with %d jobs of %d threads\n"), w.image_count, jobs, w.omp_threads);
+
+  pthread_t *workers = g_malloc0(sizeof(pthread_t) * jobs);
+  int started = 0;
+  for(int j = 1; j < jobs; j++)
+    if(!dt_pthread_create(&workers[started], _generate_worker, &w))
+      started++;
+  // this thread is a worker too
+  _generate_worker(&w);
+  for(int j = 0; j < started; j++)
+    pthread_join(workers[j], NULL);
+  g_free(workers);
+
+  for(guint i = 0; i < images->len; i++)
+    g_free(g_array_index(images, _image_t, i).filename);
+  g_array_free(images, TRUE);
+
+  fprintf(stderr, _("done, %d images were up to date\n"), dt_atomic_get_int(&w.skipped));
 
   return 0;
 }
@@ -130,14 +209,17 @@ static void usage(const char *progname)
   fprintf(stderr,
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
-          "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [--min-imgid <N>] [--max-imgid <N>] [-j, --jobs <N>]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
           "while the rest are quickly downsampled.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "The --jobs option sets how many images are processed at once (default\n"
+          "= a quarter of the threads), images with current thumbnails are skipped.\n",
           progname);
 }
 
@@ -163,6 +245,7 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   dt_imgid_t min_imgid = NO_IMGID;
   int32_t max_imgid = INT32_MAX;
+  int jobs = 0;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -198,6 +281,11 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+    {
+      k++;
+      jobs = MAX(atoi(arg[k]), 1);
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -251,7 +339,7 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, jobs))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
@@ -190,6 +190,19 @@ void *legacy_params(dt_imageio_module_storage_t *self,
   return NULL;
 }
 
+// names of the files being written by the exports running right now,
+// protected by darktable.plugin_threadsafe
+static GHashTable *_claimed_names = NULL;
+static pthread_cond_t _claimed_cond = PTHREAD_COND_INITIALIZER;
+
+static void _release_name(const char *filename)
+{
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  g_hash_table_remove(_claimed_names, filename);
+  pthread_cond_broadcast(&_claimed_cond);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+}
+
 static void button_clicked(GtkWidget *widget,
                            dt_imageio_module_storage_t *self)
 {
@@ -340,14 +353,15 @@ int store(dt_imageio_module_storage_t *self,
   char pattern[DT_MAX_PATH_FOR_PARAMS];
   g_strlcpy(pattern, d->filename, sizeof(pattern));
   dt_image_full_path(imgid, input_dir, sizeof(input_dir), NULL);
-  // set variable values to expand them afterwards in darktable variables
-  dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
-  dt_variables_set_upscale(d->vp, upscale);
 
   gboolean fail = FALSE;
   // we're potentially called in parallel. have sequence number synchronized:
   dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
   {
+    // set variable values to expand them afterwards in darktable variables
+    dt_variables_set_max_width_height(d->vp, fdata->max_width, fdata->max_height);
+    dt_variables_set_upscale(d->vp, upscale);
+
 try_again:
     // avoid braindead export which is bound to overwrite at random:
     if(total > 1 && !g_strrstr(pattern, "$"))
@@ -418,6 +432,17 @@ try_again:
   failed:
     g_free(output_dir);
 
+    if(!_claimed_names)
+      _claimed_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    // the file is only written after the unlock below, a parallel export
+    // may be about to write the same name. wait for it as if the exports
+    // had run one after the other, the unique filename option picks
+    // another name instead.
+    if(!fail && d->onsave_action != DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
+      while(g_hash_table_contains(_claimed_names, filename))
+        dt_pthread_cond_wait(&_claimed_cond, &darktable.plugin_threadsafe);
+
     // conflict handling option: unique filename is generated if the
     // file already exists
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
@@ -425,7 +450,8 @@ try_again:
       int seq = 1;
 
       // increase filename suffix until a filename is generated that is unique
-      while(g_file_test(filename, G_FILE_TEST_EXISTS))
+      while(g_file_test(filename, G_FILE_TEST_EXISTS)
+            || g_hash_table_contains(_claimed_names, filename))
       {
         snprintf(c, filename_free_space, "_%.2d.%s", seq, ext);
         seq++;
@@ -496,16 +522,19 @@ try_again:
         }
       }
     }
+    if(!fail) g_hash_table_add(_claimed_names, g_strdup(filename));
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality,
-                       upscale, is_scaling, scale_factor,
-                       TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata,
-                       num, total, metadata) != 0)
+  const int res = dt_imageio_export(imgid, filename, format, fdata, high_quality,
+                                    upscale, is_scaling, scale_factor,
+                                    TRUE, export_masks, icc_type,
+                                    icc_filename, icc_intent, self, sdata,
+                                    num, total, metadata);
+  _release_name(filename);
+  if(res != 0)
   {
     dt_print(DT_DEBUG_ALWAYS,
              "[imageio_storage_disk] could not export to file: `%s'!",
@@ -3433,6 +3433,52 @@ static void do_fit(dt_iop_module_t *self,
   --darktable.gui->reset;
 }
 
+typedef struct _process_map_t
+{
+  const float *ihomograph; // 3x3
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  float cx, cy;
+} _process_map_t;
+
+// input coordinates of a span of an output row for dt_interpolation_warp4c()
+static void _process_map(float *xy,
+                         const int row,
+                         const int col,
+                         const int width,
+                         void *data)
+{
+  const _process_map_t *m = (const _process_map_t *)data;
+  const dt_iop_roi_t *const roi_in = m->roi_in;
+  const dt_iop_roi_t *const roi_out = m->roi_out;
+
+  for(int i = 0; i < width; i++)
+  {
+    float pin[3], pout[3];
+
+    // convert output pixel coordinates to original image coordinates
+    pout[0] = roi_out->x + col + i + m->cx;
+    pout[1] = roi_out->y + row + m->cy;
+    pout[0] /= roi_out->scale;
+    pout[1] /= roi_out->scale;
+    pout[2] = 1.0f;
+
+    // apply homograph
+    mat3mulv(pin, (float *)m->ihomograph, pout);
+
+    // convert to input pixel coordinates
+    pin[0] /= pin[2];
+    pin[1] /= pin[2];
+    pin[0] *= roi_in->scale;
+    pin[1] *= roi_in->scale;
+    pin[0] -= roi_in->x;
+    pin[1] -= roi_in->y;
+
+    xy[2 * i] = pin[0];
+    xy[2 * i + 1] = pin[1];
+  }
+}
+
 void process(dt_iop_module_t *self,
              dt_dev_pixelpipe_iop_t *piece,
              const void *const ivoid,
@@ -3444,7 +3490,6 @@ void process(dt_iop_module_t *self,
   dt_iop_ashift_gui_data_t *g = self->gui_data;
 
   const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
 
   // only for preview pipe: collect input buffer data and do some other evaluations
   if(g && self->dev->gui_attached && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW))
@@ -3532,39 +3577,13 @@ void process(dt_iop_module_t *self,
   const float cx = roi_out->scale * fullwidth * data->cl;
   const float cy = roi_out->scale * fullheight * data->ct;
 
-  DT_OMP_FOR(shared(ihomograph))
-  // go over all pixels of output image
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *const restrict out = ((float *)ovoid) + (size_t)ch * j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++)
-    {
-      float pin[3], pout[3];
-
-      // convert output pixel coordinates to original image coordinates
-      pout[0] = roi_out->x + i + cx;
-      pout[1] = roi_out->y + j + cy;
-      pout[0] /= roi_out->scale;
-      pout[1] /= roi_out->scale;
-      pout[2] = 1.0f;
-
-      // apply homograph
-      mat3mulv(pin, (float *)ihomograph, pout);
+  const _process_map_t map = { .ihomograph = &ihomograph[0][0],
+                               .roi_in = roi_in, .roi_out = roi_out,
+                               .cx = cx, .cy = cy };
 
-      // convert to input pixel coordinates
-      pin[0] /= pin[2];
-      pin[1] /= pin[2];
-      pin[0] *= roi_in->scale;
-      pin[1] *= roi_in->scale;
-      pin[0] -= roi_in->x;
-      pin[1] -= roi_in->y;
-
-      // get output values by interpolation from input image
-      dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out + ch*i,
-                                       pin[0], pin[1], roi_in->width,
-                                       roi_in->height, ch_width);
-    }
-  }
+  dt_interpolation_warp4c(interpolation, (float *)ovoid, roi_out->width, roi_out->height,
+                          (const float *)ivoid, roi_in->width, roi_in->height,
+                          _process_map, (void *)&map);
 }
 
 #ifdef HAVE_OPENCL
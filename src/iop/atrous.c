@@ -20,6 +20,7 @@
 #include "common/eaw.h"
 #include "common/imagebuf.h"
 #include "common/opencl.h"
+#include "common/wavelet.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "develop/imageop.h"
@@ -309,7 +310,7 @@ static void process_wavelets(dt_iop_module_t *self,
   float *restrict tmp = NULL;
   float *restrict tmp2 = NULL;
 
-  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &tmp, 4, &tmp2, 0))
+  if(!dt_wavelet_alloc_buffers(self, (size_t)4 * width * height, &tmp, &tmp2, NULL))
   {
     dt_iop_copy_image_roi(out, i, piece->colors, roi_in, roi_out);
     return;
@@ -323,7 +324,10 @@ static void process_wavelets(dt_iop_module_t *self,
 
   // now do the wavelet decomposition, immediately synthesizing the
   // detail scale into the final output so that we don't need to store
-  // it past the current scale's iteration
+  // it past the current scale's iteration. this is already the band
+  // fusion of dt_wavelet_hat_decompose(), but the edge-aware 5x5 kernel
+  // weighs each tap by its distance to the center pixel, so it can't be
+  // split into the separable hat passes without changing the result.
   for(int scale = 0; scale < max_scale; scale++)
   {
     eaw_decompose_and_synthesize(buf2, buf1, out, scale, sharp[scale], thrs[scale],
@@ -342,8 +346,8 @@ static void process_wavelets(dt_iop_module_t *self,
   for(size_t k = 0; k < (size_t)4 * width * height; k++)
     out[k] += buf1[k];
 
-  dt_free_align(tmp);
-  dt_free_align(tmp2);
+  dt_wavelet_free(tmp);
+  dt_wavelet_free(tmp2);
   return;
 }
 
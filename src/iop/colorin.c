@@ -94,6 +94,7 @@ typedef struct dt_iop_colorin_data_t
   cmsHTRANSFORM *xform_cam_Lab;
   cmsHTRANSFORM *xform_cam_nrgb;
   cmsHTRANSFORM *xform_nrgb_Lab;
+  cmsHTRANSFORM *xform_cam_XYZ; // clipped by nmatrix/lmatrix and converted to Lab in the same pass
   float lut[3][LUT_SAMPLES];
   dt_colormatrix_t cmatrix;
   dt_colormatrix_t nmatrix;
@@ -995,6 +996,26 @@ static void process_cmatrix(dt_iop_module_t *self,
   }
 }
 
+// the clipping of the lcms2 fallback when the clipping profile is a
+// matrix one: lcms2 only converts the camera data to XYZ, the clipping in
+// the gamut of nrgb and the conversion to Lab are done here in place.
+// takes the transposed matrices.
+static inline void _clip_XYZ_to_Lab(float *const out,
+                                    const size_t width,
+                                    const dt_colormatrix_t nmatrix,
+                                    const dt_colormatrix_t lmatrix)
+{
+  for(size_t j = 0; j < width; j++)
+  {
+    dt_aligned_pixel_t nRGB;
+    dt_apply_transposed_color_matrix(out + 4*j, nmatrix, nRGB);
+    dt_vector_clip(nRGB);
+    dt_aligned_pixel_t XYZ;
+    dt_apply_transposed_color_matrix(nRGB, lmatrix, XYZ);
+    dt_XYZ_to_Lab(XYZ, out + 4*j);
+  }
+}
+
 // legacy processing (IOP versions 1 and 2, 2014 and earlier)
 static void process_lcms2_bm(dt_iop_module_t *self,
                              dt_dev_pixelpipe_iop_t *piece,
@@ -1006,9 +1027,13 @@ static void process_lcms2_bm(dt_iop_module_t *self,
   const dt_iop_colorin_data_t *const d = piece->data;
   const size_t height = roi_out->height;
   const size_t width = roi_out->width;
+  dt_colormatrix_t nmatrix;
+  transpose_3xSSE(d->nmatrix, nmatrix);
+  dt_colormatrix_t lmatrix;
+  transpose_3xSSE(d->lmatrix, lmatrix);
 
 // use general lcms2 fallback
-  DT_OMP_FOR()
+  DT_OMP_FOR(shared(nmatrix, lmatrix))
   for(int k = 0; k < height; k++)
   {
     const float *in = (const float *)ivoid + (size_t)4 * k * width;
@@ -1024,6 +1049,11 @@ static void process_lcms2_bm(dt_iop_module_t *self,
     {
       cmsDoTransform(d->xform_cam_Lab, out, out, width);
     }
+    else if(d->xform_cam_XYZ)
+    {
+      cmsDoTransform(d->xform_cam_XYZ, out, out, width);
+      _clip_XYZ_to_Lab(out, width, nmatrix, lmatrix);
+    }
     else
     {
       cmsDoTransform(d->xform_cam_nrgb, out, out, width);
@@ -1050,8 +1080,12 @@ static void process_lcms2_proper(dt_iop_module_t *self,
   size_t padded_size;
   float *const restrict scratchlines = dt_alloc_perthread_float(4 * width, &padded_size);
   gboolean correcting = corr[0] != 1.0f || corr[1] != 1.0f || corr[2] != 1.0f;
+  dt_colormatrix_t nmatrix;
+  transpose_3xSSE(d->nmatrix, nmatrix);
+  dt_colormatrix_t lmatrix;
+  transpose_3xSSE(d->lmatrix, lmatrix);
 
-  DT_OMP_FOR()
+  DT_OMP_FOR(shared(nmatrix, lmatrix))
   for(size_t k = 0; k < height; k++)
   {
     float *in = (float *)ivoid + (size_t)4 * k * width;
@@ -1071,6 +1105,11 @@ static void process_lcms2_proper(dt_iop_module_t *self,
     {
       cmsDoTransform(d->xform_cam_Lab, in, out, width);
     }
+    else if(d->xform_cam_XYZ)
+    {
+      cmsDoTransform(d->xform_cam_XYZ, in, out, width);
+      _clip_XYZ_to_Lab(out, width, nmatrix, lmatrix);
+    }
     else
     {
       cmsDoTransform(d->xform_cam_nrgb, in, out, width);
@@ -1145,6 +1184,18 @@ void process(dt_iop_module_t *self,
   }
 }
 
+static void _release_transforms(dt_iop_colorin_data_t *d)
+{
+  dt_colorspaces_release_transform(d->xform_cam_Lab);
+  dt_colorspaces_release_transform(d->xform_cam_nrgb);
+  dt_colorspaces_release_transform(d->xform_nrgb_Lab);
+  dt_colorspaces_release_transform(d->xform_cam_XYZ);
+  d->xform_cam_Lab = NULL;
+  d->xform_cam_nrgb = NULL;
+  d->xform_nrgb_Lab = NULL;
+  d->xform_cam_XYZ = NULL;
+}
+
 void commit_params(dt_iop_module_t *self,
                    dt_iop_params_t *p1,
                    dt_dev_pixelpipe_t *pipe,
@@ -1194,21 +1245,7 @@ void commit_params(dt_iop_module_t *self,
       d->nrgb = NULL;
   }
 
-  if(d->xform_cam_Lab)
-  {
-    cmsDeleteTransform(d->xform_cam_Lab);
-    d->xform_cam_Lab = NULL;
-  }
-  if(d->xform_cam_nrgb)
-  {
-    cmsDeleteTransform(d->xform_cam_nrgb);
-    d->xform_cam_nrgb = NULL;
-  }
-  if(d->xform_nrgb_Lab)
-  {
-    cmsDeleteTransform(d->xform_nrgb_Lab);
-    d->xform_nrgb_Lab = NULL;
-  }
+  _release_transforms(d);
 
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   dt_mark_colormatrix_invalid(&d->nmatrix[0][0]);
@@ -1374,21 +1411,34 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, input_format, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
-      d->xform_cam_nrgb = cmsCreateTransform(d->input, input_format, d->nrgb,
-                                             TYPE_RGBA_FLT, p->intent, 0);
-      d->xform_nrgb_Lab = cmsCreateTransform(d->nrgb, TYPE_RGBA_FLT, Lab,
-                                             TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_get_transform(d->input, input_format, Lab, TYPE_LabA_FLT,
+                                                      NULL, p->intent, p->intent, 0);
+      // with a matrix clipping profile lcms2 only does the camera to XYZ
+      // part, the clipping and the conversion to Lab are done in one pass
+      if(!dt_colorspaces_get_matrix_from_output_profile(d->nrgb, d->nmatrix, NULL, NULL, NULL, 0)
+         && !dt_colorspaces_get_matrix_from_input_profile(d->nrgb, d->lmatrix, NULL, NULL, NULL, 0))
+      {
+        const cmsHPROFILE XYZ =
+          dt_colorspaces_get_profile(DT_COLORSPACE_XYZ, "", DT_PROFILE_DIRECTION_ANY)->profile;
+        d->xform_cam_XYZ = dt_colorspaces_get_transform(d->input, input_format, XYZ, TYPE_XYZA_FLT,
+                                                        NULL, p->intent, p->intent, 0);
+      }
+      if(!d->xform_cam_XYZ)
+      {
+        dt_mark_colormatrix_invalid(&d->nmatrix[0][0]);
+        dt_mark_colormatrix_invalid(&d->lmatrix[0][0]);
+        d->xform_cam_nrgb = dt_colorspaces_get_transform(d->input, input_format, d->nrgb, TYPE_RGBA_FLT,
+                                                         NULL, p->intent, p->intent, 0);
+        d->xform_nrgb_Lab = dt_colorspaces_get_transform(d->nrgb, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT,
+                                                         NULL, p->intent, p->intent, 0);
+      }
     }
     else
     {
-      float lutr[1], lutg[1], lutb[1];
       dt_colormatrix_t omat;
-      dt_colorspaces_get_matrix_from_output_profile(d->nrgb, omat, lutr, lutg, lutb, 1);
+      dt_colorspaces_get_matrix_from_output_profile(d->nrgb, omat, NULL, NULL, NULL, 0);
       dt_colormatrix_mul(d->nmatrix, omat, d->cmatrix);
-      dt_colorspaces_get_matrix_from_input_profile(d->nrgb, d->lmatrix,
-                                                   lutr, lutg, lutb, 1);
+      dt_colorspaces_get_matrix_from_input_profile(d->nrgb, d->lmatrix, NULL, NULL, NULL, 0);
     }
   }
   else
@@ -1400,8 +1450,8 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, input_format, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_get_transform(d->input, input_format, Lab, TYPE_LabA_FLT,
+                                                      NULL, p->intent, p->intent, 0);
     }
   }
 
@@ -1409,16 +1459,10 @@ void commit_params(dt_iop_module_t *self,
   if(d->nrgb && ((!d->xform_cam_nrgb && !dt_is_valid_colormatrix(d->nmatrix[0][0]))
                  || (!d->xform_nrgb_Lab && !dt_is_valid_colormatrix(d->lmatrix[0][0]))))
   {
-    if(d->xform_cam_nrgb)
-    {
-      cmsDeleteTransform(d->xform_cam_nrgb);
-      d->xform_cam_nrgb = NULL;
-    }
-    if(d->xform_nrgb_Lab)
-    {
-      cmsDeleteTransform(d->xform_nrgb_Lab);
-      d->xform_nrgb_Lab = NULL;
-    }
+    dt_colorspaces_release_transform(d->xform_cam_nrgb);
+    dt_colorspaces_release_transform(d->xform_nrgb_Lab);
+    d->xform_cam_nrgb = NULL;
+    d->xform_nrgb_Lab = NULL;
     d->nrgb = NULL;
   }
 
@@ -1443,8 +1487,8 @@ void commit_params(dt_iop_module_t *self,
     {
       piece->process_cl_ready = FALSE;
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
-      d->xform_cam_Lab = cmsCreateTransform(d->input, TYPE_RGBA_FLT, Lab,
-                                            TYPE_LabA_FLT, p->intent, 0);
+      d->xform_cam_Lab = dt_colorspaces_get_transform(d->input, TYPE_RGBA_FLT, Lab, TYPE_LabA_FLT,
+                                                      NULL, p->intent, p->intent, 0);
     }
   }
 
@@ -1490,6 +1534,7 @@ void init_pipe(dt_iop_module_t *self,
   d->xform_cam_Lab = NULL;
   d->xform_cam_nrgb = NULL;
   d->xform_nrgb_Lab = NULL;
+  d->xform_cam_XYZ = NULL;
 }
 
 void cleanup_pipe(dt_iop_module_t *self,
@@ -1498,21 +1543,7 @@ void cleanup_pipe(dt_iop_module_t *self,
 {
   dt_iop_colorin_data_t *d = piece->data;
   if(d->input && d->clear_input) dt_colorspaces_cleanup_profile(d->input);
-  if(d->xform_cam_Lab)
-  {
-    cmsDeleteTransform(d->xform_cam_Lab);
-    d->xform_cam_Lab = NULL;
-  }
-  if(d->xform_cam_nrgb)
-  {
-    cmsDeleteTransform(d->xform_cam_nrgb);
-    d->xform_cam_nrgb = NULL;
-  }
-  if(d->xform_nrgb_Lab)
-  {
-    cmsDeleteTransform(d->xform_nrgb_Lab);
-    d->xform_nrgb_Lab = NULL;
-  }
+  _release_transforms(d);
 
   free(piece->data);
   piece->data = NULL;
@@ -527,11 +527,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
 
   d->mode = (pipe->type & DT_DEV_PIXELPIPE_FULL) ? darktable.color_profiles->mode : DT_PROFILE_NORMAL;
 
-  if(d->xform)
-  {
-    cmsDeleteTransform(d->xform);
-    d->xform = NULL;
-  }
+  dt_colorspaces_release_transform(d->xform);
+  d->xform = NULL;
   dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
   d->lut[0][0] = -1.0f;
   d->lut[1][0] = -1.0f;
@@ -663,8 +660,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
   {
     dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
     piece->process_cl_ready = FALSE;
-    d->xform = cmsCreateProofingTransform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
-                                          out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
+    d->xform = dt_colorspaces_get_transform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
+                                            out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
   }
 
   // user selected a non-supported output profile, check that:
@@ -683,8 +680,8 @@ void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_
       dt_mark_colormatrix_invalid(&d->cmatrix[0][0]);
       piece->process_cl_ready = FALSE;
 
-      d->xform = cmsCreateProofingTransform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
-                                            out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
+      d->xform = dt_colorspaces_get_transform(Lab, TYPE_LabA_FLT, output, output_format, softproof,
+                                              out_intent, INTENT_RELATIVE_COLORIMETRIC, transformFlags);
     }
   }
 
@@ -727,11 +724,8 @@ void init_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe
 void cleanup_pipe(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorout_data_t *d = piece->data;
-  if(d->xform)
-  {
-    cmsDeleteTransform(d->xform);
-    d->xform = NULL;
-  }
+  dt_colorspaces_release_transform(d->xform);
+  d->xform = NULL;
 
   free(piece->data);
   piece->data = NULL;
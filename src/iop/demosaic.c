@@ -40,6 +40,7 @@
 #include "imageio/imageio_rawspeed.h" // for dt_rawspeed_crop_dcraw_filters
 #include "develop/tiling.h"
 #include "iop/iop_api.h"
+#include "iop/demosaicing/demosaic.h"
 
 #include <complex.h>
 #include <glib.h>
@@ -54,10 +55,6 @@ DT_MODULE_INTROSPECTION(6, dt_iop_demosaic_params_t)
 #define DT_DEMOSAIC_DUAL 2048   // masks for dual demosaicing methods
 #define DT_REDUCESIZE_MIN 64
 
-// these are highly depending on CPU architecture (cache size)
-#define DT_RCD_TILESIZE 112
-#define DT_LMMSE_TILESIZE 136
-
 typedef enum dt_iop_demosaic_method_t
 {
   // methods for Bayer images
@@ -137,15 +134,6 @@ typedef enum dt_iop_demosaic_smooth_t
   DT_DEMOSAIC_SMOOTH_5 = 5,   // $DESCRIPTION: "five times"
 } dt_iop_demosaic_smooth_t;
 
-typedef enum dt_iop_demosaic_lmmse_t
-{
-  DT_LMMSE_REFINE_0 = 0,   // $DESCRIPTION: "basic"
-  DT_LMMSE_REFINE_1 = 1,   // $DESCRIPTION: "median"
-  DT_LMMSE_REFINE_2 = 2,   // $DESCRIPTION: "3x median"
-  DT_LMMSE_REFINE_3 = 3,   // $DESCRIPTION: "refine & medians"
-  DT_LMMSE_REFINE_4 = 4,   // $DESCRIPTION: "2x refine + medians"
-} dt_iop_demosaic_lmmse_t;
-
 typedef struct dt_iop_demosaic_params_t
 {
   dt_iop_demosaic_greeneq_t green_eq;           // $DEFAULT: DT_IOP_GREEN_EQ_NO $DESCRIPTION: "match greens"
@@ -32,60 +32,8 @@ G_BEGIN_DECLS
 
 static inline float _clampnan(const float x, const float m, const float M)
 {
-  float r;
-
   // clamp to [m, M] if x is infinite; return average of m and M if x is NaN; else just return x
-
-  if(std::isinf(x))
-    r = (std::isless(x, m) ? m : (std::isgreater(x, M) ? M : x));
-  else if(std::isnan(x))
-    r = (m + M) / 2.0f;
-  else // normal number
-    r = x;
-
-  return r;
-}
-
-static inline float _xmul2f(float d)
-{
-  union {
-      float f;
-      uint32_t u;
-  } x;
-  x.f = d;
-  if(x.u & 0x7FFFFFFF) // if f==0 do nothing
-  {
-    x.u += 1 << 23; // add 1 to the exponent
-  }
-  return x.f;
-}
-
-static inline float _xdiv2f(float d)
-{
-  union {
-      float f;
-      uint32_t u;
-  } x;
-  x.f = d;
-  if(x.u & 0x7FFFFFFF) // if f==0 do nothing
-  {
-    x.u -= 1 << 23; // sub 1 from the exponent
-  }
-  return x.f;
-}
-
-static inline float _xdivf(float d, int n)
-{
-  union {
-      float f;
-      uint32_t u;
-  } x;
-  x.f = d;
-  if(x.u & 0x7FFFFFFF) // if f==0 do nothing
-  {
-    x.u -= n << 23; // add n to the exponent
-  }
-  return x.f;
+  return std::isnan(x) ? 0.5f * (m + M) : (std::isinf(x) ? (x < m ? m : (x > M ? M : x)) : x);
 }
 
 
@@ -96,6 +44,25 @@ static inline float _xdivf(float d, int n)
 #define LIM(x, min, max) MAX(min, MIN(x, max))
 #define ULIM(x, y, z) ((y) < (z) ? LIM(x, y, z) : LIM(x, z, y))
 
+// bound an interpolated colour difference in regions of high saturation. sgn is -1 at G sites where
+// the difference is taken the other way round, n1 and n2 are the opposite neighbours along the direction.
+static inline float _bound_cd(const float cd,
+                              const float sgn,
+                              const float cfa,
+                              const float n1,
+                              const float n2,
+                              const float clip_pt)
+{
+  constexpr float eps = 1e-5f;
+  const float Gint = sgn * cd + cfa;
+  const float bound = sgn * (ULIM(Gint, n1, n2) - cfa);
+  const float wt = 1.f + 3.f * sgn * cd / (eps + Gint + cfa);
+  float res = cd;
+  if(sgn * cd < 0.f)
+    res = 3.f * sgn * cd < -(Gint + cfa) ? bound : wt * cd + (1.f - wt) * bound;
+  return Gint > clip_pt ? bound : res;
+}
+
 
 ////////////////////////////////////////////////////////////////
 //
@@ -237,7 +204,7 @@ void amaze_demosaic(const float *const in,
     // weight to give horizontal vs vertical interpolation
     float *hvwt = (float(*))((char *)cddiffsq + sizeof(float) * ts * ts + 2 * cldf * 64); // 1
     // final interpolated colour difference
-    float(*Dgrb)[ts * tsh] = (float(*)[ts * tsh])vcdalt; // there is no overlap in buffer usage => share
+    float *Dgrb[2] = { vcdalt, vcdalt + ts * tsh }; // there is no overlap in buffer usage => share
     // gradient in plus (NE/SW) direction
     float *delp = (float(*))cddiffsq; // there is no overlap in buffer usage => share
     // gradient in minus (NW/SE) direction
@@ -409,13 +376,18 @@ void amaze_demosaic(const float *const in,
           }
 
 // interpolate vertical and horizontal colour differences
+// the colour site parity is folded into a sign (-1 at G sites) so that the row kernels carry no branches
+// and vectorize
 
         for(int rr = 4; rr < rr1 - 4; rr++)
         {
-          bool fcswitch = FC(rr, 4, filters) & 1;
+          const float sgn0 = (FC(rr, 4, filters) & 1) ? -1.f : 1.f;
 
-          for(int cc = 4, indx = rr * ts + cc; cc < cc1 - 4; cc++, indx++)
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
           {
+            const int indx = rr * ts + cc;
+            const float sgn = (cc & 1) ? -sgn0 : sgn0;
 
             // colour ratios in each cardinal direction
             const float cru = cfa[indx - v1] * (dirwts0[indx - v2] + dirwts0[indx])
@@ -428,49 +400,10 @@ void amaze_demosaic(const float *const in,
                         / (dirwts1[indx + 2] * (eps + cfa[indx]) + dirwts1[indx] * (eps + cfa[indx + 2]));
 
             // G interpolated in vert/hor directions using Hamilton-Adams method
-            const float guha = cfa[indx - v1] + _xdiv2f(cfa[indx] - cfa[indx - v2]);
-            const float gdha = cfa[indx + v1] + _xdiv2f(cfa[indx] - cfa[indx + v2]);
-            const float glha = cfa[indx - 1] + _xdiv2f(cfa[indx] - cfa[indx - 2]);
-            const float grha = cfa[indx + 1] + _xdiv2f(cfa[indx] - cfa[indx + 2]);
-
-            // G interpolated in vert/hor directions using adaptive ratios
-            float guar, gdar, glar, grar;
-
-            if(fabsf(1.f - cru) < arthresh)
-            {
-              guar = cfa[indx] * cru;
-            }
-            else
-            {
-              guar = guha;
-            }
-
-            if(fabsf(1.f - crd) < arthresh)
-            {
-              gdar = cfa[indx] * crd;
-            }
-            else
-            {
-              gdar = gdha;
-            }
-
-            if(fabsf(1.f - crl) < arthresh)
-            {
-              glar = cfa[indx] * crl;
-            }
-            else
-            {
-              glar = glha;
-            }
-
-            if(fabsf(1.f - crr) < arthresh)
-            {
-              grar = cfa[indx] * crr;
-            }
-            else
-            {
-              grar = grha;
-            }
+            const float guha = cfa[indx - v1] + 0.5f * (cfa[indx] - cfa[indx - v2]);
+            const float gdha = cfa[indx + v1] + 0.5f * (cfa[indx] - cfa[indx + v2]);
+            const float glha = cfa[indx - 1] + 0.5f * (cfa[indx] - cfa[indx - 2]);
+            const float grha = cfa[indx + 1] + 0.5f * (cfa[indx] - cfa[indx + 2]);
 
             // adaptive weights for vertical/horizontal directions
             const float hwt = dirwts1[indx - 1] / (dirwts1[indx - 1] + dirwts1[indx + 1]);
@@ -480,35 +413,19 @@ void amaze_demosaic(const float *const in,
             const float Gintvha = vwt * gdha + (1.f - vwt) * guha;
             const float Ginthha = hwt * grha + (1.f - hwt) * glha;
 
-            // interpolated colour differences
-            if(fcswitch)
-            {
-              vcd[indx] = cfa[indx] - (vwt * gdar + (1.f - vwt) * guar);
-              hcd[indx] = cfa[indx] - (hwt * grar + (1.f - hwt) * glar);
-              vcdalt[indx] = cfa[indx] - Gintvha;
-              hcdalt[indx] = cfa[indx] - Ginthha;
-            }
-            else
-            {
-              // interpolated colour differences
-              vcd[indx] = (vwt * gdar + (1.f - vwt) * guar) - cfa[indx];
-              hcd[indx] = (hwt * grar + (1.f - hwt) * glar) - cfa[indx];
-              vcdalt[indx] = Gintvha - cfa[indx];
-              hcdalt[indx] = Ginthha - cfa[indx];
-            }
-
-            fcswitch = !fcswitch;
+            // G interpolated in vert/hor directions using adaptive ratios,
+            // use HA if highlights are (nearly) clipped
+            const bool clipped = cfa[indx] > clip_pt8 || Gintvha > clip_pt8 || Ginthha > clip_pt8;
+            const float guar = !clipped && fabsf(1.f - cru) < arthresh ? cfa[indx] * cru : guha;
+            const float gdar = !clipped && fabsf(1.f - crd) < arthresh ? cfa[indx] * crd : gdha;
+            const float glar = !clipped && fabsf(1.f - crl) < arthresh ? cfa[indx] * crl : glha;
+            const float grar = !clipped && fabsf(1.f - crr) < arthresh ? cfa[indx] * crr : grha;
 
-            if(cfa[indx] > clip_pt8 || Gintvha > clip_pt8 || Ginthha > clip_pt8)
-            {
-              // use HA if highlights are (nearly) clipped
-              guar = guha;
-              gdar = gdha;
-              glar = glha;
-              grar = grha;
-              vcd[indx] = vcdalt[indx];
-              hcd[indx] = hcdalt[indx];
-            }
+            // interpolated colour differences
+            vcd[indx] = sgn * ((vwt * gdar + (1.f - vwt) * guar) - cfa[indx]);
+            hcd[indx] = sgn * ((hwt * grar + (1.f - hwt) * glar) - cfa[indx]);
+            vcdalt[indx] = sgn * (Gintvha - cfa[indx]);
+            hcdalt[indx] = sgn * (Ginthha - cfa[indx]);
 
             // differences of interpolations in opposite directions
             dgintv[indx] = MIN(sqrf(guha - gdha), sqrf(guar - gdar));
@@ -518,131 +435,82 @@ void amaze_demosaic(const float *const in,
 
         for(int rr = 4; rr < rr1 - 4; rr++)
         {
-          for(int cc = 4, indx = rr * ts + cc, c = FC(rr, cc, filters) & 1; cc < cc1 - 4; cc++, indx++)
+          // the choice between hcd and hcdalt depends on the already bounded hcd two pixels to the left.
+          // both candidates are bounded in the vectorized kernel, the cheap choice is made afterwards.
+          float DT_ALIGNED_ARRAY hcdbound[ts];
+          float DT_ALIGNED_ARRAY hcdaltbound[ts];
+          float DT_ALIGNED_ARRAY hcdaltvar[ts];
+          uint8_t DT_ALIGNED_ARRAY usealt[ts];
+          const float sgn0 = (FC(rr, 4, filters) & 1) ? -1.f : 1.f;
+
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
           {
-            const float hcdvar = 3.f * (sqrf(hcd[indx - 2]) + sqrf(hcd[indx]) + sqrf(hcd[indx + 2]))
-                           - sqrf(hcd[indx - 2] + hcd[indx] + hcd[indx + 2]);
-            const float hcdaltvar = 3.f * (sqrf(hcdalt[indx - 2]) + sqrf(hcdalt[indx]) + sqrf(hcdalt[indx + 2]))
-                              - sqrf(hcdalt[indx - 2] + hcdalt[indx] + hcdalt[indx + 2]);
+            const int indx = rr * ts + cc;
+            const float sgn = (cc & 1) ? -sgn0 : sgn0;
+
+            hcdaltvar[cc] = 3.f * (sqrf(hcdalt[indx - 2]) + sqrf(hcdalt[indx]) + sqrf(hcdalt[indx + 2]))
+                            - sqrf(hcdalt[indx - 2] + hcdalt[indx] + hcdalt[indx + 2]);
             const float vcdvar = 3.f * (sqrf(vcd[indx - v2]) + sqrf(vcd[indx]) + sqrf(vcd[indx + v2]))
                            - sqrf(vcd[indx - v2] + vcd[indx] + vcd[indx + v2]);
             const float vcdaltvar = 3.f * (sqrf(vcdalt[indx - v2]) + sqrf(vcdalt[indx]) + sqrf(vcdalt[indx + v2]))
                               - sqrf(vcdalt[indx - v2] + vcdalt[indx] + vcdalt[indx + v2]);
 
             // choose the smallest variance; this yields a smoother interpolation
-            if(hcdaltvar < hcdvar)
-            {
-              hcd[indx] = hcdalt[indx];
-            }
-
-            if(vcdaltvar < vcdvar)
-            {
-              vcd[indx] = vcdalt[indx];
-            }
+            const float vcdv = vcdaltvar < vcdvar ? vcdalt[indx] : vcd[indx];
 
             // bound the interpolation in regions of high saturation
-            // vertical and horizontal G interpolations
-            float Gintv, Ginth;
-
-            if(c)
-            {                                 // G site
-              Ginth = -hcd[indx] + cfa[indx]; // R or B
-              Gintv = -vcd[indx] + cfa[indx]; // B or R
-
-              if(hcd[indx] > 0)
-              {
-                if(3.f * hcd[indx] > (Ginth + cfa[indx]))
-                {
-                  hcd[indx] = -ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) + cfa[indx];
-                }
-                else
-                {
-                  const float hwt = 1.f - 3.f * hcd[indx] / (eps + Ginth + cfa[indx]);
-                  hcd[indx] = hwt * hcd[indx]
-                              + (1.f - hwt) * (-ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) + cfa[indx]);
-                }
-              }
-
-              if(vcd[indx] > 0)
-              {
-                if(3.f * vcd[indx] > (Gintv + cfa[indx]))
-                {
-                  vcd[indx] = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
-                }
-                else
-                {
-                  const float vwt = 1.f - 3.f * vcd[indx] / (eps + Gintv + cfa[indx]);
-                  vcd[indx] = vwt * vcd[indx]
-                              + (1.f - vwt) * (-ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx]);
-                }
-              }
-
-              if(Ginth > clip_pt)
-              {
-                hcd[indx] = -ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) + cfa[indx];
-              }
-
-              if(Gintv > clip_pt)
-              {
-                vcd[indx] = -ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) + cfa[indx];
-              }
-            }
-            else
-            { // R or B site
-
-              Ginth = hcd[indx] + cfa[indx]; // interpolated G
-              Gintv = vcd[indx] + cfa[indx];
-
-              if(hcd[indx] < 0)
-              {
-                if(3.f * hcd[indx] < -(Ginth + cfa[indx]))
-                {
-                  hcd[indx] = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) - cfa[indx];
-                }
-                else
-                {
-                  float hwt = 1.f + 3.f * hcd[indx] / (eps + Ginth + cfa[indx]);
-                  hcd[indx] = hwt * hcd[indx]
-                              + (1.f - hwt) * (ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) - cfa[indx]);
-                }
-              }
-
-              if(vcd[indx] < 0)
-              {
-                if(3.f * vcd[indx] < -(Gintv + cfa[indx]))
-                {
-                  vcd[indx] = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
-                }
-                else
-                {
-                  const float vwt = 1.f + 3.f * vcd[indx] / (eps + Gintv + cfa[indx]);
-                  vcd[indx] = vwt * vcd[indx]
-                              + (1.f - vwt) * (ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx]);
-                }
-              }
+            vcd[indx] = _bound_cd(vcdv, sgn, cfa[indx], cfa[indx - v1], cfa[indx + v1], clip_pt);
+            hcdbound[cc] = _bound_cd(hcd[indx], sgn, cfa[indx], cfa[indx - 1], cfa[indx + 1], clip_pt);
+            hcdaltbound[cc] = _bound_cd(hcdalt[indx], sgn, cfa[indx], cfa[indx - 1], cfa[indx + 1], clip_pt);
+          }
 
-              if(Ginth > clip_pt)
-              {
-                hcd[indx] = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]) - cfa[indx];
-              }
+          // with x the bounded hcd two pixels to the left, hcdalt is chosen if
+          //   hcdaltvar < 3 * (x^2 + q) - (x + s)^2 = 2 * x * (x - s) + 3 * q - s^2
+          // for s and q the sum and the sum of squares of the two other samples. x is itself one of the
+          // two bounded candidates, so the test is done for both and only the resulting flags are chained.
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
+          {
+            const int indx = rr * ts + cc;
+            const float sum = hcd[indx] + hcd[indx + 2];
+            const float q = 3.f * (sqrf(hcd[indx]) + sqrf(hcd[indx + 2])) - sqrf(sum) - hcdaltvar[cc];
+            const float xalt = cc < 6 ? hcd[indx - 2] : hcdaltbound[cc - 2];
+            const float x = cc < 6 ? hcd[indx - 2] : hcdbound[cc - 2];
+            usealt[cc] = (2.f * xalt * (xalt - sum) + q > 0.f ? 1 : 0) | (2.f * x * (x - sum) + q > 0.f ? 2 : 0);
+          }
 
-              if(Gintv > clip_pt)
-              {
-                vcd[indx] = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]) - cfa[indx];
-              }
+          // columns 2 and 3 are not bounded, both flags agree at columns 4 and 5
+          int left2 = 0, left1 = 0;
+          for(int cc = 4; cc < cc1 - 4; cc++)
+          {
+            const int alt = (usealt[cc] >> (left2 ? 0 : 1)) & 1;
+            left2 = left1;
+            left1 = usealt[cc] = alt;
+          }
 
-              cddiffsq[indx] = sqrf(vcd[indx] - hcd[indx]);
-            }
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
+            hcd[rr * ts + cc] = usealt[cc] ? hcdaltbound[cc] : hcdbound[cc];
 
-            c = !c;
-          }
+          // only read at R/B sites
+          DT_OMP_SIMD()
+          for(int cc = 4; cc < cc1 - 4; cc++)
+            cddiffsq[rr * ts + cc] = sqrf(vcd[rr * ts + cc] - hcd[rr * ts + cc]);
         }
 
 
         for(int rr = 6; rr < rr1 - 6; rr++)
         {
-          for(int cc = 6 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc; cc < cc1 - 6; cc += 2, indx += 2)
+          const int c0 = 6 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+
+          // the R/B site kernels count along the half size arrays so that their stores stay contiguous
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 6 - c0 + 1) / 2; i++)
           {
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
 
             // compute colour difference variances in cardinal directions
 
@@ -683,26 +551,23 @@ void amaze_demosaic(const float *const in,
             // if both agree on interpolation direction, choose the one with strongest directional
             // discrimination;
             // otherwise, choose the u/d and l/r difference fluctuation weights
-            if((0.5 - varwt) * (0.5 - diffwt) > 0 && fabsf(0.5f - diffwt) < fabsf(0.5f - varwt))
-            {
-              hvwt[indx >> 1] = varwt;
-            }
-            else
-            {
-              hvwt[indx >> 1] = diffwt;
-            }
+            hvwt[indx1] = (0.5f - varwt) * (0.5f - diffwt) > 0.f && fabsf(0.5f - diffwt) < fabsf(0.5f - varwt)
+                                ? varwt : diffwt;
           }
         }
 
         // precompute nyquist
         for(int rr = 6; rr < rr1 - 6; rr++)
         {
-          int cc = 6 + (FC(rr, 2, filters) & 1);
-          int indx = rr * ts + cc;
+          const int c0 = 6 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
 
-          for(; cc < cc1 - 6; cc += 2, indx += 2)
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 6 - c0 + 1) / 2; i++)
           {
-            nyqutest[indx >> 1]
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
+            nyqutest[indx1]
                 = (gaussodd[0] * cddiffsq[indx]
                    + gaussodd[1] * (cddiffsq[(indx - m1)] + cddiffsq[(indx + p1)] + cddiffsq[(indx - p1)]
                                     + cddiffsq[(indx + m1)])
@@ -812,9 +677,9 @@ void amaze_demosaic(const float *const in,
                 }
 
                 // horizontal and vertical colour differences, and adaptive weight
-                sumh = sumcfa - _xdiv2f(sumh);
-                sumv = sumcfa - _xdiv2f(sumv);
-                areawt = _xdiv2f(areawt);
+                sumh = sumcfa - 0.5f * sumh;
+                sumv = sumcfa - 0.5f * sumv;
+                areawt = 0.5f * areawt;
                 const float hcdvar = epssq + fabsf(areawt * sumsqh - sumh * sumh);
                 const float vcdvar = epssq + fabsf(areawt * sumsqv - sumv * sumv);
                 hvwt[indx >> 1] = hcdvar / (vcdvar + hcdvar);
@@ -827,30 +692,36 @@ void amaze_demosaic(const float *const in,
 
         // populate G at R/B sites
         for(int rr = 8; rr < rr1 - 8; rr++)
-          for(int indx = rr * ts + 8 + (FC(rr, 2, filters) & 1); indx < rr * ts + cc1 - 8; indx += 2)
+        {
+          const int c0 = 8 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+          const int o = c0 & 1;
+
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 8 - c0 + 1) / 2; i++)
           {
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
 
             // first ask if one gets more directional discrimination from nearby B/R sites
-            const float hvwtalt = _xdivf(hvwt[(indx - m1) >> 1] + hvwt[(indx + p1) >> 1] + hvwt[(indx - p1) >> 1]
-                                      + hvwt[(indx + m1) >> 1],
-                                  2);
+            const float hvwtalt = 0.25f * (hvwt[indx1 + ((o - m1) >> 1)] + hvwt[indx1 + ((o + p1) >> 1)] + hvwt[indx1 + ((o - p1) >> 1)]
+                                           + hvwt[indx1 + ((o + m1) >> 1)]);
 
-            hvwt[indx >> 1]
-                = fabsf(0.5f - hvwt[indx >> 1]) < fabsf(0.5f - hvwtalt) ? hvwtalt : hvwt[indx >> 1];
             // a better result was obtained from the neighbours
+            const float wt = fabsf(0.5f - hvwt[indx1]) < fabsf(0.5f - hvwtalt) ? hvwtalt : hvwt[indx1];
+            hvwt[indx1] = wt;
 
-            Dgrb[0][indx >> 1] = interpolatef(hvwt[indx >> 1], vcd[indx], hcd[indx]); // evaluate colour differences
+            const float cd = interpolatef(wt, vcd[indx], hcd[indx]); // evaluate colour differences
+            Dgrb[0][indx1] = cd;
 
-            rgbgreen[indx] = cfa[indx] + Dgrb[0][indx >> 1]; // evaluate G (finally!)
+            const float green = cfa[indx] + cd; // evaluate G (finally!)
+            rgbgreen[indx] = green;
 
             // local curvature in G (preparation for nyquist refinement step)
-            Dgrb2[indx >> 1].h = nyquist2[indx >> 1]
-                                     ? sqrf(rgbgreen[indx] - _xdiv2f(rgbgreen[indx - 1] + rgbgreen[indx + 1]))
-                                     : 0.f;
-            Dgrb2[indx >> 1].v = nyquist2[indx >> 1]
-                                     ? sqrf(rgbgreen[indx] - _xdiv2f(rgbgreen[indx - v1] + rgbgreen[indx + v1]))
-                                     : 0.f;
+            Dgrb2[indx1].h = nyquist2[indx1] ? sqrf(green - 0.5f * (rgbgreen[indx - 1] + rgbgreen[indx + 1])) : 0.f;
+            Dgrb2[indx1].v = nyquist2[indx1] ? sqrf(green - 0.5f * (rgbgreen[indx - v1] + rgbgreen[indx + v1])) : 0.f;
           }
+        }
 
 
         // end of standard interpolation
@@ -918,200 +789,130 @@ void amaze_demosaic(const float *const in,
 // diagonal interpolation correction
         for(int rr = 8; rr < rr1 - 8; rr++)
         {
-          for(int cc = 8 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 8;
-              cc += 2, indx += 2, indx1++)
+          const int c0 = 8 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+          const int o = c0 & 1;
+
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 8 - c0 + 1) / 2; i++)
           {
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
 
             // diagonal colour ratios
-            float crse = _xmul2f(cfa[indx + m1]) / (eps + cfa[indx] + (cfa[indx + m2]));
-            float crnw = _xmul2f(cfa[indx - m1]) / (eps + cfa[indx] + (cfa[indx - m2]));
-            float crne = _xmul2f(cfa[indx + p1]) / (eps + cfa[indx] + (cfa[indx + p2]));
-            float crsw = _xmul2f(cfa[indx - p1]) / (eps + cfa[indx] + (cfa[indx - p2]));
-            // colour differences in diagonal directions
-            float rbse, rbnw, rbne, rbsw;
+            const float crse = 2.f * cfa[indx + m1] / (eps + cfa[indx] + cfa[indx + m2]);
+            const float crnw = 2.f * cfa[indx - m1] / (eps + cfa[indx] + cfa[indx - m2]);
+            const float crne = 2.f * cfa[indx + p1] / (eps + cfa[indx] + cfa[indx + p2]);
+            const float crsw = 2.f * cfa[indx - p1] / (eps + cfa[indx] + cfa[indx - p2]);
 
+            // colour differences in diagonal directions
             // assign B/R at R/B sites
-            if(fabsf(1.f - crse) < arthresh)
-            {
-              rbse = cfa[indx] * crse; // use this if more precise diag interp is necessary
-            }
-            else
-            {
-              rbse = (cfa[indx + m1]) + _xdiv2f(cfa[indx] - cfa[indx + m2]);
-            }
-
-            if(fabsf(1.f - crnw) < arthresh)
-            {
-              rbnw = cfa[indx] * crnw;
-            }
-            else
-            {
-              rbnw = (cfa[indx - m1]) + _xdiv2f(cfa[indx] - cfa[indx - m2]);
-            }
-
-            if(fabsf(1.f - crne) < arthresh)
-            {
-              rbne = cfa[indx] * crne;
-            }
-            else
-            {
-              rbne = (cfa[indx + p1]) + _xdiv2f(cfa[indx] - cfa[indx + p2]);
-            }
-
-            if(fabsf(1.f - crsw) < arthresh)
-            {
-              rbsw = cfa[indx] * crsw;
-            }
-            else
-            {
-              rbsw = (cfa[indx - p1]) + _xdiv2f(cfa[indx] - cfa[indx - p2]);
-            }
-
-            const float wtse = eps + delm[indx1] + delm[(indx + m1) >> 1]
-                         + delm[(indx + m2) >> 1]; // same as for wtu,wtd,wtl,wtr
-            const float wtnw = eps + delm[indx1] + delm[(indx - m1) >> 1] + delm[(indx - m2) >> 1];
-            const float wtne = eps + delp[indx1] + delp[(indx + p1) >> 1] + delp[(indx + p2) >> 1];
-            const float wtsw = eps + delp[indx1] + delp[(indx - p1) >> 1] + delp[(indx - p2) >> 1];
-
-
-            rbm[indx1] = (wtse * rbnw + wtnw * rbse) / (wtse + wtnw);
-            rbp[indx1] = (wtne * rbsw + wtsw * rbne) / (wtne + wtsw);
+            const float rbse = fabsf(1.f - crse) < arthresh ? cfa[indx] * crse
+                                                            : cfa[indx + m1] + 0.5f * (cfa[indx] - cfa[indx + m2]);
+            const float rbnw = fabsf(1.f - crnw) < arthresh ? cfa[indx] * crnw
+                                                            : cfa[indx - m1] + 0.5f * (cfa[indx] - cfa[indx - m2]);
+            const float rbne = fabsf(1.f - crne) < arthresh ? cfa[indx] * crne
+                                                            : cfa[indx + p1] + 0.5f * (cfa[indx] - cfa[indx + p2]);
+            const float rbsw = fabsf(1.f - crsw) < arthresh ? cfa[indx] * crsw
+                                                            : cfa[indx - p1] + 0.5f * (cfa[indx] - cfa[indx - p2]);
+
+            const float wtse = eps + delm[indx1] + delm[indx1 + ((o + m1) >> 1)]
+                         + delm[indx1 + ((o + m2) >> 1)]; // same as for wtu,wtd,wtl,wtr
+            const float wtnw = eps + delm[indx1] + delm[indx1 + ((o - m1) >> 1)] + delm[indx1 + ((o - m2) >> 1)];
+            const float wtne = eps + delp[indx1] + delp[indx1 + ((o + p1) >> 1)] + delp[indx1 + ((o + p2) >> 1)];
+            const float wtsw = eps + delp[indx1] + delp[indx1 + ((o - p1) >> 1)] + delp[indx1 + ((o - p2) >> 1)];
+
+            float rbmv = (wtse * rbnw + wtnw * rbse) / (wtse + wtnw);
+            float rbpv = (wtne * rbsw + wtsw * rbne) / (wtne + wtsw);
 
             // variance of R-B in plus/minus directions
             const float rbvarm = epssq
-                  + (gausseven[0] * (Dgrbsq1m[(indx - v1) >> 1] + Dgrbsq1m[(indx - 1) >> 1]
-                                     + Dgrbsq1m[(indx + 1) >> 1] + Dgrbsq1m[(indx + v1) >> 1])
-                     + gausseven[1] * (Dgrbsq1m[(indx - v2 - 1) >> 1] + Dgrbsq1m[(indx - v2 + 1) >> 1]
-                                       + Dgrbsq1m[(indx - 2 - v1) >> 1] + Dgrbsq1m[(indx + 2 - v1) >> 1]
-                                       + Dgrbsq1m[(indx - 2 + v1) >> 1] + Dgrbsq1m[(indx + 2 + v1) >> 1]
-                                       + Dgrbsq1m[(indx + v2 - 1) >> 1] + Dgrbsq1m[(indx + v2 + 1) >> 1]));
+                  + (gausseven[0] * (Dgrbsq1m[indx1 + ((o - v1) >> 1)] + Dgrbsq1m[indx1 + ((o - 1) >> 1)]
+                                     + Dgrbsq1m[indx1 + ((o + 1) >> 1)] + Dgrbsq1m[indx1 + ((o + v1) >> 1)])
+                     + gausseven[1] * (Dgrbsq1m[indx1 + ((o - v2 - 1) >> 1)] + Dgrbsq1m[indx1 + ((o - v2 + 1) >> 1)]
+                                       + Dgrbsq1m[indx1 + ((o - 2 - v1) >> 1)] + Dgrbsq1m[indx1 + ((o + 2 - v1) >> 1)]
+                                       + Dgrbsq1m[indx1 + ((o - 2 + v1) >> 1)] + Dgrbsq1m[indx1 + ((o + 2 + v1) >> 1)]
+                                       + Dgrbsq1m[indx1 + ((o + v2 - 1) >> 1)] + Dgrbsq1m[indx1 + ((o + v2 + 1) >> 1)]));
             pmwt[indx1] = rbvarm
-                  / ((epssq + (gausseven[0] * (Dgrbsq1p[(indx - v1) >> 1] + Dgrbsq1p[(indx - 1) >> 1]
-                                               + Dgrbsq1p[(indx + 1) >> 1] + Dgrbsq1p[(indx + v1) >> 1])
+                  / ((epssq + (gausseven[0] * (Dgrbsq1p[indx1 + ((o - v1) >> 1)] + Dgrbsq1p[indx1 + ((o - 1) >> 1)]
+                                               + Dgrbsq1p[indx1 + ((o + 1) >> 1)] + Dgrbsq1p[indx1 + ((o + v1) >> 1)])
                                + gausseven[1]
-                                     * (Dgrbsq1p[(indx - v2 - 1) >> 1] + Dgrbsq1p[(indx - v2 + 1) >> 1]
-                                        + Dgrbsq1p[(indx - 2 - v1) >> 1] + Dgrbsq1p[(indx + 2 - v1) >> 1]
-                                        + Dgrbsq1p[(indx - 2 + v1) >> 1] + Dgrbsq1p[(indx + 2 + v1) >> 1]
-                                        + Dgrbsq1p[(indx + v2 - 1) >> 1] + Dgrbsq1p[(indx + v2 + 1) >> 1])))
+                                     * (Dgrbsq1p[indx1 + ((o - v2 - 1) >> 1)] + Dgrbsq1p[indx1 + ((o - v2 + 1) >> 1)]
+                                        + Dgrbsq1p[indx1 + ((o - 2 - v1) >> 1)] + Dgrbsq1p[indx1 + ((o + 2 - v1) >> 1)]
+                                        + Dgrbsq1p[indx1 + ((o - 2 + v1) >> 1)] + Dgrbsq1p[indx1 + ((o + 2 + v1) >> 1)]
+                                        + Dgrbsq1p[indx1 + ((o + v2 - 1) >> 1)] + Dgrbsq1p[indx1 + ((o + v2 + 1) >> 1)])))
                      + rbvarm);
 
             // bound the interpolation in regions of high saturation
-
-            if(rbp[indx1] < cfa[indx])
-            {
-              if(_xmul2f(rbp[indx1]) < cfa[indx])
-              {
-                rbp[indx1] = ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-              }
-              else
-              {
-                const float pwt = _xmul2f(cfa[indx] - rbp[indx1]) / (eps + rbp[indx1] + cfa[indx]);
-                rbp[indx1] = pwt * rbp[indx1] + (1.f - pwt) * ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-              }
-            }
-
-            if(rbm[indx1] < cfa[indx])
-            {
-              if(_xmul2f(rbm[indx1]) < cfa[indx])
-              {
-                rbm[indx1] = ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-              }
-              else
-              {
-                const float mwt = _xmul2f(cfa[indx] - rbm[indx1]) / (eps + rbm[indx1] + cfa[indx]);
-                rbm[indx1] = mwt * rbm[indx1] + (1.f - mwt) * ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-              }
-            }
-
-            if(rbp[indx1] > clip_pt)
-            {
-              rbp[indx1] = ULIM(rbp[indx1], cfa[indx - p1], cfa[indx + p1]);
-            }
-
-            if(rbm[indx1] > clip_pt)
-            {
-              rbm[indx1] = ULIM(rbm[indx1], cfa[indx - m1], cfa[indx + m1]);
-            }
+            const float pbound = ULIM(rbpv, cfa[indx - p1], cfa[indx + p1]);
+            const float mbound = ULIM(rbmv, cfa[indx - m1], cfa[indx + m1]);
+            const float pwt = 2.f * (cfa[indx] - rbpv) / (eps + rbpv + cfa[indx]);
+            const float mwt = 2.f * (cfa[indx] - rbmv) / (eps + rbmv + cfa[indx]);
+
+            if(rbpv < cfa[indx])
+              rbpv = 2.f * rbpv < cfa[indx] ? pbound : pwt * rbpv + (1.f - pwt) * pbound;
+            if(rbmv < cfa[indx])
+              rbmv = 2.f * rbmv < cfa[indx] ? mbound : mwt * rbmv + (1.f - mwt) * mbound;
+
+            rbp[indx1] = rbpv > clip_pt ? ULIM(rbpv, cfa[indx - p1], cfa[indx + p1]) : rbpv;
+            rbm[indx1] = rbmv > clip_pt ? ULIM(rbmv, cfa[indx - m1], cfa[indx + m1]) : rbmv;
           }
         }
 
         for(int rr = 10; rr < rr1 - 10; rr++)
-          for(int cc = 10 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 10;
-              cc += 2, indx += 2, indx1++)
+        {
+          const int c0 = 10 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+          const int o = c0 & 1;
+
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 10 - c0 + 1) / 2; i++)
           {
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
 
             // first ask if one gets more directional discrimination from nearby B/R sites
-            const float pmwtalt = _xdivf(pmwt[(indx - m1) >> 1] + pmwt[(indx + p1) >> 1] + pmwt[(indx - p1) >> 1]
-                                      + pmwt[(indx + m1) >> 1],
-                                  2);
+            const float pmwtalt = 0.25f * (pmwt[indx1 + ((o - m1) >> 1)] + pmwt[indx1 + ((o + p1) >> 1)] + pmwt[indx1 + ((o - p1) >> 1)]
+                                           + pmwt[indx1 + ((o + m1) >> 1)]);
 
-            if(fabsf(0.5f - pmwt[indx1]) < fabsf(0.5f - pmwtalt))
-            {
-              pmwt[indx1] = pmwtalt; // a better result was obtained from the neighbours
-            }
+            // a better result was obtained from the neighbours
+            const float wt = fabsf(0.5f - pmwt[indx1]) < fabsf(0.5f - pmwtalt) ? pmwtalt : pmwt[indx1];
+            pmwt[indx1] = wt;
 
-            rbint[indx1] = _xdiv2f(cfa[indx] + rbm[indx1] * (1.f - pmwt[indx1])
-                                  + rbp[indx1] * pmwt[indx1]); // this is R+B, interpolated
+            rbint[indx1] = 0.5f * (cfa[indx] + rbm[indx1] * (1.f - wt) + rbp[indx1] * wt); // this is R+B, interpolated
           }
+        }
 
         for(int rr = 12; rr < rr1 - 12; rr++)
-          for(int cc = 12 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, indx1 = indx >> 1; cc < cc1 - 12;
-              cc += 2, indx += 2, indx1++)
-          {
+        {
+          const int c0 = 12 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+          float *const Dgrbrow = Dgrb[0];
 
-            if(fabsf(0.5f - pmwt[indx >> 1]) < fabsf(0.5f - hvwt[indx >> 1]))
-            {
-              continue;
-            }
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 12 - c0 + 1) / 2; i++)
+          {
+            const int indx = indx0 + 2 * i;
+            const int indx1 = (indx0 >> 1) + i;
 
             // now interpolate G vertically/horizontally using R+B values
             // unfortunately, since G interpolation cannot be done diagonally this may lead to colour shifts
 
             // colour ratios for G interpolation
-            const float cru = cfa[indx - v1] * 2.0 / (eps + rbint[indx1] + rbint[(indx1 - v1)]);
-            const float crd = cfa[indx + v1] * 2.0 / (eps + rbint[indx1] + rbint[(indx1 + v1)]);
-            const float crl = cfa[indx - 1] * 2.0 / (eps + rbint[indx1] + rbint[(indx1 - 1)]);
-            const float crr = cfa[indx + 1] * 2.0 / (eps + rbint[indx1] + rbint[(indx1 + 1)]);
-
-            // interpolation of G in four directions
-            float gu, gd, gl, gr;
+            const float cru = cfa[indx - v1] * 2.f / (eps + rbint[indx1] + rbint[(indx1 - v1)]);
+            const float crd = cfa[indx + v1] * 2.f / (eps + rbint[indx1] + rbint[(indx1 + v1)]);
+            const float crl = cfa[indx - 1] * 2.f / (eps + rbint[indx1] + rbint[(indx1 - 1)]);
+            const float crr = cfa[indx + 1] * 2.f / (eps + rbint[indx1] + rbint[(indx1 + 1)]);
 
             // interpolated G via adaptive ratios or Hamilton-Adams in each cardinal direction
-            if(fabsf(1.f - cru) < arthresh)
-            {
-              gu = rbint[indx1] * cru;
-            }
-            else
-            {
-              gu = cfa[indx - v1] + _xdiv2f(rbint[indx1] - rbint[(indx1 - v1)]);
-            }
-
-            if(fabsf(1.f - crd) < arthresh)
-            {
-              gd = rbint[indx1] * crd;
-            }
-            else
-            {
-              gd = cfa[indx + v1] + _xdiv2f(rbint[indx1] - rbint[(indx1 + v1)]);
-            }
-
-            if(fabsf(1.f - crl) < arthresh)
-            {
-              gl = rbint[indx1] * crl;
-            }
-            else
-            {
-              gl = cfa[indx - 1] + _xdiv2f(rbint[indx1] - rbint[(indx1 - 1)]);
-            }
-
-            if(fabsf(1.f - crr) < arthresh)
-            {
-              gr = rbint[indx1] * crr;
-            }
-            else
-            {
-              gr = cfa[indx + 1] + _xdiv2f(rbint[indx1] - rbint[(indx1 + 1)]);
-            }
+            const float gu = fabsf(1.f - cru) < arthresh ? rbint[indx1] * cru
+                                                         : cfa[indx - v1] + 0.5f * (rbint[indx1] - rbint[(indx1 - v1)]);
+            const float gd = fabsf(1.f - crd) < arthresh ? rbint[indx1] * crd
+                                                         : cfa[indx + v1] + 0.5f * (rbint[indx1] - rbint[(indx1 + v1)]);
+            const float gl = fabsf(1.f - crl) < arthresh ? rbint[indx1] * crl
+                                                         : cfa[indx - 1] + 0.5f * (rbint[indx1] - rbint[(indx1 - 1)]);
+            const float gr = fabsf(1.f - crr) < arthresh ? rbint[indx1] * crr
+                                                         : cfa[indx + 1] + 0.5f * (rbint[indx1] - rbint[(indx1 + 1)]);
 
             // interpolated G via adaptive weights of cardinal evaluations
             float Gintv = (dirwts0[indx - v1] * gd + dirwts0[indx + v1] * gu)
@@ -1120,45 +921,28 @@ void amaze_demosaic(const float *const in,
                           / (dirwts1[indx - 1] + dirwts1[indx + 1]);
 
             // bound the interpolation in regions of high saturation
-            if(Gintv < rbint[indx1])
-            {
-              if(2 * Gintv < rbint[indx1])
-              {
-                Gintv = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]);
-              }
-              else
-              {
-                float vwt = 2.0 * (rbint[indx1] - Gintv) / (eps + Gintv + rbint[indx1]);
-                Gintv = vwt * Gintv + (1.f - vwt) * ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]);
-              }
-            }
+            const float vbound = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]);
+            const float hbound = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]);
+            const float vwt = 2.f * (rbint[indx1] - Gintv) / (eps + Gintv + rbint[indx1]);
+            const float hwt = 2.f * (rbint[indx1] - Ginth) / (eps + Ginth + rbint[indx1]);
 
+            if(Gintv < rbint[indx1])
+              Gintv = 2.f * Gintv < rbint[indx1] ? vbound : vwt * Gintv + (1.f - vwt) * vbound;
             if(Ginth < rbint[indx1])
-            {
-              if(2 * Ginth < rbint[indx1])
-              {
-                Ginth = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]);
-              }
-              else
-              {
-                const float hwt = 2.0 * (rbint[indx1] - Ginth) / (eps + Ginth + rbint[indx1]);
-                Ginth = hwt * Ginth + (1.f - hwt) * ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]);
-              }
-            }
-
+              Ginth = 2.f * Ginth < rbint[indx1] ? hbound : hwt * Ginth + (1.f - hwt) * hbound;
             if(Ginth > clip_pt)
-            {
               Ginth = ULIM(Ginth, cfa[indx - 1], cfa[indx + 1]);
-            }
-
             if(Gintv > clip_pt)
-            {
               Gintv = ULIM(Gintv, cfa[indx - v1], cfa[indx + v1]);
-            }
 
-            rgbgreen[indx] = Ginth * (1.f - hvwt[indx1]) + Gintv * hvwt[indx1];
-            Dgrb[0][indx >> 1] = rgbgreen[indx] - cfa[indx];
+            // keep the cardinal interpolation where the diagonal one discriminates better
+            const bool diagonal = fabsf(0.5f - pmwt[indx1]) < fabsf(0.5f - hvwt[indx1]);
+            const float green = Ginth * (1.f - hvwt[indx1]) + Gintv * hvwt[indx1];
+            // rgbgreen == cfa + Dgrb at R/B sites, rebuilding it avoids a strided masked store
+            rgbgreen[indx] = diagonal ? cfa[indx] + Dgrbrow[indx1] : green;
+            Dgrbrow[indx1] = diagonal ? Dgrbrow[indx1] : green - cfa[indx];
           }
+        }
 
         // end of diagonal interpolation correction
 
@@ -1172,169 +956,82 @@ void amaze_demosaic(const float *const in,
           }
 
         for(int rr = 14; rr < rr1 - 14; rr++)
-
-          for(int cc = 14 + (FC(rr, 2, filters) & 1), indx = rr * ts + cc, c = 1 - FC(rr, cc, filters) / 2;
-              cc < cc1 - 14; cc += 2, indx += 2)
+        {
+          const int c0 = 14 + (FC(rr, 2, filters) & 1);
+          const int indx0 = rr * ts + c0;
+          const int o = c0 & 1;
+          float *const Dc = Dgrb[1 - FC(rr, c0, filters) / 2];
+          DT_OMP_SIMD()
+          for(int i = 0; i < (cc1 - 14 - c0 + 1) / 2; i++)
           {
-            const float wtnw = 1.f / (eps + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx + m1) >> 1])
-                                + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx - m3) >> 1])
-                                + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - m3) >> 1]));
-            const float wtne = 1.f / (eps + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx - p1) >> 1])
-                                + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx + p3) >> 1])
-                                + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + p3) >> 1]));
-            const float wtsw = 1.f / (eps + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + p1) >> 1])
-                                + fabsf(Dgrb[c][(indx - p1) >> 1] - Dgrb[c][(indx + m3) >> 1])
-                                + fabsf(Dgrb[c][(indx + p1) >> 1] - Dgrb[c][(indx - p3) >> 1]));
-            const float wtse = 1.f / (eps + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - m1) >> 1])
-                                + fabsf(Dgrb[c][(indx + m1) >> 1] - Dgrb[c][(indx - p3) >> 1])
-                                + fabsf(Dgrb[c][(indx - m1) >> 1] - Dgrb[c][(indx + m3) >> 1]));
-
-            Dgrb[c][indx >> 1]
-                = (wtnw * (1.325f * Dgrb[c][(indx - m1) >> 1] - 0.175f * Dgrb[c][(indx - m3) >> 1]
-                           - 0.075f * Dgrb[c][(indx - m1 - 2) >> 1] - 0.075f * Dgrb[c][(indx - m1 - v2) >> 1])
-                   + wtne * (1.325f * Dgrb[c][(indx + p1) >> 1] - 0.175f * Dgrb[c][(indx + p3) >> 1]
-                             - 0.075f * Dgrb[c][(indx + p1 + 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx + p1 + v2) >> 1])
-                   + wtsw * (1.325f * Dgrb[c][(indx - p1) >> 1] - 0.175f * Dgrb[c][(indx - p3) >> 1]
-                             - 0.075f * Dgrb[c][(indx - p1 - 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx - p1 - v2) >> 1])
-                   + wtse * (1.325f * Dgrb[c][(indx + m1) >> 1] - 0.175f * Dgrb[c][(indx + m3) >> 1]
-                             - 0.075f * Dgrb[c][(indx + m1 + 2) >> 1]
-                             - 0.075f * Dgrb[c][(indx + m1 + v2) >> 1]))
-                  / (wtnw + wtne + wtsw + wtse);
+            const int indx1 = (indx0 >> 1) + i;
+            const float nw1 = Dc[indx1 + ((o - m1) >> 1)], nw3 = Dc[indx1 + ((o - m3) >> 1)];
+            const float ne1 = Dc[indx1 + ((o + p1) >> 1)], ne3 = Dc[indx1 + ((o + p3) >> 1)];
+            const float sw1 = Dc[indx1 + ((o - p1) >> 1)], sw3 = Dc[indx1 + ((o - p3) >> 1)];
+            const float se1 = Dc[indx1 + ((o + m1) >> 1)], se3 = Dc[indx1 + ((o + m3) >> 1)];
+
+            const float wtnw = 1.f / (eps + fabsf(nw1 - se1) + fabsf(nw1 - nw3) + fabsf(se1 - nw3));
+            const float wtne = 1.f / (eps + fabsf(ne1 - sw1) + fabsf(ne1 - ne3) + fabsf(sw1 - ne3));
+            const float wtsw = 1.f / (eps + fabsf(sw1 - ne1) + fabsf(sw1 - se3) + fabsf(ne1 - sw3));
+            const float wtse = 1.f / (eps + fabsf(se1 - nw1) + fabsf(se1 - sw3) + fabsf(nw1 - se3));
+
+            Dc[indx1] = (wtnw * (1.325f * nw1 - 0.175f * nw3 - 0.075f * Dc[indx1 + ((o - m1 - 2) >> 1)]
+                                 - 0.075f * Dc[indx1 + ((o - m1 - v2) >> 1)])
+                         + wtne * (1.325f * ne1 - 0.175f * ne3 - 0.075f * Dc[indx1 + ((o + p1 + 2) >> 1)]
+                                   - 0.075f * Dc[indx1 + ((o + p1 + v2) >> 1)])
+                         + wtsw * (1.325f * sw1 - 0.175f * sw3 - 0.075f * Dc[indx1 + ((o - p1 - 2) >> 1)]
+                                   - 0.075f * Dc[indx1 + ((o - p1 - v2) >> 1)])
+                         + wtse * (1.325f * se1 - 0.175f * se3 - 0.075f * Dc[indx1 + ((o + m1 + 2) >> 1)]
+                                   - 0.075f * Dc[indx1 + ((o + m1 + v2) >> 1)]))
+                        / (wtnw + wtne + wtsw + wtse);
           }
+        }
 
-        for(int rr = 16; rr < rr1 - 16; rr++)
+        // copy the results back to the image, the tile limits are folded into the row range
+        const int rrout = MIN(rr1 - 16, height - top);
+        const int ccout = MIN(cc1 - 16, width - left);
+        for(int rr = 16; rr < rrout; rr++)
         {
-          int row = rr + top;
-          int col = left + 16;
-          int indx = rr * ts + 16;
-
-          if((FC(rr, 2, filters) & 1) == 1)
-          {
-            for(; indx < rr * ts + cc1 - 16 - (cc1 & 1); indx++, col++)
-            {
-              if(col < width && row < height)
-              {
-                const float temp = 1.f / (hvwt[(indx - v1) >> 1] + 2.f - hvwt[(indx + 1) >> 1]
-                                    - hvwt[(indx - 1) >> 1] + hvwt[(indx + v1) >> 1]);
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[0][(indx - v1) >> 1]
-                                      + (1.f - hvwt[(indx + 1) >> 1]) * Dgrb[0][(indx + 1) >> 1]
-                                      + (1.f - hvwt[(indx - 1) >> 1]) * Dgrb[0][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[0][(indx + v1) >> 1])
-                                         * temp,
-                               0.0, 1.0);
-
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[1][(indx - v1) >> 1]
-                                      + (1.f - hvwt[(indx + 1) >> 1]) * Dgrb[1][(indx + 1) >> 1]
-                                      + (1.f - hvwt[(indx - 1) >> 1]) * Dgrb[1][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[1][(indx + v1) >> 1])
-                                         * temp,
-                               0.0, 1.0);
-              }
-
-              indx++;
-              col++;
-              if(col < width && row < height)
-              {
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx] - Dgrb[0][indx >> 1], 0.0, 1.0);
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx] - Dgrb[1][indx >> 1], 0.0, 1.0);
-              }
-            }
-
-            if(cc1 & 1)
-            { // width of tile is odd
-              if(col < width && row < height)
-              {
-                const float temp = 1.f / (hvwt[(indx - v1) >> 1] + 2.f - hvwt[(indx + 1) >> 1]
-                                    - hvwt[(indx - 1) >> 1] + hvwt[(indx + v1) >> 1]);
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[0][(indx - v1) >> 1]
-                                      + (1.f - hvwt[(indx + 1) >> 1]) * Dgrb[0][(indx + 1) >> 1]
-                                      + (1.f - hvwt[(indx - 1) >> 1]) * Dgrb[0][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[0][(indx + v1) >> 1])
-                                         * temp,
-                               0.0, 1.0);
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[1][(indx - v1) >> 1]
-                                      + (1.f - hvwt[(indx + 1) >> 1]) * Dgrb[1][(indx + 1) >> 1]
-                                      + (1.f - hvwt[(indx - 1) >> 1]) * Dgrb[1][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[1][(indx + v1) >> 1])
-                                         * temp,
-                               0.0, 1.0);
-              }
-            }
-          }
-          else
+          float *const outrow = out + ((size_t)(rr + top) * width + left) * 4;
+
+          // R and B at G sites
+          const int cg = 17 - (FC(rr, 2, filters) & 1);
+          const int indxg = rr * ts + cg;
+          const int o = cg & 1;
+          DT_OMP_SIMD()
+          for(int i = 0; i < (ccout - cg + 1) / 2; i++)
           {
-            for(; indx < rr * ts + cc1 - 16 - (cc1 & 1); indx++, col++)
-            {
-              if(col < width && row < height)
-              {
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx] - Dgrb[0][indx >> 1], 0.0f, 1.0f);
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx] - Dgrb[1][indx >> 1], 0.0f, 1.0f);
-              }
-
-              indx++;
-              col++;
-              if(col < width && row < height)
-              {
-                const float temp = 1.f / (hvwt[(indx - v1) >> 1] + 2.f - hvwt[(indx + 1) >> 1]
-                                    - hvwt[(indx - 1) >> 1] + hvwt[(indx + v1) >> 1]);
-
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[0][(indx - v1) >> 1]
-                                      + (1.0f - hvwt[(indx + 1) >> 1]) * Dgrb[0][(indx + 1) >> 1]
-                                      + (1.0f - hvwt[(indx - 1) >> 1]) * Dgrb[0][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[0][(indx + v1) >> 1])
-                                         * temp,
-                               0.0f, 1.0f);
-
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx]
-                                   - ((hvwt[(indx - v1) >> 1]) * Dgrb[1][(indx - v1) >> 1]
-                                      + (1.0f - hvwt[(indx + 1) >> 1]) * Dgrb[1][(indx + 1) >> 1]
-                                      + (1.0f - hvwt[(indx - 1) >> 1]) * Dgrb[1][(indx - 1) >> 1]
-                                      + (hvwt[(indx + v1) >> 1]) * Dgrb[1][(indx + v1) >> 1])
-                                         * temp,
-                               0.0f, 1.0f);
-              }
-            }
-
-            if(cc1 & 1)
-            { // width of tile is odd
-              if(col < width && row < height)
-              {
-                out[(row * width + col) * 4]
-                    = _clampnan(rgbgreen[indx] - Dgrb[0][indx >> 1], 0.0f, 1.0f);
-                out[(row * width + col) * 4 + 2]
-                    = _clampnan(rgbgreen[indx] - Dgrb[1][indx >> 1], 0.0f, 1.0f);
-              }
-            }
+            const int cc = cg + 2 * i;
+            const int indx = indxg + 2 * i;
+            const int indx1 = (indxg >> 1) + i;
+            const int n = indx1 + ((o - v1) >> 1), s = indx1 + ((o + v1) >> 1);
+            const int w = indx1 + ((o - 1) >> 1), e = indx1 + ((o + 1) >> 1);
+            const float temp = 1.f / (hvwt[n] + 2.f - hvwt[e] - hvwt[w] + hvwt[s]);
+            outrow[cc * 4] = _clampnan(rgbgreen[indx]
+                                       - (hvwt[n] * Dgrb[0][n] + (1.f - hvwt[e]) * Dgrb[0][e]
+                                          + (1.f - hvwt[w]) * Dgrb[0][w] + hvwt[s] * Dgrb[0][s])
+                                             * temp,
+                                       0.0f, 1.0f);
+            outrow[cc * 4 + 1] = _clampnan(rgbgreen[indx], 0.0f, 1.0f);
+            outrow[cc * 4 + 2] = _clampnan(rgbgreen[indx]
+                                           - (hvwt[n] * Dgrb[1][n] + (1.f - hvwt[e]) * Dgrb[1][e]
+                                              + (1.f - hvwt[w]) * Dgrb[1][w] + hvwt[s] * Dgrb[1][s])
+                                                 * temp,
+                                           0.0f, 1.0f);
           }
-        }
 
-        // copy smoothed results back to image matrix
-        for(int rr = 16; rr < rr1 - 16; rr++)
-        {
-          const int row = rr + top;
-          for(int cc = 16; cc < cc1 - 16; cc++)
+          // the missing colours at R and B sites
+          const int crb = 16 + (FC(rr, 2, filters) & 1);
+          const int indxrb = rr * ts + crb;
+          DT_OMP_SIMD()
+          for(int i = 0; i < (ccout - crb + 1) / 2; i++)
           {
-            const int col = cc + left;
-            const int indx = rr * ts + cc;
-            if(col < width && row < height)
-              out[(row * width + col) * 4 + 1] = _clampnan(rgbgreen[indx], 0.0f, 1.0f);
+            const int cc = crb + 2 * i;
+            const int indx = indxrb + 2 * i;
+            const int indx1 = (indxrb >> 1) + i;
+            outrow[cc * 4] = _clampnan(rgbgreen[indx] - Dgrb[0][indx1], 0.0f, 1.0f);
+            outrow[cc * 4 + 1] = _clampnan(rgbgreen[indx], 0.0f, 1.0f);
+            outrow[cc * 4 + 2] = _clampnan(rgbgreen[indx] - Dgrb[1][indx1], 0.0f, 1.0f);
           }
         }
       }
@@ -0,0 +1,40 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// shared by demosaic.c and the demosaicer unit tests
+
+// these are highly depending on CPU architecture (cache size)
+#define DT_RCD_TILESIZE 112
+#define DT_LMMSE_TILESIZE 136
+
+typedef enum dt_iop_demosaic_lmmse_t
+{
+  DT_LMMSE_REFINE_0 = 0,   // $DESCRIPTION: "basic"
+  DT_LMMSE_REFINE_1 = 1,   // $DESCRIPTION: "median"
+  DT_LMMSE_REFINE_2 = 2,   // $DESCRIPTION: "3x median"
+  DT_LMMSE_REFINE_3 = 3,   // $DESCRIPTION: "refine & medians"
+  DT_LMMSE_REFINE_4 = 4,   // $DESCRIPTION: "2x refine + medians"
+} dt_iop_demosaic_lmmse_t;
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -97,23 +97,73 @@ static void _init_lmmse_gamma()
 
 
 
+// functions from common/math.h are compiled without the optimize pragma above and can't be inlined
+// into lmmse_demosaic(), calls to them keep the row loops from vectorizing. so we use local copies.
+static inline float _sqrf(const float x)
+{
+  return x * x;
+}
+
 static inline float _median3f(float x0, float x1, float x2)
 {
   return fmaxf(fminf(x0,x1), fminf(x2, fmaxf(x0,x1)));
 }
 
-static inline float _calc_gamma(float val, float *table)
+// same sorting network as median9f() but on values
+static inline float _median9f(const float x0, const float x1, const float x2,
+                              const float x3, const float x4, const float x5,
+                              const float x6, const float x7, const float x8)
+{
+  float p1 = fminf(x1, x2);
+  float p2 = fmaxf(x1, x2);
+  float p4 = fminf(x4, x5);
+  float p5 = fmaxf(x4, x5);
+  float p7 = fminf(x7, x8);
+  float p8 = fmaxf(x7, x8);
+  const float p0 = fminf(x0, p1);
+  const float p1a = fmaxf(x0, p1);
+  float p3 = fminf(x3, p4);
+  float p4a = fmaxf(x3, p4);
+  float p6 = fminf(x6, p7);
+  float p7a = fmaxf(x6, p7);
+  p1 = fminf(p1a, p2);
+  p2 = fmaxf(p1a, p2);
+  p4 = fminf(p4a, p5);
+  p5 = fmaxf(p4a, p5);
+  p7 = fminf(p7a, p8);
+  p8 = fmaxf(p7a, p8);
+  p3 = fmaxf(p0, p3);
+  p5 = fminf(p5, p8);
+  p7a = fmaxf(p4, p7);
+  p4 = fminf(p4, p7);
+  p6 = fmaxf(p3, p6);
+  p4 = fmaxf(p1, p4);
+  p2 = fminf(p2, p5);
+  p4a = fminf(p4, p7a);
+  p4 = fminf(p4a, p2);
+  p2 = fmaxf(p4a, p2);
+  p4 = fmaxf(p6, p4);
+  return fminf(p2, p4);
+}
+
+static inline float _gamma_lookup(float val, const float *table)
 {
-  if(table == NULL) return val;
   const float index = val * 65535.0f;
-  if(index < 0.0f)      return 0.0f;
-  if(index > 65534.99f) return 1.0f;
-  const int idx = (int)index;
+  // instead of returning early the index is clamped, above the table the interpolation
+  // ends at table[65535] == 1.0f. this keeps the callers' loops free of branches.
+  const float cindex = fminf(fmaxf(index, 0.0f), 65534.99f);
+  const int idx = (int)cindex;
 
-  const float diff = index - (float)idx;
+  const float diff = fminf(cindex - (float)idx + (index > 65534.99f ? 1.0f : 0.0f), 1.0f);
   const float p1 = table[idx];
   const float p2 = table[idx+1] - p1;
-  return (p1 + p2 * diff);
+  return p1 + p2 * diff;
+}
+
+static inline float _calc_gamma(float val, float *table)
+{
+  if(table == NULL) return val;
+  return _gamma_lookup(val, table);
 }
 
 DT_OMP_DECLARE_SIMD(aligned(in, out : 64))
@@ -248,81 +298,89 @@ static void lmmse_demosaic(float *const restrict out,
 
         for(int rr = 4; rr < last_rr - 4; rr++)
         {
-          for(int cc = 4 + (FC(rr, 4, filters) & 1); cc < last_cc - 4; cc += 2)
+          const int c0 = 4 + (FC(rr, 4, filters) & 1);
+          const float *hdiff = qix[0] + rr * DT_LMMSE_TILESIZE + c0;
+          const float *vdiff = qix[1] + rr * DT_LMMSE_TILESIZE + c0;
+          const float *hlp   = qix[2] + rr * DT_LMMSE_TILESIZE + c0;
+          const float *vlp   = qix[3] + rr * DT_LMMSE_TILESIZE + c0;
+          float *interp = qix[4] + rr * DT_LMMSE_TILESIZE + c0;
+          DT_OMP_SIMD()
+          for(int i = 0; i < (last_cc - 4 - c0 + 1) / 2; i++)
           {
-            float *hdiff = qix[0] + rr * DT_LMMSE_TILESIZE + cc;
-            float *vdiff = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
-            float *hlp   = qix[2] + rr * DT_LMMSE_TILESIZE + cc;
-            float *vlp   = qix[3] + rr * DT_LMMSE_TILESIZE + cc;
-            float *interp = qix[4] + rr * DT_LMMSE_TILESIZE + cc;
+            const int cc = 2 * i;
             // horizontal
-            float p1 = hlp[-4];
-            float p2 = hlp[-3];
-            float p3 = hlp[-2];
-            float p4 = hlp[-1];
-            float p5 = hlp[ 0];
-            float p6 = hlp[ 1];
-            float p7 = hlp[ 2];
-            float p8 = hlp[ 3];
-            float p9 = hlp[ 4];
+            float p1 = hlp[cc - 4];
+            float p2 = hlp[cc - 3];
+            float p3 = hlp[cc - 2];
+            float p4 = hlp[cc - 1];
+            float p5 = hlp[cc    ];
+            float p6 = hlp[cc + 1];
+            float p7 = hlp[cc + 2];
+            float p8 = hlp[cc + 3];
+            float p9 = hlp[cc + 4];
             float mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.0f;
-            float vx = 1e-7f + sqrf(p1 - mu) + sqrf(p2 - mu) + sqrf(p3 - mu) + sqrf(p4 - mu) + sqrf(p5 - mu) + sqrf(p6 - mu) + sqrf(p7 - mu) + sqrf(p8 - mu) + sqrf(p9 - mu);
-            p1 -= hdiff[-4];
-            p2 -= hdiff[-3];
-            p3 -= hdiff[-2];
-            p4 -= hdiff[-1];
-            p5 -= hdiff[ 0];
-            p6 -= hdiff[ 1];
-            p7 -= hdiff[ 2];
-            p8 -= hdiff[ 3];
-            p9 -= hdiff[ 4];
-            float vn = 1e-7f + sqrf(p1) + sqrf(p2) + sqrf(p3) + sqrf(p4) + sqrf(p5) + sqrf(p6) + sqrf(p7) + sqrf(p8) + sqrf(p9);
-            float xh = (hdiff[0] * vx + hlp[0] * vn) / (vx + vn);
-            float vh = vx * vn / (vx + vn);
+            float vx = 1e-7f + _sqrf(p1 - mu) + _sqrf(p2 - mu) + _sqrf(p3 - mu) + _sqrf(p4 - mu) + _sqrf(p5 - mu) + _sqrf(p6 - mu) + _sqrf(p7 - mu) + _sqrf(p8 - mu) + _sqrf(p9 - mu);
+            p1 -= hdiff[cc - 4];
+            p2 -= hdiff[cc - 3];
+            p3 -= hdiff[cc - 2];
+            p4 -= hdiff[cc - 1];
+            p5 -= hdiff[cc    ];
+            p6 -= hdiff[cc + 1];
+            p7 -= hdiff[cc + 2];
+            p8 -= hdiff[cc + 3];
+            p9 -= hdiff[cc + 4];
+            float vn = 1e-7f + _sqrf(p1) + _sqrf(p2) + _sqrf(p3) + _sqrf(p4) + _sqrf(p5) + _sqrf(p6) + _sqrf(p7) + _sqrf(p8) + _sqrf(p9);
+            const float xh = (hdiff[cc] * vx + hlp[cc] * vn) / (vx + vn);
+            const float vh = vx * vn / (vx + vn);
 
             // vertical
-            p1 = vlp[-w4];
-            p2 = vlp[-w3];
-            p3 = vlp[-w2];
-            p4 = vlp[-w1];
-            p5 = vlp[  0];
-            p6 = vlp[ w1];
-            p7 = vlp[ w2];
-            p8 = vlp[ w3];
-            p9 = vlp[ w4];
+            p1 = vlp[cc - w4];
+            p2 = vlp[cc - w3];
+            p3 = vlp[cc - w2];
+            p4 = vlp[cc - w1];
+            p5 = vlp[cc     ];
+            p6 = vlp[cc + w1];
+            p7 = vlp[cc + w2];
+            p8 = vlp[cc + w3];
+            p9 = vlp[cc + w4];
             mu = (p1 + p2 + p3 + p4 + p5 + p6 + p7 + p8 + p9) / 9.0f;
-            vx = 1e-7f + sqrf(p1 - mu) + sqrf(p2 - mu) + sqrf(p3 - mu) + sqrf(p4 - mu) + sqrf(p5 - mu) + sqrf(p6 - mu) + sqrf(p7 - mu) + sqrf(p8 - mu) + sqrf(p9 - mu);
-            p1 -= vdiff[-w4];
-            p2 -= vdiff[-w3];
-            p3 -= vdiff[-w2];
-            p4 -= vdiff[-w1];
-            p5 -= vdiff[  0];
-            p6 -= vdiff[ w1];
-            p7 -= vdiff[ w2];
-            p8 -= vdiff[ w3];
-            p9 -= vdiff[ w4];
-            vn = 1e-7f + sqrf(p1) + sqrf(p2) + sqrf(p3) + sqrf(p4) + sqrf(p5) + sqrf(p6) + sqrf(p7) + sqrf(p8) + sqrf(p9);
-            const float xv = (vdiff[0] * vx + vlp[0] * vn) / (vx + vn);
+            vx = 1e-7f + _sqrf(p1 - mu) + _sqrf(p2 - mu) + _sqrf(p3 - mu) + _sqrf(p4 - mu) + _sqrf(p5 - mu) + _sqrf(p6 - mu) + _sqrf(p7 - mu) + _sqrf(p8 - mu) + _sqrf(p9 - mu);
+            p1 -= vdiff[cc - w4];
+            p2 -= vdiff[cc - w3];
+            p3 -= vdiff[cc - w2];
+            p4 -= vdiff[cc - w1];
+            p5 -= vdiff[cc     ];
+            p6 -= vdiff[cc + w1];
+            p7 -= vdiff[cc + w2];
+            p8 -= vdiff[cc + w3];
+            p9 -= vdiff[cc + w4];
+            vn = 1e-7f + _sqrf(p1) + _sqrf(p2) + _sqrf(p3) + _sqrf(p4) + _sqrf(p5) + _sqrf(p6) + _sqrf(p7) + _sqrf(p8) + _sqrf(p9);
+            const float xv = (vdiff[cc] * vx + vlp[cc] * vn) / (vx + vn);
             const float vv = vx * vn / (vx + vn);
             // interpolated G-R(B)
-            interp[0] = (xh * vv + xv * vh) / (vh + vv);
+            interp[cc] = (xh * vv + xv * vh) / (vh + vv);
           }
         }
 
         // copy CFA values
         for(int rr = 0, row_in = rowStart - BORDER_AROUND; rr < last_rr; rr++, row_in++)
         {
-          for(int cc = 0, col_in = colStart - BORDER_AROUND; cc < last_cc; cc++, col_in++)
+          const gboolean row_inside = (row_in >= 0) && (row_in < height);
+          const float *cfa = qix[5] + rr * DT_LMMSE_TILESIZE;
+          float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE;
+          const float *interp = qix[4] + rr * DT_LMMSE_TILESIZE;
+          // the colour sites of a row alternate, handle each with its own contiguous writes
+          for(int c0 = 0; c0 < 2; c0++)
           {
-            const int c = FC(rr, cc, filters);
-            const gboolean inside = ((row_in >= 0) && (row_in < height) && (col_in >= 0) && (col_in < width));
-            float *colc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
-            colc[0] = (inside) ? qix[5][rr * DT_LMMSE_TILESIZE + cc] : 0.0f;
-            if(c != 1)
+            const int c = FC(rr, c0, filters);
+            float *colc = qix[c] + rr * DT_LMMSE_TILESIZE;
+            DT_OMP_SIMD()
+            for(int cc = c0; cc < last_cc; cc += 2)
             {
-              float *col1   = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
-              float *interp = qix[4] + rr * DT_LMMSE_TILESIZE + cc;
-              col1[0] = (inside) ? colc[0] + interp[0] : 0.0f;
+              const int col_in = colStart - BORDER_AROUND + cc;
+              const gboolean inside = row_inside && (col_in >= 0) && (col_in < width);
+              colc[cc] = (inside) ? cfa[cc] : 0.0f;
+              if(c != 1) col1[cc] = (inside) ? colc[cc] + interp[cc] : 0.0f;
             }
           }
         }
@@ -371,107 +429,47 @@ static void lmmse_demosaic(float *const restrict out,
             for(int c = 0; c < 3; c += 2)
             {
               const int d = c + 3 - (c == 0 ? 0 : 1);
+              float *corr = qix[d] + rr * DT_LMMSE_TILESIZE;
+              const float *colc = qix[c] + rr * DT_LMMSE_TILESIZE;
+              const float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE;
+              DT_OMP_SIMD()
               for(int cc = 1; cc < last_cc - 1; cc++)
               {
-                float *corr = qix[d] + rr * DT_LMMSE_TILESIZE + cc;
-                float *colc = qix[c] + rr * DT_LMMSE_TILESIZE + cc;
-                float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE + cc;
-                // Assign 3x3 differential color values
-                const float p[9] __attribute__((aligned(16))) =
-                                  { colc[-w1-1] - col1[-w1-1],
-                                    colc[-w1  ] - col1[-w1  ],
-                                    colc[-w1+1] - col1[-w1+1],
-                                    colc[   -1] - col1[   -1],
-                                    colc[    0] - col1[    0],
-                                    colc[    1] - col1[    1],
-                                    colc[ w1-1] - col1[ w1-1],
-                                    colc[ w1  ] - col1[ w1  ],
-                                    colc[ w1+1] - col1[ w1+1]};
-                corr[0] = median9f(p);
+                // 3x3 differential color values
+                corr[cc] = _median9f(colc[cc - w1 - 1] - col1[cc - w1 - 1],
+                                     colc[cc - w1    ] - col1[cc - w1    ],
+                                     colc[cc - w1 + 1] - col1[cc - w1 + 1],
+                                     colc[cc      - 1] - col1[cc      - 1],
+                                     colc[cc         ] - col1[cc         ],
+                                     colc[cc      + 1] - col1[cc      + 1],
+                                     colc[cc + w1 - 1] - col1[cc + w1 - 1],
+                                     colc[cc + w1    ] - col1[cc + w1    ],
+                                     colc[cc + w1 + 1] - col1[cc + w1 + 1]);
               }
             }
           }
 
-          // red/blue at GREEN pixel locations & red/blue and green at BLUE/RED pixel locations
+          // red/blue at GREEN pixel locations & red/blue and green at BLUE/RED pixel locations.
+          // all reads and writes are at the pixel itself so both site types are handled in one loop.
           for(int rr = rrmin; rr < rrmax - 1; rr++)
           {
-            float *col0 = qix[0] + rr * DT_LMMSE_TILESIZE + ccmin;
-            float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE + ccmin;
-            float *col2 = qix[2] + rr * DT_LMMSE_TILESIZE + ccmin;
-            float *corr3 = qix[3] + rr * DT_LMMSE_TILESIZE + ccmin;
-            float *corr4 = qix[4] + rr * DT_LMMSE_TILESIZE + ccmin;
-            int c0 = FC(rr, 0, filters);
-            int c1 = FC(rr, 1, filters);
-
-            if(c0 == 1)
-            {
-              c1 = 2 - c1;
-              const int d = c1 + 3 - (c1 == 0 ? 0 : 1);
-              int cc;
-              float *col_c1 = qix[c1] + rr * DT_LMMSE_TILESIZE + ccmin;
-              float *corr_d = qix[d] + rr * DT_LMMSE_TILESIZE + ccmin;
-              for(cc = ccmin; cc < ccmax - 1; cc += 2)
-              {
-                col0[0] = col1[0] + corr3[0];
-                col2[0] = col1[0] + corr4[0];
-                col0++;
-                col1++;
-                col2++;
-                corr3++;
-                corr4++;
-                col_c1++;
-                corr_d++;
-                col_c1[0] = col1[0] + corr_d[0];
-                col1[0] = 0.5f * (col0[0] - corr3[0] + col2[0] - corr4[0]);
-                col0++;
-                col1++;
-                col2++;
-                corr3++;
-                corr4++;
-                col_c1++;
-                corr_d++;
-              }
-
-              if(cc < ccmax)
-              { // remaining pixel, only if width is odd
-                col0[0] = col1[0] + corr3[0];
-                col2[0] = col1[0] + corr4[0];
-              }
-            }
-            else
+            float *col0 = qix[0] + rr * DT_LMMSE_TILESIZE;
+            float *col1 = qix[1] + rr * DT_LMMSE_TILESIZE;
+            float *col2 = qix[2] + rr * DT_LMMSE_TILESIZE;
+            const float *corr3 = qix[3] + rr * DT_LMMSE_TILESIZE;
+            const float *corr4 = qix[4] + rr * DT_LMMSE_TILESIZE;
+            // parity of the green columns and the colour of the other sites in this row
+            const int gpar = FC(rr, 0, filters) == 1 ? 0 : 1;
+            const int crow = FC(rr, 1 - gpar, filters);
+            DT_OMP_SIMD()
+            for(int cc = ccmin; cc < ccmax; cc++)
             {
-              c0 = 2 - c0;
-              const int d = c0 + 3 - (c0 == 0 ? 0 : 1);
-              float *col_c0 = qix[c0] + rr * DT_LMMSE_TILESIZE + ccmin;
-              float *corr_d = qix[d] + rr * DT_LMMSE_TILESIZE + ccmin;
-              int cc;
-              for(cc = ccmin; cc < ccmax - 1; cc += 2)
-              {
-                col_c0[0] = col1[0] + corr_d[0];
-                col1[0] = 0.5f * (col0[0] - corr3[0] + col2[0] - corr4[0]);
-                col0++;
-                col1++;
-                col2++;
-                corr3++;
-                corr4++;
-                col_c0++;
-                corr_d++;
-                col0[0] = col1[0] + corr3[0];
-                col2[0] = col1[0] + corr4[0];
-                col0++;
-                col1++;
-                col2++;
-                corr3++;
-                corr4++;
-                col_c0++;
-                corr_d++;
-             }
-
-              if(cc < ccmax)
-              { // remaining pixel, only if width is odd
-                col_c0[0] = col1[0] + corr_d[0];
-                col1[0] = 0.5f * (col0[0] - corr3[0] + col2[0] - corr4[0]);
-              }
+              const gboolean green = (cc & 1) == gpar;
+              const float r = (green || crow == 2) ? col1[cc] + corr3[cc] : col0[cc];
+              const float b = (green || crow == 0) ? col1[cc] + corr4[cc] : col2[cc];
+              col1[cc] = green ? col1[cc] : 0.5f * (r - corr3[cc] + b - corr4[cc]);
+              col0[cc] = r;
+              col2[cc] = b;
             }
           }
         }
@@ -479,11 +477,13 @@ static void lmmse_demosaic(float *const restrict out,
         // we fill the non-approximated color channels from gamma corrected cfa data
         for(int rrr = 4; rrr < last_rr - 4; rrr++)
         {
-          for(int ccc = 4; ccc < last_cc - 4; ccc++)
+          const float *cfa = qix[5] + rrr * DT_LMMSE_TILESIZE;
+          for(int c0 = 4; c0 < 6; c0++)
           {
-            const int idx = rrr * DT_LMMSE_TILESIZE + ccc;
-            const int c = FC(rrr, ccc, filters);
-            qix[c][idx] = qix[5][idx];
+            float *colc = qix[FC(rrr, c0, filters)] + rrr * DT_LMMSE_TILESIZE;
+            DT_OMP_SIMD()
+            for(int ccc = c0; ccc < last_cc - 4; ccc += 2)
+              colc[ccc] = cfa[ccc];
           }
         }
 
@@ -552,15 +552,31 @@ static void lmmse_demosaic(float *const restrict out,
         {
           float *dest = out + 4 * (row * width + first_horizontal);
           const int idx = rr * DT_LMMSE_TILESIZE + first_horizontal - colStart + BORDER_AROUND;
-          float *col0 = qix[0] + idx;
-          float *col1 = qix[1] + idx;
-          float *col2 = qix[2] + idx;
-          for(int col = first_horizontal; col < last_horizontal; col++, dest +=4, col0++, col1++, col2++)
+          const float *col0 = qix[0] + idx;
+          const float *col1 = qix[1] + idx;
+          const float *col2 = qix[2] + idx;
+          const float *gamma = lmmse_gamma_out;
+          if(gamma)
+          {
+            // the table check is hoisted out of the row so the gamma lookups vectorize
+            DT_OMP_SIMD()
+            for(int col = 0; col < last_horizontal - first_horizontal; col++)
+            {
+              dest[4 * col + 0] = scaler * _gamma_lookup(col0[col], gamma);
+              dest[4 * col + 1] = scaler * _gamma_lookup(col1[col], gamma);
+              dest[4 * col + 2] = scaler * _gamma_lookup(col2[col], gamma);
+              dest[4 * col + 3] = 0.0f;
+            }
+          }
+          else
           {
-            dest[0] = scaler * _calc_gamma(col0[0], lmmse_gamma_out);
-            dest[1] = scaler * _calc_gamma(col1[0], lmmse_gamma_out);
-            dest[2] = scaler * _calc_gamma(col2[0], lmmse_gamma_out);
-            dest[3] = 0.0f;
+            for(int col = 0; col < last_horizontal - first_horizontal; col++)
+            {
+              dest[4 * col + 0] = scaler * col0[col];
+              dest[4 * col + 1] = scaler * col1[col];
+              dest[4 * col + 2] = scaler * col2[col];
+              dest[4 * col + 3] = 0.0f;
+            }
           }
         }
       }
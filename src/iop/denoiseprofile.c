@@ -22,6 +22,7 @@
 #include "common/nlmeans_core.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
+#include "common/wavelet.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
@@ -848,7 +849,7 @@ void tiling_callback(dt_iop_module_t *self,
 
     const int max_filter_radius = (1u << max_scale); // 2 * 2^max_scale
 
-    tiling->factor = 5.0f; // in + out + precond + tmp + reducebuffer
+    tiling->factor = 4.0f; // in + out + precond + tmp
     tiling->factor_cl = 3.5f + max_scale; // in + out + tmp + reducebuffer + scale buffers
     tiling->maxbuf = 1.0f;
     tiling->maxbuf_cl = 1.0f;
@@ -1380,7 +1381,7 @@ static void process_wavelets(dt_iop_module_t *self,
                              const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out,
                              const eaw_dn_decompose_t decompose,
-                             const eaw_synthesize_t synthesize)
+                             const eaw_dn_synthesize_t synthesize)
 {
   // this is called for preview and full pipe separately, each with
   // its own pixelpipe piece.  get our data struct:
@@ -1422,11 +1423,12 @@ static void process_wavelets(dt_iop_module_t *self,
     return;
   }
 
-  float *buf = NULL;
   float *restrict precond = NULL;
   float *restrict tmp = NULL;
 
-  if(!dt_iop_alloc_image_buffers(self, roi_in, roi_out, 4, &precond, 4, &tmp, 4, &buf, 0, NULL))
+  // two scales are all that is needed: each detail band is consumed as
+  // soon as its coarse scale exists and is never stored
+  if(!dt_wavelet_alloc_buffers(self, 4 * npixels, &precond, &tmp, NULL))
   {
     dt_iop_copy_image_roi(out, in, piece->colors, roi_in, roi_out);
     return;
@@ -1514,15 +1516,14 @@ static void process_wavelets(dt_iop_module_t *self,
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
     dt_aligned_pixel_t sum_y2;
-    decompose(buf2, buf1, buf, sum_y2,
+    decompose(buf2, buf1, sum_y2,
               scale, 1.0f / (sigma_band * sigma_band), width, height);
     debug_dump_PFM(piece, "coarse_%d", buf2, width, height, scale);
-    debug_dump_PFM(piece, "detail_%d", buf, width, height, scale);
 
     const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
     dt_aligned_pixel_t thrs;
     variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
-    synthesize(out, out, buf, thrs, boost, width, height);
+    synthesize(out, buf1, buf2, thrs, boost, width, height);
 
     float *buf3 = buf2;
     buf2 = buf1;
@@ -1549,9 +1550,8 @@ static void process_wavelets(dt_iop_module_t *self,
                          p, d->b[1], d->bias - 0.5 * logf(in_scale), wb, toRGB_trans);
   }
 
-  dt_free_align(buf);
-  dt_free_align(tmp);
-  dt_free_align(precond);
+  dt_wavelet_free(tmp);
+  dt_wavelet_free(precond);
 
 #undef MAX_MAX_SCALE
 }
@@ -2727,7 +2727,7 @@ void process(dt_iop_module_t *self,
   else if(d->mode == MODE_WAVELETS
           || d->mode == MODE_WAVELETS_AUTO)
     process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out,
-                     eaw_dn_decompose, eaw_synthesize);
+                     eaw_dn_decompose, eaw_dn_synthesize);
   else
     process_variance(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
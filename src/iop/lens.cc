@@ -53,6 +53,8 @@
 
 #define MAXKNOTS 16
 #define VIGSPLINES 512
+// output pixels sampled at once by the metadata correction
+#define LENS_MD_SPAN 128
 
 G_BEGIN_DECLS
 
@@ -1041,6 +1043,26 @@ static float _get_autoscale_lf(dt_iop_module_t *self,
   return scale;
 }
 
+// Moves the subpixel coordinates of a row from lensfun into the input buffer
+// for sampling. Coordinates failing the nan checks are put outside, so their
+// samples are zero.
+static void _clip_subpixel_coords(float *xy,
+                                  const int width,
+                                  const dt_iop_roi_t *const roi_in,
+                                  const gboolean do_nan_checks)
+{
+  for(int k = 0; k < 3 * width; k++, xy += 2)
+  {
+    if(do_nan_checks && (!isfinite(xy[0]) || !isfinite(xy[1])))
+    {
+      xy[0] = xy[1] = -1.0f;
+      continue;
+    }
+    xy[0] = fmaxf(fminf(xy[0] - roi_in->x, roi_in->width - 1.0f), 0.0f);
+    xy[1] = fmaxf(fminf(xy[1] - roi_in->y, roi_in->height - 1.0f), 0.0f);
+  }
+}
+
 static void _process_lf(dt_iop_module_t *self,
                         dt_dev_pixelpipe_iop_t *piece,
                         const void *const ivoid,
@@ -1106,54 +1128,20 @@ static void _process_lf(dt_iop_module_t *self,
         modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y,
                                                   roi_out->width, 1, bufptr);
 
+        _clip_subpixel_coords(bufptr, roi_out->width, roi_in, d->do_nan_checks);
+
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
-        for(int x = 0; x < roi_out->width; x++, bufptr += 6, out += ch)
-        {
-          for(int c = 0; c < 3; c++)
-          {
-            if(d->do_nan_checks
-               && (!isfinite(bufptr[c * 2])
-                   || !isfinite(bufptr[c * 2 + 1])))
-            {
-              out[c] = 0.0f;
-              continue;
-            }
-
-            const float *const inptr = (const float *const)ivoid + (size_t)c;
-            const float pi0 = fmaxf(fminf(bufptr[c * 2] - roi_in->x,
-                                          roi_in->width - 1.0f), 0.0f);
-            const float pi1 = fmaxf(fminf(bufptr[c * 2 + 1] - roi_in->y,
-                                          roi_in->height - 1.0f),
-                                    0.0f);
-            out[c] = dt_interpolation_compute_sample(interpolation, inptr,
-                                                     pi0, pi1,
-                                                     roi_in->width, roi_in->height, ch, ch_width);
-          }
-
-          if(mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
-          {
-            if(d->do_nan_checks
-               && (!isfinite(bufptr[2])
-                   || !isfinite(bufptr[3])))
-            {
-              out[3] = 0.0f;
-              continue;
-            }
-
-            // take green channel distortion also for alpha channel
-            const float *const inptr = (const float *const)ivoid + (size_t)3;
-            const float pi0 = fmaxf(fminf(bufptr[2] - roi_in->x,
-                                          roi_in->width - 1.0f),
-                                    0.0f);
-            const float pi1 = fmaxf(fminf(bufptr[3] - roi_in->y,
-                                          roi_in->height - 1.0f),
-                                    0.0f);
-            out[3] = dt_interpolation_compute_sample(interpolation, inptr,
-                                                     pi0, pi1,
-                                                     roi_in->width, roi_in->height, ch, ch_width);
-          }
-        }
+        for(int c = 0; c < 3; c++)
+          dt_interpolation_compute_samples(interpolation, (const float *)ivoid + c, out + c, ch,
+                                           bufptr + 2 * c, 6, roi_out->width,
+                                           roi_in->width, roi_in->height, ch, ch_width);
+
+        // take green channel distortion also for alpha channel
+        if(mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
+          dt_interpolation_compute_samples(interpolation, (const float *)ivoid + 3, out + 3, ch,
+                                           bufptr + 2, 6, roi_out->width,
+                                           roi_in->width, roi_in->height, ch, ch_width);
       }
       dt_free_align(buf);
     }
@@ -1217,54 +1205,20 @@ static void _process_lf(dt_iop_module_t *self,
                                                   roi_out->y + y,
                                                   roi_out->width,
                                                   1, buf2ptr);
+        _clip_subpixel_coords(buf2ptr, roi_out->width, roi_in, d->do_nan_checks);
+
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
-        for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
-        {
-          for(int c = 0; c < 3; c++)
-          {
-            if(d->do_nan_checks
-               && (!isfinite(buf2ptr[c * 2])
-                   || !isfinite(buf2ptr[c * 2 + 1])))
-            {
-              out[c] = 0.0f;
-              continue;
-            }
-
-            float *bufptr = ((float *)buf) + c;
-            const float pi0 = fmaxf(fminf(buf2ptr[c * 2] - roi_in->x,
-                                          roi_in->width - 1.0f), 0.0f);
-            const float pi1 = fmaxf(fminf(buf2ptr[c * 2 + 1] - roi_in->y,
-                                          roi_in->height - 1.0f), 0.0f);
-            out[c] = dt_interpolation_compute_sample(interpolation, bufptr,
-                                                     pi0, pi1,
-                                                     roi_in->width, roi_in->height, ch, ch_width);
-          }
-
-          if(mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
-          {
-            if(d->do_nan_checks
-               && (!isfinite(buf2ptr[2])
-                   || !isfinite(buf2ptr[3])))
-            {
-              out[3] = 0.0f;
-              continue;
-            }
-
-            // take green channel distortion also for alpha channel
-            float *bufptr = ((float *)buf) + 3;
-            const float pi0 = fmaxf(fminf(buf2ptr[2] - roi_in->x,
-                                          roi_in->width - 1.0f), 0.0f);
-            const float pi1 = fmaxf(fminf(buf2ptr[3] - roi_in->y,
-                                          roi_in->height - 1.0f), 0.0f);
-            out[3] = dt_interpolation_compute_sample(interpolation,
-                                                     bufptr, pi0, pi1,
-                                                     roi_in->width,
-                                                     roi_in->height,
-                                                     ch,
-                                                     ch_width);
-          }
-        }
+        for(int c = 0; c < 3; c++)
+          dt_interpolation_compute_samples(interpolation, (float *)buf + c, out + c, ch,
+                                           buf2ptr + 2 * c, 6, roi_out->width,
+                                           roi_in->width, roi_in->height, ch, ch_width);
+
+        // take green channel distortion also for alpha channel
+        if(mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK)
+          dt_interpolation_compute_samples(interpolation, (float *)buf + 3, out + 3, ch,
+                                           buf2ptr + 2, 6, roi_out->width,
+                                           roi_in->width, roi_in->height, ch, ch_width);
       }
       dt_free_align(buf2);
     }
@@ -2792,29 +2746,38 @@ static void _process_md(dt_iop_module_t *self,
 
   const float limw = roi_in->width - 1;
   const float limh = roi_in->height - 1;
-  DT_OMP_FOR(collapse(2))
+
+  DT_OMP_FOR()
   for(int y = 0; y < roi_out->height; y++)
   {
-    for(int x = 0; x < roi_out->width; x++)
+    // input coordinates of the four channels of a span of the row
+    float DT_ALIGNED_ARRAY xy[8 * LENS_MD_SPAN];
+    const float cy = (roi_out->y + y - h2) * inv_scale_md;
+    for(int x0 = 0; x0 < roi_out->width; x0 += LENS_MD_SPAN)
     {
-      const size_t odx = 4 * (y * roi_out->width + x);
-      const float cx = (roi_out->x + x - w2) * inv_scale_md;
-      const float cy = (roi_out->y + y - h2) * inv_scale_md;
+      const int n = MIN(LENS_MD_SPAN, roi_out->width - x0);
+      for(int x = 0; x < n; x++)
+      {
+        const float cx = (roi_out->x + x0 + x - w2) * inv_scale_md;
 
-      const float radius = r*sqrtf(cx*cx + cy*cy);
+        const float radius = r*sqrtf(cx*cx + cy*cy);
 
-      for_each_channel(c)
-      {
-        // use green data for alpha channel
-        const int plane = (c == 3 || pass_mode) ? 1 : c;
-        const float dr =
-          _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
-        const float xs = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
-        const float ys = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
-        out[odx+c] = dt_interpolation_compute_sample(interpolation, buf + c,
-                                                     xs, ys,
-                                                     roi_in->width, roi_in->height, 4, 4*roi_in->width);
+        for_each_channel(c)
+        {
+          // use green data for alpha channel
+          const int plane = (c == 3 || pass_mode) ? 1 : c;
+          const float dr =
+            _interpolate_linear_spline(d->knots_dist, d->cor_rgb[plane], d->nc, radius);
+          xy[8 * x + 2 * c] = CLAMP(dr*cx + w2 - roi_in->x, 0.0f, limw);
+          xy[8 * x + 2 * c + 1] = CLAMP(dr*cy + h2 - roi_in->y, 0.0f, limh);
+        }
       }
+
+      float *const row = out + (size_t)4 * ((size_t)y * roi_out->width + x0);
+      for(int c = 0; c < 4; c++)
+        dt_interpolation_compute_samples(interpolation, buf + c, row + c, 4,
+                                         xy + 2 * c, 8, n,
+                                         roi_in->width, roi_in->height, 4, 4*roi_in->width);
     }
   }
 
@@ -44,6 +44,7 @@
 DT_MODULE_INTROSPECTION(1, dt_iop_liquify_params_t)
 
 #define MAX_NODES 100 // max of nodes in one instance
+#define WARP_SPAN 256  // warped points sampled together
 
 const int   LOOKUP_OVERSAMPLE = 10;
 const int   INTERPOLATION_POINTS = 100; // when interpolating bezier
@@ -1034,27 +1035,40 @@ static void _apply_global_distortion_map(dt_iop_module_t *self,
     const size_t max_x = MIN(roi_out->x + roi_out->width, extent->x + extent->width);
     const float complex *row = map + (y - extent->y) * extent->width + (min_x - extent->x);
     float* out_sample = out + ch * ((y - roi_out->y) * roi_out->width - roi_out->x);
-    for(size_t x = min_x; x < max_x; x++)
+    if(ch == 1) // handle masks
     {
-      if(*row != 0) // point actually warped?
+      for(size_t x = min_x; x < max_x; x++)
       {
-        if(ch == 1) // handle masks
+        if(*row != 0) // point actually warped?
           out_sample[x] = CLIP(dt_interpolation_compute_sample(interpolation, in,
                                                                x + crealf(*row) - roi_in->x, y + cimagf(*row) - roi_in->y,
                                                                roi_in->width, roi_in->height, 1, ch_width));
-        else
-          dt_interpolation_compute_pixel4c(
-            interpolation,
-            in,
-            out_sample + ch*x,
-            x + crealf(*row) - roi_in->x,
-            y + cimagf(*row) - roi_in->y,
-            roi_in->width,
-            roi_in->height,
-            ch_width);
+        ++row;
+      }
+    }
+    else
+    {
+      // input coordinates of a run of warped points, sampled together
+      float DT_ALIGNED_ARRAY xy[2 * WARP_SPAN];
+      size_t x = min_x;
+      while(x < max_x)
+      {
+        // skip the points which are not warped
+        for(; x < max_x && *row == 0; x++)
+          ++row;
 
+        const size_t first = x;
+        size_t n = 0;
+        for(; x < max_x && *row != 0 && n < WARP_SPAN; x++, n++)
+        {
+          xy[2 * n] = x + crealf(*row) - roi_in->x;
+          xy[2 * n + 1] = y + cimagf(*row) - roi_in->y;
+          ++row;
+        }
+        if(n)
+          dt_interpolation_compute_pixels4c(interpolation, in, out_sample + ch * first, xy, n,
+                                            roi_in->width, roi_in->height, ch_width);
       }
-      ++row;
     }
   }
 }
@@ -25,6 +25,7 @@
 #include "common/heal.h"
 #include "common/imagebuf.h"
 #include "common/opencl.h"
+#include "common/wavelet.h"
 #include "develop/blend.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
@@ -3786,7 +3787,7 @@ void process(dt_iop_module_t *self,
 
   // we will do all the clone, heal, etc on the input image,
   // this way the source for one algorithm can be the destination from a previous one
-  in_retouch = dt_alloc_align_float((size_t)4 * roi_rt->width * roi_rt->height);
+  in_retouch = dt_wavelet_alloc((size_t)4 * roi_rt->width * roi_rt->height);
   if(in_retouch == NULL)
   {
     dt_print(DT_DEBUG_ALWAYS,"[retouch] out of memory");
@@ -3894,7 +3895,7 @@ void process(dt_iop_module_t *self,
   rt_copy_in_to_out(in_retouch, roi_rt, ovoid, roi_out, 4, 0, 0);
 
 cleanup:
-  dt_free_align(in_retouch);
+  dt_wavelet_free(in_retouch);
   dt_dwt_free(dwt_p);
 }
 
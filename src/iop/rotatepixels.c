@@ -272,42 +272,54 @@ void modify_roi_in(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const d
   roi_in->height = CLAMP(roi_in->height, 1, (int)ceilf(orig_h) - roi_in->y);
 }
 
-// 3rd (final) pass: you get this input region (may be different from what was requested above),
-// do your best to fill the output region!
-void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
-             const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+typedef struct _process_map_t
+{
+  const dt_dev_pixelpipe_iop_t *piece;
+  const dt_iop_roi_t *roi_in;
+  const dt_iop_roi_t *roi_out;
+  float scale;
+} _process_map_t;
+
+// input coordinates of a span of an output row for dt_interpolation_warp4c()
+static void _process_map(float *xy,
+                         const int row,
+                         const int col,
+                         const int width,
+                         void *data)
 {
-  const int ch = piece->colors;
-  const int ch_width = ch * roi_in->width;
+  const _process_map_t *m = (const _process_map_t *)data;
 
-  const float scale = roi_in->scale / piece->iscale;
+  // point-by-point transformation.
+  // TODO: optimize with scanlines and linear steps between?
+  for(int i = 0; i < width; i++, xy += 2)
+  {
+    float pi[2];
 
-  assert(ch == 4);
+    pi[0] = m->roi_out->x + col + i;
+    pi[1] = m->roi_out->y + row;
 
-  const dt_interpolation_t *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
+    backtransform(m->piece, m->scale, pi, xy);
 
-  DT_OMP_FOR()
-  // (slow) point-by-point transformation.
-  // TODO: optimize with scanlines and linear steps between?
-  for(int j = 0; j < roi_out->height; j++)
-  {
-    float *out = ((float *)ovoid) + (size_t)ch * j * roi_out->width;
-    for(int i = 0; i < roi_out->width; i++, out += ch)
-    {
-      float pi[2], po[2];
+    xy[0] -= m->roi_in->x;
+    xy[1] -= m->roi_in->y;
+  }
+}
 
-      pi[0] = roi_out->x + i;
-      pi[1] = roi_out->y + j;
+// 3rd (final) pass: you get this input region (may be different from what was requested above),
+// do your best to fill the output region!
+void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
+             const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  assert(piece->colors == 4);
 
-      backtransform(piece, scale, pi, po);
+  const dt_interpolation_t *interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
-      po[0] -= roi_in->x;
-      po[1] -= roi_in->y;
+  const _process_map_t map = { .piece = piece, .roi_in = roi_in, .roi_out = roi_out,
+                               .scale = roi_in->scale / piece->iscale };
 
-      dt_interpolation_compute_pixel4c(interpolation, (float *)ivoid, out, po[0], po[1], roi_in->width,
-                                       roi_in->height, ch_width);
-    }
-  }
+  dt_interpolation_warp4c(interpolation, (float *)ovoid, roi_out->width, roi_out->height,
+                          (const float *)ivoid, roi_in->width, roi_in->height,
+                          _process_map, (void *)&map);
 }
 
 void commit_params(dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
@@ -0,0 +1,170 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// contention benchmark for dt_cache_t: many threads hammering one cache
+// with a skewed key distribution, the way thumbnail workers hit the mipmap
+// and image caches while the lighttable scrolls. every entry carries its
+// key, so a lookup returning the wrong entry or a lost write shows up as a
+// failure, not just as a number.
+//
+// usage: darktable-bench-cache [threads] [keys] [quota] [ops per thread]
+
+#include "common/cache.h"
+#include "common/darktable.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef struct bench_payload_t
+{
+  uint32_t key;
+  uint32_t writes;
+} bench_payload_t;
+
+typedef struct bench_thread_t
+{
+  dt_cache_t *cache;
+  GThread *thread;
+  uint32_t seed;
+  uint32_t keys;
+  int ops;
+  int errors;
+  int misses;
+} bench_thread_t;
+
+static void _allocate(void *data, dt_cache_entry_t *entry)
+{
+  entry->data_size = sizeof(bench_payload_t);
+  entry->data = g_malloc(entry->data_size);
+  bench_payload_t *payload = entry->data;
+  payload->key = entry->key;
+  payload->writes = 0;
+  entry->cost = 1;
+  int *misses = data;
+  g_atomic_int_inc(misses);
+}
+
+static void _cleanup(void *data, dt_cache_entry_t *entry)
+{
+  g_free(entry->data);
+}
+
+static inline uint32_t _xorshift(uint32_t *state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+// most accesses go to a small hot set (the visible page), the rest
+// anywhere in the collection
+static inline uint32_t _pick_key(uint32_t *state, const uint32_t keys)
+{
+  const uint32_t r = _xorshift(state);
+  const uint32_t hot = MAX(keys / 64, 1);
+  return (r & 7) ? r % hot : r % keys;
+}
+
+static gpointer _worker(gpointer data)
+{
+  bench_thread_t *t = data;
+  for(int k = 0; k < t->ops; k++)
+  {
+    const uint32_t key = _pick_key(&t->seed, t->keys);
+    const char mode = (k & 15) == 0 ? 'w' : 'r';
+    dt_cache_entry_t *entry = dt_cache_get(t->cache, key, mode);
+    bench_payload_t *payload = entry->data;
+    if(entry->key != key || payload->key != key) t->errors++;
+    if(mode == 'w') payload->writes++;
+    dt_cache_release(t->cache, entry);
+
+    if((k & 1023) == 0) dt_cache_remove(t->cache, _pick_key(&t->seed, t->keys));
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  const int threads = argc > 1 ? atoi(argv[1]) : 16;
+  const uint32_t keys = argc > 2 ? (uint32_t)atoi(argv[2]) : 100000;
+  const size_t quota = argc > 3 ? (size_t)atoll(argv[3]) : keys / 4;
+  const int ops = argc > 4 ? atoi(argv[4]) : 1000000;
+
+  dt_cache_t cache;
+  int misses = 0;
+  dt_cache_init(&cache, 0, quota);
+  dt_cache_set_allocate_callback(&cache, _allocate, &misses);
+  dt_cache_set_cleanup_callback(&cache, _cleanup, NULL);
+
+  bench_thread_t *t = g_new0(bench_thread_t, threads);
+  const double start = dt_get_wtime();
+  for(int i = 0; i < threads; i++)
+  {
+    t[i].cache = &cache;
+    t[i].seed = 0x9e3779b9u * (i + 1);
+    t[i].keys = keys;
+    t[i].ops = ops;
+    t[i].thread = g_thread_new("bench", _worker, t + i);
+  }
+  int errors = 0;
+  for(int i = 0; i < threads; i++)
+  {
+    g_thread_join(t[i].thread);
+    errors += t[i].errors;
+  }
+  const double elapsed = dt_get_wtime() - start;
+
+  // every entry left must still be reachable under its own key
+  int lost = 0;
+  for(uint32_t key = 0; key < keys; key++)
+  {
+    dt_cache_entry_t *entry = dt_cache_testget(&cache, key, 'r');
+    if(!entry) continue;
+    if(((bench_payload_t *)entry->data)->key != key) lost++;
+    dt_cache_release(&cache, entry);
+  }
+
+  const double total = (double)threads * ops;
+  printf("[cache] %d threads, %u keys, quota %zu: %.0f ops in %.3fs, %.2f Mops/s, %.1f%% misses\n",
+         threads, keys, quota, total, elapsed, total / elapsed * 1e-6,
+         100.0 * misses / total);
+  printf("[cache] cost %zu of %zu after the run\n", cache.cost, cache.cost_quota);
+
+  dt_cache_cleanup(&cache);
+  g_free(t);
+
+  if(errors || lost)
+  {
+    printf("[cache] FAILED: %d wrong entries returned, %d entries under a wrong key\n", errors, lost);
+    return 1;
+  }
+  printf("[cache] passed\n");
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
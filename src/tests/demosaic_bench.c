@@ -0,0 +1,216 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for the bayer demosaicers used for export: AMaZE and LMMSE in
+// all its refinement modes, with box3 and RCD as points of reference. a
+// synthetic scene (zone plate, hard edges, smooth gradients, noise and
+// clipped highlights) is mosaiced with each of the four bayer layouts and
+// every demosaicer reports its throughput and its worst PSNR against the
+// scene. the quality checks are in unittests/iop/test_demosaic.c.
+//
+// usage: darktable-bench-demosaic [runs]
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "develop/imageop_math.h"
+#include "iop/demosaicing/demosaic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// only the cpu code paths are benchmarked, the opencl ones need the module
+#undef HAVE_OPENCL
+
+#include "iop/demosaicing/rcd.c"
+#include "iop/demosaicing/lmmse.c"
+
+// implemented in demosaicing/amaze.cc
+void amaze_demosaic(const float *const in,
+                    float *out,
+                    const int width,
+                    const int height,
+                    const uint32_t filters,
+                    const float procmin);
+
+#define BENCH_WIDTH 3000
+#define BENCH_HEIGHT 2000
+#define BENCH_BORDER 16
+
+typedef enum bench_algo_t
+{
+  BENCH_BOX3,
+  BENCH_RCD,
+  BENCH_LMMSE,
+  BENCH_AMAZE
+} bench_algo_t;
+
+typedef struct bench_case_t
+{
+  const char *name;
+  bench_algo_t algo;
+  dt_iop_demosaic_lmmse_t mode;
+} bench_case_t;
+
+static const bench_case_t _cases[] = {
+  { "box3", BENCH_BOX3, DT_LMMSE_REFINE_0 },
+  { "rcd", BENCH_RCD, DT_LMMSE_REFINE_0 },
+  { "lmmse-0", BENCH_LMMSE, DT_LMMSE_REFINE_0 },
+  { "lmmse-1", BENCH_LMMSE, DT_LMMSE_REFINE_1 },
+  { "lmmse-2", BENCH_LMMSE, DT_LMMSE_REFINE_2 },
+  { "lmmse-3", BENCH_LMMSE, DT_LMMSE_REFINE_3 },
+  { "lmmse-4", BENCH_LMMSE, DT_LMMSE_REFINE_4 },
+  { "amaze", BENCH_AMAZE, DT_LMMSE_REFINE_0 },
+};
+
+static const uint32_t _filters[] = { 0x94949494u, 0x16161616u, 0x61616161u, 0x49494949u };
+
+static float _random(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return (float)(*state >> 8) / 16777216.0f;
+}
+
+// left third a zone plate, middle third hard edged blocks, right third
+// smooth gradients. the bottom rows are pushed into clipping.
+static void _scene(float *rgb, const int width, const int height)
+{
+  uint32_t state = 0x12345678u;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      float *p = rgb + 4 * ((size_t)j * width + i);
+      const float x = (float)i / width;
+      const float y = (float)j / height;
+      const float zone = 0.5f + 0.5f * cosf(400.0f * (sqf(x - 0.5f) + sqf(y - 0.5f)));
+      const float edge = ((i / 97 + j / 61) & 1) ? 0.8f : 0.15f;
+      const float smooth = 0.5f + 0.45f * sinf(30.0f * y) * cosf(20.0f * x);
+      float base = x < 0.33f ? zone : (x < 0.66f ? edge : smooth);
+      if(y > 0.85f) base *= 1.4f;
+      const float noise = 0.03f * _random(&state);
+      p[0] = fminf(1.0f, base * (0.6f + 0.4f * y) + noise);
+      p[1] = fminf(1.0f, base * 0.9f + noise);
+      p[2] = fminf(1.0f, base * (0.4f + 0.5f * x) + noise);
+      p[3] = 0.0f;
+    }
+}
+
+static void _mosaic(float *cfa, const float *rgb, const int width, const int height, const uint32_t filters)
+{
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+      cfa[(size_t)j * width + i] = rgb[4 * ((size_t)j * width + i) + FC(j, i, filters)];
+}
+
+static double _psnr(const float *out, const float *rgb, const int width, const int height)
+{
+  double sum = 0.0;
+  size_t count = 0;
+  for(int j = BENCH_BORDER; j < height - BENCH_BORDER; j++)
+    for(int i = BENCH_BORDER; i < width - BENCH_BORDER; i++)
+      for(int c = 0; c < 3; c++)
+      {
+        const size_t k = 4 * ((size_t)j * width + i) + c;
+        sum += sqf(out[k] - rgb[k]);
+        count++;
+      }
+  return sum > 0.0 ? 10.0 * log10(count / sum) : 999.0;
+}
+
+static void _run(const bench_case_t *bc, float *out, const float *cfa, const int width, const int height,
+                 const uint32_t filters)
+{
+  switch(bc->algo)
+  {
+    case BENCH_BOX3:
+      demosaic_box3(out, cfa, width, height, filters, NULL);
+      break;
+    case BENCH_RCD:
+      rcd_demosaic(out, cfa, width, height, filters, 1.0f);
+      break;
+    case BENCH_LMMSE:
+      lmmse_demosaic(out, cfa, width, height, filters, bc->mode, 1.0f);
+      break;
+    case BENCH_AMAZE:
+      amaze_demosaic(cfa, out, width, height, filters, 1.0f);
+      break;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  const int runs = argc > 1 ? MAX(1, atoi(argv[1])) : 5;
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+  omp_set_num_threads(darktable.num_openmp_threads);
+#else
+  darktable.num_openmp_threads = 1;
+#endif
+
+  const int width = BENCH_WIDTH;
+  const int height = BENCH_HEIGHT;
+  const size_t npix = (size_t)width * height;
+  float *rgb = dt_alloc_align_float(4 * npix);
+  float *cfa = dt_alloc_align_float(npix);
+  float *out = dt_alloc_align_float(4 * npix);
+  if(!rgb || !cfa || !out)
+  {
+    printf("[demosaic] out of memory for %dx%d\n", width, height);
+    return 1;
+  }
+  _scene(rgb, width, height);
+
+  const int ncases = sizeof(_cases) / sizeof(_cases[0]);
+  for(int n = 0; n < ncases; n++)
+  {
+    const bench_case_t *bc = &_cases[n];
+    double time = 0.0;
+    double worst = 999.0;
+    for(int f = 0; f < 4; f++)
+    {
+      _mosaic(cfa, rgb, width, height, _filters[f]);
+      // the first call also sets up the lmmse gamma tables
+      _run(bc, out, cfa, width, height, _filters[f]);
+      const double start = dt_get_wtime();
+      for(int r = 0; r < runs; r++)
+        _run(bc, out, cfa, width, height, _filters[f]);
+      time += dt_get_wtime() - start;
+      worst = MIN(worst, _psnr(out, rgb, width, height));
+    }
+    printf("[demosaic] %-8s %dx%d: %8.2fms %7.1f Mpix/s, psnr %6.2f dB\n",
+           bc->name, width, height, 1e3 * time / (4 * runs), 4e-6 * runs * npix / time, worst);
+  }
+
+  _cleanup_lmmse_gamma();
+  dt_free_align(rgb);
+  dt_free_align(cfa);
+  dt_free_align(out);
+
+  return 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,193 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for dt_gaussian_blur() and dt_gaussian_blur_4c() against the
+// previous column by column implementation, kept here as the reference.
+// every run also compares the outputs, a deviation beyond float rounding
+// noise is reported as a failure.
+//
+// usage: darktable-bench-gaussian [runs]
+
+#include "common/darktable.h"
+#include "common/gaussian.h"
+#include "common/math.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// same coefficients as _compute_gauss_params() for order 0
+static void _reference_params(const float sigma,
+                              float *a0, float *a1, float *a2, float *a3,
+                              float *b1, float *b2, float *coefp, float *coefn)
+{
+  const float alpha = 1.695f / sigma;
+  const float ema = expf(-alpha);
+  const float ema2 = expf(-2.0f * alpha);
+  *b1 = -2.0f * ema;
+  *b2 = ema2;
+  const float k = (1.0f - ema) * (1.0f - ema) / (1.0f + (2.0f * alpha * ema) - ema2);
+  *a0 = k;
+  *a1 = k * (alpha - 1.0f) * ema;
+  *a2 = k * (alpha + 1.0f) * ema;
+  *a3 = -k * ema2;
+  *coefp = (*a0 + *a1) / (1.0f + *b1 + *b2);
+  *coefn = (*a2 + *a3) / (1.0f + *b1 + *b2);
+}
+
+// one line of the recursive filter, `stride` floats between samples
+static void _reference_line(const float *in, float *out, const size_t stride, const size_t len,
+                            const int ch, const float *min, const float *max, const float *c)
+{
+  for(int k = 0; k < ch; k++)
+  {
+    float xp = CLAMPF(in[k], min[k], max[k]);
+    float yb = xp * c[6];
+    float yp = yb;
+    for(size_t j = 0; j < len; j++)
+    {
+      const float xc = CLAMPF(in[j * stride + k], min[k], max[k]);
+      const float yc = (c[0] * xc) + (c[1] * xp) - (c[4] * yp) - (c[5] * yb);
+      out[j * stride + k] = yc;
+      xp = xc;
+      yb = yp;
+      yp = yc;
+    }
+    float xn = CLAMPF(in[(len - 1) * stride + k], min[k], max[k]);
+    float xa = xn;
+    float yn = xn * c[7];
+    float ya = yn;
+    for(size_t j = len; j > 0; j--)
+    {
+      const float xc = CLAMPF(in[(j - 1) * stride + k], min[k], max[k]);
+      const float yc = (c[2] * xn) + (c[3] * xa) - (c[4] * yn) - (c[5] * ya);
+      xa = xn;
+      xn = xc;
+      ya = yn;
+      yn = yc;
+      out[(j - 1) * stride + k] += yc;
+    }
+  }
+}
+
+static void _reference_blur(const float *in, float *temp, float *out, const int width, const int height,
+                            const int ch, const float *min, const float *max, const float sigma)
+{
+  float c[8];
+  _reference_params(sigma, c, c + 1, c + 2, c + 3, c + 4, c + 5, c + 6, c + 7);
+
+  DT_OMP_FOR()
+  for(int i = 0; i < width; i++)
+    _reference_line(in + (size_t)i * ch, temp + (size_t)i * ch, (size_t)width * ch, height, ch, min, max, c);
+
+  DT_OMP_FOR()
+  for(int j = 0; j < height; j++)
+    _reference_line(temp + (size_t)j * width * ch, out + (size_t)j * width * ch, ch, width, ch, min, max, c);
+}
+
+static void _fill(float *buf, const size_t n)
+{
+  uint32_t state = 0x12345678u;
+  for(size_t k = 0; k < n; k++)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    buf[k] = (float)(state & 0xffff) / 65535.0f;
+  }
+}
+
+static int _bench(const int width, const int height, const int ch, const float sigma, const int runs)
+{
+  const size_t n = (size_t)width * height * ch;
+  float *in = dt_alloc_align_float(n);
+  float *ref = dt_alloc_align_float(n);
+  float *tmp = dt_alloc_align_float(n);
+  float *out = dt_alloc_align_float(n);
+  const float min[4] = { -INFINITY, -INFINITY, -INFINITY, -INFINITY };
+  const float max[4] = { INFINITY, INFINITY, INFINITY, INFINITY };
+  dt_gaussian_t *g = dt_gaussian_init(width, height, ch, max, min, sigma, DT_IOP_GAUSSIAN_ZERO);
+  if(!in || !ref || !tmp || !out || !g)
+  {
+    printf("[gaussian] out of memory for %dx%d\n", width, height);
+    return 1;
+  }
+  _fill(in, n);
+
+  double t_ref = 0.0, t_new = 0.0;
+  for(int r = 0; r < runs; r++)
+  {
+    double start = dt_get_wtime();
+    _reference_blur(in, tmp, ref, width, height, ch, min, max, sigma);
+    t_ref += dt_get_wtime() - start;
+
+    start = dt_get_wtime();
+    if(ch == 4)
+      dt_gaussian_blur_4c(g, in, out);
+    else
+      dt_gaussian_blur(g, in, out);
+    t_new += dt_get_wtime() - start;
+  }
+
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < n; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(out[k] - ref[k]));
+
+  const gboolean failed = !(maxdiff <= 1e-5f);
+  printf("[gaussian] %5dx%-5d %dch sigma %5.1f: reference %8.2fms, blocked %8.2fms, %5.2fx, max diff %g%s\n",
+         width, height, ch, sigma, 1e3 * t_ref / runs, 1e3 * t_new / runs, t_ref / t_new, maxdiff,
+         failed ? " FAILED" : "");
+
+  dt_gaussian_free(g);
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(tmp);
+  dt_free_align(out);
+  return failed;
+}
+
+int main(int argc, char *argv[])
+{
+  const int runs = argc > 1 ? MAX(1, atoi(argv[1])) : 5;
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+  omp_set_num_threads(darktable.num_openmp_threads);
+#else
+  darktable.num_openmp_threads = 1;
+#endif
+
+  const int sizes[][2] = { { 640, 480 }, { 1920, 1080 }, { 4000, 3000 }, { 6000, 4000 } };
+  const int channels[] = { 1, 4 };
+  int failed = 0;
+  for(int s = 0; s < 4; s++)
+    for(int c = 0; c < 2; c++)
+      failed += _bench(sizes[s][0], sizes[s][1], channels[c], 8.0f, runs);
+  failed += _bench(4000, 3000, 2, 30.0f, runs);
+
+  printf("[gaussian] %s\n", failed ? "FAILED" : "passed");
+  return failed ? 1 : 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
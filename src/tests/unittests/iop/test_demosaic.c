@@ -0,0 +1,378 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the bayer demosaicers of iop/demosaic.c
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "../util/assert.h"
+#include "../util/tracing.h"
+
+#include "common/darktable.h"
+#include "common/math.h"
+#include "develop/imageop_math.h"
+#include "iop/demosaicing/demosaic.h"
+
+// only the cpu code paths are tested, the opencl ones need the module
+#undef HAVE_OPENCL
+
+#include "iop/demosaicing/rcd.c"
+#include "iop/demosaicing/lmmse.c"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// implemented in demosaicing/amaze.cc
+void amaze_demosaic(const float *const in,
+                    float *out,
+                    const int width,
+                    const int height,
+                    const uint32_t filters,
+                    const float procmin);
+
+/*
+ * DEFINITIONS
+ */
+
+#define SCENE_WIDTH 900
+#define SCENE_HEIGHT 600
+// pixels at the image border are not compared
+#define SCENE_BORDER 16
+// a result this far (dB) below the floor is a failure
+#define PSNR_TOLERANCE 0.05
+// the scene is cut in TILES_X x TILES_Y tiles for the comparison with the
+// output of the previous implementations
+#define TILES_X 4
+#define TILES_Y 3
+#define TILES (TILES_X * TILES_Y)
+// allowed deviation (dB) of a tile from the previous implementation. a
+// single pixel off by 0.5 in a tile moves it by about 0.1 dB.
+#define TILE_TOLERANCE 0.05
+
+// the four bayer layouts
+static const uint32_t filters[] = { 0x94949494u, 0x16161616u,
+                                    0x61616161u, 0x49494949u };
+
+typedef struct scene_t
+{
+  float *rgb;
+  float *cfa;
+  float *out;
+} scene_t;
+
+typedef enum algo_t
+{
+  ALGO_BOX3,
+  ALGO_RCD,
+  ALGO_LMMSE_0,
+  ALGO_LMMSE_1,
+  ALGO_LMMSE_2,
+  ALGO_LMMSE_3,
+  ALGO_LMMSE_4,
+  ALGO_AMAZE,
+  ALGO_COUNT
+} algo_t;
+
+static const char *algo_names[] = { "box3", "rcd", "lmmse-0", "lmmse-1",
+                                    "lmmse-2", "lmmse-3", "lmmse-4", "amaze" };
+
+// psnr (dB) per tile of the implementations before their row kernels were
+// vectorized, per demosaicer and bayer layout
+static const double reference[ALGO_COUNT][4][TILES] = {
+  // box3
+  {
+    { 31.57, 29.22, 28.50, 41.09, 36.77, 29.52, 28.29, 41.02, 28.15, 26.94, 26.60, 39.23 },
+    { 31.56, 29.22, 28.50, 41.09, 36.76, 29.52, 28.29, 41.02, 28.18, 26.93, 26.59, 39.23 },
+    { 31.57, 29.21, 28.49, 41.09, 36.74, 29.52, 28.29, 41.01, 28.14, 26.94, 26.60, 39.22 },
+    { 31.57, 29.22, 28.49, 41.09, 36.77, 29.52, 28.29, 41.01, 28.18, 26.95, 26.60, 39.21 }
+  },
+  // rcd
+  {
+    { 36.06, 39.93, 40.98, 43.78, 41.46, 41.31, 41.72, 43.69, 34.65, 38.85, 41.59, 43.78 },
+    { 36.06, 40.00, 40.97, 43.78, 41.45, 41.36, 41.71, 43.69, 34.61, 38.91, 41.56, 43.77 },
+    { 36.07, 39.98, 40.84, 43.77, 41.38, 41.37, 41.61, 43.65, 34.57, 38.89, 41.35, 43.73 },
+    { 36.07, 39.89, 40.86, 43.76, 41.36, 41.24, 41.59, 43.65, 34.60, 38.75, 41.33, 43.72 }
+  },
+  // lmmse-0
+  {
+    { 41.72, 42.46, 42.67, 47.51, 44.96, 43.41, 42.77, 47.50, 33.43, 38.42, 41.85, 47.31 },
+    { 41.76, 42.46, 42.59, 47.51, 44.95, 43.72, 42.89, 47.50, 33.50, 38.32, 42.11, 47.33 },
+    { 41.75, 41.43, 41.18, 47.53, 44.89, 42.34, 41.37, 47.42, 33.39, 37.79, 40.66, 47.20 },
+    { 41.75, 41.54, 41.14, 47.51, 44.89, 42.22, 41.44, 47.41, 33.50, 38.00, 40.81, 47.19 }
+  },
+  // lmmse-1
+  {
+    { 41.49, 42.82, 43.26, 48.55, 45.26, 43.95, 43.37, 48.54, 33.32, 38.12, 42.34, 48.25 },
+    { 41.52, 42.82, 43.17, 48.54, 45.24, 44.30, 43.53, 48.54, 33.42, 38.04, 42.65, 48.28 },
+    { 41.52, 41.79, 41.74, 48.56, 45.18, 42.91, 41.97, 48.44, 33.30, 37.55, 41.14, 48.13 },
+    { 41.50, 41.91, 41.70, 48.55, 45.19, 42.76, 42.06, 48.43, 33.42, 37.78, 41.33, 48.12 }
+  },
+  // lmmse-2
+  {
+    { 40.66, 43.07, 43.99, 49.98, 45.28, 44.59, 44.19, 50.07, 32.95, 37.68, 43.01, 49.61 },
+    { 40.68, 43.04, 43.88, 49.98, 45.28, 44.97, 44.40, 50.06, 33.04, 37.62, 43.40, 49.66 },
+    { 40.67, 42.07, 42.45, 49.99, 45.21, 43.59, 42.78, 49.94, 32.91, 37.17, 41.81, 49.49 },
+    { 40.66, 42.22, 42.41, 49.98, 45.24, 43.40, 42.91, 49.93, 33.04, 37.42, 42.04, 49.47 }
+  },
+  // lmmse-3
+  {
+    { 38.22, 42.64, 44.57, 51.35, 44.81, 45.16, 44.99, 51.44, 32.09, 37.23, 43.70, 50.68 },
+    { 38.23, 42.63, 44.45, 51.34, 44.83, 45.55, 45.20, 51.43, 32.16, 37.21, 44.17, 50.76 },
+    { 38.26, 41.79, 42.94, 51.36, 44.72, 44.10, 43.44, 51.27, 32.05, 36.81, 42.36, 50.55 },
+    { 38.25, 41.91, 42.90, 51.34, 44.78, 43.87, 43.56, 51.27, 32.17, 37.03, 42.64, 50.52 }
+  },
+  // lmmse-4
+  {
+    { 35.53, 41.12, 44.54, 52.29, 42.66, 45.01, 45.27, 52.42, 31.50, 36.78, 43.94, 51.27 },
+    { 35.53, 41.11, 44.44, 52.28, 42.68, 45.33, 45.48, 52.41, 31.56, 36.79, 44.46, 51.38 },
+    { 35.58, 40.53, 43.00, 52.30, 42.58, 43.98, 43.70, 52.23, 31.47, 36.43, 42.58, 51.15 },
+    { 35.57, 40.62, 42.96, 52.27, 42.63, 43.75, 43.83, 52.22, 31.57, 36.63, 42.90, 51.10 }
+  },
+  // amaze
+  {
+    { 36.47, 38.28, 39.83, 45.41, 41.41, 40.20, 41.41, 45.27, 34.24, 37.36, 41.37, 45.29 },
+    { 36.49, 38.27, 39.84, 45.44, 41.36, 40.18, 41.38, 45.26, 34.19, 37.33, 41.34, 45.27 },
+    { 36.49, 38.31, 39.66, 45.42, 41.33, 40.20, 41.17, 45.25, 34.20, 37.28, 40.93, 45.18 },
+    { 36.48, 38.34, 39.66, 45.47, 41.26, 40.16, 41.18, 45.24, 34.12, 37.25, 40.90, 45.19 }
+  }
+};
+
+/*
+ * HELPER FUNCTIONS
+ */
+
+// a fixed xorshift sequence, the noise is the same on every run
+static float scene_noise(uint32_t *state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return (float)(*state >> 8) / 16777216.0f;
+}
+
+// left third a zone plate, middle third hard edged blocks, right third
+// smooth gradients. the bottom rows are pushed into clipping.
+static void scene_fill(float *rgb, const int width, const int height)
+{
+  uint32_t state = 0x12345678u;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      float *p = rgb + 4 * ((size_t)j * width + i);
+      const float x = (float)i / width;
+      const float y = (float)j / height;
+      const float zone =
+        0.5f + 0.5f * cosf(400.0f * (sqf(x - 0.5f) + sqf(y - 0.5f)));
+      const float edge = ((i / 97 + j / 61) & 1) ? 0.8f : 0.15f;
+      const float smooth = 0.5f + 0.45f * sinf(30.0f * y) * cosf(20.0f * x);
+      float base = x < 0.33f ? zone : (x < 0.66f ? edge : smooth);
+      if(y > 0.85f) base *= 1.4f;
+      const float noise = 0.03f * scene_noise(&state);
+      p[0] = fminf(1.0f, base * (0.6f + 0.4f * y) + noise);
+      p[1] = fminf(1.0f, base * 0.9f + noise);
+      p[2] = fminf(1.0f, base * (0.4f + 0.5f * x) + noise);
+      p[3] = 0.0f;
+    }
+}
+
+static void scene_mosaic(scene_t *s, const uint32_t f)
+{
+  for(int j = 0; j < SCENE_HEIGHT; j++)
+    for(int i = 0; i < SCENE_WIDTH; i++)
+    {
+      const size_t k = (size_t)j * SCENE_WIDTH + i;
+      s->cfa[k] = s->rgb[4 * k + FC(j, i, f)];
+    }
+}
+
+static void scene_demosaic(scene_t *s, const algo_t algo, const uint32_t f)
+{
+  scene_mosaic(s, f);
+  switch(algo)
+  {
+    case ALGO_BOX3:
+      demosaic_box3(s->out, s->cfa, SCENE_WIDTH, SCENE_HEIGHT, f, NULL);
+      break;
+    case ALGO_RCD:
+      rcd_demosaic(s->out, s->cfa, SCENE_WIDTH, SCENE_HEIGHT, f, 1.0f);
+      break;
+    case ALGO_AMAZE:
+      amaze_demosaic(s->cfa, s->out, SCENE_WIDTH, SCENE_HEIGHT, f, 1.0f);
+      break;
+    default:
+      lmmse_demosaic(s->out, s->cfa, SCENE_WIDTH, SCENE_HEIGHT, f,
+                     (dt_iop_demosaic_lmmse_t)(algo - ALGO_LMMSE_0), 1.0f);
+      break;
+  }
+}
+
+// psnr of the area [x0, x1[ x [y0, y1[ of the output against the scene
+static double scene_psnr_area(const scene_t *s, const int x0, const int y0,
+                              const int x1, const int y1)
+{
+  double sum = 0.0;
+  size_t count = 0;
+  for(int j = y0; j < y1; j++)
+    for(int i = x0; i < x1; i++)
+      for(int c = 0; c < 3; c++)
+      {
+        const size_t k = 4 * ((size_t)j * SCENE_WIDTH + i) + c;
+        sum += sqf(s->out[k] - s->rgb[k]);
+        count++;
+      }
+  return sum > 0.0 ? 10.0 * log10(count / sum) : 999.0;
+}
+
+static double scene_psnr(const scene_t *s)
+{
+  return scene_psnr_area(s, SCENE_BORDER, SCENE_BORDER,
+                         SCENE_WIDTH - SCENE_BORDER,
+                         SCENE_HEIGHT - SCENE_BORDER);
+}
+
+// psnr per tile, the tiles at the edges leave out the border
+static void scene_psnr_tiles(const scene_t *s, double *psnr)
+{
+  const int tw = SCENE_WIDTH / TILES_X;
+  const int th = SCENE_HEIGHT / TILES_Y;
+  for(int ty = 0; ty < TILES_Y; ty++)
+    for(int tx = 0; tx < TILES_X; tx++)
+      psnr[ty * TILES_X + tx] =
+        scene_psnr_area(s, MAX(tx * tw, SCENE_BORDER),
+                        MAX(ty * th, SCENE_BORDER),
+                        MIN((tx + 1) * tw, SCENE_WIDTH - SCENE_BORDER),
+                        MIN((ty + 1) * th, SCENE_HEIGHT - SCENE_BORDER));
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static int setup(void **state)
+{
+  scene_t *s = calloc(1, sizeof(scene_t));
+  const size_t npix = (size_t)SCENE_WIDTH * SCENE_HEIGHT;
+  s->rgb = dt_alloc_align_float(4 * npix);
+  s->cfa = dt_alloc_align_float(npix);
+  s->out = dt_alloc_align_float(4 * npix);
+  if(!s->rgb || !s->cfa || !s->out) return -1;
+  scene_fill(s->rgb, SCENE_WIDTH, SCENE_HEIGHT);
+  *state = s;
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  scene_t *s = *state;
+  _cleanup_lmmse_gamma();
+  dt_free_align(s->rgb);
+  dt_free_align(s->cfa);
+  dt_free_align(s->out);
+  free(s);
+  return 0;
+}
+
+static void test_lmmse(void **state)
+{
+  scene_t *s = *state;
+  // the psnr the implementation reached on this scene before its row
+  // kernels were vectorized, per refinement mode
+  const double floor[] = { 40.28, 40.41, 40.36, 39.79, 38.98 };
+
+  for(int mode = DT_LMMSE_REFINE_0; mode <= DT_LMMSE_REFINE_4; mode++)
+  {
+    TR_STEP("verify that lmmse refinement %d keeps its psnr", mode);
+    for(int f = 0; f < 4; f++)
+    {
+      scene_demosaic(s, ALGO_LMMSE_0 + mode, filters[f]);
+      const double psnr = scene_psnr(s);
+      TR_DEBUG("filters=%08x => psnr=%.2f dB", filters[f], psnr);
+      assert_true(psnr > floor[mode] - PSNR_TOLERANCE);
+    }
+  }
+}
+
+static void test_amaze(void **state)
+{
+  scene_t *s = *state;
+  // the psnr the implementation reached on this scene before its row
+  // kernels were vectorized
+  const double floor = 39.17;
+
+  TR_STEP("verify that amaze keeps its psnr");
+  for(int f = 0; f < 4; f++)
+  {
+    scene_demosaic(s, ALGO_AMAZE, filters[f]);
+    const double psnr = scene_psnr(s);
+    TR_DEBUG("filters=%08x => psnr=%.2f dB", filters[f], psnr);
+    assert_true(psnr > floor - PSNR_TOLERANCE);
+  }
+}
+
+static void test_reference(void **state)
+{
+  scene_t *s = *state;
+
+  for(int algo = 0; algo < ALGO_COUNT; algo++)
+  {
+    TR_STEP("verify that %s matches the previous implementation per tile",
+            algo_names[algo]);
+    for(int f = 0; f < 4; f++)
+    {
+      double psnr[TILES];
+      scene_demosaic(s, algo, filters[f]);
+      scene_psnr_tiles(s, psnr);
+      for(int t = 0; t < TILES; t++)
+      {
+        TR_DEBUG("filters=%08x tile %d => psnr=%.2f dB (previous %.2f dB)",
+                 filters[f], t, psnr[t], reference[algo][f][t]);
+        assert_float_equal(psnr[t], reference[algo][f][t], TILE_TOLERANCE);
+      }
+    }
+  }
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_lmmse),
+    cmocka_unit_test(test_amaze),
+    cmocka_unit_test(test_reference),
+  };
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,308 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2025 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// benchmark for the wavelet engine: dwt_denoise() (rawdenoise) and
+// dwt_decompose() (retouch) against the previous two-sweep
+// implementation, kept here as the reference. the reference allocates its
+// buffers on every call like the old code did, the engine takes them from
+// the pool. every run compares the outputs and reports the bytes of
+// scratch memory each side needs per call.
+//
+// usage: darktable-bench-wavelet [runs]
+
+#include "common/darktable.h"
+#include "common/dwt.h"
+#include "common/math.h"
+#include "common/wavelet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+// vertical sweep of the old transform over the whole image
+static void _reference_vertical(float *out, const float *in, const int width, const int height,
+                                const int ch, const int lev)
+{
+  const int vscale = MIN(1 << lev, height - 1);
+  const size_t rowlen = (size_t)width * ch;
+  DT_OMP_FOR()
+  for(int row = 0; row < height; row++)
+  {
+    const int above = abs(row - vscale);
+    const int below = (row + vscale < height) ? row + vscale : 2 * (height - 1) - (row + vscale);
+    for(size_t k = 0; k < rowlen; k++)
+      out[row * rowlen + k] = 2.f * in[row * rowlen + k] + in[above * rowlen + k] + in[below * rowlen + k];
+  }
+}
+
+static inline float _reference_hat(const float *v, const int col, const int c, const int width,
+                                   const int ch, const int hscale)
+{
+  const int left = abs(col - hscale);
+  const int right = (col + hscale < width) ? col + hscale : 2 * (width - 1) - (col + hscale);
+  return (2.f * v[col * ch + c] + v[left * ch + c] + v[right * ch + c]) / 16.f;
+}
+
+// the old dwt_denoise(): the vertical sweep goes to a second buffer, the
+// horizontal one puts the coarse scale back into img and accumulates the
+// thresholded details
+static size_t _reference_denoise(float *img, const int width, const int height, const int bands,
+                                 const float *noise)
+{
+  const size_t n = (size_t)width * height;
+  float *accum = dt_calloc_align_float(n);
+  float *interm = dt_alloc_align_float(n);
+  for(int lev = 0; lev < bands; lev++)
+  {
+    const int hscale = MIN(1 << lev, width - 1);
+    const float thold = noise[lev];
+    _reference_vertical(interm, img, width, height, 1, lev);
+    DT_OMP_FOR()
+    for(int row = 0; row < height; row++)
+    {
+      const float *v = interm + (size_t)row * width;
+      float *details = img + (size_t)row * width;
+      float *acc = accum + (size_t)row * width;
+      // reflected borders apart, the old code ran this as a vectorized loop
+      for(int col = 0; col < hscale; col++)
+      {
+        const float hat = _reference_hat(v, col, 0, width, 1, hscale);
+        const float diff = details[col] - hat;
+        details[col] = hat;
+        acc[col] += MAX(diff - thold, 0.0f) + MIN(diff + thold, 0.0f);
+      }
+      DT_OMP_SIMD()
+      for(int col = hscale; col < width - hscale; col++)
+      {
+        const float hat = (2.f * v[col] + v[col - hscale] + v[col + hscale]) / 16.f;
+        const float diff = details[col] - hat;
+        details[col] = hat;
+        acc[col] += MAX(diff - thold, 0.0f) + MIN(diff + thold, 0.0f);
+      }
+      for(int col = width - hscale; col < width; col++)
+      {
+        const float hat = _reference_hat(v, col, 0, width, 1, hscale);
+        const float diff = details[col] - hat;
+        details[col] = hat;
+        acc[col] += MAX(diff - thold, 0.0f) + MIN(diff + thold, 0.0f);
+      }
+    }
+  }
+  for(size_t k = 0; k < n; k++) img[k] += accum[k];
+  dt_free_align(accum);
+  dt_free_align(interm);
+  return 2 * n * sizeof(float);
+}
+
+// residual of the old dwt_decompose(): the vertical sweep goes into the
+// coarse buffer, the horizontal one through a row per thread and back,
+// next to the reconstruction buffer it always allocated
+static size_t _reference_residual(float *img, const int width, const int height, const int scales)
+{
+  const size_t n = (size_t)4 * width * height;
+  float *buffer[2] = { img, dt_alloc_align_float(n) };
+  float *layers = dt_calloc_align_float(n);
+  size_t padded;
+  float *temp = dt_alloc_perthread_float((size_t)4 * width, &padded);
+  int hpass = 0;
+  for(int lev = 0; lev < scales; lev++)
+  {
+    const int lpass = 1 - (lev & 1);
+    const int hscale = MIN(1 << lev, width - 1);
+    float *coarse = buffer[lpass];
+    float *fine = buffer[hpass];
+    _reference_vertical(coarse, fine, width, height, 4, lev);
+    DT_OMP_FOR()
+    for(int row = 0; row < height; row++)
+    {
+      float *temprow = dt_get_perthread(temp, padded);
+      float *v = coarse + (size_t)4 * row * width;
+      for(int col = 0; col < width; col++)
+        for(int c = 0; c < 4; c++)
+        {
+          const float hat = _reference_hat(v, col, c, width, 4, hscale);
+          temprow[4 * col + c] = hat;
+          fine[(size_t)4 * row * width + 4 * col + c] -= hat;
+        }
+      memcpy(v, temprow, sizeof(float) * 4 * width);
+    }
+    hpass = lpass;
+  }
+  if(buffer[hpass] != img) memcpy(img, buffer[hpass], n * sizeof(float));
+  dt_free_align(buffer[1]);
+  dt_free_align(layers);
+  dt_free_align(temp);
+  return (2 * n + padded * dt_get_num_threads()) * sizeof(float);
+}
+
+static void _fill(float *buf, const size_t n)
+{
+  uint32_t state = 0x12345678u;
+  for(size_t k = 0; k < n; k++)
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    buf[k] = (float)(state & 0xffff) / 65535.0f;
+  }
+}
+
+static float _maxdiff(const float *a, const float *b, const size_t n)
+{
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < n; k++)
+    maxdiff = fmaxf(maxdiff, fabsf(a[k] - b[k]));
+  return maxdiff;
+}
+
+static int _report(const char *what, const int width, const int height, const double t_ref,
+                   const double t_new, const size_t mem_ref, const size_t mem_new,
+                   const size_t allocs, const int runs, const float maxdiff)
+{
+  const gboolean failed = !(maxdiff <= 1e-5f);
+  printf("[wavelet] %-8s %5dx%-5d: reference %8.2fms %6.1fMB, engine %8.2fms %6.1fMB, %5.2fx, "
+         "%zu allocations in %d runs, max diff %g%s\n",
+         what, width, height, 1e3 * t_ref / runs, mem_ref / 1048576.0, 1e3 * t_new / runs,
+         mem_new / 1048576.0, t_ref / t_new, allocs, runs, maxdiff, failed ? " FAILED" : "");
+  return failed;
+}
+
+static int _bench_denoise(const int width, const int height, const int runs)
+{
+  const size_t n = (size_t)width * height;
+  const float noise[5] = { 0.04f, 0.03f, 0.02f, 0.01f, 0.005f };
+  float *in = dt_alloc_align_float(n);
+  float *ref = dt_alloc_align_float(n);
+  float *out = dt_alloc_align_float(n);
+  if(!in || !ref || !out)
+  {
+    printf("[wavelet] out of memory for %dx%d\n", width, height);
+    return 1;
+  }
+  _fill(in, n);
+
+  // start from an empty pool, so that the peak is what this size needs
+  dt_wavelet_pool_cleanup();
+  dt_wavelet_pool_stats_t before, after;
+  dt_wavelet_pool_stats(&before);
+  dt_wavelet_pool_reset_peak();
+  double t_ref = 0.0, t_new = 0.0;
+  size_t mem_ref = 0;
+  for(int r = 0; r < runs; r++)
+  {
+    memcpy(ref, in, n * sizeof(float));
+    double start = dt_get_wtime();
+    mem_ref = _reference_denoise(ref, width, height, 5, noise);
+    t_ref += dt_get_wtime() - start;
+
+    memcpy(out, in, n * sizeof(float));
+    start = dt_get_wtime();
+    dwt_denoise(out, width, height, 5, noise);
+    t_new += dt_get_wtime() - start;
+  }
+  dt_wavelet_pool_stats(&after);
+
+  const int failed = _report("denoise", width, height, t_ref, t_new, mem_ref, after.peak - before.in_use,
+                             after.allocations - before.allocations, runs, _maxdiff(ref, out, n));
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+  return failed;
+}
+
+static int _bench_decompose(const int width, const int height, const int runs)
+{
+  const size_t n = (size_t)4 * width * height;
+  const int scales = 5;
+  float *in = dt_alloc_align_float(n);
+  float *ref = dt_alloc_align_float(n);
+  float *out = dt_alloc_align_float(n);
+  if(!in || !ref || !out)
+  {
+    printf("[wavelet] out of memory for %dx%d\n", width, height);
+    return 1;
+  }
+  _fill(in, n);
+
+  // start from an empty pool, so that the peak is what this size needs
+  dt_wavelet_pool_cleanup();
+  dt_wavelet_pool_stats_t before, after;
+  dt_wavelet_pool_stats(&before);
+  dt_wavelet_pool_reset_peak();
+  double t_ref = 0.0, t_new = 0.0;
+  size_t mem_ref = 0;
+  for(int r = 0; r < runs; r++)
+  {
+    memcpy(ref, in, n * sizeof(float));
+    double start = dt_get_wtime();
+    mem_ref = _reference_residual(ref, width, height, scales);
+    t_ref += dt_get_wtime() - start;
+
+    // returning the residual skips the reconstruction, but the
+    // decomposition is the same as for the whole image
+    memcpy(out, in, n * sizeof(float));
+    start = dt_get_wtime();
+    dwt_params_t *p = dt_dwt_init(out, width, height, 4, scales, scales + 1, 0, NULL, 1.0f);
+    dwt_decompose(p, NULL);
+    dt_dwt_free(p);
+    t_new += dt_get_wtime() - start;
+  }
+  dt_wavelet_pool_stats(&after);
+
+  const int failed = _report("residual", width, height, t_ref, t_new, mem_ref, after.peak - before.in_use,
+                             after.allocations - before.allocations, runs, _maxdiff(ref, out, n));
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+  return failed;
+}
+
+int main(int argc, char *argv[])
+{
+  const int runs = argc > 1 ? MAX(1, atoi(argv[1])) : 5;
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+  omp_set_num_threads(darktable.num_openmp_threads);
+#else
+  darktable.num_openmp_threads = 1;
+#endif
+  dt_wavelet_pool_init();
+  // no darktable resources here, let the pool keep what a run needs
+  dt_wavelet_pool_set_limit((size_t)1 << 30);
+
+  const int sizes[][2] = { { 640, 480 }, { 1920, 1080 }, { 4000, 3000 }, { 6000, 4000 } };
+  int failed = 0;
+  for(int s = 0; s < 4; s++)
+  {
+    failed += _bench_denoise(sizes[s][0], sizes[s][1], runs);
+    failed += _bench_decompose(sizes[s][0], sizes[s][1], runs);
+  }
+  dt_wavelet_pool_cleanup();
+
+  printf("[wavelet] %s\n", failed ? "FAILED" : "passed");
+  return failed ? 1 : 0;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on